@@ -0,0 +1,26 @@
+//===-- BenchMain.cpp -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Context.h"
+
+#include "benchmark/benchmark.h"
+
+using namespace klee;
+
+int main(int argc, char **argv) {
+  // as for a 64 bit little endian module
+  Context::initialize(true, Expr::Int64);
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
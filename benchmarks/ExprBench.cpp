@@ -0,0 +1,94 @@
+//===-- ExprBench.cpp -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/IndependentPartitions.h"
+
+#include "benchmark/benchmark.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> readByte(const Array *array, unsigned index) {
+  return ReadExpr::create(UpdateList(array, 0),
+                          ConstantExpr::alloc(index, Expr::Int32));
+}
+
+void BM_ExprFoldConstants(benchmark::State &state) {
+  ref<Expr> a = ConstantExpr::alloc(12345, Expr::Int32);
+  ref<Expr> b = ConstantExpr::alloc(678, Expr::Int32);
+  for (auto _ : state) {
+    ref<Expr> e = AddExpr::create(a, b);
+    e = MulExpr::create(e, b);
+    e = UltExpr::create(e, a);
+    benchmark::DoNotOptimize(e.get());
+  }
+}
+BENCHMARK(BM_ExprFoldConstants);
+
+/// Fold constants into a symbolic sum, as address arithmetic does.
+void BM_ExprFoldSymbolic(benchmark::State &state) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("a", 4);
+  ref<Expr> x = ZExtExpr::create(readByte(array, 0), Expr::Int32);
+  ref<Expr> one = ConstantExpr::alloc(1, Expr::Int32);
+  for (auto _ : state) {
+    ref<Expr> e = x;
+    for (unsigned i = 0; i != 8; ++i)
+      e = AddExpr::create(e, one);
+    benchmark::DoNotOptimize(e.get());
+  }
+}
+BENCHMARK(BM_ExprFoldSymbolic);
+
+/// Concatenate the bytes of a symbolic word, as a 4 byte load does.
+void BM_ExprConcatRead(benchmark::State &state) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("a", 4);
+  for (auto _ : state) {
+    ref<Expr> e = readByte(array, 0);
+    for (unsigned i = 1; i != 4; ++i)
+      e = ConcatExpr::create(readByte(array, i), e);
+    benchmark::DoNotOptimize(e.get());
+  }
+}
+BENCHMARK(BM_ExprConcatRead);
+
+/// Partition N constraints over N / 4 independent arrays, then look up the
+/// dependencies of one byte.
+void BM_IndependentPartitions(benchmark::State &state) {
+  unsigned n = state.range(0);
+  ArrayCache ac;
+  std::vector<const Array *> arrays;
+  std::vector<ref<Expr> > constraints;
+  for (unsigned i = 0; i != n; ++i) {
+    if (i % 4 == 0)
+      arrays.push_back(ac.CreateArray("a" + std::to_string(i / 4), 4));
+    constraints.push_back(UltExpr::create(
+        readByte(arrays.back(), i % 4),
+        ConstantExpr::alloc(i % 200 + 1, Expr::Int8)));
+  }
+  std::vector<ref<Expr> > result;
+  for (auto _ : state) {
+    IndependentPartitions partitions;
+    for (unsigned i = 0; i != n; ++i)
+      partitions.add(i, constraints[i]);
+    result.clear();
+    partitions.getDependencies(readByte(arrays[0], 0), result);
+    benchmark::DoNotOptimize(result.data());
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_IndependentPartitions)->Range(8, 1024);
+
+}
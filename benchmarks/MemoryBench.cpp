@@ -0,0 +1,177 @@
+//===-- MemoryBench.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "AddressSpace.h"
+#include "Memory.h"
+#include "MemoryManager.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Expr/ArrayCache.h"
+
+#include "benchmark/benchmark.h"
+
+#include <memory>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+const unsigned ObjectSize = 256;
+
+/// A memory manager with objects of ObjectSize bytes.
+struct Objects {
+  ArrayCache arrayCache;
+  MemoryManager memory{&arrayCache};
+  std::vector<MemoryObject *> objects;
+
+  explicit Objects(unsigned n) {
+    for (unsigned i = 0; i != n; ++i)
+      objects.push_back(memory.allocate(ObjectSize, false, true, nullptr, 8));
+  }
+};
+
+void BM_PlaneWriteConcrete(benchmark::State &state) {
+  Objects o(1);
+  ObjectStatePlane plane(o.objects[0]);
+  plane.initializeToZero();
+  unsigned offset = 0;
+  for (auto _ : state) {
+    plane.write32(offset, offset);
+    offset = (offset + 4) % ObjectSize;
+  }
+}
+BENCHMARK(BM_PlaneWriteConcrete);
+
+void BM_PlaneReadConcrete(benchmark::State &state) {
+  Objects o(1);
+  ObjectStatePlane plane(o.objects[0]);
+  plane.initializeToZero();
+  unsigned offset = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(plane.read(offset, Expr::Int32).get());
+    offset = (offset + 4) % ObjectSize;
+  }
+}
+BENCHMARK(BM_PlaneReadConcrete);
+
+void BM_PlaneReadSymbolic(benchmark::State &state) {
+  Objects o(1);
+  const Array *array = o.arrayCache.CreateArray("a", ObjectSize);
+  ObjectStatePlane plane(o.objects[0], array);
+  unsigned offset = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(plane.read(offset, Expr::Int32).get());
+    offset = (offset + 4) % ObjectSize;
+  }
+}
+BENCHMARK(BM_PlaneReadSymbolic);
+
+/// Read words of which every other byte is symbolic.
+void BM_PlaneReadMixed(benchmark::State &state) {
+  Objects o(1);
+  const Array *array = o.arrayCache.CreateArray("a", ObjectSize);
+  ObjectStatePlane plane(o.objects[0]);
+  plane.initializeToZero();
+  for (unsigned i = 0; i < ObjectSize; i += 2)
+    plane.write(i, ReadExpr::create(UpdateList(array, 0),
+                                    ConstantExpr::alloc(i, Expr::Int32)));
+  unsigned offset = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(plane.read(offset, Expr::Int32).get());
+    offset = (offset + 4) % ObjectSize;
+  }
+}
+BENCHMARK(BM_PlaneReadMixed);
+
+/// Create a plane and write to it at a symbolic offset, which flushes it to
+/// its update list.
+void BM_PlaneWriteSymbolicOffset(benchmark::State &state) {
+  Objects o(1);
+  const Array *array = o.arrayCache.CreateArray("i", 4);
+  ref<Expr> index = ZExtExpr::create(
+      ReadExpr::create(UpdateList(array, 0), ConstantExpr::alloc(0, Expr::Int32)),
+      Expr::Int64);
+  ref<Expr> value = ConstantExpr::alloc(1, Expr::Int8);
+  for (auto _ : state) {
+    ObjectStatePlane plane(o.objects[0]);
+    plane.initializeToZero();
+    for (unsigned i = 0; i != 16; ++i)
+      plane.write(index, value);
+  }
+}
+BENCHMARK(BM_PlaneWriteSymbolicOffset);
+
+/// A state whose address space holds N objects.
+struct StateWithObjects : Objects {
+  ExecutionState state{std::vector<ref<Expr> >()};
+
+  explicit StateWithObjects(unsigned n) : Objects(n) {
+    uint64_t address = 0x10000;
+    for (MemoryObject *mo : objects) {
+      ObjectState *os = new ObjectState(mo);
+      os->initializeToZero();
+      state.addressSpace.bindObject(mo, os);
+      state.addressSpace.bindConcreteAddress(address, mo->segment);
+      address += ObjectSize;
+    }
+  }
+};
+
+void BM_ResolveSegment(benchmark::State &state) {
+  StateWithObjects s(state.range(0));
+  const MemoryObject *mo = s.objects[s.objects.size() / 2];
+  KValue pointer(ConstantExpr::alloc(mo->segment, Expr::Int64),
+                 ConstantExpr::alloc(8, Expr::Int64));
+  ResolutionList rl;
+  for (auto _ : state) {
+    rl.clear();
+    s.state.addressSpace.resolveConstantPointer(s.state, nullptr, pointer, rl);
+    benchmark::DoNotOptimize(rl.data());
+  }
+}
+BENCHMARK(BM_ResolveSegment)->Range(8, 8 << 10);
+
+/// Resolve a plain address through the concrete address map.
+void BM_ResolveAddress(benchmark::State &state) {
+  StateWithObjects s(state.range(0));
+  uint64_t address = 0x10000 + s.objects.size() / 2 * ObjectSize + 8;
+  KValue pointer(ConstantExpr::alloc(0, Expr::Int64),
+                 ConstantExpr::alloc(address, Expr::Int64));
+  ResolutionList rl;
+  for (auto _ : state) {
+    rl.clear();
+    s.state.addressSpace.resolveConstantPointer(s.state, nullptr, pointer, rl);
+    benchmark::DoNotOptimize(rl.data());
+  }
+}
+BENCHMARK(BM_ResolveAddress)->Range(8, 8 << 10);
+
+void BM_Fork(benchmark::State &state) {
+  StateWithObjects s(state.range(0));
+  for (auto _ : state) {
+    std::unique_ptr<ExecutionState> child(s.state.branch());
+    benchmark::DoNotOptimize(child.get());
+  }
+}
+BENCHMARK(BM_Fork)->Range(8, 8 << 10);
+
+/// Fork and write to one object in the child, which copies it.
+void BM_ForkAndWrite(benchmark::State &state) {
+  StateWithObjects s(state.range(0));
+  const MemoryObject *mo = s.objects[0];
+  for (auto _ : state) {
+    std::unique_ptr<ExecutionState> child(s.state.branch());
+    const ObjectState *os = child->addressSpace.findObject(mo);
+    child->addressSpace.getWriteable(mo, os)->write8(0, 0, 1);
+  }
+}
+BENCHMARK(BM_ForkAndWrite)->Range(8, 8 << 10);
+
+}
@@ -0,0 +1,88 @@
+//===-- SolverBench.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverCmdLine.h"
+
+#include "benchmark/benchmark.h"
+
+#include <memory>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// N constraints on the bytes of N / 4 independent arrays, and a query
+/// about the first byte.
+struct Constraints {
+  ArrayCache ac;
+  std::vector<const Array *> arrays;
+  std::vector<ref<Expr> > constraints;
+
+  explicit Constraints(unsigned n) {
+    for (unsigned i = 0; i != n; ++i) {
+      if (i % 4 == 0)
+        arrays.push_back(ac.CreateArray("a" + std::to_string(i / 4), 4));
+      constraints.push_back(UltExpr::create(
+          read(arrays.back(), i % 4),
+          ConstantExpr::alloc(i % 200 + 1, Expr::Int8)));
+    }
+  }
+
+  ref<Expr> read(const Array *array, unsigned index) {
+    return ReadExpr::create(UpdateList(array, 0),
+                            ConstantExpr::alloc(index, Expr::Int32));
+  }
+
+  ref<Expr> query() {
+    return EqExpr::create(read(arrays[0], 0),
+                          ConstantExpr::alloc(0, Expr::Int8));
+  }
+};
+
+/// Answer the same query over and over, so that after the first time the
+/// counterexample cache answers it.
+void BM_CexCacheLookup(benchmark::State &state) {
+  Constraints c(state.range(0));
+  ConstraintManager cm(c.constraints);
+  std::unique_ptr<Solver> solver(
+      createCexCachingSolver(createCoreSolver(CoreSolverToUse)));
+  ref<Expr> expr = c.query();
+  bool result;
+  solver->mayBeTrue(Query(cm, expr), result);
+  for (auto _ : state) {
+    solver->mayBeTrue(Query(cm, expr), result);
+    benchmark::DoNotOptimize(result);
+  }
+}
+BENCHMARK(BM_CexCacheLookup)->Range(8, 512);
+
+/// Split a query into its independent part; the core solver is only
+/// asked about that part, and a caching solver below keeps its answer.
+void BM_IndependentSolver(benchmark::State &state) {
+  Constraints c(state.range(0));
+  ConstraintManager cm(c.constraints);
+  std::unique_ptr<Solver> solver(createIndependentSolver(
+      createCachingSolver(createCoreSolver(CoreSolverToUse))));
+  ref<Expr> expr = c.query();
+  bool result;
+  solver->mayBeTrue(Query(cm, expr), result);
+  for (auto _ : state) {
+    solver->mayBeTrue(Query(cm, expr), result);
+    benchmark::DoNotOptimize(result);
+  }
+  state.SetItemsProcessed(state.iterations() * c.constraints.size());
+}
+BENCHMARK(BM_IndependentSolver)->Range(8, 512);
+
+}
@@ -0,0 +1,23 @@
+// Loads and stores at symbolic offsets: update lists and array queries.
+#include "klee/klee.h"
+
+#define N 64
+
+int main() {
+  unsigned char data[N];
+  unsigned char index[4];
+  klee_make_symbolic(index, sizeof index, "index");
+
+  for (unsigned i = 0; i != N; ++i)
+    data[i] = i * 7;
+  for (unsigned i = 0; i != sizeof index; ++i) {
+    klee_assume(index[i] < N);
+    data[index[i]] += 1;
+  }
+
+  unsigned sum = 0;
+  for (unsigned i = 0; i != sizeof index; ++i)
+    if (data[index[i]] % 3 == 0)
+      ++sum;
+  return sum;
+}
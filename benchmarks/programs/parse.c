@@ -0,0 +1,24 @@
+// Parsing a symbolic string: byte comparisons over a growing path condition.
+#include "klee/klee.h"
+
+#define N 8
+
+static int isDigit(char c) { return c >= '0' && c <= '9'; }
+
+int main() {
+  char input[N];
+  klee_make_symbolic(input, sizeof input, "input");
+  input[N - 1] = 0;
+
+  int value = 0, sign = 1;
+  const char *p = input;
+  if (*p == '-') {
+    sign = -1;
+    ++p;
+  }
+  while (isDigit(*p))
+    value = value * 10 + (*p++ - '0');
+  if (*p != 0)
+    return -1;
+  return sign * value == 1234;
+}
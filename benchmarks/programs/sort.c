@@ -0,0 +1,22 @@
+// Sorting symbolic values: many forks and branch queries.
+#include "klee/klee.h"
+
+#define N 6
+
+int main() {
+  unsigned char values[N];
+  klee_make_symbolic(values, sizeof values, "values");
+
+  for (unsigned i = 0; i != N; ++i)
+    for (unsigned j = 0; j + 1 < N - i; ++j)
+      if (values[j] > values[j + 1]) {
+        unsigned char t = values[j];
+        values[j] = values[j + 1];
+        values[j + 1] = t;
+      }
+
+  for (unsigned i = 0; i + 1 < N; ++i)
+    if (values[i] > values[i + 1])
+      klee_report_error(__FILE__, __LINE__, "not sorted", "sort.err");
+  return values[0];
+}
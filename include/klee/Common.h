@@ -23,12 +23,16 @@ namespace klee {
     const char SOLVER_QUERIES_SMT2_FILE_NAME[]="solver-queries.smt2";
     const char ALL_QUERIES_KQUERY_FILE_NAME[]="all-queries.kquery";
     const char SOLVER_QUERIES_KQUERY_FILE_NAME[]="solver-queries.kquery";
+    const char ALL_QUERIES_BINARY_FILE_NAME[]="all-queries.kqb";
+    const char SOLVER_QUERIES_BINARY_FILE_NAME[]="solver-queries.kqb";
 
     Solver *constructSolverChain(Solver *coreSolver,
                                  std::string querySMT2LogPath,
                                  std::string baseSolverQuerySMT2LogPath,
                                  std::string queryKQueryLogPath,
-                                 std::string baseSolverQueryKQueryLogPath);
+                                 std::string baseSolverQueryKQueryLogPath,
+                                 std::string queryBinaryLogPath,
+                                 std::string baseSolverQueryBinaryLogPath);
 }
 
 
@@ -12,7 +12,11 @@
 
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Internal/ADT/ImmutableList.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
+#include "klee/Internal/ADT/ImmutableSet.h"
 #include "klee/Internal/ADT/TreeStream.h"
+#include "klee/Internal/Module/Cell.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/MergeHandler.h"
 
@@ -21,29 +25,92 @@
 #include "klee/Internal/Module/KInstIterator.h"
 #include "klee/ConcreteValue.h"
 
+#include "llvm/ADT/SparseBitVector.h"
+
+#include <climits>
 #include <map>
+#include <memory>
 #include <set>
+#include <string>
 #include <vector>
 
+namespace llvm {
+class Function;
+}
+
 namespace klee {
 class Array;
+class Assignment;
 class CallPathNode;
-struct Cell;
+struct CallRecording;
+class ExprReader;
+class ExprWriter;
 struct KFunction;
 struct KInstruction;
 class MemoryObject;
 class PTreeNode;
 struct InstructionInfo;
+class SubsumptionNode;
 
 llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const MemoryMap &mm);
 
+/// Register file of a stack frame. It is shared between the copies of a
+/// frame made when a state forks, until one of them writes to it.
+struct StackLocals {
+  unsigned refCount;
+  unsigned size;
+  Cell *cells;
+  /// Order-independent hash of the bound cells, see StackFrame::setLocal.
+  uint64_t hash;
+};
+
 struct StackFrame {
   KInstIterator caller;
   KFunction *kf;
   CallPathNode *callPathNode;
 
+  /// The local objects of the frame, unbound when it is popped. The slots
+  /// of objects whose lifetime ended are null until compacted.
   std::vector<const MemoryObject *> allocas;
-  Cell *locals;
+  /// The slot of each object in \ref allocas, shared between the copies
+  /// of the frame made when a state forks.
+  ImmutableMap<const MemoryObject *, unsigned> allocaSlots;
+
+  /// Allocas whose lifetime ended, by alloca instruction. They are kept so
+  /// that a new lifetime of the alloca binds the same object again, which
+  /// its pointer still refers to.
+  std::vector<std::pair<const KInstruction *, ref<const MemoryObject> > >
+      deadAllocas;
+
+private:
+  StackLocals *locals;
+
+  void unshareLocals();
+  /// Prepare the register \p index to be overwritten with \p value.
+  Cell &beginSetLocal(unsigned index, const KValue &value);
+
+public:
+  const Cell &getLocal(unsigned index) const {
+    assert(index < locals->size);
+    return locals->cells[index];
+  }
+  /// Bind a register, keeping the hash of the locals up to date.
+  void setLocal(unsigned index, const KValue &value);
+  void setLocal(unsigned index, KValue &&value);
+
+  /// Hash of the locals of the frame, maintained by setLocal.
+  uint64_t getLocalsHash() const { return locals->hash; }
+
+  /// Move the locals to \p w unless they are shared with another frame,
+  /// keeping their hash. They are read back by swapInLocals().
+  void swapOutLocals(ExprWriter &w);
+  void swapInLocals(ExprReader &r);
+
+  /// Add a local object to \ref allocas, once.
+  void addAlloca(const MemoryObject *mo);
+  /// Remove a local object from \ref allocas without a scan.
+  /// \return false if the frame has no such object.
+  bool removeAlloca(const MemoryObject *mo);
 
   /// Minimum distance to an uncovered instruction once the function
   /// returns. This is not a good place for this but is used to
@@ -59,8 +126,12 @@ struct StackFrame {
   // of intrinsic lowering.
   MemoryObject *varargs;
 
+  /// The call recorded by -memoize-calls, if any.
+  std::shared_ptr<CallRecording> recording;
+
   StackFrame(KInstIterator caller, KFunction *kf);
   StackFrame(const StackFrame &s);
+  StackFrame &operator=(const StackFrame &s);
   ~StackFrame();
 };
 
@@ -107,46 +178,61 @@ private:
 public:
   // Execution - Control Flow specific
 
+  /// A value returned by a nondet function, recorded for the test vector
+  /// and the witness of the path.
   struct NondetValue {
       KValue value;
-      // info about name and where the object was created...
-      NondetValue() = default;
+      KInstruction *kinstruction{nullptr};
+      /// Interned, see ExecutionState::internNondetName
+      const std::string *name;
+      bool isSigned;
+
+      NondetValue(const KValue &val, bool sgned, const std::string *n)
+      : value(val), name(n), isSigned(sgned) {}
 
-      NondetValue(ref<Expr> e, const std::string& n) : value(e), name(n) {}
-      NondetValue(const KValue& val, const std::string& n) : value(val), name(n) {}
+      const std::string &getName() const { return *name; }
+  };
 
-      NondetValue(ref<Expr> e, KInstruction *ki, const std::string& n)
-      : value(e), kinstruction(ki), name(n) {}
-      NondetValue(const KValue& val, KInstruction *ki, const std::string& n)
-      : value(val), kinstruction(ki), name(n) {}
+  /// @brief A symbolic memory object with the array backing its contents.
+  /// Holds a reference to the memory object and to the array.
+  class Symbolic {
+    const MemoryObject *memoryObject;
+    const Array *array;
 
-      NondetValue(ref<Expr> e, bool sgned, const std::string& n)
-      : value(e), isSigned(sgned), name(n) {}
-      NondetValue(const KValue& val, bool sgned, const std::string& n)
-      : value(val), isSigned(sgned), name(n) {}
+  public:
+    Symbolic(const MemoryObject *mo, const Array *array);
+    Symbolic(const Symbolic &b);
+    Symbolic &operator=(const Symbolic &b);
+    ~Symbolic();
 
-      NondetValue(ref<Expr> e, bool sgned, KInstruction *ki, const std::string& n)
-      : value(e), isSigned(sgned), kinstruction(ki), name(n) {}
-      NondetValue(const KValue& val, bool sgned, KInstruction *ki, const std::string& n)
-      : value(val), isSigned(sgned), kinstruction(ki), name(n) {}
+    const MemoryObject *getObject() const { return memoryObject; }
+    const Array *getArray() const { return array; }
 
-      bool isSigned{false};
-      KInstruction *kinstruction{nullptr};
-      const std::string name{};
+    bool operator==(const Symbolic &b) const {
+      return memoryObject == b.memoryObject && array == b.array;
+    }
+  };
 
-      // when an instruction that creates a nodet value is called
-      // several times, we can assign a sequential number to each
-      // of the values here
-      //size_t seqNum{0};
+  /// Shared with the states this one was forked from, appending is O(1).
+  ImmutableList<NondetValue> nondetValues;
 
-      // concrete value
-      //MaybeConcreteValue concreteValue;
-      //
-      //bool hasConcreteValue() const { return concreteValue.hasValue(); }
+  /// A call of an undefined function assumed to be pure (see
+  /// -external-calls=pure) and the nondet value it returned.
+  struct PureCall {
+      std::vector<KValue> arguments;
+      KValue result;
   };
 
-  // FIXME: wouldn't unique_ptr be more efficient (no ref<> copying)
-  std::vector<NondetValue> nondetValues;
+  /// The pure calls on this path by function, the calls with the same
+  /// arguments return the same value.
+  ImmutableMap<const llvm::Function *, ImmutableList<PureCall> > pureCalls;
+
+  /// The nondet pointers not dereferenced yet on this path, by segment to
+  /// their offset (see -lazy-nondet-pointers).
+  ImmutableMap<ref<Expr>, ref<Expr> > lazyPointers;
+  /// The objects the nondet pointers were initialized to point to, which
+  /// the pointers dereferenced later may alias.
+  ImmutableList<ref<const MemoryObject> > lazyObjects;
   // FIXME: this is a hack to be able to generate termination witnesses for SV-COMP
   llvm::Instruction *lastLoopHead{nullptr};
   size_t lastLoopHeadId{0};
@@ -176,11 +262,35 @@ public:
   /// @brief Constraints collected so far
   ConstraintManager constraints;
 
+  /// @brief A branch condition this state took without asking the solver,
+  /// not yet part of the constraints, see -fast-seed-replay
+  ref<Expr> pendingCondition;
+
+  /// @brief The values expressions were concretized to on this path. The
+  /// constraints imply each of them, so they are reused without asking the
+  /// solver again, and inherited by the states forked from this one.
+  ImmutableMap<ref<Expr>, ref<ConstantExpr> > pinnedValues;
+
+  /// @brief A model of the constraints found by the solver, kept while it
+  /// satisfies the constraints added since (see -reuse-models)
+  mutable std::shared_ptr<const Assignment> model;
+
+  /// @brief The expressions the solver proved true or false on this path,
+  /// which the constraints added later cannot change. They are inherited by
+  /// the states forked from this one, so that a condition decided before
+  /// the fork is not asked about again.
+  mutable ImmutableMap<ref<Expr>, bool> decidedExprs;
+
   /// Statistics and information
 
   /// @brief Costs for all queries issued for this state, in seconds
   mutable time::Span queryCost;
 
+  /// @brief Number of queries issued for this state, and of those that
+  /// missed all caches and reached the core solver
+  mutable unsigned solverQueries = 0;
+  mutable unsigned coreSolverQueries = 0;
+
   /// @brief Weight assigned for importance of this state.  Can be
   /// used for searchers to decide what paths to explore
   double weight;
@@ -206,28 +316,61 @@ public:
   /// @brief Disables forking for this state. Set by user code
   bool forkDisabled;
 
-  /// @brief Set containing which lines in which files are covered by this state
-  std::map<const std::string *, std::set<unsigned> > coveredLines;
+  /// @brief The instructions first covered by this state (since it was
+  /// forked; copies start with an empty set), by InstructionInfo id. Their
+  /// lines are only looked up when a test case is written.
+  llvm::SparseBitVector<> coveredInstructions;
+
+  /// @brief Explanations of the values concretized on this path because
+  /// their expressions grew too deep (see -max-expr-depth)
+  std::vector<std::string> exprDepthConcretizations;
 
   /// @brief Pointer to the process tree of the current state
   PTreeNode *ptreeNode;
 
+  /// @brief The part of the exploration this state is in, for
+  /// -subsume-states
+  std::shared_ptr<SubsumptionNode> subsumptionNode;
+
   /// @brief Ordered list of symbolics: used to generate test cases.
-  //
-  // FIXME: Move to a shared list structure (not critical).
-  std::vector<std::pair<const MemoryObject *, const Array *> > symbolics;
+  ImmutableList<Symbolic> symbolics;
 
   /// @brief Set of used array names for this state.  Used to avoid collisions.
-  std::set<std::string> arrayNames;
+  ImmutableSet<std::string> arrayNames;
+
+  /// @brief For each name asked for by getUniqueArrayName, the next suffix
+  /// to try: the name and its variants with smaller suffixes are taken.
+  ImmutableMap<std::string, unsigned> arrayNameIds;
 
   // The objects handling the klee_open_merge calls this state ran through
   std::vector<ref<MergeHandler> > openMergeStack;
 
+  /// @brief Number of states merged into this one, to account the solver
+  /// time spent on merged states
+  unsigned mergedStates = 0;
+
   // The numbers of times this state has run through Executor::stepInstruction
   std::uint64_t steppedInstructions;
 
+  /// @brief The instruction count when this state was last selected to
+  /// run, see -compact-states-after.
+  std::uint64_t lastScheduled = 0;
+
+  /// @brief Identifies this state in the checkpoint log (see
+  /// -checkpoint-interval). Zero marks a state resumed into a part of the
+  /// exploration that the checkpoint had already finished.
+  std::uint64_t checkpointId = 1;
+
+  /// @brief Identifies the path of this state by the sides it took at each
+  /// choice, whatever order the states ran in (see -deterministic-test-ids).
+  std::uint64_t pathId = 0;
+
   NondetValue& addNondetValue(const KValue& val, bool isSigned, const std::string& name);
 
+  /// Return the one copy of \a name shared by the nondet values of all
+  /// states, there are few distinct names but many values.
+  static const std::string *internNondetName(const std::string &name);
+
 private:
   ExecutionState() : ptreeNode(0) {}
 
@@ -243,15 +386,40 @@ public:
   ~ExecutionState();
 
   ExecutionState *branch();
+  /// Extend pathId by the side \a side the state took at a fork.
+  void takeBranch(unsigned side);
+  /// A pseudo-random number below \a n that only depends on pathId and
+  /// \a salt.
+  unsigned getPathRandom(unsigned n, unsigned salt = 0) const;
 
   void pushFrame(KInstIterator caller, KFunction *kf);
   void popFrame();
   void removeAlloca(const MemoryObject *mo);
 
   void addSymbolic(const MemoryObject *mo, const Array *array);
-  void addConstraint(ref<Expr> e) { constraints.addConstraint(e); }
-
-  bool merge(const ExecutionState &b);
+  /// Reserve an array name not used by this state yet: \a name itself, or
+  /// else \a name with the first free suffix _1, _2, ...
+  std::string getUniqueArrayName(const std::string &name);
+  void addConstraint(ref<Expr> e);
+
+  /// Merge b into this state. Fails if the states differ in more than
+  /// maxJoins local values and memory bytes, as each of them becomes an
+  /// if-then-else that every later query has to reason about.
+  bool merge(const ExecutionState &b, unsigned maxJoins = UINT_MAX);
+
+  /// A 64-bit hash of the location, the stack, the constraints and the
+  /// versions of the memory objects. Equal states get equal fingerprints
+  /// as long as they wrote their memory in the same way; requires
+  /// AddressSpace::trackVersions.
+  uint64_t getFingerprint() const;
+  /// The fingerprint without the constraints.
+  uint64_t getContextFingerprint() const;
+
+  /// Move the constraints, the locals and the memory objects this state
+  /// does not share with others to \p w (see -max-memory-suspend). The
+  /// state must not run until resume() reads them back.
+  void suspend(ExprWriter &w);
+  void resume(ExprReader &r);
   void dumpStack(llvm::raw_ostream &out) const;
 };
 }
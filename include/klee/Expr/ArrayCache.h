@@ -11,30 +11,15 @@
 #define KLEE_ARRAYCACHE_H
 
 #include "klee/Expr/Expr.h"
-#include "klee/Expr/ArrayExprHash.h" // For klee::ArrayHashFn
-
-// FIXME: Remove this hack when we switch to C++11
-#ifdef _LIBCPP_VERSION
-#include <unordered_set>
-#define unordered_set std::unordered_set
-#else
-#include <tr1/unordered_set>
-#define unordered_set std::tr1::unordered_set
-#endif
 
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace klee {
 
-struct EquivArrayCmpFn {
-  bool operator()(const Array *array1, const Array *array2) const {
-    if (array1 == NULL || array2 == NULL)
-      return false;
-    return (array1->size == array2->size) && (array1->name == array2->name);
-  }
-};
-
 /// Provides an interface for creating and destroying Array objects.
 class ArrayCache {
 public:
@@ -44,10 +29,13 @@ public:
   //
   /// Symbolic Arrays are cached so that only one instance exists. This
   /// provides a limited form of "alpha-renaming". Constant arrays are not
-  /// cached.
+  /// cached. Symbolic arrays are looked up by their interned name (see
+  /// ArrayName), so the name is hashed once per call.
   ///
   /// This class retains ownership of Array object so that upon destruction
-  /// of this object all allocated Array objects are deleted.
+  /// of this object all allocated Array objects are deleted, except the
+  /// ones still referenced (see Array::retain()), which are freed with
+  /// their last reference.
   ///
   /// \param _name The name of the array
   /// \param _size The size of the array in bytes
@@ -67,15 +55,42 @@ public:
                            Expr::Width _domain = Expr::Int32,
                            Expr::Width _range = Expr::Int8);
 
+  /// Free the arrays that were referenced (by an UpdateList, say) and no
+  /// longer are. Arrays which were never referenced are kept, as whoever
+  /// created them may still be about to use them; so are all arrays until
+  /// this is called, so the owner calls it where no array it released is
+  /// used through a plain pointer anymore.
+  ///
+  /// \return The number of arrays freed.
+  size_t collect();
+
+  /// Number of arrays currently owned by the cache.
+  size_t size() const {
+    return cachedSymbolicArrays.size() + concreteArrays.size();
+  }
+
 private:
-  typedef unordered_set<const Array *, klee::ArrayHashFn,
-                        klee::EquivArrayCmpFn> ArrayHashMap;
+  friend class Array;
+
+  /// A symbolic array is identified by its name and size.
+  typedef std::pair<const ArrayName *, uint64_t> SymbolicKey;
+  struct SymbolicKeyHashFn {
+    size_t operator()(const SymbolicKey &key) const {
+      // the hash of the array, computed without the array
+      return key.first->hash * Expr::MAGIC_HASH_CONSTANT + key.second;
+    }
+  };
+  typedef std::unordered_map<SymbolicKey, const Array *, SymbolicKeyHashFn>
+      ArrayHashMap;
   ArrayHashMap cachedSymbolicArrays;
-  typedef std::vector<const Array *> ArrayPtrVec;
-  ArrayPtrVec concreteArrays;
+  typedef std::unordered_set<const Array *> ArrayPtrSet;
+  ArrayPtrSet concreteArrays;
+  /// The arrays released since the last collect(), which may have been
+  /// referenced again since.
+  std::vector<const Array *> released;
+
+  void freeArray(const Array *array);
 };
 }
 
-#undef unordered_set
-
 #endif /* KLEE_ARRAYCACHE_H */
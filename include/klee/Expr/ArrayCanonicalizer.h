@@ -0,0 +1,64 @@
+//===-- ArrayCanonicalizer.h ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_ARRAYCANONICALIZER_H
+#define KLEE_ARRAYCANONICALIZER_H
+
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+namespace klee {
+  class ArrayCache;
+  class Assignment;
+
+  /// ArrayCanonicalizer - Rename the symbolic arrays of a query by their
+  /// order of first occurrence.
+  ///
+  /// Arrays get their names from the state that made them, so the same
+  /// query asked by two states differs in its array names and misses in
+  /// the caches. After renaming, the i-th symbolic array of every query is
+  /// the same canonical array (for a given size, domain and range). Each
+  /// canonicalizer numbers the arrays of one query, and translates the
+  /// assignments for it between the two namings. Constant arrays are kept.
+  class ArrayCanonicalizer {
+    /// Where the canonical arrays are created; they are shared by all
+    /// canonicalizers using it.
+    ArrayCache &arrayCache;
+    std::map<const Array *, const Array *> canonical;
+    std::map<const Array *, const Array *> original;
+    ExprHashMap<ref<Expr> > visited;
+    std::unordered_map<const UpdateNode *, UpdateList> updates;
+
+    const Array *getCanonical(const Array *array);
+    UpdateList visit(const UpdateList &ul);
+
+  public:
+    explicit ArrayCanonicalizer(ArrayCache &arrayCache)
+        : arrayCache(arrayCache) {}
+
+    /// \return \arg e over the canonical arrays, numbering the arrays not
+    /// seen before by this canonicalizer.
+    ref<Expr> visit(const ref<Expr> &e);
+
+    /// \return The bindings of \arg a for the arrays seen so far, moved to
+    /// their canonical arrays.
+    std::shared_ptr<const Assignment> toCanonical(const Assignment &a) const;
+
+    /// \return The bindings of \arg a for canonical arrays, moved back to
+    /// the arrays seen so far.
+    std::shared_ptr<const Assignment> toOriginal(const Assignment &a) const;
+  };
+
+}
+
+#endif /* KLEE_ARRAYCANONICALIZER_H */
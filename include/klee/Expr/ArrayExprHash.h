@@ -16,6 +16,7 @@
 
 #include <map>
 #include <unordered_map>
+#include <utility>
 
 namespace klee {
   
@@ -43,6 +44,9 @@ struct UpdateNodeCmpFn {
   }
 };  
 
+/// The hashed arrays are kept alive (see Array::retain()) for as long as
+/// they are hashed, so that an array freed meanwhile cannot be mistaken for
+/// a new one at the same address.
 template<class T>
 class ArrayExprHash {  
 public:
@@ -51,7 +55,7 @@ public:
   // Note: Extend the class and overload the destructor if the objects of type T
   // that are to be hashed need to be explicitly destroyed
   // As an example, see class STPArrayExprHash
-  virtual ~ArrayExprHash() {};
+  virtual ~ArrayExprHash() { clearArrays(); };
    
   bool lookupArrayExpr(const Array* array, T& exp) const;
   void hashArrayExpr(const Array* array, T& exp);  
@@ -70,6 +74,13 @@ protected:
   
   ArrayHash      _array_hash;
   UpdateNodeHash _update_node_hash;  
+
+  /// Forget the hashed arrays, releasing them.
+  void clearArrays() {
+    for (const auto &entry : _array_hash)
+      entry.first->release();
+    _array_hash.clear();
+  }
 };
 
 
@@ -98,7 +109,12 @@ void ArrayExprHash<T>::hashArrayExpr(const Array* array, T& exp) {
 #endif
    
    assert(array);
-  _array_hash[array] = exp;
+  std::pair<ArrayHashIter, bool> res =
+      _array_hash.insert(std::make_pair(array, exp));
+  if (res.second)
+    array->retain();
+  else
+    res.first->second = exp;
 }
 
 template<class T>
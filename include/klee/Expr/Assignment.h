@@ -11,30 +11,77 @@
 #define KLEE_ASSIGNMENT_H
 
 #include "klee/Expr/ExprEvaluator.h"
+#include "klee/Expr/ExprScalarEvaluator.h"
 
+#include <algorithm>
 #include <map>
+#include <vector>
 
 namespace klee {
   class Array;
 
+  /// CompactArrayModel - The bytes of an array in a model, stored as
+  /// runs of consecutive values. Gaps of up to MaxFill bytes between the
+  /// values are stored as zeros, so a dense model is a single byte vector
+  /// indexed directly, and a sparse one is a few runs found by a binary
+  /// search.
   class CompactArrayModel {
   private:
-    std::vector<std::pair<uint32_t, uint32_t> > skipRanges;
+    static const uint32_t MaxFill = 16;
+
+    /// The first index of each run and the position of its first byte in
+    /// values, empty if the values start at index 0 without a gap.
+    std::vector<std::pair<uint32_t, uint32_t> > runs;
     std::vector<uint8_t> values;
-    friend class MapArrayModel;
+
   public:
-    uint8_t get(unsigned index) const;
+    /// Set the model to the (index, value) pairs of [begin, end), sorted
+    /// by index and without duplicates.
+    template <typename Iterator> void assign(Iterator begin, Iterator end);
+
+    /// Set the model to the bytes of \a bytes, from index 0.
+    void assign(const std::vector<uint8_t> &bytes) {
+      runs.clear();
+      values = bytes;
+    }
+
+    uint8_t get(unsigned index) const {
+      if (runs.empty())
+        return index < values.size() ? values[index] : 0;
+      return getFromRuns(index);
+    }
+
     std::map<uint32_t, uint8_t> asMap() const;
     std::vector<uint8_t> asVector() const;
     void dump() const;
+
+  private:
+    uint8_t getFromRuns(unsigned index) const;
   };
 
+  template <typename Iterator>
+  void CompactArrayModel::assign(Iterator begin, Iterator end) {
+    runs.clear();
+    values.clear();
+    uint32_t next = 0;
+    for (; begin != end; ++begin) {
+      uint32_t gap = begin->first - next;
+      if (gap > MaxFill) {
+        // the values so far are a run starting at index 0
+        if (runs.empty() && !values.empty())
+          runs.push_back(std::make_pair(0, 0));
+        runs.push_back(std::make_pair(begin->first, values.size()));
+      } else {
+        values.resize(values.size() + gap);
+      }
+      values.push_back(begin->second);
+      next = begin->first + 1;
+    }
+  }
+
   class MapArrayModel {
   private:
     std::map<uint32_t, uint8_t> content;
-    bool shouldSkip(unsigned difference) const {
-      return difference > 1;
-    }
   public:
     MapArrayModel() {}
     MapArrayModel(const MapArrayModel &other) {
@@ -70,7 +117,9 @@ namespace klee {
       content[index] = value;
     }
 
-    void toCompact(CompactArrayModel& model) const;
+    void toCompact(CompactArrayModel& model) const {
+      model.assign(content.begin(), content.end());
+    }
   };
 
   class VectorAssignment {
@@ -102,33 +151,41 @@ namespace klee {
     ref<Expr> evaluate(ref<Expr> e) const;
   };
 
+  /// Assignment - The values of the arrays in a model. The models are
+  /// kept in a vector sorted by array, most assignments bind a handful of
+  /// arrays, which a binary search over contiguous memory finds quickly.
   class Assignment {
   public:
     typedef std::map<const Array*, CompactArrayModel> bindings_ty;
     typedef std::map<const Array*, MapArrayModel> map_bindings_ty;
 
     Assignment() = default;
-    Assignment(const bindings_ty bindings) : bindings(bindings) {}
-    Assignment(const map_bindings_ty models) {
+    Assignment(const bindings_ty &models)
+        : bindings(models.begin(), models.end()) {}
+    Assignment(const map_bindings_ty &models) {
+      bindings.reserve(models.size());
       for (const auto &pair : models) {
-        auto &item = bindings[pair.first];
-        pair.second.toCompact(item);
+        bindings.emplace_back(pair.first, CompactArrayModel());
+        pair.second.toCompact(bindings.back().second);
       }
     }
 
     CompactArrayModel& getBindings(const Array *a) {
-        return bindings[a];
+      auto it = lowerBound(a);
+      if (it == bindings.end() || it->first != a)
+        it = bindings.insert(it, std::make_pair(a, CompactArrayModel()));
+      return it->second;
     }
 
     const CompactArrayModel *getBindingsOrNull(const Array *a) const {
-        auto it = bindings.find(a);
-        if (it == bindings.end())
-            return nullptr;
-        return &it->second;
+      auto it = lowerBound(a);
+      if (it == bindings.end() || it->first != a)
+        return nullptr;
+      return &it->second;
     }
 
     bool hasBindings(const Array *a) const {
-        return bindings.find(a) != bindings.end();
+      return getBindingsOrNull(a) != nullptr;
     }
 
     void addBinding(const Array*, const std::vector<unsigned char>& values);
@@ -143,7 +200,22 @@ namespace klee {
     void dump() const;
 
   private:
-    bindings_ty bindings;
+    typedef std::vector<std::pair<const Array *, CompactArrayModel> >
+        flat_bindings_ty;
+
+    /// Sorted by array, as the maps the assignment is built from are.
+    flat_bindings_ty bindings;
+
+    flat_bindings_ty::iterator lowerBound(const Array *a) {
+      return std::lower_bound(
+          bindings.begin(), bindings.end(), a,
+          [](const flat_bindings_ty::value_type &binding, const Array *a) {
+            return binding.first < a;
+          });
+    }
+    flat_bindings_ty::const_iterator lowerBound(const Array *a) const {
+      return const_cast<Assignment *>(this)->lowerBound(a);
+    }
   };
 
   template <typename T>
@@ -189,24 +261,36 @@ namespace klee {
   }
 
   inline ref<Expr> Assignment::evaluate(ref<Expr> e) const {
+    if (isa<ConstantExpr>(e))
+      return e;
+    // one constant for the result rather than one for every node
+    uint64_t value;
+    if (ExprScalarEvaluator(*this).evaluate(e, value))
+      return ConstantExpr::alloc(value, e->getWidth());
     AssignmentEvaluator<Assignment> v(*this);
     return v.visit(e);
   }
 
   inline uint8_t Assignment::getValue(const Array* array, unsigned index) const {
-    bindings_ty::const_iterator it = bindings.find(array);
-    if (it!=bindings.end()) {
-      return it->second.get(index);
-    }
+    if (const CompactArrayModel *model = getBindingsOrNull(array))
+      return model->get(index);
     return 0;
   }
 
   template<typename InputIterator>
   inline bool Assignment::satisfies(InputIterator begin, InputIterator end) const {
+    // shares the values of common subexpressions between the constraints
+    ExprScalarEvaluator scalar(*this);
     AssignmentEvaluator<Assignment> v(*this);
-    for (; begin!=end; ++begin)
-      if (!v.visit(*begin)->isTrue())
+    for (; begin!=end; ++begin) {
+      uint64_t value;
+      if (scalar.evaluate(*begin, value)) {
+        if ((*begin)->getWidth() != Expr::Bool || !value)
+          return false;
+      } else if (!v.visit(*begin)->isTrue()) {
         return false;
+      }
+    }
     return true;
   }
 }
@@ -0,0 +1,81 @@
+//===-- ByteBounds.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BYTEBOUNDS_H
+#define KLEE_BYTEBOUNDS_H
+
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ValueRange.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
+
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+  /// ByteBounds - The intervals that comparisons with constants put on the
+  /// initial bytes of symbolic arrays, e.g. x < 10 for a byte, or a 32-bit
+  /// value below 256 (which fixes its three higher bytes at 0).
+  ///
+  /// The bounds are persistent, so copies share what they have in common.
+  /// They can be used to decide expressions over the bounded bytes without
+  /// a solver, see evaluate().
+  class ByteBounds {
+  public:
+    /// A byte of the initial contents of a symbolic array.
+    typedef std::pair<const Array *, unsigned> Byte;
+
+    struct Bound {
+      Byte byte;
+      ValueRange range;
+    };
+
+    typedef ImmutableMap<Byte, ValueRange> bounds_ty;
+
+  private:
+    bounds_ty bounds;
+    bool contradictory = false;
+
+  public:
+    /// Get the bounds a comparison of bytes with a constant puts on them.
+    /// An unsatisfiable comparison bounds its first byte by an empty range.
+    ///
+    /// \param[out] exact - Whether the bounds say all \arg e says.
+    /// \return false iff \arg e is not such a comparison.
+    static bool getBounds(const ref<Expr> &e, std::vector<Bound> &result,
+                          bool &exact);
+
+    /// Narrow the bounds by those of \arg e.
+    ///
+    /// \return Whether \arg e is a comparison of bytes with a constant.
+    bool add(const ref<Expr> &e);
+
+    bool empty() const { return bounds.empty(); }
+
+    /// Whether the bounds of some byte are empty. Nothing else should be
+    /// concluded from contradictory bounds.
+    bool isContradictory() const { return contradictory; }
+
+    /// The range of a byte, all values if it is not bounded.
+    ValueRange get(const Array *array, unsigned index) const {
+      const auto *b = bounds.lookup(std::make_pair(array, index));
+      return b ? b->second : ValueRange(0, 255);
+    }
+
+    bounds_ty::iterator begin() const { return bounds.begin(); }
+    bounds_ty::iterator end() const { return bounds.end(); }
+
+    /// Evaluate the range of the values of \arg e under the bounds, or all
+    /// values of its width if the range evaluator does not support it.
+    ValueRange evaluate(const ref<Expr> &e) const;
+  };
+
+}
+
+#endif /* KLEE_BYTEBOUNDS_H */
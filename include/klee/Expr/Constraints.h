@@ -10,7 +10,12 @@
 #ifndef KLEE_CONSTRAINTS_H
 #define KLEE_CONSTRAINTS_H
 
+#include "klee/Expr/ByteBounds.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Expr/IndependentPartitions.h"
+#include "klee/Internal/ADT/ImmutableList.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
 
 // FIXME: Currently we use ConstraintManager for two things: to pass
 // sets of constraints around, and to optimize constraints. We should
@@ -20,10 +25,14 @@ namespace klee {
 
 class ExprVisitor;
 
+/// The constraints are kept in a persistent list, so copying a manager
+/// (e.g. when a state forks) shares the common prefix instead of copying
+/// it. Alongside the list, the manager maintains the data derived from it
+/// that used to be recomputed for every query.
 class ConstraintManager {
 public:
-  using constraints_ty = std::vector<ref<Expr>>;
-  using iterator = constraints_ty::iterator;
+  using constraints_ty = ImmutableList<ref<Expr>>;
+  using iterator = constraints_ty::const_iterator;
   using const_iterator = constraints_ty::const_iterator;
 
   ConstraintManager() = default;
@@ -33,8 +42,10 @@ public:
   ConstraintManager &operator=(ConstraintManager &&cs) = default;
 
   // create from constraints with no optimization
-  explicit ConstraintManager(const std::vector<ref<Expr>> &_constraints)
-      : constraints(_constraints) {}
+  explicit ConstraintManager(const std::vector<ref<Expr>> &_constraints) {
+    for (const auto &constraint : _constraints)
+      push(constraint);
+  }
 
   // given a constraint which is known to be valid, attempt to
   // simplify the existing constraint set
@@ -46,23 +57,68 @@ public:
 
   bool empty() const noexcept { return constraints.empty(); }
   ref<Expr> back() const { return constraints.back(); }
-  const_iterator begin() const { return constraints.cbegin(); }
-  const_iterator end() const { return constraints.cend(); }
+  const_iterator begin() const { return constraints.begin(); }
+  const_iterator end() const { return constraints.end(); }
   std::size_t size() const noexcept { return constraints.size(); }
 
+  /// Order-independent hash of the constraints, maintained incrementally.
+  unsigned hash() const noexcept { return hashValue; }
+
   bool operator==(const ConstraintManager &other) const {
-    return constraints == other.constraints;
+    return hashValue == other.hashValue && constraints == other.constraints;
   }
 
   bool operator!=(const ConstraintManager &other) const {
-    return constraints != other.constraints;
+    return !(*this == other);
   }
 
+  using equalities_ty = ImmutableMap<ref<Expr>, ref<Expr>>;
+
+  /// The constraints split into independent partitions.
+  const IndependentPartitions &getIndependentPartitions() const;
+
+  /// Collect the constraints \arg e depends on, in their original order.
+  void getIndependentConstraints(const ref<Expr> &e,
+                                 std::vector<ref<Expr>> &result) const {
+    getIndependentPartitions().getDependencies(e, result);
+  }
+
+  /// The bounds the constraints put on bytes of symbolic arrays.
+  const ByteBounds &getByteBounds() const;
+
 private:
-  std::vector<ref<Expr>> constraints;
+  constraints_ty constraints;
+
+  /// Replacements used by simplifyExpr: the constant side of every
+  /// equality with a constant, true for every other constraint.
+  equalities_ty equalities;
+
+  unsigned hashValue = 0;
+
+  /// Results of simplifyExpr for the current constraints. Copies of the
+  /// manager share the cache until one of them adds a constraint.
+  mutable std::shared_ptr<ExprHashMap<ref<Expr>>> simplifyCache;
+
+  /// Partitions of the first \c partitioned constraints, extended when
+  /// they are asked for; most managers are never partitioned.
+  mutable IndependentPartitions partitions;
+  mutable std::size_t partitioned = 0;
+
+  /// Bounds of the first \c bounded constraints, extended likewise.
+  mutable ByteBounds bounds;
+  mutable std::size_t bounded = 0;
+
+  /// The sorted arrays read by each constraint, so that rewriting with an
+  /// equality only visits the constraints that may contain its term.
+  /// Brought up to date by rewriteConstraints; most managers never are.
+  ImmutableList<std::vector<const Array *>> arrays;
+
+  /// Append a constraint and update the derived data.
+  void push(const ref<Expr> &e);
 
-  // returns true iff the constraints were modified
-  bool rewriteConstraints(ExprVisitor &visitor);
+  /// Replace \arg src by \arg dst in the constraints.
+  /// Returns true iff the constraints were modified.
+  bool rewriteConstraints(const ref<Expr> &src, const ref<Expr> &dst);
 
   void addConstraintInternal(ref<Expr> e);
 };
@@ -10,6 +10,7 @@
 #ifndef KLEE_EXPR_H
 #define KLEE_EXPR_H
 
+#include "klee/Expr/ExprAllocator.h"
 #include "klee/util/Bits.h"
 #include "klee/util/Ref.h"
 
@@ -22,6 +23,7 @@
 
 #include <sstream>
 #include <set>
+#include <string>
 #include <vector>
 #include <map>
 
@@ -92,6 +94,8 @@ Todo: Shouldn't bool \c Xor just be written as not equal?
 class Expr {
 public:
   static unsigned count;
+  /// Number of expressions created so far, including the freed ones.
+  static uint64_t allocations;
   static const unsigned MAGIC_HASH_CONSTANT = 39;
 
   /// The type of an expression is simply its width, in bits. 
@@ -179,6 +183,13 @@ public:
 protected:  
   unsigned hashValue;
 
+  /// See getDepth().
+  unsigned depth;
+
+  /// See getKnownZeros() and getKnownOnes().
+  uint64_t knownZeros;
+  uint64_t knownOnes;
+
   /// Compares `b` to `this` Expr and determines how they are ordered
   /// (ignoring their kid expressions - i.e. those returned by `getKid()`).
   ///
@@ -204,9 +215,19 @@ protected:
   virtual int compareContents(const Expr &b) const = 0;
 
 public:
-  Expr() : refCount(0) { Expr::count++; }
+  Expr() : refCount(0), depth(1), knownZeros(0), knownOnes(0) {
+    Expr::count++;
+    Expr::allocations++;
+  }
   virtual ~Expr() { Expr::count--; } 
 
+  static void *operator new(size_t size) {
+    return ExprAllocator::allocate(size);
+  }
+  static void operator delete(void *p, size_t size) {
+    ExprAllocator::deallocate(p, size);
+  }
+
   virtual Kind getKind() const = 0;
   virtual Width getWidth() const = 0;
   
@@ -224,6 +245,41 @@ public:
   /// (Re)computes the hash of the current expression.
   /// Returns the hash value. 
   virtual unsigned computeHash();
+
+  /// Returns the pre-computed depth of the current expression: 1 for a
+  /// constant, otherwise one more than the deepest kid. The values written
+  /// into the update list of a read do not count, only its index; they are
+  /// bounded by the depth of the expressions written.
+  unsigned getDepth() const { return depth; }
+
+  /// (Re)computes the depth of the current expression from its kids.
+  void computeDepth();
+
+  /// Returns the pre-computed mask of the bits of the current expression
+  /// which are zero whatever the arrays it reads hold. Nothing is known of
+  /// the expressions wider than 64 bits.
+  uint64_t getKnownZeros() const { return knownZeros; }
+
+  /// Returns the pre-computed mask of the bits of the current expression
+  /// which are one whatever the arrays it reads hold.
+  uint64_t getKnownOnes() const { return knownOnes; }
+
+  /// Whether the value of a boolean expression follows from its known bits,
+  /// in which case it is stored in `value`.
+  bool isKnownBool(bool &value) const {
+    if (!((knownZeros | knownOnes) & 1))
+      return false;
+    value = knownOnes & 1;
+    return true;
+  }
+
+  /// (Re)computes the known bits of the current expression from its kids.
+  void computeKnownBits();
+
+  /// Whether the comparison of kind `k` of `l` and `r` follows from their
+  /// known bits, in which case its result is stored in `value`.
+  static bool decideByKnownBits(Kind k, const Expr *l, const Expr *r,
+                                bool &value);
   
   /// Compares `b` to `this` Expr for structural equivalence.
   ///
@@ -417,6 +473,8 @@ public:
   static ref<Expr> alloc(const ref<Expr> &src) {
     ref<Expr> r(new NotOptimizedExpr(src));
     r->computeHash();
+    r->computeDepth();
+    r->computeKnownBits();
     return r;
   }
   
@@ -462,28 +520,105 @@ public:
 private:
   /// size of this update sequence, including this update
   unsigned size;
-  
-public:
-  UpdateNode(const UpdateNode *_next, 
+
+  /// Number of updates at constant indices this sequence starts with.
+  unsigned constantRun;
+
+  /// The array the update was made to, see intern().
+  const Array *root;
+
+  struct RunIndex;
+  /// The most recent updates at each constant index of a span of the run
+  /// at constant indices this update ends, for every IndexSpan-th update of
+  /// a run.
+  const RunIndex *runIndex;
+
+  UpdateNode(const Array *_root,
+             const UpdateNode *_next, 
              const ref<Expr> &_index, 
              const ref<Expr> &_value);
 
+public:
+  /// The update of \a root at \a index to \a value on top of \a next.
+  /// Updates are hash-consed: an equal update on the same node is shared,
+  /// so that update lists of an array are equal exactly if their heads
+  /// are.
+  static const UpdateNode *intern(const Array *root, const UpdateNode *next,
+                                  const ref<Expr> &index,
+                                  const ref<Expr> &value);
+
+  static void *operator new(size_t size) {
+    return ExprAllocator::allocate(size);
+  }
+  static void operator delete(void *p, size_t size) {
+    ExprAllocator::deallocate(p, size);
+  }
+
   unsigned getSize() const { return size; }
+  const Array *getRoot() const { return root; }
 
   int compare(const UpdateNode &b) const;  
   unsigned hash() const { return hashValue; }
 
+  /// Find the most recent update at the constant index \a index among the
+  /// updates at constant indices this sequence starts with, without
+  /// visiting each of a long run of them.
+  ///
+  /// \param [out] rest - If there is no such update, the rest of the
+  /// sequence after those updates.
+  /// \return The update, or null if there is none.
+  const UpdateNode *findConstantWrite(uint64_t index,
+                                      const UpdateNode *&rest) const;
+
 private:
-  UpdateNode() : refCount(0) {}
+  UpdateNode() : refCount(0), root(0), runIndex(0) {}
   ~UpdateNode();
 
   unsigned computeHash();
 };
 
+/// ArrayName - The name of one or more arrays, interned so that each name is
+/// stored once, and compared and hashed without going through its
+/// characters. Names are created and freed with the arrays that have them.
+class ArrayName {
+  friend class Array;
+
+  /// The number of arrays with this name.
+  unsigned uses;
+
+  ArrayName(const std::string &_str);
+
+public:
+  const std::string str;
+  /// The hash of \ref str, computed once.
+  const unsigned hash;
+
+  /// intern - Get the name \arg str of arrays, creating it if no array has
+  /// it yet; an array should then be created with the new name, which is
+  /// freed with the last array that has it.
+  static const ArrayName *intern(const std::string &str);
+
+  static unsigned hashString(const std::string &str);
+};
+
 class Array {
+  /// The interned name; arrays with equal names share it.
+  const ArrayName *const pooledName;
+
+  /// The number of references held to the array, by the update lists over
+  /// it and the other holders which retain() it.
+  mutable unsigned refCount;
+
+  /// Whether the array is on the list of arrays of its cache which have
+  /// been released since ArrayCache::collect() last ran.
+  mutable bool queuedForCollection;
+
+  /// The cache that created the array, or null once that is gone.
+  mutable ArrayCache *cache;
+
 public:
   // Name of the array
-  const std::string name;
+  const std::string &name;
 
   const size_t size;
 
@@ -514,7 +649,7 @@ private:
   /// when printing expressions. When expressions are printed the output will
   /// not parse correctly since two arrays with the same name cannot be
   /// distinguished once printed.
-  Array(const std::string &_name, uint64_t _size,
+  Array(const ArrayName *_name, uint64_t _size,
         const ref<ConstantExpr> *constantValuesBegin = 0,
         const ref<ConstantExpr> *constantValuesEnd = 0,
         Expr::Width _domain = Expr::Int32, Expr::Width _range = Expr::Int8);
@@ -530,6 +665,19 @@ public:
   const std::string getName() const { return name; }
   unsigned getSize() const { return size; }
 
+  /// hasSameName - Whether the two arrays have equal names, by identity of
+  /// the interned names.
+  bool hasSameName(const Array &b) const { return pooledName == b.pooledName; }
+  /// The hash of the name alone, as UpdateList::hash needs it.
+  unsigned getNameHash() const { return pooledName->hash; }
+
+  /// retain - Keep the array alive until the matching release().
+  void retain() const { ++refCount; }
+  /// release - Drop a reference taken with retain(). An array which is no
+  /// longer referenced is freed by the next ArrayCache::collect(), or here
+  /// if its cache is gone.
+  void release() const;
+
   Expr::Width getDomain() const { return domain; }
   Expr::Width getRange() const { return range; }
 
@@ -581,6 +729,8 @@ public:
   static ref<Expr> alloc(const UpdateList &updates, const ref<Expr> &index) {
     ref<Expr> r(new ReadExpr(updates, index));
     r->computeHash();
+    r->computeDepth();
+    r->computeKnownBits();
     return r;
   }
   
@@ -626,6 +776,8 @@ public:
                          const ref<Expr> &f) {
     ref<Expr> r(new SelectExpr(c, t, f));
     r->computeHash();
+    r->computeDepth();
+    r->computeKnownBits();
     return r;
   }
   
@@ -689,6 +841,8 @@ public:
   static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {
     ref<Expr> c(new ConcatExpr(l, r));
     c->computeHash();
+    c->computeDepth();
+    c->computeKnownBits();
     return c;
   }
   
@@ -756,6 +910,8 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e, unsigned o, Width w) {
     ref<Expr> r(new ExtractExpr(e, o, w));
     r->computeHash();
+    r->computeDepth();
+    r->computeKnownBits();
     return r;
   }
   
@@ -807,6 +963,8 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e) {
     ref<Expr> r(new NotExpr(e));
     r->computeHash();
+    r->computeDepth();
+    r->computeKnownBits();
     return r;
   }
   
@@ -884,6 +1042,8 @@ public:                                                          \
     static ref<Expr> alloc(const ref<Expr> &e, Width w) {        \
       ref<Expr> r(new _class_kind ## Expr(e, w));                \
       r->computeHash();                                          \
+      r->computeDepth();                                         \
+      r->computeKnownBits();                                     \
       return r;                                                  \
     }                                                            \
     static ref<Expr> create(const ref<Expr> &e, Width w);        \
@@ -917,6 +1077,8 @@ CAST_EXPR_CLASS(ZExt)
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
+      res->computeDepth();                                                     \
+      res->computeKnownBits();                                                 \
       return res;                                                              \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
@@ -966,6 +1128,8 @@ ARITHMETIC_EXPR_CLASS(AShr)
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
+      res->computeDepth();                                                     \
+      res->computeKnownBits();                                                 \
       return res;                                                              \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
@@ -1007,7 +1171,7 @@ public:
 private:
   llvm::APInt value;
 
-  ConstantExpr(const llvm::APInt &v) : value(v) {}
+  ConstantExpr(const llvm::APInt &v) : value(v) { computeKnownBits(); }
 
 public:
   ~ConstantExpr() {}
@@ -1068,12 +1232,26 @@ public:
   static ref<Expr> fromMemory(void *address, Width w);
   void toMemory(void *address);
 
-  static ref<ConstantExpr> alloc(const llvm::APInt &v) {
+private:
+  /// Constants of at most 64 bits below this value are interned: every
+  /// alloc of such a constant returns the same node.
+  static const uint64_t InternedValues = 256;
+
+  static ref<ConstantExpr> allocInterned(uint64_t v, Width w);
+
+  static ref<ConstantExpr> allocNew(const llvm::APInt &v) {
     ref<ConstantExpr> r(new ConstantExpr(v));
     r->computeHash();
     return r;
   }
 
+public:
+  static ref<ConstantExpr> alloc(const llvm::APInt &v) {
+    if (v.getBitWidth() <= 64 && v.getZExtValue() < InternedValues)
+      return allocInterned(v.getZExtValue(), v.getBitWidth());
+    return allocNew(v);
+  }
+
   static ref<ConstantExpr> alloc(const llvm::APFloat &f) {
     return alloc(f.bitcastToAPInt());
   }
@@ -1082,6 +1260,12 @@ public:
     return alloc(llvm::APInt(w, v));
   }
 
+  /// getTrue, getFalse - The Bool constants. Like every constant of at most
+  /// 64 bits below InternedValues they are unique, these are just kept at
+  /// hand.
+  static const ref<ConstantExpr> &getTrue();
+  static const ref<ConstantExpr> &getFalse();
+
   static ref<ConstantExpr> create(uint64_t v, Width w) {
 /*
 #ifndef NDEBUG
@@ -1104,14 +1288,10 @@ public:
   bool isOne() const { return getLimitedValue() == 1; }
 
   /// isTrue - Is this the true expression.
-  bool isTrue() const {
-    return (getWidth() == Expr::Bool && value.getBoolValue() == true);
-  }
+  bool isTrue() const { return this == getTrue().get(); }
 
   /// isFalse - Is this the false expression.
-  bool isFalse() const {
-    return (getWidth() == Expr::Bool && value.getBoolValue() == false);
-  }
+  bool isFalse() const { return this == getFalse().get(); }
 
   /// isAllOnes - Is this constant all ones.
   bool isAllOnes() const { return getAPValue().isAllOnesValue(); }
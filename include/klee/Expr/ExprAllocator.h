@@ -0,0 +1,44 @@
+//===-- ExprAllocator.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRALLOCATOR_H
+#define KLEE_EXPRALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace klee {
+
+  /// ExprAllocator - Slab allocation of expression and update nodes, which
+  /// are created and destroyed in large numbers. Memory objects, their
+  /// states and the nodes of immutable trees are allocated from it as well.
+  ///
+  /// Allocations are rounded up to a size class, and freed nodes are kept
+  /// on a free list of their class for reuse rather than returned to
+  /// malloc. Nodes are still freed one by one when their reference count
+  /// drops to zero; the slabs themselves are kept for the lifetime of the
+  /// process.
+  class ExprAllocator {
+  public:
+    /// Allocations above this size are passed on to operator new.
+    static const size_t MaxSize = 256;
+
+    static void *allocate(size_t size);
+    static void deallocate(void *p, size_t size);
+
+    /// Number of bytes of the slabs allocated.
+    static uint64_t getSlabBytes();
+
+    /// Number of bytes of the slabs taken by live nodes.
+    static uint64_t getUsedBytes();
+  };
+
+}
+
+#endif /* KLEE_EXPRALLOCATOR_H */
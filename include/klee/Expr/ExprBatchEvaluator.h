@@ -0,0 +1,84 @@
+//===-- ExprBatchEvaluator.h ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRBATCHEVALUATOR_H
+#define KLEE_EXPRBATCHEVALUATOR_H
+
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace klee {
+  class Assignment;
+
+  /// ExprBatchEvaluator - Evaluate a set of expressions under many
+  /// assignments at once.
+  ///
+  /// The expressions are compiled once into a flat list of instructions,
+  /// one register each. The registers hold the values of Lanes assignments
+  /// side by side, so every instruction is a loop over the lanes that the
+  /// compiler can vectorize; walking the expression tree is paid once per
+  /// batch instead of once per assignment.
+  ///
+  /// Only expressions of at most 64 bits are compiled. A lane that divides
+  /// by zero is not exact: ExprEvaluator leaves such a division
+  /// unevaluated, so its result has to come from Assignment::evaluate.
+  class ExprBatchEvaluator {
+  public:
+    enum { Lanes = 16 };
+
+  private:
+    struct Instruction {
+      unsigned op;
+      Expr::Width width;
+      // operand registers
+      unsigned a, b, c;
+      // constant value, extract offset or operand width
+      uint64_t imm;
+      const Array *array;
+    };
+
+    std::vector<ref<Expr> > exprs;
+    std::vector<Instruction> program;
+    /// The register holding the value of each expression.
+    std::vector<unsigned> results;
+    bool compiled;
+
+    unsigned compile(const ref<Expr> &e, ExprHashMap<unsigned> &registers);
+    unsigned emit(const Instruction &instruction);
+    void run(const Assignment *const *assignments, unsigned count,
+             uint64_t *registers, bool *inexact) const;
+
+  public:
+    explicit ExprBatchEvaluator(const std::vector<ref<Expr> > &exprs);
+    ~ExprBatchEvaluator();
+
+    /// isCompiled - Whether all expressions could be compiled; evaluate()
+    /// must not be used otherwise.
+    bool isCompiled() const { return compiled; }
+
+    /// evaluate - Compute the value of every expression under every
+    /// assignment: \arg values[i][j] is the value of expression j under
+    /// assignment i, meaningful only if \arg exact[i].
+    void evaluate(const std::vector<const Assignment *> &assignments,
+                  std::vector<std::vector<uint64_t> > &values,
+                  std::vector<bool> &exact) const;
+
+    /// findSatisfying - Find the first assignment under which all (boolean)
+    /// expressions are true.
+    ///
+    /// \return The index of that assignment, or -1 if there is none.
+    int findSatisfying(const std::vector<const Assignment *> &assignments) const;
+  };
+
+}
+
+#endif /* KLEE_EXPRBATCHEVALUATOR_H */
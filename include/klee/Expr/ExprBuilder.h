@@ -61,9 +61,9 @@ namespace klee {
 
     // Utility functions
 
-    ref<Expr> False() { return ConstantExpr::alloc(0, Expr::Bool); }
+    ref<Expr> False() { return ConstantExpr::getFalse(); }
 
-    ref<Expr> True() { return ConstantExpr::alloc(1, Expr::Bool); }
+    ref<Expr> True() { return ConstantExpr::getTrue(); }
 
     ref<Expr> Constant(uint64_t Value, Expr::Width W) {
       return Constant(llvm::APInt(W, Value));
@@ -74,6 +74,19 @@ namespace klee {
   /// folding.
   ExprBuilder *createDefaultExprBuilder();
 
+  /// createCanonicalExprBuilder - Create an expression builder which builds
+  /// expressions with the static create functions of the expression classes,
+  /// which fold them into the canonical form of the rest of KLEE.
+  ExprBuilder *createCanonicalExprBuilder();
+
+  /// createHashConsingExprBuilder - Create an expression builder which
+  /// returns a single shared node for structurally equal expressions, so
+  /// they can be compared by pointer. Use it as the innermost builder of a
+  /// chain to share all subexpressions.
+  ///
+  /// Base - The base builder to use when constructing expressions.
+  ExprBuilder *createHashConsingExprBuilder(ExprBuilder *Base);
+
   /// createConstantFoldingExprBuilder - Create an expression builder which
   /// folds constant expressions.
   ///
@@ -125,10 +125,18 @@ T ExprRangeEvaluator<T>::evaluate(const ref<Expr> &e) {
     const Expr *ep = e.get();
     T res(0);
     for (unsigned i=0; i<ep->getNumKids(); i++)
-      res = res.concat(evaluate(ep->getKid(i)),8);
+      res = res.concat(evaluate(ep->getKid(i)), ep->getKid(i)->getWidth());
     return res;
   }
 
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    return evaluate(ee->expr).extract(ee->offset, ee->offset + ee->width);
+  }
+
+  case Expr::ZExt:
+    return evaluate(cast<ZExtExpr>(e)->src);
+
     // Arithmetic
 
   case Expr::Add: {
@@ -182,15 +190,21 @@ T ExprRangeEvaluator<T>::evaluate(const ref<Expr> &e) {
     return evaluate(be->left).binaryXor(evaluate(be->right));
   }
   case Expr::Shl: {
-    //    BinaryExpr *be = cast<BinaryExpr>(e);
-    //    unsigned width = be->left->getWidth();
-    //    return evaluate(be->left).shl(evaluate(be->right), width);
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    unsigned width = be->left->getWidth();
+    T shift = evaluate(be->right);
+    if (shift.isFixed() && shift.min() < width) {
+      T left = evaluate(be->left);
+      if (left.max() <= bits64::maxValueOfNBits(width) >> shift.min())
+        return left.binaryShiftLeft(shift.min());
+    }
     break;
   }
   case Expr::LShr: {
-    //    BinaryExpr *be = cast<BinaryExpr>(e);
-    //    unsigned width = be->left->getWidth();
-    //    return evaluate(be->left).lshr(evaluate(be->right), width);
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    T shift = evaluate(be->right);
+    if (shift.isFixed() && shift.min() < be->left->getWidth())
+      return evaluate(be->left).binaryShiftRight(shift.min());
     break;
   }
   case Expr::AShr: {
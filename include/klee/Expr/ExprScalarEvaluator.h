@@ -0,0 +1,64 @@
+//===-- ExprScalarEvaluator.h -----------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRSCALAREVALUATOR_H
+#define KLEE_EXPRSCALAREVALUATOR_H
+
+#include "klee/Expr/Expr.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <cstdint>
+
+namespace klee {
+  class Assignment;
+
+  /// ExprScalarEvaluator - Evaluate expressions of at most 64 bits under an
+  /// assignment on plain integers.
+  ///
+  /// Unlike AssignmentEvaluator, which rebuilds every node it visits into a
+  /// new ConstantExpr, this computes on uint64_t values and dispatches on
+  /// the kind of each node, with the arithmetic specialized for the common
+  /// widths. The value of every node is remembered, so subexpressions shared
+  /// within and across the expressions evaluated are computed once; the
+  /// expressions must therefore outlive the evaluator.
+  ///
+  /// An expression that is wider than 64 bits, or depends on a division by
+  /// zero (which ExprEvaluator leaves unevaluated), is not evaluated, and its
+  /// value has to come from Assignment::evaluate.
+  class ExprScalarEvaluator {
+    const Assignment &assignment;
+    llvm::SmallDenseMap<const Expr *, uint64_t, 32> values;
+
+    bool evaluateNode(const Expr &e, uint64_t &value);
+    bool evaluateRead(const ReadExpr &re, uint64_t &value);
+
+  public:
+    explicit ExprScalarEvaluator(const Assignment &assignment)
+        : assignment(assignment) {}
+
+    /// evaluate - Compute the value of \arg e under the assignment.
+    ///
+    /// \return false if the value could not be computed here.
+    bool evaluate(const ref<Expr> &e, uint64_t &value) {
+      return evaluateNode(*e, value);
+    }
+
+    /// evaluateBinary - Compute the binary operation \arg kind on the values
+    /// \arg l and \arg r of width \arg width, with the result ConstantExpr
+    /// would give. ConstantExpr folds its constants through this too.
+    ///
+    /// \return false for a division by zero or a width above 64 bits.
+    static bool evaluateBinary(Expr::Kind kind, Expr::Width width, uint64_t l,
+                               uint64_t r, uint64_t &result);
+  };
+
+}
+
+#endif /* KLEE_EXPRSCALAREVALUATOR_H */
@@ -0,0 +1,101 @@
+//===-- ExprSerializer.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRSERIALIZER_H
+#define KLEE_EXPRSERIALIZER_H
+
+#include "klee/Expr/Expr.h"
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+  class ArrayCache;
+
+  /// ExprWriter - Write expressions and update lists to a binary stream,
+  /// keeping the sharing between them: every node is written once and
+  /// referred to by its number afterwards.
+  ///
+  /// Integers are written as variable-length quantities, seven bits to a
+  /// byte, so that the small numbers that make most of the data (node
+  /// numbers, kinds, widths and constants) take a byte or two.
+  ///
+  /// By default arrays are written as their address, so the data can only
+  /// be read back by the process that wrote it, while the arrays are still
+  /// alive (they are owned by an ArrayCache). When arrays are defined, each
+  /// is written in full once (name, size, domain, range and constant
+  /// values) and by its number afterwards, and the reader recreates it.
+  ///
+  /// The writer keeps a reference to every node and array it numbered, so
+  /// that one freed meanwhile cannot be mistaken for a new one at the same
+  /// address.
+  class ExprWriter {
+    std::ostream &os;
+    bool defineArrays;
+    std::unordered_map<const Expr *, uint64_t> exprIds;
+    std::unordered_map<const UpdateNode *, uint64_t> nodeIds;
+    std::unordered_map<const Array *, uint64_t> arrayIds;
+    std::vector<ref<Expr> > exprs;
+    std::vector<UpdateList> nodes;
+
+  public:
+    explicit ExprWriter(std::ostream &os, bool defineArrays = false)
+        : os(os), defineArrays(defineArrays) {}
+    ~ExprWriter() { clear(); }
+
+    void writeInt(uint64_t value);
+    void writeBytes(const void *data, size_t size);
+    void write(const ref<Expr> &e);
+    void write(const UpdateList &updates);
+    void write(const Array *array);
+
+    /// Number of expressions, update nodes and arrays numbered so far.
+    size_t getNumDefinitions() const {
+      return exprIds.size() + nodeIds.size() + arrayIds.size();
+    }
+
+    /// Forget everything numbered so far, so that it is written again in
+    /// full when it is used next. The reader has to be cleared at the same
+    /// point.
+    void clear();
+  };
+
+  /// ExprReader - Read back what an ExprWriter wrote, in the same order.
+  ///
+  /// Arrays written as definitions are created in \a arrayCache, which has
+  /// to be given exactly when the writer defined arrays.
+  class ExprReader {
+    std::istream &is;
+    ArrayCache *arrayCache;
+    std::vector<ref<Expr> > exprs;
+    // each list ends with the node of that number, keeping it alive
+    std::vector<UpdateList> nodes;
+    std::vector<const Array *> arrays;
+
+  public:
+    explicit ExprReader(std::istream &is, ArrayCache *arrayCache = nullptr)
+        : is(is), arrayCache(arrayCache) {}
+    ~ExprReader() { clear(); }
+
+    uint64_t readInt();
+    void readBytes(void *data, size_t size);
+    ref<Expr> readExpr();
+    UpdateList readUpdateList();
+    const Array *readArray();
+
+    /// Forget everything read so far, where the writer was cleared.
+    void clear();
+  };
+
+}
+
+#endif /* KLEE_EXPRSERIALIZER_H */
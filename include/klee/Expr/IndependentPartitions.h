@@ -0,0 +1,90 @@
+//===-- IndependentPartitions.h ---------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_INDEPENDENTPARTITIONS_H
+#define KLEE_INDEPENDENTPARTITIONS_H
+
+#include "klee/Expr/Expr.h"
+#include "klee/Internal/ADT/ImmutableList.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+  /// IndependentPartitions - Split a list of constraints into groups that
+  /// share no symbolic bytes, one constraint at a time.
+  ///
+  /// The variables of a constraint are the bytes it reads at constant
+  /// indices, or the whole array for a read at a symbolic index. Adding a
+  /// constraint merges the partitions of its variables, relabeling the
+  /// variables of the smaller ones. All of the data is persistent, so a
+  /// copy (e.g. the one a forked state gets with its ConstraintManager)
+  /// costs nothing and the two copies share what they have in common.
+  class IndependentPartitions {
+  public:
+    /// The index standing for all the bytes of an array.
+    static const uint64_t WholeArray = ~uint64_t(0);
+
+    typedef std::pair<const Array *, uint64_t> Variable;
+
+    typedef std::vector<std::pair<unsigned, ref<Expr> > > ordered_ty;
+
+    struct Partition {
+      /// The constraints with their positions in the list they came from.
+      ImmutableList<std::pair<unsigned, ref<Expr> > > constraints;
+      /// The variables read by the constraints, each once.
+      ImmutableList<Variable> variables;
+      /// The constraints sorted by position, computed on the first use.
+      /// Shared partitions are never changed, so it stays valid for all
+      /// the queries against this version of the constraints.
+      mutable std::shared_ptr<const ordered_ty> ordered;
+
+      /// The constraints with their positions, in their original order.
+      const ordered_ty &getOrdered() const;
+
+      /// The constraints of the partition in their original order.
+      void getConstraints(std::vector<ref<Expr> > &result) const;
+    };
+
+    typedef ImmutableMap<unsigned, std::shared_ptr<const Partition> >
+        partitions_ty;
+
+  private:
+    /// The partition of every variable.
+    ImmutableMap<Variable, unsigned> owners;
+    partitions_ty partitions;
+    unsigned nextId = 0;
+
+    void getPartitionIds(const std::vector<Variable> &variables,
+                         std::vector<unsigned> &ids) const;
+
+  public:
+    /// Add the constraint at \arg position. Constraints without symbolic
+    /// reads are independent of everything and are not recorded.
+    void add(unsigned position, const ref<Expr> &e);
+
+    /// Collect the constraints that \arg e depends on, directly or through
+    /// other constraints, in their original order.
+    void getDependencies(const ref<Expr> &e,
+                         std::vector<ref<Expr> > &result) const;
+
+    const partitions_ty &getPartitions() const { return partitions; }
+
+    /// The variables of \arg e, sorted and without duplicates.
+    static void getVariables(const ref<Expr> &e,
+                             std::vector<Variable> &variables);
+  };
+
+}
+
+#endif /* KLEE_INDEPENDENTPARTITIONS_H */
@@ -10,6 +10,10 @@
 #ifndef KLEE_DISCRETEPDF_H
 #define KLEE_DISCRETEPDF_H
 
+#include <cstddef>
+#include <utility>
+#include <vector>
+
 namespace klee {
   template <class T>
   class DiscretePDF {
@@ -23,9 +27,17 @@ namespace klee {
     ~DiscretePDF();
 
     bool empty() const;
+    std::size_t size() const;
     void insert(T item, weight_type weight);
     void update(T item, weight_type newWeight);
     void remove(T item);
+
+    /* batched versions: large batches restructure the tree first and
+     * recompute the weight sums once, rather than once per item.
+     */
+    void insert(const std::vector<std::pair<T, weight_type> > &items);
+    void update(const std::vector<std::pair<T, weight_type> > &items);
+    void remove(const std::vector<T> &items);
     bool inTree(T item);
     weight_type getWeight(T item);
 	
@@ -37,8 +49,13 @@ namespace klee {
   private:
     class Node;
     Node *m_root;
+    std::size_t m_size;
     
     Node **lookup(T item, Node **parent_out);
+    Node *insertNode(T item, weight_type weight);
+    Node *removeNode(T item);
+    bool isBulk(std::size_t batchSize) const;
+    void setSums(Node *n);
     void split(Node *node);
     void rotate(Node *node);
     void lengthen(Node *node);
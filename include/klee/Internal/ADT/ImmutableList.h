@@ -0,0 +1,170 @@
+//===-- ImmutableList.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_IMMUTABLELIST_H
+#define KLEE_IMMUTABLELIST_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace klee {
+  /// Append-only list with O(1) copies. Elements live in chunks linked to
+  /// the chunk of the list they were copied from; a list appends in place
+  /// only while it is the sole owner of its last chunk, otherwise it
+  /// starts a new chunk on top of the shared prefix.
+  template<class T>
+  class ImmutableList {
+    struct Node {
+      std::shared_ptr<Node> prev;
+      // number of elements in all previous chunks
+      size_t base;
+      std::vector<T> values;
+
+      Node(std::shared_ptr<Node> prev, size_t base)
+        : prev(std::move(prev)), base(base) {}
+
+      // release long chains iteratively rather than recursively
+      ~Node() {
+        std::shared_ptr<Node> p = std::move(prev);
+        while (p && p.use_count() == 1) {
+          std::shared_ptr<Node> next = std::move(p->prev);
+          p = std::move(next);
+        }
+      }
+    };
+
+    std::shared_ptr<Node> tail;
+
+    Node &getWriteableTail() {
+      if (!tail || tail.use_count() != 1) {
+        size_t base = size();
+        tail = std::make_shared<Node>(std::move(tail), base);
+      }
+      return *tail;
+    }
+
+  public:
+    typedef T value_type;
+
+    class const_iterator {
+      friend class ImmutableList;
+
+      // chunks from the oldest to the newest one
+      std::shared_ptr<std::vector<const Node *> > chain;
+      size_t node = 0, elem = 0, pos;
+
+      explicit const_iterator(size_t pos) : pos(pos) {}
+
+    public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef T value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const T *pointer;
+      typedef const T &reference;
+
+      reference operator*() const { return (*chain)[node]->values[elem]; }
+      pointer operator->() const { return &**this; }
+
+      const_iterator &operator++() {
+        ++pos;
+        if (++elem == (*chain)[node]->values.size()) {
+          elem = 0;
+          // skip chunks that did not get any element
+          while (++node < chain->size() && (*chain)[node]->values.empty())
+            ;
+        }
+        return *this;
+      }
+      const_iterator operator++(int) {
+        const_iterator tmp(*this);
+        ++*this;
+        return tmp;
+      }
+
+      bool operator==(const const_iterator &b) const { return pos == b.pos; }
+      bool operator!=(const const_iterator &b) const { return pos != b.pos; }
+    };
+    typedef const_iterator iterator;
+
+    ImmutableList() {}
+    ImmutableList(const ImmutableList &b) : tail(b.tail) {}
+    ImmutableList &operator=(const ImmutableList &b) {
+      tail = b.tail;
+      return *this;
+    }
+
+    size_t size() const { return tail ? tail->base + tail->values.size() : 0; }
+    bool empty() const { return size() == 0; }
+
+    void push_back(const T &value) { getWriteableTail().values.push_back(value); }
+
+    template<class... Args>
+    T &emplace_back(Args &&... args) {
+      Node &n = getWriteableTail();
+      n.values.emplace_back(std::forward<Args>(args)...);
+      return n.values.back();
+    }
+
+    /// The last element may be modified only until the list is copied.
+    T &back() {
+      assert(!empty() && tail.use_count() == 1 && "modifying a shared element");
+      return tail->values.back();
+    }
+    const T &back() const {
+      assert(!empty());
+      const Node *n = tail.get();
+      while (n->values.empty())
+        n = n->prev.get();
+      return n->values.back();
+    }
+
+    /// Random access walks the chunks backwards, prefer iteration.
+    const T &operator[](size_t i) const {
+      assert(i < size() && "index out of bounds");
+      const Node *n = tail.get();
+      while (i < n->base)
+        n = n->prev.get();
+      return n->values[i - n->base];
+    }
+
+    const_iterator begin() const {
+      const_iterator it(0);
+      if (empty())
+        return it;
+      it.chain = std::make_shared<std::vector<const Node *> >();
+      for (const Node *n = tail.get(); n; n = n->prev.get())
+        it.chain->push_back(n);
+      std::reverse(it.chain->begin(), it.chain->end());
+      while (it.chain->at(it.node)->values.empty())
+        ++it.node;
+      return it;
+    }
+    const_iterator end() const { return const_iterator(size()); }
+
+    bool operator==(const ImmutableList &b) const {
+      if (tail == b.tail)
+        return true;
+      if (size() != b.size())
+        return false;
+      for (const_iterator i = begin(), j = b.begin(), e = end(); i != e; ++i, ++j)
+        if (!(*i == *j))
+          return false;
+      return true;
+    }
+    bool operator!=(const ImmutableList &b) const { return !(*this == b); }
+  };
+
+}
+
+#endif /* KLEE_IMMUTABLELIST_H */
@@ -70,9 +70,17 @@ namespace klee {
     ImmutableMap replace(const value_type &value) const { 
       return elts.replace(value); 
     }
+    template <class InputIterator>
+    ImmutableMap replaceMany(InputIterator begin, InputIterator end) const {
+      return elts.replaceMany(begin, end);
+    }
     ImmutableMap remove(const key_type &key) const { 
       return elts.remove(key); 
     }
+    /// See ImmutableTree::diff().
+    template <class F> bool diff(const ImmutableMap &b, F f) const {
+      return elts.diff(b.elts, f);
+    }
     ImmutableMap popMin(const value_type &valueOut) const { 
       return elts.popMin(valueOut); 
     }
@@ -0,0 +1,227 @@
+//===-- ImmutableRadixMap.h -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_IMMUTABLERADIXMAP_H
+#define KLEE_IMMUTABLERADIXMAP_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+namespace klee {
+  /// A persistent map from integer keys to values, laid out as a radix trie
+  /// of fixed fan-out. A lookup takes one step per 5 bits of the largest key
+  /// and an update copies only the nodes on the path to its key, so copies
+  /// of the map share all other nodes. It suits densely allocated keys such
+  /// as segments, unlike ImmutableMap it does not support ordered
+  /// iteration.
+  template<class D>
+  class ImmutableRadixMap {
+  public:
+    typedef uint64_t key_type;
+    typedef D data_type;
+
+  private:
+    static const unsigned Bits = 5;
+    static const unsigned Fanout = 1u << Bits;
+    static const unsigned Mask = Fanout - 1;
+
+    struct Node {
+      unsigned refCount;
+      /// Which children (or values, in leaves) are set.
+      uint32_t present;
+
+      Node() : refCount(0), present(0) {}
+      bool has(unsigned i) const { return present & (1u << i); }
+    };
+
+    struct Inner : Node {
+      Node *children[Fanout];
+    };
+
+    struct Leaf : Node {
+      D values[Fanout];
+    };
+
+    Node *root;
+    /// The root spans the keys below Fanout << shift; leaves have shift 0.
+    unsigned shift;
+    size_t numElements;
+
+    static void retain(Node *n) {
+      if (n)
+        ++n->refCount;
+    }
+
+    static void release(Node *n, unsigned s) {
+      if (!n || --n->refCount)
+        return;
+      if (s == 0) {
+        delete static_cast<Leaf *>(n);
+        return;
+      }
+      Inner *inner = static_cast<Inner *>(n);
+      for (unsigned i = 0; i != Fanout; ++i)
+        if (inner->has(i))
+          release(inner->children[i], s - Bits);
+      delete inner;
+    }
+
+    /// Whether \a key lies below a node at shift \a s.
+    static bool fits(key_type key, unsigned s) {
+      return s + Bits >= 64 || (key >> (s + Bits)) == 0;
+    }
+
+    /// Return a copy of \a n (or a new node, if null) with \a key bound to
+    /// \a value.
+    static Node *set(const Node *n, unsigned s, key_type key,
+                     const D &value, bool &added) {
+      unsigned i = (key >> s) & Mask;
+      if (s == 0) {
+        Leaf *leaf = n ? new Leaf(*static_cast<const Leaf *>(n)) : new Leaf();
+        leaf->refCount = 0;
+        added = !leaf->has(i);
+        leaf->present |= 1u << i;
+        leaf->values[i] = value;
+        return leaf;
+      }
+
+      Inner *inner = n ? copy(static_cast<const Inner *>(n)) : newInner();
+      Node *old = inner->has(i) ? inner->children[i] : nullptr;
+      Node *child = set(old, s - Bits, key, value, added);
+      retain(child);
+      release(old, s - Bits);
+      inner->children[i] = child;
+      inner->present |= 1u << i;
+      return inner;
+    }
+
+    /// Return a copy of \a n without \a key, or null if nothing is left.
+    static Node *erase(const Node *n, unsigned s, key_type key) {
+      unsigned i = (key >> s) & Mask;
+      if (s == 0) {
+        Leaf *leaf = new Leaf(*static_cast<const Leaf *>(n));
+        leaf->refCount = 0;
+        leaf->present &= ~(1u << i);
+        leaf->values[i] = D();
+        if (!leaf->present) {
+          delete leaf;
+          return nullptr;
+        }
+        return leaf;
+      }
+
+      Inner *inner = copy(static_cast<const Inner *>(n));
+      Node *old = inner->children[i];
+      Node *child = erase(old, s - Bits, key);
+      retain(child);
+      release(old, s - Bits);
+      if (child) {
+        inner->children[i] = child;
+      } else {
+        inner->present &= ~(1u << i);
+        if (!inner->present) {
+          delete inner;
+          return nullptr;
+        }
+      }
+      return inner;
+    }
+
+    static Inner *newInner() {
+      Inner *inner = new Inner();
+      for (unsigned i = 0; i != Fanout; ++i)
+        inner->children[i] = nullptr;
+      return inner;
+    }
+
+    static Inner *copy(const Inner *n) {
+      Inner *inner = new Inner(*n);
+      inner->refCount = 0;
+      for (unsigned i = 0; i != Fanout; ++i)
+        if (inner->has(i))
+          retain(inner->children[i]);
+      return inner;
+    }
+
+    ImmutableRadixMap(Node *_root, unsigned _shift, size_t _numElements)
+        : root(_root), shift(_shift), numElements(_numElements) {
+      retain(root);
+    }
+
+  public:
+    ImmutableRadixMap() : root(nullptr), shift(0), numElements(0) {}
+    ImmutableRadixMap(const ImmutableRadixMap &b)
+        : root(b.root), shift(b.shift), numElements(b.numElements) {
+      retain(root);
+    }
+    ~ImmutableRadixMap() { release(root, shift); }
+
+    ImmutableRadixMap &operator=(const ImmutableRadixMap &b) {
+      retain(b.root);
+      release(root, shift);
+      root = b.root;
+      shift = b.shift;
+      numElements = b.numElements;
+      return *this;
+    }
+
+    bool empty() const { return numElements == 0; }
+    size_t size() const { return numElements; }
+
+    const D *lookup(key_type key) const {
+      if (!root || !fits(key, shift))
+        return nullptr;
+      const Node *n = root;
+      for (unsigned s = shift; s != 0; s -= Bits) {
+        unsigned i = (key >> s) & Mask;
+        if (!n->has(i))
+          return nullptr;
+        n = static_cast<const Inner *>(n)->children[i];
+      }
+      unsigned i = key & Mask;
+      return n->has(i) ? &static_cast<const Leaf *>(n)->values[i] : nullptr;
+    }
+
+    size_t count(key_type key) const { return lookup(key) ? 1 : 0; }
+
+    /// Bind \a key to \a value, replacing any previous binding.
+    ImmutableRadixMap replace(key_type key, const D &value) const {
+      Node *top = root;
+      unsigned s = shift;
+      retain(top);
+      // grow upwards until the key fits below the root
+      while (!fits(key, s)) {
+        s += Bits;
+        if (!top)
+          continue;
+        Inner *inner = newInner();
+        inner->children[0] = top;
+        inner->present = 1;
+        retain(inner);
+        top = inner;
+      }
+
+      bool added = false;
+      Node *n = set(top, s, key, value, added);
+      ImmutableRadixMap result(n, s, numElements + (added ? 1 : 0));
+      release(top, s);
+      return result;
+    }
+
+    ImmutableRadixMap remove(key_type key) const {
+      if (!lookup(key))
+        return *this;
+      Node *n = erase(root, shift, key);
+      return ImmutableRadixMap(n, n ? shift : 0, numElements - 1);
+    }
+  };
+}
+
+#endif /* KLEE_IMMUTABLERADIXMAP_H */
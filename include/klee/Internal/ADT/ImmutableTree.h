@@ -10,6 +10,9 @@
 #ifndef KLEE_IMMUTABLETREE_H
 #define KLEE_IMMUTABLETREE_H
 
+#include "klee/Expr/ExprAllocator.h"
+
+#include <algorithm>
 #include <cassert>
 #include <vector>
 
@@ -47,7 +50,20 @@ namespace klee {
 
     ImmutableTree insert(const value_type &value) const;
     ImmutableTree replace(const value_type &value) const;
+    /// Replace or insert all of \p values at once. The paths to the keys
+    /// already present are copied once for all of them, where separate
+    /// replace() calls would copy their common part again for each.
+    /// Of several values for the same key, the last one is kept.
+    template <class InputIterator>
+    ImmutableTree replaceMany(InputIterator begin, InputIterator end) const;
     ImmutableTree remove(const key_type &key) const;
+    /// Call \p f(a, b) in key order on the values of this tree and of \p b
+    /// which may differ, with a null \p a or \p b for a key missing from
+    /// the tree. Subtrees both trees share are skipped without visiting
+    /// them, so trees derived from each other are compared in time
+    /// proportional to the paths they copied. Stops, returning false, as
+    /// soon as \p f does.
+    template <class F> bool diff(const ImmutableTree &b, F f) const;
     ImmutableTree popMin(value_type &valueOut) const;
     ImmutableTree popMax(value_type &valueOut) const;
 
@@ -85,6 +101,15 @@ namespace klee {
     Node(Node *_left, Node *_right, const value_type &_value);
     ~Node();
 
+    // trees are path-copied on every update, their nodes come and go in
+    // large numbers like those of expressions
+    static void *operator new(size_t size) {
+      return ExprAllocator::allocate(size);
+    }
+    static void operator delete(void *p, size_t size) {
+      ExprAllocator::deallocate(p, size);
+    }
+
     void decref();
     Node *incref();
 
@@ -95,6 +120,11 @@ namespace klee {
     Node *popMax(value_type &valueOut);
     Node *insert(const value_type &v);
     Node *replace(const value_type &v);
+    /// Replace the values in [\p begin, \p end), sorted by key, whose key
+    /// is present, keeping the shape of the tree, and append the others to
+    /// \p missing.
+    Node *replaceExisting(const value_type *begin, const value_type *end,
+                          std::vector<value_type> &missing);
     Node *remove(const key_type &k);
   };
 
@@ -394,6 +424,31 @@ namespace klee {
     }
   }
 
+  template<class K, class V, class KOV, class CMP>
+  typename ImmutableTree<K,V,KOV,CMP>::Node *
+  ImmutableTree<K,V,KOV,CMP>::Node::replaceExisting(
+      const value_type *begin, const value_type *end,
+      std::vector<value_type> &missing) {
+    if (begin == end)
+      return incref();
+    if (isTerminator()) {
+      missing.insert(missing.end(), begin, end);
+      return incref();
+    }
+
+    const key_type &key = key_of_value()(value);
+    const value_type *mid = begin;
+    while (mid != end && key_compare()(key_of_value()(*mid), key))
+      ++mid;
+    const value_type *upper = mid;
+    if (upper != end && !key_compare()(key, key_of_value()(*upper)))
+      ++upper;
+    // the shape does not change, so neither do the heights
+    return new Node(left->replaceExisting(begin, mid, missing),
+                    right->replaceExisting(upper, end, missing),
+                    mid != upper ? *mid : value);
+  }
+
   template<class K, class V, class KOV, class CMP>
   typename ImmutableTree<K,V,KOV,CMP>::Node *
   ImmutableTree<K,V,KOV,CMP>::Node::remove(const key_type &k) {
@@ -540,6 +595,118 @@ namespace klee {
     return ImmutableTree(node->replace(value)); 
   }
 
+  template<class K, class V, class KOV, class CMP>
+  template <class InputIterator>
+  ImmutableTree<K,V,KOV,CMP>
+  ImmutableTree<K,V,KOV,CMP>::replaceMany(InputIterator begin,
+                                          InputIterator end) const {
+    std::vector<value_type> values(begin, end);
+    if (values.empty())
+      return *this;
+    auto lessKey = [](const value_type &a, const value_type &b) {
+      return key_compare()(key_of_value()(a), key_of_value()(b));
+    };
+    // keep the last value of each key
+    std::stable_sort(values.begin(), values.end(), lessKey);
+    auto last = values.begin();
+    for (auto it = values.begin(); it != values.end(); ++it) {
+      if (lessKey(*last, *it))
+        ++last;
+      if (last != it)
+        *last = *it;
+    }
+    values.erase(last + 1, values.end());
+
+    std::vector<value_type> missing;
+    ImmutableTree result(node->replaceExisting(
+        values.data(), values.data() + values.size(), missing));
+    for (const value_type &value : missing)
+      result = result.replace(value);
+    return result;
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  template <class F>
+  bool ImmutableTree<K,V,KOV,CMP>::diff(const ImmutableTree &b, F f) const {
+    // The rest of each tree in key order, next last: subtrees still to
+    // expand, and nodes whose subtrees were expanded, standing for their
+    // value alone.
+    typedef std::pair<Node *, bool> Item;
+    std::vector<Item> as(1, Item(node, false)), bs(1, Item(b.node, false));
+    auto expand = [](std::vector<Item> &items) {
+      Node *n = items.back().first;
+      items.pop_back();
+      items.push_back(Item(n->right, false));
+      items.push_back(Item(n, true));
+      items.push_back(Item(n->left, false));
+    };
+    auto dropEmpty = [](std::vector<Item> &items) {
+      while (!items.empty() && !items.back().second &&
+             items.back().first->isTerminator())
+        items.pop_back();
+    };
+
+    for (;;) {
+      dropEmpty(as);
+      dropEmpty(bs);
+      if (as.empty() || bs.empty())
+        break;
+      Item a = as.back(), bi = bs.back();
+      if (!a.second && !bi.second) {
+        if (a.first == bi.first) {
+          as.pop_back();
+          bs.pop_back();
+        } else if (a.first->height >= bi.first->height) {
+          expand(as);
+        } else {
+          expand(bs);
+        }
+        continue;
+      }
+      if (!a.second) {
+        expand(as);
+        continue;
+      }
+      if (!bi.second) {
+        expand(bs);
+        continue;
+      }
+
+      const value_type &av = a.first->value, &bv = bi.first->value;
+      if (key_compare()(key_of_value()(av), key_of_value()(bv))) {
+        if (!f(&av, static_cast<const value_type *>(0)))
+          return false;
+        as.pop_back();
+      } else if (key_compare()(key_of_value()(bv), key_of_value()(av))) {
+        if (!f(static_cast<const value_type *>(0), &bv))
+          return false;
+        bs.pop_back();
+      } else {
+        if (!f(&av, &bv))
+          return false;
+        as.pop_back();
+        bs.pop_back();
+      }
+    }
+
+    // what is left is in one tree only
+    for (bool inA : {true, false}) {
+      std::vector<Item> &items = inA ? as : bs;
+      for (dropEmpty(items); !items.empty(); dropEmpty(items)) {
+        if (!items.back().second) {
+          expand(items);
+          continue;
+        }
+        const value_type *v = &items.back().first->value;
+        items.pop_back();
+        if (!(inA ? f(v, static_cast<const value_type *>(0))
+                  : f(static_cast<const value_type *>(0), v)))
+          return false;
+      }
+    }
+    return true;
+  }
+
   template<class K, class V, class KOV, class CMP>
   ImmutableTree<K,V,KOV,CMP> 
   ImmutableTree<K,V,KOV,CMP>::remove(const key_type &key) const { 
@@ -10,6 +10,8 @@
 #ifndef KLEE_KTEST_H
 #define KLEE_KTEST_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -48,12 +50,47 @@ extern "C" {
 
   /* returns 1 on success, 0 on (unspecified) error */
   int   kTest_toFile(KTest *, const char *path);
+
+  /* puts the .ktest file into a buffer to be released with free;
+     returns 1 on success, 0 on (unspecified) error */
+  int   kTest_toBuffer(KTest *, unsigned char **data, size_t *size);
   
   /* returns total number of object bytes */
   unsigned kTest_numBytes(KTest *);
 
   void  kTest_free(KTest *);
 
+  /* A ktest pack holds many tests in one file: a header and an index of
+     their names and extents, followed by the tests as they would be
+     written to .ktest files. */
+
+  /* return true iff file at path matches the ktest pack header */
+  int   kTest_isKTestPack(const char *path);
+
+  /* writes numTests tests, each under the matching name, to a pack;
+     returns 1 on success, 0 on (unspecified) error */
+  int   kTest_packToFile(KTest **tests, const char **names,
+                         unsigned numTests, const char *path);
+
+  /* A .ktest file or a ktest pack mapped into memory, read without
+     copying the object bytes. */
+  typedef struct KTestMap KTestMap;
+
+  /* returns NULL on (unspecified) error */
+  KTestMap *kTest_openMap(const char *path);
+
+  unsigned kTest_mapNumTests(const KTestMap *);
+
+  /* returns the name a test was packed under, or the path of a .ktest */
+  const char *kTest_mapName(const KTestMap *, unsigned index);
+
+  /* returns NULL if the test is malformed. The test is a view whose object
+     bytes point into the mapping: it stays valid until kTest_closeMap and
+     is not to be passed to kTest_free. */
+  KTest *kTest_mapGet(KTestMap *, unsigned index);
+
+  void  kTest_closeMap(KTestMap *);
+
 #ifdef __cplusplus
 }
 #endif
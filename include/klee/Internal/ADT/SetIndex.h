@@ -0,0 +1,167 @@
+//===-- SetIndex.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SETINDEX_H
+#define KLEE_SETINDEX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <set>
+#include <unordered_map>
+
+namespace klee {
+
+  /// Map from sets to values, answering subset and superset queries.
+  ///
+  /// Every set carries a 64-bit signature with one bit per element (chosen
+  /// by the hash of the element), so most candidates of a subset or
+  /// superset search are rejected with a single AND before their elements
+  /// are compared. Entries are kept in least recently used order, and the
+  /// oldest one is dropped when the index grows past its capacity.
+  template<class K, class V, class Hash = std::hash<K> >
+  class SetIndex {
+    struct Entry {
+      std::set<K> set;
+      uint64_t signature;
+      size_t hash;
+      V value;
+    };
+    // most recently used first
+    typedef std::list<Entry> entries_ty;
+
+    entries_ty entries;
+    std::unordered_multimap<size_t, typename entries_ty::iterator> byHash;
+    size_t capacity;
+    Hash hasher;
+
+    void computeKey(const std::set<K> &set, uint64_t &signature,
+                    size_t &hash) const {
+      signature = 0;
+      hash = set.size();
+      for (const K &element : set) {
+        uint64_t h = hasher(element);
+        signature |= uint64_t(1) << ((h * 0x9e3779b97f4a7c15ULL) >> 58);
+        hash = hash * 31 + h;
+      }
+    }
+
+    typename entries_ty::iterator find(const std::set<K> &set, size_t hash) {
+      auto range = byHash.equal_range(hash);
+      for (auto it = range.first; it != range.second; ++it)
+        if (it->second->set == set)
+          return it->second;
+      return entries.end();
+    }
+
+    V *touch(typename entries_ty::iterator it) {
+      entries.splice(entries.begin(), entries, it);
+      return &it->value;
+    }
+
+    void erase(typename entries_ty::iterator it) {
+      auto range = byHash.equal_range(it->hash);
+      for (auto bit = range.first; bit != range.second; ++bit) {
+        if (bit->second == it) {
+          byHash.erase(bit);
+          break;
+        }
+      }
+      entries.erase(it);
+    }
+
+  public:
+    /// \arg capacity - The maximum number of sets, 0 for no limit.
+    explicit SetIndex(size_t capacity = 0) : capacity(capacity) {}
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+
+    void clear() {
+      entries.clear();
+      byHash.clear();
+    }
+
+    /// Insert or replace the value for \arg set. If that drops the least
+    /// recently used set, its value is stored in \arg evicted.
+    /// \return True if a set was dropped.
+    bool insert(const std::set<K> &set, const V &value, V *evicted = 0) {
+      uint64_t signature;
+      size_t hash;
+      computeKey(set, signature, hash);
+
+      auto it = find(set, hash);
+      if (it != entries.end()) {
+        it->value = value;
+        touch(it);
+        return false;
+      }
+      entries.push_front(Entry{set, signature, hash, value});
+      byHash.insert(std::make_pair(hash, entries.begin()));
+
+      if (!capacity || entries.size() <= capacity)
+        return false;
+      auto last = std::prev(entries.end());
+      if (evicted)
+        *evicted = last->value;
+      erase(last);
+      return true;
+    }
+
+    /// \return The value for exactly \arg set, or null.
+    V *lookup(const std::set<K> &set) {
+      uint64_t signature;
+      size_t hash;
+      computeKey(set, signature, hash);
+      auto it = find(set, hash);
+      return it == entries.end() ? 0 : touch(it);
+    }
+
+    /// \return The value of the most recently used subset of \arg set whose
+    /// value satisfies \arg p, or null.
+    template<class Predicate>
+    V *findSubset(const std::set<K> &set, const Predicate &p) {
+      uint64_t signature;
+      size_t hash;
+      computeKey(set, signature, hash);
+      for (auto it = entries.begin(), ie = entries.end(); it != ie; ++it) {
+        if ((it->signature & ~signature) || it->set.size() > set.size())
+          continue;
+        if (std::includes(set.begin(), set.end(), it->set.begin(),
+                          it->set.end()) &&
+            p(it->value))
+          return touch(it);
+      }
+      return 0;
+    }
+
+    /// \return The value of the most recently used superset of \arg set
+    /// whose value satisfies \arg p, or null.
+    template<class Predicate>
+    V *findSuperset(const std::set<K> &set, const Predicate &p) {
+      uint64_t signature;
+      size_t hash;
+      computeKey(set, signature, hash);
+      for (auto it = entries.begin(), ie = entries.end(); it != ie; ++it) {
+        if ((signature & ~it->signature) || it->set.size() < set.size())
+          continue;
+        if (std::includes(it->set.begin(), it->set.end(), set.begin(),
+                          set.end()) &&
+            p(it->value))
+          return touch(it);
+      }
+      return 0;
+    }
+  };
+
+}
+
+#endif /* KLEE_SETINDEX_H */
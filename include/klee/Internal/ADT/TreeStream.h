@@ -10,6 +10,7 @@
 #ifndef KLEE_TREESTREAM_H
 #define KLEE_TREESTREAM_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -18,21 +19,32 @@ namespace klee {
   typedef unsigned TreeStreamID;
   class TreeOStream;
 
+  /// TreeStreamWriter - Write a tree of streams to a file, each stream
+  /// continuing the one it was opened from.
+  ///
+  /// Streams are sequences of bits, so that a branch takes one of them;
+  /// bytes are stored as eight bits each, least significant first. The
+  /// file is a sequence of records, each a varint stream id followed by a
+  /// varint tag: a fork, with the id of the new stream, or a run of bits
+  /// appended to the stream.
   class TreeStreamWriter {
     static const unsigned bufferSize = 4*4096;
 
     friend class TreeOStream;
 
   private:
-    char buffer[bufferSize];
-    unsigned lastID, bufferCount;
+    /// The bits of stream lastID not written yet
+    unsigned char buffer[bufferSize];
+    unsigned lastID, bufferBits;
 
     std::string path;
     std::ofstream *output;
     unsigned ids;
 
-    void write(TreeOStream &os, const char *s, unsigned size);
+    void write(TreeOStream &os, const unsigned char *bits, unsigned count);
+    void writeRecord(unsigned id, uint64_t tag);
     void flushBuffer();
+    void readBits(TreeStreamID id, std::vector<bool> &out);
 
   public:
     TreeStreamWriter(const std::string &_path);
@@ -48,6 +60,8 @@ namespace klee {
     // hack, to be replace by proper stream capabilities
     void readStream(TreeStreamID id,
                     std::vector<unsigned char> &out);
+    /// Read back a stream of branches written with TreeOStream::writeBranch
+    void readStream(TreeStreamID id, std::vector<bool> &out);
   };
 
   class TreeOStream {
@@ -69,6 +83,9 @@ namespace klee {
 
     TreeOStream &operator<<(const std::string &s);
 
+    /// Append a single bit for the direction of a branch
+    void writeBranch(bool taken);
+
     void flush();
   };
 }
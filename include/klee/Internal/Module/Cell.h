@@ -16,8 +16,12 @@ namespace klee {
   struct Cell : public KValue {
     Cell() {}
     Cell(const KValue &other) : KValue(other) {}
+    Cell(KValue &&other) : KValue(std::move(other)) {}
 
     Cell(const Cell &other) = default;
+    Cell(Cell &&other) = default;
+    Cell &operator=(const Cell &other) = default;
+    Cell &operator=(Cell &&other) = default;
   };
 }
 
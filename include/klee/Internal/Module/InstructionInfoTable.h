@@ -11,6 +11,7 @@
 #define KLEE_INSTRUCTIONINFOTABLE_H
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -29,6 +30,8 @@ namespace klee {
     const std::string &file;
     unsigned line;
     unsigned column;
+    /// The line in assembly.ll, valid once the table computed the assembly
+    /// lines, see InstructionInfoTable::computeAssemblyLines().
     unsigned assemblyLine;
 
   public:
@@ -43,6 +46,7 @@ namespace klee {
     unsigned id;
     const std::string &file;
     unsigned line;
+    /// The line in assembly.ll, see InstructionInfo::assemblyLine.
     uint64_t assemblyLine;
 
   public:
@@ -57,16 +61,22 @@ namespace klee {
   };
 
   class InstructionInfoTable {
+    const llvm::Module &module;
     std::unordered_map<const llvm::Instruction *,
                        std::unique_ptr<InstructionInfo>>
         infos;
     std::unordered_map<const llvm::Function *, std::unique_ptr<FunctionInfo>>
         functionInfos;
     std::vector<std::unique_ptr<std::string>> internedStrings;
+    mutable std::once_flag assemblyLinesComputed;
 
   public:
     InstructionInfoTable(const llvm::Module &m);
 
+    /// Fill in the assembly lines of all instructions and functions. Printing
+    /// the module for them takes a while, so it is only done on first use.
+    void computeAssemblyLines() const;
+
     unsigned getMaxID() const;
     const InstructionInfo &getInfo(const llvm::Instruction &) const;
     const FunctionInfo &getFunctionInfo(const llvm::Function &) const;
@@ -19,6 +19,7 @@
 #include <vector>
 
 namespace llvm {
+  class Function;
   class Instruction;
 }
 
@@ -42,6 +43,27 @@ namespace klee {
     /// Destination register index.
     unsigned dest;
 
+    /// The parts of the instruction the executor needs on every execution,
+    /// decoded once so that it does not go back to the LLVM IR for them.
+
+    /// The opcode of \ref inst.
+    unsigned opcode;
+    /// The predicate of a comparison, otherwise 0.
+    unsigned predicate;
+    /// The width in bits of the result, or 0 if it has no sized type.
+    unsigned width;
+    /// The number of lanes of an integer vector operation the executor
+    /// executes lane by lane, otherwise 0.
+    unsigned lanes;
+    /// The function a call calls directly, looking through aliases and
+    /// bitcasts, otherwise null.
+    llvm::Function *callee;
+    /// One more than the index of the special function handler of
+    /// \ref callee, or 0 if it has none, see SpecialFunctionHandler::bindCall.
+    unsigned specialFunction;
+    /// For a call of a scope marker, the alloca it marks, otherwise null.
+    KInstruction *scopeAlloca;
+
   public:
     virtual ~KInstruction();
     std::string getSourceLocation() const;
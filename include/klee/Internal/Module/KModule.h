@@ -18,6 +18,7 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 namespace llvm {
@@ -25,6 +26,7 @@ namespace llvm {
   class Constant;
   class Function;
   class Instruction;
+  class LoopInfo;
   class Module;
   class DataLayout;
 }
@@ -47,13 +49,17 @@ namespace klee {
     unsigned numInstructions;
     KInstruction **instructions;
 
-    std::map<llvm::BasicBlock*, unsigned> basicBlockEntry;
-    std::map<llvm::Instruction*,KInstruction*> instructionsMap;
+    std::unordered_map<llvm::BasicBlock*, unsigned> basicBlockEntry;
+    std::unordered_map<llvm::Instruction*,KInstruction*> instructionsMap;
 
     /// Whether instructions in this function should count as
     /// "coverable" for statistics and search heuristics.
     bool trackCoverage;
 
+  private:
+    /// Loops of the function, computed on first use.
+    std::unique_ptr<llvm::LoopInfo> loopInfo;
+
   public:
     explicit KFunction(llvm::Function*, KModule *);
     KFunction(const KFunction &) = delete;
@@ -63,6 +69,8 @@ namespace klee {
 
     unsigned getArgRegister(unsigned index) { return index; }
 
+    const llvm::LoopInfo &getLoopInfo();
+
     KInstruction *getKInstruction(llvm::Instruction *I) const {
         auto it = instructionsMap.find(I);
         assert(it != instructionsMap.end());
@@ -94,7 +102,7 @@ namespace klee {
 
     // Our shadow versions of LLVM structures.
     std::vector<std::unique_ptr<KFunction>> functions;
-    std::map<llvm::Function*, KFunction*> functionMap;
+    std::unordered_map<llvm::Function*, KFunction*> functionMap;
 
     // Functions which escape (may be called indirectly)
     // XXX change to KFunction
@@ -115,6 +123,9 @@ namespace klee {
     // Mark function with functionName as part of the KLEE runtime
     void addInternalFunction(const char* functionName);
 
+    // Mark the runtime check functions requested by opts as internal
+    void addInternalFunctions(const Interpreter::ModuleOptions &opts);
+
   public:
     KModule() = default;
 
@@ -148,6 +159,22 @@ namespace klee {
 
     void instrument(const Interpreter::ModuleOptions &opts);
 
+    /// Return the path under which the prepared form of the given input
+    /// modules is cached, or an empty string if caching is disabled.
+    std::string
+    getPreparedModulePath(const std::vector<std::unique_ptr<llvm::Module>> &modules,
+                          const Interpreter::ModuleOptions &opts);
+
+    /// Replace the module with a previously prepared one.  This stands in
+    /// for link(), instrument(), optimiseAndPrepare() and checkModule().
+    ///
+    /// @return false if no usable module is cached at path
+    bool loadPrepared(const std::string &path, llvm::LLVMContext &context,
+                      const Interpreter::ModuleOptions &opts);
+
+    /// Write the prepared module to path for later runs.
+    void storePrepared(const std::string &path);
+
     /// Return an id for the given constant, creating a new one if necessary.
     unsigned getConstantID(llvm::Constant *c, KInstruction* ki);
 
@@ -0,0 +1,64 @@
+//===-- ArchiveWriter.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_ARCHIVEWRITER_H
+#define KLEE_ARCHIVEWRITER_H
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace klee {
+
+/// ArchiveWriter - Collect files in a tar archive, gzip compressed if
+/// requested, which a thread of its own writes out.
+///
+/// Files are handed over as formatted archive members, so that they may
+/// be formatted where the archive is not at hand, e.g. in a forked
+/// process, and passed on as bytes.
+class ArchiveWriter {
+  std::unique_ptr<llvm::raw_ostream> file;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  std::deque<std::string> pending;
+  bool closing = false;
+
+  explicit ArchiveWriter(std::unique_ptr<llvm::raw_ostream> file);
+  void run();
+
+public:
+  /// Create the archive at \a path, return null and set \a error if that
+  /// fails.
+  static std::unique_ptr<ArchiveWriter>
+  create(const std::string &path, bool compress, std::string &error);
+
+  /// Write what is pending and the end of the archive.
+  ~ArchiveWriter();
+
+  ArchiveWriter(const ArchiveWriter &) = delete;
+  ArchiveWriter &operator=(const ArchiveWriter &) = delete;
+
+  /// Append the archive member for a file \a name with \a contents to
+  /// \a members.
+  static void appendMember(std::string &members, const std::string &name,
+                           const std::string &contents);
+
+  /// Add \a members, formatted by appendMember, to the archive.
+  void add(std::string members);
+};
+
+} // namespace klee
+
+#endif /* KLEE_ARCHIVEWRITER_H */
@@ -14,8 +14,12 @@
 
 #include "llvm/ADT/SmallVector.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 namespace klee {
 
@@ -69,26 +73,44 @@ namespace klee {
    * being invoked too often by defining a minimum invocation interval (MI).
    * All registered timer intervals should be larger than MI and also be multiples of MI.
    * Similar to Timer, a TimerGroup is _passive_ and needs to be `invoke`d by an external
-   * caller.
+   * caller. A thread started by `reset` counts the elapsed MIs, so an `invoke` between
+   * two of them costs an atomic load and a compare rather than reading the clock.
    */
   class TimerGroup {
     /// Registered timers.
     llvm::SmallVector<std::unique_ptr<Timer>, 4> timers;
-    /// Timer that invokes all registered timers after minimum interval.
-    Timer invocationTimer;
-    /// Time of last `invoke` call.
-    time::Point currentTime;
+    /// Minimum interval between invocations of the registered timers.
+    time::Span minInterval;
+    /// Number of minimum intervals elapsed, counted by the ticker thread.
+    std::atomic<std::uint64_t> ticks{0};
+    /// Value of `ticks` at the last invocation of the registered timers.
+    std::uint64_t seenTicks = 0;
+    /// Wall time the ticks are counted from.
+    time::Point start;
+    std::thread ticker;
+    std::mutex tickerMutex;
+    std::condition_variable tickerStop;
+    bool stopping = false;
+
+    void tick();
+    void stop();
   public:
     /// \param minInterval The minimum interval between invocations of registered timers.
     explicit TimerGroup(const time::Span &minInterval);
+    ~TimerGroup();
 
     /// Add a timer to be executed periodically.
     ///
     /// \param timer The timer object to register.
     void add(std::unique_ptr<Timer> timer);
     /// Invoke registered timers with current time only if minimum interval exceeded.
-    void invoke();
-    /// Reset all timers.
+    void invoke() {
+      if (ticks.load(std::memory_order_relaxed) != seenTicks)
+        invokeTimers();
+    }
+    /// Invoke registered timers with current time.
+    void invokeTimers();
+    /// Reset all timers and start counting minimum intervals.
     void reset();
   };
 
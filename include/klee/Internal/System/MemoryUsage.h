@@ -14,7 +14,11 @@
 
 namespace klee {
   namespace util {
+    /// Return the number of bytes allocated on the heap, as reported by
+    /// the allocator KLEE was built with.
     size_t GetTotalMallocUsage();
+    /// Return the name of the source of GetTotalMallocUsage().
+    const char *GetMallocImplementation();
   }
 }
 
@@ -36,6 +36,10 @@ namespace klee {
     /// Returns point in time using a monotonic steady clock
     Point getWallTime();
 
+    /// Returns point in time of the same clock as getWallTime(), but only as
+    /// precise as the scheduler tick (a few ms), which is cheaper to read
+    Point getCoarseWallTime();
+
     struct Point {
       using SteadyTimePoint = std::chrono::steady_clock::time_point;
 
@@ -47,6 +47,10 @@ public:
   virtual void processTestCase(const ExecutionState &state,
                                const char *err,
                                const char *suffix) = 0;
+
+  /// Append the paths of the .ktest files written since the last call to
+  /// \a paths; tests which do not go to files of their own are left out.
+  virtual void takeWrittenKTests(std::vector<std::string> &paths) {}
 };
 
 class Interpreter {
@@ -59,6 +63,10 @@ public:
     bool Optimize;
     bool CheckDivZero;
     bool CheckOvershift;
+    /// Further functions execution may start in, kept through the
+    /// optimizations and running the static constructors like the entry
+    /// point.
+    std::vector<std::string> ExtraEntryPoints;
 
     ModuleOptions(const std::string &_LibraryDir,
                   const std::string &_EntryPoint, bool _Optimize,
@@ -82,8 +90,13 @@ public:
     /// symbolic execution on concrete programs.
     unsigned MakeConcreteSymbolic;
 
+    /// Make the random choices of a state depend on its path only, so that
+    /// they do not change with the order the states run in.
+    bool DeterministicPaths;
+
     InterpreterOptions()
-      : MakeConcreteSymbolic(false)
+      : MakeConcreteSymbolic(false),
+        DeterministicPaths(false)
     {}
   };
 
@@ -154,6 +167,10 @@ public:
 
   virtual unsigned getSymbolicPathStreamID(const ExecutionState &state) = 0;
 
+  /// A hash of the sides \a state took at its forks, equal in every run
+  /// that explores the same path.
+  virtual uint64_t getPathId(const ExecutionState &state) = 0;
+
   virtual void getConstraintLog(const ExecutionState &state,
                                 std::string &res,
                                 LogType logFormat = STP) = 0;
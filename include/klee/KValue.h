@@ -11,9 +11,12 @@
 #define KVALUE_H
 
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprBuilder.h"
 
 #include "llvm/Support/raw_ostream.h"
 
+#include <utility>
+
 // Special segments. Memory allocated via alloca and on heap
 // will have segments that have so higher value.
 enum SpecialSegment {
@@ -34,24 +37,69 @@ namespace klee {
     ref<Expr> value;
     ref<Expr> pointerSegment;
 
+    /// Returns the (shared) VALUES_SEGMENT constant of the given width.
+    /// Plain values are by far the most common KValues, interning their
+    /// segment saves an allocation for each of them.
+    static ref<Expr> getValuesSegment(Expr::Width w) {
+      // never destroyed: KValues may still be released during static destruction
+      static ref<Expr> *segments = new ref<Expr>[MaxInternedWidth + 1];
+      if (w > MaxInternedWidth)
+        return ConstantExpr::alloc(VALUES_SEGMENT, w);
+      ref<Expr> &segment = segments[w];
+      if (segment.isNull())
+        segment = ConstantExpr::alloc(VALUES_SEGMENT, w);
+      return segment;
+    }
+
+    /// Returns the builder the operations on KValues create their
+    /// expressions with; by default the static create functions of the
+    /// expressions.
+    static ExprBuilder &getBuilder() { return *getBuilderSlot(); }
+
+    /// Sets the builder of the operations on KValues, taking ownership of it.
+    static void setBuilder(ExprBuilder *builder) {
+      delete getBuilderSlot();
+      getBuilderSlot() = builder;
+    }
+
+  private:
+    static const Expr::Width MaxInternedWidth = Expr::Int64;
+
+    static ExprBuilder *&getBuilderSlot() {
+      // never destroyed: KValues may still be built during static destruction
+      static ExprBuilder *builder = createCanonicalExprBuilder();
+      return builder;
+    }
+
+    static ref<Expr> getSpecialSegment(SpecialSegment segment, Expr::Width w) {
+      if (segment == VALUES_SEGMENT)
+        return getValuesSegment(w);
+      return ConstantExpr::alloc(segment, w);
+    }
+
   public:
     KValue() {}
-    KValue(const KValue &other) : value(other.value), pointerSegment(other.pointerSegment) {}
-    KValue(ref<Expr> value)
-      : value(value), pointerSegment(ConstantExpr::alloc(VALUES_SEGMENT, value->getWidth())) {}
-    KValue(ref<ConstantExpr> value)
-      : value(value), pointerSegment(ConstantExpr::alloc(VALUES_SEGMENT, value->getWidth())) {}
+    KValue(const KValue &other) = default;
+    KValue(KValue &&other) = default;
+    KValue(ref<Expr> val)
+      : value(std::move(val)),
+        pointerSegment(getValuesSegment(value->getWidth())) {}
+    KValue(ref<ConstantExpr> val)
+      : value(std::move(val)),
+        pointerSegment(getValuesSegment(value->getWidth())) {}
     KValue(ref<Expr> segment, ref<Expr> offset)
-      : value(offset), pointerSegment(segment) {}
+      : value(std::move(offset)), pointerSegment(std::move(segment)) {}
 
     KValue(SpecialSegment segment, ref<Expr> offset)
-      : value(offset), pointerSegment(ConstantExpr::alloc(segment, value->getWidth())) {}
+      : value(std::move(offset)),
+        pointerSegment(getSpecialSegment(segment, value->getWidth())) {}
 
     KValue& operator=(const KValue &other) = default;
+    KValue& operator=(KValue &&other) = default;
 
-    ref<Expr> getValue() const { return value; }
-    ref<Expr> getOffset() const { return value; }
-    ref<Expr> getSegment() const { return pointerSegment; }
+    const ref<Expr> &getValue() const { return value; }
+    const ref<Expr> &getOffset() const { return value; }
+    const ref<Expr> &getSegment() const { return pointerSegment; }
 
     /// Checks if both segment and offset are ConstantExpr and if yes, if they contain zero value
     bool isZero() const {
@@ -69,21 +117,33 @@ namespace klee {
     }
     
     KValue ZExt(Expr::Width w) const {
-      return KValue(ZExtExpr::create(pointerSegment, w),
-                    ZExtExpr::create(value, w));
+      return KValue(extendSegment(w, false), getBuilder().ZExt(value, w));
     }
 
     KValue SExt(Expr::Width w) const {
-      return KValue(SExtExpr::create(pointerSegment, w),
-                    SExtExpr::create(value, w));
+      return KValue(extendSegment(w, true), getBuilder().SExt(value, w));
     }
 
+  private:
+    /// The segment extended to \a w bits; plain values keep the interned
+    /// segment rather than getting a new constant.
+    ref<Expr> extendSegment(Expr::Width w, bool sign) const {
+      if (pointerSegment->getWidth() == w)
+        return pointerSegment;
+      ConstantExpr *CE = dyn_cast<ConstantExpr>(pointerSegment);
+      if (CE && CE->isZero())
+        return getValuesSegment(w);
+      return sign ? getBuilder().SExt(pointerSegment, w)
+                  : getBuilder().ZExt(pointerSegment, w);
+    }
+
+  public:
 #define _op_seg_different(op) \
      KValue op(const KValue &other) const { \
       if (getSegment().get()->isZero() && other.getSegment().get()->isZero()) { \
-        return KValue(op##Expr::create(value, other.value)); \
+        return KValue(getBuilder().op(value, other.value)); \
       } else { \
-        KValue retval = KValue(op##Expr::create(value, other.value)); \
+        KValue retval = KValue(getBuilder().op(value, other.value)); \
         if (getSegment().get()->isZero()) { \
           retval.pointerSegment = other.getSegment(); \
         } else { \
@@ -94,12 +154,12 @@ namespace klee {
     }
 #define _op_seg_same(op) \
     KValue op(const KValue &other) const { \
-      return KValue(op##Expr::create(pointerSegment, other.pointerSegment), \
-                    op##Expr::create(value, other.value)); \
+      return KValue(getBuilder().op(pointerSegment, other.pointerSegment), \
+                    getBuilder().op(value, other.value)); \
     }
 #define _op_seg_zero(op) \
     KValue op(const KValue &other) const { \
-      return KValue(op##Expr::create(value, other.value)); \
+      return KValue(getBuilder().op(value, other.value)); \
     }
 
     _op_seg_same(Concat);
@@ -108,8 +168,8 @@ namespace klee {
     _op_seg_same(Sub);
     KValue Mul(const KValue &other) const {
       // multiplying pointers doesn't make sense, but we must ensure that identity 1*x==x works
-      return KValue(AddExpr::create(pointerSegment, other.pointerSegment),
-                    MulExpr::create(value, other.value));
+      return KValue(getBuilder().Add(pointerSegment, other.pointerSegment),
+                    getBuilder().Mul(value, other.value));
     }
 
     _op_seg_different(And);
@@ -127,12 +187,12 @@ namespace klee {
 #define _op_seg_cmp_lexicographic(cmp) \
     KValue cmp(const KValue &other) const { \
       if (isa<ConstantExpr>(value) && isa<ConstantExpr>(other.value)) { \
-        return KValue(SelectExpr::create( \
-              EqExpr::create(pointerSegment, other.pointerSegment), \
-              cmp##Expr::create(value, other.value), \
-              cmp##Expr::create(pointerSegment, other.pointerSegment))); \
+        return KValue(getBuilder().Select( \
+              getBuilder().Eq(pointerSegment, other.pointerSegment), \
+              getBuilder().cmp(value, other.value), \
+              getBuilder().cmp(pointerSegment, other.pointerSegment))); \
       } else { \
-        return KValue(cmp##Expr::create(value, other.value)); \
+        return KValue(getBuilder().cmp(value, other.value)); \
       } \
     } \
 
@@ -146,29 +206,29 @@ namespace klee {
     _op_seg_cmp_lexicographic(Sle);
 
     KValue SymbCmp(const KValue &other) const {
-      return KValue(EqExpr::create(value, other.value));
+      return KValue(getBuilder().Eq(value, other.value));
     }
 
     KValue Eq(const KValue &other) const {
-      return KValue(AndExpr::create(
-                      EqExpr::create(pointerSegment, other.pointerSegment),
-                      EqExpr::create(value, other.value)));
+      return KValue(getBuilder().And(
+                      getBuilder().Eq(pointerSegment, other.pointerSegment),
+                      getBuilder().Eq(value, other.value)));
     }
 
     KValue Ne(const KValue &other) const {
-      return KValue(OrExpr::create(
-                      NeExpr::create(pointerSegment, other.pointerSegment),
-                      NeExpr::create(value, other.value)));
+      return KValue(getBuilder().Or(
+                      getBuilder().Ne(pointerSegment, other.pointerSegment),
+                      getBuilder().Ne(value, other.value)));
     }
 
     KValue Select(const KValue &b1, const KValue &b2) const {
-      return KValue(SelectExpr::create(value, b1.pointerSegment, b2.pointerSegment),
-                    SelectExpr::create(value, b1.value, b2.value));
+      return KValue(getBuilder().Select(value, b1.pointerSegment, b2.pointerSegment),
+                    getBuilder().Select(value, b1.value, b2.value));
     }
 
     KValue Extract(unsigned bitOff, Expr::Width width) const {
-      return KValue(ExtractExpr::create(pointerSegment, bitOff, width),
-                    ExtractExpr::create(value, bitOff, width));
+      return KValue(getBuilder().Extract(pointerSegment, bitOff, width),
+                    getBuilder().Extract(value, bitOff, width));
     }
 
     ref<Expr> createIsZero() const {
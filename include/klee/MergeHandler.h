@@ -64,6 +64,16 @@
  * possible) will be continued without waiting for the remaining states. When a
  * remaining state now enters a close-merge point, it will again wait for the
  * other states, or until the 'timeout' is reached.
+ *
+ * # Automatic Loop Merging
+ *
+ * With '-auto-merge-loops', the Executor opens a merge region whenever a
+ * state enters a loop through its header, and closes it when the state
+ * leaves the loop, without klee_open_merge() and klee_close_merge() calls.
+ * The states that forked inside the loop are merged at the exit block they
+ * leave through, unless they differ in more values than
+ * '-auto-merge-max-joins', in which case exploring them separately is
+ * expected to be cheaper than the queries over the joined values.
 */
 
 #ifndef KLEE_MERGEHANDLER_H
@@ -76,6 +86,7 @@
 
 namespace llvm {
 class Instruction;
+class Loop;
 }
 
 namespace klee {
@@ -87,6 +98,8 @@ extern llvm::cl::opt<bool> UseIncompleteMerge;
 
 extern llvm::cl::opt<bool> DebugLogIncompleteMerge;
 
+extern llvm::cl::opt<bool> AutoMergeLoops;
+
 class Executor;
 class ExecutionState;
 
@@ -119,8 +132,19 @@ private:
   std::map<llvm::Instruction *, std::vector<ExecutionState *> >
       reachedCloseMerge;
 
+  /// @brief For regions opened by '-auto-merge-loops', the loop and the
+  /// stack depth of the frame executing it; null for klee_open_merge
+  const llvm::Loop *loop;
+  size_t loopFrame;
+
 public:
 
+  /// @brief The loop the region was opened for, or null
+  const llvm::Loop *getLoop() const { return loop; }
+
+  /// @brief Stack depth of the frame executing getLoop()
+  size_t getLoopFrame() const { return loopFrame; }
+
   /// @brief Called when a state runs into a 'klee_close_merge()' call
   void addClosedState(ExecutionState *es, llvm::Instruction *mp);
 
@@ -149,7 +173,8 @@ public:
   unsigned refCount;
 
 
-  MergeHandler(Executor *_executor, ExecutionState *es);
+  MergeHandler(Executor *_executor, ExecutionState *es,
+               const llvm::Loop *_loop = nullptr);
   ~MergeHandler();
 };
 }
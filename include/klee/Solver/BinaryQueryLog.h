@@ -0,0 +1,102 @@
+//===-- BinaryQueryLog.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BINARYQUERYLOG_H
+#define KLEE_BINARYQUERYLOG_H
+
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprSerializer.h"
+#include "klee/Internal/System/Time.h"
+
+#include <cstdint>
+#include <istream>
+#include <sstream>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace klee {
+  class ArrayCache;
+
+  /// A query as logged in a binary query log, with the result the solver
+  /// gave for it.
+  struct LoggedQuery {
+    /// The SolverImpl operation the query was asked through.
+    enum Kind { Truth, Validity, Value, InitialValues };
+
+    Kind kind = Truth;
+    std::vector<ref<Expr> > constraints;
+    /// The query expression, or for a Value query the expression whose
+    /// value was asked for.
+    ref<Expr> expr;
+    /// The arrays whose values were asked for by an InitialValues query.
+    std::vector<const Array *> objects;
+
+    bool success = false;
+    /// If successful: whether a Truth query is valid, the Solver::Validity
+    /// of a Validity query, or whether an InitialValues query has a
+    /// solution.
+    int result = 0;
+    /// The value found by a Value query.
+    ref<Expr> value;
+    /// The values of \ref objects found by an InitialValues query.
+    std::vector<std::vector<unsigned char> > values;
+    /// The time the query took when it was logged.
+    time::Span elapsed;
+
+    static const char *getKindName(Kind kind);
+  };
+
+  /// BinaryQueryLogWriter - Write queries in the binary query log format.
+  ///
+  /// The format is a header followed by one record per query. The
+  /// expressions of all records are written through one ExprWriter, so a
+  /// node (or array) shared between queries, as the constraints of a path
+  /// are, is written once for the whole log rather than once per query.
+  /// To bound the memory kept for that, the tables are cleared once they
+  /// hold more than a million entries, which is recorded in the log.
+  class BinaryQueryLogWriter {
+    llvm::raw_ostream &os;
+    std::ostringstream buffer;
+    ExprWriter writer;
+
+  public:
+    explicit BinaryQueryLogWriter(llvm::raw_ostream &os);
+
+    /// Append \arg query to the log.
+    void write(const LoggedQuery &query);
+  };
+
+  /// BinaryQueryLogReader - Read back the queries of a binary query log.
+  class BinaryQueryLogReader {
+    std::istream &is;
+    ExprReader reader;
+    bool valid;
+
+  public:
+    /// Arrays are created in \arg arrayCache as they are defined.
+    BinaryQueryLogReader(std::istream &is, ArrayCache &arrayCache);
+
+    /// Whether the stream starts with the header of a binary query log.
+    bool isValid() const { return valid; }
+
+    /// Read the next query into \arg query.
+    /// \return false at the end of the log, or if it is truncated.
+    bool read(LoggedQuery &query);
+
+    /// Whether \arg data (of \arg size bytes, the start of a file) is the
+    /// start of a binary query log.
+    static bool hasHeader(const char *data, size_t size);
+  };
+
+}
+
+#endif /* KLEE_BINARYQUERYLOG_H */
@@ -0,0 +1,94 @@
+//===-- PersistentQueryCache.h ----------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PERSISTENTQUERYCACHE_H
+#define KLEE_PERSISTENTQUERYCACHE_H
+
+#include "klee/Expr/Expr.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+  class Assignment;
+
+  /// PersistentQueryCache - Solver results kept in a file across runs.
+  ///
+  /// Results are addressed by a canonical encoding of the expressions they
+  /// are about, in which arrays are numbered by first occurrence instead of
+  /// named, so the same query asked by another run (or another state)
+  /// finds them. The file is only ever appended to, under an exclusive
+  /// lock; readers map it and pick up the records added by other
+  /// processes without locking, as every record carries a checksum.
+  class PersistentQueryCache {
+  public:
+    /// The canonical form of a set of expressions.
+    class Key {
+      friend class PersistentQueryCache;
+
+      std::string bytes;
+      uint64_t hash;
+      /// The arrays of the expressions, by canonical number.
+      std::vector<const Array *> arrays;
+
+    public:
+      /// \arg kind - Separates the results of different users of the cache.
+      /// \arg exprs - The expressions, whose order does not matter.
+      /// \arg query - An optional expression kept apart from \arg exprs.
+      Key(char kind, const std::vector<ref<Expr> > &exprs,
+          const ref<Expr> &query = ref<Expr>());
+
+      const std::vector<const Array *> &getArrays() const { return arrays; }
+    };
+
+  private:
+    int fd;
+    const char *data;
+    size_t mappedSize;
+    /// The end of the last record read from the file.
+    size_t scanned;
+    /// The offsets of the records, oldest first, by key hash.
+    std::unordered_map<uint64_t, std::vector<size_t> > index;
+
+    explicit PersistentQueryCache(int fd);
+
+    void refresh();
+    bool find(const Key &key, std::string &value);
+
+  public:
+    ~PersistentQueryCache();
+
+    /// Open the cache named by -persistent-query-cache.
+    /// \return Null if there is none.
+    static std::unique_ptr<PersistentQueryCache> open();
+
+    /// Look up the newest value stored for \arg key.
+    bool lookup(const Key &key, std::string &value);
+
+    /// Store \arg value for \arg key, unless it is the current one.
+    void insert(const Key &key, const std::string &value);
+
+    /// Encode the bindings of the arrays of \arg key in \arg assignment (or
+    /// the absence of an assignment).
+    static std::string encodeAssignment(const Key &key,
+                                        const Assignment *assignment);
+
+    /// Decode what encodeAssignment stored for the arrays of \arg key;
+    /// \arg result is null if there was no assignment.
+    /// \return False if \arg value is not such an encoding.
+    static bool decodeAssignment(const Key &key, const std::string &value,
+                                 std::shared_ptr<const Assignment> &result);
+  };
+
+}
+
+#endif /* KLEE_PERSISTENTQUERYCACHE_H */
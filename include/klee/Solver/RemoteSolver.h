@@ -0,0 +1,53 @@
+//===-- RemoteSolver.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_REMOTESOLVER_H
+#define KLEE_REMOTESOLVER_H
+
+#include "klee/Internal/System/Time.h"
+#include "klee/Solver/Solver.h"
+
+#include <string>
+
+namespace klee {
+  class ArrayCache;
+
+  /// RemoteSolver - A complete solver which sends its queries to a solver
+  /// service (kleaver -serve) over TCP, so that the KLEE processes of a
+  /// cluster share its workers and their caches.
+  ///
+  /// A connection carries a binary query log each way: the client writes
+  /// each query as a record without a result, whose elapsed time is the
+  /// timeout to solve it in, and the service answers with a record holding
+  /// the result. As in a log, the expressions shared by the queries of a
+  /// connection are sent once.
+  class RemoteSolver : public Solver {
+  public:
+    /// RemoteSolver - Construct a new RemoteSolver.
+    ///
+    /// \param address - The service as host:port. The connection is opened
+    /// on the first query, and opened again after it fails.
+    RemoteSolver(const std::string &address);
+
+    /// setCoreSolverTimeout - Set constraint solver timeout delay to the
+    /// given value; 0 is off.
+    virtual void setCoreSolverTimeout(time::Span timeout);
+  };
+
+  /// Answer the queries of the RemoteSolver connected to \arg fd with
+  /// \arg solver until it disconnects, then close \arg fd.
+  ///
+  /// \param arrayCache - Where the arrays of the queries are created.
+  /// \param maxTimeout - The timeout of queries sent without one, or
+  /// longer; 0 is none.
+  void serveRemoteSolver(Solver *solver, ArrayCache &arrayCache, int fd,
+                         time::Span maxTimeout);
+}
+
+#endif /* KLEE_REMOTESOLVER_H */
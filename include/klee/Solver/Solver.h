@@ -143,6 +143,20 @@ namespace klee {
     /// \return True on success.
     bool mayBeTrue(const Query&, bool &result);
 
+    /// mayBeTrue - Determine for each of the expressions whether there is a
+    /// valid assignment for the constraints in which it evaluates to true.
+    ///
+    /// The expressions are asked together, so that the solvers can share
+    /// the work they do for the constraints.
+    ///
+    /// \param [out] results - On success, whether each expression may be
+    /// true.
+    ///
+    /// \return True on success.
+    bool mayBeTrue(const ConstraintManager &constraints,
+                   const std::vector<ref<Expr>> &exprs,
+                   std::vector<bool> &results);
+
     /// mayBeFalse - Determine if there is a valid assignment for the given
     /// state in which the expression evaluates to false.
     ///
@@ -200,14 +214,22 @@ namespace klee {
 
   /* *** */
 
-  /// createValidatingSolver - Create a solver which will validate all query
+  /// createValidatingSolver - Create a solver which will validate query
   /// results against an oracle, used for testing that an optimized solver has
-  /// the same results as an unoptimized one. This solver will assert on any
-  /// mismatches.
+  /// the same results as an unoptimized one. Mismatches are logged with the
+  /// query; when all queries are validated in place, the solver also asserts
+  /// on them.
   ///
   /// \param s - The primary underlying solver to use.
   /// \param oracle - The solver to check query results against.
-  Solver *createValidatingSolver(Solver *s, Solver *oracle);
+  /// \param rate - The percentage of the queries to validate.
+  /// \param cachedOnly - Only validate the queries \a s answered without
+  /// querying its core solver.
+  /// \param jobs - If not zero, validate in up to this many forked processes
+  /// without waiting for them, skipping the queries when all are busy.
+  Solver *createValidatingSolver(Solver *s, Solver *oracle,
+                                 unsigned rate = 100, bool cachedOnly = false,
+                                 unsigned jobs = 0);
 
   /// createAssignmentValidatingSolver - Create a solver that when requested
   /// for an assignment will check that the computed assignment satisfies
@@ -215,6 +237,14 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createAssignmentValidatingSolver(Solver *s);
 
+  /// createPreprocessingSolver - Create a solver which rewrites queries into
+  /// simpler, equivalent ones before passing them to the underlying solver.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param rewrites - The rewrites to apply, a bit set of
+  /// PreprocessingRewrite values.
+  Solver *createPreprocessingSolver(Solver *s, unsigned rewrites);
+
   /// createCachingSolver - Create a solver which will cache the queries in
   /// memory (without eviction).
   ///
@@ -229,6 +259,15 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createCexCachingSolver(Solver *s);
 
+  /// createUnsatCoreCachingSolver - Create a solver which records why the
+  /// queries the core solver finds infeasible are, and answers any later
+  /// query including such a reason without asking it. The reasons are kept
+  /// in memory (without eviction).
+  ///
+  /// \param s - The core solver, which has to support unsat cores (see
+  /// SolverImpl::enableUnsatCores()). If it does not, it is returned.
+  Solver *createUnsatCoreCachingSolver(Solver *s);
+
   /// createFastCexSolver - Create a "fast counterexample solver", which tries
   /// to quickly compute a satisfying assignment for a constraint set using
   /// value propogation and range analysis.
@@ -255,13 +294,54 @@ namespace klee {
                                     time::Span minQueryTimeToLog,
                                     bool logTimedOut);
 
+  /// createBinaryQueryLoggingSolver - Create a solver which will forward all
+  /// queries, writing them with their results to the given path in the
+  /// binary query log format (see BinaryQueryLog.h).
+  Solver *createBinaryQueryLoggingSolver(Solver *s, std::string path,
+                                         time::Span minQueryTimeToLog,
+                                         bool logTimedOut);
+
 
   /// createDummySolver - Create a dummy solver implementation which always
   /// fails.
   Solver *createDummySolver();
 
+  /// createPortfolioSolver - Create a solver which answers queries with the
+  /// backend that was fastest for similar queries before, and races all
+  /// \arg solvers (in child processes) on those that take it too long.
+  /// Takes ownership of the solvers.
+  Solver *createPortfolioSolver(const std::vector<Solver *> &solvers);
+
   // Create a solver based on the supplied ``CoreSolverType``.
   Solver *createCoreSolver(CoreSolverType cst);
+
+  /// The layers of the solver chain, from the core solver up, see
+  /// createProfilingSolver().
+  enum SolverLayer {
+    CoreSolverLayer,
+    UnsatCoreCacheLayer,
+    SolverQueryLoggingLayer,
+    AssignmentValidatingLayer,
+    FastCexLayer,
+    CexCacheLayer,
+    BranchCacheLayer,
+    PreprocessingLayer,
+    IndependentLayer,
+    ValidatingLayer,
+    QueryLoggingLayer,
+    NumSolverLayers
+  };
+
+  /// createProfilingSolver - Create a solver which forwards all queries to
+  /// \arg s, accounting them to \arg layer: how many there were, how many
+  /// \arg s passed on to the profiled layer below, how many it answered
+  /// itself and how long it took without the layer below. The numbers go
+  /// to the solverLayer statistics and printSolverChainProfile().
+  Solver *createProfilingSolver(Solver *s, SolverLayer layer);
+
+  /// printSolverChainProfile - Print the numbers of each profiled layer for
+  /// each kind of query.
+  void printSolverChainProfile(llvm::raw_ostream &os);
 }
 
 #endif /* KLEE_SOLVER_H */
@@ -28,10 +28,20 @@ extern llvm::cl::opt<bool> UseCexCache;
 
 extern llvm::cl::opt<bool> UseBranchCache;
 
+extern llvm::cl::opt<bool> UseUnsatCoreCache;
+
+extern llvm::cl::opt<bool> CanonicalizeCacheArrays;
+
 extern llvm::cl::opt<bool> UseIndependentSolver;
 
 extern llvm::cl::opt<bool> DebugValidateSolver;
 
+extern llvm::cl::opt<unsigned> DebugValidateSolverRate;
+
+extern llvm::cl::opt<bool> DebugValidateSolverCachedOnly;
+
+extern llvm::cl::opt<unsigned> DebugValidateSolverJobs;
+
 extern llvm::cl::opt<std::string> MinQueryTimeToLog;
 
 extern llvm::cl::opt<bool> LogTimedOutQueries;
@@ -42,23 +52,45 @@ extern llvm::cl::opt<bool> UseForkedCoreSolver;
 
 extern llvm::cl::opt<bool> CoreSolverOptimizeDivides;
 
+extern llvm::cl::opt<std::string> SMTLIBSolverCommand;
+
+extern llvm::cl::opt<std::string> RemoteSolverAddress;
+
 extern llvm::cl::opt<bool> UseAssignmentValidatingSolver;
 
+extern llvm::cl::opt<bool> ProfileSolverChain;
+
 /// The different query logging solvers that can be switched on/off
 enum QueryLoggingSolverType {
   ALL_KQUERY,    ///< Log all queries in .kquery (KQuery) format
   ALL_SMTLIB,    ///< Log all queries .smt2 (SMT-LIBv2) format
   SOLVER_KQUERY, ///< Log queries passed to solver in .kquery (KQuery) format
-  SOLVER_SMTLIB  ///< Log queries passed to solver in .smt2 (SMT-LIBv2) format
+  SOLVER_SMTLIB, ///< Log queries passed to solver in .smt2 (SMT-LIBv2) format
+  ALL_BINARY,    ///< Log all queries in the binary .kqb format
+  SOLVER_BINARY  ///< Log queries passed to solver in the binary .kqb format
 };
 
 extern llvm::cl::bits<QueryLoggingSolverType> QueryLoggingOptions;
 
+/// The rewrites the preprocessing solver can apply to queries
+enum PreprocessingRewrite {
+  PREPROCESS_EQUALITIES, ///< Substitute equalities with constants
+  PREPROCESS_READS,      ///< Expand reads at symbolic indices of few values
+  PREPROCESS_TABLES,     ///< Encode reads of constant arrays without them
+  PREPROCESS_BOUNDS,     ///< Drop constraints implied by bounds on bytes
+  PREPROCESS_DEAD        ///< Drop constraints unrelated to the query
+};
+
+extern llvm::cl::bits<PreprocessingRewrite> PreprocessingRewrites;
+
 enum CoreSolverType {
   STP_SOLVER,
   METASMT_SOLVER,
   DUMMY_SOLVER,
   Z3_SOLVER,
+  SMTLIB_SOLVER,
+  PORTFOLIO_SOLVER,
+  REMOTE_SOLVER,
   NO_SOLVER
 };
 
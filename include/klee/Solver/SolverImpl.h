@@ -79,6 +79,22 @@ namespace klee {
     /// \return True on success
     virtual bool computeTruth(const Query& query, bool &isValid) = 0;
 
+    /// computeTruths - Determine for each of the given expressions whether
+    /// it is provably true given the same constraints, as computeTruth.
+    ///
+    /// The expressions are guaranteed to be non-constant and have bool
+    /// type.
+    ///
+    /// SolverImpl provides a default implementation which uses
+    /// computeTruth for each expression in turn. Clients should override
+    /// this if they can share work between the expressions.
+    ///
+    /// \param [out] isValid - On success, the truth of each expression.
+    /// \return True on success
+    virtual bool computeTruths(const ConstraintManager &constraints,
+                               const std::vector<ref<Expr>> &exprs,
+                               std::vector<bool> &isValid);
+
     /// computeValue - Compute a feasible value for the expression.
     ///
     /// The query expression is guaranteed to be non-constant.
@@ -104,6 +120,20 @@ namespace klee {
     }
 
     virtual void setCoreSolverTimeout(time::Span timeout) {};
+
+    /// enableUnsatCores - Ask the solver to find out why the queries it
+    /// finds infeasible are, see getUnsatCore().
+    ///
+    /// \return false iff the solver does not support this.
+    virtual bool enableUnsatCores() { return false; }
+
+    /// getUnsatCore - Get the reason the last query was infeasible, if it
+    /// was: some of its constraints, and maybe the negation of its
+    /// expression (as Expr::createIsZero()), whose conjunction is already
+    /// infeasible.
+    ///
+    /// \return false iff there is no such core for the last query.
+    virtual bool getUnsatCore(std::vector<ref<Expr> > &core) { return false; }
 };
 
 }
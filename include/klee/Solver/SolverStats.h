@@ -16,6 +16,12 @@ namespace klee {
 namespace stats {
 
   extern Statistic cexCacheTime;
+  extern Statistic preprocessDeadConstraints;
+  extern Statistic preprocessExpandedReads;
+  extern Statistic preprocessExpandedTableReads;
+  extern Statistic preprocessImpliedConstraints;
+  extern Statistic preprocessInvertedTableReads;
+  extern Statistic preprocessSubstitutions;
   extern Statistic queries;
   extern Statistic queriesInvalid;
   extern Statistic queriesValid;
@@ -23,10 +29,30 @@ namespace stats {
   extern Statistic queryCacheMisses;
   extern Statistic queryCexCacheHits;
   extern Statistic queryCexCacheMisses;
+  extern Statistic queryConstructCacheHits;
+  extern Statistic queryConstructCacheMisses;
   extern Statistic queryConstructTime;
   extern Statistic queryConstructs;
   extern Statistic queryCounterexamples;
+  extern Statistic queryCoreCacheHits;
+  extern Statistic queryCores;
+  extern Statistic queryFactorCacheHits;
+  extern Statistic queryIncrementalAsserts;
+  extern Statistic queryIncrementalResets;
+  extern Statistic queryIncrementalReuses;
+  extern Statistic queryPersistentCacheHits;
+  extern Statistic queryPortfolioRaces;
   extern Statistic queryTime;
+  extern Statistic queryValidationMismatches;
+  extern Statistic queryValidations;
+
+  /// Number of queries each SolverLayer got, passed on to the layer below
+  /// and answered without it, and its time (in microseconds) without the
+  /// layer below, with -profile-solver-chain.
+  extern Statistic solverLayerQueries[];
+  extern Statistic solverLayerPassedQueries[];
+  extern Statistic solverLayerHits[];
+  extern Statistic solverLayerTime[];
   
 #ifdef KLEE_ARRAY_DEBUG
   extern Statistic arrayHashTime;
@@ -135,6 +135,11 @@ extern "C" {
      constants and that the range lie within a single object. */
   void klee_check_memory_access(const void *address, size_t size);
 
+  /* Copy n bytes from src to dest without interpreting a copy loop. The
+     pointers and the count are concretized, and each range has to lie
+     within a single object. */
+  void klee_memcpy(void *dest, const void *src, size_t n);
+
   /* Enable/disable forking. */
   void klee_set_forking(unsigned enable);
 
@@ -10,6 +10,14 @@
 #ifndef KLEE_BITARRAY_H
 #define KLEE_BITARRAY_H
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace klee {
 
   // XXX would be nice not to have
@@ -23,6 +31,33 @@ private:
 protected:
   static uint32_t length(unsigned size) { return (size+31)/32; }
 
+  // index of the first bit at or after idx in a word that differs from
+  // skip (all zeros or all ones), or size() if there is none
+  unsigned findFirst(unsigned idx, uint32_t skip) const {
+    if (idx >= _size)
+      return _size;
+    unsigned w = idx/32, e = length(_size);
+    uint32_t word = (bits[w] ^ skip) & (~0u << (idx&0x1F));
+    while (!word) {
+      if (++w == e)
+        return _size;
+#ifdef __SSE2__
+      // skip four uninteresting words at a time
+      const __m128i pattern = _mm_set1_epi32(skip);
+      while (w + 4 <= e) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bits + w));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(v, pattern)) != 0xFFFF)
+          break;
+        w += 4;
+      }
+      if (w == e)
+        return _size;
+#endif
+      word = bits[w] ^ skip;
+    }
+    return std::min(w*32 + __builtin_ctz(word), _size);
+  }
+
 public:
   BitArray() : bits(0), _size(0) {}
   explicit BitArray(unsigned size, bool value = false) : bits(new uint32_t[length(size)]), _size(size) {
@@ -34,6 +69,10 @@ public:
     if (b.bits)
       memcpy(bits, b.bits, sizeof(*bits)*length(_size));
   }
+  BitArray(BitArray &&b) : bits(b.bits), _size(b._size) {
+    b.bits = 0;
+    b._size = 0;
+  }
   ~BitArray() { delete[] bits; }
 
   unsigned size() const {
@@ -42,14 +81,14 @@ public:
 
   void resize(unsigned newSize, bool value = false) {
     uint32_t *oldBits = bits;
-    if (newSize)
-      bits = new uint32_t[length(newSize)];
+    bits = newSize ? new uint32_t[length(newSize)] : 0;
     if (oldBits) {
-      memcpy(bits, oldBits, sizeof(*bits)*length(std::min(_size, newSize)));
+      if (bits)
+        memcpy(bits, oldBits, sizeof(*bits)*length(std::min(_size, newSize)));
       delete[] oldBits;
     }
-    for (unsigned i = _size; i < newSize; i++)
-      set(i, value);
+    if (newSize > _size)
+      setRange(_size, newSize - _size, value);
     _size = newSize;
   }
 
@@ -57,6 +96,48 @@ public:
   void set(unsigned idx) { bits[idx/32] |= 1<<(idx&0x1F); }
   void unset(unsigned idx) { bits[idx/32] &= ~(1<<(idx&0x1F)); }
   void set(unsigned idx, bool value) { if (value) set(idx); else unset(idx); }
+
+  /// Set (or clear) all bits in [idx, idx+count).
+  void setRange(unsigned idx, unsigned count, bool value = true) {
+    for (; count && (idx&0x1F); ++idx, --count)
+      set(idx, value);
+    unsigned words = count/32;
+    memset(bits + idx/32, value?0xFF:0, sizeof(*bits)*words);
+    idx += words*32;
+    count -= words*32;
+    for (; count; ++idx, --count)
+      set(idx, value);
+  }
+
+  /// Return the index of the first set bit at or after idx, or size().
+  unsigned findFirstSet(unsigned idx = 0) const { return findFirst(idx, 0); }
+  /// Return the index of the first unset bit at or after idx, or size().
+  unsigned findFirstUnset(unsigned idx = 0) const { return findFirst(idx, ~0u); }
+
+  /// Return the number of set bits.
+  unsigned popcount() const {
+    unsigned count = 0, full = _size/32;
+    for (unsigned w = 0; w < full; ++w)
+      count += __builtin_popcount(bits[w]);
+    if (_size&0x1F)
+      count += __builtin_popcount(bits[full] & ((1u << (_size&0x1F)) - 1));
+    return count;
+  }
+
+  /// Return true if all bits in [idx, idx+count) are set, testing a whole
+  /// word at a time.
+  bool isAllSet(unsigned idx, unsigned count) const {
+    while (count) {
+      unsigned bit = idx & 0x1F;
+      unsigned len = std::min(count, 32 - bit);
+      uint32_t mask = (len == 32 ? ~0u : ((1u << len) - 1)) << bit;
+      if ((bits[idx/32] & mask) != mask)
+        return false;
+      idx += len;
+      count -= len;
+    }
+    return true;
+  }
 };
 
 } // End klee namespace
@@ -12,6 +12,8 @@
 
 #include "klee/Expr/Expr.h"
 
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <sstream>
@@ -82,15 +84,32 @@ public:
 
   /// write - Output a string to the stream and update the
   /// position. The stream should not have any newlines.
-  void write(const std::string &s) {
+  void write(llvm::StringRef s) {
     os << s;
-    pos += s.length();
+    pos += s.size();
+  }
+
+  /// Strings are written as they are, anything else is formatted on the
+  /// stack first so that its length is known.
+  PrintContext &operator<<(llvm::StringRef s) {
+    write(s);
+    return *this;
+  }
+
+  PrintContext &operator<<(const char *s) {
+    write(s);
+    return *this;
+  }
+
+  PrintContext &operator<<(const std::string &s) {
+    write(s);
+    return *this;
   }
 
   template <typename T>
   PrintContext &operator<<(T elt) {
-    std::string str;
-    llvm::raw_string_ostream ss(str);
+    llvm::SmallString<32> str;
+    llvm::raw_svector_ostream ss(str);
     ss << elt;
     write(ss.str());
     return *this;
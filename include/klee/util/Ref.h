@@ -65,6 +65,16 @@ public:
     inc();
   }
 
+  // move constructors: take over the reference, leaving \a r null
+  ref(ref<T> &&r) noexcept : ptr(r.ptr) {
+    r.ptr = nullptr;
+  }
+
+  template<class U>
+  ref(ref<U> &&r) noexcept : ptr(r.ptr) {
+    r.ptr = nullptr;
+  }
+
   // pointer operations
   T *get () const {
     return ptr;
@@ -88,6 +98,23 @@ public:
     return *this;
   }
 
+  // r is released first: it may be owned by the object dec() frees
+  ref<T> &operator=(ref<T> &&r) noexcept {
+    T *p = r.ptr;
+    r.ptr = nullptr;
+    dec();
+    ptr = p;
+    return *this;
+  }
+
+  template<class U> ref<T> &operator=(ref<U> &&r) noexcept {
+    T *p = r.ptr;
+    r.ptr = nullptr;
+    dec();
+    ptr = p;
+    return *this;
+  }
+
   T& operator*() const {
     return *ptr;
   }
@@ -9,9 +9,14 @@
 
 #include "klee/Internal/ADT/KTest.h"
 
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define KTEST_VERSION 3
 #define KTEST_MAGIC_SIZE 5
@@ -20,44 +25,144 @@
 // for compatibility reasons
 #define BOUT_MAGIC "BOUT\n"
 
+#define KTEST_PACK_VERSION 1
+#define KTEST_PACK_MAGIC_SIZE 8
+#define KTEST_PACK_MAGIC "KTSTPACK"
+
 /***/
 
-static int read_uint32(FILE *f, unsigned *value_out) {
-  unsigned char data[4];
-  if (fread(data, 4, 1, f)!=1)
+/* A cursor over a file held in memory. All reads are bounds checked, so
+   a truncated or corrupt file fails to parse instead of being overrun. */
+typedef struct {
+  const unsigned char *pos;
+  const unsigned char *end;
+} KTestReader;
+
+static int get_bytes(KTestReader *r, size_t len,
+                     const unsigned char **value_out) {
+  if ((size_t)(r->end - r->pos) < len)
+    return 0;
+  *value_out = r->pos;
+  r->pos += len;
+  return 1;
+}
+
+static int get_uint32(KTestReader *r, unsigned *value_out) {
+  const unsigned char *data;
+  if (!get_bytes(r, 4, &data))
     return 0;
   *value_out = (((((data[0]<<8) + data[1])<<8) + data[2])<<8) + data[3];
   return 1;
 }
 
-static int write_uint32(FILE *f, unsigned value) {
-  unsigned char data[4];
+static int get_uint64(KTestReader *r, uint64_t *value_out) {
+  unsigned hi, lo;
+  if (!get_uint32(r, &hi) || !get_uint32(r, &lo))
+    return 0;
+  *value_out = ((uint64_t) hi << 32) | lo;
+  return 1;
+}
+
+static int get_string(KTestReader *r, const unsigned char **value_out,
+                      unsigned *len_out) {
+  return get_uint32(r, len_out) && get_bytes(r, *len_out, value_out);
+}
+
+/* A growing buffer a file is put together in before it is written out
+   with a single write. */
+typedef struct {
+  unsigned char *data;
+  size_t size;
+  size_t capacity;
+  int failed;
+} KTestWriter;
+
+static void put_bytes(KTestWriter *w, const void *value, size_t len) {
+  if (w->failed)
+    return;
+  if (w->size + len > w->capacity) {
+    size_t capacity = w->capacity ? w->capacity : 4096;
+    unsigned char *data;
+    while (capacity < w->size + len)
+      capacity *= 2;
+    data = (unsigned char*) realloc(w->data, capacity);
+    if (!data) {
+      w->failed = 1;
+      return;
+    }
+    w->data = data;
+    w->capacity = capacity;
+  }
+  if (len)
+    memcpy(w->data + w->size, value, len);
+  w->size += len;
+}
+
+static void store_uint32(unsigned char *data, unsigned value) {
   data[0] = value>>24;
   data[1] = value>>16;
   data[2] = value>> 8;
   data[3] = value>> 0;
-  return fwrite(data, 1, 4, f)==4;
 }
 
-static int read_string(FILE *f, char **value_out) {
-  unsigned len;
-  if (!read_uint32(f, &len))
-    return 0;
-  *value_out = (char*) malloc(len+1);
-  if (!*value_out)
+static void store_uint64(unsigned char *data, uint64_t value) {
+  store_uint32(data, (unsigned) (value >> 32));
+  store_uint32(data + 4, (unsigned) value);
+}
+
+static void put_uint32(KTestWriter *w, unsigned value) {
+  unsigned char data[4];
+  store_uint32(data, value);
+  put_bytes(w, data, 4);
+}
+
+static void put_uint64(KTestWriter *w, uint64_t value) {
+  unsigned char data[8];
+  store_uint64(data, value);
+  put_bytes(w, data, 8);
+}
+
+static void put_string(KTestWriter *w, const char *value) {
+  unsigned len = strlen(value);
+  put_uint32(w, len);
+  put_bytes(w, value, len);
+}
+
+static int writer_toFile(KTestWriter *w, const char *path) {
+  FILE *f;
+  int res;
+
+  if (w->failed)
     return 0;
-  if (fread(*value_out, len, 1, f)!=1)
+  f = fopen(path, "wb");
+  if (!f)
     return 0;
-  (*value_out)[len] = 0;
-  return 1;
+  res = fwrite(w->data, 1, w->size, f) == w->size;
+  if (fclose(f))
+    res = 0;
+  return res;
 }
 
-static int write_string(FILE *f, const char *value) {
-  unsigned len = strlen(value);
-  if (!write_uint32(f, len))
+/* Map the file at path into memory, privately, so that views into it may
+   be written to without changing the file. */
+static int map_file(const char *path, unsigned char **data_out,
+                    size_t *size_out) {
+  struct stat st;
+  void *data;
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0)
     return 0;
-  if (fwrite(value, len, 1, f)!=1)
+  if (fstat(fd, &st) || st.st_size == 0) {
+    close(fd);
+    return 0;
+  }
+  data = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
     return 0;
+  *data_out = (unsigned char*) data;
+  *size_out = st.st_size;
   return 1;
 }
 
@@ -91,135 +196,273 @@ int kTest_isKTestFile(const char *path) {
   return res;
 }
 
-KTest *kTest_fromFile(const char *path) {
+int kTest_isKTestPack(const char *path) {
   FILE *f = fopen(path, "rb");
-  KTest *res = 0;
-  unsigned i, version;
+  char header[KTEST_PACK_MAGIC_SIZE];
+  int res;
 
-  if (!f) 
-    goto error;
-  if (!kTest_checkHeader(f)) 
-    goto error;
+  if (!f)
+    return 0;
+  res = fread(header, KTEST_PACK_MAGIC_SIZE, 1, f) == 1 &&
+        !memcmp(header, KTEST_PACK_MAGIC, KTEST_PACK_MAGIC_SIZE);
+  fclose(f);
 
-  res = (KTest*) calloc(1, sizeof(*res));
-  if (!res) 
-    goto error;
+  return res;
+}
 
-  if (!read_uint32(f, &version)) 
-    goto error;
-  
-  if (version > kTest_getCurrentVersion())
-    goto error;
+/* What a pass over a .ktest finds, before anything is allocated. */
+typedef struct {
+  unsigned version;
+  unsigned numArgs;
+  unsigned symArgvs;
+  unsigned symArgvLen;
+  unsigned numObjects;
+  /* the bytes taken by the arguments and object names, terminated */
+  size_t stringBytes;
+  /* where the arguments start */
+  const unsigned char *args;
+} KTestLayout;
+
+static int kTest_scan(KTestReader r, KTestLayout *l) {
+  const unsigned char *data;
+  unsigned i, len, numBytes;
+
+  if (!get_bytes(&r, KTEST_MAGIC_SIZE, &data))
+    return 0;
+  if (memcmp(data, KTEST_MAGIC, KTEST_MAGIC_SIZE) &&
+      memcmp(data, BOUT_MAGIC, KTEST_MAGIC_SIZE))
+    return 0;
 
-  res->version = version;
+  if (!get_uint32(&r, &l->version))
+    return 0;
+  if (l->version > kTest_getCurrentVersion())
+    return 0;
+
+  l->stringBytes = 0;
+  if (!get_uint32(&r, &l->numArgs))
+    return 0;
+  l->args = r.pos;
+  for (i=0; i<l->numArgs; i++) {
+    if (!get_string(&r, &data, &len))
+      return 0;
+    l->stringBytes += len + 1;
+  }
+
+  l->symArgvs = l->symArgvLen = 0;
+  if (l->version >= 2) {
+    if (!get_uint32(&r, &l->symArgvs))
+      return 0;
+    if (!get_uint32(&r, &l->symArgvLen))
+      return 0;
+  }
+
+  if (!get_uint32(&r, &l->numObjects))
+    return 0;
+  for (i=0; i<l->numObjects; i++) {
+    if (!get_string(&r, &data, &len))
+      return 0;
+    l->stringBytes += len + 1;
+    if (!get_uint32(&r, &numBytes) || !get_bytes(&r, numBytes, &data))
+      return 0;
+  }
+  return 1;
+}
+
+/* Fill res from the scanned .ktest. Strings are copied to strings if it is
+   given and to allocations of their own otherwise; object bytes are left
+   pointing into the file if view is set. */
+static int kTest_fill(KTest *res, const KTestLayout *l, KTestReader r,
+                      char *strings, int view) {
+  const unsigned char *data;
+  unsigned i, len;
+
+  res->version = l->version;
+  res->numArgs = l->numArgs;
+  res->symArgvs = l->symArgvs;
+  res->symArgvLen = l->symArgvLen;
+  res->numObjects = l->numObjects;
+
+  r.pos = l->args;
+  for (i=0; i<res->numArgs; i++) {
+    get_string(&r, &data, &len);
+    res->args[i] = strings ? strings : (char*) malloc(len+1);
+    if (!res->args[i])
+      return 0;
+    memcpy(res->args[i], data, len);
+    res->args[i][len] = 0;
+    if (strings)
+      strings += len + 1;
+  }
+
+  if (res->version >= 2)
+    r.pos += 8;
+  r.pos += 4;
 
-  if (!read_uint32(f, &res->numArgs)) 
-    goto error;
-  res->args = (char**) calloc(res->numArgs, sizeof(*res->args));
-  if (!res->args) 
-    goto error;
-  
-  for (i=0; i<res->numArgs; i++)
-    if (!read_string(f, &res->args[i]))
-      goto error;
-
-  if (version >= 2) {
-    if (!read_uint32(f, &res->symArgvs)) 
-      goto error;
-    if (!read_uint32(f, &res->symArgvLen)) 
-      goto error;
-  }
-
-  if (!read_uint32(f, &res->numObjects))
-    goto error;
-  res->objects = (KTestObject*) calloc(res->numObjects, sizeof(*res->objects));
-  if (!res->objects)
-    goto error;
   for (i=0; i<res->numObjects; i++) {
     KTestObject *o = &res->objects[i];
-    if (!read_string(f, &o->name))
-      goto error;
-    if (!read_uint32(f, &o->numBytes))
-      goto error;
+    get_string(&r, &data, &len);
+    o->name = strings ? strings : (char*) malloc(len+1);
+    if (!o->name)
+      return 0;
+    memcpy(o->name, data, len);
+    o->name[len] = 0;
+    if (strings)
+      strings += len + 1;
+
+    get_uint32(&r, &o->numBytes);
+    get_bytes(&r, o->numBytes, &data);
     o->bytes = 0;
     if (o->numBytes) {
-      o->bytes = (unsigned char*) malloc(o->numBytes);
-      if (fread(o->bytes, o->numBytes, 1, f)!=1)
-        goto error;
+      if (view) {
+        o->bytes = (unsigned char*) data;
+      } else {
+        o->bytes = (unsigned char*) malloc(o->numBytes);
+        if (!o->bytes)
+          return 0;
+        memcpy(o->bytes, data, o->numBytes);
+      }
     }
   }
+  return 1;
+}
 
-  fclose(f);
+/* Parse a .ktest into allocations of its own, for kTest_free. */
+static KTest *kTest_parse(KTestReader r) {
+  KTestLayout l;
+  KTest *res;
 
-  return res;
- error:
-  if (res) {
-    if (res->args) {
-      for (i=0; i<res->numArgs; i++)
-        if (res->args[i])
-          free(res->args[i]);
-      free(res->args);
-    }
-    if (res->objects) {
-      for (i=0; i<res->numObjects; i++) {
-        KTestObject *bo = &res->objects[i];
-        if (bo->name)
-          free(bo->name);
-        if (bo->bytes)
-          free(bo->bytes);
-      }
-      free(res->objects);
-    }
-    free(res);
+  if (!kTest_scan(r, &l))
+    return 0;
+
+  res = (KTest*) calloc(1, sizeof(*res));
+  if (!res)
+    return 0;
+  res->args = (char**) calloc(l.numArgs, sizeof(*res->args));
+  res->objects = (KTestObject*) calloc(l.numObjects, sizeof(*res->objects));
+  if (!res->args || !res->objects || !kTest_fill(res, &l, r, 0, 0)) {
+    /* what was not filled in is null, which kTest_free copes with */
+    kTest_free(res);
+    return 0;
   }
+  return res;
+}
+
+/* Parse a .ktest into a single allocation whose object bytes point into
+   the file. */
+static KTest *kTest_parseView(KTestReader r) {
+  KTestLayout l;
+  KTest *res;
+  size_t size;
 
-  if (f) fclose(f);
+  if (!kTest_scan(r, &l))
+    return 0;
 
-  return 0;
+  size = sizeof(KTest) + l.numArgs * sizeof(char*) +
+         l.numObjects * sizeof(KTestObject);
+  res = (KTest*) malloc(size + l.stringBytes);
+  if (!res)
+    return 0;
+  res->args = (char**) (res + 1);
+  res->objects = (KTestObject*) (res->args + l.numArgs);
+  kTest_fill(res, &l, r, (char*) res + size, 1);
+  return res;
 }
 
-int kTest_toFile(KTest *bo, const char *path) {
-  FILE *f = fopen(path, "wb");
+KTest *kTest_fromFile(const char *path) {
+  unsigned char *data;
+  size_t size;
+  KTestReader r;
+  KTest *res;
+
+  if (!map_file(path, &data, &size))
+    return 0;
+  r.pos = data;
+  r.end = data + size;
+  res = kTest_parse(r);
+  munmap(data, size);
+
+  return res;
+}
+
+static void kTest_serialize(KTestWriter *w, KTest *bo) {
   unsigned i;
 
-  if (!f) 
-    goto error;
-  if (fwrite(KTEST_MAGIC, strlen(KTEST_MAGIC), 1, f)!=1)
-    goto error;
-  if (!write_uint32(f, KTEST_VERSION))
-    goto error;
-      
-  if (!write_uint32(f, bo->numArgs))
-    goto error;
-  for (i=0; i<bo->numArgs; i++) {
-    if (!write_string(f, bo->args[i]))
-      goto error;
-  }
-
-  if (!write_uint32(f, bo->symArgvs))
-    goto error;
-  if (!write_uint32(f, bo->symArgvLen))
-    goto error;
-  
-  if (!write_uint32(f, bo->numObjects))
-    goto error;
+  put_bytes(w, KTEST_MAGIC, KTEST_MAGIC_SIZE);
+  put_uint32(w, KTEST_VERSION);
+
+  put_uint32(w, bo->numArgs);
+  for (i=0; i<bo->numArgs; i++)
+    put_string(w, bo->args[i]);
+
+  put_uint32(w, bo->symArgvs);
+  put_uint32(w, bo->symArgvLen);
+
+  put_uint32(w, bo->numObjects);
   for (i=0; i<bo->numObjects; i++) {
     KTestObject *o = &bo->objects[i];
-    if (!write_string(f, o->name))
-      goto error;
-    if (!write_uint32(f, o->numBytes))
-      goto error;
-    if (o->numBytes && fwrite(o->bytes, o->numBytes, 1, f)!=1)
-      goto error;
+    put_string(w, o->name);
+    put_uint32(w, o->numBytes);
+    put_bytes(w, o->bytes, o->numBytes);
   }
+}
 
-  fclose(f);
+int kTest_toFile(KTest *bo, const char *path) {
+  KTestWriter w = {0, 0, 0, 0};
+  int res;
+
+  kTest_serialize(&w, bo);
+  res = writer_toFile(&w, path);
+  free(w.data);
+
+  return res;
+}
 
+int kTest_toBuffer(KTest *bo, unsigned char **data_out, size_t *size_out) {
+  KTestWriter w = {0, 0, 0, 0};
+
+  kTest_serialize(&w, bo);
+  if (w.failed) {
+    free(w.data);
+    return 0;
+  }
+  *data_out = w.data;
+  *size_out = w.size;
   return 1;
- error:
-  if (f) fclose(f);
-  
-  return 0;
+}
+
+int kTest_packToFile(KTest **tests, const char **names, unsigned numTests,
+                     const char *path) {
+  KTestWriter w = {0, 0, 0, 0};
+  size_t indexAt, start;
+  unsigned i;
+  int res;
+
+  /* the header and the index, whose offsets are patched in below */
+  put_bytes(&w, KTEST_PACK_MAGIC, KTEST_PACK_MAGIC_SIZE);
+  put_uint32(&w, KTEST_PACK_VERSION);
+  put_uint32(&w, numTests);
+  for (i=0; i<numTests; i++) {
+    put_string(&w, names[i]);
+    put_uint64(&w, 0);
+    put_uint64(&w, 0);
+  }
+
+  indexAt = KTEST_PACK_MAGIC_SIZE + 8;
+  for (i=0; i<numTests; i++) {
+    start = w.size;
+    kTest_serialize(&w, tests[i]);
+    if (w.failed)
+      break;
+    indexAt += 4 + strlen(names[i]);
+    store_uint64(w.data + indexAt, start);
+    store_uint64(w.data + indexAt + 8, w.size - start);
+    indexAt += 16;
+  }
+
+  res = writer_toFile(&w, path);
+  free(w.data);
+
+  return res;
 }
 
 unsigned kTest_numBytes(KTest *bo) {
@@ -241,3 +484,114 @@ void kTest_free(KTest *bo) {
   free(bo->objects);
   free(bo);
 }
+
+/***/
+
+struct KTestMap {
+  unsigned char *data;
+  size_t size;
+  unsigned numTests;
+  /* where each test is in the mapping */
+  KTestReader *tests;
+  char **names;
+  /* the views handed out so far, parsed on first use */
+  KTest **views;
+};
+
+static int kTest_readPackIndex(KTestMap *m, const char *path) {
+  KTestReader r = {m->data, m->data + m->size};
+  const unsigned char *data;
+  unsigned i, version, len;
+  uint64_t offset, size;
+
+  if (!get_bytes(&r, KTEST_PACK_MAGIC_SIZE, &data))
+    return 0;
+  if (memcmp(data, KTEST_PACK_MAGIC, KTEST_PACK_MAGIC_SIZE)) {
+    /* a plain .ktest, named after its file */
+    m->numTests = 1;
+    m->tests = (KTestReader*) calloc(1, sizeof(*m->tests));
+    m->names = (char**) calloc(1, sizeof(*m->names));
+    if (!m->tests || !m->names)
+      return 0;
+    m->tests[0].pos = m->data;
+    m->tests[0].end = m->data + m->size;
+    m->names[0] = strdup(path);
+    return m->names[0] != 0;
+  }
+
+  if (!get_uint32(&r, &version) || version > KTEST_PACK_VERSION)
+    return 0;
+  if (!get_uint32(&r, &m->numTests))
+    return 0;
+  m->tests = (KTestReader*) calloc(m->numTests, sizeof(*m->tests));
+  m->names = (char**) calloc(m->numTests, sizeof(*m->names));
+  if (!m->tests || !m->names)
+    return 0;
+
+  for (i=0; i<m->numTests; i++) {
+    if (!get_string(&r, &data, &len))
+      return 0;
+    if (!get_uint64(&r, &offset) || !get_uint64(&r, &size))
+      return 0;
+    if (offset > m->size || size > m->size - offset)
+      return 0;
+    m->tests[i].pos = m->data + offset;
+    m->tests[i].end = m->data + offset + size;
+    m->names[i] = (char*) malloc(len+1);
+    if (!m->names[i])
+      return 0;
+    memcpy(m->names[i], data, len);
+    m->names[i][len] = 0;
+  }
+  return 1;
+}
+
+KTestMap *kTest_openMap(const char *path) {
+  KTestMap *m = (KTestMap*) calloc(1, sizeof(*m));
+
+  if (!m)
+    return 0;
+  if (!map_file(path, &m->data, &m->size)) {
+    free(m);
+    return 0;
+  }
+  if (!kTest_readPackIndex(m, path)) {
+    kTest_closeMap(m);
+    return 0;
+  }
+  m->views = (KTest**) calloc(m->numTests, sizeof(*m->views));
+  if (!m->views) {
+    kTest_closeMap(m);
+    return 0;
+  }
+  return m;
+}
+
+unsigned kTest_mapNumTests(const KTestMap *m) {
+  return m->numTests;
+}
+
+const char *kTest_mapName(const KTestMap *m, unsigned index) {
+  return m->names[index];
+}
+
+KTest *kTest_mapGet(KTestMap *m, unsigned index) {
+  if (!m->views[index])
+    m->views[index] = kTest_parseView(m->tests[index]);
+  return m->views[index];
+}
+
+void kTest_closeMap(KTestMap *m) {
+  unsigned i;
+  if (m->names)
+    for (i=0; i<m->numTests; i++)
+      free(m->names[i]);
+  if (m->views)
+    for (i=0; i<m->numTests; i++)
+      free(m->views[i]);
+  free(m->names);
+  free(m->views);
+  free(m->tests);
+  munmap(m->data, m->size);
+  free(m);
+}
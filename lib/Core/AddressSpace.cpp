@@ -9,28 +9,129 @@
 
 #include "AddressSpace.h"
 #include "CoreStats.h"
+#include "EventTrace.h"
 #include "Memory.h"
 #include "TimingSolver.h"
 
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprSerializer.h"
+#include "klee/Expr/ExprRangeEvaluator.h"
+#include "klee/Expr/ValueRange.h"
+#include "klee/OptionCategories.h"
 #include "klee/TimerStatIncrementer.h"
 #include "klee/KValue.h"
 
+#include "llvm/Support/CommandLine.h"
+
+#include <algorithm>
+
 using namespace klee;
+using namespace llvm;
+
+namespace {
+cl::opt<bool> BatchedResolution(
+    "batched-resolution", cl::init(false),
+    cl::desc("Resolve symbolic segments by enumerating their feasible values "
+             "with the solver instead of checking every live object "
+             "(default=false)"),
+    cl::cat(SolvingCat));
+
+/// Over-approximates the values of an expression without asking the
+/// solver, used to prune the candidate objects of a symbolic segment.
+class SegmentRangeEvaluator : public ExprRangeEvaluator<ValueRange> {
+protected:
+  ValueRange getInitialReadRange(const Array &array, ValueRange index) {
+    if (array.isConstantArray() && index.isFixed() &&
+        index.min() < array.constantValues.size())
+      return ValueRange(array.constantValues[index.min()]->getZExtValue(8));
+
+    return ValueRange(0, bits64::maxValueOfNBits(array.getRange()));
+  }
+};
+} // namespace
 
 ///
 
+bool AddressSpace::trackVersions = false;
+
+uint64_t AddressSpace::hashVersion(const MemoryObject *mo,
+                                   const ObjectState *os) {
+  uint64_t h = mo->id * 0x9e3779b97f4a7c15ULL ^ os->contentsVersion;
+  // finalizer of splitmix64
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+void AddressSpace::markVersionPending(const MemoryObject *mo,
+                                      const ObjectState *os) {
+  if (!trackVersions)
+    return;
+  if (std::find(versionsPending.begin(), versionsPending.end(), mo) !=
+      versionsPending.end())
+    return;
+  versionsHash ^= hashVersion(mo, os);
+  versionsPending.push_back(mo);
+}
+
+uint64_t AddressSpace::getVersionsHash() const {
+  assert(trackVersions && "object versions are not tracked");
+  for (const MemoryObject *mo : versionsPending)
+    if (const ObjectState *os = findObject(mo))
+      versionsHash ^= hashVersion(mo, os);
+  versionsPending.clear();
+  return versionsHash;
+}
+
 void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
   assert(os->copyOnWriteOwner==0 && "object already has owner");
   os->copyOnWriteOwner = cowKey;
+  // the new binding is hashed together with the pending objects
+  if (const ObjectState *old = findObject(mo))
+    markVersionPending(mo, old);
+  else if (trackVersions)
+    versionsPending.push_back(mo);
   objects = objects.replace(std::make_pair(mo, os));
-  if (mo->segment != 0)
+  if (mo->segment != 0) {
+    segmentMap = segmentMap.replace(std::make_pair(mo->segment, mo));
+    segmentTable = segmentTable.replace(mo->segment, ObjectPair(mo, os));
+  }
+}
+
+void AddressSpace::bindSharedObject(const MemoryObject *mo,
+                                    const ObjectState *os) {
+  assert((os->readOnly || os->copyOnWriteOwner == 0) &&
+         "shared object must not have an owner");
+  if (const ObjectState *old = findObject(mo))
+    markVersionPending(mo, old);
+  else if (trackVersions)
+    versionsPending.push_back(mo);
+  objects = objects.replace(std::make_pair(mo, const_cast<ObjectState *>(os)));
+  if (mo->segment != 0) {
     segmentMap = segmentMap.replace(std::make_pair(mo->segment, mo));
+    segmentTable = segmentTable.replace(mo->segment, ObjectPair(mo, os));
+  }
 }
 
 void AddressSpace::unbindObject(const MemoryObject *mo) {
-  if (mo->segment != 0)
+  if (mo->segment != 0) {
     segmentMap = segmentMap.remove(mo->segment);
+    segmentTable = segmentTable.remove(mo->segment);
+    sizeBounds = sizeBounds.remove(mo->segment);
+    if (const ConcreteSegmentMap::value_type *res =
+            concreteSegmentMap.lookup(mo->segment)) {
+      concreteAddressMap = concreteAddressMap.remove(res->second);
+      concreteSegmentMap = concreteSegmentMap.remove(mo->segment);
+    }
+  }
+  if (trackVersions) {
+    auto pending =
+        std::find(versionsPending.begin(), versionsPending.end(), mo);
+    if (pending != versionsPending.end())
+      versionsPending.erase(pending);
+    else if (const ObjectState *os = findObject(mo))
+      versionsHash ^= hashVersion(mo, os);
+  }
   objects = objects.remove(mo);
   // NOTE MemoryObjects are reference counted, *mo is deleted at this point
 }
@@ -43,25 +144,84 @@ const ObjectState *AddressSpace::findObject(const MemoryObject *mo) const {
 
 ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
                                         const ObjectState *os) {
+  ObjectState *n = copyForWriting(mo, os);
+  if (n != os) {
+    objects = objects.replace(std::make_pair(mo, n));
+    if (mo->segment != 0)
+      segmentTable = segmentTable.replace(mo->segment, ObjectPair(mo, n));
+  }
+  return n;
+}
+
+ObjectState *AddressSpace::copyForWriting(const MemoryObject *mo,
+                                          const ObjectState *os) {
   assert(!os->readOnly);
+  markVersionPending(mo, os);
 
   if (cowKey==os->copyOnWriteOwner) {
     return const_cast<ObjectState*>(os);
   } else {
     ObjectState *n = new ObjectState(*os);
+    EventTrace::record(TraceEvent::CopyOnWrite, nullptr, os->getSizeBound());
     n->copyOnWriteOwner = cowKey;
-    objects = objects.replace(std::make_pair(mo, n));
     return n;
   }
 }
 
+void AddressSpace::bindCopies(
+    const std::vector<MemoryMap::value_type> &copies) {
+  if (copies.empty())
+    return;
+  objects = objects.replaceMany(copies.begin(), copies.end());
+  for (const auto &copy : copies)
+    if (copy.first->segment != 0)
+      segmentTable = segmentTable.replace(
+          copy.first->segment, ObjectPair(copy.first, copy.second));
+}
+
+void AddressSpace::swapOut(ExprWriter &w) {
+  // only the objects owned by this address space are not shared
+  std::vector<ObjectState *> owned;
+  for (const auto &object : objects) {
+    ObjectState *os = object.second;
+    if (os->copyOnWriteOwner == cowKey && !os->readOnly)
+      owned.push_back(os);
+  }
+  w.writeInt(owned.size());
+  for (ObjectState *os : owned) {
+    w.writeInt(os->getObject()->id);
+    os->swapOut(w);
+  }
+}
+
+void AddressSpace::swapIn(ExprReader &r) {
+  uint64_t n = r.readInt();
+  for (const auto &object : objects) {
+    if (n == 0)
+      break;
+    ObjectState *os = object.second;
+    if (os->copyOnWriteOwner != cowKey || os->readOnly)
+      continue;
+    uint64_t id = r.readInt();
+    assert(id == os->getObject()->id && "address space changed while swapped out");
+    (void) id;
+    os->swapIn(r);
+    --n;
+  }
+  assert(n == 0 && "address space changed while swapped out");
+}
+
+void AddressSpace::bindConcreteAddress(uint64_t address, uint64_t segment) {
+  if (concreteAddressMap.count(address) || concreteSegmentMap.count(segment))
+    return;
+  concreteAddressMap = concreteAddressMap.insert(std::make_pair(address, segment));
+  concreteSegmentMap = concreteSegmentMap.insert(std::make_pair(segment, address));
+}
+
 bool AddressSpace::resolveInConcreteMap(const uint64_t& segment, uint64_t &address) const {
-  auto found = std::find_if(concreteAddressMap.begin(),concreteAddressMap.end(),
-                            [segment](std::pair<const uint64_t&, const uint64_t&> value) {
-                              return value.second == segment;
-                            });
-  if (found != concreteAddressMap.end()) {
-    address = found->first;
+  if (const ConcreteSegmentMap::value_type *res =
+          concreteSegmentMap.lookup(segment)) {
+    address = res->second;
     return true;
   }
   return false;
@@ -72,9 +232,9 @@ bool AddressSpace::resolveOneConstantSegment(const KValue &pointer,
   uint64_t segment = cast<ConstantExpr>(pointer.getSegment())->getZExtValue();
 
   if (segment != 0) {
-    if (const SegmentMap::value_type *res = segmentMap.lookup(segment)) {
+    if (const ObjectPair *res = segmentTable.lookup(segment)) {
       // TODO bounds check?
-      result = *objects.lookup(res->second);
+      result = *res;
       return true;
     }
   }
@@ -188,19 +348,94 @@ bool AddressSpace::resolve(ExecutionState &state,
                                           KValue(zeroSegment, pointer.getValue()),
                                           rl, maxResolutions, timeout))
     return true;
-  // TODO inefficient
+  // only the segments the expression can evaluate to are worth a query
+  ValueRange range = SegmentRangeEvaluator().evaluate(pointer.getSegment());
+  if (range.isEmpty())
+    return false;
+
+  bool incomplete;
+  if (BatchedResolution &&
+      resolveSegmentsBatched(state, solver, pointer, range, rl,
+                             maxResolutions, timeout, incomplete))
+    return incomplete;
+
+  // ask about all the segments at once, the solver shares the work on the
+  // path constraints between them
+  TimerStatIncrementer timer(stats::resolveTime);
+  std::vector<ref<Expr> > matches;
+  std::vector<const MemoryObject *> candidates;
+  for (SegmentMap::iterator it = segmentMap.lower_bound(range.min()),
+                            ie = segmentMap.end();
+       it != ie && it->first <= range.max(); ++it) {
+    ref<Expr> segmentExpr = ConstantExpr::create(it->first, pointer.getWidth());
+    matches.push_back(EqExpr::create(pointer.getSegment(), segmentExpr));
+    candidates.push_back(it->second);
+  }
+  std::vector<bool> feasible;
+  if (!solver->mayBeTrue(state, matches, feasible))
+    return true;
+  for (unsigned i = 0; i != candidates.size(); ++i)
+    if (feasible[i])
+      rl.push_back(*objects.lookup(candidates[i]));
+  return false;
+}
+
+bool AddressSpace::resolveSegmentsBatched(ExecutionState &state,
+                                          TimingSolver *solver,
+                                          const KValue &pointer,
+                                          const ValueRange &range,
+                                          ResolutionList &rl,
+                                          unsigned maxResolutions,
+                                          time::Span timeout,
+                                          bool &incomplete) const {
+  const ref<Expr> &segment = pointer.getSegment();
+
+  // restrict the segment to the live objects so that every model
+  // names one of them
+  ref<Expr> isObject = ConstantExpr::alloc(0, Expr::Bool);
+  for (SegmentMap::iterator it = segmentMap.lower_bound(range.min()),
+                            ie = segmentMap.end();
+       it != ie && it->first <= range.max(); ++it) {
+    ref<Expr> segmentExpr = ConstantExpr::create(it->first, pointer.getWidth());
+    isObject = OrExpr::create(EqExpr::create(segment, segmentExpr), isObject);
+  }
+  std::vector<ref<Expr> > assumptions(1, isObject);
+
+  size_t initialSize = rl.size();
   TimerStatIncrementer timer(stats::resolveTime);
-  for (const SegmentMap::value_type &res : segmentMap) {
-    if (timeout && timeout < timer.delta())
+  while (!maxResolutions || rl.size() - initialSize < maxResolutions) {
+    if (timeout && timeout < timer.delta()) {
+      incomplete = true;
+      return true;
+    }
+
+    std::shared_ptr<const Assignment> model;
+    bool hasSolution;
+    if (!solver->getInitialValues(state, assumptions, model, hasSolution)) {
+      incomplete = true;
       return true;
-    ref<Expr> segmentExpr = ConstantExpr::create(res.first, pointer.getWidth());
-    ref<Expr> expr = EqExpr::create(pointer.getSegment(), segmentExpr);
-    if (!solver->mayBeTrue(state, expr, mayBeTrue))
+    }
+    if (!hasSolution) {
+      incomplete = false;
       return true;
-    if (mayBeTrue)
-      rl.push_back(*objects.lookup(res.second));
+    }
+
+    ref<ConstantExpr> value = dyn_cast<ConstantExpr>(model->evaluate(segment));
+    const ObjectPair *res =
+        value.isNull() ? nullptr : segmentTable.lookup(value->getZExtValue());
+    if (!res) {
+      // the model does not bind everything the segment depends on
+      rl.resize(initialSize);
+      return false;
+    }
+
+    rl.push_back(*res);
+    assumptions.push_back(
+        Expr::createIsZero(EqExpr::create(segment, value)));
   }
-  return false;
+
+  incomplete = true;
+  return true;
 }
 
 bool AddressSpace::resolveConstantPointer(ExecutionState &state,
@@ -228,24 +463,29 @@ void AddressSpace::resolveAddressWithOffset(const ExecutionState &state,
   if (!value)
     return;
 
-  ObjectPair op;
-  for (const auto pair: concreteAddressMap) {
-    const auto& resolvedAddress = pair.first;
-    const auto& resolvedSegment = pair.second;
-    const auto *res = segmentMap.lookup(resolvedSegment);
+  // The concrete memory of different objects does not overlap, so the
+  // only object that can contain the address is the one with the closest
+  // lower (or equal) starting address.
+  const ConcreteAddressMap::value_type *pair =
+      concreteAddressMap.lookup_previous(value->getZExtValue());
+  if (!pair)
+    return;
 
-    if (!res)
-      continue;
+  const auto& resolvedAddress = pair->first;
+  const auto& resolvedSegment = pair->second;
+  const ObjectPair *res = segmentTable.lookup(resolvedSegment);
 
-    op = *objects.lookup(res->second);
-    auto subexpr = SubExpr::alloc(address, ConstantExpr::alloc(resolvedAddress, Context::get().getPointerWidth()));
-    auto check = op.first->getBoundsCheckOffset(subexpr);
-    bool mayBeTrue = false;
-    if (solver->mayBeTrue(state, check, mayBeTrue)) {
-      if (mayBeTrue) {
-        rl.push_back(op);
-        offset = cast<ConstantExpr>(address)->getZExtValue() - resolvedAddress;
-      }
+  if (!res)
+    return;
+
+  ObjectPair op = *res;
+  auto subexpr = SubExpr::alloc(address, ConstantExpr::alloc(resolvedAddress, Context::get().getPointerWidth()));
+  auto check = op.first->getBoundsCheckOffset(subexpr);
+  bool mayBeTrue = false;
+  if (solver->mayBeTrue(state, check, mayBeTrue)) {
+    if (mayBeTrue) {
+      rl.push_back(op);
+      offset = value->getZExtValue() - resolvedAddress;
     }
   }
 }
@@ -276,11 +516,14 @@ void AddressSpace::copyOutConcretes(const SegmentAddressMap &resolved, bool igno
 
       if (!os->readOnly || ignoreReadOnly) {
         if (address) {
-          auto &concreteStore = os->offsetPlane->concreteStore;
-          concreteStore.resize(os->offsetPlane->sizeBound,
-                               os->offsetPlane->initialValue);
-
-          memcpy(address, concreteStore.data(), concreteStore.size());
+          // the real memory still holds these contents from the last call
+          if (mo->copiedOutAddress == pair->second &&
+              mo->copiedOutVersion == os->contentsVersion)
+            continue;
+
+          os->copyConcreteTo(address);
+          mo->copiedOutAddress = pair->second;
+          mo->copiedOutVersion = os->contentsVersion;
         }
       }
     }
@@ -288,6 +531,9 @@ void AddressSpace::copyOutConcretes(const SegmentAddressMap &resolved, bool igno
 }
 
 bool AddressSpace::copyInConcretes(const SegmentAddressMap &resolved, ExecutionState &state, TimingSolver *solver) {
+  // the objects copied for writing are bound all at once after the walk
+  std::vector<MemoryMap::value_type> copies;
+  bool success = true;
   for (MemoryMap::iterator it = objects.begin(), ie = objects.end();
        it != ie; ++it) {
     const MemoryObject *mo = it->first;
@@ -298,23 +544,41 @@ bool AddressSpace::copyInConcretes(const SegmentAddressMap &resolved, ExecutionS
     if (!mo->isUserSpecified) {
       const ObjectState *os = it->second;
 
-      if (!copyInConcrete(mo, os, pair->second, state, solver))
-        return false;
+      if (!copyInConcrete(mo, os, pair->second, state, solver, copies)) {
+        success = false;
+        break;
+      }
     }
   }
 
-  return true;
+  bindCopies(copies);
+  return success;
 }
 
 bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
                                   const uint64_t &resolvedAddress, ExecutionState &state, TimingSolver *solver) {
+  std::vector<MemoryMap::value_type> copies;
+  bool success =
+      copyInConcrete(mo, os, resolvedAddress, state, solver, copies);
+  bindCopies(copies);
+  return success;
+}
+
+bool AddressSpace::copyInConcrete(
+    const MemoryObject *mo, const ObjectState *os,
+    const uint64_t &resolvedAddress, ExecutionState &state,
+    TimingSolver *solver, std::vector<MemoryMap::value_type> &copies) {
   auto address = reinterpret_cast<uint8_t*>(resolvedAddress);
-  auto &concreteStoreR = os->offsetPlane->concreteStore;
-  if (memcmp(address, concreteStoreR.data(), concreteStoreR.size()) != 0) {
+  if (!os->concreteEquals(address)) {
+    // the real memory no longer matches any known contents
+    if (mo->copiedOutAddress == resolvedAddress)
+      mo->copiedOutVersion = 0;
     if (os->readOnly) {
       return false;
     } else {
-      ObjectState *wos = getWriteable(mo, os);
+      ObjectState *wos = copyForWriting(mo, os);
+      if (wos != os)
+        copies.push_back(std::make_pair(mo, wos));
       writeToWOS(state, solver, address, wos);
     }
   }
@@ -322,10 +586,9 @@ bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
 }
 void AddressSpace::writeToWOS(ExecutionState &state, TimingSolver *solver,
                               const uint8_t *address, ObjectState *wos) const {
-  auto &concreteStoreW = wos->offsetPlane->concreteStore;
-  memcpy(concreteStoreW.data(), address, concreteStoreW.size());
+  wos->copyConcreteFrom(address);
 
-  if (concreteStoreW.size() == Context::get().getPointerWidth() / 8) {
+  if (wos->getSizeBound() == Context::get().getPointerWidth() / 8) {
     KValue written = wos->read(0, Context::get().getPointerWidth());
 
     ResolutionList rl;
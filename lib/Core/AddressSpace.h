@@ -10,18 +10,25 @@
 #ifndef KLEE_ADDRESSSPACE_H
 #define KLEE_ADDRESSSPACE_H
 
+#include "Memory.h"
 #include "ObjectHolder.h"
 
 #include "klee/Expr/Expr.h"
 #include "klee/Internal/ADT/ImmutableMap.h"
+#include "klee/Internal/ADT/ImmutableRadixMap.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/KValue.h"
 
+#include <vector>
+
 namespace klee {
 class ExecutionState;
+class ExprReader;
+class ExprWriter;
 class MemoryObject;
 class ObjectState;
 class TimingSolver;
+class ValueRange;
 
 template<class T> class ref;
 
@@ -35,9 +42,31 @@ struct MemoryObjectLT {
 
 typedef ImmutableMap<const MemoryObject*, ObjectHolder, MemoryObjectLT> MemoryMap;
 typedef ImmutableMap<uint64_t, const MemoryObject*> SegmentMap;
-typedef std::map</*address*/ const uint64_t, /*segment*/ const uint64_t> ConcreteAddressMap;
+typedef ImmutableRadixMap<ObjectPair> SegmentTable;
+typedef ImmutableMap</*address*/ uint64_t, /*segment*/ uint64_t> ConcreteAddressMap;
+typedef ImmutableMap</*segment*/ uint64_t, /*address*/ uint64_t> ConcreteSegmentMap;
 typedef std::map</*segment*/ const uint64_t, /*address*/ const uint64_t> SegmentAddressMap;
-typedef std::map</*segment*/ const uint64_t, /*symbolic array*/ const Array*> RemovedObjectsMap;
+
+/// Symbolic address and size of an object in the address layout used to
+/// compare pointers into different segments.
+/// The entry keeps the object alive, so its segment is not reused while a
+/// state orders pointers against it.
+struct LayoutEntry {
+  ref<Expr> address;
+  ref<Expr> size;
+  ref<const MemoryObject> object;
+};
+typedef ImmutableMap</*segment*/ uint64_t, LayoutEntry> AddressLayoutMap;
+typedef ImmutableRadixMap<ref<const MemoryObject> > RemovedObjectsMap;
+
+/// What a state knows about the size of an object of symbolic size.
+struct SymbolicSizeBounds {
+  /// Accesses that end at or below this are in bounds.
+  uint64_t inBounds = 0;
+  /// Accesses that end above this are out of bounds.
+  uint64_t maxSize = UINT64_MAX;
+};
+typedef ImmutableRadixMap<SymbolicSizeBounds> SizeBoundsMap;
 
 class AddressSpace {
   friend class ExecutionState;
@@ -49,6 +78,16 @@ private:
   /// Unsupported, use copy constructor
   AddressSpace &operator=(const AddressSpace &);
 
+  /// Hash of the bound objects and their contents versions, without the
+  /// objects in versionsPending. An object becomes pending when it is handed
+  /// out for writing, since its version changes with the write; it is
+  /// hashed again on the next getVersionsHash().
+  mutable uint64_t versionsHash = 0;
+  mutable std::vector<const MemoryObject *> versionsPending;
+
+  static uint64_t hashVersion(const MemoryObject *mo, const ObjectState *os);
+  void markVersionPending(const MemoryObject *mo, const ObjectState *os);
+
 public:
   /// The MemoryObject -> ObjectState map that constitutes the
   /// address space.
@@ -61,17 +100,59 @@ public:
 
   SegmentMap segmentMap;
 
+  /// The bound objects with a non-zero segment, indexed by segment. This
+  /// resolves constant segments in a few steps without going through
+  /// segmentMap and objects.
+  ///
+  /// \invariant holds exactly the bindings of objects with a non-zero
+  /// segment, use bindObject() and friends to modify it.
+  SegmentTable segmentTable;
+
+  /// Real addresses of objects that were given concrete backing memory
+  /// (globals, external objects, fixed objects), keyed by address.
+  ///
+  /// \invariant concreteAddressMap and concreteSegmentMap are inverse
+  /// to each other, use bindConcreteAddress() to modify them.
   ConcreteAddressMap concreteAddressMap;
 
+  /// The inverse of concreteAddressMap, keyed by segment.
+  ConcreteSegmentMap concreteSegmentMap;
+
+  /// Freed objects whose dangling pointers may still be compared, indexed
+  /// by segment. The entries keep the objects alive, so their segments are
+  /// not reused while this state may refer to them.
   RemovedObjectsMap removedObjectsMap;
 
+  /// Objects placed in the address layout of this state, keyed by segment.
+  /// Their symbolic addresses are constrained to non-overlapping ranges
+  /// in segment order, see Executor::getSymbolicAddress.
+  AddressLayoutMap addressLayout;
+
+  /// Bounds on the sizes of bound objects of symbolic size, by segment.
+  /// They follow from the constraints of this state and let accesses at
+  /// constant offsets be decided without a query, see
+  /// Executor::executeMemoryOperation.
+  SizeBoundsMap sizeBounds;
+
   AddressSpace() : cowKey(1) {}
   AddressSpace(const AddressSpace &b)
       : cowKey(++b.cowKey),
+        versionsHash(b.versionsHash),
+        versionsPending(b.versionsPending),
         objects(b.objects),
-        segmentMap(b.segmentMap) { }
+        segmentMap(b.segmentMap),
+        segmentTable(b.segmentTable),
+        concreteAddressMap(b.concreteAddressMap),
+        concreteSegmentMap(b.concreteSegmentMap),
+        removedObjectsMap(b.removedObjectsMap),
+        addressLayout(b.addressLayout),
+        sizeBounds(b.sizeBounds) { }
   ~AddressSpace() {}
 
+  /// Record that the object with the given segment is backed by real
+  /// memory at the given address. Existing bindings are not replaced.
+  void bindConcreteAddress(uint64_t address, uint64_t segment);
+
   /// Looks up constant segment in concreteAddressMap.
   /// \param segment segment to search for
   /// \param[out] address found address for given segment
@@ -131,12 +212,27 @@ public:
   /// Add a binding to the address space.
   void bindObject(const MemoryObject *mo, ObjectState *os);
 
+  /// Add a binding to an object state that this address space does not
+  /// own, so that the first write to it makes a private copy. \a os has to
+  /// be read-only or unowned.
+  void bindSharedObject(const MemoryObject *mo, const ObjectState *os);
+
   /// Remove a binding from the address space.
   void unbindObject(const MemoryObject *mo);
 
   /// Lookup a binding from a MemoryObject.
   const ObjectState *findObject(const MemoryObject *mo) const;
 
+  /// Order-independent hash of the bound objects and the versions of their
+  /// contents. Equal hashes of two address spaces imply, up to collisions,
+  /// that they bind the same objects to the same contents. Only available
+  /// while trackVersions is set.
+  uint64_t getVersionsHash() const;
+
+  /// Maintain the hash returned by getVersionsHash, off by default. It has
+  /// to be set before the first object is bound.
+  static bool trackVersions;
+
   /// \brief Obtain an ObjectState suitable for writing.
   ///
   /// This returns a writeable object state, creating a new copy of
@@ -149,6 +245,18 @@ public:
   /// \return A writeable ObjectState (\a os or a copy).
   ObjectState *getWriteable(const MemoryObject *mo, const ObjectState *os);
 
+  /// Whether \a os was copied for this address space, rather than being
+  /// shared with the address spaces it was copied from.
+  bool owns(const ObjectState *os) const {
+    return os->copyOnWriteOwner == cowKey;
+  }
+
+  /// Move the contents of the objects not shared with any other address
+  /// space to \p w, leaving the bindings in place. Nothing may touch the
+  /// objects until swapIn() reads them back.
+  void swapOut(ExprWriter &w);
+  void swapIn(ExprReader &r);
+
   /// Copy the concrete values of all managed ObjectStates into the
   /// actual system memory location they were allocated at.
   void copyOutConcretes(const SegmentAddressMap &resolved, bool ignoreReadOnly = false);
@@ -186,6 +294,27 @@ public:
   /// pointer on current platform.
   /// if yes, resolveAddressWithOffset is called to check if it is not a pointer we have already seen before.
   void writeToWOS(ExecutionState &state, TimingSolver *solver, const uint8_t *address, ObjectState *wos) const;
+
+private:
+  /// getWriteable(), except that a copy is left for the caller to bind.
+  ObjectState *copyForWriting(const MemoryObject *mo, const ObjectState *os);
+  /// Bind the copies made by copyForWriting() in one update of the maps.
+  void bindCopies(const std::vector<MemoryMap::value_type> &copies);
+  bool copyInConcrete(const MemoryObject *mo, const ObjectState *os,
+                      const uint64_t &resolvedAddress, ExecutionState &state,
+                      TimingSolver *solver,
+                      std::vector<MemoryMap::value_type> &copies);
+
+  /// Resolve a symbolic segment by asking the solver for models of the
+  /// segment one by one (blocking the segments already found) instead of
+  /// querying every object in \a range.
+  ///
+  /// \param[out] incomplete set as in resolve()
+  /// \return false iff the models could not be used, \a rl is unchanged then
+  bool resolveSegmentsBatched(ExecutionState &state, TimingSolver *solver,
+                              const KValue &pointer, const ValueRange &range,
+                              ResolutionList &rl, unsigned maxResolutions,
+                              time::Span timeout, bool &incomplete) const;
 };
 } // End klee namespace
 
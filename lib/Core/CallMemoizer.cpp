@@ -0,0 +1,206 @@
+//===-- CallMemoizer.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CallMemoizer.h"
+
+#include "klee/ExecutionState.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+/// The results kept for each function and arguments, calls reading other
+/// memory contents are not stored once they are all taken.
+const unsigned MaxEntriesPerCall = 8;
+/// The locations a call may read before it is given up on, both to bound
+/// the memory of the entries and the time to look them up.
+const unsigned MaxReadsPerCall = 4096;
+
+bool getConstant(const ref<Expr> &e, uint64_t &value) {
+  const ConstantExpr *CE = dyn_cast<ConstantExpr>(e);
+  if (!CE || CE->getWidth() > Expr::Int64)
+    return false;
+  value = CE->getZExtValue();
+  return true;
+}
+} // namespace
+
+bool CallMemoizer::matches(const ExecutionState &state, const Entry &entry) {
+  for (const Read &read : entry.reads) {
+    const ObjectState *os = state.addressSpace.findObject(read.object.get());
+    if (!os)
+      return false;
+    KValue value = os->read(read.offset, read.width);
+    if (value.getValue() != read.value.getValue() ||
+        value.getSegment() != read.value.getSegment())
+      return false;
+  }
+  return true;
+}
+
+bool CallMemoizer::lookup(ExecutionState &state, const Function *f,
+                          const std::vector<Cell> &arguments,
+                          Expr::Width width, KValue &result) {
+  Key key(f, std::vector<uint64_t>());
+  for (const Cell &argument : arguments) {
+    uint64_t segment, offset;
+    if (!getConstant(argument.getSegment(), segment) ||
+        !getConstant(argument.getOffset(), offset))
+      return false;
+    key.second.push_back(segment);
+    key.second.push_back(offset);
+  }
+
+  auto it = entries.find(key);
+  if (it == entries.end())
+    return false;
+  for (const Entry &entry : it->second) {
+    if (entry.result.getWidth() != width || !matches(state, entry))
+      continue;
+    FunctionStats &fs = functionStats[f];
+    ++fs.calls;
+    ++fs.hits;
+    fs.instructionsSaved += entry.instructions;
+    // the calls being recorded depend on what this one read
+    for (StackFrame &sf : state.stack) {
+      if (!sf.recording || !sf.recording->pure)
+        continue;
+      for (const Read &read : entry.reads)
+        noteRead(*sf.recording, read.object.get(), read.offset, read.value);
+    }
+    result = entry.result;
+    return true;
+  }
+  return false;
+}
+
+void CallMemoizer::startRecording(ExecutionState &state, const Function *f,
+                                  const std::vector<Cell> &arguments) {
+  if (f->isVarArg() || f->getReturnType()->isVoidTy())
+    return;
+
+  auto recording = std::make_shared<CallRecording>();
+  for (const Cell &argument : arguments) {
+    uint64_t segment, offset;
+    if (!getConstant(argument.getSegment(), segment) ||
+        !getConstant(argument.getOffset(), offset))
+      return;
+    recording->arguments.push_back(segment);
+    recording->arguments.push_back(offset);
+  }
+  recording->function = f;
+  recording->firstObjectId = MemoryObject::getNextId();
+  recording->startInstructions = state.steppedInstructions;
+  recording->pure = true;
+  ++functionStats[f].calls;
+  state.stack.back().recording = std::move(recording);
+}
+
+void CallMemoizer::finish(ExecutionState &state,
+                          const std::shared_ptr<CallRecording> &recording,
+                          const KValue &result) {
+  uint64_t segment, offset;
+  // a pointer result could refer to an object of the call itself
+  if (!recording->pure || !getConstant(result.getSegment(), segment) ||
+      segment != VALUES_SEGMENT || !getConstant(result.getOffset(), offset))
+    return;
+
+  Key key(recording->function, recording->arguments);
+  std::vector<Entry> &calls = entries[key];
+  if (calls.size() >= MaxEntriesPerCall)
+    return;
+
+  Entry entry;
+  entry.reads.reserve(recording->reads.size());
+  for (const auto &read : recording->reads)
+    entry.reads.push_back({std::get<0>(read.first), std::get<1>(read.first),
+                           std::get<2>(read.first), read.second});
+  entry.result = result;
+  entry.instructions = state.steppedInstructions - recording->startInstructions;
+  calls.push_back(std::move(entry));
+  ++functionStats[recording->function].entries;
+}
+
+bool CallMemoizer::isRecording(const ExecutionState &state) {
+  for (const StackFrame &sf : state.stack)
+    if (sf.recording && sf.recording->pure)
+      return true;
+  return false;
+}
+
+void CallMemoizer::noteRead(CallRecording &recording, const MemoryObject *mo,
+                            uint64_t offset, const KValue &value) {
+  if (mo->id >= recording.firstObjectId)
+    return;
+  if (recording.reads.size() >= MaxReadsPerCall) {
+    recording.pure = false;
+    return;
+  }
+  recording.reads.emplace(std::make_tuple(mo, offset, value.getWidth()),
+                          value);
+}
+
+void CallMemoizer::noteRead(ExecutionState &state, const MemoryObject *mo,
+                            const ref<Expr> &offset, const KValue &value) {
+  uint64_t offsetValue;
+  bool concrete = getConstant(offset, offsetValue) && value.isConstant();
+  for (StackFrame &sf : state.stack) {
+    if (!sf.recording || !sf.recording->pure)
+      continue;
+    if (concrete)
+      noteRead(*sf.recording, mo, offsetValue, value);
+    else
+      sf.recording->pure = false;
+  }
+}
+
+void CallMemoizer::noteWrite(ExecutionState &state, const MemoryObject *mo) {
+  for (StackFrame &sf : state.stack)
+    if (sf.recording && mo->id < sf.recording->firstObjectId)
+      sf.recording->pure = false;
+}
+
+void CallMemoizer::noteImpure(ExecutionState &state) {
+  for (StackFrame &sf : state.stack)
+    if (sf.recording)
+      sf.recording->pure = false;
+}
+
+void CallMemoizer::report(raw_ostream &os) const {
+  std::vector<std::pair<const Function *, FunctionStats> > counts;
+  for (const auto &entry : functionStats)
+    if (entry.second.entries)
+      counts.push_back(entry);
+  if (counts.empty())
+    return;
+  std::sort(counts.begin(), counts.end(),
+            [](const std::pair<const Function *, FunctionStats> &a,
+               const std::pair<const Function *, FunctionStats> &b) {
+              if (a.second.instructionsSaved != b.second.instructionsSaved)
+                return a.second.instructionsSaved > b.second.instructionsSaved;
+              return a.first->getName() < b.first->getName();
+            });
+
+  os << "Calls memoized by -memoize-calls, by function:\n";
+  const unsigned shown = 10;
+  for (unsigned i = 0; i != counts.size() && i != shown; ++i) {
+    const FunctionStats &fs = counts[i].second;
+    os << "  " << counts[i].first->getName() << ": " << fs.hits << " of "
+       << fs.calls << " calls hit (" << (fs.calls ? 100 * fs.hits / fs.calls : 0)
+       << "%), " << fs.entries << " results cached, " << fs.instructionsSaved
+       << " instructions saved\n";
+  }
+  if (counts.size() > shown)
+    os << "  ... and " << counts.size() - shown << " other functions\n";
+}
@@ -0,0 +1,127 @@
+//===-- CallMemoizer.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CALLMEMOIZER_H
+#define KLEE_CALLMEMOIZER_H
+
+#include "Memory.h"
+
+#include "klee/Expr/Expr.h"
+#include "klee/Internal/Module/Cell.h"
+#include "klee/KValue.h"
+
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace llvm {
+  class Function;
+  class raw_ostream;
+}
+
+namespace klee {
+  class ExecutionState;
+
+  /// What a call being recorded by the CallMemoizer has read so far, hung
+  /// off the frame of the callee.
+  struct CallRecording {
+    const llvm::Function *function;
+    /// The segments and offsets of the arguments, in turn.
+    std::vector<uint64_t> arguments;
+    /// The objects allocated by the call have ids from this one on, their
+    /// contents only depend on the call itself.
+    unsigned firstObjectId;
+    uint64_t startInstructions;
+    /// Whether the call still only depends on its arguments and the
+    /// concrete memory it read.
+    bool pure;
+    /// The first value read from each location of the objects which
+    /// existed before the call, by object, offset and width.
+    std::map<std::tuple<const MemoryObject *, uint64_t, Expr::Width>, KValue>
+        reads;
+  };
+
+  /// CallMemoizer - Caches the results of the calls which only depended on
+  /// concrete arguments and concrete memory, used by -memoize-calls.
+  ///
+  /// A call is recorded while it runs: every read of an object that
+  /// existed before the call is kept with the value it returned. The call
+  /// is given up on once it reads a symbolic value or at a symbolic
+  /// offset, writes to an object it did not allocate, calls an external or
+  /// special function, or the state forks or takes an error path in it.
+  /// Once a call returns a concrete value, the same call on any state whose
+  /// memory holds the same values at the recorded locations returns it
+  /// without being run again.
+  class CallMemoizer {
+    struct Read {
+      ref<const MemoryObject> object;
+      uint64_t offset;
+      Expr::Width width;
+      KValue value;
+    };
+
+    struct Entry {
+      std::vector<Read> reads;
+      KValue result;
+      /// The instructions the call took when it was recorded.
+      uint64_t instructions;
+    };
+
+    struct FunctionStats {
+      uint64_t calls = 0;
+      uint64_t hits = 0;
+      uint64_t entries = 0;
+      uint64_t instructionsSaved = 0;
+    };
+
+    typedef std::pair<const llvm::Function *, std::vector<uint64_t> > Key;
+    std::map<Key, std::vector<Entry> > entries;
+    std::map<const llvm::Function *, FunctionStats> functionStats;
+
+    /// Whether \a entry holds for the memory of \a state.
+    static bool matches(const ExecutionState &state, const Entry &entry);
+    static void noteRead(CallRecording &recording, const MemoryObject *mo,
+                         uint64_t offset, const KValue &value);
+
+  public:
+    /// Look the call of \a f with \a arguments up for \a state, setting
+    /// \a result, of width \a width, on a hit.
+    bool lookup(ExecutionState &state, const llvm::Function *f,
+                const std::vector<Cell> &arguments, Expr::Width width,
+                KValue &result);
+
+    /// Start recording the call of \a f whose frame \a state just pushed,
+    /// if the call is one that can be memoized.
+    void startRecording(ExecutionState &state, const llvm::Function *f,
+                        const std::vector<Cell> &arguments);
+
+    /// Store the call recorded in \a recording, whose frame \a state just
+    /// popped, returning \a result.
+    void finish(ExecutionState &state,
+                const std::shared_ptr<CallRecording> &recording,
+                const KValue &result);
+
+    /// Whether a call is being recorded on the stack of \a state.
+    static bool isRecording(const ExecutionState &state);
+
+    /// Note a read of \a value at \a offset of \a mo by \a state.
+    static void noteRead(ExecutionState &state, const MemoryObject *mo,
+                         const ref<Expr> &offset, const KValue &value);
+    /// Note a write to \a mo by \a state.
+    static void noteWrite(ExecutionState &state, const MemoryObject *mo);
+    /// Give up on all the calls recorded on the stack of \a state.
+    static void noteImpure(ExecutionState &state);
+
+    /// Print the calls and hits by function.
+    void report(llvm::raw_ostream &os) const;
+  };
+}
+
+#endif /* KLEE_CALLMEMOIZER_H */
@@ -11,8 +11,6 @@
 
 #include "klee/Statistics.h"
 
-#include <map>
-#include <vector>
 #include "llvm/IR/Function.h"
 
 #include "llvm/Support/raw_ostream.h"
@@ -24,12 +22,17 @@ using namespace klee;
 CallPathNode::CallPathNode(CallPathNode *_parent,
                            const llvm::Instruction *_callSite,
                            const llvm::Function *_function)
-    : parent(_parent), callSite(_callSite), function(_function), count(0) {}
+    : parent(_parent), callSite(_callSite), function(_function),
+      depth(_parent ? _parent->depth + 1 : 0), count(0) {}
 
 void CallPathNode::print() {
-  llvm::errs() << "  (Function: " << this->function->getName() << ", "
-               << "Callsite: " << callSite << ", "
-               << "Count: " << this->count << ")";
+  if (isSummary())
+    llvm::errs() << "  (Calls below depth " << parent->depth << ", "
+                 << "Count: " << this->count << ")";
+  else
+    llvm::errs() << "  (Function: " << this->function->getName() << ", "
+                 << "Callsite: " << callSite << ", "
+                 << "Count: " << this->count << ")";
   if (parent && parent->callSite) {
     llvm::errs() << ";\n";
     parent->print();
@@ -39,22 +42,26 @@ void CallPathNode::print() {
 
 ///
 
-CallPathManager::CallPathManager() : root(nullptr, nullptr, nullptr) {}
+CallPathManager::CallPathManager(unsigned maxDepth)
+    : root(nullptr, nullptr, nullptr), maxDepth(maxDepth) {}
 
 void CallPathManager::getSummaryStatistics(CallSiteSummaryTable &results) {
   results.clear();
 
   for (auto &path : paths)
-    path->summaryStatistics = path->statistics;
+    path.summaryStatistics = path.statistics;
 
   // compute summary bottom up, while building result table
   for (auto it = paths.rbegin(), ie = paths.rend(); it != ie; ++it) {
-    const auto &cp = (*it);
-    cp->parent->summaryStatistics += cp->summaryStatistics;
-
-    CallSiteInfo &csi = results[cp->callSite][cp->function];
-    csi.count += cp->count;
-    csi.statistics += cp->summaryStatistics;
+    CallPathNode &cp = *it;
+    cp.parent->summaryStatistics += cp.summaryStatistics;
+
+    // merged calls only count towards the call sites above them
+    if (cp.isSummary())
+      continue;
+    CallSiteInfo &csi = results[cp.callSite][cp.function];
+    csi.count += cp.count;
+    csi.statistics += cp.summaryStatistics;
   }
 }
 
@@ -65,10 +72,22 @@ CallPathNode *CallPathManager::computeCallPath(CallPathNode *parent,
     if (cs==p->callSite && f==p->function)
       return p;
 
-  auto cp = std::unique_ptr<CallPathNode>(new CallPathNode(parent, cs, f));
-  auto newCP = cp.get();
-  paths.emplace_back(std::move(cp));
-  return newCP;
+  // all calls below the maximum depth share a single summary node
+  if (maxDepth && parent->depth >= maxDepth) {
+    if (parent->isSummary())
+      return parent;
+    std::pair<const llvm::Instruction *, const llvm::Function *> key(nullptr,
+                                                                     nullptr);
+    auto it = parent->children.find(key);
+    if (it != parent->children.end())
+      return it->second;
+    paths.emplace_back(parent, nullptr, nullptr);
+    parent->children.insert(std::make_pair(key, &paths.back()));
+    return &paths.back();
+  }
+
+  paths.emplace_back(parent, cs, f);
+  return &paths.back();
 }
 
 CallPathNode *CallPathManager::getCallPath(CallPathNode *parent,
@@ -12,9 +12,9 @@
 
 #include "klee/Statistics.h"
 
-#include <map>
-#include <memory>
-#include <vector>
+#include "llvm/ADT/DenseMap.h"
+
+#include <deque>
 
 namespace llvm {
   class Instruction;
@@ -32,17 +32,21 @@ namespace klee {
     CallSiteInfo() : count(0) {}
   };
 
-  typedef std::map<const llvm::Instruction *,
-                   std::map<const llvm::Function *, CallSiteInfo>>
+  /// Most call sites call a single function, so the functions of a call
+  /// site are kept inline.
+  typedef llvm::DenseMap<const llvm::Instruction *,
+                         llvm::SmallDenseMap<const llvm::Function *,
+                                             CallSiteInfo, 1>>
       CallSiteSummaryTable;
 
   class CallPathNode {
     friend class CallPathManager;
 
   public:
-    typedef std::map<
+    /// Most nodes have a handful of callees, which are kept inline.
+    typedef llvm::SmallDenseMap<
         std::pair<const llvm::Instruction *, const llvm::Function *>,
-        CallPathNode *>
+        CallPathNode *, 4>
         children_ty;
 
     // form list of (callSite,function) path
@@ -50,6 +54,8 @@ namespace klee {
     const llvm::Instruction *callSite;
     const llvm::Function *function;
     children_ty children;
+    /// The number of calls from the root to this node.
+    unsigned depth;
 
     StatisticRecord statistics;
     StatisticRecord summaryStatistics;
@@ -59,12 +65,20 @@ namespace klee {
     CallPathNode(CallPathNode *parent, const llvm::Instruction *callSite,
                  const llvm::Function *function);
 
+    /// Whether this node stands for all calls below a node at the maximum
+    /// depth rather than for a single call site and function.
+    bool isSummary() const { return !function; }
+
     void print();
   };
 
   class CallPathManager {
     CallPathNode root;
-    std::vector<std::unique_ptr<CallPathNode>> paths;
+    /// All nodes but the root in the order of their creation, so parents
+    /// come before their children. Nodes never move once created.
+    std::deque<CallPathNode> paths;
+    /// The depth below which calls are merged into a summary node, or 0.
+    unsigned maxDepth;
 
   private:
     CallPathNode *computeCallPath(CallPathNode *parent,
@@ -72,7 +86,7 @@ namespace klee {
                                   const llvm::Function *f);
 
   public:
-    CallPathManager();
+    explicit CallPathManager(unsigned maxDepth = 0);
     ~CallPathManager() = default;
 
     void getSummaryStatistics(CallSiteSummaryTable &result);
@@ -0,0 +1,232 @@
+//===-- Checkpoint.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Checkpoint.h"
+
+#include "CoreStats.h"
+
+#include "klee/Statistic.h"
+#include "klee/Statistics.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_set>
+
+using namespace klee;
+
+namespace {
+  const char Magic[8] = {'K', 'L', 'E', 'E', 'C', 'K', 'P', '1'};
+
+  // record kinds
+  const char Fork = 'F';
+  const char End = 'E';
+  const char Covered = 'I';
+  const char Checkpoint = 'C';
+
+  template <typename T> void put(std::string &out, T value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  /// Reads the records of a checkpoint file, failing past its end.
+  class RecordReader {
+    const std::string &data;
+    size_t pos;
+
+  public:
+    RecordReader(const std::string &data, size_t pos) : data(data), pos(pos) {}
+
+    bool atEnd() const { return pos == data.size(); }
+    size_t position() const { return pos; }
+
+    template <typename T> bool get(T &value) {
+      if (data.size() - pos < sizeof(value))
+        return false;
+      memcpy(&value, data.data() + pos, sizeof(value));
+      pos += sizeof(value);
+      return true;
+    }
+
+    bool get(std::string &value, size_t size) {
+      if (data.size() - pos < size)
+        return false;
+      value.assign(data, pos, size);
+      pos += size;
+      return true;
+    }
+  };
+}
+
+CheckpointLog::CheckpointLog(std::unique_ptr<llvm::raw_fd_ostream> _file,
+                             unsigned instructions)
+    : file(std::move(_file)), covered(instructions) {
+  file->write(Magic, sizeof(Magic));
+  file->flush();
+}
+
+// the records since the last checkpoint are dropped, the file ends with a
+// complete checkpoint
+CheckpointLog::~CheckpointLog() = default;
+
+void CheckpointLog::fork(std::uint64_t parent,
+                         const std::vector<std::uint64_t> &children) {
+  pending += Fork;
+  put(pending, parent);
+  put(pending, static_cast<std::uint32_t>(children.size()));
+  for (std::uint64_t child : children)
+    put(pending, child);
+}
+
+void CheckpointLog::end(std::uint64_t id) {
+  pending += End;
+  put(pending, id);
+}
+
+void CheckpointLog::checkpoint() {
+  StatisticManager &sm = *theStatisticManager;
+  if (sm.hasIndexedStats()) {
+    for (unsigned id = 0; id != covered.size(); ++id) {
+      if (covered[id] || !sm.getIndexedValue(stats::coveredInstructions, id))
+        continue;
+      covered[id] = true;
+      pending += Covered;
+      put(pending, static_cast<std::uint32_t>(id));
+    }
+  }
+
+  pending += Checkpoint;
+  put(pending, static_cast<std::uint32_t>(sm.getNumStatistics()));
+  for (unsigned i = 0; i != sm.getNumStatistics(); ++i) {
+    Statistic &s = sm.getStatistic(i);
+    put(pending, static_cast<std::uint16_t>(s.getName().size()));
+    pending += s.getName();
+    put(pending, sm.getValue(s));
+  }
+
+  file->write(pending.data(), pending.size());
+  file->flush();
+  pending.clear();
+}
+
+bool ResumeTree::read(const std::string &path, std::string &error) {
+  std::ifstream is(path, std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(is)),
+                   std::istreambuf_iterator<char>());
+  if (!is.good() && !is.eof()) {
+    error = "cannot read " + path;
+    return false;
+  }
+  if (data.size() < sizeof(Magic) || memcmp(data.data(), Magic, sizeof(Magic))) {
+    error = path + " is not a checkpoint file";
+    return false;
+  }
+
+  // apply the records up to the last complete checkpoint
+  std::unordered_map<std::uint64_t, std::vector<std::uint64_t>> allForks;
+  std::vector<std::pair<std::uint64_t, std::vector<std::uint64_t>>> newForks;
+  std::unordered_set<std::uint64_t> ended;
+  std::vector<std::uint64_t> newEnded;
+  std::vector<unsigned> newCovered;
+  bool complete = false;
+  RecordReader r(data, sizeof(Magic));
+  while (!r.atEnd()) {
+    char kind;
+    if (!r.get(kind))
+      break;
+    if (kind == Fork) {
+      std::uint64_t parent;
+      std::uint32_t n;
+      if (!r.get(parent) || !r.get(n))
+        break;
+      std::vector<std::uint64_t> children(n);
+      bool ok = true;
+      for (auto &child : children)
+        ok = ok && r.get(child);
+      if (!ok)
+        break;
+      newForks.emplace_back(parent, std::move(children));
+    } else if (kind == End) {
+      std::uint64_t id;
+      if (!r.get(id))
+        break;
+      newEnded.push_back(id);
+    } else if (kind == Covered) {
+      std::uint32_t id;
+      if (!r.get(id))
+        break;
+      newCovered.push_back(id);
+    } else if (kind == Checkpoint) {
+      std::uint32_t n;
+      if (!r.get(n))
+        break;
+      std::vector<std::pair<std::string, std::uint64_t>> values(n);
+      bool ok = true;
+      for (auto &value : values) {
+        std::uint16_t size;
+        ok = ok && r.get(size) && r.get(value.first, size) &&
+             r.get(value.second);
+      }
+      if (!ok)
+        break;
+      for (auto &f : newForks) {
+        for (std::uint64_t child : f.second)
+          maxId = std::max(maxId, child);
+        allForks[f.first] = std::move(f.second);
+      }
+      ended.insert(newEnded.begin(), newEnded.end());
+      covered.insert(covered.end(), newCovered.begin(), newCovered.end());
+      statistics = std::move(values);
+      newForks.clear();
+      newEnded.clear();
+      newCovered.clear();
+      complete = true;
+    } else {
+      break;
+    }
+  }
+  if (!complete) {
+    error = path + " holds no complete checkpoint";
+    return false;
+  }
+
+  // keep the forks that lead to a state still alive, children of forks
+  // first so that each fork sees whether its children are needed
+  std::vector<std::uint64_t> order, stack{1};
+  while (!stack.empty()) {
+    std::uint64_t id = stack.back();
+    stack.pop_back();
+    order.push_back(id);
+    auto it = allForks.find(id);
+    if (it != allForks.end())
+      for (std::uint64_t child : it->second)
+        if (child)
+          stack.push_back(child);
+  }
+  std::unordered_set<std::uint64_t> needed;
+  for (auto it = order.rbegin(), ie = order.rend(); it != ie; ++it) {
+    auto f = allForks.find(*it);
+    if (f == allForks.end()) {
+      if (!ended.count(*it))
+        needed.insert(*it);
+      continue;
+    }
+    for (std::uint64_t &child : f->second)
+      if (child && !needed.count(child))
+        child = 0;
+    for (std::uint64_t child : f->second)
+      if (child) {
+        needed.insert(*it);
+        forks[*it] = f->second;
+        break;
+      }
+  }
+  return true;
+}
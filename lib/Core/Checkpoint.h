@@ -0,0 +1,79 @@
+//===-- Checkpoint.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CHECKPOINT_H
+#define KLEE_CHECKPOINT_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace llvm {
+  class raw_fd_ostream;
+}
+
+namespace klee {
+
+  /// CheckpointLog - The forks and terminations of an exploration,
+  /// written with -checkpoint-interval to the file checkpoint in the
+  /// output directory, from which -resume-from continues the exploration.
+  ///
+  /// Every state carries the id of the fork that created it. A fork record
+  /// holds the ids of the states it created, an end record the id of a
+  /// terminated state. The records are kept in memory and appended at each
+  /// checkpoint together with the newly covered instructions and the
+  /// statistics, so a checkpoint writes what changed since the previous
+  /// one and the file stays usable up to its last checkpoint whenever the
+  /// run is killed.
+  class CheckpointLog {
+    std::unique_ptr<llvm::raw_fd_ostream> file;
+    std::string pending;
+    /// The instructions covered as of the last checkpoint, by
+    /// InstructionInfo id.
+    std::vector<bool> covered;
+
+  public:
+    /// Log to \a file, noting the coverage of \a instructions instructions
+    /// if the indexed statistics are kept.
+    CheckpointLog(std::unique_ptr<llvm::raw_fd_ostream> file,
+                  unsigned instructions);
+    ~CheckpointLog();
+
+    void fork(std::uint64_t parent, const std::vector<std::uint64_t> &children);
+    void end(std::uint64_t id);
+
+    /// Append the records since the last checkpoint, the instructions
+    /// covered since and the values of all statistics.
+    void checkpoint();
+  };
+
+  /// ResumeTree - The forks of a checkpoint file that lead to the states
+  /// alive at its last checkpoint.
+  class ResumeTree {
+  public:
+    /// The ids of the states each fork created, in the order of the
+    /// branch conditions, zero for the ones fully explored before.
+    std::unordered_map<std::uint64_t, std::vector<std::uint64_t>> forks;
+    /// The largest id in the file.
+    std::uint64_t maxId = 0;
+    /// The values of the statistics at the checkpoint, by name.
+    std::vector<std::pair<std::string, std::uint64_t>> statistics;
+    /// The instructions covered at the checkpoint, by InstructionInfo id.
+    std::vector<unsigned> covered;
+
+    /// Read the checkpoint file \a path. Return false with \a error set if
+    /// it cannot be read or holds no checkpoint.
+    bool read(const std::string &path, std::string &error);
+  };
+
+}
+
+#endif /* KLEE_CHECKPOINT_H */
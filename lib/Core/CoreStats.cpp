@@ -12,18 +12,90 @@
 using namespace klee;
 
 Statistic stats::allocations("Allocations", "Alloc");
+Statistic stats::boundsCheckCombinedQueries("BoundsCheckCombinedQueries", "BCcomb");
+Statistic stats::boundsCheckOffsetQueries("BoundsCheckOffsetQueries", "BCoff");
+Statistic stats::boundsCheckSegmentQueries("BoundsCheckSegmentQueries", "BCseg");
+Statistic stats::boundsChecksFolded("BoundsChecksFolded", "BCfold");
+Statistic stats::compactedStates("CompactedStates", "Compacted");
+Statistic stats::cowBytesCopied("CopyOnWriteBytes", "CoWbytes");
 Statistic stats::coveredInstructions("CoveredInstructions", "Icov");
+Statistic stats::deferredStates("DeferredStates", "Deferred");
+Statistic stats::duplicateStates("DuplicateStates", "Dup");
+Statistic stats::exprAllocations("ExprAllocations", "ExprAlloc");
+Statistic stats::exprDepthConcretizations("ExprDepthConcretizations",
+                                          "ExprDepthConc");
 Statistic stats::falseBranches("FalseBranches", "Bf");
 Statistic stats::forkTime("ForkTime", "Ftime");
 Statistic stats::forks("Forks", "Forks");
+Statistic stats::ifConvertedSelects("IfConvertedSelects", "IfConvSel");
+Statistic stats::infeasibleSeedBranches("InfeasibleSeedBranches",
+                                        "SeedBrInf");
 Statistic stats::instructionRealTime("InstructionRealTimes", "Ireal");
 Statistic stats::instructionTime("InstructionTimes", "Itime");
 Statistic stats::instructions("Instructions", "I");
+Statistic stats::knownBitsQueries("KnownBitsQueries", "KBitsQ");
+Statistic stats::lazyPointerInitializations("LazyPointerInitializations",
+                                            "LazyPtrs");
+Statistic stats::loopsSummarized("LoopsSummarized", "LoopSum");
+Statistic stats::mergedSolverTime("MergedSolverTime", "MStime");
+Statistic stats::mergedStates("MergedStates", "Merged");
 Statistic stats::minDistToReturn("MinDistToReturn", "Rdist");
 Statistic stats::minDistToUncovered("MinDistToUncovered", "UCdist");
+Statistic stats::modelQueries("ModelQueries", "ModelQ");
+Statistic stats::nativelyCoveredInstructions("NativelyCoveredInstructions",
+                                             "IcovNative");
+Statistic stats::pathQueries("PathQueries", "PathQ");
+Statistic stats::pureCallCongruences("PureCallCongruences", "PureCong");
+Statistic stats::pureCallsShared("PureCallsShared", "PureShared");
+Statistic stats::rangeQueries("RangeQueries", "RangeQ");
 Statistic stats::reachableUncovered("ReachableUncovered", "IuncovReach");
 Statistic stats::resolveTime("ResolveTime", "Rtime");
+Statistic stats::seedDecidedBranches("SeedDecidedBranches", "SeedBr");
 Statistic stats::solverTime("SolverTime", "Stime");
+Statistic stats::solverTimeoutEscalations("SolverTimeoutEscalations", "STesc");
+Statistic stats::splitObjectReads("SplitObjectReads", "SplitReads");
+Statistic stats::stateForkBytes("StateForkBytes", "SFbytes");
 Statistic stats::states("States", "States");
+Statistic stats::subsumedStates("SubsumedStates", "Subsumed");
+Statistic stats::summarizedCalls("SummarizedCalls", "SumCalls");
 Statistic stats::trueBranches("TrueBranches", "Bt");
 Statistic stats::uncoveredInstructions("UncoveredInstructions", "Iuncov");
+Statistic stats::unreachableBranches("UnreachableBranches", "UnreachBr");
+
+// indexed by QueryPurpose
+Statistic stats::purposeQueries[] = {
+    {"OtherQueries", "OthQ"},
+    {"BranchQueries", "BrQ"},
+    {"BoundsCheckQueries", "BCQ"},
+    {"ResolutionQueries", "ResQ"},
+    {"PointerComparisonQueries", "PtrQ"},
+    {"ConcretizationQueries", "ConcQ"},
+    {"TestGenerationQueries", "TGQ"}
+};
+Statistic stats::purposeQueryTime[] = {
+    {"OtherQueryTime", "OthQtime"},
+    {"BranchQueryTime", "BrQtime"},
+    {"BoundsCheckQueryTime", "BCQtime"},
+    {"ResolutionQueryTime", "ResQtime"},
+    {"PointerComparisonQueryTime", "PtrQtime"},
+    {"ConcretizationQueryTime", "ConcQtime"},
+    {"TestGenerationQueryTime", "TGQtime"}
+};
+Statistic stats::purposeQueryCacheHits[] = {
+    {"OtherQueryCacheHits", "OthQhits"},
+    {"BranchQueryCacheHits", "BrQhits"},
+    {"BoundsCheckQueryCacheHits", "BCQhits"},
+    {"ResolutionQueryCacheHits", "ResQhits"},
+    {"PointerComparisonQueryCacheHits", "PtrQhits"},
+    {"ConcretizationQueryCacheHits", "ConcQhits"},
+    {"TestGenerationQueryCacheHits", "TGQhits"}
+};
+Statistic stats::purposeQueryTimeouts[] = {
+    {"OtherQueryTimeouts", "OthQto"},
+    {"BranchQueryTimeouts", "BrQto"},
+    {"BoundsCheckQueryTimeouts", "BCQto"},
+    {"ResolutionQueryTimeouts", "ResQto"},
+    {"PointerComparisonQueryTimeouts", "PtrQto"},
+    {"ConcretizationQueryTimeouts", "ConcQto"},
+    {"TestGenerationQueryTimeouts", "TGQto"}
+};
@@ -22,6 +22,10 @@ namespace stats {
   extern Statistic instructionRealTime;
   extern Statistic coveredInstructions;
   extern Statistic uncoveredInstructions;  
+
+  /// Number of instructions first covered by running a generated test
+  /// natively (see -native-coverage-command).
+  extern Statistic nativelyCoveredInstructions;
   extern Statistic trueBranches;
   extern Statistic falseBranches;
   extern Statistic forkTime;
@@ -30,6 +34,113 @@ namespace stats {
   /// The number of process forks.
   extern Statistic forks;
 
+  /// Number of concrete memory bytes duplicated when a forked state first
+  /// writes to a page it still shares.
+  extern Statistic cowBytesCopied;
+
+  /// Number of reads at symbolic offsets that referred to a few windows of
+  /// a large object instead of all of it (see -split-objects).
+  extern Statistic splitObjectReads;
+
+  /// Approximate number of bytes copied when forking execution states.
+  extern Statistic stateForkBytes;
+
+  /// Number of states merged into others, and the solver time spent on
+  /// behalf of states that resulted from a merge.
+  extern Statistic mergedStates;
+  extern Statistic mergedSolverTime;
+
+  /// Number of times a state left unscheduled was compacted into memory
+  /// (see -compact-states-after).
+  extern Statistic compactedStates;
+
+  /// Number of states dropped because an equivalent state had already
+  /// been seen at the same block entry.
+  extern Statistic duplicateStates;
+
+  /// Number of states dropped because their constraints implied the
+  /// interpolant of an explored subtree at the same point (see
+  /// -subsume-states).
+  extern Statistic subsumedStates;
+
+  /// Number of retries of timed out queries with a larger budget, and of
+  /// states paused after their query timed out (see
+  /// -adaptive-solver-timeout).
+  extern Statistic solverTimeoutEscalations;
+  extern Statistic deferredStates;
+
+  /// Number of branches the seeds decided without a solver query, and of
+  /// the sides no seed took that then turned out infeasible (see
+  /// -fast-seed-replay).
+  extern Statistic seedDecidedBranches;
+  extern Statistic infeasibleSeedBranches;
+
+  /// Number of branch targets not taken because no error site is
+  /// reachable from them (see -prune-unreachable-errors).
+  extern Statistic unreachableBranches;
+
+  /// Number of expressions created, charged to the instruction being
+  /// executed when they were.
+  extern Statistic exprAllocations;
+
+  /// Number of values concretized because their expressions grew deeper
+  /// than -max-expr-depth.
+  extern Statistic exprDepthConcretizations;
+
+  /// Number of selects introduced by -if-convert executed on a symbolic
+  /// condition, each in place of a branch that may have forked.
+  extern Statistic ifConvertedSelects;
+
+  /// Number of nondet pointers initialized at their first dereference
+  /// (see -lazy-nondet-pointers).
+  extern Statistic lazyPointerInitializations;
+
+  /// Number of loops run in a single step by -summarize-loops.
+  extern Statistic loopsSummarized;
+
+  /// Number of calls whose result was bound from the summary of the
+  /// function (see -summarize-functions).
+  extern Statistic summarizedCalls;
+
+  /// Number of calls of undefined functions assumed pure that returned
+  /// the result of an earlier call with the same arguments, and of
+  /// constraints equating the results of calls whose arguments may be
+  /// equal.
+  extern Statistic pureCallsShared;
+  extern Statistic pureCallCongruences;
+
+  /// Number of queries decided from the bounds of the bytes they read,
+  /// without asking the solver chain.
+  extern Statistic rangeQueries;
+
+  /// Number of queries decided from the bits known in the expressions they
+  /// are built from, without asking the solver chain.
+  extern Statistic knownBitsQueries;
+
+  /// Number of queries decided from the model kept for the state (see
+  /// -reuse-models), without asking the solver chain.
+  extern Statistic modelQueries;
+
+  /// Number of queries decided by the result of the same query earlier on
+  /// the path, maybe before the state was forked.
+  extern Statistic pathQueries;
+
+  /// Number of solver queries issued by the memory access bounds checks,
+  /// split by what they checked (segment only, offset only, or both at
+  /// once), and the number of checks answered without a solver query.
+  extern Statistic boundsCheckSegmentQueries;
+  extern Statistic boundsCheckOffsetQueries;
+  extern Statistic boundsCheckCombinedQueries;
+  extern Statistic boundsChecksFolded;
+
+  /// Number of solver queries, their time (in microseconds), the number
+  /// of them answered without the core solver, and the number of them that
+  /// failed, for each QueryPurpose.
+  extern Statistic purposeQueries[];
+  extern Statistic purposeQueryTime[];
+  extern Statistic purposeQueryCacheHits[];
+  extern Statistic purposeQueryTimeouts[];
+
   /// Number of states, this is a "fake" statistic used by istats, it
   /// isn't normally up-to-date.
   extern Statistic states;
@@ -0,0 +1,175 @@
+//===-- ErrorReachability.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ErrorReachability.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/Support/ModuleUtil.h"
+
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/Instructions.h"
+
+#include <map>
+#include <unordered_map>
+
+using namespace llvm;
+using namespace klee;
+
+ErrorReachability::ErrorReachability(
+    const KModule &module, const std::set<const Function *> &errorFunctions)
+    : reachesError(module.infos->getMaxID()),
+      reachesReturn(module.infos->getMaxID()),
+      errorAfterCall(module.infos->getMaxID()),
+      returnAfterCall(module.infos->getMaxID()) {
+  // Compute call targets the way StatsTracker does, indirect calls may
+  // hit all escaping functions.
+  std::unordered_map<const Instruction *, std::vector<const Function *> >
+      callTargets;
+  std::map<const Function *, std::vector<const Function *> > callers;
+  for (const auto &kf : module.functions) {
+    for (auto &bb : *kf->function) {
+      for (auto &inst : bb) {
+        if (!isa<CallInst>(inst) && !isa<InvokeInst>(inst))
+          continue;
+        CallSite cs(&inst);
+        std::vector<const Function *> &targets = callTargets[&inst];
+        if (isa<InlineAsm>(cs.getCalledValue()))
+          continue;
+        if (Function *target =
+                getDirectCallTarget(cs, /*moduleIsFullyLinked=*/true))
+          targets.push_back(target);
+        else
+          targets.assign(module.escapingFunctions.begin(),
+                         module.escapingFunctions.end());
+        for (const Function *target : targets)
+          callers[target].push_back(kf->function);
+      }
+    }
+  }
+
+  // the functions that may call an error function, directly or not
+  std::set<const Function *> reaching(errorFunctions);
+  std::vector<const Function *> stack(errorFunctions.begin(),
+                                      errorFunctions.end());
+  while (!stack.empty()) {
+    const Function *f = stack.back();
+    stack.pop_back();
+    for (const Function *caller : callers[f])
+      if (reaching.insert(caller).second)
+        stack.push_back(caller);
+  }
+
+  auto callsError = [&](const Instruction &inst) {
+    auto it = callTargets.find(&inst);
+    if (it == callTargets.end())
+      return false;
+    for (const Function *target : it->second)
+      if (reaching.count(target))
+        return true;
+    return false;
+  };
+
+  for (const auto &kf : module.functions) {
+    if (!reaching.count(kf->function))
+      continue;
+
+    // propagate backwards through the control flow graph until nothing
+    // changes, the blocks are visited last to first to converge quickly
+    std::unordered_map<const BasicBlock *, bool> blockError, blockReturn;
+    for (auto &bb : *kf->function) {
+      bool error = false;
+      for (auto &inst : bb)
+        error = error || callsError(inst);
+      blockError[&bb] = error;
+      blockReturn[&bb] = isa<ReturnInst>(bb.getTerminator()) ||
+                         isa<ResumeInst>(bb.getTerminator());
+    }
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (auto bb = kf->function->getBasicBlockList().rbegin(),
+                be = kf->function->getBasicBlockList().rend();
+           bb != be; ++bb) {
+        for (const BasicBlock *succ : successors(&*bb)) {
+          if (blockError[succ] && !blockError[&*bb])
+            changed = blockError[&*bb] = true;
+          if (blockReturn[succ] && !blockReturn[&*bb])
+            changed = blockReturn[&*bb] = true;
+        }
+      }
+    }
+
+    for (auto &bb : *kf->function) {
+      bool error = false;
+      for (const BasicBlock *succ : successors(&bb))
+        error = error || blockError[succ];
+      bool ret = blockReturn[&bb];
+      for (auto inst = bb.rbegin(), ie = bb.rend(); inst != ie; ++inst) {
+        unsigned id = kf->getKInstruction(&*inst)->info->id;
+        if (isa<CallInst>(*inst) || isa<InvokeInst>(*inst)) {
+          errorAfterCall[id] = error;
+          returnAfterCall[id] = ret;
+        }
+        error = error || callsError(*inst);
+        reachesError[id] = error;
+        reachesReturn[id] = ret;
+      }
+    }
+  }
+
+  // A function that cannot reach an error site keeps its bits cleared,
+  // except that returning from it is taken to be possible, its callers
+  // decide then.
+  for (const auto &kf : module.functions) {
+    if (reaching.count(kf->function))
+      continue;
+    for (unsigned i = 0; i != kf->numInstructions; ++i) {
+      unsigned id = kf->instructions[i]->info->id;
+      reachesReturn[id] = true;
+      returnAfterCall[id] = true;
+    }
+  }
+}
+
+bool ErrorReachability::mayReach(const ExecutionState &state,
+                                 const KInstruction *next) const {
+  unsigned id = next->info->id;
+  if (reachesError[id])
+    return true;
+  if (!reachesReturn[id])
+    return false;
+
+  // the frames below continue after their calls, the bottom frame has no
+  // caller to return to
+  for (auto frame = state.stack.rbegin(), fe = state.stack.rend();
+       frame != fe; ++frame) {
+    const KInstruction *call = frame->caller;
+    if (!call)
+      return false;
+    if (errorAfterCall[call->info->id])
+      return true;
+    if (!returnAfterCall[call->info->id])
+      return false;
+  }
+  return false;
+}
+
+bool ErrorReachability::mayReach(const ExecutionState &state) const {
+  return mayReach(state, state.pc);
+}
+
+bool ErrorReachability::mayReach(const ExecutionState &state,
+                                 BasicBlock *dst) const {
+  const KFunction *kf = state.stack.back().kf;
+  return mayReach(state, kf->instructions[kf->basicBlockEntry.at(dst)]);
+}
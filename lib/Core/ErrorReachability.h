@@ -0,0 +1,65 @@
+//===-- ErrorReachability.h -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_ERRORREACHABILITY_H
+#define KLEE_ERRORREACHABILITY_H
+
+#include "llvm/ADT/BitVector.h"
+
+#include <set>
+
+namespace llvm {
+  class BasicBlock;
+  class Function;
+}
+
+namespace klee {
+  class ExecutionState;
+  struct KInstruction;
+  class KModule;
+
+  /// ErrorReachability - Which instructions a call to one of the error
+  /// functions may still follow, used by -prune-unreachable-errors.
+  ///
+  /// The analysis runs once over the call graph and the control flow
+  /// graphs of the module and keeps a few bits per instruction, so
+  /// whether a state may still reach an error site is decided by walking
+  /// its stack up to the first frame that may reach one. It is an over
+  /// approximation: calls through function pointers are taken to reach an
+  /// error site, and every function is taken to return.
+  class ErrorReachability {
+    /// By InstructionInfo id, whether an error site may be reached from
+    /// the instruction without returning from its function.
+    llvm::BitVector reachesError;
+    /// By InstructionInfo id, whether the function may return after the
+    /// instruction.
+    llvm::BitVector reachesReturn;
+    /// The same for the instructions following the call instructions,
+    /// where the caller frames continue.
+    llvm::BitVector errorAfterCall;
+    llvm::BitVector returnAfterCall;
+
+    bool mayReach(const ExecutionState &state, const KInstruction *next) const;
+
+  public:
+    /// Analyze \a module for calls to the functions \a errorFunctions.
+    ErrorReachability(const KModule &module,
+                      const std::set<const llvm::Function *> &errorFunctions);
+
+    /// Whether \a state may reach an error site from its pc.
+    bool mayReach(const ExecutionState &state) const;
+
+    /// Whether \a state may reach an error site after its top frame
+    /// branched to \a dst.
+    bool mayReach(const ExecutionState &state, llvm::BasicBlock *dst) const;
+  };
+
+}
+
+#endif /* KLEE_ERRORREACHABILITY_H */
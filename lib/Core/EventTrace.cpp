@@ -0,0 +1,57 @@
+//===-- EventTrace.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "EventTrace.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <cassert>
+
+using namespace klee;
+
+EventTrace *EventTrace::active = nullptr;
+
+namespace {
+  // a megabyte and a half of records between writes
+  const size_t BufferRecords = 1 << 15;
+  const char Magic[8] = {'K', 'L', 'E', 'E', 'T', 'R', 'C', '1'};
+}
+
+EventTrace::EventTrace(std::unique_ptr<llvm::raw_fd_ostream> _file)
+    : file(std::move(_file)), buffer(BufferRecords),
+      begin(time::getWallTime()) {
+  assert(!active && "only one event trace may be open");
+  file->write(Magic, sizeof(Magic));
+  active = this;
+}
+
+EventTrace::~EventTrace() {
+  flush();
+  active = nullptr;
+}
+
+void EventTrace::flush() {
+  file->write(reinterpret_cast<const char *>(buffer.data()),
+              used * sizeof(Record));
+  file->flush();
+  used = 0;
+}
+
+void EventTrace::append(TraceEvent kind, const void *state, uint64_t arg,
+                        time::Point start, time::Span duration) {
+  Record &r = buffer[used];
+  r.start = (start - begin).toMicroseconds();
+  r.duration = duration.toMicroseconds();
+  r.state = reinterpret_cast<uintptr_t>(state);
+  r.arg = arg;
+  r.kind = static_cast<uint32_t>(kind);
+  r.reserved = 0;
+  if (++used == buffer.size())
+    flush();
+}
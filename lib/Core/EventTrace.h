@@ -0,0 +1,121 @@
+//===-- EventTrace.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EVENTTRACE_H
+#define KLEE_EVENTTRACE_H
+
+#include "klee/Internal/System/Time.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace llvm {
+  class raw_fd_ostream;
+}
+
+namespace klee {
+
+  /// The kinds of events in an event trace. The values are part of the
+  /// file format read by klee-trace.
+  enum class TraceEvent : uint32_t {
+    /// A state forked, the argument is the new state.
+    Fork = 0,
+    /// A solver query, the argument is its QueryPurpose, with bit 8 set if
+    /// it reached the core solver.
+    Query = 1,
+    /// A memory object was allocated, the argument is its size.
+    Allocate = 2,
+    /// An object state was copied on write, the argument is its size.
+    CopyOnWrite = 3,
+    /// The searcher selected a state.
+    Select = 4,
+    /// A state was terminated.
+    Terminate = 5
+  };
+
+  /// EventTrace - A binary log of what the executor spends its time on,
+  /// written with -trace-events to events.trace in the output directory.
+  ///
+  /// Events are appended to a fixed buffer that is written out whenever it
+  /// fills up, so recording one costs a few stores. While no trace is
+  /// open, recording costs a load and a branch.
+  class EventTrace {
+  public:
+    /// One event as stored in the file, after an 8 byte magic header.
+    struct Record {
+      /// Microseconds since the trace was opened.
+      uint64_t start;
+      /// Microseconds, zero for instant events.
+      uint64_t duration;
+      /// Identifies the state the event belongs to, zero for none.
+      uint64_t state;
+      uint64_t arg;
+      uint32_t kind;
+      uint32_t reserved;
+    };
+
+  private:
+    static EventTrace *active;
+
+    std::unique_ptr<llvm::raw_fd_ostream> file;
+    std::vector<Record> buffer;
+    size_t used = 0;
+    time::Point begin;
+
+    void flush();
+    void append(TraceEvent kind, const void *state, uint64_t arg,
+                time::Point start, time::Span duration);
+
+  public:
+    /// Start tracing to \a file, which stays active until destroyed.
+    explicit EventTrace(std::unique_ptr<llvm::raw_fd_ostream> file);
+    ~EventTrace();
+
+    static bool enabled() { return active != nullptr; }
+
+    /// Record an event that started at \a start and lasted \a duration.
+    static void record(TraceEvent kind, const void *state, uint64_t arg,
+                       time::Point start, time::Span duration) {
+      if (active)
+        active->append(kind, state, arg, start, duration);
+    }
+
+    /// Record an instant event.
+    static void record(TraceEvent kind, const void *state, uint64_t arg = 0) {
+      if (active)
+        active->append(kind, state, arg, time::getWallTime(), time::Span());
+    }
+  };
+
+  /// EventTraceScope - Record an event lasting the lifetime of the scope.
+  class EventTraceScope {
+    TraceEvent kind;
+    const void *state;
+    uint64_t arg = 0;
+    time::Point start;
+
+  public:
+    EventTraceScope(TraceEvent kind, const void *state)
+        : kind(kind), state(state) {
+      if (EventTrace::enabled())
+        start = time::getWallTime();
+    }
+    ~EventTraceScope() {
+      if (EventTrace::enabled())
+        EventTrace::record(kind, state, arg, start,
+                           time::getWallTime() - start);
+    }
+
+    void setArgument(uint64_t value) { arg = value; }
+  };
+
+}
+
+#endif /* KLEE_EVENTTRACE_H */
@@ -7,17 +7,21 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "CoreStats.h"
 #include "Memory.h"
 
 #include "klee/ExecutionState.h"
 
+#include "klee/Expr/Assignment.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprSerializer.h"
 #include "klee/Internal/Module/Cell.h"
 #include "klee/Internal/Module/InstructionInfoTable.h"
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Module/KModule.h"
 #include "klee/OptionCategories.h"
 
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/IR/Function.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
@@ -28,6 +32,8 @@
 #include <set>
 #include <sstream>
 #include <stdarg.h>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace llvm;
 using namespace klee;
@@ -41,10 +47,55 @@ cl::opt<bool> DebugLogStateMerge(
 
 /***/
 
+namespace {
+/// Recycles register files by size, so that pushing a frame or unsharing
+/// one after a fork rarely has to allocate.
+class StackLocalsPool {
+  static const size_t MaxFree = 64;
+  std::unordered_map<unsigned, std::vector<StackLocals *>> free;
+
+public:
+  StackLocals *acquire(unsigned size) {
+    auto &list = free[size];
+    StackLocals *l;
+    if (list.empty()) {
+      l = new StackLocals;
+      l->size = size;
+      l->cells = new Cell[size];
+    } else {
+      l = list.back();
+      list.pop_back();
+    }
+    l->refCount = 1;
+    l->hash = 0;
+    return l;
+  }
+
+  void release(StackLocals *l) {
+    auto &list = free[l->size];
+    if (list.size() >= MaxFree) {
+      delete[] l->cells;
+      delete l;
+      return;
+    }
+    // drop the references held by the registers
+    for (unsigned i = 0; i < l->size; i++)
+      l->cells[i] = Cell();
+    list.push_back(l);
+  }
+};
+
+// never destroyed: frames may still be released during static destruction
+StackLocalsPool &getStackLocalsPool() {
+  static StackLocalsPool *pool = new StackLocalsPool();
+  return *pool;
+}
+}
+
 StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
   : caller(_caller), kf(_kf), callPathNode(0), 
     minDistToUncoveredOnReturn(0), varargs(0) {
-  locals = new Cell[kf->numRegisters];
+  locals = getStackLocalsPool().acquire(kf->numRegisters);
 }
 
 StackFrame::StackFrame(const StackFrame &s) 
@@ -52,15 +103,137 @@ StackFrame::StackFrame(const StackFrame &s)
     kf(s.kf),
     callPathNode(s.callPathNode),
     allocas(s.allocas),
+    allocaSlots(s.allocaSlots),
+    deadAllocas(s.deadAllocas),
+    locals(s.locals),
     minDistToUncoveredOnReturn(s.minDistToUncoveredOnReturn),
-    varargs(s.varargs) {
-  locals = new Cell[s.kf->numRegisters];
-  for (unsigned i=0; i<s.kf->numRegisters; i++)
-    locals[i] = s.locals[i];
+    varargs(s.varargs),
+    recording(s.recording) {
+  ++locals->refCount;
+}
+
+StackFrame &StackFrame::operator=(const StackFrame &s) {
+  ++s.locals->refCount;
+  if (--locals->refCount == 0)
+    getStackLocalsPool().release(locals);
+  caller = s.caller;
+  kf = s.kf;
+  callPathNode = s.callPathNode;
+  allocas = s.allocas;
+  allocaSlots = s.allocaSlots;
+  deadAllocas = s.deadAllocas;
+  locals = s.locals;
+  minDistToUncoveredOnReturn = s.minDistToUncoveredOnReturn;
+  varargs = s.varargs;
+  recording = s.recording;
+  return *this;
 }
 
 StackFrame::~StackFrame() { 
-  delete[] locals; 
+  if (--locals->refCount == 0)
+    getStackLocalsPool().release(locals);
+}
+
+void StackFrame::unshareLocals() {
+  StackLocals *copy = getStackLocalsPool().acquire(locals->size);
+  for (unsigned i = 0; i < locals->size; i++)
+    copy->cells[i] = locals->cells[i];
+  copy->hash = locals->hash;
+  --locals->refCount;
+  locals = copy;
+}
+
+namespace {
+/// Contribution of a bound register to StackLocals::hash.
+// finalizer of splitmix64
+uint64_t mix(uint64_t h) {
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+uint64_t hashLocal(unsigned index, const KValue &value) {
+  if (value.value.isNull())
+    return 0;
+  uint64_t h = value.getOffset()->hash();
+  if (!value.getSegment().isNull())
+    h ^= (uint64_t) value.getSegment()->hash() << 32;
+  return mix(h ^ (index + 1) * 0x9e3779b97f4a7c15ULL);
+}
+}
+
+Cell &StackFrame::beginSetLocal(unsigned index, const KValue &value) {
+  assert(index < locals->size);
+  if (locals->refCount > 1)
+    unshareLocals();
+  Cell &cell = locals->cells[index];
+  locals->hash ^= hashLocal(index, cell) ^ hashLocal(index, value);
+  return cell;
+}
+
+void StackFrame::setLocal(unsigned index, const KValue &value) {
+  static_cast<KValue &>(beginSetLocal(index, value)) = value;
+}
+
+void StackFrame::setLocal(unsigned index, KValue &&value) {
+  static_cast<KValue &>(beginSetLocal(index, value)) = std::move(value);
+}
+
+void StackFrame::swapOutLocals(ExprWriter &w) {
+  bool owned = locals->refCount == 1;
+  w.writeInt(owned);
+  if (!owned)
+    return;
+  for (unsigned i = 0; i < locals->size; i++) {
+    Cell &cell = locals->cells[i];
+    w.write(cell.value);
+    w.write(cell.pointerSegment);
+    cell = Cell();
+  }
+}
+
+void StackFrame::swapInLocals(ExprReader &r) {
+  if (!r.readInt())
+    return;
+  for (unsigned i = 0; i < locals->size; i++) {
+    Cell &cell = locals->cells[i];
+    cell.value = r.readExpr();
+    cell.pointerSegment = r.readExpr();
+  }
+}
+
+void StackFrame::addAlloca(const MemoryObject *mo) {
+  if (allocaSlots.count(mo))
+    return;
+  allocaSlots = allocaSlots.insert(std::make_pair(mo, allocas.size()));
+  allocas.push_back(mo);
+}
+
+bool StackFrame::removeAlloca(const MemoryObject *mo) {
+  const auto *slot = allocaSlots.lookup(mo);
+  if (!slot)
+    return false;
+  allocas[slot->second] = nullptr;
+  allocaSlots = allocaSlots.remove(mo);
+
+  // Lifetimes mostly end in the reverse order they started in, which the
+  // null slots at the end cover. Compact the others once most slots are
+  // null, so that a loop ending lifetimes keeps the vector bounded.
+  while (!allocas.empty() && !allocas.back())
+    allocas.pop_back();
+  if (allocas.size() < 2 * allocaSlots.size() + 16)
+    return true;
+  std::vector<std::pair<const MemoryObject *, unsigned> > slots;
+  unsigned n = 0;
+  for (const MemoryObject *live : allocas) {
+    if (!live)
+      continue;
+    slots.push_back(std::make_pair(live, n));
+    allocas[n++] = live;
+  }
+  allocas.resize(n);
+  allocaSlots = allocaSlots.replaceMany(slots.begin(), slots.end());
+  return true;
 }
 
 /***/
@@ -84,15 +257,6 @@ ExecutionState::ExecutionState(const std::vector<ref<Expr> > &assumptions)
     : constraints(assumptions), ptreeNode(0) {}
 
 ExecutionState::~ExecutionState() {
-  for (unsigned int i=0; i<symbolics.size(); i++)
-  {
-    const MemoryObject *mo = symbolics[i].first;
-    assert(mo->refCount > 0);
-    mo->refCount--;
-    if (mo->refCount == 0)
-      delete mo;
-  }
-
   for (auto cur_mergehandler: openMergeStack){
     cur_mergehandler->removeOpenState(this);
   }
@@ -103,6 +267,9 @@ ExecutionState::~ExecutionState() {
 
 ExecutionState::ExecutionState(const ExecutionState& state):
     nondetValues(state.nondetValues),
+    pureCalls(state.pureCalls),
+    lazyPointers(state.lazyPointers),
+    lazyObjects(state.lazyObjects),
     lastLoopHead(state.lastLoopHead),
     lastLoopHeadId(state.lastLoopHeadId),
     lastLoopCheck(state.lastLoopCheck),
@@ -114,8 +281,14 @@ ExecutionState::ExecutionState(const ExecutionState& state):
 
     addressSpace(state.addressSpace),
     constraints(state.constraints),
+    pendingCondition(state.pendingCondition),
+    pinnedValues(state.pinnedValues),
+    model(state.model),
+    decidedExprs(state.decidedExprs),
 
     queryCost(state.queryCost),
+    solverQueries(state.solverQueries),
+    coreSolverQueries(state.coreSolverQueries),
     weight(state.weight),
     depth(state.depth),
 
@@ -125,16 +298,20 @@ ExecutionState::ExecutionState(const ExecutionState& state):
     instsSinceCovNew(state.instsSinceCovNew),
     coveredNew(state.coveredNew),
     forkDisabled(state.forkDisabled),
-    coveredLines(state.coveredLines),
+    // coveredInstructions are deliberately not inherited
+    exprDepthConcretizations(state.exprDepthConcretizations),
     ptreeNode(state.ptreeNode),
+    subsumptionNode(state.subsumptionNode),
     symbolics(state.symbolics),
     arrayNames(state.arrayNames),
+    arrayNameIds(state.arrayNameIds),
     openMergeStack(state.openMergeStack),
-    steppedInstructions(state.steppedInstructions)
+    mergedStates(state.mergedStates),
+    steppedInstructions(state.steppedInstructions),
+    lastScheduled(state.lastScheduled),
+    checkpointId(state.checkpointId),
+    pathId(state.pathId)
 {
-  for (unsigned int i=0; i<symbolics.size(); i++)
-    symbolics[i].first->refCount++;
-
   for (auto cur_mergehandler: openMergeStack)
     cur_mergehandler->addOpenState(this);
 }
@@ -144,7 +321,15 @@ ExecutionState *ExecutionState::branch() {
 
   ExecutionState *falseState = new ExecutionState(*this);
   falseState->coveredNew = false;
-  falseState->coveredLines.clear();
+
+  // approximate the memory duplicated by the fork; the rest of the state
+  // is shared with this one
+  uint64_t bytes = sizeof(ExecutionState) +
+                   constraints.size() * sizeof(ref<Expr>);
+  for (const StackFrame &sf : stack)
+    bytes += sizeof(StackFrame) +
+             sf.allocas.size() * sizeof(const MemoryObject *);
+  stats::stateForkBytes += bytes;
 
   weight *= .5;
   falseState->weight -= weight;
@@ -158,45 +343,75 @@ void ExecutionState::pushFrame(KInstIterator caller, KFunction *kf) {
 
 void ExecutionState::popFrame() {
   StackFrame &sf = stack.back();
-  for (std::vector<const MemoryObject*>::iterator it = sf.allocas.begin(), 
-         ie = sf.allocas.end(); it != ie; ++it)
-    addressSpace.unbindObject(*it);
+  for (const MemoryObject *mo : sf.allocas)
+    if (mo)
+      addressSpace.unbindObject(mo);
   stack.pop_back();
 }
 
 void ExecutionState::removeAlloca(const MemoryObject *mo) {
-  StackFrame &sf = stack.back();
-  unsigned idx = 0;
-  for (auto it = sf.allocas.begin(), ie = sf.allocas.end(); it != ie; ++it) {
-    if (*it == mo) {
-        addressSpace.unbindObject(*it);
-        *it = nullptr;
-        break;
-    }
-    ++idx;
-  }
-  assert(sf.allocas[idx] == nullptr);
-  if (idx == sf.allocas.size() - 1) {
-    // if it is the last alloca, just remove it
-    sf.allocas.pop_back();
-  } else if (sf.allocas.size() > 1) {
-    assert(idx < sf.allocas.size());
-    // shrink the allocas -- put the last element inplace of the
-    // deleted element and then remove it
-    sf.allocas[idx] = sf.allocas.back();
-    sf.allocas.pop_back();
+  if (!stack.back().removeAlloca(mo)) {
+    assert(0 && "alloca not in the current frame");
+    return;
   }
+  addressSpace.unbindObject(mo);
 }
 
 ExecutionState::NondetValue&
 ExecutionState::addNondetValue(const KValue& kval, bool isSigned, const std::string& name) { 
-    nondetValues.emplace_back(kval, isSigned, name);
-    return nondetValues.back();
+    return nondetValues.emplace_back(kval, isSigned, internNondetName(name));
+}
+
+const std::string *ExecutionState::internNondetName(const std::string &name) {
+  static std::unordered_set<std::string> names;
+  return &*names.insert(name).first;
 }
 
 void ExecutionState::addSymbolic(const MemoryObject *mo, const Array *array) { 
-  mo->refCount++;
-  symbolics.push_back(std::make_pair(mo, array));
+  symbolics.emplace_back(mo, array);
+}
+
+std::string ExecutionState::getUniqueArrayName(const std::string &name) {
+  // Names are never given back, so start probing after the suffix handed
+  // out last instead of at the name itself, which would take as many
+  // probes as there are arrays with the name already.
+  unsigned id = 0;
+  if (const auto *last = arrayNameIds.lookup(name))
+    id = last->second;
+  std::string uniqueName = id ? name + "_" + llvm::utostr(id) : name;
+  while (arrayNames.count(uniqueName))
+    uniqueName = name + "_" + llvm::utostr(++id);
+  arrayNames = arrayNames.insert(uniqueName);
+  arrayNameIds = arrayNameIds.replace(std::make_pair(name, id + 1));
+  return uniqueName;
+}
+
+ExecutionState::Symbolic::Symbolic(const MemoryObject *mo, const Array *array)
+  : memoryObject(mo), array(array) {
+  memoryObject->refCount++;
+  array->retain();
+}
+
+ExecutionState::Symbolic::Symbolic(const Symbolic &b)
+  : memoryObject(b.memoryObject), array(b.array) {
+  memoryObject->refCount++;
+  array->retain();
+}
+
+ExecutionState::Symbolic &
+ExecutionState::Symbolic::operator=(const Symbolic &b) {
+  Symbolic tmp(b);
+  std::swap(memoryObject, tmp.memoryObject);
+  std::swap(array, tmp.array);
+  return *this;
+}
+
+ExecutionState::Symbolic::~Symbolic() {
+  assert(memoryObject->refCount > 0);
+  memoryObject->refCount--;
+  if (memoryObject->refCount == 0)
+    delete memoryObject;
+  array->release();
 }
 
 /**/
@@ -214,11 +429,82 @@ llvm::raw_ostream &klee::operator<<(llvm::raw_ostream &os, const MemoryMap &mm)
   return os;
 }
 
-bool ExecutionState::merge(const ExecutionState &b) {
+void ExecutionState::addConstraint(ref<Expr> e) {
+  constraints.addConstraint(e);
+  if (model && !model->satisfies(&e, &e + 1))
+    model.reset();
+}
+
+void ExecutionState::takeBranch(unsigned side) {
+  pathId = mix(pathId ^ (side + 1));
+}
+
+unsigned ExecutionState::getPathRandom(unsigned n, unsigned salt) const {
+  return mix(pathId ^ mix(salt + 1)) % n;
+}
+
+uint64_t ExecutionState::getFingerprint() const {
+  return mix(getContextFingerprint() ^ constraints.hash());
+}
+
+uint64_t ExecutionState::getContextFingerprint() const {
+  uint64_t h = mix(reinterpret_cast<uintptr_t>(pc->inst) ^ incomingBBIndex);
+  for (const StackFrame &sf : stack) {
+    h = mix(h ^ reinterpret_cast<uintptr_t>(sf.kf));
+    h = mix(h ^ reinterpret_cast<uintptr_t>(sf.caller ? sf.caller->inst : 0));
+    h = mix(h ^ sf.getLocalsHash());
+  }
+  h = mix(h ^ symbolics.size() ^ (uint64_t) nondetValues.size() << 32);
+  return mix(h ^ addressSpace.getVersionsHash());
+}
+
+void ExecutionState::suspend(ExprWriter &w) {
+  w.writeInt(constraints.size());
+  for (const auto &constraint : constraints)
+    w.write(constraint);
+  constraints = ConstraintManager();
+  model.reset();
+
+  for (StackFrame &sf : stack)
+    sf.swapOutLocals(w);
+  addressSpace.swapOut(w);
+}
+
+void ExecutionState::resume(ExprReader &r) {
+  std::vector<ref<Expr> > cs(r.readInt());
+  for (auto &constraint : cs)
+    constraint = r.readExpr();
+  constraints = ConstraintManager(cs);
+
+  for (StackFrame &sf : stack)
+    sf.swapInLocals(r);
+  addressSpace.swapIn(r);
+}
+
+/// Call `f(offset, a, b)` on the words of an object whose contents differ
+/// between its states `os` and `otherOS`, in either plane. The words are
+/// 8 bytes wide, but for a shorter tail, so that a merge joins the values
+/// stored with one select per word rather than one per byte.
+template <typename F>
+static void forEachDifferingWord(const MemoryObject *mo, const ObjectState *os,
+                                 const ObjectState *otherOS, F f) {
+  unsigned size = cast<ConstantExpr>(mo->size)->getZExtValue();
+  for (unsigned i = 0; i < size;) {
+    Expr::Width width = size - i >= 8 ? Expr::Int64 : Expr::Int8;
+    KValue av = os->read(i, width);
+    KValue bv = otherOS->read(i, width);
+    if (av.getSegment() != bv.getSegment() || av.getOffset() != bv.getOffset())
+      f(i, av, bv);
+    i += width / 8;
+  }
+}
+
+bool ExecutionState::merge(const ExecutionState &b, unsigned maxJoins) {
   if (DebugLogStateMerge)
     llvm::errs() << "-- attempting merge of A:" << this << " with B:" << &b
                  << "--\n";
-  if (pc != b.pc)
+  // at the start of a block, the phi nodes must read the same edge
+  if (pc != b.pc || incomingBBIndex != b.incomingBBIndex)
     return false;
 
   // XXX is it even possible for these to differ? does it matter? probably
@@ -289,40 +575,69 @@ bool ExecutionState::merge(const ExecutionState &b) {
     llvm::errs() << "B: " << b.addressSpace.objects << "\n";
   }
     
+  // objects still shared copy-on-write, and the subtrees of the maps
+  // holding only such objects, are skipped
   std::set<const MemoryObject*> mutated;
-  MemoryMap::iterator ai = addressSpace.objects.begin();
-  MemoryMap::iterator bi = b.addressSpace.objects.begin();
-  MemoryMap::iterator ae = addressSpace.objects.end();
-  MemoryMap::iterator be = b.addressSpace.objects.end();
-  for (; ai!=ae && bi!=be; ++ai, ++bi) {
-    if (ai->first != bi->first) {
-      if (DebugLogStateMerge) {
-        if (ai->first < bi->first) {
-          llvm::errs() << "\t\tB misses binding for: " << ai->first->id << "\n";
-        } else {
-          llvm::errs() << "\t\tA misses binding for: " << bi->first->id << "\n";
+  bool mappingsMatch = addressSpace.objects.diff(
+      b.addressSpace.objects, [&](const MemoryMap::value_type *ai,
+                                  const MemoryMap::value_type *bi) {
+        if (!ai || !bi) {
+          if (DebugLogStateMerge) {
+            if (ai)
+              llvm::errs() << "\t\tB misses binding for: " << ai->first->id
+                           << "\n";
+            else
+              llvm::errs() << "\t\tA misses binding for: " << bi->first->id
+                           << "\n";
+          }
+          return false;
+        }
+        if (ai->second == bi->second)
+          return true;
+        if (DebugLogStateMerge)
+          llvm::errs() << "\t\tmutated: " << ai->first->id << "\n";
+        mutated.insert(ai->first);
+        if (!isa<ConstantExpr>(ai->first->size)) {
+          if (DebugLogStateMerge) {
+            llvm::errs() << "\t\tobject with symbolic size preventing merge: "
+                << ai->first->id << "\n";
+          }
+          return false;
         }
+        return true;
+      });
+  if (!mappingsMatch) {
+    if (DebugLogStateMerge)
+      llvm::errs() << "\t\tmappings differ\n";
+    return false;
+  }
+
+  if (maxJoins != UINT_MAX) {
+    unsigned joins = 0;
+    std::vector<StackFrame>::const_iterator itA = stack.begin();
+    std::vector<StackFrame>::const_iterator itB = b.stack.begin();
+    for (; itA != stack.end(); ++itA, ++itB) {
+      for (unsigned i = 0; i < itA->kf->numRegisters; i++) {
+        const KValue &av = itA->getLocal(i);
+        const KValue &bv = itB->getLocal(i);
+        if (!av.value.isNull() && !bv.value.isNull() &&
+            (av.getSegment() != bv.getSegment() ||
+             av.getOffset() != bv.getOffset()))
+          ++joins;
       }
-      return false;
     }
-    if (ai->second != bi->second) {
+    for (const MemoryObject *mo : mutated)
+      forEachDifferingWord(mo, addressSpace.findObject(mo),
+                           b.addressSpace.findObject(mo),
+                           [&](unsigned, const KValue &, const KValue &) {
+                             ++joins;
+                           });
+    if (joins > maxJoins) {
       if (DebugLogStateMerge)
-        llvm::errs() << "\t\tmutated: " << ai->first->id << "\n";
-      mutated.insert(ai->first);
-    }
-    if (!isa<ConstantExpr>(ai->first->size)) {
-      if (DebugLogStateMerge) {
-        llvm::errs() << "\t\tobject with symbolic size preventing merge: "
-            << ai->first->id << "\n";
-      }
+        llvm::errs() << "\t\t" << joins << " values to join\n";
       return false;
     }
   }
-  if (ai!=ae || bi!=be) {
-    if (DebugLogStateMerge)
-      llvm::errs() << "\t\tmappings differ\n";
-    return false;
-  }
   
   // merge stack
 
@@ -345,13 +660,16 @@ bool ExecutionState::merge(const ExecutionState &b) {
     StackFrame &af = *itA;
     const StackFrame &bf = *itB;
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
-      const ref<Expr> &bv = bf.locals[i].value;
-      if (av.isNull() || bv.isNull()) {
+      const KValue &av = af.getLocal(i);
+      const KValue &bv = bf.getLocal(i);
+      if (av.value.isNull() || bv.value.isNull()) {
         // if one is null then by implication (we are at same pc)
         // we cannot reuse this local, so just ignore
       } else {
-        av = SelectExpr::create(inA, av, bv);
+        KValue merged(
+            SelectExpr::create(inA, av.getSegment(), bv.getSegment()),
+            SelectExpr::create(inA, av.getOffset(), bv.getOffset()));
+        af.setLocal(i, merged);
       }
     }
   }
@@ -366,14 +684,23 @@ bool ExecutionState::merge(const ExecutionState &b) {
     assert(otherOS);
 
     ObjectState *wos = addressSpace.getWriteable(mo, os);
-    for (unsigned i = 0; i < cast<ConstantExpr>(mo->size)->getZExtValue(); i++) {
-      KValue av = wos->read8(i);
-      KValue bv = otherOS->read8(i);
-      wos->write(i, KValue(SelectExpr::create(inA, av.getSegment(), bv.getSegment()),
-                           SelectExpr::create(inA, av.getOffset(), bv.getOffset())));
-    }
+    forEachDifferingWord(
+        mo, wos, otherOS,
+        [&](unsigned offset, const KValue &av, const KValue &bv) {
+          wos->write(offset, KValue(SelectExpr::create(inA, av.getSegment(),
+                                                       bv.getSegment()),
+                                    SelectExpr::create(inA, av.getOffset(),
+                                                       bv.getOffset())));
+        });
   }
 
+  // values pinned on one of the paths need not hold on the other
+  pinnedValues = ImmutableMap<ref<Expr>, ref<ConstantExpr> >();
+  decidedExprs = ImmutableMap<ref<Expr>, bool>();
+  // and so need the results of the pure calls
+  pureCalls = ImmutableMap<const llvm::Function *, ImmutableList<PureCall> >();
+  // a pointer initialized on one of the paths is resolved as usual
+  lazyPointers = ImmutableMap<ref<Expr>, ref<Expr> >();
   constraints = ConstraintManager();
   for (std::set< ref<Expr> >::iterator it = commonConstraints.begin(), 
          ie = commonConstraints.end(); it != ie; ++it)
@@ -405,7 +732,7 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
 
       out << ai->getName().str();
       // XXX should go through function
-      ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].value;
+      ref<Expr> value = sf.getLocal(sf.kf->getArgRegister(index++)).value;
       if (value.get() && isa<ConstantExpr>(value))
         out << "=" << value;
     }
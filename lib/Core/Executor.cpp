@@ -10,17 +10,26 @@
 #include "Executor.h"
 
 #include "../Expr/ArrayExprOptimizer.h"
+#include "CallMemoizer.h"
 #include "Context.h"
+#include "Checkpoint.h"
 #include "CoreStats.h"
+#include "ErrorReachability.h"
+#include "EventTrace.h"
 #include "ExternalDispatcher.h"
+#include "FunctionSummarizer.h"
 #include "ImpliedValue.h"
+#include "LoopSummary.h"
 #include "Memory.h"
 #include "MemoryManager.h"
+#include "NativeCoverage.h"
 #include "PTree.h"
+#include "PTreeLog.h"
 #include "Searcher.h"
 #include "SeedInfo.h"
 #include "SpecialFunctionHandler.h"
 #include "StatsTracker.h"
+#include "Subsumption.h"
 #include "TimingSolver.h"
 #include "UserSearcher.h"
 
@@ -28,9 +37,12 @@
 #include "klee/Config/Version.h"
 #include "klee/ExecutionState.h"
 #include "klee/Expr/Assignment.h"
+#include "klee/Expr/ByteBounds.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprBuilder.h"
 #include "klee/Expr/ExprPPrinter.h"
 #include "klee/Expr/ExprSMTLIBPrinter.h"
+#include "klee/Expr/ExprSerializer.h"
 #include "klee/Expr/ExprUtil.h"
 #include "klee/Internal/ADT/KTest.h"
 #include "klee/Internal/ADT/RNG.h"
@@ -49,10 +61,12 @@
 #include "klee/Solver/SolverCmdLine.h"
 #include "klee/Solver/SolverStats.h"
 #include "klee/TimerStatIncrementer.h"
+#include "klee/util/Bits.h"
 #include "klee/util/GetElementPtrTypeIterator.h"
 
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/Attributes.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CallSite.h"
@@ -66,13 +80,19 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Process.h"
+#include "llvm/Support/SwapByteOrder.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cerrno>
+#include <cfenv>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
 #include <cxxabi.h>
 #include <fstream>
 #include <iomanip>
@@ -80,6 +100,7 @@
 #include <sstream>
 #include <string>
 #include <sys/mman.h>
+#include <unordered_set>
 #include <vector>
 
 using namespace llvm;
@@ -144,6 +165,21 @@ cl::opt<bool> CheckMemCleanup(
     cl::desc("Check for memory cleanup"),
     cl::cat(TestGenCat));
 
+cl::opt<std::string> NativeCoverageCommand(
+    "native-coverage-command",
+    cl::desc("Run each .ktest file written with this shell command, given "
+             "its path as last argument, in the background, and count the "
+             "source lines it prints as file:line as covered, so that the "
+             "coverage guided searchers steer away from them. The command "
+             "is expected to replay the test on a coverage instrumented "
+             "native build of the program (requires --output-istats)"),
+    cl::value_desc("command"), cl::cat(TestGenCat));
+
+cl::opt<unsigned> NativeCoverageJobs(
+    "native-coverage-jobs", cl::init(4),
+    cl::desc("Number of -native-coverage-command runs at once (default=4)"),
+    cl::cat(TestGenCat));
+
 
 /* Constraint solving options */
 
@@ -155,6 +191,29 @@ cl::opt<unsigned> MaxSymArraySize(
     cl::init(0),
     cl::cat(SolvingCat));
 
+cl::opt<bool> LazyNondetPointers(
+    "lazy-nondet-pointers",
+    cl::desc("Resolve the first dereference of a nondet pointer by forking "
+             "into it being null, pointing to a fresh object of the size "
+             "accessed, or aliasing an object initialized so earlier, "
+             "instead of considering every object (default=false)"),
+    cl::init(false), cl::cat(SolvingCat));
+
+cl::opt<unsigned> LazyNondetPointerAliases(
+    "lazy-nondet-pointer-aliases",
+    cl::desc("The number of the objects last initialized by "
+             "-lazy-nondet-pointers a nondet pointer may alias (default=4)"),
+    cl::init(4), cl::cat(SolvingCat));
+
+cl::opt<unsigned> MaxExprDepth(
+    "max-expr-depth",
+    cl::desc("Concretize values whose expressions are deeper than this when "
+             "they are stored to memory or bound to a register, adding the "
+             "value chosen to the constraints.  Set to 0 to disable "
+             "(default=0)"),
+    cl::init(0),
+    cl::cat(SolvingCat));
+
 cl::opt<bool>
     SimplifySymIndices("simplify-sym-indices",
                        cl::init(false),
@@ -168,6 +227,150 @@ cl::opt<bool>
                                   "querying the solver (default=true)"),
                          cl::cat(SolvingCat));
 
+cl::opt<bool> ImpliedValueConcretization(
+    "implied-value-concretization", cl::init(false),
+    cl::desc("Write the bytes of symbolic objects that a new constraint "
+             "pins to a single value back as concrete bytes "
+             "(default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> CombinedBoundsCheck(
+    "combined-bounds-check", cl::init(true),
+    cl::desc("Check the segment and the offset of a memory access using "
+             "a single solver query (default=true)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> SymbolicSizeRange(
+    "symbolic-size-range", cl::init(false),
+    cl::desc("Compute the range of a symbolic allocation size when the "
+             "object is allocated, so that accesses at constant offsets "
+             "within it need no bounds check query (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> EnumerateSwitchTargets(
+    "enumerate-switch-targets", cl::init(true),
+    cl::desc("Find the targets a symbolic switch can take by asking for a "
+             "value of the condition that avoids the targets found so far, "
+             "one query per feasible target, rather than checking every "
+             "case (default=true)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> AddressLayoutSlots(
+    "address-layout-slots", cl::init(1024),
+    cl::desc("Number of objects whose symbolic addresses, used to compare "
+             "pointers into different objects, share one array. Further "
+             "objects get an array each (default=1024)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> AdaptiveSolverTimeout(
+    "adaptive-solver-timeout", cl::init(false),
+    cl::desc("Give speculative queries short timeouts learned from the "
+             "latencies of previous queries, retry the queries deciding a "
+             "path with growing timeouts, and defer states whose query still "
+             "times out instead of terminating them. Needs "
+             "--max-solver-time (default=false)"),
+    cl::cat(SolvingCat));
+
+
+/*** Expression options ***/
+
+enum class InterpreterExprBuilderKind {
+  Canonical,   // The folding of the create functions of the expressions
+  Simplifying, // Simplifications on top of that
+};
+
+cl::opt<InterpreterExprBuilderKind> InterpreterExprBuilder(
+    "interpreter-expr-builder",
+    cl::desc("Specify how the expressions of interpreted instructions are "
+             "built"),
+    cl::values(
+        clEnumValN(InterpreterExprBuilderKind::Canonical, "canonical",
+                   "Fold them as the expression create functions do"),
+        clEnumValN(InterpreterExprBuilderKind::Simplifying, "simplify",
+                   "Also simplify nested casts and casts and comparisons of "
+                   "selects between constants, such as the segments of "
+                   "pointers to one of two objects (default)")
+            KLEE_LLVM_CL_VAL_END),
+    cl::init(InterpreterExprBuilderKind::Simplifying),
+    cl::cat(klee::ExprCat));
+
+cl::opt<bool> ReuseGlobalsSnapshot(
+    "reuse-globals-snapshot", cl::init(false),
+    cl::desc("When running the entry function more than once in one process "
+             "(e.g. replaying several ktests), initialize the globals only "
+             "for the first run and share the resulting objects "
+             "copy-on-write with the later ones.  Objects leaked by a run "
+             "are then kept until exit (default=false)"),
+    cl::cat(SeedingCat));
+
+cl::opt<bool> ConcreteFastPath(
+    "concrete-fast-path", cl::init(false),
+    cl::desc("After an instruction, keep executing the same state up to the "
+             "end of its basic block for as long as the instructions only "
+             "compute on concrete registers, without going back to the "
+             "searcher in between (default=false)"),
+    cl::cat(klee::ExprCat));
+
+cl::opt<bool> NativeMemoryFunctions(
+    "native-memory-functions", cl::init(true),
+    cl::desc("Execute calls of memcpy, memmove and memset with a concrete "
+             "length on in-bounds concrete pointers by copying the object "
+             "contents directly, instead of interpreting the library "
+             "loops byte by byte (default=true)"),
+    cl::cat(klee::ExprCat));
+
+cl::opt<bool> NativeFloatingPoint(
+    "native-floating-point", cl::init(true),
+    cl::desc("Compute the floating point instructions on concrete 32 and 64 "
+             "bit operands with the host floating point unit when it rounds "
+             "to nearest, instead of emulating them with APFloat "
+             "(default=true)"),
+    cl::cat(klee::ExprCat));
+
+cl::opt<bool> NativeStringFunctions(
+    "native-string-functions", cl::init(true),
+    cl::desc("Compute strlen, strcmp, strncmp, strchr, strcpy and strncpy "
+             "natively when the strings they read are concrete and in "
+             "bounds, instead of interpreting the library loops "
+             "(default=true)"),
+    cl::cat(klee::ExprCat));
+
+cl::opt<bool> MemoizeCalls(
+    "memoize-calls", cl::init(false),
+    cl::desc("Cache the results of the calls that only read concrete memory "
+             "and write none but their own, by their concrete arguments and "
+             "the contents they read, and skip the calls found in the cache "
+             "(default=false)"),
+    cl::cat(klee::ExprCat));
+
+cl::opt<bool> SummarizeLoops(
+    "summarize-loops", cl::init(false),
+    cl::desc("Run the loops counting an induction variable up to a bound, "
+             "whose only effects are stores of invariant values to the "
+             "elements it indexes, in a single step instead of forking at "
+             "each iteration on a symbolic bound. Needs the loops in SSA "
+             "form, e.g. with -optimize (default=false)"),
+    cl::cat(klee::ExprCat));
+
+cl::opt<bool> SummarizeFunctions(
+    "summarize-functions", cl::init(false),
+    cl::desc("Explore the functions computing an integer from integer "
+             "arguments, without memory but their scalar locals, once on "
+             "symbolic arguments and bind the values of their paths at the "
+             "calls instead of exploring them again (default=false)"),
+    cl::cat(klee::ExprCat));
+
+cl::opt<unsigned> SummaryMaxPaths(
+    "summary-max-paths", cl::init(16),
+    cl::desc("Do not summarize the functions with more paths than this "
+             "(default=16)"),
+    cl::cat(klee::ExprCat));
+
+cl::opt<unsigned> SummaryMaxInstructions(
+    "summary-max-instructions", cl::init(1000),
+    cl::desc("Do not summarize the functions with a path longer than this "
+             "many instructions (default=1000)"),
+    cl::cat(klee::ExprCat));
 
 /*** External call policy options ***/
 
@@ -190,7 +393,8 @@ cl::opt<ExternalCallPolicy> ExternalCalls(
             "(in particular printf and puts), regardless of this option."),
         clEnumValN(ExternalCallPolicy::Pure, "pure",
                    "Allow all external function calls but assume that they have "
-                   "no side-effects and return nondet values"),
+                   "no side-effects and return nondet values, the same one "
+                   "for calls with equal arguments"),
         clEnumValN(ExternalCallPolicy::Concrete, "concrete",
                    "Only external function calls with concrete arguments are "
                    "allowed (default)"),
@@ -214,6 +418,16 @@ cl::opt<bool> AllExternalWarnings(
              "as opposed to once per function (default=false)"),
     cl::cat(ExtCallsCat));
 
+cl::opt<bool> IsolateExternalCalls(
+    "isolate-external-calls",
+    cl::init(false),
+    cl::desc("Run external calls in a forked helper process and copy back "
+             "only the result and the objects passed to the call. A crash "
+             "cannot harm KLEE then, but neither can the call change "
+             "anything else in the process, e.g. open a file for later "
+             "calls (default=false)"),
+    cl::cat(ExtCallsCat));
+
 
 /*** Seeding options ***/
 
@@ -230,6 +444,14 @@ cl::opt<bool> OnlyReplaySeeds(
     cl::desc("Discard states that do not have a seed (default=false)."),
     cl::cat(SeedingCat));
 
+cl::opt<bool> FastSeedReplay(
+    "fast-seed-replay",
+    cl::init(false),
+    cl::desc("Let the seeds decide the branches they fully determine without "
+             "asking the solver, a side no seed takes is checked for "
+             "feasibility when its state first runs (default=false)."),
+    cl::cat(SeedingCat));
+
 cl::opt<bool> OnlySeed("only-seed",
                        cl::init(false),
                        cl::desc("Stop execution after seeding is done without "
@@ -304,6 +526,14 @@ cl::opt<std::string>
                       "to __assert_fail"),
              cl::cat(TerminationCat));
 
+cl::opt<bool> PruneUnreachableErrors(
+    "prune-unreachable-errors", cl::init(false),
+    cl::desc("Terminate the states that cannot call the -error-fn function, "
+             "__VERIFIER_error or reach_error any more, and do not fork "
+             "into branches that cannot, as found by a static analysis of "
+             "the module (default=false)"),
+    cl::cat(TerminationCat));
+
 cl::opt<unsigned long long> MaxInstructions(
     "max-instructions",
     cl::desc("Stop execution after this many instructions.  Set to 0 to disable (default=0)"),
@@ -335,6 +565,22 @@ cl::opt<bool> MaxMemoryInhibit(
     cl::init(true),
     cl::cat(TerminationCat));
 
+cl::opt<bool> MaxMemorySuspend(
+    "max-memory-suspend",
+    cl::desc("Suspend states to the output directory instead of killing them "
+             "when over the memory cap, and resume them once memory is "
+             "available again (default=false)"),
+    cl::init(false),
+    cl::cat(TerminationCat));
+
+cl::opt<unsigned> CompactStatesAfter(
+    "compact-states-after",
+    cl::desc("Compact the contents of states not selected for this many "
+             "instructions into memory buffers, and expand them once they "
+             "are selected again (default=0 (off))"),
+    cl::init(0),
+    cl::cat(TerminationCat));
+
 cl::opt<unsigned> RuntimeMaxStackFrames(
     "max-stack-frames",
     cl::desc("Terminate a state after this many stack frames.  Set to 0 to "
@@ -342,6 +588,24 @@ cl::opt<unsigned> RuntimeMaxStackFrames(
     cl::init(8192),
     cl::cat(TerminationCat));
 
+cl::opt<bool> DedupStates(
+    "dedup-states",
+    cl::desc("Terminate a state silently when it enters a basic block in the "
+             "same state (same stack, constraints and memory versions) as "
+             "another state did before (default=false)"),
+    cl::init(false),
+    cl::cat(TerminationCat));
+
+cl::opt<bool> SubsumeStates(
+    "subsume-states",
+    cl::desc("Terminate a state silently when it enters a basic block with "
+             "the same stack and memory versions as a state whose subtree "
+             "was explored completely, and its constraints imply the part "
+             "of that state's constraints the queries in the subtree "
+             "depended on (default=false)"),
+    cl::init(false),
+    cl::cat(TerminationCat));
+
 cl::opt<double> MaxStaticForkPct(
     "max-static-fork-pct", cl::init(1.),
     cl::desc("Maximum percentage spent by an instruction forking out of the "
@@ -372,10 +636,27 @@ cl::opt<double> MaxStaticCPSolvePct(
 cl::opt<std::string> TimerInterval(
     "timer-interval",
     cl::desc("Minimum interval to check timers. "
-             "Affects -max-time, -istats-write-interval, -stats-write-interval, and -uncovered-update-interval (default=1s)"),
+             "Affects -max-time, -max-memory, -istats-write-interval, -stats-write-interval, and -uncovered-update-interval (default=1s)"),
     cl::init("1s"),
     cl::cat(TerminationCat));
 
+cl::opt<std::string> CheckpointInterval(
+    "checkpoint-interval",
+    cl::desc("Append the forks and terminations of the exploration to the "
+             "file checkpoint in the output directory at this interval, so "
+             "that -resume-from can continue the exploration if it is "
+             "halted or killed (default=0s (off))"),
+    cl::cat(TerminationCat));
+
+cl::opt<std::string> ResumeFrom(
+    "resume-from",
+    cl::desc("Continue the exploration of the checkpoint file, or of the "
+             "file checkpoint in the given output directory, replaying the "
+             "paths to the states alive at its last checkpoint. Needs the "
+             "same program and options and a new output directory "
+             "(default=off)"),
+    cl::cat(TerminationCat));
+
 
 /*** Debugging options ***/
 
@@ -428,6 +709,36 @@ cl::opt<bool> DebugCheckForImpliedValues(
     cl::desc("Debug the implied value optimization"),
     cl::cat(DebugCat));
 
+cl::opt<bool> DebugValidateNativeFloatingPoint(
+    "debug-validate-native-floating-point", cl::init(false),
+    cl::desc("Compute the floating point instructions computed natively "
+             "with APFloat as well, and warn when the results differ "
+             "(default=false)"),
+    cl::cat(DebugCat));
+
+cl::opt<bool> DumpMemoryProfile(
+    "dump-memory-profile", cl::init(false),
+    cl::desc("Write the memory taken by the object states of each allocation "
+             "site and each state to memory-profile.txt when the memory cap "
+             "is reached and when execution halts (default=false)"),
+    cl::cat(DebugCat));
+
+cl::opt<bool> TraceEvents(
+    "trace-events", cl::init(false),
+    cl::desc("Write the forks, solver queries, allocations, copies on "
+             "write, state selections and terminations with their times to "
+             "events.trace, klee-trace converts it for trace viewers "
+             "(default=false)"),
+    cl::cat(DebugCat));
+
+cl::opt<bool> WritePTreeLog(
+    "write-ptree-log", cl::init(false),
+    cl::desc("Append the forks and terminations to the process tree log "
+             "ptree.log as they happen, from which klee-ptree draws the tree "
+             "at any point of the run. A requested ptree dump then only "
+             "writes out the log (default=false)"),
+    cl::cat(DebugCat));
+
 } // namespace
 
 namespace klee {
@@ -463,8 +774,15 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
       pathWriter(0), symPathWriter(0), specialFunctionHandler(0), timers{time::Span(TimerInterval)},
       replayKTest(0), replayPath(0), usingSeeds(0),
       atMemoryLimit(false), inhibitForking(false), haltExecution(false),
-      ivcEnabled(false), debugLogBuffer(debugBufferString) {
+      ivcEnabled(ImpliedValueConcretization), debugLogBuffer(debugBufferString) {
+  // must be set before the first object gets bound
+  AddressSpace::trackVersions = DedupStates || SubsumeStates;
+  if (SubsumeStates)
+    subsumptionTable = std::make_shared<SubsumptionTable>();
 
+  if (InterpreterExprBuilder == InterpreterExprBuilderKind::Simplifying)
+    KValue::setBuilder(
+        createSimplifyingExprBuilder(createCanonicalExprBuilder()));
 
   const time::Span maxTime{MaxTime};
   if (maxTime) timers.add(
@@ -473,8 +791,17 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
         setHaltExecution(true);
       })));
 
+  if (MaxMemory)
+    timers.add(std::make_unique<Timer>(time::Span(TimerInterval),
+                                       [&] { memoryCheckDue = true; }));
+
+  if (nativeCoverage)
+    timers.add(std::make_unique<Timer>(time::Span(TimerInterval),
+                                       [&] { collectNativeCoverage(); }));
+
   coreSolverTimeout = time::Span{MaxCoreSolverTime};
   if (coreSolverTimeout) UseForkedCoreSolver = true;
+  timeoutPolicy = SolverTimeoutPolicy(coreSolverTimeout, AdaptiveSolverTimeout);
   Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
   if (!coreSolver) {
     klee_error("Failed to create core solver\n");
@@ -485,7 +812,9 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
       interpreterHandler->getOutputFilename(ALL_QUERIES_SMT2_FILE_NAME),
       interpreterHandler->getOutputFilename(SOLVER_QUERIES_SMT2_FILE_NAME),
       interpreterHandler->getOutputFilename(ALL_QUERIES_KQUERY_FILE_NAME),
-      interpreterHandler->getOutputFilename(SOLVER_QUERIES_KQUERY_FILE_NAME));
+      interpreterHandler->getOutputFilename(SOLVER_QUERIES_KQUERY_FILE_NAME),
+      interpreterHandler->getOutputFilename(ALL_QUERIES_BINARY_FILE_NAME),
+      interpreterHandler->getOutputFilename(SOLVER_QUERIES_BINARY_FILE_NAME));
 
   this->solver = new TimingSolver(solver, EqualitySubstitution);
 
@@ -538,8 +867,17 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
     klee_error("Could not load KLEE intrinsic file %s", LibPath.c_str());
   }
 
+  // A module prepared by an earlier run from the same inputs lets us skip
+  // linking, instrumentation and optimisation altogether
+  std::string preparedPath = kmodule->getPreparedModulePath(modules, opts);
+  bool prepared = !preparedPath.empty() &&
+                  kmodule->loadPrepared(preparedPath,
+                                        modules[0]->getContext(), opts);
+  if (prepared)
+    modules.clear();
+
   // 1.) Link the modules together
-  while (kmodule->link(modules, opts.EntryPoint)) {
+  while (!prepared && kmodule->link(modules, opts.EntryPoint)) {
     // 2.) Apply different instrumentation
     kmodule->instrument(opts);
   }
@@ -552,6 +890,8 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
   specialFunctionHandler->prepare(preservedFunctions);
 
   preservedFunctions.push_back(opts.EntryPoint.c_str());
+  for (const auto &entry : opts.ExtraEntryPoints)
+    preservedFunctions.push_back(entry.c_str());
 
   // Preserve the free-standing library calls
   preservedFunctions.push_back("memset");
@@ -559,14 +899,104 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
   preservedFunctions.push_back("memcmp");
   preservedFunctions.push_back("memmove");
 
-  kmodule->optimiseAndPrepare(opts, preservedFunctions);
-  kmodule->checkModule();
+  if (!prepared) {
+    kmodule->optimiseAndPrepare(opts, preservedFunctions);
+    kmodule->checkModule();
+    if (!preparedPath.empty())
+      kmodule->storePrepared(preparedPath);
+  }
 
   // 4.) Manifest the module
   kmodule->manifest(interpreterHandler, StatsTracker::useStatistics());
 
   specialFunctionHandler->bind();
 
+  errorFunction =
+      ErrorFun.empty() ? nullptr : kmodule->module->getFunction(ErrorFun);
+  instrFailFunction = kmodule->module->getFunction("__INSTR_fail");
+  nonterminationCheckFunction =
+      kmodule->module->getFunction("__INSTR_check_nontermination");
+  nonterminationHeaderFunction =
+      kmodule->module->getFunction("__INSTR_check_nontermination_header");
+
+  static const std::pair<const char *, NativeFunction> memoryFunctions[] = {
+      {"memcpy", NativeFunction::Memcpy},
+      {"memmove", NativeFunction::Memmove},
+      {"memset", NativeFunction::Memset}};
+  static const std::pair<const char *, NativeFunction> stringFunctions[] = {
+      {"strlen", NativeFunction::Strlen},
+      {"strcmp", NativeFunction::Strcmp},
+      {"strncmp", NativeFunction::Strncmp},
+      {"strchr", NativeFunction::Strchr},
+      {"strcpy", NativeFunction::Strcpy},
+      {"strncpy", NativeFunction::Strncpy}};
+  nativeFunctions.clear();
+  auto addNativeFunction = [this](const std::pair<const char *,
+                                                  NativeFunction> &entry) {
+    Function *f = kmodule->module->getFunction(entry.first);
+    if (f && !f->isDeclaration())
+      nativeFunctions[f] = entry.second;
+  };
+  if (NativeMemoryFunctions)
+    for (const auto &entry : memoryFunctions)
+      addNativeFunction(entry);
+  if (NativeStringFunctions)
+    for (const auto &entry : stringFunctions)
+      addNativeFunction(entry);
+
+  if (MemoizeCalls)
+    callMemoizer.reset(new CallMemoizer());
+  if (SummarizeFunctions)
+    functionSummarizer.reset(new FunctionSummarizer(
+        this->solver->solver, arrayCache, SummaryMaxPaths,
+        SummaryMaxInstructions));
+
+  if (TraceEvents) {
+    if (auto file = interpreterHandler->openOutputFile("events.trace"))
+      eventTrace.reset(new EventTrace(std::move(file)));
+  }
+
+  if (WritePTreeLog) {
+    if (auto file = interpreterHandler->openOutputFile("ptree.log"))
+      ptreeLog.reset(new PTreeLog(std::move(file)));
+  }
+
+  if (!ResumeFrom.empty()) {
+    std::string path = ResumeFrom;
+    if (llvm::sys::fs::is_directory(path))
+      path += "/checkpoint";
+    std::string error;
+    resumeTree.reset(new ResumeTree());
+    if (!resumeTree->read(path, error))
+      klee_error("unable to resume: %s", error.c_str());
+  }
+
+  const time::Span checkpointInterval{CheckpointInterval};
+  if (checkpointInterval) {
+    if (auto file = interpreterHandler->openOutputFile("checkpoint")) {
+      checkpointLog.reset(
+          new CheckpointLog(std::move(file), kmodule->infos->getMaxID()));
+      timers.add(std::make_unique<Timer>(checkpointInterval, [&] {
+        checkpointLog->checkpoint();
+      }));
+    }
+  }
+
+  if (PruneUnreachableErrors) {
+    std::set<const Function *> errorFunctions;
+    for (const std::string &name :
+         {ErrorFun.getValue(), std::string("__VERIFIER_error"),
+          std::string("reach_error")})
+      if (!name.empty())
+        if (const Function *f = kmodule->module->getFunction(name))
+          errorFunctions.insert(f);
+    if (errorFunctions.empty())
+      klee_warning("no error function in the module, "
+                   "-prune-unreachable-errors is ignored");
+    else
+      errorReachability.reset(new ErrorReachability(*kmodule, errorFunctions));
+  }
+
   if (StatsTracker::useStatistics() || userSearcherRequiresMD2U()) {
     statsTracker = 
       new StatsTracker(*this,
@@ -574,6 +1004,15 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
                        userSearcherRequiresMD2U());
   }
 
+  if (!NativeCoverageCommand.empty()) {
+    if (!statsTracker || !StatsTracker::useIStats())
+      klee_warning("-native-coverage-command requires --output-istats, "
+                   "ignoring it");
+    else
+      nativeCoverage.reset(new NativeCoverage(
+          NativeCoverageCommand, std::max(NativeCoverageJobs.getValue(), 1u)));
+  }
+
   // Initialize the context.
   DataLayout *TD = kmodule->targetData.get();
   Context::initialize(TD->isLittleEndian(),
@@ -623,6 +1062,16 @@ void Executor::initializeGlobalObject(ExecutionState &state, ObjectState *os,
                dyn_cast<ConstantDataSequential>(c)) {
     unsigned elementSize =
       targetData->getTypeStoreSize(cds->getElementType());
+    // the raw data is laid out as in memory if it is in the byte order of
+    // the target, as strings and tables of bytes always are
+    if (elementSize == cds->getElementByteSize() &&
+        (elementSize == 1 ||
+         targetData->isLittleEndian() == sys::IsLittleEndianHost)) {
+      StringRef data = cds->getRawDataValues();
+      os->writeBytes(offset, reinterpret_cast<const uint8_t *>(data.data()),
+                     data.size());
+      return;
+    }
     for (unsigned i=0, e=cds->getNumElements(); i != e; ++i)
       initializeGlobalObject(state, os, cds->getElementAsConstant(i),
                              offset + i*elementSize);
@@ -643,8 +1092,8 @@ MemoryObject *Executor::addExternalObject(ExecutionState &state, void *addr,
                                           unsigned size, bool isReadOnly,
                                           uint64_t specialSegment) {
   auto mo = memory->allocateFixed(size, nullptr, specialSegment);
-  state.addressSpace.concreteAddressMap.insert(
-      {reinterpret_cast<uint64_t>(addr), mo->segment});
+  state.addressSpace.bindConcreteAddress(reinterpret_cast<uint64_t>(addr),
+                                         mo->segment);
   ObjectState *os = bindObjectInState(state, mo, false);
   for (unsigned i = 0; i < size; i++)
     os->write8(i, (uint8_t)mo->segment, ((uint8_t *)addr)[i]);
@@ -812,49 +1261,70 @@ void Executor::initializeGlobals(ExecutionState &state) {
     globalAddresses.insert(std::make_pair(&*i, evalConstant(alias->getAliasee())));
   }
 
-  // once all objects are allocated, do the actual initialization
-  // remember constant objects to initialise their counter part for external
-  // calls
-  std::vector<ObjectState *> constantObjects;
-  SegmentAddressMap initializedMOs;
-
+  // once all objects are allocated, do the actual initialization; the
+  // globals get real memory only once they are passed to an external call
+  // (see getConcreteAddress), which copies their contents out then
   for (Module::const_global_iterator i = m->global_begin(), e = m->global_end();
        i != e; ++i) {
     if (i->hasInitializer()) {
       const GlobalVariable *v = &*i;
       MemoryObject *mo = globalObjects.find(v)->second;
-      void *address = memory->allocateMemory(
-          mo->allocatedSize, getAllocationAlignment(mo->allocSite));
-      if (!address)
-        klee_error("Couldn't allocate memory for external function");
-
-      initializedMOs.insert({mo->segment, reinterpret_cast<uint64_t>(address)});
-      state.addressSpace.concreteAddressMap.insert(
-          {reinterpret_cast<uint64_t>(address), mo->getSegment()});
-      state.addressSpace.segmentMap.replace(
-          std::make_pair(mo->getSegment(), mo));
-
       const ObjectState *os = state.addressSpace.findObject(mo);
       assert(os);
       ObjectState *wos = state.addressSpace.getWriteable(mo, os);
 
       initializeGlobalObject(state, wos, i->getInitializer(), 0);
       if (i->isConstant())
-        constantObjects.emplace_back(wos);
+        wos->setReadOnly(true);
     }
   }
+}
 
-  // initialise constant memory that is potentially used with external calls
-  if (!constantObjects.empty()) {
-    // initialise the actual memory with constant values
-    state.addressSpace.copyOutConcretes(initializedMOs);
+uint64_t Executor::getConcreteAddress(ExecutionState &state,
+                                      const MemoryObject *mo) {
+  uint64_t address;
+  if (state.addressSpace.resolveInConcreteMap(mo->segment, address))
+    return address;
+
+  void *addr = memory->allocateMemory(mo->allocatedSize,
+                                      getAllocationAlignment(mo->allocSite));
+  if (!addr)
+    klee_error("Couldn't allocate memory for external function");
+  address = reinterpret_cast<uint64_t>(addr);
+  // later calls and pointers returned by externals refer to the same memory
+  state.addressSpace.bindConcreteAddress(address, mo->segment);
+  return address;
+}
 
-    // mark constant objects as read-only
-    for (auto obj : constantObjects)
-      obj->setReadOnly(true);
+void Executor::takeGlobalsSnapshot(const ExecutionState &state,
+                                   const MemoryMap &before) {
+  globalsSnapshot = std::make_unique<GlobalsSnapshot>();
+  const AddressSpace &as = state.addressSpace;
+  for (const auto &binding : as.objects) {
+    const MemoryObject *mo = binding.first;
+    if (before.lookup(mo))
+      continue;
+
+    // The state keeps writing to the objects it owns, so the snapshot
+    // holds its own unowned copies of those
+    const ObjectState *os = binding.second;
+    ObjectState *shared = os->readOnly ? const_cast<ObjectState *>(os)
+                                       : new ObjectState(*os);
+    globalsSnapshot->objects.emplace_back(mo, shared);
+
+    uint64_t address;
+    if (mo->segment && as.resolveInConcreteMap(mo->segment, address))
+      globalsSnapshot->concreteAddresses.emplace_back(mo->segment, address);
   }
 }
 
+void Executor::restoreGlobalsSnapshot(ExecutionState &state) {
+  for (const auto &entry : globalsSnapshot->objects)
+    state.addressSpace.bindSharedObject(entry.first, entry.second);
+  for (const auto &entry : globalsSnapshot->concreteAddresses)
+    state.addressSpace.bindConcreteAddress(entry.second, entry.first);
+}
+
 void Executor::branch(ExecutionState &state, 
                       const std::vector< ref<Expr> > &conditions,
                       std::vector<ExecutionState*> &result) {
@@ -863,7 +1333,8 @@ void Executor::branch(ExecutionState &state,
   assert(N);
 
   if (MaxForks!=~0u && stats::forks >= MaxForks) {
-    unsigned next = theRNG.getInt32() % N;
+    unsigned next = getRandom(state, N);
+    state.takeBranch(next);
     for (unsigned i=0; i<N; ++i) {
       if (i == next) {
         result.push_back(&state);
@@ -873,16 +1344,27 @@ void Executor::branch(ExecutionState &state,
     }
   } else {
     stats::forks += N-1;
+    if (!staticForks.empty())
+      staticForks[state.prevPC->info->id] += N-1;
+
+    if (callMemoizer && N > 1)
+      CallMemoizer::noteImpure(state);
 
     // XXX do proper balance or keep random?
     result.push_back(&state);
     for (unsigned i=1; i<N; ++i) {
       ExecutionState *es = result[theRNG.getInt32() % i];
       ExecutionState *ns = es->branch();
+      EventTrace::record(TraceEvent::Fork, es, reinterpret_cast<uintptr_t>(ns));
       addedStates.push_back(ns);
       result.push_back(ns);
       processTree->attach(es->ptreeNode, ns, es);
     }
+    // the children are still copies of the parent here
+    for (unsigned i = 0; i < N; ++i)
+      result[i]->takeBranch(i);
+    if (checkpointLog || resumeTree)
+      assignCheckpointIds(state.checkpointId, result);
   }
 
   // If necessary redistribute seeds to match conditions, killing
@@ -892,8 +1374,10 @@ void Executor::branch(ExecutionState &state,
   std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
     seedMap.find(&state);
   if (it != seedMap.end()) {
-    std::vector<SeedInfo> seeds = it->second;
+    patchSeeds(state, it->second);
+    std::vector<SeedInfo> seeds = std::move(it->second);
     seedMap.erase(it);
+    std::shared_ptr<const Assignment> model;
 
     // Assume each seed only satisfies one condition (necessarily true
     // when conditions are mutually exclusive and their conjunction is
@@ -902,24 +1386,18 @@ void Executor::branch(ExecutionState &state,
            siie = seeds.end(); siit != siie; ++siit) {
       unsigned i;
       for (i=0; i<N; ++i) {
-        ref<ConstantExpr> res;
-        bool success = 
-          solver->getValue(state, siit->assignment.evaluate(conditions[i]), 
-                           res);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
-        if (res->isTrue())
+        if (evaluateSeed(state, *siit, conditions[i], model)->isTrue())
           break;
       }
       
       // If we didn't find a satisfying condition randomly pick one
       // (the seed will be patched).
       if (i==N)
-        i = theRNG.getInt32() % N;
+        i = getRandom(state, N, siit - seeds.begin());
 
       // Extra check in case we're replaying seeds with a max-fork
       if (result[i])
-        seedMap[result[i]].push_back(*siit);
+        seedMap[result[i]].push_back(std::move(*siit));
     }
 
     if (OnlyReplaySeeds) {
@@ -937,56 +1415,284 @@ void Executor::branch(ExecutionState &state,
       addConstraint(*result[i], conditions[i]);
 }
 
+ref<klee::ConstantExpr>
+Executor::evaluateSeed(const ExecutionState &state, const SeedInfo &seed,
+                       ref<Expr> e, std::shared_ptr<const Assignment> &model) {
+  ref<Expr> value = seed.assignment.evaluate(e);
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value))
+    return CE;
+
+  // Any model of the constraints gives the free values, so one solver
+  // query serves every seed rather than one query per seed.
+  if (!model) {
+    bool success = solver->getInitialValues(state, model);
+    assert(success && "FIXME: Unhandled solver failure");
+    (void) success;
+  }
+  return cast<ConstantExpr>(model->evaluate(value));
+}
+
+unsigned Executor::getRandom(const ExecutionState &state, unsigned n,
+                             unsigned salt) {
+  if (interpreterOpts.DeterministicPaths)
+    return state.getPathRandom(n, salt);
+  return theRNG.getInt32() % n;
+}
+
+void Executor::patchSeeds(ExecutionState &state,
+                          std::vector<SeedInfo> &seeds) {
+  bool warn = false;
+  for (SeedInfo &si : seeds) {
+    if (si.unpatched.isNull())
+      continue;
+    si.patchSeed(state, si.unpatched, solver);
+    si.unpatched = nullptr;
+    warn = true;
+  }
+  if (warn)
+    klee_warning("seeds patched for violating constraint");
+}
+
+bool Executor::evaluateSeeds(const std::vector<SeedInfo> &seeds,
+                             ref<Expr> condition, bool &trueSeed,
+                             bool &falseSeed) {
+  for (const SeedInfo &seed : seeds) {
+    ref<Expr> value = seed.assignment.evaluate(condition);
+    ConstantExpr *CE = dyn_cast<ConstantExpr>(value);
+    if (!CE)
+      return false;
+    (CE->isTrue() ? trueSeed : falseSeed) = true;
+  }
+  return true;
+}
+
+bool Executor::provePendingCondition(ExecutionState &state) {
+  ref<Expr> condition = state.pendingCondition;
+  state.pendingCondition = nullptr;
+
+  QueryPurposeScope purpose(*solver, BranchQuery);
+  bool feasible;
+  if (!solver->mayBeTrue(state, condition, feasible)) {
+    terminateStateEarly(state, "Query timed out (seed replay).");
+    return false;
+  }
+  if (!feasible) {
+    ++stats::infeasibleSeedBranches;
+    terminateState(state);
+    return false;
+  }
+  addConstraint(state, condition);
+  return true;
+}
+
+template <typename Query>
+bool Executor::solveWithBudget(const ExecutionState &state,
+                               SolverTimeoutPolicy::Purpose purpose,
+                               Query query) {
+  if (&state == retriedState && purpose == SolverTimeoutPolicy::Decisive) {
+    solver->setTimeout(coreSolverTimeout);
+    bool success = query(coreSolverTimeout);
+    solver->setTimeout(time::Span());
+    if (success)
+      retriedState = nullptr;
+    return success;
+  }
+
+  time::Span budget;
+  for (unsigned attempt = 0;
+       timeoutPolicy.getBudget(solver->latencies, purpose, attempt, budget);
+       ++attempt) {
+    if (attempt)
+      ++stats::solverTimeoutEscalations;
+    solver->setTimeout(budget);
+    bool success = query(budget);
+    solver->setTimeout(time::Span());
+    if (success)
+      return true;
+  }
+  return false;
+}
+
+bool Executor::deferState(ExecutionState &state) {
+  // the state has already waited for its full attempt
+  if (&state == retriedState) {
+    retriedState = nullptr;
+    return false;
+  }
+  // seeding runs without a searcher to pause the state in
+  if (!AdaptiveSolverTimeout || !searcher)
+    return false;
+
+  ++stats::deferredStates;
+  state.pc = state.prevPC;
+  deferredStates.push_back(&state);
+  pauseState(state);
+  return true;
+}
+
+bool Executor::findSwitchTargets(ExecutionState &state, ref<Expr> cond,
+                                 const std::vector<ref<Expr> > &caseValues,
+                                 const std::vector<BasicBlock *> &successors,
+                                 const std::vector<ref<Expr> > &matches,
+                                 std::vector<bool> &feasible) {
+  std::map<ref<Expr>, unsigned> caseIndex;
+  for (unsigned i = 0; i != caseValues.size(); ++i)
+    caseIndex.insert(std::make_pair(caseValues[i], i));
+
+  // Every model leads to a new target, whose cases are then excluded, so
+  // this asks one query per feasible target and one to find no more.
+  feasible.assign(matches.size(), false);
+  std::vector<ref<Expr> > assumptions;
+  for (;;) {
+    std::shared_ptr<const Assignment> model;
+    bool hasSolution;
+    if (!solver->getInitialValues(state, assumptions, model, hasSolution))
+      return false;
+    if (!hasSolution)
+      return true;
+
+    ref<ConstantExpr> value = dyn_cast<ConstantExpr>(model->evaluate(cond));
+    if (value.isNull())
+      // the model does not bind everything the condition depends on
+      return false;
+
+    auto it = caseIndex.find(value);
+    if (it == caseIndex.end()) {
+      // values of cases going to the default target are not in matches
+      // either, the default condition includes them
+      feasible.back() = true;
+      assumptions.push_back(Expr::createIsZero(matches.back()));
+      continue;
+    }
+    ref<Expr> excluded = ConstantExpr::alloc(1, Expr::Bool);
+    for (unsigned i = 0; i != successors.size(); ++i) {
+      if (successors[i] != successors[it->second])
+        continue;
+      feasible[i] = true;
+      excluded = AndExpr::create(excluded, Expr::createIsZero(matches[i]));
+    }
+    assumptions.push_back(excluded);
+  }
+}
+
+bool Executor::exceedsStaticLimits(const ExecutionState &current) const {
+  unsigned id = current.prevPC->info->id;
+  if (staticForks[id] > staticForkLimit ||
+      staticSolveTime[id] > staticSolveLimit)
+    return true;
+  CallPathNode *cpn = current.stack.back().callPathNode;
+  return cpn && (cpn->statistics.getValue(stats::forks) > staticCPForkLimit ||
+                 cpn->statistics.getValue(stats::solverTime) >
+                     staticCPSolveLimit);
+}
+
+void Executor::updateStaticLimits() {
+  // the shares are not meaningful until the totals have grown a bit
+  if (!statsTracker || statsTracker->elapsed() <= time::seconds(60))
+    return;
+  auto limit = [](uint64_t total, double pct) {
+    return pct < 1. ? static_cast<uint64_t>(total * pct) : UINT64_MAX;
+  };
+  staticForkLimit = limit(stats::forks, MaxStaticForkPct);
+  staticSolveLimit = limit(stats::solverTime, MaxStaticSolvePct);
+  staticCPForkLimit = limit(stats::forks, MaxStaticCPForkPct);
+  staticCPSolveLimit = limit(stats::solverTime, MaxStaticCPSolvePct);
+}
+
+QueryPurpose Executor::getBranchPurpose(ref<Expr> condition) const {
+  if (symbolicAddresses.empty())
+    return BranchQuery;
+  std::vector<const Array *> arrays;
+  findSymbolicObjects(condition, arrays);
+  for (const Array *array : arrays)
+    if (array == addressLayoutArray ||
+        llvm::StringRef(array->name).startswith("mo_addr_for_seg:"))
+      return PointerComparisonQuery;
+  return BranchQuery;
+}
+
 Executor::StatePair 
 Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
+  // internal forks count for the operation they are part of
+  QueryPurposeScope purpose(*solver, isInternal ? solver->purpose
+                                                : getBranchPurpose(condition));
   Solver::Validity res;
   std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
     seedMap.find(&current);
   bool isSeeding = it != seedMap.end();
-
-  if (!isSeeding && !isa<ConstantExpr>(condition) && 
-      (MaxStaticForkPct!=1. || MaxStaticSolvePct != 1. ||
-       MaxStaticCPForkPct!=1. || MaxStaticCPSolvePct != 1.) &&
-      statsTracker->elapsed() > time::seconds(60)) {
-    StatisticManager &sm = *theStatisticManager;
-    CallPathNode *cpn = current.stack.back().callPathNode;
-    if ((MaxStaticForkPct<1. &&
-         sm.getIndexedValue(stats::forks, sm.getIndex()) > 
-         stats::forks*MaxStaticForkPct) ||
-        (MaxStaticCPForkPct<1. &&
-         cpn && (cpn->statistics.getValue(stats::forks) > 
-                 stats::forks*MaxStaticCPForkPct)) ||
-        (MaxStaticSolvePct<1 &&
-         sm.getIndexedValue(stats::solverTime, sm.getIndex()) > 
-         stats::solverTime*MaxStaticSolvePct) ||
-        (MaxStaticCPForkPct<1. &&
-         cpn && (cpn->statistics.getValue(stats::solverTime) > 
-                 stats::solverTime*MaxStaticCPSolvePct))) {
-      ref<ConstantExpr> value; 
-      bool success = solver->getValue(current, condition, value);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
-      addConstraint(current, EqExpr::create(value, condition));
-      condition = value;
-    }
+  // the seeds decide branches below, so they must model the constraints
+  if (isSeeding)
+    patchSeeds(current, it->second);
+  bool isReplaying = replayPath && !isInternal &&
+                     replayPosition < replayPath->size();
+
+  // The replayed path was feasible when it was recorded, so the branch it
+  // took needs no solver query.
+  if (isReplaying && !isSeeding && !isa<ConstantExpr>(condition)) {
+    bool branch = (*replayPath)[replayPosition++];
+    addConstraint(current, branch ? condition : Expr::createIsZero(condition));
+    if (pathWriter)
+      current.pathOS.writeBranch(branch);
+    return branch ? StatePair(&current, 0) : StatePair(0, &current);
+  }
+
+  if (!isSeeding && !isa<ConstantExpr>(condition) &&
+      !staticForks.empty() && exceedsStaticLimits(current)) {
+    ref<ConstantExpr> value; 
+    bool success = solver->getValue(current, condition, value);
+    assert(success && "FIXME: Unhandled solver failure");
+    (void) success;
+    addConstraint(current, EqExpr::create(value, condition));
+    condition = value;
   }
 
-  time::Span timeout = coreSolverTimeout;
-  if (isSeeding)
+  // A side some seed takes is feasible, the seed is a model of it. When
+  // the seeds fix the condition they decide the branch without a query.
+  bool trueSeed = false, falseSeed = false;
+  bool seedsDecide = isSeeding && FastSeedReplay &&
+                     !isa<ConstantExpr>(condition) &&
+                     evaluateSeeds(it->second, condition, trueSeed, falseSeed);
+
+  time::Span queryCost = current.queryCost;
+  bool success;
+  if (seedsDecide) {
+    ++stats::seedDecidedBranches;
+    success = true;
+    res = Solver::Unknown;
+    if (!(trueSeed && falseSeed) &&
+        (current.forkDisabled || OnlyReplaySeeds)) {
+      res = trueSeed ? Solver::True : Solver::False;
+      addConstraint(current,
+                    trueSeed ? condition : Expr::createIsZero(condition));
+    }
+  } else if (isSeeding) {
+    time::Span timeout = coreSolverTimeout;
     timeout *= static_cast<unsigned>(it->second.size());
-  solver->setTimeout(timeout);
-  bool success = solver->evaluate(current, condition, res);
-  solver->setTimeout(time::Span());
+    solver->setTimeout(timeout);
+    success = solver->evaluate(current, condition, res);
+    solver->setTimeout(time::Span());
+  } else {
+    success = solveWithBudget(current, SolverTimeoutPolicy::Decisive,
+                              [&](time::Span) {
+                                return solver->evaluate(current, condition,
+                                                        res);
+                              });
+  }
+  if (!staticSolveTime.empty())
+    staticSolveTime[current.prevPC->info->id] +=
+        (current.queryCost - queryCost).toMicroseconds();
   if (!success) {
-    current.pc = current.prevPC;
-    terminateStateEarly(current, "Query timed out (fork).");
+    // internal forks may follow other effects of the instruction, only
+    // a branch can safely run it again
+    if (isInternal || !deferState(current)) {
+      current.pc = current.prevPC;
+      terminateStateEarly(current, "Query timed out (fork).");
+    }
     return StatePair(0, 0);
   }
 
   if (!isSeeding) {
-    if (replayPath && !isInternal) {
-      assert(replayPosition<replayPath->size() &&
-             "ran out of branches in replay path mode");
+    if (isReplaying) {
       bool branch = (*replayPath)[replayPosition++];
       
       if (res==Solver::True) {
@@ -1019,9 +1725,15 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
 	  klee_warning_once(0, "skipping fork (fork disabled globally)");
 	else 
 	  klee_warning_once(0, "skipping fork (max-forks reached)");
+        if (current.subsumptionNode)
+          current.subsumptionNode->markIncomplete();
 
         TimerStatIncrementer timer(stats::forkTime);
-        if (theRNG.getBool()) {
+        bool side = interpreterOpts.DeterministicPaths
+                        ? current.getPathRandom(2)
+                        : theRNG.getBool();
+        current.takeBranch(side);
+        if (side) {
           addConstraint(current, condition);
           res = Solver::True;        
         } else {
@@ -1034,7 +1746,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
 
   // Fix branch in only-replay-seed mode, if we don't have both true
   // and false seeds.
-  if (isSeeding && 
+  if (isSeeding && !seedsDecide &&
       (current.forkDisabled || OnlyReplaySeeds) && 
       res == Solver::Unknown) {
     bool trueSeed=false, falseSeed=false;
@@ -1073,7 +1785,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   if (res==Solver::True) {
     if (!isInternal) {
       if (pathWriter) {
-        current.pathOS << "1";
+        current.pathOS.writeBranch(true);
       }
     }
 
@@ -1081,7 +1793,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   } else if (res==Solver::False) {
     if (!isInternal) {
       if (pathWriter) {
-        current.pathOS << "0";
+        current.pathOS.writeBranch(false);
       }
     }
 
@@ -1091,26 +1803,33 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     ExecutionState *falseState, *trueState = &current;
 
     ++stats::forks;
+    if (!staticForks.empty())
+      ++staticForks[current.prevPC->info->id];
 
     falseState = trueState->branch();
+    trueState->takeBranch(1);
+    falseState->takeBranch(0);
+    // the frames of both states share the recordings of the calls
+    if (callMemoizer)
+      CallMemoizer::noteImpure(current);
+    EventTrace::record(TraceEvent::Fork, trueState,
+                       reinterpret_cast<uintptr_t>(falseState));
     addedStates.push_back(falseState);
+    if (checkpointLog || resumeTree)
+      assignCheckpointIds(current.checkpointId, {trueState, falseState});
 
     if (it != seedMap.end()) {
-      std::vector<SeedInfo> seeds = it->second;
+      std::vector<SeedInfo> seeds = std::move(it->second);
       it->second.clear();
       std::vector<SeedInfo> &trueSeeds = seedMap[trueState];
       std::vector<SeedInfo> &falseSeeds = seedMap[falseState];
+      std::shared_ptr<const Assignment> model;
       for (std::vector<SeedInfo>::iterator siit = seeds.begin(), 
              siie = seeds.end(); siit != siie; ++siit) {
-        ref<ConstantExpr> res;
-        bool success = 
-          solver->getValue(current, siit->assignment.evaluate(condition), res);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
-        if (res->isTrue()) {
-          trueSeeds.push_back(*siit);
+        if (evaluateSeed(current, *siit, condition, model)->isTrue()) {
+          trueSeeds.push_back(std::move(*siit));
         } else {
-          falseSeeds.push_back(*siit);
+          falseSeeds.push_back(std::move(*siit));
         }
       }
       
@@ -1125,7 +1844,8 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       }
       if (swapInfo) {
         std::swap(trueState->coveredNew, falseState->coveredNew);
-        std::swap(trueState->coveredLines, falseState->coveredLines);
+        std::swap(trueState->coveredInstructions,
+                  falseState->coveredInstructions);
       }
     }
 
@@ -1136,20 +1856,30 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       // is used for both falseState and trueState.
       falseState->pathOS = pathWriter->open(current.pathOS);
       if (!isInternal) {
-        trueState->pathOS << "1";
-        falseState->pathOS << "0";
+        trueState->pathOS.writeBranch(true);
+        falseState->pathOS.writeBranch(false);
       }
     }
     if (symPathWriter) {
       falseState->symPathOS = symPathWriter->open(current.symPathOS);
       if (!isInternal) {
-        trueState->symPathOS << "1";
-        falseState->symPathOS << "0";
+        trueState->symPathOS.writeBranch(true);
+        falseState->symPathOS.writeBranch(false);
       }
     }
 
-    addConstraint(*trueState, condition);
-    addConstraint(*falseState, Expr::createIsZero(condition));
+    // the side without seeds waits for its feasibility check until it runs
+    ExecutionState *unproven = nullptr;
+    if (seedsDecide && !(trueSeed && falseSeed))
+      unproven = trueSeed ? falseState : trueState;
+    if (trueState == unproven)
+      trueState->pendingCondition = condition;
+    else
+      addConstraint(*trueState, condition);
+    if (falseState == unproven)
+      falseState->pendingCondition = Expr::createIsZero(condition);
+    else
+      addConstraint(*falseState, Expr::createIsZero(condition));
 
     // Kinda gross, do we even really still want this option?
     if (MaxDepth && MaxDepth<=trueState->depth) {
@@ -1162,6 +1892,131 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   }
 }
 
+void Executor::assignCheckpointIds(
+    std::uint64_t parent, const std::vector<ExecutionState *> &children) {
+  // the forks of a finished subtree are finished as well
+  if (!parent) {
+    for (ExecutionState *es : children)
+      es->checkpointId = 0;
+    return;
+  }
+
+  if (resumeTree) {
+    auto it = resumeTree->forks.find(parent);
+    if (it != resumeTree->forks.end()) {
+      std::vector<std::uint64_t> ids = std::move(it->second);
+      resumeTree->forks.erase(it);
+      // the fork is in the new log already
+      if (ids.size() == children.size()) {
+        for (unsigned i = 0; i != children.size(); ++i)
+          children[i]->checkpointId = ids[i];
+        return;
+      }
+      klee_warning_once(0, "execution diverged from the resumed checkpoint, "
+                           "exploring the diverging paths anew");
+    }
+  }
+
+  std::vector<std::uint64_t> ids;
+  for (ExecutionState *es : children) {
+    es->checkpointId = nextCheckpointId++;
+    ids.push_back(es->checkpointId);
+  }
+  if (checkpointLog)
+    checkpointLog->fork(parent, ids);
+}
+
+void Executor::resumeCheckpoint() {
+  StatisticManager &sm = *theStatisticManager;
+  for (const auto &value : resumeTree->statistics)
+    if (Statistic *s = sm.getStatisticByName(value.first))
+      sm.setValue(*s, value.second);
+  if (sm.hasIndexedStats()) {
+    for (unsigned id : resumeTree->covered) {
+      if (id >= kmodule->infos->getMaxID())
+        continue;
+      sm.setIndexedValue(stats::coveredInstructions, id, 1);
+      sm.setIndexedValue(stats::uncoveredInstructions, id, 0);
+    }
+  }
+
+  nextCheckpointId = std::max(nextCheckpointId, resumeTree->maxId + 1);
+  if (checkpointLog)
+    for (const auto &f : resumeTree->forks)
+      checkpointLog->fork(f.first, f.second);
+  klee_message("resuming %zu forks from the checkpoint",
+               resumeTree->forks.size());
+}
+
+bool Executor::takeReachingBranch(ExecutionState &state, BranchInst *bi,
+                                  ref<Expr> condition) {
+  if (seedMap.count(&state) || replayPath)
+    return false;
+  bool reaches[2] = {errorReachability->mayReach(state, bi->getSuccessor(0)),
+                     errorReachability->mayReach(state, bi->getSuccessor(1))};
+  if (reaches[0] && reaches[1])
+    return false;
+
+  if (!reaches[0] && !reaches[1]) {
+    stats::unreachableBranches += 2;
+    terminateState(state);
+    return true;
+  }
+
+  // only the side that may reach an error site needs to be feasible
+  ++stats::unreachableBranches;
+  unsigned side = reaches[0] ? 0 : 1;
+  ref<Expr> taken = side == 0 ? condition : Expr::createIsZero(condition);
+  QueryPurposeScope purpose(*solver, getBranchPurpose(condition));
+  bool feasible;
+  if (!solver->mayBeTrue(state, taken, feasible)) {
+    terminateStateEarly(state, "Query timed out (reachability).");
+    return true;
+  }
+  if (!feasible) {
+    terminateState(state);
+    return true;
+  }
+  addConstraint(state, taken);
+  if (pathWriter)
+    state.pathOS.writeBranch(side == 0);
+
+  if (statsTracker && state.stack.back().kf->trackCoverage)
+    statsTracker->markBranchVisited(side == 0 ? &state : nullptr,
+                                    side == 1 ? &state : nullptr);
+  transferToBasicBlock(bi->getSuccessor(side), bi->getParent(), state);
+  return true;
+}
+
+Executor::StatePair
+Executor::fork(ExecutionState &current, ref<Expr> segmentCondition,
+               ref<Expr> offsetCondition, bool isInternal) {
+  // a decided part either decides the branch or leaves the other part
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(segmentCondition))
+    return fork(current, CE->isTrue() ? offsetCondition : segmentCondition,
+                isInternal);
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(offsetCondition))
+    return fork(current, CE->isTrue() ? segmentCondition : offsetCondition,
+                isInternal);
+
+  ref<Expr> condition = AndExpr::create(segmentCondition, offsetCondition);
+  if (seedMap.count(&current) ||
+      (replayPath && !isInternal && replayPosition < replayPath->size()))
+    return fork(current, condition, isInternal);
+
+  // Pointer conditions mostly fail for all but one object, so ask for the
+  // true side first. If it holds, the query cache already knows half of
+  // the validity query the regular fork issues.
+  bool mayBeTrue;
+  bool success = solveWithBudget(
+      current, SolverTimeoutPolicy::Speculative, [&](time::Span) {
+        return solver->mayBeTrue(current, condition, mayBeTrue);
+      });
+  if (success && !mayBeTrue)
+    return fork(current, ConstantExpr::alloc(0, Expr::Bool), isInternal);
+  return fork(current, condition, isInternal);
+}
+
 void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(condition)) {
     if (!CE->isTrue())
@@ -1173,21 +2028,23 @@ void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
   std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
     seedMap.find(&state);
   if (it != seedMap.end()) {
-    bool warn = false;
-    for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
-           siie = it->second.end(); siit != siie; ++siit) {
+    for (SeedInfo &si : it->second) {
+      // the seed mostly decides the condition alone
+      ref<Expr> value = si.assignment.evaluate(condition);
       bool res;
-      bool success = 
-        solver->mustBeFalse(state, siit->assignment.evaluate(condition), res);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
-      if (res) {
-        siit->patchSeed(state, condition, solver);
-        warn = true;
+      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
+        res = CE->isFalse();
+      } else {
+        bool success = solver->mustBeFalse(state, value, res);
+        assert(success && "FIXME: Unhandled solver failure");
+        (void) success;
       }
+      // patched once the seed is used again, see patchSeeds
+      if (res)
+        si.unpatched = si.unpatched.isNull()
+                           ? condition
+                           : AndExpr::create(si.unpatched, condition);
     }
-    if (warn)
-      klee_warning("seeds patched for violating constraint"); 
   }
 
   state.addConstraint(condition);
@@ -1210,53 +2067,182 @@ const Cell& Executor::eval(KInstruction *ki, unsigned index,
     return kmodule->constantTable[index];
   } else {
     unsigned index = vnumber;
-    StackFrame &sf = state.stack.back();
-    return sf.locals[index];
+    const StackFrame &sf = state.stack.back();
+    return sf.getLocal(index);
   }
 }
 
 void Executor::bindLocal(KInstruction *target, ExecutionState &state,
-                         const KValue &value) {
-  getDestCell(state, target) = value;
+                         KValue value) {
+  state.stack.back().setLocal(target->dest,
+                              capExprDepth(state, target, std::move(value)));
 }
 
 void Executor::bindArgument(KFunction *kf, unsigned index,
                             ExecutionState &state, const KValue &value) {
-  getArgumentCell(state, kf, index) = value;
+  state.stack.back().setLocal(kf->getArgRegister(index), value);
+}
+
+ref<Expr> Executor::getSymbolicAddress(ExecutionState &state,
+                                       const MemoryObject *mo) {
+  uint64_t segment = mo->segment;
+  ref<Expr> size = mo->getSizeExpr();
+  Expr::Width width = Context::get().getPointerWidth();
+  unsigned bytes = width / 8;
+
+  ref<Expr> &address = symbolicAddresses[segment];
+  if (address.isNull()) {
+    if (symbolicAddresses.size() <= AddressLayoutSlots) {
+      if (!addressLayoutArray)
+        addressLayoutArray =
+            arrayCache.CreateArray("addr_layout", AddressLayoutSlots * bytes);
+      // little-endian read of the next free slot
+      UpdateList ul(addressLayoutArray, 0);
+      unsigned slot = (symbolicAddresses.size() - 1) * bytes;
+      std::vector<ref<Expr> > kids;
+      for (unsigned i = bytes; i != 0; --i)
+        kids.push_back(ReadExpr::create(
+            ul, ConstantExpr::alloc(slot + i - 1, Expr::Int32)));
+      address = ConcatExpr::createN(kids.size(), kids.data());
+    } else {
+      const Array *array = arrayCache.CreateArray(
+          "mo_addr_for_seg:" + std::to_string(segment), bytes);
+      address = Expr::createTempRead(array, width);
+    }
+  }
+
+  AddressLayoutMap &layout = state.addressSpace.addressLayout;
+  if (layout.count(segment))
+    return address;
+
+  // a non-null range that does not wrap around...
+  ref<Expr> end = AddExpr::create(address, size);
+  addConstraint(state, UltExpr::create(ConstantExpr::alloc(0, width), address));
+  addConstraint(state, UleExpr::create(address, end));
+  // ...between the ranges of the neighbours, the rest follows by transitivity
+  if (const AddressLayoutMap::value_type *prev = layout.lookup_previous(segment))
+    addConstraint(state,
+                  UleExpr::create(AddExpr::create(prev->second.address,
+                                                  prev->second.size),
+                                  address));
+  AddressLayoutMap::iterator next = layout.upper_bound(segment);
+  if (next != layout.end())
+    addConstraint(state, UleExpr::create(end, next->second.address));
+
+  layout = layout.insert(
+      std::make_pair(segment, LayoutEntry{address, size, mo}));
+  return address;
 }
 
 ref<Expr> Executor::toUnique(const ExecutionState &state, 
                              const ref<Expr> &e) {
+  QueryPurposeScope purpose(*solver, ConcretizationQuery);
   ref<Expr> result = e;
 
   if (!isa<ConstantExpr>(e)) {
     ref<ConstantExpr> value;
     bool isTrue = false;
     auto expr = optimizer.optimizeExpr(e, true);
-    solver->setTimeout(coreSolverTimeout);
-    if (solver->getValue(state, expr, value)) {
-      ref<Expr> cond = EqExpr::create(expr, value);
-      cond = optimizer.optimizeExpr(cond, false);
-      if (solver->mustBeTrue(state, cond, isTrue) && isTrue)
-        result = value;
-    }
-    solver->setTimeout(time::Span());
+    bool success = solveWithBudget(
+        state, SolverTimeoutPolicy::Speculative, [&](time::Span) {
+          if (!solver->getValue(state, expr, value))
+            return false;
+          ref<Expr> cond = EqExpr::create(expr, value);
+          cond = optimizer.optimizeExpr(cond, false);
+          return solver->mustBeTrue(state, cond, isTrue);
+        });
+    if (success && isTrue)
+      result = value;
   }
   
   return result;
 }
 
 
+KValue Executor::capExprDepth(ExecutionState &state, KInstruction *ki,
+                              KValue value) {
+  if (!MaxExprDepth)
+    return value;
+  unsigned depth = std::max(value.getSegment()->getDepth(),
+                            value.getOffset()->getDepth());
+  if (depth <= MaxExprDepth)
+    return value;
+
+  ++stats::exprDepthConcretizations;
+  ++exprDepthConcretizations[ki];
+
+  std::string str;
+  llvm::raw_string_ostream os(str);
+  os << "concretized a value of depth " << depth << " (limit "
+     << MaxExprDepth << ") at " << ki->info->file << ":" << ki->info->line
+     << " (" << ki->inst->getOpcodeName() << ")";
+  state.exprDepthConcretizations.push_back(os.str());
+
+  if (value.pointerSegment->getDepth() > MaxExprDepth)
+    value.pointerSegment =
+        toConstant(state, value.pointerSegment, "max-expr-depth");
+  if (value.value->getDepth() > MaxExprDepth)
+    value.value = toConstant(state, value.value, "max-expr-depth");
+  return value;
+}
+
+void Executor::reportExprDepthConcretizations() {
+  if (exprDepthConcretizations.empty())
+    return;
+
+  std::vector<std::pair<uint64_t, const KInstruction *> > counts;
+  for (const auto &entry : exprDepthConcretizations)
+    counts.emplace_back(entry.second, entry.first);
+  std::sort(counts.begin(), counts.end(),
+            [](const std::pair<uint64_t, const KInstruction *> &a,
+               const std::pair<uint64_t, const KInstruction *> &b) {
+              if (a.first != b.first)
+                return a.first > b.first;
+              return a.second->info->id < b.second->info->id;
+            });
+
+  kmodule->infos->computeAssemblyLines();
+  llvm::raw_ostream &os = interpreterHandler->getInfoStream();
+  os << "Values concretized by -max-expr-depth, by instruction:\n";
+  const unsigned shown = 10;
+  for (unsigned i = 0; i != counts.size() && i != shown; ++i) {
+    const KInstruction *ki = counts[i].second;
+    os << "  " << counts[i].first << " at " << ki->info->file << ":"
+       << ki->info->line << " (" << ki->inst->getOpcodeName() << ", assembly "
+       << "line " << ki->info->assemblyLine << ")\n";
+  }
+  if (counts.size() > shown)
+    os << "  ... and " << counts.size() - shown << " other instructions\n";
+
+  const KInstruction *top = counts.front().second;
+  klee_message("concretized %lu values exceeding -max-expr-depth, most often "
+               "at %s:%u (%lu times)",
+               (unsigned long)stats::exprDepthConcretizations.getValue(),
+               top->info->file.c_str(), top->info->line,
+               (unsigned long)counts.front().first);
+}
+
 /* Concretize the given expression, and return a possible constant value. 
    'reason' is just a documentation string stating the reason for concretization. */
 ref<klee::ConstantExpr> 
 Executor::toConstant(ExecutionState &state, 
                      ref<Expr> e,
                      const char *reason) {
+  // callers keep concretizing the same expressions read from memory, the
+  // pinned value spares simplifying them and the equality is already there
+  if (auto pinned = state.pinnedValues.lookup(e))
+    return pinned->second;
+
+  ref<Expr> original = e;
   e = state.constraints.simplifyExpr(e);
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e))
     return CE;
+  if (auto pinned = state.pinnedValues.lookup(e)) {
+    state.pinnedValues = state.pinnedValues.insert({original, pinned->second});
+    return pinned->second;
+  }
 
+  QueryPurposeScope purpose(*solver, ConcretizationQuery);
   ref<ConstantExpr> value;
   bool success = solver->getValue(state, e, value);
   assert(success && "FIXME: Unhandled solver failure");
@@ -1274,13 +2260,17 @@ Executor::toConstant(ExecutionState &state,
     klee_warning_once(reason, "%s", os.str().c_str());
 
   addConstraint(state, EqExpr::create(e, value));
-    
+  state.pinnedValues = state.pinnedValues.insert({e, value});
+  if (original != e)
+    state.pinnedValues = state.pinnedValues.insert({original, value});
+
   return value;
 }
 
 void Executor::executeGetValue(ExecutionState &state,
                                const KValue& kval,
                                KInstruction *target) {
+  QueryPurposeScope purpose(*solver, ConcretizationQuery);
   ref<Expr> expr = state.constraints.simplifyExpr(kval.getValue());
   ref<Expr> segment = state.constraints.simplifyExpr(kval.getSegment());
 
@@ -1288,14 +2278,25 @@ void Executor::executeGetValue(ExecutionState &state,
     seedMap.find(&state);
   if (it==seedMap.end() ||
       (isa<ConstantExpr>(expr) && isa<ConstantExpr>(segment))) {
+    // a pinned value is implied by the constraints, so it is a value the
+    // expression may take without asking the solver
     ref<ConstantExpr> off, seg;
-    expr = optimizer.optimizeExpr(expr, true);
-    bool success = solver->getValue(state, expr, off);
-    assert(success && "FIXME: Unhandled solver failure");
+    if (auto pinned = state.pinnedValues.lookup(expr)) {
+      off = pinned->second;
+    } else {
+      expr = optimizer.optimizeExpr(expr, true);
+      bool success = solver->getValue(state, expr, off);
+      assert(success && "FIXME: Unhandled solver failure");
+      (void) success;
+    }
 
-    success = solver->getValue(state, segment, seg);
-    assert(success && "FIXME: Unhandled solver failure");
-    (void) success;
+    if (auto pinned = state.pinnedValues.lookup(segment)) {
+      seg = pinned->second;
+    } else {
+      bool success = solver->getValue(state, segment, seg);
+      assert(success && "FIXME: Unhandled solver failure");
+      (void) success;
+    }
     bindLocal(target, state, KValue(seg, off));
   } else {
     // This does not work with segments yet
@@ -1353,6 +2354,7 @@ void Executor::printDebugInstructions(ExecutionState &state) {
     (*stream) << "     " << state.pc->getSourceLocation() << ":";
   }
 
+  kmodule->infos->computeAssemblyLines();
   (*stream) << state.pc->info->assemblyLine;
 
   if (DebugPrintInstructions.isSet(STDERR_ALL) ||
@@ -1371,6 +2373,10 @@ void Executor::printDebugInstructions(ExecutionState &state) {
 
 void Executor::stepInstruction(ExecutionState &state) {
   printDebugInstructions(state);
+  // charge the expressions built since the last step to the instruction
+  // executed then, before the stats tracker moves on to the next one
+  stats::exprAllocations += Expr::allocations - exprAllocationsStepped;
+  exprAllocationsStepped = Expr::allocations;
   if (statsTracker)
     statsTracker->stepInstruction(state);
 
@@ -1412,10 +2418,32 @@ void Executor::executeLifetimeIntrinsic(ExecutionState &state,
                                         KInstruction *allocSite,
                                         const KValue& address,
                                         bool isEnd) {
+  StackFrame &sf = state.stack.back();
+  ConstantExpr *segment = dyn_cast<ConstantExpr>(address.getSegment());
+  if (!isEnd && segment) {
+    // a new lifetime of an alloca whose pointer still refers to its dead
+    // object binds that object again, with undefined contents
+    for (auto it = sf.deadAllocas.begin(), ie = sf.deadAllocas.end();
+         it != ie; ++it) {
+      if (it->first != allocSite ||
+          it->second->segment != segment->getZExtValue())
+        continue;
+      ObjectState *os = bindObjectInState(state, it->second.get(), true);
+      os->initializeToRandom();
+      sf.deadAllocas.erase(it);
+      return;
+    }
+  }
+
   ObjectPair op;
   bool success;
-  llvm::Optional<uint64_t> temp;
-  state.addressSpace.resolveOne(state, solver, address, op, success, temp);
+  if (segment && !segment->isZero()) {
+    // the pointer of an alloca needs no solver to resolve
+    success = state.addressSpace.resolveOneConstantSegment(address, op);
+  } else {
+    llvm::Optional<uint64_t> temp;
+    state.addressSpace.resolveOne(state, solver, address, op, success, temp);
+  }
   if (!success) {
     // the object is dead, create a new one
     // XXX: we should distringuish between resolve error and dead object...
@@ -1434,7 +2462,10 @@ void Executor::executeLifetimeIntrinsic(ExecutionState &state,
   // written before)
 
   if (isEnd) {
+    // keep the object for the next lifetime, unbinding it may free it
+    ref<const MemoryObject> mo(op.first);
     state.removeAlloca(op.first);
+    sf.deadAllocas.push_back(std::make_pair(allocSite, mo));
     //bindLocal(allocSite, state, KValue(Expr::createPointer(0)));
   } else {
     // This is the first call to lifetime start, the object already exists.
@@ -1445,6 +2476,207 @@ void Executor::executeLifetimeIntrinsic(ExecutionState &state,
   }
 }
 
+bool Executor::resolveConcreteRange(ExecutionState &state,
+                                    const KValue &address, uint64_t length,
+                                    ObjectPair &op, unsigned &offset) {
+  ConstantExpr *segment = dyn_cast<ConstantExpr>(address.getSegment());
+  ConstantExpr *value = dyn_cast<ConstantExpr>(address.getOffset());
+  if (!segment || !value || segment->isZero() ||
+      !state.addressSpace.resolveOneConstantSegment(address, op))
+    return false;
+  ConstantExpr *size = dyn_cast<ConstantExpr>(op.first->size);
+  if (!size)
+    return false;
+  uint64_t start = value->getZExtValue();
+  uint64_t end = start + length;
+  if (end < start || end > size->getZExtValue())
+    return false;
+  offset = start;
+  return true;
+}
+
+/// Set \a length to the value of \a value if it is a concrete value.
+static bool getConcreteLength(const KValue &value, uint64_t &length) {
+  klee::ConstantExpr *CE = dyn_cast<klee::ConstantExpr>(value.getValue());
+  if (!CE || CE->getWidth() > Expr::Int64 || !value.getSegment()->isZero())
+    return false;
+  length = CE->getZExtValue();
+  return true;
+}
+
+bool Executor::readConcreteString(ExecutionState &state,
+                                  const KValue &address, uint64_t limit,
+                                  std::string &result, int stop) {
+  ObjectPair op;
+  unsigned offset;
+  if (!resolveConcreteRange(state, address, 0, op, offset))
+    return false;
+  uint64_t size = cast<ConstantExpr>(op.first->size)->getZExtValue();
+  result.clear();
+  for (uint64_t i = offset; result.size() < limit; ++i) {
+    uint8_t byte;
+    if (i >= size || !op.second->getConcreteByte(i, byte))
+      return false;
+    if (!byte)
+      break;
+    result.push_back(byte);
+    if (byte == stop)
+      break;
+  }
+  return true;
+}
+
+bool Executor::executeNativeFunction(ExecutionState &state, KInstruction *ki,
+                                     NativeFunction function,
+                                     const std::vector<Cell> &arguments) {
+  // Anything this cannot decide without the solver, e.g. symbolic pointers,
+  // symbolic bytes or out-of-bounds ranges, is left to the library
+  // function, so that errors are reported at the byte they occur.
+  if (isa<InvokeInst>(ki->inst))
+    return false;
+
+  switch (function) {
+  case NativeFunction::Memcpy:
+  case NativeFunction::Memmove:
+  case NativeFunction::Memset: {
+    if (arguments.size() != 3)
+      return false;
+    uint64_t length;
+    if (!getConcreteLength(arguments[2], length))
+      return false;
+
+    ObjectPair dst;
+    unsigned dstOffset;
+    if (!resolveConcreteRange(state, arguments[0], length, dst, dstOffset) ||
+        dst.second->readOnly)
+      return false;
+
+    if (function == NativeFunction::Memset) {
+      ref<Expr> byte = ExtractExpr::create(arguments[1].getValue(), 0,
+                                           Expr::Int8);
+      if (length)
+        state.addressSpace.getWriteable(dst.first, dst.second)
+            ->fill(dstOffset, byte, length);
+    } else {
+      ObjectPair src;
+      unsigned srcOffset;
+      if (!resolveConcreteRange(state, arguments[1], length, src, srcOffset))
+        return false;
+      // memcpy of overlapping ranges is undefined, copying as memmove does
+      // is one of its behaviours
+      if (length) {
+        ObjectState *wos =
+            state.addressSpace.getWriteable(dst.first, dst.second);
+        const ObjectState *ros = src.first == dst.first ? wos : src.second;
+        wos->copyRange(dstOffset, *ros, srcOffset, length);
+      }
+    }
+    bindLocal(ki, state, arguments[0]);
+    return true;
+  }
+
+  case NativeFunction::Strlen: {
+    if (arguments.size() != 1)
+      return false;
+    std::string str;
+    if (!readConcreteString(state, arguments[0], ~0ull, str))
+      return false;
+    bindLocal(ki, state,
+              KValue(ConstantExpr::alloc(
+                  str.size(), getWidthForLLVMType(ki->inst->getType()))));
+    return true;
+  }
+
+  case NativeFunction::Strcmp:
+  case NativeFunction::Strncmp: {
+    uint64_t limit = ~0ull;
+    if (function == NativeFunction::Strncmp &&
+        (arguments.size() != 3 || !getConcreteLength(arguments[2], limit)))
+      return false;
+    if (arguments.size() < 2)
+      return false;
+    // the second string is not compared past the end of the first
+    std::string a, b;
+    if (!readConcreteString(state, arguments[0], limit, a))
+      return false;
+    if (!readConcreteString(state, arguments[1],
+                            std::min<uint64_t>(limit, a.size() + 1), b))
+      return false;
+    int result = 0;
+    for (size_t i = 0; i < limit; ++i) {
+      unsigned char ca = i < a.size() ? a[i] : 0;
+      unsigned char cb = i < b.size() ? b[i] : 0;
+      if (ca != cb) {
+        // strcmp subtracts plain chars, whose sign depends on the target
+        if (function == NativeFunction::Strcmp && (ca | cb) & 0x80)
+          return false;
+        result = ca - cb;
+        break;
+      }
+      if (!ca)
+        break;
+    }
+    bindLocal(ki, state, KValue(ConstantExpr::alloc(
+                             result, getWidthForLLVMType(ki->inst->getType()))));
+    return true;
+  }
+
+  case NativeFunction::Strchr: {
+    if (arguments.size() != 2)
+      return false;
+    ConstantExpr *ch = dyn_cast<ConstantExpr>(arguments[1].getValue());
+    if (!ch || !arguments[1].getSegment()->isZero())
+      return false;
+    uint8_t c = ch->getZExtValue();
+    // the string up to and including the first c, or up to the terminator
+    std::string str;
+    if (!readConcreteString(state, arguments[0], ~0ull, str, c))
+      return false;
+    KValue result = KValue(Expr::createPointer(0));
+    Expr::Width width = Context::get().getPointerWidth();
+    if (c == 0)
+      result = arguments[0].Add(ConstantExpr::alloc(str.size(), width));
+    else if (!str.empty() && (uint8_t)str.back() == c)
+      result = arguments[0].Add(ConstantExpr::alloc(str.size() - 1, width));
+    bindLocal(ki, state, result);
+    return true;
+  }
+
+  case NativeFunction::Strcpy:
+  case NativeFunction::Strncpy: {
+    uint64_t limit = ~0ull;
+    if (function == NativeFunction::Strncpy &&
+        (arguments.size() != 3 || !getConcreteLength(arguments[2], limit)))
+      return false;
+    if (arguments.size() < 2)
+      return false;
+    std::string str;
+    if (!readConcreteString(state, arguments[1], limit, str))
+      return false;
+    // bytes read from the source, including the terminator if within limit
+    uint64_t count = std::min<uint64_t>(str.size() + 1, limit);
+    uint64_t length = function == NativeFunction::Strncpy ? limit : count;
+
+    ObjectPair dst;
+    unsigned dstOffset;
+    if (!resolveConcreteRange(state, arguments[0], length, dst, dstOffset) ||
+        dst.second->readOnly)
+      return false;
+    if (length) {
+      ObjectState *wos = state.addressSpace.getWriteable(dst.first, dst.second);
+      for (uint64_t i = 0; i < count; ++i)
+        wos->write8(dstOffset + i, 0, i < str.size() ? str[i] : 0);
+      if (length > count)
+        wos->fill(dstOffset + count, ConstantExpr::alloc(0, Expr::Int8),
+                  length - count);
+    }
+    bindLocal(ki, state, arguments[0]);
+    return true;
+  }
+  }
+  return false;
+}
+
 static inline const llvm::fltSemantics *fpWidthToSemantics(unsigned width) {
   switch (width) {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(4, 0)
@@ -1468,10 +2700,6 @@ static inline const llvm::fltSemantics *fpWidthToSemantics(unsigned width) {
 }
 
 
-static inline bool isErrorCall(const llvm::StringRef& name) {
-    return name.equals(ErrorFun);
-}
-
 void Executor::executeCall(ExecutionState &state, 
                            KInstruction *ki,
                            Function *f,
@@ -1481,20 +2709,20 @@ void Executor::executeCall(ExecutionState &state,
     return;
 
   // FIXME: hack!
-  if (f->getName().equals("__INSTR_check_nontermination")) {
+  if (f == nonterminationCheckFunction) {
     state.lastLoopCheck = ki->inst;
     // fall-through
-  } else if (f->getName().equals("__INSTR_fail")) {
+  } else if (f == instrFailFunction) {
     state.lastLoopFail = ki->inst;
     // fall-through
-  } else if (isErrorCall(f->getName())) {
+  } else if (f == errorFunction) {
       terminateStateOnError(state,
                             "ASSERTION FAIL: " + ErrorFun + " called",
 				            Executor::Assert);
       return;
   }
 
-  if (f->getName().equals("__INSTR_check_nontermination_header")) {
+  if (f == nonterminationHeaderFunction) {
     state.lastLoopHead = ki->inst;
     state.lastLoopHeadId = state.nondetValues.size();
     return;
@@ -1582,6 +2810,28 @@ void Executor::executeCall(ExecutionState &state,
     if (InvokeInst *ii = dyn_cast<InvokeInst>(i))
       transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
   } else {
+    // the calls recorded need to see the memory the native functions read
+    if (!nativeFunctions.empty() &&
+        !(callMemoizer && CallMemoizer::isRecording(state))) {
+      auto native = nativeFunctions.find(f);
+      if (native != nativeFunctions.end() &&
+          executeNativeFunction(state, ki, native->second, arguments))
+        return;
+    }
+
+    if (callMemoizer && !isa<InvokeInst>(i)) {
+      KValue result;
+      if (callMemoizer->lookup(state, f, arguments,
+                               getWidthForLLVMType(i->getType()), result)) {
+        bindLocal(ki, state, result);
+        return;
+      }
+    }
+
+    if (functionSummarizer && !isa<InvokeInst>(i) &&
+        executeSummarizedCall(state, ki, f, arguments))
+      return;
+
     // Check if maximum stack size was reached.
     // We currently only count the number of stack frames
     if (RuntimeMaxStackFrames && state.stack.size() > RuntimeMaxStackFrames) {
@@ -1598,6 +2848,8 @@ void Executor::executeCall(ExecutionState &state,
 
     state.pushFrame(state.prevPC, kf);
     state.pc = kf->instructions;
+    if (callMemoizer && !isa<InvokeInst>(i))
+      callMemoizer->startRecording(state, f, arguments);
 
     if (statsTracker)
       statsTracker->framePushed(state, &state.stack[state.stack.size()-2]);
@@ -1708,6 +2960,34 @@ void Executor::executeCall(ExecutionState &state,
   }
 }
 
+bool Executor::executeSummarizedCall(ExecutionState &state, KInstruction *ki,
+                                     Function *f,
+                                     const std::vector<Cell> &arguments) {
+  if (ki->inst->getType() != f->getReturnType() ||
+      arguments.size() != f->arg_size())
+    return false;
+  std::vector<ref<Expr> > values;
+  for (const Argument &arg : f->args()) {
+    const Cell &argument = arguments[arg.getArgNo()];
+    ConstantExpr *segment = dyn_cast<ConstantExpr>(argument.getSegment());
+    if (!segment || !segment->isZero() || !arg.getType()->isIntegerTy() ||
+        argument.getWidth() != arg.getType()->getIntegerBitWidth())
+      return false;
+    values.push_back(argument.getValue());
+  }
+
+  solver->setTimeout(coreSolverTimeout);
+  const FunctionSummarizer::Summary *summary =
+      functionSummarizer->getSummary(f);
+  solver->setTimeout(time::Span());
+  if (!summary)
+    return false;
+  ++stats::summarizedCalls;
+  bindLocal(ki, state,
+            KValue(FunctionSummarizer::instantiate(*summary, values)));
+  return true;
+}
+
 void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src, 
                                     ExecutionState &state) {
   // Note that in general phi nodes can reuse phi values from the same
@@ -1726,7 +3006,7 @@ void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src,
   KFunction *kf = state.stack.back().kf;
   unsigned entry = kf->basicBlockEntry[dst];
   state.pc = &kf->instructions[entry];
-  if (state.pc->inst->getOpcode() == Instruction::PHI) {
+  if (state.pc->opcode == Instruction::PHI) {
     PHINode *first = static_cast<PHINode*>(state.pc->inst);
     state.incomingBBIndex = first->getBasicBlockIndex(src);
   }
@@ -1734,7 +3014,7 @@ void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src,
 
 /// Compute the true target of a function call, resolving LLVM aliases
 /// and bitcasts.
-Function* Executor::getTargetFunction(Value *calledVal, ExecutionState &state) {
+Function* Executor::getTargetFunction(Value *calledVal) {
   SmallPtrSet<const GlobalValue*, 3> Visited;
 
   Constant *c = dyn_cast<Constant>(calledVal);
@@ -1775,9 +3055,188 @@ ref<Expr> Executor::getSizeForAlloca(ExecutionState& state, KInstruction *ki) co
   return size;
 }
 
+namespace {
+template <typename T> bool toNativeFloat(const klee::ConstantExpr *ce, T &value) {
+  if (ce->getWidth() != sizeof(T) * 8)
+    return false;
+  typedef typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type
+      Bits;
+  Bits bits = ce->getZExtValue();
+  std::memcpy(&value, &bits, sizeof(T));
+  return true;
+}
+
+// NaNs are left to APFloat, the payloads the host produces may differ
+template <typename T>
+bool fromNativeFloat(T value, ref<klee::ConstantExpr> &result) {
+  if (std::isnan(value))
+    return false;
+  typedef typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type
+      Bits;
+  Bits bits;
+  std::memcpy(&bits, &value, sizeof(T));
+  result = klee::ConstantExpr::alloc(bits, sizeof(T) * 8);
+  return true;
+}
+
+bool compareNativeFloats(unsigned predicate, double a, double b) {
+  bool unordered = std::isnan(a) || std::isnan(b);
+  switch (predicate) {
+  case FCmpInst::FCMP_FALSE: return false;
+  case FCmpInst::FCMP_TRUE: return true;
+  case FCmpInst::FCMP_ORD: return !unordered;
+  case FCmpInst::FCMP_UNO: return unordered;
+  case FCmpInst::FCMP_OEQ: return a == b;
+  case FCmpInst::FCMP_UEQ: return unordered || a == b;
+  case FCmpInst::FCMP_OGT: return a > b;
+  case FCmpInst::FCMP_UGT: return unordered || a > b;
+  case FCmpInst::FCMP_OGE: return a >= b;
+  case FCmpInst::FCMP_UGE: return unordered || a >= b;
+  case FCmpInst::FCMP_OLT: return a < b;
+  case FCmpInst::FCMP_ULT: return unordered || a < b;
+  case FCmpInst::FCMP_OLE: return a <= b;
+  case FCmpInst::FCMP_ULE: return unordered || a <= b;
+  case FCmpInst::FCMP_ONE: return !unordered && a != b;
+  case FCmpInst::FCMP_UNE: return a != b;
+  default:
+    assert(0 && "Invalid FCMP predicate!");
+    return false;
+  }
+}
+
+template <typename T>
+bool evalNativeFloatAs(const KInstruction *ki, const klee::ConstantExpr *left,
+                     const klee::ConstantExpr *right, ref<klee::ConstantExpr> &result) {
+  T a;
+  if (!toNativeFloat(left, a))
+    return false;
+  Expr::Width width = ki->width;
+  switch (ki->opcode) {
+  case Instruction::FAdd:
+  case Instruction::FSub:
+  case Instruction::FMul:
+  case Instruction::FDiv:
+  case Instruction::FRem:
+  case Instruction::FCmp: {
+    T b;
+    if (!toNativeFloat(right, b))
+      return false;
+    switch (ki->opcode) {
+    case Instruction::FAdd: return fromNativeFloat<T>(a + b, result);
+    case Instruction::FSub: return fromNativeFloat<T>(a - b, result);
+    case Instruction::FMul: return fromNativeFloat<T>(a * b, result);
+    case Instruction::FDiv: return fromNativeFloat<T>(a / b, result);
+    case Instruction::FRem: return fromNativeFloat<T>(std::fmod(a, b), result);
+    default:
+      result = klee::ConstantExpr::alloc(compareNativeFloats(ki->predicate, a, b),
+                                   Expr::Bool);
+      return true;
+    }
+  }
+  case Instruction::FPTrunc:
+    return width == Expr::Int32 && fromNativeFloat<float>(a, result);
+  case Instruction::FPExt:
+    return width == Expr::Int64 && fromNativeFloat<double>(a, result);
+  case Instruction::FPToSI:
+  case Instruction::FPToUI: {
+    // out of range values are left to APFloat, the cast is undefined then
+    if (std::isnan(a) || width > Expr::Int64)
+      return false;
+    double t = std::trunc((double)a);
+    uint64_t value;
+    if (ki->opcode == Instruction::FPToSI) {
+      double limit = std::ldexp(1.0, width - 1);
+      if (t < -limit || t >= limit)
+        return false;
+      value = (uint64_t)(int64_t)t;
+    } else {
+      if (t < 0 || t >= std::ldexp(1.0, width))
+        return false;
+      value = (uint64_t)t;
+    }
+    if (width < 64)
+      value &= (1ull << width) - 1;
+    result = klee::ConstantExpr::alloc(value, width);
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+} // namespace
+
+bool Executor::evalNativeFloat(ExecutionState &state, KInstruction *ki,
+                               ref<ConstantExpr> &result) {
+#if FLT_EVAL_METHOD != 0
+  // the host computes in a wider precision than the one of the operands
+  return false;
+#endif
+  switch (ki->opcode) {
+  case Instruction::FAdd:
+  case Instruction::FSub:
+  case Instruction::FMul:
+  case Instruction::FDiv:
+  case Instruction::FRem:
+  case Instruction::FCmp:
+  case Instruction::FPTrunc:
+  case Instruction::FPExt:
+  case Instruction::FPToSI:
+  case Instruction::FPToUI:
+  case Instruction::SIToFP:
+  case Instruction::UIToFP:
+    break;
+  default:
+    return false;
+  }
+  // an external call may have changed the rounding mode of the host
+  if (std::fegetround() != FE_TONEAREST)
+    return false;
+
+  const ConstantExpr *left = dyn_cast<ConstantExpr>(eval(ki, 0, state).value);
+  if (!left)
+    return false;
+
+  if (ki->opcode == Instruction::SIToFP || ki->opcode == Instruction::UIToFP) {
+    if (left->getWidth() > Expr::Int64)
+      return false;
+    bool isSigned = ki->opcode == Instruction::SIToFP;
+    int64_t s = left->getAPValue().getSExtValue();
+    uint64_t u = left->getZExtValue();
+    if (ki->width == Expr::Int32)
+      return fromNativeFloat<float>(isSigned ? (float)s : (float)u, result);
+    if (ki->width == Expr::Int64)
+      return fromNativeFloat<double>(isSigned ? (double)s : (double)u, result);
+    return false;
+  }
+
+  const ConstantExpr *right = nullptr;
+  if (isa<BinaryOperator>(ki->inst) || isa<FCmpInst>(ki->inst)) {
+    right = dyn_cast<ConstantExpr>(eval(ki, 1, state).value);
+    if (!right)
+      return false;
+  }
+  if (left->getWidth() == Expr::Int32)
+    return evalNativeFloatAs<float>(ki, left, right, result);
+  if (left->getWidth() == Expr::Int64)
+    return evalNativeFloatAs<double>(ki, left, right, result);
+  return false;
+}
+
 void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   Instruction *i = ki->inst;
-  switch (i->getOpcode()) {
+  ref<ConstantExpr> nativeResult;
+  if (NativeFloatingPoint && evalNativeFloat(state, ki, nativeResult) &&
+      !DebugValidateNativeFloatingPoint) {
+    bindLocal(ki, state, nativeResult);
+    return;
+  }
+
+  if (ki->lanes) {
+    executeVectorInstruction(state, ki);
+    return;
+  }
+
+  switch (ki->opcode) {
     // Control flow
   case Instruction::Ret: {
     ReturnInst *ri = cast<ReturnInst>(i);
@@ -1796,6 +3255,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       state.pc = {0};
       terminateStateOnExit(state);
     } else {
+      std::shared_ptr<CallRecording> recording = state.stack.back().recording;
       state.popFrame();
 
       if (statsTracker)
@@ -1833,6 +3293,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
           }
 
           bindLocal(kcaller, state, result);
+          // results coerced for this caller are not the ones of others
+          if (recording && from == to)
+            callMemoizer->finish(state, recording, result);
         }
       } else {
         // We check that the return value has no users instead of
@@ -1856,6 +3319,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       ref<Expr> cond = eval(ki, 0, state).value;
 
       cond = optimizer.optimizeExpr(cond, false);
+      if (errorReachability && takeReachingBranch(state, bi, cond))
+        break;
       Executor::StatePair branches = fork(state, cond, false);
 
       // NOTE: There is a hidden dependency here, markBranchVisited
@@ -1974,9 +3439,18 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
       std::map<ref<Expr>, BasicBlock *> expressionOrder;
 
+      // cases outside the bounds the constraints put on the condition's
+      // bytes cannot be taken, and need no query
+      ValueRange range(0, bits64::maxValueOfNBits(Expr::Int64));
+      if (cond->getWidth() <= Expr::Int64)
+        range = state.constraints.getByteBounds().evaluate(cond);
+
       // Iterate through all non-default cases and order them by expressions
       for (auto i : si->cases()) {
         ref<Expr> value = evalConstant(i.getCaseValue()).getValue();
+        if (cond->getWidth() <= Expr::Int64 &&
+            !range.contains(cast<ConstantExpr>(value)->getZExtValue()))
+          continue;
         BasicBlock *caseSuccessor = i.getCaseSuccessor();
         expressionOrder.insert(std::make_pair(value, caseSuccessor));
       }
@@ -1984,7 +3458,11 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       // Track default branch values
       ref<Expr> defaultValue = ConstantExpr::alloc(1, Expr::Bool);
 
-      // iterate through all non-default cases but in order of the expressions
+      // Collect the conditions of the non-default cases in order of the
+      // expressions, followed by the default condition
+      std::vector<ref<Expr> > matches;
+      std::vector<ref<Expr> > caseValues;
+      std::vector<BasicBlock *> caseSuccessors;
       for (std::map<ref<Expr>, BasicBlock *>::iterator
                it = expressionOrder.begin(),
                itE = expressionOrder.end();
@@ -1998,14 +3476,27 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         // Make sure that the default value does not contain this target's value
         defaultValue = AndExpr::create(defaultValue, Expr::createIsZero(match));
 
-        // Check if control flow could take this case
-        bool result;
-        match = optimizer.optimizeExpr(match, false);
-        bool success = solver->mayBeTrue(state, match, result);
+        matches.push_back(optimizer.optimizeExpr(match, false));
+        caseValues.push_back(it->first);
+        caseSuccessors.push_back(it->second);
+      }
+      defaultValue = optimizer.optimizeExpr(defaultValue, false);
+      matches.push_back(defaultValue);
+
+      QueryPurposeScope purpose(*solver, getBranchPurpose(cond));
+      std::vector<bool> feasible;
+      if (!EnumerateSwitchTargets ||
+          !findSwitchTargets(state, cond, caseValues, caseSuccessors, matches,
+                             feasible)) {
+        // Check which cases control flow could take, all at once
+        bool success = solver->mayBeTrue(state, matches, feasible);
         assert(success && "FIXME: Unhandled solver failure");
         (void) success;
-        if (result) {
-          BasicBlock *caseSuccessor = it->second;
+      }
+
+      for (unsigned i = 0; i != caseSuccessors.size(); ++i) {
+        if (feasible[i]) {
+          BasicBlock *caseSuccessor = caseSuccessors[i];
 
           // Handle the case that a basic block might be the target of multiple
           // switch cases.
@@ -2017,7 +3508,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
               branchTargets.insert(std::make_pair(
                   caseSuccessor, ConstantExpr::alloc(0, Expr::Bool)));
 
-          res.first->second = OrExpr::create(match, res.first->second);
+          res.first->second = OrExpr::create(matches[i], res.first->second);
 
           // Only add basic blocks which have not been target of a branch yet
           if (res.second) {
@@ -2027,12 +3518,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       }
 
       // Check if control could take the default case
-      defaultValue = optimizer.optimizeExpr(defaultValue, false);
-      bool res;
-      bool success = solver->mayBeTrue(state, defaultValue, res);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
-      if (res) {
+      if (feasible.back()) {
         std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> ret =
             branchTargets.insert(
                 std::make_pair(si->getDefaultDest(), defaultValue));
@@ -2041,6 +3527,20 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         }
       }
 
+      // Do not fork into the successors no error site is reachable from
+      if (errorReachability && !seedMap.count(&state)) {
+        auto end = std::remove_if(
+            bbOrder.begin(), bbOrder.end(), [&](BasicBlock *successor) {
+              return !errorReachability->mayReach(state, successor);
+            });
+        stats::unreachableBranches += bbOrder.end() - end;
+        bbOrder.erase(end, bbOrder.end());
+        if (bbOrder.empty()) {
+          terminateState(state);
+          break;
+        }
+      }
+
       // Fork the current state with each state having one of the possible
       // successors of this switch
       std::vector< ref<Expr> > conditions;
@@ -2081,7 +3581,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     unsigned numArgs = cs.arg_size();
     Value *fp = cs.getCalledValue();
-    Function *f = getTargetFunction(fp, state);
+    Function *f = ki->callee;
 
     if (isa<InlineAsm>(fp)) {
       terminateStateOnExecError(state, "inline assembly is unsupported");
@@ -2145,6 +3645,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
       ExecutionState *free = &state;
       bool hasInvalid = false, first = true;
+      QueryPurposeScope purpose(*solver, ResolutionQuery);
 
       /* XXX This is wasteful, no need to do a full evaluate since we
          have already got a value. But in the end the caches should
@@ -2194,6 +3695,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     KValue cond = eval(ki, 0, state);
     const Cell &tCell = eval(ki, 1, state);
     const Cell &fCell = eval(ki, 2, state);
+    if (!isa<ConstantExpr>(cond.value) && i->getMetadata("klee.if-converted"))
+      ++stats::ifConvertedSelects;
     bindLocal(ki, state, cond.Select(tCell, fCell));
     break;
   }
@@ -2298,9 +3801,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     // Compare
 
   case Instruction::ICmp: {
-    CmpInst *ci = cast<CmpInst>(i);
-    ICmpInst *ii = cast<ICmpInst>(ci);
-    const auto& predicate = ii->getPredicate();
+    const auto predicate = static_cast<ICmpInst::Predicate>(ki->predicate);
 
     const Cell &leftOriginal = eval(ki, 0, state);
     const Cell &rightOriginal = eval(ki, 1, state);
@@ -2337,28 +3838,28 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
       ObjectPair op;
       bool successRight, successLeft;
+      uint64_t segment = leftSegment->getZExtValue(pointerWidth);
       if (!state.addressSpace.resolveOneConstantSegment(leftOriginal, op)) {
         successLeft = false;
-        const auto res = state.addressSpace.removedObjectsMap.find(leftSegment->getZExtValue(pointerWidth));
-        if (res != state.addressSpace.removedObjectsMap.end()) {
-          leftArray = Expr::createTempRead(res->second, Context::get().getPointerWidth());
+        if (const ref<const MemoryObject> *removed =
+                state.addressSpace.removedObjectsMap.lookup(segment)) {
+          leftArray = getSymbolicAddress(state, removed->get());
         }
       } else {
         successLeft = true;
-        leftArray = const_cast<MemoryObject *>(op.first)->getSymbolicAddress(
-            arrayCache);
+        leftArray = getSymbolicAddress(state, op.first);
       }
 
+      segment = rightSegment->getZExtValue(pointerWidth);
       if (!state.addressSpace.resolveOneConstantSegment(rightOriginal, op)) {
         successRight = false;
-        const auto res = state.addressSpace.removedObjectsMap.find(rightSegment->getZExtValue(pointerWidth));
-        if (res != state.addressSpace.removedObjectsMap.end()) {
-          rightArray = Expr::createTempRead(res->second, Context::get().getPointerWidth());
+        if (const ref<const MemoryObject> *removed =
+                state.addressSpace.removedObjectsMap.lookup(segment)) {
+          rightArray = getSymbolicAddress(state, removed->get());
         }
       } else {
         successRight = true;
-        rightArray = const_cast<MemoryObject *>(op.first)->getSymbolicAddress(
-            arrayCache);
+        rightArray = getSymbolicAddress(state, op.first);
       }
       success = successLeft && successRight;
       deletedObject = successLeft == !successRight;
@@ -2370,8 +3871,12 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       left = static_cast<KValue>(leftOriginal);
       right = static_cast<KValue>(rightOriginal);
     } else {
-      klee_warning("Comparing pointers, using symbolic values instead of "
-                   "segment for comparison");
+      klee_warning_once(0, "Comparing pointers, using symbolic values "
+                           "instead of segment for comparison");
+      if (!leftArray.isNull())
+        leftArray = AddExpr::create(leftArray, leftOriginal.getOffset());
+      if (!rightArray.isNull())
+        rightArray = AddExpr::create(rightArray, rightOriginal.getOffset());
       left = KValue(leftOriginal.getSegment(), leftArray);
       right = KValue(rightOriginal.getSegment(), rightArray);
     }
@@ -2448,43 +3953,51 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     KValue base = eval(ki, 0, state);
     Expr::Width pointerWidth = Context::get().getPointerWidth();
 
+    // Concrete indices are summed up natively together with the constant
+    // offset, only symbolic ones build expressions
+    uint64_t addend = kgepi->offset;
     for (std::vector< std::pair<unsigned, uint64_t> >::iterator 
            it = kgepi->indices.begin(), ie = kgepi->indices.end(); 
          it != ie; ++it) {
       uint64_t elementSize = it->second;
-      KValue index = eval(ki, it->first, state);
+      const KValue &index = eval(ki, it->first, state);
+      auto value = dyn_cast<ConstantExpr>(index.getValue());
+      if (value && value->getWidth() <= 64 && index.getSegment()->isZero()) {
+        addend += (uint64_t)llvm::SignExtend64(value->getZExtValue(),
+                                               value->getWidth()) *
+                  elementSize;
+        continue;
+      }
       base = base.Add(
           index.SExt(pointerWidth)
           .Mul(ConstantExpr::create(elementSize, pointerWidth)));
     }
-    if (kgepi->offset)
-      base = base.Add(ConstantExpr::create(kgepi->offset, pointerWidth));
+    addend = bits64::truncateToNBits(addend, pointerWidth);
+    if (addend)
+      base = base.Add(ConstantExpr::create(addend, pointerWidth));
     bindLocal(ki, state, base);
     break;
   }
 
     // Conversion
   case Instruction::Trunc: {
-    CastInst *ci = cast<CastInst>(i);
     const Cell &cell = eval(ki, 0, state);
-    KValue result = cell.Extract(0, getWidthForLLVMType(ci->getType()));
+    KValue result = cell.Extract(0, ki->width);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::SExt: {
-    CastInst *ci = cast<CastInst>(i);
     const Cell &cell = eval(ki, 0, state);
-    bindLocal(ki, state, cell.SExt(getWidthForLLVMType(ci->getType())));
+    bindLocal(ki, state, cell.SExt(ki->width));
     break;
   }
 
   case Instruction::ZExt:
   case Instruction::IntToPtr:
   case Instruction::PtrToInt: {
-    CastInst *ci = cast<CastInst>(i);
     const Cell &cell = eval(ki, 0, state);
-    bindLocal(ki, state, cell.ZExt(getWidthForLLVMType(ci->getType())));
+    bindLocal(ki, state, cell.ZExt(ki->width));
     break;
   }
 
@@ -2571,8 +4084,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPTrunc: {
-    FPTruncInst *fi = cast<FPTruncInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > arg->getWidth())
@@ -2588,8 +4100,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPExt: {
-    FPExtInst *fi = cast<FPExtInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                         "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || arg->getWidth() > resultType)
@@ -2604,8 +4115,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPToUI: {
-    FPToUIInst *fi = cast<FPToUIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
@@ -2626,8 +4136,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPToSI: {
-    FPToSIInst *fi = cast<FPToSIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
@@ -2648,8 +4157,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::UIToFP: {
-    UIToFPInst *fi = cast<UIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
@@ -2664,8 +4172,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::SIToFP: {
-    SIToFPInst *fi = cast<SIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
@@ -2680,7 +4187,6 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FCmp: {
-    FCmpInst *fi = cast<FCmpInst>(i);
     ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
                                         "floating point");
     ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
@@ -2694,7 +4200,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     APFloat::cmpResult CmpRes = LHS.compare(RHS);
 
     bool Result = false;
-    switch( fi->getPredicate() ) {
+    switch (ki->predicate) {
       // Predicates which only care about whether or not the operands are NaNs.
     case FCmpInst::FCMP_ORD:
       Result = (CmpRes != APFloat::cmpUnordered);
@@ -2796,7 +4302,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     KValue agg = eval(ki, 0, state);
 
-    KValue result = agg.Extract(kgepi->offset*8, getWidthForLLVMType(i->getType()));
+    KValue result = agg.Extract(kgepi->offset*8, ki->width);
 
     bindLocal(ki, state, result);
     break;
@@ -2872,11 +4378,36 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 	bindLocal(ki, state, Result);
     break;
   }
-  case Instruction::ShuffleVector:
-    // Should never happen due to Scalarizer pass removing ShuffleVector
-    // instructions.
-    terminateStateOnExecError(state, "Unexpected ShuffleVector instruction");
+  case Instruction::ShuffleVector: {
+    // Left by the Scalarizer with -native-vectors only.
+    ShuffleVectorInst *svi = cast<ShuffleVectorInst>(i);
+    const Cell &first = eval(ki, 0, state);
+    const Cell &second = eval(ki, 1, state);
+    const unsigned inputElements =
+        cast<llvm::VectorType>(svi->getOperand(0)->getType())->getNumElements();
+    const unsigned EltBits =
+        getWidthForLLVMType(svi->getType()->getElementType());
+    SmallVector<int, 16> mask;
+    svi->getShuffleMask(mask);
+
+    llvm::SmallVector<KValue, 16> elems;
+    elems.reserve(mask.size());
+    for (unsigned of = mask.size(); of != 0; --of) {
+      const int element = mask[of - 1];
+      // undefined elements are taken to be zero
+      if (element < 0)
+        elems.push_back(KValue(ConstantExpr::alloc(0, EltBits)));
+      else if ((unsigned)element < inputElements)
+        elems.push_back(first.Extract(EltBits * element, EltBits));
+      else
+        elems.push_back(
+            second.Extract(EltBits * (element - inputElements), EltBits));
+    }
+
+    assert(Context::get().isLittleEndian() && "FIXME:Broken for big endian");
+    bindLocal(ki, state, KValue::concatValues(elems));
     break;
+  }
   case Instruction::AtomicRMW:
     terminateStateOnExecError(state, "Unexpected Atomic instruction, should be "
                                      "lowered by LowerAtomicInstructionPass");
@@ -2892,6 +4423,164 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     terminateStateOnExecError(state, "illegal instruction");
     break;
   }
+
+  if (!nativeResult.isNull()) {
+    const ref<Expr> &emulated = state.stack.back().getLocal(ki->dest).value;
+    if (emulated != nativeResult) {
+      std::string str;
+      llvm::raw_string_ostream os(str);
+      os << *ki->inst << ": native " << nativeResult << ", APFloat "
+         << emulated;
+      klee_warning("native floating point result differs: %s",
+                   os.str().c_str());
+    }
+  }
+}
+
+/// Compare \a left with \a right as the integer comparison \a predicate.
+static KValue compareLanes(unsigned predicate, const KValue &left,
+                           const KValue &right) {
+  switch (predicate) {
+  case ICmpInst::ICMP_EQ: return left.Eq(right);
+  case ICmpInst::ICMP_NE: return left.Ne(right);
+  case ICmpInst::ICMP_UGT: return left.Ugt(right);
+  case ICmpInst::ICMP_UGE: return left.Uge(right);
+  case ICmpInst::ICMP_ULT: return left.Ult(right);
+  case ICmpInst::ICMP_ULE: return left.Ule(right);
+  case ICmpInst::ICMP_SGT: return left.Sgt(right);
+  case ICmpInst::ICMP_SGE: return left.Sge(right);
+  case ICmpInst::ICMP_SLT: return left.Slt(right);
+  case ICmpInst::ICMP_SLE: return left.Sle(right);
+  default:
+    assert(0 && "invalid ICmp predicate");
+    return left.Eq(right);
+  }
+}
+
+void Executor::executeVectorInstruction(ExecutionState &state,
+                                        KInstruction *ki) {
+  const unsigned lanes = ki->lanes;
+  const Cell *operands[3];
+  for (unsigned j = 0, e = ki->inst->getNumOperands(); j != e; ++j)
+    operands[j] = &eval(ki, j, state);
+  // Lane i of an operand are its bits [i * w, (i + 1) * w), as elements
+  // are laid out in memory on little endian targets. Extracting the lanes
+  // of constant vectors and combining them folds, so that concrete vector
+  // code costs one instruction rather than one per element.
+  auto lane = [&](unsigned j, unsigned i) {
+    const Expr::Width width = operands[j]->getWidth() / lanes;
+    return operands[j]->Extract(width * i, width);
+  };
+  const Expr::Width width = ki->width / lanes;
+
+  llvm::SmallVector<KValue, 16> result;
+  result.reserve(lanes);
+  // from the last lane, the most significant part of the concatenation
+  for (unsigned i = lanes; i != 0;) {
+    --i;
+    switch (ki->opcode) {
+    case Instruction::Add: result.push_back(lane(0, i).Add(lane(1, i))); break;
+    case Instruction::Sub: result.push_back(lane(0, i).Sub(lane(1, i))); break;
+    case Instruction::Mul: result.push_back(lane(0, i).Mul(lane(1, i))); break;
+    case Instruction::UDiv:
+      result.push_back(lane(0, i).UDiv(lane(1, i)));
+      break;
+    case Instruction::SDiv:
+      result.push_back(lane(0, i).SDiv(lane(1, i)));
+      break;
+    case Instruction::URem:
+      result.push_back(lane(0, i).URem(lane(1, i)));
+      break;
+    case Instruction::SRem:
+      result.push_back(lane(0, i).SRem(lane(1, i)));
+      break;
+    case Instruction::And: result.push_back(lane(0, i).And(lane(1, i))); break;
+    case Instruction::Or: result.push_back(lane(0, i).Or(lane(1, i))); break;
+    case Instruction::Xor: result.push_back(lane(0, i).Xor(lane(1, i))); break;
+    case Instruction::Shl: result.push_back(lane(0, i).Shl(lane(1, i))); break;
+    case Instruction::LShr:
+      result.push_back(lane(0, i).LShr(lane(1, i)));
+      break;
+    case Instruction::AShr:
+      result.push_back(lane(0, i).AShr(lane(1, i)));
+      break;
+    case Instruction::ICmp:
+      result.push_back(compareLanes(ki->predicate, lane(0, i), lane(1, i)));
+      break;
+    case Instruction::Select:
+      result.push_back(lane(0, i).Select(lane(1, i), lane(2, i)));
+      break;
+    case Instruction::Trunc:
+      result.push_back(lane(0, i).Extract(0, width));
+      break;
+    case Instruction::ZExt: result.push_back(lane(0, i).ZExt(width)); break;
+    case Instruction::SExt: result.push_back(lane(0, i).SExt(width)); break;
+    default:
+      assert(0 && "no lane by lane execution of the instruction");
+    }
+  }
+
+  assert(Context::get().isLittleEndian() && "FIXME:Broken for big endian");
+  bindLocal(ki, state, KValue::concatValues(result));
+}
+
+bool Executor::isConcreteLocal(ExecutionState &state, KInstruction *ki) const {
+  switch (ki->opcode) {
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+  case Instruction::BitCast:
+  case Instruction::PtrToInt:
+  case Instruction::IntToPtr:
+  case Instruction::Select:
+  case Instruction::GetElementPtr:
+  case Instruction::ExtractValue:
+  case Instruction::InsertValue:
+  case Instruction::ShuffleVector:
+    break;
+  case Instruction::ICmp:
+    if (ki->lanes)
+      break;
+    // pointers into objects are compared through the address space
+    for (unsigned j = 0; j != 2; ++j) {
+      const Cell &cell = eval(ki, j, state);
+      if (!cell.isConstant() || !cell.getSegment()->isZero())
+        return false;
+    }
+    return true;
+  default:
+    return false;
+  }
+
+  for (unsigned j = 0, e = ki->inst->getNumOperands(); j != e; ++j)
+    if (!eval(ki, j, state).isConstant())
+      return false;
+  return true;
+}
+
+void Executor::executeConcreteRun(ExecutionState &state, KInstruction *last) {
+  // Stay within the block, so that the searcher, -auto-merge-loops and
+  // -dedup-states still see every block entry.
+  if (last->inst->isTerminator())
+    return;
+  const BasicBlock *bb = last->inst->getParent();
+  while (!haltExecution && addedStates.empty() && removedStates.empty() &&
+         pausedStates.empty()) {
+    KInstruction *ki = state.pc;
+    if (ki->inst->getParent() != bb || !isConcreteLocal(state, ki))
+      break;
+    stepInstruction(state);
+    executeInstruction(state, ki);
+  }
 }
 
 void Executor::updateStates(ExecutionState *current) {
@@ -2906,7 +4595,7 @@ void Executor::updateStates(ExecutionState *current) {
                                                ie = removedStates.end();
        it != ie; ++it) {
     ExecutionState *es = *it;
-    std::set<ExecutionState*>::iterator it2 = states.find(es);
+    auto it2 = states.find(es);
     assert(it2!=states.end());
     states.erase(it2);
     std::map<ExecutionState*, std::vector<SeedInfo> >::iterator it3 = 
@@ -2918,6 +4607,9 @@ void Executor::updateStates(ExecutionState *current) {
   }
   removedStates.clear();
 
+  // Between instructions, no array is held by a plain pointer alone.
+  arrayCache.collect();
+
   if (searcher) {
     searcher->update(nullptr, continuedStates, pausedStates);
     pausedStates.clear();
@@ -2977,6 +4669,42 @@ void Executor::computeOffsets(KGEPInstruction *kgepi, TypeIt ib, TypeIt ie) {
 void Executor::bindInstructionConstants(KInstruction *KI) {
   KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(KI);
 
+  if (KI->inst->getType()->isSized())
+    KI->width = getWidthForLLVMType(KI->inst->getType());
+
+  // the vector operations left by the Scalarizer with -native-vectors
+  llvm::Type *laneType = nullptr;
+  switch (KI->opcode) {
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+    laneType = KI->inst->getType();
+    break;
+  case Instruction::ICmp:
+  case Instruction::Select:
+    laneType = KI->inst->getOperand(0)->getType();
+    break;
+  }
+  if (laneType && laneType->isVectorTy())
+    KI->lanes = cast<llvm::VectorType>(laneType)->getNumElements();
+  if (isa<CallInst>(KI->inst) || isa<InvokeInst>(KI->inst))
+    KI->callee = getTargetFunction(CallSite(KI->inst).getCalledValue());
+  if (KI->callee)
+    specialFunctionHandler->bindCall(KI);
+
   if (GetElementPtrInst *gepi = dyn_cast<GetElementPtrInst>(KI->inst)) {
     computeOffsets(kgepi, gep_type_begin(gepi), gep_type_end(gepi));
   } else if (InsertValueInst *ivi = dyn_cast<InsertValueInst>(KI->inst)) {
@@ -2988,11 +4716,40 @@ void Executor::bindInstructionConstants(KInstruction *KI) {
   }
 }
 
+/// Let a GEP whose base is another GEP with only constant indices start
+/// from the base of that GEP instead, adding up the constant offsets, so
+/// that chains of constant GEPs cost a single addition at runtime.
+static void foldConstantGEPChain(KFunction *kf, KGEPInstruction *kgepi,
+                                 std::set<KGEPInstruction *> &folded) {
+  if (!folded.insert(kgepi).second)
+    return;
+  auto gepi = cast<GetElementPtrInst>(kgepi->inst);
+  auto inner = dyn_cast<GetElementPtrInst>(gepi->getPointerOperand());
+  if (!inner || inner->getType() != gepi->getPointerOperandType())
+    return;
+  auto kinner = static_cast<KGEPInstruction *>(kf->getKInstruction(inner));
+  foldConstantGEPChain(kf, kinner, folded);
+  if (!kinner->indices.empty())
+    return;
+
+  // The base of the inner GEP dominates it and thus also this one, so its
+  // register still holds the same value here
+  kgepi->operands[0] = kinner->operands[0];
+  kgepi->offset = bits64::truncateToNBits(
+      kgepi->offset + kinner->offset, Context::get().getPointerWidth());
+}
+
 void Executor::bindModuleConstants() {
   for (auto &kfp : kmodule->functions) {
     KFunction *kf = kfp.get();
     for (unsigned i=0; i<kf->numInstructions; ++i)
       bindInstructionConstants(kf->instructions[i]);
+
+    std::set<KGEPInstruction *> folded;
+    for (unsigned i=0; i<kf->numInstructions; ++i)
+      if (isa<GetElementPtrInst>(kf->instructions[i]->inst))
+        foldConstantGEPChain(
+            kf, static_cast<KGEPInstruction *>(kf->instructions[i]), folded);
   }
 
   kmodule->constantTable =
@@ -3006,15 +4763,22 @@ void Executor::bindModuleConstants() {
 void Executor::checkMemoryUsage() {
   if (!MaxMemory)
     return;
-  if ((stats::instructions & 0xFFFF) == 0) {
-    // We need to avoid calling GetTotalMallocUsage() often because it
-    // is O(elts on freelist). This is really bad since we start
-    // to pummel the freelist once we hit the memory cap.
+  if (memoryCheckDue) {
+    // We need to avoid calling GetTotalMallocUsage() often because with
+    // glibc's mallinfo it is O(elts on freelist). This is really bad since
+    // we start to pummel the freelist once we hit the memory cap. jemalloc
+    // and tcmalloc keep the count at hand.
+    memoryCheckDue = false;
     unsigned mbs = (util::GetTotalMallocUsage() >> 20) +
                    (memory->getUsedDeterministicSize() >> 20);
 
     if (mbs > MaxMemory) {
-      if (mbs > MaxMemory + 100) {
+      if (!atMemoryLimit)
+        dumpMemoryProfile();
+      if (mbs > MaxMemory + 100 && MaxMemorySuspend) {
+        unsigned numStates = states.size() - suspendedStates.size();
+        suspendStates(std::max(1U, numStates - numStates * MaxMemory / mbs));
+      } else if (mbs > MaxMemory + 100) {
         // just guess at how many to kill
         unsigned numStates = states.size();
         unsigned toKill = std::max(1U, numStates - numStates * MaxMemory / mbs);
@@ -3028,29 +4792,169 @@ void Executor::checkMemoryUsage() {
             idx = rand() % N;
 
           std::swap(arr[idx], arr[N - 1]);
+          expandState(*arr[N - 1]);
           terminateStateEarly(*arr[N - 1], "Memory limit exceeded.");
         }
       }
       atMemoryLimit = true;
     } else {
       atMemoryLimit = false;
+      // resume one state at a time, its memory shows up at the next check
+      if (!suspendedStates.empty() && mbs + 100 < MaxMemory)
+        resumeState(*suspendedStates.begin()->first);
     }
   }
 }
 
+void Executor::suspendStates(unsigned count) {
+  std::vector<ExecutionState *> arr;
+  for (ExecutionState *es : states) {
+    // compacted states take little memory already
+    if (suspendedStates.count(es) || compactedStates.count(es) ||
+        inCloseMerge.count(es) || seedMap.count(es) ||
+        std::find(removedStates.begin(), removedStates.end(), es) !=
+            removedStates.end())
+      continue;
+    arr.push_back(es);
+  }
+  // keep at least one state running
+  count = std::min<size_t>(count, arr.empty() ? 0 : arr.size() - 1);
+  if (!count)
+    return;
+
+  klee_warning("suspending %d states (over memory cap)", count);
+  for (unsigned i = 0, N = arr.size(); i < count; ++i, --N) {
+    unsigned idx = rand() % N;
+    // as when killing, try not to hit a state that covered new code
+    if (arr[idx]->coveredNew)
+      idx = rand() % N;
+
+    std::swap(arr[idx], arr[N - 1]);
+    suspendState(*arr[N - 1]);
+  }
+}
+
+void Executor::suspendState(ExecutionState &state) {
+  static unsigned id = 0;
+  std::string path = interpreterHandler->getOutputFilename(
+      "suspended" + llvm::utostr(++id) + ".state");
+  std::ofstream os(path, std::ios::binary);
+  ExprWriter w(os);
+  state.suspend(w);
+  os.close();
+  if (!os) {
+    klee_warning("unable to write suspended state to %s, dropping it",
+                 path.c_str());
+    llvm::sys::fs::remove(path);
+    if (state.subsumptionNode)
+      state.subsumptionNode->markIncomplete();
+    terminateState(state);
+    return;
+  }
+  suspendedStates[&state] = path;
+  pauseState(state);
+}
+
+void Executor::resumeState(ExecutionState &state) {
+  auto it = suspendedStates.find(&state);
+  assert(it != suspendedStates.end() && "state is not suspended");
+  std::ifstream is(it->second, std::ios::binary);
+  ExprReader r(is);
+  state.resume(r);
+  if (!is)
+    klee_error("unable to read suspended state from %s", it->second.c_str());
+  is.close();
+  llvm::sys::fs::remove(it->second);
+  suspendedStates.erase(it);
+  if (searcher)
+    continueState(state);
+}
+
+void Executor::compactStates() {
+  uint64_t now = stats::instructions;
+  for (ExecutionState *es : states) {
+    if (now - es->lastScheduled < CompactStatesAfter ||
+        compactedStates.count(es) || suspendedStates.count(es) ||
+        seedMap.count(es))
+      continue;
+    compactState(*es);
+  }
+}
+
+void Executor::compactState(ExecutionState &state) {
+  std::ostringstream os;
+  ExprWriter w(os);
+  state.suspend(w);
+  compactedStates[&state] = os.str();
+  ++stats::compactedStates;
+}
+
+void Executor::expandState(ExecutionState &state) {
+  auto it = compactedStates.find(&state);
+  if (it == compactedStates.end())
+    return;
+  std::istringstream is(it->second);
+  ExprReader r(is);
+  state.resume(r);
+  assert(is && "truncated compacted state");
+  compactedStates.erase(it);
+}
+
 void Executor::doDumpStates() {
-  if (!DumpStatesOnHalt || states.empty())
+  // the states halted here stay alive in the checkpoint
+  if (checkpointLog && !states.empty())
+    checkpointLog->checkpoint();
+  if (!states.empty())
+    dumpMemoryProfile();
+  if (!DumpStatesOnHalt || states.empty()) {
+    for (const auto &suspended : suspendedStates)
+      llvm::sys::fs::remove(suspended.second);
+    suspendedStates.clear();
+    compactedStates.clear();
     return;
+  }
 
   klee_message("halting execution, dumping remaining states");
+  while (!suspendedStates.empty())
+    resumeState(*suspendedStates.begin()->first);
+  while (!compactedStates.empty())
+    expandState(*compactedStates.begin()->first);
+  for (ExecutionState *es : deferredStates)
+    continueState(*es);
+  deferredStates.clear();
+  updateStates(nullptr);
   for (const auto &state : states)
-    terminateStateEarly(*state, "Execution halting.");
+    if (state->pendingCondition.isNull() || provePendingCondition(*state))
+      terminateStateEarly(*state, "Execution halting.");
   updateStates(nullptr);
 }
 
+void Executor::collectNativeCoverage() {
+  std::vector<std::string> ktests;
+  interpreterHandler->takeWrittenKTests(ktests);
+  for (const std::string &path : ktests)
+    nativeCoverage->submit(path);
+
+  std::vector<std::pair<std::string, unsigned> > lines;
+  nativeCoverage->poll(lines);
+  statsTracker->markLinesCovered(lines);
+}
+
 void Executor::run(ExecutionState &initialState) {
   bindModuleConstants();
 
+  if (MaxStaticForkPct < 1. || MaxStaticSolvePct < 1. ||
+      MaxStaticCPForkPct < 1. || MaxStaticCPSolvePct < 1.) {
+    staticForks.assign(kmodule->infos->getMaxID(), 0);
+    staticSolveTime.assign(kmodule->infos->getMaxID(), 0);
+    timers.add(std::make_unique<Timer>(time::Span(TimerInterval),
+                                       [&] { updateStaticLimits(); }));
+  }
+
+  initialState.checkpointId = 1;
+  if (resumeTree)
+    resumeCheckpoint();
+
   // Delay init till now so that ticks don't accrue during optimization and such.
   timers.reset();
 
@@ -3065,6 +4969,7 @@ void Executor::run(ExecutionState &initialState) {
 
     int lastNumSeeds = usingSeeds->size()+10;
     time::Point lastTime, startTime = lastTime = time::getWallTime();
+    time::Point lastCount = startTime;
     ExecutionState *lastState = 0;
     while (!seedMap.empty()) {
       if (haltExecution) {
@@ -3078,6 +4983,7 @@ void Executor::run(ExecutionState &initialState) {
         it = seedMap.begin();
       lastState = it->first;
       ExecutionState &state = *lastState;
+      patchSeeds(state, it->second);
       KInstruction *ki = state.pc;
       stepInstruction(state);
 
@@ -3087,7 +4993,11 @@ void Executor::run(ExecutionState &initialState) {
       if (::dumpPTree) dumpPTree();
       updateStates(&state);
 
-      if ((stats::instructions % 1000) == 0) {
+      // counting the seeds walks all the seeded states, do it at most once
+      // a second
+      if ((stats::instructions % 1000) == 0 &&
+          time::getWallTime() - lastCount >= time::seconds(1)) {
+        lastCount = time::getWallTime();
         int numSeeds = 0, numStates = 0;
         for (std::map<ExecutionState*, std::vector<SeedInfo> >::iterator
                it = seedMap.begin(), ie = seedMap.end();
@@ -3115,9 +5025,7 @@ void Executor::run(ExecutionState &initialState) {
 
     // XXX total hack, just because I like non uniform better but want
     // seed results to be equally weighted.
-    for (std::set<ExecutionState*>::iterator
-           it = states.begin(), ie = states.end();
-         it != ie; ++it) {
+    for (auto it = states.begin(), ie = states.end(); it != ie; ++it) {
       (*it)->weight = 1.;
     }
 
@@ -3133,11 +5041,63 @@ void Executor::run(ExecutionState &initialState) {
   searcher->update(0, newStates, std::vector<ExecutionState *>());
 
   while (!states.empty() && !haltExecution) {
+    if (searcher->empty() && !suspendedStates.empty()) {
+      resumeState(*suspendedStates.begin()->first);
+      updateStates(nullptr);
+    }
+    if (searcher->empty() && !deferredStates.empty()) {
+      retriedState = deferredStates.front();
+      deferredStates.pop_front();
+      continueState(*retriedState);
+      updateStates(nullptr);
+    }
+    time::Point selectStart;
+    if (EventTrace::enabled())
+      selectStart = time::getWallTime();
     ExecutionState &state = searcher->selectState();
+    if (EventTrace::enabled())
+      EventTrace::record(TraceEvent::Select, &state, 0, selectStart,
+                         time::getWallTime() - selectStart);
+    state.lastScheduled = stats::instructions;
+    expandState(state);
+    if (!state.pendingCondition.isNull() && !provePendingCondition(state)) {
+      updateStates(&state);
+      continue;
+    }
+    if (!state.checkpointId && resumeTree) {
+      terminateState(state);
+      updateStates(&state);
+      continue;
+    }
+    if (SummarizeLoops && summarizeLoop(state)) {
+      updateStates(&state);
+      continue;
+    }
+    if (AutoMergeLoops && mergeAtLoopBoundary(state)) {
+      updateStates(&state);
+      continue;
+    }
+    if (DedupStates && isDuplicateState(state)) {
+      ++stats::duplicateStates;
+      // its paths are left to the other state, wherever that one is
+      if (state.subsumptionNode)
+        state.subsumptionNode->markIncomplete();
+      terminateState(state);
+      updateStates(&state);
+      continue;
+    }
+    if (subsumptionTable && isSubsumedState(state)) {
+      ++stats::subsumedStates;
+      terminateState(state);
+      updateStates(&state);
+      continue;
+    }
     KInstruction *ki = state.pc;
     stepInstruction(state);
 
     executeInstruction(state, ki);
+    if (ConcreteFastPath)
+      executeConcreteRun(state, ki);
     timers.invoke();
     if (::dumpStates) dumpStates();
     if (::dumpPTree) dumpPTree();
@@ -3145,6 +5105,11 @@ void Executor::run(ExecutionState &initialState) {
     checkMemoryUsage();
 
     updateStates(&state);
+
+    if (CompactStatesAfter && stats::instructions >= nextCompaction) {
+      compactStates();
+      nextCompaction = stats::instructions + CompactStatesAfter;
+    }
   }
 
   delete searcher;
@@ -3217,13 +5182,267 @@ void Executor::continueState(ExecutionState &state){
   }
 }
 
+/// Whether the state stands between the terminator of a block and the
+/// first instruction of its successor in the same frame.
+static bool isAtBlockEntry(const ExecutionState &state) {
+  Instruction *last = state.prevPC->inst, *first = state.pc->inst;
+  BasicBlock *src = last->getParent(), *dst = first->getParent();
+  return first == &dst->front() && last == &src->back() &&
+         !isa<ReturnInst>(last) && src->getParent() == dst->getParent();
+}
+
+bool Executor::isDuplicateState(const ExecutionState &state) {
+  if (!isAtBlockEntry(state))
+    return false;
+  // a state meeting its own fingerprint again is looping, leave it to the
+  // other limits rather than dropping the only copy
+  auto res = visitedFingerprints.emplace(state.getFingerprint(), &state);
+  return !res.second && res.first->second != &state;
+}
+
+bool Executor::isSubsumedState(ExecutionState &state) {
+  if (!isAtBlockEntry(state) || !seedMap.empty() || replayPath)
+    return false;
+
+  uint64_t fingerprint = state.getContextFingerprint();
+  if (const auto *interpolants = subsumptionTable->lookup(fingerprint)) {
+    ExprHashSet constraints(state.constraints.begin(),
+                            state.constraints.end());
+    auto implies = [&](const std::vector<ref<Expr> > &interpolant) {
+      for (const ref<Expr> &constraint : interpolant) {
+        bool res;
+        if (!constraints.count(constraint) &&
+            (!solver->mustBeTrue(state, constraint, res) || !res))
+          return false;
+      }
+      return true;
+    };
+    for (const std::vector<ref<Expr> > &interpolant : *interpolants) {
+      if (implies(interpolant)) {
+        // the paths of the state depend on its constraints only through
+        // the interpolant, which the enclosing subtrees have to keep
+        if (state.subsumptionNode)
+          for (const ref<Expr> &constraint : interpolant)
+            state.subsumptionNode->noteQuery(constraint);
+        return true;
+      }
+    }
+  }
+
+  state.subsumptionNode = subsumptionTable->open(state.subsumptionNode,
+                                                 fingerprint,
+                                                 state.constraints);
+  return false;
+}
+
+bool Executor::summarizeLoop(ExecutionState &state) {
+  if (!isAtBlockEntry(state))
+    return false;
+  BasicBlock *src = state.prevPC->inst->getParent();
+  BasicBlock *dst = state.pc->inst->getParent();
+  KFunction *kf = state.stack.back().kf;
+  const Loop *loop = kf->getLoopInfo().getLoopFor(dst);
+  if (!loop || loop->getHeader() != dst || loop->contains(src))
+    return false;
+
+  auto it = loopSummaries.find(loop);
+  if (it == loopSummaries.end())
+    it = loopSummaries
+             .emplace(loop, LoopSummary::analyze(loop, *kmodule->targetData))
+             .first;
+  const LoopSummary *summary = it->second.get();
+  if (!summary)
+    return false;
+
+  PHINode *iv = summary->inductionVariable;
+  KInstruction *ivKI = kf->getKInstruction(iv);
+  KInstruction *compareKI = kf->getKInstruction(summary->compare);
+  KValue startValue = eval(ivKI, iv->getBasicBlockIndex(src), state);
+  KValue boundValue = eval(compareKI, summary->boundOperand, state);
+  for (const KValue *value : {&startValue, &boundValue}) {
+    ConstantExpr *segment = dyn_cast<ConstantExpr>(value->getSegment());
+    if (!segment || !segment->isZero())
+      return false;
+  }
+  ref<Expr> start = startValue.getValue(), bound = boundValue.getValue();
+  Expr::Width width = start->getWidth();
+  ref<Expr> one = ConstantExpr::alloc(1, width);
+  ref<Expr> first = summary->comparesIncrement ? AddExpr::create(start, one)
+                                               : start;
+
+  solver->setTimeout(coreSolverTimeout);
+  bool success = true, result = true;
+  // counting up to an unequal bound wraps around, which the summary does not
+  // model
+  if (summary->predicate == CmpInst::ICMP_NE)
+    success = solver->mustBeTrue(state,
+                                 summary->isSigned
+                                     ? SleExpr::create(first, bound)
+                                     : UleExpr::create(first, bound),
+                                 result);
+  solver->setTimeout(time::Span());
+  if (!success || !result)
+    return false;
+
+  // the iterations the exit test holds for, and the ones the stores run in
+  ref<Expr> goesOn = summary->isSigned ? SltExpr::create(first, bound)
+                                       : UltExpr::create(first, bound);
+  ref<Expr> count = SelectExpr::create(goesOn, SubExpr::create(bound, first),
+                                       ConstantExpr::alloc(0, width));
+  Expr::Width pointerWidth = Context::get().getPointerWidth();
+  ref<Expr> iterations = ZExtExpr::create(count, pointerWidth);
+  if (summary->testAfterBody)
+    iterations =
+        AddExpr::create(iterations, ConstantExpr::alloc(1, pointerWidth));
+
+  struct Write {
+    const MemoryObject *mo;
+    const ObjectState *os;
+    uint64_t offset;
+    uint64_t elementSize;
+    KValue value;
+  };
+  std::vector<Write> writes;
+  for (const LoopSummary::Store &store : summary->stores) {
+    KValue base = eval(kf->getKInstruction(store.address), 0, state);
+    ObjectPair op;
+    if (!isa<ConstantExpr>(base.getSegment()) ||
+        !state.addressSpace.resolveOneConstantSegment(base, op))
+      return false;
+    const MemoryObject *mo = op.first;
+    ConstantExpr *size = dyn_cast<ConstantExpr>(mo->size);
+    if (!size || op.second->readOnly)
+      return false;
+    for (const Write &write : writes)
+      if (write.mo == mo)
+        return false;
+
+    ref<Expr> index = start;
+    if (store.cast == Instruction::ZExt)
+      index = ZExtExpr::create(start, pointerWidth);
+    else if (width < pointerWidth)
+      index = SExtExpr::create(start, pointerWidth);
+    ref<Expr> elementSize = ConstantExpr::alloc(store.elementSize,
+                                                pointerWidth);
+    ref<Expr> begin = AddExpr::create(base.getOffset(),
+                                      MulExpr::create(index, elementSize));
+    ConstantExpr *beginCE = dyn_cast<ConstantExpr>(begin);
+    if (!beginCE)
+      return false;
+    ref<Expr> end = AddExpr::create(
+        begin, MulExpr::create(iterations, elementSize));
+    ref<Expr> objectSize = ZExtExpr::create(size, pointerWidth);
+    ref<Expr> inBounds = OrExpr::create(
+        Expr::createIsZero(iterations),
+        AndExpr::create(UleExpr::create(iterations, objectSize),
+                        AndExpr::create(UleExpr::create(begin, end),
+                                        UleExpr::create(end, objectSize))));
+    // an access out of bounds is left to the iterations to report
+    solver->setTimeout(coreSolverTimeout);
+    success = solver->mustBeTrue(state, inBounds, result);
+    solver->setTimeout(time::Span());
+    if (!success || !result)
+      return false;
+    writes.push_back({mo, op.second, beginCE->getZExtValue(),
+                      store.elementSize,
+                      eval(kf->getKInstruction(store.store), 0, state)});
+  }
+
+  // the elements written by the iterations, or by the ones up to the count
+  // if it is symbolic
+  ConstantExpr *iterationsCE = dyn_cast<ConstantExpr>(iterations);
+  for (const Write &write : writes) {
+    if (callMemoizer)
+      CallMemoizer::noteWrite(state, write.mo);
+    ObjectState *wos = state.addressSpace.getWriteable(write.mo, write.os);
+    uint64_t size = cast<ConstantExpr>(write.mo->size)->getZExtValue();
+    uint64_t elements = iterationsCE ? iterationsCE->getZExtValue()
+                        : write.offset > size
+                            ? 0
+                            : (size - write.offset) / write.elementSize;
+    for (uint64_t i = 0; i != elements; ++i) {
+      unsigned offset = write.offset + i * write.elementSize;
+      if (iterationsCE) {
+        wos->write(offset, write.value);
+        continue;
+      }
+      KValue written(UltExpr::create(ConstantExpr::alloc(i, pointerWidth),
+                                     iterations));
+      wos->write(offset, written.Select(write.value,
+                                        wos->read(offset,
+                                                  write.value.getWidth())));
+    }
+  }
+
+  // the registers read after the loop, the increment only if it was
+  // computed before the exit test
+  ref<Expr> last = AddExpr::create(start, count);
+  bindLocal(ivKI, state, KValue(last));
+  bindLocal(kf->getKInstruction(summary->increment), state,
+            KValue(AddExpr::create(last, one)));
+  ++stats::loopsSummarized;
+  state.prevPC = &kf->instructions[kf->basicBlockEntry[summary->exiting] +
+                                   summary->exiting->size() - 1];
+  transferToBasicBlock(summary->exit, summary->exiting, state);
+  return true;
+}
+
+bool Executor::mergeAtLoopBoundary(ExecutionState &state) {
+  if (!isAtBlockEntry(state))
+    return false;
+  Instruction *last = state.prevPC->inst, *first = state.pc->inst;
+  BasicBlock *src = last->getParent(), *dst = first->getParent();
+
+  size_t frame = state.stack.size();
+  while (!state.openMergeStack.empty()) {
+    MergeHandler *mh = state.openMergeStack.back().get();
+    const Loop *loop = mh->getLoop();
+    if (!loop)
+      break;
+    if (mh->getLoopFrame() > frame ||
+        (mh->getLoopFrame() == frame && !loop->contains(src))) {
+      // the frame returned from inside the loop, it will not reach an exit
+      mh->removeOpenState(&state);
+      state.openMergeStack.pop_back();
+      continue;
+    }
+    if (mh->getLoopFrame() == frame && !loop->contains(dst)) {
+      if (DebugLogMerge)
+        llvm::errs() << "loop exit: " << &state << " at " << first << '\n';
+      inCloseMerge.insert(&state);
+      mh->addClosedState(&state, first);
+      state.openMergeStack.pop_back();
+      return true;
+    }
+    break;
+  }
+
+  const Loop *loop = state.stack.back().kf->getLoopInfo().getLoopFor(dst);
+  if (loop && loop->getHeader() == dst && !loop->contains(src)) {
+    if (DebugLogMerge)
+      llvm::errs() << "loop entry: " << &state << " at " << first << '\n';
+    state.openMergeStack.push_back(
+        ref<MergeHandler>(new MergeHandler(this, &state, loop)));
+  }
+  return false;
+}
+
 void Executor::terminateState(ExecutionState &state) {
   if (replayKTest && replayPosition!=replayKTest->numObjects) {
     klee_warning_once(replayKTest,
                       "replay did not consume all objects in test input.");
   }
 
-  interpreterHandler->incPathsExplored();
+  // the paths of a finished subtree were counted by the resumed run
+  if (state.checkpointId)
+    interpreterHandler->incPathsExplored();
+  if (checkpointLog && state.checkpointId)
+    checkpointLog->end(state.checkpointId);
+  EventTrace::record(TraceEvent::Terminate, &state);
+
+  if (&state == retriedState)
+    retriedState = nullptr;
+  compactedStates.erase(&state);
 
   std::vector<ExecutionState *>::iterator it =
       std::find(addedStates.begin(), addedStates.end(), &state);
@@ -3245,6 +5464,8 @@ void Executor::terminateState(ExecutionState &state) {
 
 void Executor::terminateStateEarly(ExecutionState &state, 
                                    const Twine &message) {
+  if (state.subsumptionNode)
+    state.subsumptionNode->markIncomplete();
   if (ExitOnErrorType.empty() &&
       (!OnlyOutputStatesCoveringNew || state.coveredNew ||
       (AlwaysOutputSeeds && seedMap.count(&state))))
@@ -3278,85 +5499,30 @@ static std::vector<const MemoryObject *> getMemoryLeaks(ExecutionState &state) {
     return leaks;
 }
 
-static void getPointers(const llvm::Type *type,
-                        const llvm::DataLayout& DL,
-                        const ObjectState *os,
-                        std::set<ref<Expr>>& objects,
-                        unsigned off=0) {
-  using namespace llvm;
-
-  const auto ptrWidth = Context::get().getPointerWidth();
-
-  // XXX: we ignore integer types which is wrong since
-  // we can cast pointer to integer... we should actually search
-  // any object that has segment plane set
-  for (auto *Ty : type->subtypes()) {
-      if (Ty->isStructTy()) {
-          getPointers(Ty, DL, os, objects, off);
-      } else if (auto AT = dyn_cast<ArrayType>(Ty)) {
-          if (AT->getElementType()->isIntegerTy())
-              continue; // we cannot find anything here
-
-          // we must search on all indices in the array,
-          // so just artificially shift offsets
-          for (unsigned idx = 0; idx < AT->getNumElements(); ++idx) {
-              getPointers(Ty, DL, os, objects,
-                          off + idx*DL.getTypeAllocSize(AT->getElementType()));
-          }
-      } if (Ty->isPointerTy()) {
-        KValue ptr = os->read(off, ptrWidth);
-       //llvm::errs() << "TY @ " << off << ": " << *Ty << "\n";
-       //llvm::errs() << "  --> POINTER!: " << *Ty << "\n";
-       //llvm::errs() << "  --> " << ptr << "\n";
-        objects.insert(ptr.getSegment());
-      }
-      // FIXME: is this always enough? Does this cover padding
-      // in any structure?
-      off += DL.getTypeAllocSize(Ty);
-  }
-}
-
 std::set<const MemoryObject *>
 Executor::getReachableMemoryObjects(ExecutionState &state) {
     std::set<const MemoryObject *> reachable;
-    std::set<ObjectPair> queue;
-
-    DataLayout& DL = *kmodule->targetData.get();
+    std::vector<ObjectPair> queue;
 
     for (auto& object : state.addressSpace.objects) {
       // the only objects that are still left are those that
       // are either local to main or global (or heap-allocated,
-      // but we do not care about those while initializing queue)
+      // but those are found through the others)
       if (object.first->isLocal || object.first->isGlobal) {
-
         reachable.insert(object.first);
-
-        if (!object.first->allocSite ||
-            (!llvm::isa<llvm::AllocaInst>(object.first->allocSite) &&
-            !llvm::isa<llvm::GlobalValue>(object.first->allocSite))){
-          continue;
-        }
-
-        queue.insert(object);
+        queue.push_back(object);
       }
     }
 
-    // iterate the search until we searched all the reachable objects
+    // follow the edges of the points-to graph until we searched all the
+    // reachable objects; the edges of an object are cached with its
+    // contents, so only the objects written since they were last
+    // searched (by any state) are scanned again
     while (!queue.empty()) {
-      ObjectPair object = *queue.begin();
-      queue.erase(queue.begin());
-
-      if (!object.first->allocSite ||
-          (!llvm::isa<llvm::AllocaInst>(object.first->allocSite) &&
-          !llvm::isa<llvm::GlobalValue>(object.first->allocSite))){
-        continue;
-      }
+      ObjectPair object = queue.back();
+      queue.pop_back();
 
-      std::set<ref<Expr>> segments;
-      getPointers(object.first->allocSite->getType(), DL,
-                  &*object.second, segments);
-
-      for (auto segment : segments) {
+      for (ref<Expr> segment : object.second->getStoredSegments()) {
         segment = toUnique(state, segment);
         if (auto C = dyn_cast<ConstantExpr>(segment)) {
           if (C->getZExtValue() < FIRST_ORDINARY_SEGMENT)
@@ -3370,7 +5536,7 @@ Executor::getReachableMemoryObjects(ExecutionState &state) {
               if (reachable.insert(result.first).second) {
                   // if we haven't found this memory before,
                   // add it to queue for processing
-                  queue.insert(result);
+                  queue.push_back(result);
               }
           } else {
               klee_warning("Failed resolving segment in memcleanup check");
@@ -3485,6 +5651,8 @@ void Executor::terminateStateOnError(ExecutionState &state,
                                      const llvm::Twine &info) {
   std::string message = messaget.str();
   static std::set< std::pair<Instruction*, std::string> > emittedErrors;
+  if (state.subsumptionNode)
+    state.subsumptionNode->markIncomplete();
   Instruction * lastInst;
   const InstructionInfo &ii = getLastNonKleeInternalInstruction(state, &lastInst);
 
@@ -3508,6 +5676,7 @@ void Executor::terminateStateOnError(ExecutionState &state,
   // for a specific error and this is the error (haltExecution is set to true),
   // or if we do not search for a specific error and we haven't emitted this error yet
   if (EmitAllErrors || haltExecution || (ExitOnErrorType.empty() && notemitted)) {
+    kmodule->infos->computeAssemblyLines();
     std::string MsgString;
     llvm::raw_string_ostream msg(MsgString);
     msg << "Error: " << message << "\n";
@@ -3640,14 +5809,87 @@ static std::set<std::string> nokExternals({"fesetround", "fesetenv",
                                            "feupdateenv", "fesetexceptflag",
                                            "feclearexcept", "feraiseexcept"});
 
+bool Executor::lookupPureCall(ExecutionState &state, Function *function,
+                              const std::vector<Cell> &arguments,
+                              KValue &result) {
+  auto calls = state.pureCalls.lookup(function);
+  if (!calls)
+    return false;
+  for (const ExecutionState::PureCall &call : calls->second) {
+    if (call.arguments.size() != arguments.size())
+      continue;
+    bool same = true;
+    for (unsigned i = 0; same && i != arguments.size(); ++i)
+      same = call.arguments[i].getSegment() == arguments[i].getSegment() &&
+             call.arguments[i].getValue() == arguments[i].getValue();
+    if (same) {
+      ++stats::pureCallsShared;
+      result = call.result;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Executor::recordPureCall(ExecutionState &state, Function *function,
+                              const std::vector<Cell> &arguments,
+                              const KValue &result) {
+  // Equal arguments imply equal results. Only the last calls get the
+  // constraint, a function called over and over with symbolic arguments
+  // would otherwise add a quadratic number of them.
+  const unsigned congruentCalls = 16;
+  ImmutableList<ExecutionState::PureCall> calls;
+  if (auto previous = state.pureCalls.lookup(function))
+    calls = previous->second;
+  unsigned index = 0;
+  for (const ExecutionState::PureCall &call : calls) {
+    if (index++ + congruentCalls < calls.size() ||
+        call.arguments.size() != arguments.size() ||
+        call.result.getWidth() != result.getWidth())
+      continue;
+    ref<Expr> equalArguments = ConstantExpr::alloc(1, Expr::Bool);
+    for (unsigned i = 0; i != arguments.size(); ++i) {
+      if (call.arguments[i].getWidth() != arguments[i].getWidth()) {
+        equalArguments = ConstantExpr::alloc(0, Expr::Bool);
+        break;
+      }
+      equalArguments = AndExpr::create(
+          equalArguments,
+          AndExpr::create(EqExpr::create(call.arguments[i].getSegment(),
+                                         arguments[i].getSegment()),
+                          EqExpr::create(call.arguments[i].getValue(),
+                                         arguments[i].getValue())));
+    }
+    if (equalArguments->isFalse())
+      continue;
+    ref<Expr> equalResults =
+        AndExpr::create(EqExpr::create(call.result.getSegment(),
+                                       result.getSegment()),
+                        EqExpr::create(call.result.getValue(),
+                                       result.getValue()));
+    ++stats::pureCallCongruences;
+    addConstraint(state, OrExpr::create(Expr::createIsZero(equalArguments),
+                                        equalResults));
+  }
+
+  calls.push_back({std::vector<KValue>(arguments.begin(), arguments.end()),
+                   result});
+  state.pureCalls = state.pureCalls.replace({function, calls});
+}
+
 void Executor::callExternalFunction(ExecutionState &state,
                                     KInstruction *target,
                                     Function *function,
                                     const std::vector<Cell> &arguments) {
+  if (callMemoizer)
+    CallMemoizer::noteImpure(state);
+
   // check if specialFunctionHandler wants it
   if (specialFunctionHandler->handle(state, function, target, arguments))
     return;
 
+  QueryPurposeScope purpose(*solver, ConcretizationQuery);
+
   if (ExternalCalls == ExternalCallPolicy::Pure &&
       nokExternals.count(function->getName()) > 0) {
     terminateStateOnError(state, "failed external call", User);
@@ -3681,6 +5923,12 @@ void Executor::callExternalFunction(ExecutionState &state,
                           function->getName().str().c_str());
         terminateStateOnError(state, "failed external call", User);
     } else {
+        KValue result;
+        if (lookupPureCall(state, function, arguments, result)) {
+            bindLocal(target, state, result);
+            return;
+        }
+
         bool isPointer = false;
         if (retTy->isPointerTy()) {
             isPointer = true;
@@ -3690,6 +5938,7 @@ void Executor::callExternalFunction(ExecutionState &state,
         auto nv = createNondetValue(state, size, false,
                                     target, function->getName().str(),
                                     isPointer);
+        recordPureCall(state, function, arguments, nv);
         bindLocal(target, state, nv);
         klee_warning_once(target, "Assume that the undefined function %s is pure",
                           function->getName().str().c_str());
@@ -3721,16 +5970,7 @@ void Executor::callExternalFunction(ExecutionState &state,
         Optional<uint64_t> temp;
         state.addressSpace.resolveOne(state, solver, *ai, op, success, temp);
         if (success) {
-          auto found = state.addressSpace.resolveInConcreteMap(
-              op.first->segment, address);
-          if (!found) {
-            void *addr = memory->allocateMemory(
-                op.first->allocatedSize,
-                getAllocationAlignment(op.first->allocSite));
-            if (!addr)
-              klee_error("Couldn't allocate memory for external function");
-            address = reinterpret_cast<uint64_t>(addr);
-          }
+          address = getConcreteAddress(state, op.first);
           resolvedMOs.insert({op.first->segment, address});
 
           if (op.second->getSizeBound() == 0 ||
@@ -3741,7 +5981,10 @@ void Executor::callExternalFunction(ExecutionState &state,
                            function->getName());
             return;
           }
-          op.second->flushToConcreteStore(solver, state);
+          // read-only objects have no symbolic bytes to flush
+          if (!op.second->readOnly)
+            state.addressSpace.getWriteable(op.first, op.second)
+                ->flushToConcreteStore(solver, state);
         }
       }
       wordIndex += (ce->getWidth() + 63) / 64;
@@ -3762,16 +6005,7 @@ void Executor::callExternalFunction(ExecutionState &state,
         Optional<uint64_t> temp;
         state.addressSpace.resolveOne(state, solver, *ai, op, success, temp);
         if (success) {
-          auto found = state.addressSpace.resolveInConcreteMap(
-              op.first->segment, address);
-          if (!found) {
-            void *addr = memory->allocateMemory(
-                op.first->allocatedSize,
-                getAllocationAlignment(op.first->allocSite));
-            if (!addr)
-              klee_error("Couldn't allocate memory for external function");
-            address = reinterpret_cast<uint64_t>(addr);
-          }
+          address = getConcreteAddress(state, op.first);
 
           resolvedMOs.insert({op.first->segment, address});
 
@@ -3858,7 +6092,22 @@ void Executor::callExternalFunction(ExecutionState &state,
       klee_warning_once(function, "%s", os.str().c_str());
   }
 
-  bool success = externalDispatcher->executeCall(function, target->inst, args);
+  bool success;
+  if (IsolateExternalCalls) {
+    ExternalDispatcher::MemoryRanges transfer;
+    transfer.reserve(resolvedMOs.size());
+    for (const auto &resolved : resolvedMOs) {
+      const ObjectPair *op =
+          state.addressSpace.segmentTable.lookup(resolved.first);
+      if (op)
+        transfer.emplace_back(reinterpret_cast<void *>(resolved.second),
+                              op->first->allocatedSize);
+    }
+    success = externalDispatcher->executeIsolatedCall(function, target->inst,
+                                                      args, transfer);
+  } else {
+    success = externalDispatcher->executeCall(function, target->inst, args);
+  }
   if (!success) {
     terminateStateOnError(state, "failed external call: " + function->getName(),
                           External);
@@ -3940,12 +6189,9 @@ ObjectState *Executor::bindObjectInState(ExecutionState &state,
   ObjectState *os = array ? new ObjectState(mo, array) : new ObjectState(mo);
   state.addressSpace.bindObject(mo, os);
 
-  // Its possible that multiple bindings of the same mo in the state
-  // will put multiple copies on this list, but it doesn't really
-  // matter because all we use this list for is to unbind the object
-  // on function return.
+  // the object may be bound again, after its lifetime ended
   if (isLocal)
-    state.stack.back().allocas.push_back(mo);
+    state.stack.back().addAlloca(mo);
 
   return os;
 }
@@ -3962,6 +6208,26 @@ void Executor::executeAlloc(ExecutionState &state,
   if (allocationAlignment == 0) {
     allocationAlignment = getAllocationAlignment(allocSite);
   }
+
+  // Segments are abstract, so unless some address was given to the old
+  // object, the resized one can take over its segment and its contents.
+  if (reallocFrom && isa<ConstantExpr>(size)) {
+    const MemoryObject *old = reallocFrom->getObject();
+    uint64_t address;
+    if (!state.addressSpace.resolveInConcreteMap(old->segment, address) &&
+        !state.addressSpace.addressLayout.lookup(old->segment)) {
+      if (MemoryObject *mo = memory->reallocate(
+              old, cast<ConstantExpr>(size)->getZExtValue())) {
+        bindLocal(target, state, mo->getPointer());
+        ObjectState *os = state.addressSpace.getWriteable(old, reallocFrom);
+        ObjectState *moved = new ObjectState(std::move(*os), mo);
+        state.addressSpace.unbindObject(old);
+        state.addressSpace.bindObject(mo, moved);
+        return;
+      }
+    }
+  }
+
   MemoryObject *mo =
       memory->allocate(size, isLocal, /*isGlobal=*/false,
                        allocSite, allocationAlignment);
@@ -3970,6 +6236,15 @@ void Executor::executeAlloc(ExecutionState &state,
               KValue(ConstantExpr::alloc(0, Context::get().getPointerWidth())));
   } else {
     bindLocal(target, state, mo->getPointer());
+    if (SymbolicSizeRange && !isa<ConstantExpr>(size)) {
+      QueryPurposeScope purpose(*solver, BoundsCheckQuery);
+      auto range = solver->getRange(state, size);
+      SymbolicSizeBounds bounds;
+      bounds.inBounds = range.first->getZExtValue();
+      bounds.maxSize = range.second->getZExtValue();
+      state.addressSpace.sizeBounds =
+          state.addressSpace.sizeBounds.replace(mo->segment, bounds);
+    }
     if (!reallocFrom) {
       ObjectState *os = bindObjectInState(state, mo, isLocal);
       if (zeroMemory) {
@@ -3988,11 +6263,15 @@ void Executor::executeAlloc(ExecutionState &state,
 void Executor::executeFree(ExecutionState &state,
                            const KValue &address,
                            KInstruction *target) {
+  QueryPurposeScope purpose(*solver, ResolutionQuery);
   auto addressOptim
     = KValue(address.getSegment(),
              optimizer.optimizeExpr(address.getOffset(), true));
 
-  StatePair zeroPointer = fork(state, addressOptim.createIsZero(), true);
+  StatePair zeroPointer = fork(state,
+                               Expr::createIsZero(addressOptim.getSegment()),
+                               Expr::createIsZero(addressOptim.getOffset()),
+                               true);
   if (zeroPointer.first) {
     if (target)
       bindLocal(target, *zeroPointer.first, KValue(Expr::createPointer(0)));
@@ -4011,8 +6290,8 @@ void Executor::executeFree(ExecutionState &state,
         terminateStateOnError(*it->second, "free of global", Free, NULL,
                               getKValueInfo(*it->second, addressOptim));
       } else {
-        const_cast<MemoryObject*>(mo)->initializeSymbolicArray(arrayCache);
-        it->second->addressSpace.removedObjectsMap.insert(std::make_pair(mo->segment, mo->symbolicAddress.getValue()));
+        RemovedObjectsMap &removed = it->second->addressSpace.removedObjectsMap;
+        removed = removed.replace(mo->segment, ref<const MemoryObject>(mo));
         it->second->addressSpace.unbindObject(mo);
         if (target)
           bindLocal(target, *it->second, KValue(Expr::createPointer(0)));
@@ -4024,6 +6303,7 @@ void Executor::executeFree(ExecutionState &state,
 void Executor::resolveExact(ExecutionState &state, const KValue &address,
                             ExactResolutionList &results,
                             const std::string &name) {
+  QueryPurposeScope purpose(*solver, ResolutionQuery);
   auto optimAddress = KValue(address.getSegment(),
                              optimizer.optimizeExpr(address.getOffset(), true));
   // XXX we may want to be capping this?
@@ -4033,9 +6313,10 @@ void Executor::resolveExact(ExecutionState &state, const KValue &address,
   ExecutionState *unbound = &state;
   for (ResolutionList::iterator it = rl.begin(), ie = rl.end(); 
        it != ie; ++it) {
-    ref<Expr> inBounds = optimAddress.Eq(it->first->getPointer()).getValue();
-    
-    StatePair branches = fork(*unbound, inBounds, true);
+    const MemoryObject *mo = it->first;
+    StatePair branches =
+        fork(*unbound, EqExpr::create(optimAddress.getSegment(), mo->getSegmentExpr()),
+             EqExpr::create(optimAddress.getOffset(), mo->getBaseExpr()), true);
     
     if (branches.first)
       results.push_back(std::make_pair(*it, branches.first));
@@ -4060,26 +6341,164 @@ void Executor::executeMemoryWrite(ExecutionState &state, const KValue &address,
                                   const KValue &value) {
   executeMemoryOperation(state, true, address, value, 0);
 }
+bool Executor::checkBounds(ExecutionState &state,
+                           ref<Expr> isEqualSegment,
+                           ref<Expr> isOffsetInBounds,
+                           bool &inBounds) {
+  QueryPurposeScope purpose(*solver, BoundsCheckQuery);
+  ConstantExpr *segmentCE = dyn_cast<ConstantExpr>(isEqualSegment);
+  ConstantExpr *offsetCE = dyn_cast<ConstantExpr>(isOffsetInBounds);
+
+  // fold the checks that are already decided
+  if ((segmentCE && segmentCE->isFalse()) || (offsetCE && offsetCE->isFalse())) {
+    ++stats::boundsChecksFolded;
+    inBounds = false;
+    return true;
+  }
+  if (segmentCE && offsetCE) {
+    ++stats::boundsChecksFolded;
+    inBounds = true;
+    return true;
+  }
+
+  // the resolution on the error path decides the access if this fails
+  return solveWithBudget(
+      state, SolverTimeoutPolicy::Speculative, [&](time::Span) {
+        if (segmentCE) {
+          ++stats::boundsChecksFolded;
+          ++stats::boundsCheckOffsetQueries;
+          return solver->mustBeTrue(state, isOffsetInBounds, inBounds);
+        }
+        if (offsetCE) {
+          ++stats::boundsChecksFolded;
+          ++stats::boundsCheckSegmentQueries;
+          return solver->mustBeTrue(state, isEqualSegment, inBounds);
+        }
+        if (CombinedBoundsCheck) {
+          ++stats::boundsCheckCombinedQueries;
+          return solver->mustBeTrue(
+              state, AndExpr::create(isEqualSegment, isOffsetInBounds),
+              inBounds);
+        }
+        ++stats::boundsCheckSegmentQueries;
+        ++stats::boundsCheckOffsetQueries;
+        bool inBoundsSegment, inBoundsOffset;
+        bool success =
+            solver->mustBeTrue(state, isEqualSegment, inBoundsSegment) &&
+            solver->mustBeTrue(state, isOffsetInBounds, inBoundsOffset);
+        inBounds = inBoundsSegment && inBoundsOffset;
+        return success;
+      });
+}
+
+bool Executor::initializeLazyPointer(ExecutionState &state,
+                                     const KValue &address, unsigned bytes,
+                                     KInstruction *target,
+                                     std::vector<ExecutionState *> &result) {
+  auto lazy = state.lazyPointers.lookup(address.getSegment());
+  if (!lazy)
+    return false;
+  ref<Expr> segment = lazy->first;
+  ref<Expr> baseOffset = lazy->second;
+  state.lazyPointers = state.lazyPointers.remove(segment);
+
+  // the object needs to extend up to the end of the access, which has to be
+  // at a constant distance past the pointer
+  ConstantExpr *delta =
+      dyn_cast<ConstantExpr>(SubExpr::create(address.getOffset(), baseOffset));
+  if (!delta || delta->getWidth() > Expr::Int64 ||
+      (int64_t)delta->getZExtValue() < 0)
+    return false;
+  uint64_t size = delta->getZExtValue() + bytes;
+
+  // the pointer is taken to point to the start of the object
+  ref<Expr> atStart =
+      EqExpr::create(ConstantExpr::alloc(0, baseOffset->getWidth()), baseOffset);
+  std::vector<ref<Expr> > conditions;
+  std::vector<const MemoryObject *> objects;
+  auto addIfFeasible = [&](const MemoryObject *mo) {
+    uint64_t segmentValue = mo ? mo->segment : 0;
+    ref<Expr> condition = AndExpr::create(
+        EqExpr::create(ConstantExpr::alloc(segmentValue, segment->getWidth()),
+                       segment),
+        atStart);
+    bool feasible;
+    if (!solver->mayBeTrue(state, condition, feasible) || !feasible)
+      return false;
+    conditions.push_back(condition);
+    objects.push_back(mo);
+    return true;
+  };
+
+  addIfFeasible(nullptr);
+  std::vector<const MemoryObject *> aliases;
+  for (const ref<const MemoryObject> &mo : state.lazyObjects) {
+    ConstantExpr *moSize = dyn_cast<ConstantExpr>(mo->size);
+    if (moSize && moSize->getZExtValue() >= size &&
+        state.addressSpace.findObject(mo.get()))
+      aliases.push_back(mo.get());
+  }
+  unsigned first = aliases.size() > LazyNondetPointerAliases
+                       ? aliases.size() - LazyNondetPointerAliases
+                       : 0;
+  for (unsigned i = first; i < aliases.size(); ++i)
+    addIfFeasible(aliases[i]);
+
+  MemoryObject *fresh =
+      memory->allocate(size, /*isLocal=*/false, /*isGlobal=*/false,
+                       target ? target->inst : nullptr, 8);
+  if (fresh && !addIfFeasible(fresh)) {
+    memory->deallocate(fresh);
+    fresh = nullptr;
+  }
+  if (conditions.empty())
+    return false;
+
+  ++stats::lazyPointerInitializations;
+  branch(state, conditions, result);
+  for (unsigned i = 0; i != result.size(); ++i) {
+    if (!result[i] || !fresh || objects[i] != fresh)
+      continue;
+    executeMakeSymbolic(*result[i], fresh, "lazy_object");
+    result[i]->lazyObjects.push_back(fresh);
+  }
+  return true;
+}
+
 void Executor::executeMemoryOperation(ExecutionState &state,
                                       bool isWrite,
                                       KValue address,
                                       KValue value, /* undef if read */
                                       KInstruction *target /* undef if write */) {
+  QueryPurposeScope purpose(*solver, ResolutionQuery);
   Expr::Width type = (isWrite ? value.getWidth() :
                      getWidthForLLVMType(target->inst->getType()));
   unsigned bytes = Expr::getMinBytesForWidth(type);
 
+  if (!state.lazyPointers.empty()) {
+    std::vector<ExecutionState *> initialized;
+    if (initializeLazyPointer(state, address, bytes, target, initialized)) {
+      for (ExecutionState *es : initialized)
+        if (es)
+          executeMemoryOperation(*es, isWrite, address, value, target);
+      return;
+    }
+  }
+
   if (SimplifySymIndices) {
-    address = KValue(state.constraints.simplifyExpr(address.getSegment()),
-                     state.constraints.simplifyExpr(address.getOffset()));
+    address.pointerSegment =
+        state.constraints.simplifyExpr(address.pointerSegment);
+    address.value = state.constraints.simplifyExpr(address.value);
     if (isWrite) {
-      value = KValue(state.constraints.simplifyExpr(value.getSegment()),
-                     state.constraints.simplifyExpr(value.getOffset()));
+      value.pointerSegment =
+          state.constraints.simplifyExpr(value.pointerSegment);
+      value.value = state.constraints.simplifyExpr(value.value);
     }
   }
 
-  address = KValue(address.getSegment(),
-                   optimizer.optimizeExpr(address.getOffset(), true));
+  address.value = optimizer.optimizeExpr(address.value, true);
+  if (isWrite)
+    value = capExprDepth(state, state.prevPC, std::move(value));
 
   // fast path: single in-bounds resolution
   ObjectPair op;
@@ -4116,43 +6535,102 @@ void Executor::executeMemoryOperation(ExecutionState &state,
       offset = address.getOffset();
     }
 
-    ref<Expr> isEqualSegment = EqExpr::create(mo->getSegmentExpr(), segment);
-
-    ref<Expr> isOffsetInBounds = mo->getBoundsCheckOffset(offset, bytes);
+    // the segment is usually known to be the one of the resolved object,
+    // do not bother the solver with it then
+    ref<Expr> isEqualSegment;
+    ConstantExpr *segmentCE = dyn_cast<ConstantExpr>(segment);
+    if (segmentCE && segmentCE->getZExtValue() == mo->segment)
+      isEqualSegment = ConstantExpr::alloc(1, Expr::Bool);
+    else
+      isEqualSegment = EqExpr::create(mo->getSegmentExpr(), segment);
+
+    // Accesses at constant offsets into objects of symbolic size are
+    // checked against what the state already knows about the size. Only
+    // the end of the access matters then, so the check need not wrap
+    // around like the general one.
+    ref<Expr> isOffsetInBounds;
+    ConstantExpr *offsetCE = dyn_cast<ConstantExpr>(offset);
+    const SymbolicSizeBounds *sizeBounds = nullptr;
+    uint64_t accessEnd = 0;
+    if (offsetCE && !isa<ConstantExpr>(mo->size) &&
+        offsetCE->getWidth() <= 64) {
+      uint64_t end = offsetCE->getZExtValue() + bytes;
+      if (end >= bytes) {
+        accessEnd = end;
+        sizeBounds = state.addressSpace.sizeBounds.lookup(mo->segment);
+        if (sizeBounds && accessEnd <= sizeBounds->inBounds)
+          isOffsetInBounds = ConstantExpr::alloc(1, Expr::Bool);
+        else if (sizeBounds && accessEnd > sizeBounds->maxSize)
+          isOffsetInBounds = ConstantExpr::alloc(0, Expr::Bool);
+        else
+          isOffsetInBounds = UleExpr::create(
+              ConstantExpr::alloc(accessEnd, mo->size->getWidth()),
+              mo->size);
+      }
+    }
+    if (isOffsetInBounds.isNull())
+      isOffsetInBounds = mo->getBoundsCheckOffset(offset, bytes);
     isOffsetInBounds = optimizer.optimizeExpr(isOffsetInBounds, true);
 
-    bool inBoundsOffset;
-    bool inBoundsSegment;
-    solver->setTimeout(coreSolverTimeout);
-    bool successSegment =
-        solver->mustBeTrue(state, isEqualSegment, inBoundsSegment);
-    bool success = solver->mustBeTrue(state, isOffsetInBounds, inBoundsOffset);
-    solver->setTimeout(time::Span());
-    if (!success || !successSegment) {
-      state.pc = state.prevPC;
-      terminateStateEarly(state, "Query timed out (bounds check).");
-      return;
+    bool inBounds;
+    if (!checkBounds(state, isEqualSegment, isOffsetInBounds, inBounds)) {
+      if (!AdaptiveSolverTimeout) {
+        state.pc = state.prevPC;
+        terminateStateEarly(state, "Query timed out (bounds check).");
+        return;
+      }
+      // the check was speculative, let the resolution below fork on the
+      // bounds instead
+      inBounds = false;
     }
 
-    if (inBoundsSegment && inBoundsOffset) {
+    if (inBounds) {
+      // remember how far the object is known to extend
+      if (accessEnd && (!sizeBounds || accessEnd > sizeBounds->inBounds)) {
+        SymbolicSizeBounds bounds = sizeBounds ? *sizeBounds
+                                               : SymbolicSizeBounds();
+        bounds.inBounds = accessEnd;
+        state.addressSpace.sizeBounds =
+            state.addressSpace.sizeBounds.replace(mo->segment, bounds);
+      }
+
       const ObjectState *os = op.second;
       if (isWrite) {
         if (os->readOnly) {
           terminateStateOnError(state, "memory error: object read only",
                                 ReadOnly);
         } else {
+          if (callMemoizer)
+            CallMemoizer::noteWrite(state, mo);
           ObjectState *wos = state.addressSpace.getWriteable(mo, os);
-          wos->write(offset, value);
+          if (!isa<ConstantExpr>(offset) && os->isSplit()) {
+            // only the bytes the offset may reach need to be flushed
+            auto range = solver->getRange(state, offset);
+            wos->write(offset, value, range.first->getZExtValue(),
+                       range.second->getZExtValue());
+          } else {
+            wos->write(offset, value);
+          }
         }          
       } else {
-        KValue result = os->read(offset, type);
+        KValue result;
+        if (!isa<ConstantExpr>(offset) && os->isSplit()) {
+          // only the windows the offset may fall into need to be read
+          auto range = solver->getRange(state, offset);
+          result = os->read(offset, type, range.first->getZExtValue(),
+                            range.second->getZExtValue());
+        } else {
+          result = os->read(offset, type);
+        }
         
         if (interpreterOpts.MakeConcreteSymbolic) {
           result = KValue(replaceReadWithSymbolic(state, result.getSegment()),
                           replaceReadWithSymbolic(state, result.getOffset()));
         }
 
-        bindLocal(target, state, result);
+        if (callMemoizer)
+          CallMemoizer::noteRead(state, mo, offset, result);
+        bindLocal(target, state, std::move(result));
       }
 
       return;
@@ -4161,22 +6639,38 @@ void Executor::executeMemoryOperation(ExecutionState &state,
 
   // we are on an error path (no resolution, multiple resolution, one
   // resolution with out of bounds)
+  if (callMemoizer)
+    CallMemoizer::noteImpure(state);
 
-  auto optimAddress = KValue(address.getSegment(),
-                             optimizer.optimizeExpr(address.getOffset(), true));
+  // the address was optimized above already
+  const KValue &optimAddress = address;
   ResolutionList rl;  
-  solver->setTimeout(coreSolverTimeout);
-  bool incomplete = state.addressSpace.resolve(state, solver, optimAddress, rl,
-                                               0, coreSolverTimeout);
-  solver->setTimeout(time::Span());
+  bool incomplete = !solveWithBudget(
+      state, SolverTimeoutPolicy::Decisive, [&](time::Span budget) {
+        rl.clear();
+        return !state.addressSpace.resolve(state, solver, optimAddress, rl, 0,
+                                           budget);
+      });
   
-  // XXX there is some query wasteage here. who cares?
+  // Ask at once which of the objects the access may be in bounds of. The
+  // states forked below only have more constraints, so the others need
+  // not be forked for.
+  std::vector<ref<Expr> > inBoundsChecks;
+  for (ResolutionList::iterator i = rl.begin(), ie = rl.end(); i != ie; ++i)
+    inBoundsChecks.push_back(
+        i->first->getBoundsCheckPointer(optimAddress, bytes));
+  std::vector<bool> mayBeInBounds;
+  if (!solver->mayBeTrue(state, inBoundsChecks, mayBeInBounds))
+    mayBeInBounds.assign(rl.size(), true);
+
   ExecutionState *unbound = &state;
   
-  for (ResolutionList::iterator i = rl.begin(), ie = rl.end(); i != ie; ++i) {
-    const MemoryObject *mo = i->first;
-    const ObjectState *os = i->second;
-    ref<Expr> inBounds = mo->getBoundsCheckPointer(optimAddress, bytes);
+  for (unsigned idx = 0; idx != rl.size(); ++idx) {
+    if (!mayBeInBounds[idx])
+      continue;
+    const MemoryObject *mo = rl[idx].first;
+    const ObjectState *os = rl[idx].second;
+    ref<Expr> inBounds = inBoundsChecks[idx];
     
     StatePair branches = fork(*unbound, inBounds, true);
     ExecutionState *bound = branches.first;
@@ -4206,7 +6700,8 @@ void Executor::executeMemoryOperation(ExecutionState &state,
   // XXX should we distinguish out of bounds and overlapped cases?
   if (unbound) {
     if (incomplete) {
-      terminateStateEarly(*unbound, "Query timed out (resolve).");
+      if (!deferState(*unbound))
+        terminateStateEarly(*unbound, "Query timed out (resolve).");
     } else {
       terminateStateOnError(*unbound, "memory error: out of bound pointer", Ptr,
                             NULL, getKValueInfo(*unbound, optimAddress));
@@ -4220,13 +6715,7 @@ KValue Executor::createNondetValue(ExecutionState &state,
                                    const std::string &name,
                                    bool isPointer) {
   assert(!replayKTest);
-  // Find a unique name for this array.  First try the original name,
-  // or if that fails try adding a unique identifier.
-  unsigned id = 0;
-  std::string uniqueName = name;
-  while (!state.arrayNames.insert(uniqueName).second) {
-    uniqueName = name + "_" + llvm::utostr(++id);
-  }
+  std::string uniqueName = state.getUniqueArrayName(name);
 
   KValue kval;
   const Array *array = arrayCache.CreateArray(uniqueName, size);
@@ -4235,9 +6724,8 @@ KValue Executor::createNondetValue(ExecutionState &state,
   if (isPointer) {
     assert(!isSigned && "Got signed pointer");
     std::string offName = uniqueName + "_off";
-    bool had = state.arrayNames.insert(offName).second;
-    assert(had && "Already had a unique name");
-    (void)had;
+    assert(!state.arrayNames.count(offName) && "Already had a unique name");
+    state.arrayNames = state.arrayNames.insert(offName);
 
     const Array *offarray
         = arrayCache.CreateArray(offName, Context::get().getPointerWidth());
@@ -4250,6 +6738,10 @@ KValue Executor::createNondetValue(ExecutionState &state,
   auto& nv = state.addNondetValue(kval, isSigned, name);
   nv.kinstruction = kinst;
 
+  if (isPointer && LazyNondetPointers)
+    state.lazyPointers =
+        state.lazyPointers.insert({kval.getSegment(), kval.getOffset()});
+
   return kval;
 }
 
@@ -4259,13 +6751,7 @@ void Executor::executeMakeSymbolic(ExecutionState &state,
                                    const std::string &name) {
   // Create a new object state for the memory object (instead of a copy).
   if (!replayKTest) {
-    // Find a unique name for this array.  First try the original name,
-    // or if that fails try adding a unique identifier.
-    unsigned id = 0;
-    std::string uniqueName = name;
-    while (!state.arrayNames.insert(uniqueName).second) {
-      uniqueName = name + "_" + llvm::utostr(++id);
-    }
+    std::string uniqueName = state.getUniqueArrayName(name);
     // TODO fix seeding fo symbolic sizes
     unsigned size = 0;
     if (ConstantExpr *CE = dyn_cast<ConstantExpr>(mo->size)) {
@@ -4442,18 +6928,35 @@ void Executor::runFunctionAsMain(Function *f,
     }
   }
   
-  initializeGlobals(*state);
+  if (globalsSnapshot) {
+    restoreGlobalsSnapshot(*state);
+  } else {
+    const MemoryMap before = state->addressSpace.objects;
+    initializeGlobals(*state);
+    if (ReuseGlobalsSnapshot)
+      takeGlobalsSnapshot(*state, before);
+  }
 
   processTree = std::make_unique<PTree>(state);
   run(*state);
   processTree = nullptr;
 
-  // hack to clear memory objects
-  delete memory;
-  memory = new MemoryManager(nullptr, NumPtrBytes * 8);
+  reportExprDepthConcretizations();
+  if (callMemoizer) {
+    callMemoizer->report(interpreterHandler->getInfoStream());
+    // the cached reads keep their objects, which the memory manager frees
+    callMemoizer.reset(new CallMemoizer());
+  }
 
-  globalObjects.clear();
-  globalAddresses.clear();
+  // hack to clear memory objects; the snapshot refers to the globals and
+  // their concrete memory, so they have to stay
+  if (!globalsSnapshot) {
+    delete memory;
+    memory = new MemoryManager(nullptr, NumPtrBytes * 8);
+
+    globalObjects.clear();
+    globalAddresses.clear();
+  }
 
   if (statsTracker)
     statsTracker->done();
@@ -4469,6 +6972,10 @@ unsigned Executor::getSymbolicPathStreamID(const ExecutionState &state) {
   return state.symPathOS.getID();
 }
 
+uint64_t Executor::getPathId(const ExecutionState &state) {
+  return state.pathId;
+}
+
 void Executor::getConstraintLog(const ExecutionState &state, std::string &res,
                                 Interpreter::LogType logFormat) {
 
@@ -4503,12 +7010,47 @@ void Executor::getConstraintLog(const ExecutionState &state, std::string &res,
   }
 }
 
+static ref<Expr> getConjunction(const std::vector<ref<Expr> > &exprs,
+                                size_t begin, size_t end) {
+  // balanced, so that many expressions do not make a deep expression
+  if (end - begin == 1)
+    return exprs[begin];
+  size_t mid = begin + (end - begin) / 2;
+  return AndExpr::create(getConjunction(exprs, begin, mid),
+                         getConjunction(exprs, mid, end));
+}
+
+/// Constrain \a state by the preferences from \a begin to \a end, each
+/// unless it contradicts the constraints and the preferences taken before
+/// it. They are all tried at once first and split in halves only if they
+/// cannot all be met, so the usual case costs one query instead of one per
+/// preference.
+/// \return false if the solver failed.
+static bool addCexPreferences(TimingSolver *solver, ExecutionState &state,
+                              const std::vector<ref<Expr> > &preferences,
+                              size_t begin, size_t end) {
+  bool mayBeTrue;
+  if (!solver->mayBeTrue(state, getConjunction(preferences, begin, end),
+                         mayBeTrue))
+    return false;
+  if (mayBeTrue) {
+    for (size_t i = begin; i < end; ++i)
+      state.addConstraint(preferences[i]);
+    return true;
+  }
+  if (end - begin == 1)
+    return true;
+  size_t mid = begin + (end - begin) / 2;
+  return addCexPreferences(solver, state, preferences, begin, mid) &&
+         addCexPreferences(solver, state, preferences, mid, end);
+}
+
 bool Executor::getSymbolicSolution(const ExecutionState &state,
                                    std::vector< 
                                    std::pair<std::string,
                                    std::vector<unsigned char> > >
                                    &res) {
-
+  QueryPurposeScope purpose(*solver, TestGenerationQuery);
   solver->setTimeout(coreSolverTimeout);
 
   ExecutionState tmp(state);
@@ -4520,32 +7062,24 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
   // the preferred constraints.  See test/Features/PreferCex.c for
   // an example) While this process can be very expensive, it can
   // also make understanding individual test cases much easier.
-  for (unsigned i = 0; i != state.symbolics.size(); ++i) {
-    const MemoryObject *mo = state.symbolics[i].first;
-    std::vector< ref<Expr> >::const_iterator pi = 
-      mo->cexPreferences.begin(), pie = mo->cexPreferences.end();
-    for (; pi != pie; ++pi) {
-      bool mustBeTrue;
-      // Attempt to bound byte to constraints held in cexPreferences
-      bool success = solver->mustBeTrue(tmp, Expr::createIsZero(*pi), 
-					mustBeTrue);
-      // If it isn't possible to constrain this particular byte in the desired
-      // way (normally this would mean that the byte can't be constrained to
-      // be between 0 and 127 without making the entire constraint list UNSAT)
-      // then just continue on to the next byte.
-      if (!success) break;
-      // If the particular constraint operated on in this iteration through
-      // the loop isn't implied then add it to the list of constraints.
-      if (!mustBeTrue) tmp.addConstraint(*pi);
-    }
-    if (pi!=pie) break;
-  }
+  // A preference which cannot be met along with the ones before it
+  // (normally this would mean that the byte can't be constrained to be
+  // between 0 and 127 without making the entire constraint list UNSAT) is
+  // skipped, and the search stops if the solver fails.
+  std::vector<ref<Expr> > preferences;
+  for (const auto &symbolic : state.symbolics) {
+    const MemoryObject *mo = symbolic.getObject();
+    preferences.insert(preferences.end(), mo->cexPreferences.begin(),
+                       mo->cexPreferences.end());
+  }
+  if (!preferences.empty())
+    addCexPreferences(solver, tmp, preferences, 0, preferences.size());
 
   // try to minimize sizes of symbolic-size objects
   std::vector<uint64_t> sizes;
   sizes.reserve(state.symbolics.size());
-  for (unsigned i = 0; i != state.symbolics.size(); ++i) {
-    const MemoryObject *mo = state.symbolics[i].first;
+  for (const auto &symbolic : state.symbolics) {
+    const MemoryObject *mo = symbolic.getObject();
     if (ConstantExpr *CE = dyn_cast<ConstantExpr>(mo->size)) {
       sizes.push_back(CE->getZExtValue());
     } else {
@@ -4567,15 +7101,16 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
       return false;
     }
   }
-  for (unsigned i = 0; i != state.symbolics.size(); ++i) {
-    const MemoryObject *mo = state.symbolics[i].first;
-    const Array *array = state.symbolics[i].second;
+  unsigned i = 0;
+  for (const auto &symbolic : state.symbolics) {
+    const MemoryObject *mo = symbolic.getObject();
+    const Array *array = symbolic.getArray();
     std::vector<uint8_t> data;
     data.reserve(sizes[i]);
     if (auto vals = assignment->getBindingsOrNull(array)) {
       data = vals->asVector();
     }
-    data.resize(sizes[i]);
+    data.resize(sizes[i++]);
     res.push_back(std::make_pair(mo->name, data));
   }
 
@@ -4591,7 +7126,7 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
     auto segment = pair.first;
     tmp.addConstraint(EqExpr::create(it.value.getSegment(), segment));
 
-    std::string descr = it.name;
+    std::string descr = it.getName();
     if (it.kinstruction) {
       auto *info = it.kinstruction->info;
       if (!info->file.empty()) {
@@ -4649,9 +7184,9 @@ Executor::getTestVector(const ExecutionState &state) {
 
     if (seg > 0) {
         auto w = Context::get().getPointerWidth();
-        res.emplace_back(APInt(w, seg), APInt(w, val), it.name);
+        res.emplace_back(APInt(w, seg), APInt(w, val), it.getName());
     } else {
-        res.emplace_back(size, val, it.isSigned, it.name);
+        res.emplace_back(size, val, it.isSigned, it.getName());
     }
     if (it.kinstruction) {
         const auto& D = it.kinstruction->inst->getDebugLoc();
@@ -4666,40 +7201,71 @@ Executor::getTestVector(const ExecutionState &state) {
 
 void Executor::getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res) {
-  res = state.coveredLines;
+  res.clear();
+  if (state.coveredInstructions.empty())
+    return;
+
+  if (instructionInfosById.empty()) {
+    instructionInfosById.resize(kmodule->infos->getMaxID());
+    for (auto &kf : kmodule->functions)
+      for (unsigned i = 0; i != kf->numInstructions; ++i) {
+        const InstructionInfo *ii = kf->instructions[i]->info;
+        instructionInfosById[ii->id] = ii;
+      }
+  }
+  for (unsigned id : state.coveredInstructions) {
+    const InstructionInfo *ii = instructionInfosById[id];
+    res[&ii->file].insert(ii->line);
+  }
 }
 
 void Executor::doImpliedValueConcretization(ExecutionState &state,
                                             ref<Expr> e,
                                             ref<ConstantExpr> value) {
-  abort(); // FIXME: Broken until we sort out how to do the write back.
-
   if (DebugCheckForImpliedValues)
     ImpliedValue::checkForImpliedValues(solver->solver, e, value);
 
   ImpliedValueList results;
   ImpliedValue::getImpliedValues(e, value, results);
-  for (ImpliedValueList::iterator it = results.begin(), ie = results.end();
-       it != ie; ++it) {
-    ReadExpr *re = it->first.get();
-    
-    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
-      // FIXME: This is the sole remaining usage of the Array object
-      // variable. Kill me.
-      const MemoryObject *mo = 0; //re->updates.root->object;
-      const ObjectState *os = state.addressSpace.findObject(mo);
+  if (results.empty())
+    return;
 
-      if (!os) {
-        // object has been free'd, no need to concretize (although as
-        // in other cases we would like to concretize the outstanding
-        // reads, but we have no facility for that yet)
-      } else {
-        assert(!os->readOnly && 
-               "not possible? read only object with static read?");
-        ObjectState *wos = state.addressSpace.getWriteable(mo, os);
-        wos->write(CE, KValue(it->second));
-      }
+  // Group the values by array. Only reads of the symbolic array itself at
+  // constant indices tell the initial contents of an object, writes at
+  // other constant indices on the way do not matter.
+  std::map<const Array *, std::vector<std::pair<unsigned, uint8_t> > > values;
+  for (const auto &result : results) {
+    const ReadExpr *re = result.first.get();
+    const ConstantExpr *index = dyn_cast<ConstantExpr>(re->index);
+    if (!index || !re->updates.root->isSymbolicArray() ||
+        result.second->getWidth() != Expr::Int8)
+      continue;
+    const UpdateNode *un = re->updates.head;
+    for (; un; un = un->next) {
+      const ConstantExpr *written = dyn_cast<ConstantExpr>(un->index);
+      if (!written || written->getZExtValue() == index->getZExtValue())
+        break;
     }
+    if (!un)
+      values[re->updates.root].emplace_back(index->getZExtValue(),
+                                            result.second->getZExtValue(8));
+  }
+
+  for (const auto &symbolic : state.symbolics) {
+    auto it = values.find(symbolic.getArray());
+    if (it == values.end())
+      continue;
+    const MemoryObject *mo = symbolic.getObject();
+    const ObjectState *os = state.addressSpace.findObject(mo);
+    // a freed object has nothing left to concretize
+    if (os && !os->readOnly) {
+      std::sort(it->second.begin(), it->second.end());
+      ObjectState *wos = state.addressSpace.getWriteable(mo, os);
+      wos->concretizeArrayBytes(it->first, it->second);
+    }
+    values.erase(it);
+    if (values.empty())
+      break;
   }
 }
 
@@ -4800,6 +7366,13 @@ int *Executor::getErrnoLocation(const ExecutionState &state) const {
 void Executor::dumpPTree() {
   if (!::dumpPTree) return;
 
+  // the log is kept current instead of writing out the whole tree
+  if (ptreeLog) {
+    ptreeLog->flush();
+    ::dumpPTree = 0;
+    return;
+  }
+
   char name[32];
   snprintf(name, sizeof(name),"ptree%08d.dot", (int) stats::instructions);
   auto os = interpreterHandler->openOutputFile(name);
@@ -4857,6 +7430,95 @@ void Executor::dumpStates() {
   ::dumpStates = 0;
 }
 
+void Executor::dumpMemoryProfile() {
+  if (!DumpMemoryProfile)
+    return;
+
+  struct SiteProfile {
+    uint64_t bytes = 0, objects = 0, copies = 0, updates = 0;
+  };
+  struct StateProfile {
+    const ExecutionState *state;
+    uint64_t ownedBytes = 0, ownedObjects = 0, updates = 0;
+  };
+  std::unordered_map<const llvm::Value *, SiteProfile> sites;
+  std::vector<StateProfile> stateProfiles;
+  // object states shared by several address spaces count once for a site
+  std::unordered_set<const ObjectState *> seen;
+  std::unordered_set<const MemoryObject *> seenObjects;
+
+  for (const ExecutionState *es : states) {
+    if (suspendedStates.count(const_cast<ExecutionState *>(es)) ||
+        compactedStates.count(const_cast<ExecutionState *>(es)))
+      continue;
+    StateProfile sp;
+    sp.state = es;
+    for (const auto &object : es->addressSpace.objects) {
+      const MemoryObject *mo = object.first;
+      const ObjectState *os = object.second;
+      unsigned updates = os->getUpdateListLength();
+      if (es->addressSpace.owns(os)) {
+        sp.ownedBytes += os->getContentsBytes();
+        ++sp.ownedObjects;
+        sp.updates += updates;
+      }
+      if (!seen.insert(os).second)
+        continue;
+      SiteProfile &site = sites[mo->allocSite];
+      site.bytes += os->getContentsBytes();
+      site.updates += updates;
+      if (seenObjects.insert(mo).second)
+        ++site.objects;
+      else
+        ++site.copies;
+    }
+    stateProfiles.push_back(sp);
+  }
+
+  auto os = interpreterHandler->openOutputFile("memory-profile.txt");
+  if (!os)
+    return;
+
+  std::vector<std::pair<const llvm::Value *, SiteProfile> > sorted(
+      sites.begin(), sites.end());
+  std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
+    return a.second.bytes > b.second.bytes;
+  });
+  *os << "# heap: " << util::GetTotalMallocUsage() << " bytes ("
+      << util::GetMallocImplementation() << "), " << Expr::count
+      << " expressions alive\n\n";
+  *os << "# object states by allocation site, " << ObjectState::liveObjectStates
+      << " alive\n"
+      << "# bytes objects copies updates site\n";
+  for (const auto &entry : sorted) {
+    const SiteProfile &site = entry.second;
+    *os << site.bytes << " " << site.objects << " " << site.copies << " "
+        << site.updates << " ";
+    const llvm::Value *allocSite = entry.first;
+    if (!allocSite) {
+      *os << "(unknown)";
+    } else if (const Instruction *i = dyn_cast<Instruction>(allocSite)) {
+      const InstructionInfo &ii = kmodule->infos->getInfo(*i);
+      *os << i->getParent()->getParent()->getName() << " " << ii.file << ":"
+          << ii.line;
+    } else {
+      *os << "global:" << allocSite->getName();
+    }
+    *os << "\n";
+  }
+
+  std::sort(stateProfiles.begin(), stateProfiles.end(),
+            [](const StateProfile &a, const StateProfile &b) {
+              return a.ownedBytes > b.ownedBytes;
+            });
+  *os << "\n# states by the bytes of the object states they do not share\n"
+      << "# bytes objects updates constraints depth state\n";
+  for (const StateProfile &sp : stateProfiles)
+    *os << sp.ownedBytes << " " << sp.ownedObjects << " " << sp.updates << " "
+        << sp.state->constraints.size() << " " << sp.state->depth << " "
+        << sp.state << "\n";
+}
+
 static std::tuple<std::string, unsigned, unsigned>
 parseNondetName(const std::string& name) {
     std::string fun;
@@ -4932,43 +7594,45 @@ void Executor::setReplayNondet(const struct KTest *out) {
   assert(out && "No ktest file given");
   assert(!replayPath && !replayKTest && "cannot replay both nondets and path");
 
-  replayNondet.reserve(out->numObjects);
+  // the values are listed once complete, in the order of the path
+  const std::tuple<std::string, unsigned, unsigned> *lastSite = nullptr;
+  ConcreteValue *last = nullptr;
+  auto printLast = [&]() {
+    if (!last)
+      return;
+    const char *fun = std::get<0>(*lastSite).c_str();
+    unsigned line = std::get<1>(*lastSite), col = std::get<2>(*lastSite);
+    if (last->isPointer()) {
+      klee_message("Input vector: %s:%u:%u = (%lu:%lu)", fun, line, col,
+                   last->getPointer().getZExtValue(),
+                   last->getValue().getZExtValue());
+    } else {
+      klee_message("Input vector: %s:%u:%u = %lu", fun, line, col,
+                   last->getValue().getZExtValue());
+    }
+  };
 
   for (unsigned i = 0; i < out->numObjects; ++i) {
       std::string name = out->objects[i].name;
-      std::string fun;
-      unsigned line, col;
-      std::tie(fun, line, col) = parseNondetName(name);
-
       auto val = getConcreteValue(out->objects[i].numBytes,
                                   out->objects[i].bytes);
 
       if (name.size() > 8 && name.compare(name.size() - 8, 8, "(offset)") == 0 ) {
         // this is an offset of previous nondet pointer,
         // so instead of creating a new record, just update the previous one
-        auto& lastNv = replayNondet.back();
-        auto& concreteVal = std::get<3>(lastNv);
-        concreteVal.setPointer(std::move(concreteVal.getValue()));
-        concreteVal.setValue(std::move(val.getValue()));
+        assert(last && "offset without a nondet pointer");
+        last->setPointer(std::move(last->getValue()));
+        last->setValue(std::move(val.getValue()));
       } else {
-        replayNondet.emplace_back(std::move(fun), line, col, std::move(val));
+        printLast();
+        auto site = replayNondetSites.insert(
+            std::make_pair(parseNondetName(name), ReplayNondetSite())).first;
+        site->second.values.push_back(std::move(val));
+        lastSite = &site->first;
+        last = &site->second.values.back();
       }
   }
-
-  for (auto& nv : replayNondet) {
-    auto& val = std::get<3>(nv);
-    if (val.isPointer()) {
-      klee_message("Input vector: %s:%u:%u = (%lu:%lu)",
-                    std::get<0>(nv).c_str(), std::get<1>(nv),
-                    std::get<2>(nv),
-                    val.getPointer().getZExtValue(),
-                    val.getValue().getZExtValue());
-    } else {
-      klee_message("Input vector: %s:%u:%u = %lu",
-                    std::get<0>(nv).c_str(), std::get<1>(nv),
-                    std::get<2>(nv), val.getValue().getZExtValue());
-    }
-  }
+  printLast();
 }
 
 ///
@@ -20,6 +20,7 @@
 #include "klee/Internal/Module/Cell.h"
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/Support/Timer.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/Interpreter.h"
 
@@ -27,11 +28,15 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include "../Expr/ArrayExprOptimizer.h"
+#include "TimingSolver.h"
 
+#include <deque>
 #include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 struct KTest;
@@ -46,6 +51,7 @@ namespace llvm {
   class GlobalValue;
   class Instruction;
   class LLVMContext;
+  class Loop;
   class DataLayout;
   class Twine;
   class Value;
@@ -53,24 +59,36 @@ namespace llvm {
 
 namespace klee {  
   class Array;
+  class Assignment;
+  class CallMemoizer;
   struct Cell;
+  class CheckpointLog;
+  class ErrorReachability;
+  class EventTrace;
+  class PTreeLog;
   class ExecutionState;
   class ExternalDispatcher;
+  class FunctionSummarizer;
+  class NativeCoverage;
   class Expr;
+  struct InstructionInfo;
   class InstructionInfoTable;
   struct KFunction;
   struct KInstruction;
   class KInstIterator;
   class KModule;
+  struct LoopSummary;
   class MemoryManager;
   class MemoryObject;
   class ObjectState;
   class PTree;
+  class ResumeTree;
   class Searcher;
   class SeedInfo;
   class SpecialFunctionHandler;
   struct StackFrame;
   class StatsTracker;
+  class SubsumptionTable;
   class TimingSolver;
   class TreeStreamWriter;
   class MergeHandler;
@@ -114,6 +132,19 @@ public:
 private:
   static const char *TerminateReasonNames[];
 
+  /// Library functions that executeNativeFunction knows.
+  enum class NativeFunction {
+    Memcpy,
+    Memmove,
+    Memset,
+    Strlen,
+    Strcmp,
+    Strncmp,
+    Strchr,
+    Strcpy,
+    Strncpy
+  };
+
   std::unique_ptr<KModule> kmodule;
   InterpreterHandler *interpreterHandler;
   Searcher *searcher;
@@ -121,8 +152,27 @@ private:
   ExternalDispatcher *externalDispatcher;
   TimingSolver *solver;
   MemoryManager *memory;
-  std::set<ExecutionState*> states;
+  std::unordered_set<ExecutionState *> states;
   StatsTracker *statsTracker;
+  std::unique_ptr<EventTrace> eventTrace;
+  std::unique_ptr<PTreeLog> ptreeLog;
+  /// The results of the calls cached with -memoize-calls.
+  std::unique_ptr<CallMemoizer> callMemoizer;
+  /// The summaries of the functions explored with -summarize-functions.
+  std::unique_ptr<FunctionSummarizer> functionSummarizer;
+  /// The tests run natively with -native-coverage-command.
+  std::unique_ptr<NativeCoverage> nativeCoverage;
+  /// The loops analyzed for -summarize-loops, null if they can not be
+  /// summarized.
+  std::map<const llvm::Loop *, std::unique_ptr<LoopSummary>> loopSummaries;
+  /// The forks and terminations logged with -checkpoint-interval.
+  std::unique_ptr<CheckpointLog> checkpointLog;
+  /// The forks of the -resume-from checkpoint not replayed yet.
+  std::unique_ptr<ResumeTree> resumeTree;
+  std::uint64_t nextCheckpointId = 2;
+  /// Which instructions may still reach an error site, with
+  /// -prune-unreachable-errors.
+  std::unique_ptr<ErrorReachability> errorReachability;
   TreeStreamWriter *pathWriter, *symPathWriter;
   SpecialFunctionHandler *specialFunctionHandler;
   TimerGroup timers;
@@ -138,6 +188,42 @@ private:
   /// waiting to be merged in a klee_close_merge instruction
   std::set<ExecutionState *> inCloseMerge;
 
+  /// States suspended to disk when over the memory cap (see
+  /// -max-memory-suspend), with the files holding their contents. They
+  /// stay in \ref states but are paused from scheduling.
+  std::map<ExecutionState *, std::string> suspendedStates;
+
+  /// States left unscheduled for long (see -compact-states-after), with
+  /// the buffers their contents were moved to. They stay scheduled, and
+  /// are expanded once selected or needed otherwise.
+  std::map<ExecutionState *, std::string> compactedStates;
+
+  /// The instruction count at which compactStates() runs next.
+  uint64_t nextCompaction = 0;
+
+  /// States whose decisive query timed out (see -adaptive-solver-timeout),
+  /// paused until no other state can run.
+  std::deque<ExecutionState *> deferredStates;
+
+  /// The deferred state resumed last, which gets a single attempt with the
+  /// full timeout at the query it was deferred at.
+  ExecutionState *retriedState = nullptr;
+
+  /// Fingerprints of the states seen at block entries (see -dedup-states),
+  /// mapped to the state that recorded them first.
+  std::unordered_map<uint64_t, const ExecutionState *> visitedFingerprints;
+
+  /// The interpolants of the explored subtrees (see -subsume-states),
+  /// shared with the nodes that add to it once they are closed.
+  std::shared_ptr<SubsumptionTable> subsumptionTable;
+
+  /// Number of values concretized at each instruction because their
+  /// expressions grew deeper than -max-expr-depth.
+  std::map<const KInstruction *, uint64_t> exprDepthConcretizations;
+
+  /// Value of Expr::allocations when the last instruction was stepped.
+  uint64_t exprAllocationsStepped = 0;
+
   /// Used to track states that have been added during the current
   /// instructions step. 
   /// \invariant \ref addedStates is a subset of \ref states. 
@@ -175,16 +261,34 @@ private:
   /// Mapping from function id's to their actual addresses
   std::map<uint64_t, llvm::Function *> legalFunctions;
 
+  /// The part of the initial address space set up by initializeGlobals,
+  /// kept across runFunctionAsMain calls with --reuse-globals-snapshot.
+  struct GlobalsSnapshot {
+    /// Unowned (or read-only) states shared copy-on-write by every run.
+    std::vector<std::pair<const MemoryObject *, ObjectHolder>> objects;
+    /// Concrete addresses of the objects, as (segment, address).
+    std::vector<std::pair<uint64_t, uint64_t>> concreteAddresses;
+  };
+  std::unique_ptr<GlobalsSnapshot> globalsSnapshot;
+
   /// When non-null the bindings that will be used for calls to
   /// klee_make_symbolic in order replay.
   const struct KTest *replayKTest;
 
-  // values for replaying nondet values -- for each object
-  // with a given name, line, col and sequence number we have
-  // a concrete value -- this is a sequence of the values
-  // as they appear on the path being replayed
-  std::vector<std::tuple<std::string, unsigned, unsigned,
-                         ConcreteValue>> replayNondet;
+  /// The nondet values to replay at one call site, in the order they
+  /// appear on the path being replayed (see --replay-nondets).
+  struct ReplayNondetSite {
+    std::vector<ConcreteValue> values;
+    /// The index of the value the next call gets.
+    size_t next = 0;
+  };
+  /// The values to replay by nondet function name, line and column.
+  std::map<std::tuple<std::string, unsigned, unsigned>, ReplayNondetSite>
+      replayNondetSites;
+  /// The site of each call replayed so far, or null if it has none, so
+  /// that a call matches its name and location only the first time.
+  std::unordered_map<const KInstruction *, ReplayNondetSite *>
+      replayNondetCalls;
 
   /// When non-null a list of branch decisions to be used for replay.
   const std::vector<bool> *replayPath;
@@ -201,6 +305,10 @@ private:
   /// needed to control memory usage. \see fork()
   bool atMemoryLimit;
 
+  /// Set on each timer tick, the memory usage is only measured then.
+  /// \see checkMemoryUsage()
+  bool memoryCheckDue = false;
+
   /// Disables forking, set by client. \see setInhibitForking()
   bool inhibitForking;
 
@@ -212,16 +320,55 @@ private:
   /// false, it is buggy (it needs to validate its writes).
   bool ivcEnabled;
 
+  /// Forks and microseconds of solving spent deciding branches, by the
+  /// InstructionInfo id of the forking instruction. Only kept while one
+  /// of the -max-static-*-pct limits is set.
+  std::vector<uint64_t> staticForks, staticSolveTime;
+
+  /// The -max-static-*-pct limits as absolute values, computed from the
+  /// totals on each timer tick, so forking does not look them up.
+  uint64_t staticForkLimit = UINT64_MAX, staticSolveLimit = UINT64_MAX;
+  uint64_t staticCPForkLimit = UINT64_MAX, staticCPSolveLimit = UINT64_MAX;
+
   /// The maximum time to allow for a single core solver query.
   /// (e.g. for a single STP query)
   time::Span coreSolverTimeout;
 
+  /// The budgets of the attempts at a query, within coreSolverTimeout.
+  SolverTimeoutPolicy timeoutPolicy;
+
   /// Maximum time to allow for a single instruction.
   time::Span maxInstructionTime;
 
   /// Assumes ownership of the created array objects
   ArrayCache arrayCache;
 
+  /// Array holding the symbolic addresses of objects whose pointers are
+  /// compared across segments, one pointer-sized slot per object.
+  const Array *addressLayoutArray = nullptr;
+
+  /// Symbolic addresses handed out so far, keyed by segment.
+  std::unordered_map<uint64_t, ref<Expr> > symbolicAddresses;
+
+  /// Library functions defined in the module whose calls are executed
+  /// natively where possible, see executeNativeFunction.
+  std::unordered_map<const llvm::Function *, NativeFunction> nativeFunctions;
+
+  /// The functions executeCall() singles out by name, or null if the
+  /// module has none of that name, so that calls compare pointers.
+  llvm::Function *errorFunction = nullptr;
+  llvm::Function *instrFailFunction = nullptr;
+  llvm::Function *nonterminationCheckFunction = nullptr;
+  llvm::Function *nonterminationHeaderFunction = nullptr;
+
+  /// The instruction infos by id, to find the lines of the instructions
+  /// covered by a state. Built on first use.
+  std::vector<const InstructionInfo *> instructionInfosById;
+
+  /// \return The purpose of the query deciding a branch on \a condition,
+  /// which compares pointers if it reads their symbolic addresses.
+  QueryPurpose getBranchPurpose(ref<Expr> condition) const;
+
   /// File to print executed instructions to
   std::unique_ptr<llvm::raw_ostream> debugInstFile;
 
@@ -234,10 +381,12 @@ private:
   /// Optimizes expressions
   ExprOptimizer optimizer;
 
-  llvm::Function* getTargetFunction(llvm::Value *calledVal,
-                                    ExecutionState &state);
+  llvm::Function* getTargetFunction(llvm::Value *calledVal);
 
   void executeInstruction(ExecutionState &state, KInstruction *ki);
+  /// Execute the integer vector operation \a ki lane by lane, see
+  /// KInstruction::lanes.
+  void executeVectorInstruction(ExecutionState &state, KInstruction *ki);
 
   void run(ExecutionState &initialState);
 
@@ -251,17 +400,46 @@ private:
 			      unsigned offset);
   void initializeGlobals(ExecutionState &state);
 
+  /// Return the real address backing \a mo in \a state, allocating (and
+  /// binding) it on first use. Objects get real memory only when they are
+  /// passed to external code.
+  uint64_t getConcreteAddress(ExecutionState &state, const MemoryObject *mo);
+
+  /// Record the objects that initializeGlobals bound in \a state beyond
+  /// those in \a before, and bind them in later states with
+  /// restoreGlobalsSnapshot instead of initializing the globals again.
+  void takeGlobalsSnapshot(const ExecutionState &state,
+                           const MemoryMap &before);
+  void restoreGlobalsSnapshot(ExecutionState &state);
+
   void stepInstruction(ExecutionState &state);
   void updateStates(ExecutionState *current);
   void transferToBasicBlock(llvm::BasicBlock *dst, 
 			    llvm::BasicBlock *src,
 			    ExecutionState &state);
 
+  /// Find the result of an earlier call of the undefined function
+  /// \a function with the same \a arguments, with -external-calls=pure.
+  bool lookupPureCall(ExecutionState &state, llvm::Function *function,
+                      const std::vector<Cell> &arguments, KValue &result);
+  /// Record the call of the undefined function \a function returning
+  /// \a result, constraining it to the results of the earlier calls whose
+  /// arguments may be equal.
+  void recordPureCall(ExecutionState &state, llvm::Function *function,
+                      const std::vector<Cell> &arguments,
+                      const KValue &result);
+
   void callExternalFunction(ExecutionState &state,
                             KInstruction *target,
                             llvm::Function *function,
                             const std::vector<Cell> &arguments);
 
+  /// With -summarize-functions, bind the result of the call of \a f from
+  /// its summary. Returns false if \a f is not summarized.
+  bool executeSummarizedCall(ExecutionState &state, KInstruction *ki,
+                             llvm::Function *f,
+                             const std::vector<Cell> &arguments);
+
   ObjectState *bindObjectInState(ExecutionState &state, const MemoryObject *mo,
                                  bool isLocal, const Array *array = 0);
 
@@ -334,12 +512,66 @@ private:
                    llvm::Function *f,
                    const std::vector<Cell> &arguments);
 
+  /// Resolve the \a length bytes at \a address if that needs no solver
+  /// query: a concrete pointer into an object of concrete size that holds
+  /// the whole range. \a offset is set to the offset into the object.
+  bool resolveConcreteRange(ExecutionState &state, const KValue &address,
+                            uint64_t length, ObjectPair &op,
+                            unsigned &offset);
+
+  /// Read the concrete string at \a address into \a result, without the
+  /// terminator, reading at most \a limit bytes and stopping after the
+  /// first byte equal to \a stop. Return false if that reads a symbolic
+  /// byte or leaves the object, see resolveConcreteRange.
+  bool readConcreteString(ExecutionState &state, const KValue &address,
+                          uint64_t limit, std::string &result,
+                          int stop = -1);
+
+  /// Compute the floating point instruction \a ki on concrete 32 or 64 bit
+  /// operands with the host floating point unit, see
+  /// -native-floating-point. Return false if it has to be emulated.
+  bool evalNativeFloat(ExecutionState &state, KInstruction *ki,
+                       ref<ConstantExpr> &result);
+
+  /// Execute a call of a library function natively on the object contents,
+  /// see -native-memory-functions and -native-string-functions. Return
+  /// false, without changing the state, if the call has to be interpreted
+  /// instead.
+  bool executeNativeFunction(ExecutionState &state, KInstruction *ki,
+                             NativeFunction function,
+                             const std::vector<Cell> &arguments);
+
   void executeMemoryRead(ExecutionState &state,
                          const KValue &address,
                          KInstruction *target);
   void executeMemoryWrite(ExecutionState &state,
                           const KValue &address,
                           const KValue &value);
+  /// Check that an access to a resolved object is in bounds, i.e. that
+  /// both \a isEqualSegment and \a isOffsetInBounds must be true.
+  /// Constant conditions are folded, the rest is asked using a single
+  /// query unless --combined-bounds-check=false.
+  ///
+  /// \return false iff the solver failed (timed out).
+  bool checkBounds(ExecutionState &state, ref<Expr> isEqualSegment,
+                   ref<Expr> isOffsetInBounds, bool &inBounds);
+
+  /// Ask \a query, which takes the time it may use, within the budgets the
+  /// timeout policy gives a query of the given \a purpose, retrying it
+  /// while it times out.
+  ///
+  /// \return false iff the solver failed at every attempt.
+  template <typename Query>
+  bool solveWithBudget(const ExecutionState &state,
+                       SolverTimeoutPolicy::Purpose purpose, Query query);
+
+  /// Pause a state whose decisive query timed out so that it executes the
+  /// instruction again once no other state can run.
+  ///
+  /// \return false iff the state cannot be deferred and is to be
+  /// terminated.
+  bool deferState(ExecutionState &state);
+
   // do address resolution / object binding / out of bounds checking
   // and perform the operation
   void executeMemoryOperation(ExecutionState &state,
@@ -348,6 +580,15 @@ private:
                               KValue value, /* undef if read */
                               KInstruction *target /* undef if write */);
 
+  /// With -lazy-nondet-pointers, fork \a state at the first dereference of
+  /// a nondet pointer by \a address, accessing \a bytes bytes, into the
+  /// states in which the pointer is null, points to a fresh object, or
+  /// aliases one of the objects the pointers dereferenced earlier point
+  /// to. The states the access continues in are stored in \a result.
+  bool initializeLazyPointer(ExecutionState &state, const KValue &address,
+                             unsigned bytes, KInstruction *target,
+                             std::vector<ExecutionState *> &result);
+
   void executeMakeSymbolic(ExecutionState &state, const MemoryObject *mo,
                            const std::string &name);
 
@@ -363,11 +604,83 @@ private:
               const std::vector< ref<Expr> > &conditions,
               std::vector<ExecutionState*> &result);
 
+  /// Find which of the \a matches of a symbolic switch condition, the
+  /// cases followed by the default, may be true, asking for a value of
+  /// \a cond that avoids the targets found so far until there is none.
+  ///
+  /// \return false iff the solver failed or its models do not fix \a cond.
+  bool findSwitchTargets(ExecutionState &state, ref<Expr> cond,
+                         const std::vector<ref<Expr> > &caseValues,
+                         const std::vector<llvm::BasicBlock *> &successors,
+                         const std::vector<ref<Expr> > &matches,
+                         std::vector<bool> &feasible);
+
+  /// Evaluate e under the seed. Values the seed leaves free are taken from
+  /// \a model, a model of the state's constraints that is computed on first
+  /// use and can be shared by all the seeds of the state.
+  ref<ConstantExpr> evaluateSeed(const ExecutionState &state,
+                                 const SeedInfo &seed, ref<Expr> e,
+                                 std::shared_ptr<const Assignment> &model);
+
   // Fork current and return states in which condition holds / does
   // not hold, respectively. One of the states is necessarily the
   // current state, and one of the states may be null.
   StatePair fork(ExecutionState &current, ref<Expr> condition, bool isInternal);
 
+  /// A random number below \a n for a choice of \a state. With
+  /// InterpreterOptions::DeterministicPaths it only depends on the path of
+  /// the state and \a salt.
+  unsigned getRandom(const ExecutionState &state, unsigned n,
+                     unsigned salt = 0);
+
+  /// Patch the seeds of \a state for the constraints they violated since
+  /// they were last patched, see SeedInfo::unpatched.
+  void patchSeeds(ExecutionState &state, std::vector<SeedInfo> &seeds);
+
+  /// Evaluate \a condition under the assignments of \a seeds, noting
+  /// which sides they take. Return false if some seed does not fix it.
+  bool evaluateSeeds(const std::vector<SeedInfo> &seeds, ref<Expr> condition,
+                     bool &trueSeed, bool &falseSeed);
+
+  /// Check the branch condition -fast-seed-replay left unproven on \a
+  /// state and add it. Terminate the state and return false if the
+  /// branch is infeasible.
+  bool provePendingCondition(ExecutionState &state);
+
+  /// Whether the instruction \a current is forking at exceeds one of the
+  /// -max-static-*-pct limits, so the branch should be concretized.
+  bool exceedsStaticLimits(const ExecutionState &current) const;
+
+  /// Recompute the -max-static-*-pct limits from the current totals.
+  void updateStaticLimits();
+
+  /// Hand the tests written since the last call to -native-coverage-command
+  /// and count the lines the finished runs covered.
+  void collectNativeCoverage();
+
+  /// Give the states a fork of \a parent created their checkpoint ids,
+  /// the ones of the -resume-from checkpoint while replaying it, and log
+  /// the fork. \a children holds the states in the order of the branch
+  /// conditions, the first one of them may be the forking state itself.
+  void assignCheckpointIds(std::uint64_t parent,
+                           const std::vector<ExecutionState *> &children);
+
+  /// Restore the statistics and coverage of the -resume-from checkpoint.
+  void resumeCheckpoint();
+
+  /// With -prune-unreachable-errors, take the side of the conditional
+  /// branch \a bi that may still reach an error site without forking, or
+  /// terminate \a state if neither may. Return false if both may, so the
+  /// branch forks as usual.
+  bool takeReachingBranch(ExecutionState &state, llvm::BranchInst *bi,
+                          ref<Expr> condition);
+
+  // Fork current on the conjunction of a segment and an offset condition,
+  // e.g. of a KValue comparison. Decided parts never reach the solver and
+  // a branch whose true side is infeasible costs a single query.
+  StatePair fork(ExecutionState &current, ref<Expr> segmentCondition,
+                 ref<Expr> offsetCondition, bool isInternal);
+
   /// Add the given (boolean) condition as a constraint on state. This
   /// function is a wrapper around the state's addConstraint function
   /// which also manages propagation of implied values,
@@ -387,20 +700,19 @@ private:
   const Cell& eval(KInstruction *ki, unsigned index, 
                    ExecutionState &state) const;
 
-  Cell& getArgumentCell(ExecutionState &state,
-                        KFunction *kf,
-                        unsigned index) {
-    return state.stack.back().locals[kf->getArgRegister(index)];
-  }
-
-  Cell& getDestCell(ExecutionState &state,
-                    KInstruction *target) {
-    return state.stack.back().locals[target->dest];
-  }
-
   void bindLocal(KInstruction *target,
                  ExecutionState &state,
-                 const KValue &value);
+                 KValue value);
+
+  /// Concretize the parts of \a value whose expressions are deeper than
+  /// -max-expr-depth, blaming instruction \a ki for it, and return the
+  /// result. The value is returned unchanged if it is within the limit.
+  KValue capExprDepth(ExecutionState &state, KInstruction *ki,
+                      KValue value);
+
+  /// Print the instructions that concretized values most often because of
+  /// -max-expr-depth.
+  void reportExprDepthConcretizations();
   void bindArgument(KFunction *kf,
                     unsigned index,
                     ExecutionState &state,
@@ -418,6 +730,13 @@ private:
   KValue evalConstant(const llvm::Constant *c,
                       const KInstruction *ki = NULL);
 
+  /// Return the symbolic address of the given object, used to compare
+  /// pointers into different segments. The object is placed in the address
+  /// layout of the state on first use: its range is constrained to lie
+  /// between the ranges of its neighbours in segment order, which orders it
+  /// against all other placed objects.
+  ref<Expr> getSymbolicAddress(ExecutionState &state, const MemoryObject *mo);
+
   /// Return a unique constant value for the given expression in the
   /// given state, if it has one (i.e. it provably only has a single
   /// value). Otherwise return the original expression.
@@ -450,6 +769,32 @@ private:
   void pauseState(ExecutionState& state);
   // add state to searcher only
   void continueState(ExecutionState& state);
+  /// With -auto-merge-loops, open or close the merge region of a loop when
+  /// the state is about to enter or has just left it. Returns true if the
+  /// state was paused or merged and must not be stepped.
+  bool mergeAtLoopBoundary(ExecutionState &state);
+
+  /// With -summarize-loops, run the loop the state is about to enter in a
+  /// single step if it is a counting loop described by a LoopSummary.
+  /// Returns true if the state was moved to the exit of the loop.
+  bool summarizeLoop(ExecutionState &state);
+
+  /// Records the fingerprint of a state at a block entry and returns true
+  /// if another state has already entered a block with the same one.
+  bool isDuplicateState(const ExecutionState &state);
+
+  /// Returns true if the state is at a block entry where the constraints
+  /// imply the interpolant of an explored subtree, otherwise opens a new
+  /// subsumption node for it there if its constraints changed.
+  bool isSubsumedState(ExecutionState &state);
+
+  /// Whether the instruction only computes on registers of the state, which
+  /// are all concrete, so that it can neither fork nor fail.
+  bool isConcreteLocal(ExecutionState &state, KInstruction *ki) const;
+  /// With -concrete-fast-path, execute the instructions following \p last
+  /// in its basic block for as long as isConcreteLocal holds for them,
+  /// without going back to the searcher.
+  void executeConcreteRun(ExecutionState &state, KInstruction *last);
   // remove state from queue and delete
   void terminateState(ExecutionState &state);
   // call exit handler and terminate state
@@ -478,7 +823,8 @@ private:
   void computeOffsets(KGEPInstruction *kgepi, TypeIt ib, TypeIt ie);
 
   /// bindInstructionConstants - Initialize any necessary per instruction
-  /// constant values.
+  /// constant values, and the result width and direct callee of the
+  /// instruction.
   void bindInstructionConstants(KInstruction *KI);
 
   void doImpliedValueConcretization(ExecutionState &state,
@@ -489,12 +835,33 @@ private:
   getReachableMemoryObjects(ExecutionState &state);
 
   void checkMemoryUsage();
+
+  /// Suspend up to \p count randomly chosen states, see suspendState().
+  void suspendStates(unsigned count);
+
+  /// Move the contents of a state to a file in the output directory and
+  /// pause it, so that its memory can be reused until resumeState().
+  void suspendState(ExecutionState &state);
+  void resumeState(ExecutionState &state);
+
+  /// Compact the states not selected for -compact-states-after
+  /// instructions, see compactState().
+  void compactStates();
+
+  /// Move the contents of a state to a buffer in memory, as suspendState()
+  /// does to a file. The expressions shared within the state are written
+  /// once.
+  void compactState(ExecutionState &state);
+
+  /// Read back the contents of a compacted state, if it is one.
+  void expandState(ExecutionState &state);
   void printDebugInstructions(ExecutionState &state);
   void doDumpStates();
 
   /// Only for debug purposes; enable via debugger or klee-control
   void dumpStates();
   void dumpPTree();
+  void dumpMemoryProfile();
 
 public:
   Executor(llvm::LLVMContext &ctx, const InterpreterOptions &opts,
@@ -549,6 +916,8 @@ public:
 
   unsigned getSymbolicPathStreamID(const ExecutionState &state) override;
 
+  uint64_t getPathId(const ExecutionState &state) override;
+
   void getConstraintLog(const ExecutionState &state, std::string &res,
                         Interpreter::LogType logFormat =
                             Interpreter::STP) override;
@@ -17,7 +17,6 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
-#include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/raw_ostream.h"
@@ -25,6 +24,10 @@
 
 #include <csetjmp>
 #include <csignal>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 using namespace llvm;
 using namespace klee;
@@ -44,14 +47,39 @@ namespace klee {
 
 class ExternalDispatcherImpl {
 private:
-  typedef std::map<const llvm::Instruction *, llvm::Function *> dispatchers_ty;
+  /// Native entry point of a compiled dispatcher, null if the target
+  /// could not be resolved.
+  typedef void (*DispatcherFn)();
+
+  /// Dispatchers by call site, in front of the signature cache.
+  typedef std::map<const llvm::Instruction *, DispatcherFn> dispatchers_ty;
   dispatchers_ty dispatchers;
-  llvm::Function *createDispatcher(llvm::Function *f, llvm::Instruction *i,
+
+  /// Dispatchers by target and the types its arguments are passed as, so
+  /// all call sites of a function with the same signature share one stub
+  /// and one JIT'ed module.
+  typedef std::map<std::pair<llvm::Function *, llvm::FunctionType *>,
+                   DispatcherFn>
+      signatures_ty;
+  signatures_ty signatures;
+
+  llvm::FunctionType *getCallType(llvm::Function *f, llvm::Instruction *i);
+  DispatcherFn compileDispatcher(llvm::Function *f, llvm::FunctionType *callTy);
+  llvm::Function *createDispatcher(llvm::Function *f,
+                                   llvm::FunctionType *callTy,
                                    llvm::Module *module);
   llvm::ExecutionEngine *executionEngine;
   LLVMContext &ctx;
   std::map<std::string, void *> preboundFunctions;
-  bool runProtectedCall(llvm::Function *f, uint64_t *args);
+  DispatcherFn getDispatcher(llvm::Function *f, llvm::Instruction *i);
+  bool runProtectedCall(DispatcherFn f, uint64_t *args);
+  bool runIsolatedCall(DispatcherFn f, uint64_t *args,
+                       const ExternalDispatcher::MemoryRanges &transfer);
+
+  /// Memory shared with the helper processes of isolated calls, kept and
+  /// grown as needed.
+  void *sharedBuffer;
+  size_t sharedSize;
   llvm::Module *singleDispatchModule;
   std::vector<std::string> moduleIDs;
   std::string &getFreshModuleID();
@@ -62,6 +90,9 @@ public:
   ~ExternalDispatcherImpl();
   bool executeCall(llvm::Function *function, llvm::Instruction *i,
                    uint64_t *args);
+  bool executeIsolatedCall(llvm::Function *function, llvm::Instruction *i,
+                           uint64_t *args,
+                           const ExternalDispatcher::MemoryRanges &transfer);
   void *resolveSymbol(const std::string &name);
   int getLastErrno();
   void setLastErrno(int newErrno);
@@ -108,7 +139,7 @@ void *ExternalDispatcherImpl::resolveSymbol(const std::string &name) {
 }
 
 ExternalDispatcherImpl::ExternalDispatcherImpl(LLVMContext &ctx)
-    : ctx(ctx), lastErrno(0) {
+    : ctx(ctx), sharedBuffer(nullptr), sharedSize(0), lastErrno(0) {
   std::string error;
   singleDispatchModule = new Module(getFreshModuleID(), ctx);
   // The MCJIT JITs whole modules at a time rather than individual functions
@@ -149,6 +180,8 @@ ExternalDispatcherImpl::ExternalDispatcherImpl(LLVMContext &ctx)
 }
 
 ExternalDispatcherImpl::~ExternalDispatcherImpl() {
+  if (sharedBuffer)
+    munmap(sharedBuffer, sharedSize);
   delete executionEngine;
   // NOTE: the `executionEngine` owns all modules so
   // we don't need to delete any of them.
@@ -156,13 +189,63 @@ ExternalDispatcherImpl::~ExternalDispatcherImpl() {
 
 bool ExternalDispatcherImpl::executeCall(Function *f, Instruction *i,
                                          uint64_t *args) {
+  return runProtectedCall(getDispatcher(f, i), args);
+}
+
+bool ExternalDispatcherImpl::executeIsolatedCall(
+    Function *f, Instruction *i, uint64_t *args,
+    const ExternalDispatcher::MemoryRanges &transfer) {
+  return runIsolatedCall(getDispatcher(f, i), args, transfer);
+}
+
+ExternalDispatcherImpl::DispatcherFn
+ExternalDispatcherImpl::getDispatcher(Function *f, Instruction *i) {
   dispatchers_ty::iterator it = dispatchers.find(i);
   if (it != dispatchers.end()) {
     // Code already JIT'ed for this
-    return runProtectedCall(it->second, args);
+    return it->second;
+  }
+
+  // Compile a dispatcher unless one for the same signature exists.
+  FunctionType *callTy = getCallType(f, i);
+  auto sig = signatures.insert(std::make_pair(std::make_pair(f, callTy),
+                                              DispatcherFn()));
+  if (sig.second)
+    sig.first->second = compileDispatcher(f, callTy);
+  DispatcherFn dispatcher = sig.first->second;
+  dispatchers.insert(std::make_pair(i, dispatcher));
+  return dispatcher;
+}
+
+FunctionType *ExternalDispatcherImpl::getCallType(Function *f,
+                                                  Instruction *i) {
+  CallSite cs;
+  if (i->getOpcode() == Instruction::Call) {
+    cs = CallSite(cast<CallInst>(i));
+  } else {
+    cs = CallSite(cast<InvokeInst>(i));
   }
 
-  // Code for this not JIT'ed. Do this now.
+  // Get the target function type.
+  FunctionType *FTy =
+      cast<FunctionType>(cast<PointerType>(f->getType())->getElementType());
+
+  // Determine the types the arguments will be passed as. This accommodates
+  // for the corresponding code in Executor.cpp for handling calls to
+  // bitcasted functions.
+  std::vector<Type *> argTys;
+  argTys.reserve(cs.arg_size());
+  unsigned n = 0;
+  for (CallSite::arg_iterator ai = cs.arg_begin(), ae = cs.arg_end(); ai != ae;
+       ++ai, ++n)
+    argTys.push_back(n < FTy->getNumParams() ? FTy->getParamType(n)
+                                             : (*ai)->getType());
+  // function types are uniqued, so the pointer identifies the signature
+  return FunctionType::get(FTy->getReturnType(), argTys, false);
+}
+
+ExternalDispatcherImpl::DispatcherFn
+ExternalDispatcherImpl::compileDispatcher(Function *f, FunctionType *callTy) {
   Function *dispatcher;
 #ifdef WINDOWS
   std::map<std::string, void *>::iterator it2 =
@@ -178,45 +261,43 @@ bool ExternalDispatcherImpl::executeCall(Function *f, Instruction *i,
 #endif
 
   Module *dispatchModule = NULL;
-  // The MCJIT generates whole modules at a time so for every call that we
-  // haven't made before we need to create a new Module.
+  // The MCJIT generates whole modules at a time so for every signature that
+  // we haven't called before we need to create a new Module.
   dispatchModule = new Module(getFreshModuleID(), ctx);
-  dispatcher = createDispatcher(f, i, dispatchModule);
-  dispatchers.insert(std::make_pair(i, dispatcher));
+  dispatcher = createDispatcher(f, callTy, dispatchModule);
+
+  if (!dispatcher) {
+    // MCJIT didn't take ownership of the module so delete it.
+    delete dispatchModule;
+    return nullptr;
+  }
 
   // Force the JIT execution engine to go ahead and build the function. This
   // ensures that any errors or assertions in the compilation process will
   // trigger crashes instead of being caught as aborts in the external
   // function.
-  if (dispatcher) {
-    // The dispatchModule is now ready so tell MCJIT to generate the code for
-    // it.
-    auto dispatchModuleUniq = std::unique_ptr<Module>(dispatchModule);
-    executionEngine->addModule(
-        std::move(dispatchModuleUniq)); // MCJIT takes ownership
-    // Force code generation
-    uint64_t fnAddr =
-        executionEngine->getFunctionAddress(dispatcher->getName());
-    executionEngine->finalizeObject();
-    assert(fnAddr && "failed to get function address");
-    (void)fnAddr;
-  } else {
-    // MCJIT didn't take ownership of the module so delete it.
-    delete dispatchModule;
-  }
-  return runProtectedCall(dispatcher, args);
+  // The dispatchModule is now ready so tell MCJIT to generate the code for
+  // it.
+  auto dispatchModuleUniq = std::unique_ptr<Module>(dispatchModule);
+  executionEngine->addModule(
+      std::move(dispatchModuleUniq)); // MCJIT takes ownership
+  // Force code generation
+  uint64_t fnAddr =
+      executionEngine->getFunctionAddress(dispatcher->getName());
+  executionEngine->finalizeObject();
+  assert(fnAddr && "failed to get function address");
+  return reinterpret_cast<DispatcherFn>(fnAddr);
 }
 
 // FIXME: This is not reentrant.
 static uint64_t *gTheArgsP;
-bool ExternalDispatcherImpl::runProtectedCall(Function *f, uint64_t *args) {
+bool ExternalDispatcherImpl::runProtectedCall(DispatcherFn f, uint64_t *args) {
   struct sigaction segvAction, segvActionOld;
   bool res;
 
   if (!f)
     return false;
 
-  std::vector<GenericValue> gvArgs;
   gTheArgsP = args;
 
   segvAction.sa_handler = nullptr;
@@ -230,7 +311,9 @@ bool ExternalDispatcherImpl::runProtectedCall(Function *f, uint64_t *args) {
     res = false;
   } else {
     errno = lastErrno;
-    executionEngine->runFunction(f, gvArgs);
+    // the dispatcher is a nullary void function, no need to go through
+    // runFunction and its lookup of the compiled code on every call
+    f();
     // Explicitly acquire errno information
     lastErrno = errno;
     res = true;
@@ -240,6 +323,88 @@ bool ExternalDispatcherImpl::runProtectedCall(Function *f, uint64_t *args) {
   return res;
 }
 
+namespace {
+/// Head of the memory shared with the helper of an isolated call, followed
+/// by the contents of the transferred ranges.
+struct IsolatedCallResult {
+  /// Set by the helper once the call returned.
+  int completed;
+  int error;
+  /// The result, written by the dispatcher into args[0] and args[1].
+  uint64_t result[2];
+};
+} // namespace
+
+bool ExternalDispatcherImpl::runIsolatedCall(
+    DispatcherFn f, uint64_t *args,
+    const ExternalDispatcher::MemoryRanges &transfer) {
+  if (!f)
+    return false;
+
+  size_t size = sizeof(IsolatedCallResult);
+  for (const auto &range : transfer)
+    size += range.second;
+  if (size > sharedSize) {
+    if (sharedBuffer)
+      munmap(sharedBuffer, sharedSize);
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    sharedSize = (size + pageSize - 1) / pageSize * pageSize;
+    sharedBuffer = mmap(nullptr, sharedSize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (sharedBuffer == MAP_FAILED) {
+      sharedBuffer = nullptr;
+      sharedSize = 0;
+      return false;
+    }
+  }
+
+  auto *shared = static_cast<IsolatedCallResult *>(sharedBuffer);
+  shared->completed = 0;
+  gTheArgsP = args;
+
+  // flush pending output so the helper does not write it a second time
+  fflush(nullptr);
+  pid_t pid = fork();
+  if (pid < 0)
+    return false;
+
+  if (pid == 0) {
+    // a crash only ends the helper
+    signal(SIGSEGV, SIG_DFL);
+    signal(SIGBUS, SIG_DFL);
+    errno = lastErrno;
+    f();
+    shared->error = errno;
+    shared->result[0] = args[0];
+    shared->result[1] = args[1];
+    char *out = reinterpret_cast<char *>(shared + 1);
+    for (const auto &range : transfer) {
+      memcpy(out, range.first, range.second);
+      out += range.second;
+    }
+    fflush(nullptr);
+    shared->completed = 1;
+    _exit(0);
+  }
+
+  int status;
+  while (waitpid(pid, &status, 0) < 0)
+    if (errno != EINTR)
+      return false;
+  if (!WIFEXITED(status) || !shared->completed)
+    return false;
+
+  lastErrno = shared->error;
+  args[0] = shared->result[0];
+  args[1] = shared->result[1];
+  const char *in = reinterpret_cast<const char *>(shared + 1);
+  for (const auto &range : transfer) {
+    memcpy(range.first, in, range.second);
+    in += range.second;
+  }
+  return true;
+}
+
 // FIXME: This might have been relevant for the old JIT but the MCJIT
 // has a completly different implementation so this comment below is
 // likely irrelevant and misleading.
@@ -251,19 +416,12 @@ bool ExternalDispatcherImpl::runProtectedCall(Function *f, uint64_t *args) {
 // done, then the jit will end up generating a nullary stub just to call our
 // stub, for every single function call.
 Function *ExternalDispatcherImpl::createDispatcher(Function *target,
-                                                   Instruction *inst,
+                                                   FunctionType *callTy,
                                                    Module *module) {
   if (!resolveSymbol(target->getName()))
     return 0;
 
-  CallSite cs;
-  if (inst->getOpcode() == Instruction::Call) {
-    cs = CallSite(cast<CallInst>(inst));
-  } else {
-    cs = CallSite(cast<InvokeInst>(inst));
-  }
-
-  Value **args = new Value *[cs.arg_size()];
+  std::vector<Value *> args(callTy->getNumParams());
 
   std::vector<Type *> nullary;
 
@@ -291,14 +449,9 @@ Function *ExternalDispatcherImpl::createDispatcher(Function *target,
       cast<PointerType>(target->getType())->getElementType());
 
   // Each argument will be passed by writing it into gTheArgsP[i].
-  unsigned i = 0, idx = 2;
-  for (CallSite::arg_iterator ai = cs.arg_begin(), ae = cs.arg_end(); ai != ae;
-       ++ai, ++i) {
-    // Determine the type the argument will be passed as. This accommodates for
-    // the corresponding code in Executor.cpp for handling calls to bitcasted
-    // functions.
-    auto argTy =
-        (i < FTy->getNumParams() ? FTy->getParamType(i) : (*ai)->getType());
+  unsigned idx = 2;
+  for (unsigned i = 0, e = callTy->getNumParams(); i != e; ++i) {
+    auto argTy = callTy->getParamType(i);
     auto argI64p =
         Builder.CreateGEP(nullptr, argI64s,
                           ConstantInt::get(Type::getInt32Ty(ctx), idx));
@@ -312,8 +465,7 @@ Function *ExternalDispatcherImpl::createDispatcher(Function *target,
 
   auto dispatchTarget = module->getOrInsertFunction(target->getName(), FTy,
                                                     target->getAttributes());
-  auto result = Builder.CreateCall(dispatchTarget,
-                                   llvm::ArrayRef<Value *>(args, args + i));
+  auto result = Builder.CreateCall(dispatchTarget, args);
   if (result->getType() != Type::getVoidTy(ctx)) {
     auto resp = Builder.CreateBitCast(
         argI64s, PointerType::getUnqual(result->getType()));
@@ -322,8 +474,6 @@ Function *ExternalDispatcherImpl::createDispatcher(Function *target,
 
   Builder.CreateRetVoid();
 
-  delete[] args;
-
   return dispatcher;
 }
 
@@ -342,6 +492,13 @@ bool ExternalDispatcher::executeCall(llvm::Function *function,
   return impl->executeCall(function, i, args);
 }
 
+bool ExternalDispatcher::executeIsolatedCall(llvm::Function *function,
+                                             llvm::Instruction *i,
+                                             uint64_t *args,
+                                             const MemoryRanges &transfer) {
+  return impl->executeIsolatedCall(function, i, args, transfer);
+}
+
 void *ExternalDispatcher::resolveSymbol(const std::string &name) {
   return impl->resolveSymbol(name);
 }
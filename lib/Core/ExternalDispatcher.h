@@ -16,6 +16,8 @@
 #include <memory>
 #include <stdint.h>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace llvm {
 class Instruction;
@@ -30,6 +32,9 @@ private:
   ExternalDispatcherImpl *impl;
 
 public:
+  /// Host memory ranges (address, size) an isolated call may modify.
+  typedef std::vector<std::pair<void *, size_t> > MemoryRanges;
+
   ExternalDispatcher(llvm::LLVMContext &ctx);
   ~ExternalDispatcher();
 
@@ -39,6 +44,13 @@ public:
    */
   bool executeCall(llvm::Function *function, llvm::Instruction *i,
                    uint64_t *args);
+
+  /// Like executeCall, but run the call in a forked helper process so that
+  /// a crash or a stray write cannot affect this process. Only the result,
+  /// errno and the contents of \a transfer are copied back, through memory
+  /// shared with the helper.
+  bool executeIsolatedCall(llvm::Function *function, llvm::Instruction *i,
+                           uint64_t *args, const MemoryRanges &transfer);
   void *resolveSymbol(const std::string &name);
 
   int getLastErrno();
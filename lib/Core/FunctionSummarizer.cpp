@@ -0,0 +1,334 @@
+//===-- FunctionSummarizer.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "FunctionSummarizer.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprVisitor.h"
+#include "klee/Solver/Solver.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+/// Replaces the bytes of the parameters by the ones of the arguments.
+class ParameterVisitor : public ExprVisitor {
+  const FunctionSummarizer::Summary &summary;
+  /// The arguments extended to the bytes of the parameters.
+  std::vector<ref<Expr> > arguments;
+
+public:
+  ParameterVisitor(const FunctionSummarizer::Summary &summary,
+                   const std::vector<ref<Expr> > &arguments)
+      : summary(summary) {
+    for (unsigned i = 0; i != arguments.size(); ++i)
+      this->arguments.push_back(
+          ZExtExpr::create(arguments[i], 8 * summary.parameters[i]->size));
+  }
+
+  Action visitRead(const ReadExpr &re) {
+    const klee::ConstantExpr *index = dyn_cast<klee::ConstantExpr>(re.index);
+    for (unsigned i = 0; i != summary.parameters.size(); ++i) {
+      if (re.updates.root != summary.parameters[i])
+        continue;
+      assert(index && !re.updates.head && "parameters are only read");
+      return Action::changeTo(ExtractExpr::create(
+          arguments[i], 8 * index->getZExtValue(), Expr::Int8));
+    }
+    return Action::doChildren();
+  }
+};
+
+Expr::Kind getCompareKind(CmpInst::Predicate predicate) {
+  switch (predicate) {
+  case ICmpInst::ICMP_EQ: return Expr::Eq;
+  case ICmpInst::ICMP_NE: return Expr::Ne;
+  case ICmpInst::ICMP_UGT: return Expr::Ugt;
+  case ICmpInst::ICMP_UGE: return Expr::Uge;
+  case ICmpInst::ICMP_ULT: return Expr::Ult;
+  case ICmpInst::ICMP_ULE: return Expr::Ule;
+  case ICmpInst::ICMP_SGT: return Expr::Sgt;
+  case ICmpInst::ICMP_SGE: return Expr::Sge;
+  case ICmpInst::ICMP_SLT: return Expr::Slt;
+  default: return Expr::Sle;
+  }
+}
+
+Expr::Kind getBinaryKind(unsigned opcode) {
+  switch (opcode) {
+  case Instruction::Add: return Expr::Add;
+  case Instruction::Sub: return Expr::Sub;
+  case Instruction::Mul: return Expr::Mul;
+  case Instruction::UDiv: return Expr::UDiv;
+  case Instruction::SDiv: return Expr::SDiv;
+  case Instruction::URem: return Expr::URem;
+  case Instruction::SRem: return Expr::SRem;
+  case Instruction::And: return Expr::And;
+  case Instruction::Or: return Expr::Or;
+  case Instruction::Xor: return Expr::Xor;
+  case Instruction::Shl: return Expr::Shl;
+  case Instruction::LShr: return Expr::LShr;
+  default: return Expr::AShr;
+  }
+}
+
+/// The bytes a parameter of \a width is read from.
+unsigned getParameterSize(Expr::Width width) { return (width + 7) / 8; }
+} // namespace
+
+/// What a path through the function has computed so far.
+struct FunctionSummarizer::Path {
+  const BasicBlock *block;
+  const BasicBlock *previous;
+  /// The values of the instructions and arguments, and of the locals by
+  /// their allocas.
+  std::map<const Value *, ref<Expr> > values, locals;
+  std::vector<ref<Expr> > constraints;
+  unsigned instructions;
+};
+
+bool FunctionSummarizer::isSummarizable(const Function *f) {
+  if (f->isDeclaration() || f->isVarArg() ||
+      !f->getReturnType()->isIntegerTy())
+    return false;
+  for (const Argument &arg : f->args())
+    if (!arg.getType()->isIntegerTy())
+      return false;
+
+  for (const BasicBlock &bb : *f) {
+    for (const Instruction &i : bb) {
+      if (const AllocaInst *ai = dyn_cast<AllocaInst>(&i)) {
+        if (!ai->getAllocatedType()->isIntegerTy() || ai->isArrayAllocation())
+          return false;
+        // the local lives in the path as long as its address does not escape
+        for (const User *user : ai->users()) {
+          const LoadInst *li = dyn_cast<LoadInst>(user);
+          const StoreInst *si = dyn_cast<StoreInst>(user);
+          if ((!li || li->isVolatile() ||
+               li->getType() != ai->getAllocatedType()) &&
+              (!si || si->isVolatile() || si->getValueOperand() == ai ||
+               si->getValueOperand()->getType() != ai->getAllocatedType()))
+            return false;
+        }
+        continue;
+      }
+      if (const LoadInst *li = dyn_cast<LoadInst>(&i)) {
+        if (!isa<AllocaInst>(li->getPointerOperand()))
+          return false;
+        continue;
+      }
+      if (const StoreInst *si = dyn_cast<StoreInst>(&i)) {
+        if (!isa<AllocaInst>(si->getPointerOperand()))
+          return false;
+        continue;
+      }
+      if (isa<DbgInfoIntrinsic>(i) ||
+          (isa<PHINode>(i) && i.getType()->isIntegerTy()) ||
+          (isa<SelectInst>(i) && i.getType()->isIntegerTy()) ||
+          (isa<ICmpInst>(i) && i.getType()->isIntegerTy()) ||
+          isa<BranchInst>(i) || isa<SwitchInst>(i) || isa<ReturnInst>(i) ||
+          ((isa<TruncInst>(i) || isa<ZExtInst>(i) || isa<SExtInst>(i)) &&
+           i.getType()->isIntegerTy()))
+        continue;
+      if (isa<BinaryOperator>(i) && i.getType()->isIntegerTy())
+        continue;
+      return false;
+    }
+  }
+  return true;
+}
+
+const FunctionSummarizer::Summary *
+FunctionSummarizer::getSummary(const Function *f) {
+  auto it = summaries.find(f);
+  if (it == summaries.end())
+    it = summaries.emplace(f, isSummarizable(f) ? explore(f) : nullptr).first;
+  return it->second.get();
+}
+
+std::unique_ptr<FunctionSummarizer::Summary>
+FunctionSummarizer::explore(const Function *f) {
+  auto summary = std::make_unique<Summary>();
+  std::vector<Path> pending(1);
+  Path &entry = pending.back();
+  entry.block = &f->getEntryBlock();
+  entry.previous = nullptr;
+  entry.instructions = 0;
+  for (const Argument &arg : f->args()) {
+    Expr::Width width = arg.getType()->getIntegerBitWidth();
+    const Array *array = arrayCache.CreateArray(
+        f->getName().str() + "_arg" + llvm::utostr(arg.getArgNo()),
+        getParameterSize(width));
+    summary->parameters.push_back(array);
+    ref<Expr> value = Expr::createTempRead(array, 8 * array->size);
+    entry.values[&arg] = ExtractExpr::create(value, 0, width);
+  }
+
+  while (!pending.empty()) {
+    Path path = std::move(pending.back());
+    pending.pop_back();
+    if (!step(path, pending, *summary) ||
+        summary->paths.size() + pending.size() > maxPaths)
+      return nullptr;
+  }
+  if (summary->paths.empty())
+    return nullptr;
+  return summary;
+}
+
+bool FunctionSummarizer::step(Path &path, std::vector<Path> &pending,
+                              Summary &summary) {
+  auto eval = [&path](const Value *v) -> ref<Expr> {
+    if (const ConstantInt *ci = dyn_cast<ConstantInt>(v))
+      return klee::ConstantExpr::alloc(ci->getValue());
+    auto it = path.values.find(v);
+    return it == path.values.end() ? ref<Expr>() : it->second;
+  };
+
+  // the phi nodes read the values of the predecessor all at once
+  std::vector<std::pair<const PHINode *, ref<Expr> > > phis;
+  for (const PHINode &phi : path.block->phis()) {
+    ref<Expr> value = eval(phi.getIncomingValueForBlock(path.previous));
+    if (value.isNull())
+      return false;
+    phis.emplace_back(&phi, value);
+  }
+  for (const auto &phi : phis)
+    path.values[phi.first] = phi.second;
+
+  // the successors with the conditions to reach them
+  std::vector<std::pair<const BasicBlock *, ref<Expr> > > successors;
+  for (const Instruction &i : *path.block) {
+    if (isa<PHINode>(i) || isa<DbgInfoIntrinsic>(i) || isa<AllocaInst>(i))
+      continue;
+    if (++path.instructions > maxInstructions)
+      return false;
+
+    if (const LoadInst *li = dyn_cast<LoadInst>(&i)) {
+      auto it = path.locals.find(li->getPointerOperand());
+      if (it == path.locals.end())
+        return false;
+      path.values[&i] = it->second;
+      continue;
+    }
+    if (const StoreInst *si = dyn_cast<StoreInst>(&i)) {
+      ref<Expr> value = eval(si->getValueOperand());
+      if (value.isNull())
+        return false;
+      path.locals[si->getPointerOperand()] = value;
+      continue;
+    }
+    if (const ReturnInst *ri = dyn_cast<ReturnInst>(&i)) {
+      ref<Expr> value = eval(ri->getReturnValue());
+      if (value.isNull())
+        return false;
+      ref<Expr> condition = klee::ConstantExpr::create(1, Expr::Bool);
+      for (const ref<Expr> &constraint : path.constraints)
+        condition = AndExpr::create(condition, constraint);
+      summary.paths.emplace_back(condition, value);
+      return true;
+    }
+    if (const BranchInst *bi = dyn_cast<BranchInst>(&i)) {
+      if (bi->isUnconditional()) {
+        successors.emplace_back(bi->getSuccessor(0), ref<Expr>());
+        break;
+      }
+      ref<Expr> cond = eval(bi->getCondition());
+      if (cond.isNull())
+        return false;
+      successors.emplace_back(bi->getSuccessor(0), cond);
+      successors.emplace_back(bi->getSuccessor(1), Expr::createIsZero(cond));
+      break;
+    }
+    if (const SwitchInst *si = dyn_cast<SwitchInst>(&i)) {
+      ref<Expr> cond = eval(si->getCondition());
+      if (cond.isNull())
+        return false;
+      ref<Expr> isDefault = klee::ConstantExpr::create(1, Expr::Bool);
+      for (auto c : si->cases()) {
+        ref<Expr> match = EqExpr::create(cond, eval(c.getCaseValue()));
+        successors.emplace_back(c.getCaseSuccessor(), match);
+        isDefault = AndExpr::create(isDefault, Expr::createIsZero(match));
+      }
+      successors.emplace_back(si->getDefaultDest(), isDefault);
+      break;
+    }
+
+    std::vector<ref<Expr> > operands;
+    for (const Value *operand : i.operands()) {
+      operands.push_back(eval(operand));
+      if (operands.back().isNull())
+        return false;
+    }
+    ref<Expr> result;
+    if (const ICmpInst *ci = dyn_cast<ICmpInst>(&i)) {
+      result = Expr::createFromKind(getCompareKind(ci->getPredicate()),
+                                    {operands[0], operands[1]});
+    } else if (isa<BinaryOperator>(i)) {
+      result = Expr::createFromKind(getBinaryKind(i.getOpcode()),
+                                    {operands[0], operands[1]});
+    } else if (isa<SelectInst>(i)) {
+      result = SelectExpr::create(operands[0], operands[1], operands[2]);
+    } else {
+      Expr::Width width = i.getType()->getIntegerBitWidth();
+      if (isa<TruncInst>(i))
+        result = ExtractExpr::create(operands[0], 0, width);
+      else if (isa<ZExtInst>(i))
+        result = ZExtExpr::create(operands[0], width);
+      else
+        result = SExtExpr::create(operands[0], width);
+    }
+    path.values[&i] = result;
+  }
+
+  // fork the path on the feasible successors
+  ConstraintManager constraints(path.constraints);
+  std::vector<Path> next;
+  for (const auto &successor : successors) {
+    ref<Expr> cond = successor.second;
+    if (!cond.isNull()) {
+      bool feasible = true;
+      if (klee::ConstantExpr *CE = dyn_cast<klee::ConstantExpr>(cond))
+        feasible = CE->isTrue();
+      else if (!solver->mayBeTrue(Query(constraints, cond), feasible))
+        return false;
+      if (!feasible)
+        continue;
+    }
+    next.push_back(path);
+    next.back().previous = path.block;
+    next.back().block = successor.first;
+    if (!cond.isNull() && !isa<klee::ConstantExpr>(cond))
+      next.back().constraints.push_back(cond);
+  }
+  for (Path &p : next)
+    pending.push_back(std::move(p));
+  return true;
+}
+
+ref<Expr>
+FunctionSummarizer::instantiate(const Summary &summary,
+                                const std::vector<ref<Expr> > &arguments) {
+  assert(!summary.paths.empty() && "a summary has a path");
+  ParameterVisitor visitor(summary, arguments);
+  // the paths are disjoint and cover the parameters, the last one holds
+  // where the others do not
+  ref<Expr> result = visitor.visit(summary.paths.back().second);
+  for (unsigned i = summary.paths.size() - 1; i-- != 0;)
+    result = SelectExpr::create(visitor.visit(summary.paths[i].first),
+                                visitor.visit(summary.paths[i].second), result);
+  return result;
+}
@@ -0,0 +1,83 @@
+//===-- FunctionSummarizer.h ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_FUNCTIONSUMMARIZER_H
+#define KLEE_FUNCTIONSUMMARIZER_H
+
+#include "klee/Expr/Expr.h"
+
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+  class BasicBlock;
+  class Function;
+  class Value;
+}
+
+namespace klee {
+  class ArrayCache;
+  class Solver;
+
+  /// FunctionSummarizer - Summarizes the functions computing an integer from
+  /// integer arguments, used by -summarize-functions.
+  ///
+  /// A function is explored once, in isolation, on symbolic parameters: each
+  /// feasible path is recorded with its condition and the value it returns.
+  /// A call then binds the choice among these values on the conditions
+  /// instantiated with its arguments, instead of exploring the function
+  /// again path by path. Only the functions whose memory is their own scalar
+  /// locals and which call nothing are summarized, and only if their paths
+  /// stay within the limits; the others are executed as usual.
+  class FunctionSummarizer {
+  public:
+    struct Summary {
+      std::vector<const Array *> parameters;
+      /// The condition on the parameters of each path and the value it
+      /// returns.
+      std::vector<std::pair<ref<Expr>, ref<Expr> > > paths;
+    };
+
+  private:
+    struct Path;
+
+    Solver *solver;
+    ArrayCache &arrayCache;
+    unsigned maxPaths;
+    unsigned maxInstructions;
+    /// The summaries by function, null for the functions not summarized.
+    std::map<const llvm::Function *, std::unique_ptr<Summary> > summaries;
+
+    /// Whether the instructions of \a f are all ones a path can compute.
+    static bool isSummarizable(const llvm::Function *f);
+    std::unique_ptr<Summary> explore(const llvm::Function *f);
+    /// Run \a path through its block, adding the paths to its successors to
+    /// \a pending or the path to \a summary at a return.
+    bool step(Path &path, std::vector<Path> &pending, Summary &summary);
+
+  public:
+    FunctionSummarizer(Solver *solver, ArrayCache &arrayCache,
+                       unsigned maxPaths, unsigned maxInstructions)
+        : solver(solver), arrayCache(arrayCache), maxPaths(maxPaths),
+          maxInstructions(maxInstructions) {}
+
+    /// The summary of \a f, explored on first use, or null if \a f is not
+    /// summarized.
+    const Summary *getSummary(const llvm::Function *f);
+
+    /// The value returned by a call with \a arguments, of the widths of the
+    /// parameters.
+    static ref<Expr> instantiate(const Summary &summary,
+                                 const std::vector<ref<Expr> > &arguments);
+  };
+}
+
+#endif /* KLEE_FUNCTIONSUMMARIZER_H */
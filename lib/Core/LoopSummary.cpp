@@ -0,0 +1,204 @@
+//===-- LoopSummary.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "LoopSummary.h"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+
+#include <algorithm>
+#include <map>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+bool isInvariant(const Loop *loop, const Value *v) {
+  const Instruction *i = dyn_cast<Instruction>(v);
+  return !i || !loop->contains(i);
+}
+
+/// The index of \a gep if it addresses an element of an array at a loop
+/// invariant address, or null.
+Value *getArrayIndex(const Loop *loop, GetElementPtrInst *gep) {
+  if (!isInvariant(loop, gep->getPointerOperand()))
+    return nullptr;
+  if (gep->getNumIndices() == 1)
+    return gep->getOperand(1);
+  ConstantInt *first = dyn_cast<ConstantInt>(gep->getOperand(1));
+  if (gep->getNumIndices() == 2 && first && first->isZero() &&
+      gep->getSourceElementType()->isArrayTy())
+    return gep->getOperand(2);
+  return nullptr;
+}
+} // namespace
+
+std::unique_ptr<LoopSummary> LoopSummary::analyze(const Loop *loop,
+                                                  const DataLayout &dl) {
+  BasicBlock *header = loop->getHeader(), *latch = loop->getLoopLatch();
+  if (!latch)
+    return nullptr;
+
+  // the blocks from the header to the latch, one of them exiting
+  auto summary = std::make_unique<LoopSummary>();
+  summary->exiting = nullptr;
+  std::vector<BasicBlock *> chain;
+  SmallPtrSet<BasicBlock *, 8> visited;
+  for (BasicBlock *bb = header;;) {
+    if (!visited.insert(bb).second)
+      return nullptr;
+    chain.push_back(bb);
+    BranchInst *br = dyn_cast<BranchInst>(bb->getTerminator());
+    if (!br)
+      return nullptr;
+    BasicBlock *next = br->getSuccessor(0);
+    if (br->isConditional()) {
+      BasicBlock *other = br->getSuccessor(1);
+      if (!loop->contains(next))
+        std::swap(next, other);
+      if (summary->exiting || !loop->contains(next) || loop->contains(other))
+        return nullptr;
+      summary->exiting = bb;
+      summary->exit = other;
+    } else if (!loop->contains(next)) {
+      return nullptr;
+    }
+    if (bb == latch) {
+      if (next != header)
+        return nullptr;
+      break;
+    }
+    bb = next;
+  }
+  if (!summary->exiting || chain.size() != loop->getNumBlocks())
+    return nullptr;
+  unsigned exitingPosition =
+      std::find(chain.begin(), chain.end(), summary->exiting) - chain.begin();
+  summary->testAfterBody = summary->exiting == latch;
+
+  // the induction variable, counted up by one
+  PHINode *iv = dyn_cast<PHINode>(&header->front());
+  if (!iv || !iv->getType()->isIntegerTy() || iv->getNumIncomingValues() != 2 ||
+      isa<PHINode>(iv->getNextNode()))
+    return nullptr;
+  BinaryOperator *increment =
+      dyn_cast<BinaryOperator>(iv->getIncomingValueForBlock(latch));
+  if (!increment || increment->getOpcode() != Instruction::Add ||
+      !loop->contains(increment))
+    return nullptr;
+  Value *one = increment->getOperand(0) == iv ? increment->getOperand(1)
+                                              : increment->getOperand(0);
+  if (increment->getOperand(0) != iv && increment->getOperand(1) != iv)
+    return nullptr;
+  if (!isa<ConstantInt>(one) || !cast<ConstantInt>(one)->isOne())
+    return nullptr;
+  summary->inductionVariable = iv;
+  summary->increment = increment;
+
+  // the exit test, with the counted value on the left and holding while the
+  // loop goes on
+  BranchInst *exitBranch = cast<BranchInst>(summary->exiting->getTerminator());
+  ICmpInst *compare = dyn_cast<ICmpInst>(exitBranch->getCondition());
+  if (!compare || !loop->contains(compare))
+    return nullptr;
+  CmpInst::Predicate predicate = compare->getPredicate();
+  unsigned counted = 0;
+  if (compare->getOperand(1) == iv || compare->getOperand(1) == increment) {
+    counted = 1;
+    predicate = CmpInst::getSwappedPredicate(predicate);
+  }
+  Value *countedValue = compare->getOperand(counted);
+  if ((countedValue != iv && countedValue != increment) ||
+      !isInvariant(loop, compare->getOperand(1 - counted)))
+    return nullptr;
+  if (!loop->contains(exitBranch->getSuccessor(0)))
+    predicate = CmpInst::getInversePredicate(predicate);
+  if (predicate != CmpInst::ICMP_ULT && predicate != CmpInst::ICMP_SLT &&
+      predicate != CmpInst::ICMP_NE)
+    return nullptr;
+  summary->compare = compare;
+  summary->boundOperand = 1 - counted;
+  summary->comparesIncrement = countedValue == increment;
+  summary->predicate = predicate;
+
+  // the stores to the elements indexed by the induction variable
+  unsigned incrementPosition =
+      std::find(chain.begin(), chain.end(), increment->getParent()) -
+      chain.begin();
+  std::map<const Value *, unsigned> casts = {{iv, 0}};
+  std::map<const GetElementPtrInst *, unsigned> addresses;
+  bool canBeSigned = true, canBeUnsigned = true;
+  for (unsigned position = 0; position != chain.size(); ++position) {
+    for (Instruction &i : *chain[position]) {
+      for (User *user : i.users()) {
+        if (loop->contains(cast<Instruction>(user)))
+          continue;
+        // the increment only holds its last value if computed before the
+        // exit test
+        if (&i != iv &&
+            (&i != increment || incrementPosition > exitingPosition))
+          return nullptr;
+      }
+
+      if (&i == iv || &i == increment || &i == compare || i.isTerminator() ||
+          isa<DbgInfoIntrinsic>(i))
+        continue;
+      if ((isa<SExtInst>(i) || isa<ZExtInst>(i)) && i.getOperand(0) == iv) {
+        casts[&i] = i.getOpcode();
+        continue;
+      }
+      if (GetElementPtrInst *gep = dyn_cast<GetElementPtrInst>(&i)) {
+        Value *index = getArrayIndex(loop, gep);
+        auto it = index ? casts.find(index) : casts.end();
+        if (it == casts.end())
+          return nullptr;
+        addresses[gep] = it->second;
+        continue;
+      }
+      StoreInst *store = dyn_cast<StoreInst>(&i);
+      if (!store || store->isVolatile() ||
+          !isInvariant(loop, store->getValueOperand()) ||
+          (!summary->testAfterBody && position <= exitingPosition))
+        return nullptr;
+      GetElementPtrInst *gep =
+          dyn_cast<GetElementPtrInst>(store->getPointerOperand());
+      auto it = gep ? addresses.find(gep) : addresses.end();
+      if (it == addresses.end())
+        return nullptr;
+      Type *type = store->getValueOperand()->getType();
+      uint64_t elementSize = dl.getTypeAllocSize(gep->getResultElementType());
+      if (dl.getTypeSizeInBits(type) != 8 * elementSize ||
+          dl.getTypeStoreSize(type) != elementSize)
+        return nullptr;
+      summary->stores.push_back({store, gep, it->second, elementSize});
+
+      // the indices are contiguous if the bound is compared to in the
+      // signedness they are extended in
+      if (it->second == Instruction::ZExt)
+        canBeSigned = false;
+      else if (it->second == Instruction::SExt ||
+               iv->getType()->getIntegerBitWidth() < 64)
+        canBeUnsigned = false;
+    }
+  }
+
+  if (predicate == CmpInst::ICMP_ULT && !canBeUnsigned)
+    return nullptr;
+  if (predicate == CmpInst::ICMP_SLT && !canBeSigned)
+    return nullptr;
+  if (!canBeSigned && !canBeUnsigned)
+    return nullptr;
+  summary->isSigned = predicate == CmpInst::ICMP_SLT ||
+                      (predicate == CmpInst::ICMP_NE && !canBeUnsigned);
+  return summary;
+}
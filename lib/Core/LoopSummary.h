@@ -0,0 +1,74 @@
+//===-- LoopSummary.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_LOOPSUMMARY_H
+#define KLEE_LOOPSUMMARY_H
+
+#include "llvm/IR/InstrTypes.h"
+
+#include <memory>
+#include <vector>
+
+namespace llvm {
+  class BasicBlock;
+  class DataLayout;
+  class GetElementPtrInst;
+  class ICmpInst;
+  class Loop;
+  class PHINode;
+  class StoreInst;
+}
+
+namespace klee {
+  /// LoopSummary - The shape of a counting loop which -summarize-loops runs
+  /// in a single step, used by Executor::summarizeLoop.
+  ///
+  /// The loop is a chain of blocks from the header to the latch with a
+  /// single exit test, counting an induction variable up by one from its
+  /// value on entry while it compares below a loop invariant bound. Its
+  /// only effects are stores of loop invariant values to the elements of
+  /// invariant arrays indexed by the induction variable, and only the
+  /// induction variable and its increment may be used after the loop.
+  struct LoopSummary {
+    struct Store {
+      llvm::StoreInst *store;
+      llvm::GetElementPtrInst *address;
+      /// The cast of the induction variable to the index of the address,
+      /// SExt, ZExt or 0 for none.
+      unsigned cast;
+      uint64_t elementSize;
+    };
+
+    llvm::PHINode *inductionVariable;
+    llvm::Instruction *increment;
+    llvm::ICmpInst *compare;
+    /// The operand of the compare which is the bound.
+    unsigned boundOperand;
+    /// Whether the compare tests the increment rather than the induction
+    /// variable.
+    bool comparesIncrement;
+    /// The predicate under which the loop goes on, with the counted value on
+    /// the left: ICMP_ULT, ICMP_SLT or ICMP_NE.
+    llvm::CmpInst::Predicate predicate;
+    /// Whether the bound is compared to signed, for ICMP_NE by the casts of
+    /// the indices.
+    bool isSigned;
+    llvm::BasicBlock *exiting, *exit;
+    /// Whether the exit test ends the iteration, so that the stores run one
+    /// more time than the test holds.
+    bool testAfterBody;
+    std::vector<Store> stores;
+
+    /// The summary of \a loop, or none if it does not have the shape.
+    static std::unique_ptr<LoopSummary> analyze(const llvm::Loop *loop,
+                                                const llvm::DataLayout &dl);
+  };
+}
+
+#endif /* KLEE_LOOPSUMMARY_H */
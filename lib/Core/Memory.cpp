@@ -10,11 +10,13 @@
 #include "Memory.h"
 
 #include "Context.h"
+#include "CoreStats.h"
 #include "MemoryManager.h"
 #include "ObjectHolder.h"
 
 #include "klee/Expr/ArrayCache.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprSerializer.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/OptionCategories.h"
 #include "klee/Solver/Solver.h"
@@ -26,7 +28,11 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <limits>
+#include <set>
 #include <sstream>
 
 using namespace llvm;
@@ -38,6 +44,43 @@ namespace {
                     cl::desc("Use constant arrays instead of updates when possible (default=true)\n"),
                     cl::init(true),
                     cl::cat(SolvingCat));
+
+  cl::opt<unsigned> CompactUpdates(
+      "compact-updates",
+      cl::desc("Fold the oldest updates at constant indices of constant values "
+               "into a new constant array once an update list has this many "
+               "updates (default=256, 0=off)"),
+      cl::init(256), cl::cat(SolvingCat));
+
+  cl::opt<unsigned> SplitObjects(
+      "split-objects",
+      cl::desc("Read objects larger than this many bytes at symbolic offsets "
+               "through windows of that size covering the possible offsets "
+               "only, and flush only the bytes a write at a symbolic offset "
+               "may reach, instead of the whole object (default=0=off)"),
+      cl::init(0), cl::cat(SolvingCat));
+
+  cl::opt<bool> FusedPointerLayout(
+      "fused-pointer-layout",
+      cl::desc("Keep the segments and offsets of the bytes of an object that "
+               "stores pointers interleaved in one array, so that a pointer "
+               "read at a symbolic offset refers to one array and update "
+               "list instead of two (default=false)"),
+      cl::init(false), cl::cat(SolvingCat));
+
+  /// Objects larger than this keep separate planes, so that twice their
+  /// size still fits the 32-bit indices of the arrays.
+  const uint64_t MaxFusedBytes = 1u << 30;
+
+  /// Create a new constant array with the given contents.
+  const Array *
+  createConstantArray(ArrayCache *cache,
+                      const std::vector<ref<ConstantExpr> > &contents) {
+    static unsigned id = 0;
+    return cache->CreateArray("const_arr" + llvm::utostr(++id),
+                              contents.size(), &contents[0],
+                              &contents[0] + contents.size());
+  }
 }
 
 /***/
@@ -63,7 +106,7 @@ ObjectHolder &ObjectHolder::operator=(const ObjectHolder &b) {
 
 /***/
 
-int MemoryObject::counter = 0;
+std::atomic<int> MemoryObject::counter(0);
 
 MemoryObject::~MemoryObject() {
   if (parent)
@@ -92,24 +135,109 @@ void MemoryObject::getAllocInfo(std::string &result) const {
   info.flush();
 }
 
-void MemoryObject::initializeSymbolicArray(klee::ArrayCache &array) {
-  if (!symbolicAddress) {
-    symbolicAddress = array.CreateArray(std::string("mo_addr_for_seg:") + std::to_string(segment), Context::get().getPointerWidth());
+/***/
+
+const size_t ConcreteStore::PageSize;
+
+void ConcreteStore::clonePage(size_t index) {
+  stats::cowBytesCopied += pages[index]->size();
+  pages[index] = std::make_shared<Page>(*pages[index]);
+}
+
+void ConcreteStore::resize(size_t n, uint8_t value) {
+  size_t numPages = (n + PageSize - 1) >> PageBits;
+  size_t tail = n & (PageSize - 1);
+
+  if (n < _size) {
+    pages.resize(numPages);
+    if (tail && pages.back())
+      getWriteablePage(numPages - 1).resize(tail);
+  } else if (n > _size) {
+    if (pages.empty())
+      fill = value;
+    // fill up the last, partially used page first
+    if (_size & (PageSize - 1)) {
+      size_t last = pages.size() - 1;
+      if (pages[last] || value != fill)
+        getWriteablePage(last).resize(
+            std::min(PageSize, n - (last << PageBits)), value);
+    }
+    while (pages.size() < numPages) {
+      size_t begin = pages.size() << PageBits;
+      if (value == fill)
+        pages.emplace_back();
+      else
+        pages.push_back(
+            std::make_shared<Page>(std::min(PageSize, n - begin), value));
+    }
   }
+  _size = n;
 }
 
-ref<Expr> MemoryObject::getSymbolicAddress(klee::ArrayCache &array) {
-  if (!symbolicAddress) {
-    initializeSymbolicArray(array);
+size_t ConcreteStore::countNonZero() const {
+  size_t count = 0;
+  for (size_t i = 0, e = pages.size(); i != e; ++i) {
+    if (!pages[i]) {
+      if (fill)
+        count += pageLength(i);
+      continue;
+    }
+    for (uint8_t byte : *pages[i])
+      count += byte != 0;
+  }
+  return count;
+}
+
+void ConcreteStore::copyTo(uint8_t *dst) const {
+  for (size_t i = 0, e = pages.size(); i != e; ++i) {
+    if (pages[i])
+      memcpy(dst + (i << PageBits), pages[i]->data(), pages[i]->size());
+    else
+      memset(dst + (i << PageBits), fill, pageLength(i));
+  }
+}
+
+namespace {
+bool isFilledWith(const uint8_t *bytes, size_t n, uint8_t value) {
+  for (size_t i = 0; i != n; ++i)
+    if (bytes[i] != value)
+      return false;
+  return true;
+}
+} // namespace
+
+void ConcreteStore::copyFrom(const uint8_t *src) {
+  for (size_t i = 0, e = pages.size(); i != e; ++i) {
+    const uint8_t *from = src + (i << PageBits);
+    size_t length = pageLength(i);
+    bool same = pages[i] ? memcmp(pages[i]->data(), from, length) == 0
+                         : isFilledWith(from, length, fill);
+    if (!same) {
+      Page &page = getWriteablePage(i);
+      memcpy(page.data(), from, page.size());
+    }
   }
-  return Expr::createTempRead(symbolicAddress.getValue(), Context::get().getPointerWidth());
+}
+
+bool ConcreteStore::equals(const uint8_t *src) const {
+  for (size_t i = 0, e = pages.size(); i != e; ++i) {
+    const uint8_t *from = src + (i << PageBits);
+    size_t length = pageLength(i);
+    if (pages[i] ? memcmp(pages[i]->data(), from, length) != 0
+                 : !isFilledWith(from, length, fill))
+      return false;
+  }
+  return true;
 }
 
 /***/
 
-ObjectStatePlane::ObjectStatePlane(const ObjectState *parent)
-  : parent(parent),
+ObjectStatePlane::ObjectStatePlane(const MemoryObject *object)
+  : object(object),
     updates(0, 0),
+    compactionSize(CompactUpdates),
+    nonZeroBytes(0),
+    flushedForWrite(false),
     sizeBound(0),
     initialized(true),
     symbolic(false),
@@ -117,44 +245,71 @@ ObjectStatePlane::ObjectStatePlane(const ObjectState *parent)
   if (!UseConstantArrays) {
     static unsigned id = 0;
     const Array *array =
-        parent->getArrayCache()->CreateArray("tmp_arr" + llvm::utostr(++id), sizeBound);
+        getArrayCache()->CreateArray("tmp_arr" + llvm::utostr(++id), sizeBound);
     updates = UpdateList(array, 0);
   }
-  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(parent->getObject()->size)) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(object->size)) {
     sizeBound = CE->getZExtValue();
   }
 }
 
 
-ObjectStatePlane::ObjectStatePlane(const ObjectState *parent, const Array *array)
-  : parent(parent),
+ObjectStatePlane::ObjectStatePlane(const MemoryObject *object, const Array *array)
+  : object(object),
     updates(array, 0),
+    compactionSize(CompactUpdates),
+    nonZeroBytes(0),
+    flushedForWrite(false),
     sizeBound(0),
     initialized(false),
     symbolic(true),
     initialValue(0) {
-  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(parent->getObject()->size)) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(object->size)) {
     sizeBound = CE->getZExtValue();
   }
 }
 
-ObjectStatePlane::ObjectStatePlane(const ObjectState *parent, const ObjectStatePlane &os)
-  : parent(parent),
+ObjectStatePlane::ObjectStatePlane(const MemoryObject *object, const ObjectStatePlane &os)
+  : object(object),
     concreteStore(os.concreteStore),
     concreteMask(os.concreteMask),
     flushMask(os.flushMask),
     knownSymbolics(os.knownSymbolics),
     updates(os.updates),
+    compactionSize(os.compactionSize),
+    nonZeroBytes(os.nonZeroBytes),
+    flushedForWrite(os.flushedForWrite),
+    sizeBound(os.sizeBound),
+    initialized(os.initialized),
+    symbolic(os.symbolic),
+    initialValue(os.initialValue) {
+}
+
+ObjectStatePlane::ObjectStatePlane(const MemoryObject *object,
+                                   ObjectStatePlane &&os)
+  : object(object),
+    concreteStore(std::move(os.concreteStore)),
+    concreteMask(std::move(os.concreteMask)),
+    flushMask(std::move(os.flushMask)),
+    knownSymbolics(std::move(os.knownSymbolics)),
+    updates(os.updates),
+    compactionSize(os.compactionSize),
+    nonZeroBytes(os.nonZeroBytes),
+    flushedForWrite(os.flushedForWrite),
     sizeBound(os.sizeBound),
     initialized(os.initialized),
     symbolic(os.symbolic),
     initialValue(os.initialValue) {
-  assert(!os.parent->readOnly && "no need to copy read only object?");
 }
 
 ObjectStatePlane::~ObjectStatePlane() {
 }
 
+ArrayCache *ObjectStatePlane::getArrayCache() const {
+  assert(object && "object was NULL");
+  return object->parent->getArrayCache();
+}
+
 /***/
 
 const UpdateList &ObjectStatePlane::getUpdates() const {
@@ -194,37 +349,202 @@ const UpdateList &ObjectStatePlane::getUpdates() const {
       Contents[Index->getZExtValue()] = Value;
     }
 
-    static unsigned id = 0;
-    const Array *array = parent->getArrayCache()->CreateArray(
-        "const_arr" + llvm::utostr(++id), sizeBound, &Contents[0],
-        &Contents[0] + Contents.size());
-    updates = UpdateList(array, 0);
+    updates = UpdateList(createConstantArray(getArrayCache(), Contents), 0);
 
     // Apply the remaining (non-constant) writes.
     for (; Begin != End; ++Begin)
       updates.extend(Writes[Begin].first, Writes[Begin].second);
+  } else if (CompactUpdates && updates.root->isConstantArray() &&
+             updates.getSize() >= compactionSize) {
+    compactUpdates();
   }
 
   return updates;
 }
 
+bool ObjectStatePlane::getWindow(unsigned begin, unsigned end,
+                                 UpdateList &window) const {
+  std::vector<ref<ConstantExpr> > contents(end - begin);
+  std::vector<unsigned> knownBytes;
+  bool complete = true;
+  for (unsigned offset = begin; offset != end; ++offset) {
+    if (isByteConcrete(offset)) {
+      contents[offset - begin] =
+          ConstantExpr::create(getConcreteValue(offset), Expr::Int8);
+    } else {
+      contents[offset - begin] = ConstantExpr::create(0, Expr::Int8);
+      if (isByteKnownSymbolic(offset))
+        knownBytes.push_back(offset);
+      else
+        complete = false;
+    }
+  }
+
+  if (complete) {
+    window = UpdateList(createConstantArray(getArrayCache(), contents), 0);
+    for (unsigned offset : knownBytes)
+      window.extend(ConstantExpr::create(offset - begin, Expr::Int32),
+                    knownSymbolics[offset]);
+    return true;
+  }
+
+  // Some bytes are only known through the update list: replay it with its
+  // indices moved down by begin. Writes that fall outside the window then
+  // never match an index of a read from it.
+  const Array *root = updates.root;
+  if (root && !root->isConstantArray())
+    return false;
+
+  std::vector<const UpdateNode *> writes(updates.getSize());
+  const UpdateNode *un = updates.head;
+  for (unsigned i = writes.size(); i != 0; un = un->next)
+    writes[--i] = un;
+
+  for (unsigned offset = begin; offset != end; ++offset)
+    contents[offset - begin] = root && offset < root->size
+                                   ? root->constantValues[offset]
+                                   : ConstantExpr::create(0, Expr::Int8);
+  unsigned i = 0;
+  for (; i != writes.size(); ++i) {
+    ConstantExpr *index = dyn_cast<ConstantExpr>(writes[i]->index);
+    ConstantExpr *value = dyn_cast<ConstantExpr>(writes[i]->value);
+    if (!index || !value)
+      break;
+    uint64_t offset = index->getZExtValue();
+    if (begin <= offset && offset < end)
+      contents[offset - begin] = value;
+  }
+
+  ref<Expr> base = ConstantExpr::create(begin, Expr::Int32);
+  window = UpdateList(createConstantArray(getArrayCache(), contents), 0);
+  for (; i != writes.size(); ++i) {
+    if (ConstantExpr *index = dyn_cast<ConstantExpr>(writes[i]->index)) {
+      uint64_t offset = index->getZExtValue();
+      if (offset < begin || offset >= end)
+        continue;
+    }
+    window.extend(SubExpr::create(writes[i]->index, base), writes[i]->value);
+  }
+
+  // the bytes written since the last flush are newer than the update list
+  for (unsigned offset = begin; offset != end; ++offset) {
+    if (isByteConcrete(offset))
+      window.extend(ConstantExpr::create(offset - begin, Expr::Int32),
+                    ConstantExpr::create(getConcreteValue(offset), Expr::Int8));
+    else if (isByteKnownSymbolic(offset))
+      window.extend(ConstantExpr::create(offset - begin, Expr::Int32),
+                    knownSymbolics[offset]);
+  }
+  return true;
+}
+
+void ObjectStatePlane::compactUpdates() const {
+  // keeps the nodes alive while the list is rebuilt
+  UpdateList old = updates;
+  const Array *root = old.root;
+
+  // Collect the list of writes, with the oldest writes first.
+  std::vector<const UpdateNode *> writes(old.getSize());
+  const UpdateNode *un = old.head;
+  for (unsigned i = writes.size(); i != 0; un = un->next)
+    writes[--i] = un;
+
+  unsigned folded = 0;
+  for (; folded != writes.size(); ++folded) {
+    ConstantExpr *index = dyn_cast<ConstantExpr>(writes[folded]->index);
+    if (!index || !isa<ConstantExpr>(writes[folded]->value) ||
+        index->getZExtValue() >= root->size)
+      break;
+  }
+
+  if (folded >= CompactUpdates) {
+    std::vector<ref<ConstantExpr> > contents(root->constantValues);
+    for (unsigned i = 0; i != folded; ++i)
+      contents[cast<ConstantExpr>(writes[i]->index)->getZExtValue()] =
+          cast<ConstantExpr>(writes[i]->value);
+    updates = UpdateList(createConstantArray(getArrayCache(), contents), 0);
+    for (unsigned i = folded; i != writes.size(); ++i)
+      updates.extend(writes[i]->index, writes[i]->value);
+  }
+
+  // Check again once the list has doubled, so that the rebuilding takes
+  // constant time per update.
+  compactionSize = std::max<unsigned>(CompactUpdates, 2 * updates.getSize());
+}
+
 void ObjectStatePlane::flushToConcreteStore(TimingSolver *solver,
                                        const ExecutionState &state) {
-  for (unsigned i = 0; i < concreteStore.size(); i++) {
-    if (isByteKnownSymbolic(i)) {
-      ref<ConstantExpr> ce;
-      bool success = solver->getValue(state, read8(i), ce);
-      if (!success) {
-        klee_warning("Solver timed out when getting a value for external call, "
-                     "segment + offset %lu+%u will have random value",
-                     parent->getObject()->segment, i);
-      } else {
-        uint8_t value;
-        ce->toMemory(&value);
-        concreteStore[i] = value;
-      }
+  knownSymbolics.forEach([&](size_t i, const ref<Expr> &byte) {
+    if (i >= concreteStore.size())
+      return;
+    ref<ConstantExpr> ce;
+    bool success = solver->getValue(state, byte, ce);
+    if (!success) {
+      klee_warning("Solver timed out when getting a value for external call, "
+                   "segment + offset %lu+%zu will have random value",
+                   object->segment, i);
+    } else {
+      uint8_t value;
+      ce->toMemory(&value);
+      concreteStore.set(i, value);
     }
+  });
+}
+
+static void writeBits(ExprWriter &w, const BitArray &bits) {
+  std::vector<uint8_t> bytes((bits.size() + 7) / 8);
+  for (unsigned i = 0, e = bits.size(); i != e; ++i)
+    if (bits.get(i))
+      bytes[i / 8] |= 1 << (i % 8);
+  w.writeInt(bits.size());
+  w.writeBytes(bytes.data(), bytes.size());
+}
+
+static void readBits(ExprReader &r, BitArray &bits) {
+  bits.resize(r.readInt());
+  std::vector<uint8_t> bytes((bits.size() + 7) / 8);
+  r.readBytes(bytes.data(), bytes.size());
+  for (unsigned i = 0, e = bits.size(); i != e; ++i)
+    bits.set(i, (bytes[i / 8] >> (i % 8)) & 1);
+}
+
+void ObjectStatePlane::swapOut(ExprWriter &w) {
+  std::vector<uint8_t> bytes(concreteStore.size());
+  concreteStore.copyTo(bytes.data());
+  w.writeInt(bytes.size());
+  w.writeBytes(bytes.data(), bytes.size());
+  writeBits(w, concreteMask);
+  writeBits(w, flushMask);
+
+  size_t numSymbolics = 0;
+  knownSymbolics.forEach([&](size_t, const ref<Expr> &) { ++numSymbolics; });
+  w.writeInt(numSymbolics);
+  knownSymbolics.forEach([&](size_t i, const ref<Expr> &byte) {
+    w.writeInt(i);
+    w.write(byte);
+  });
+  w.write(updates);
+
+  concreteStore = ConcreteStore();
+  concreteMask.resize(0);
+  flushMask.resize(0);
+  knownSymbolics.clear();
+  updates = UpdateList(updates.root, 0);
+}
+
+void ObjectStatePlane::swapIn(ExprReader &r) {
+  std::vector<uint8_t> bytes(r.readInt());
+  r.readBytes(bytes.data(), bytes.size());
+  concreteStore.resize(bytes.size(), 0);
+  concreteStore.write(0, bytes.data(), bytes.size());
+  readBits(r, concreteMask);
+  readBits(r, flushMask);
+
+  for (uint64_t n = r.readInt(); n != 0; --n) {
+    size_t i = r.readInt();
+    knownSymbolics.set(i, r.readExpr());
   }
+  updates = r.readUpdateList();
 }
 
 void ObjectStatePlane::makeConcrete() {
@@ -236,6 +556,7 @@ void ObjectStatePlane::makeConcrete() {
 void ObjectStatePlane::initializeToZero() {
   makeConcrete();
   initialValue = 0;
+  nonZeroBytes = concreteStore.countNonZero();
 }
 
 void ObjectStatePlane::initializeToRandom() {
@@ -253,26 +574,46 @@ isByteConcrete(i) => !isByteKnownSymbolic(i)
  */
 
 void ObjectStatePlane::flushForRead() const {
-  // TODO: iterate only over the offsets for which we have information
-  // (SparseVector may be, well, sparse...)
-  for (unsigned offset = 0; offset < sizeBound; offset++) {
-    if (!isByteFlushed(offset)) {
-      if (isByteConcrete(offset)) {
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(getConcreteValue(offset), Expr::Int8));
-      } else {
-        assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
-      }
+  // a plane whose bytes are all concrete and were never flushed, like the
+  // ones of constant globals, becomes a constant array at once instead of
+  // an update per byte folded into one later
+  if (UseConstantArrays && initialized && !updates.root && !updates.head &&
+      !concreteMask.size() && !flushMask.size() && sizeBound) {
+    std::vector<ref<ConstantExpr> > contents(sizeBound);
+    for (unsigned offset = 0; offset != sizeBound; ++offset)
+      contents[offset] =
+          ConstantExpr::create(getConcreteValue(offset), Expr::Int8);
+    updates = UpdateList(createConstantArray(getArrayCache(), contents), 0);
+    flushMask.resize(sizeBound, false);
+    return;
+  }
 
-      markByteFlushed(offset);
+  auto flushByte = [this](unsigned offset) {
+    if (isByteConcrete(offset)) {
+      updates.extend(ConstantExpr::create(offset, Expr::Int32),
+                     ConstantExpr::create(getConcreteValue(offset), Expr::Int8));
+    } else {
+      assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
+      updates.extend(ConstantExpr::create(offset, Expr::Int32),
+                     knownSymbolics[offset]);
     }
-  } 
+
+    markByteFlushed(offset);
+  };
+
+  // Unflushed bytes are those with their flushMask bit set and, for an
+  // initialized plane, all bytes past the end of the mask.
+  unsigned maskEnd = std::min(sizeBound, flushMask.size());
+  for (unsigned offset = flushMask.findFirstSet(); offset < maskEnd;
+       offset = flushMask.findFirstSet(offset + 1))
+    flushByte(offset);
+  if (initialized)
+    for (unsigned offset = maskEnd; offset < sizeBound; offset++)
+      flushByte(offset);
 }
 
-void ObjectStatePlane::flushForWrite() {
-  for (unsigned offset = 0; offset < sizeBound; offset++) {
+void ObjectStatePlane::flushForWrite(unsigned begin, unsigned end) {
+  for (unsigned offset = begin; offset < end; offset++) {
     if (!isByteFlushed(offset)) {
       if (isByteConcrete(offset)) {
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
@@ -292,7 +633,11 @@ void ObjectStatePlane::flushForWrite() {
       setKnownSymbolic(offset, 0);
     }
   }
-  initialized = false;
+  // the bytes outside the range keep their masks, past the end of which
+  // the bytes count as initialized
+  if (begin == 0 && end >= sizeBound)
+    initialized = false;
+  flushedForWrite = true;
 }
 
 bool ObjectStatePlane::isByteConcrete(unsigned offset) const {
@@ -358,6 +703,20 @@ uint8_t ObjectStatePlane::getConcreteValue(unsigned offset) const {
   return initialValue;
 }
 
+bool ObjectStatePlane::isRangeConcrete(unsigned offset, unsigned count) const {
+  unsigned maskSize = concreteMask.size();
+  if (offset + count <= maskSize)
+    return concreteMask.isAllSet(offset, count);
+  // bytes past the mask are concrete iff the plane is initialized
+  if (!initialized)
+    return false;
+  return offset >= maskSize || concreteMask.isAllSet(offset, maskSize - offset);
+}
+
+bool ObjectStatePlane::isByteKnownZero(unsigned offset) const {
+  return isByteConcrete(offset) && getConcreteValue(offset) == 0;
+}
+
 /***/
 
 ref<Expr> ObjectStatePlane::read8(unsigned offset) const {
@@ -377,7 +736,7 @@ ref<Expr> ObjectStatePlane::read8(ref<Expr> offset) const {
 
   if (sizeBound>4096) {
     std::string allocInfo;
-    parent->getObject()->getAllocInfo(allocInfo);
+    object->getAllocInfo(allocInfo);
     klee_warning_once(0, "flushing %d bytes on read, may be slow and/or crash: %s", 
                       sizeBound,
                       allocInfo.c_str());
@@ -385,7 +744,7 @@ ref<Expr> ObjectStatePlane::read8(ref<Expr> offset) const {
 
   const UpdateList &updates = getUpdates();
 
-  if (symbolic || isa<ConstantExpr>(parent->getObject()->size)) {
+  if (symbolic || isa<ConstantExpr>(object->size)) {
     return ReadExpr::create(updates, ZExtExpr::create(offset, Expr::Int32));
   }
 
@@ -402,13 +761,48 @@ ref<Expr> ObjectStatePlane::read8(ref<Expr> offset) const {
       ConstantExpr::alloc(initialValue, Expr::Int8));
 }
 
+void ObjectStatePlane::writeBytes(unsigned offset, const uint8_t *src,
+                                  unsigned count) {
+  if (!isRangeConcrete(offset, count)) {
+    for (unsigned i = 0; i != count; ++i)
+      write8(offset + i, src[i]);
+    return;
+  }
+
+  if (offset + count > sizeBound)
+    sizeBound = offset + count;
+  if (concreteStore.size() < offset + count)
+    concreteStore.resize(sizeBound, initialValue);
+
+  if (tracksZeroBytes()) {
+    for (unsigned i = 0; i != count; ++i) {
+      uint8_t old = concreteStore[offset + i];
+      if (!old && src[i])
+        ++nonZeroBytes;
+      else if (old && !src[i])
+        --nonZeroBytes;
+    }
+  }
+
+  concreteStore.write(offset, src, count);
+  for (unsigned i = 0; i != count; ++i)
+    markByteUnflushed(offset + i);
+}
+
 void ObjectStatePlane::write8(unsigned offset, uint8_t value) {
   //assert(read_only == false && "writing to read-only object!");
+  if (tracksZeroBytes()) {
+    bool wasZero = isByteKnownZero(offset);
+    if (wasZero && value)
+      ++nonZeroBytes;
+    else if (!wasZero && !value)
+      --nonZeroBytes;
+  }
   if (offset >= sizeBound)
     sizeBound = offset + 1;
   if (concreteStore.size() <= offset)
     concreteStore.resize(sizeBound, initialValue);
-  concreteStore[offset] = value;
+  concreteStore.set(offset, value);
   setKnownSymbolic(offset, 0);
 
   markByteConcrete(offset);
@@ -420,6 +814,8 @@ void ObjectStatePlane::write8(unsigned offset, ref<Expr> value) {
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
     write8(offset, (uint8_t) CE->getZExtValue(8));
   } else {
+    if (tracksZeroBytes() && isByteKnownZero(offset))
+      ++nonZeroBytes;
     if (offset >= sizeBound)
       sizeBound = offset + 1;
     setKnownSymbolic(offset, value.get());
@@ -431,16 +827,6 @@ void ObjectStatePlane::write8(unsigned offset, ref<Expr> value) {
 
 void ObjectStatePlane::write8(ref<Expr> offset, ref<Expr> value) {
   assert(!isa<ConstantExpr>(offset) && "constant offset passed to symbolic write8");
-  flushForWrite();
-
-  if (sizeBound>4096) {
-    std::string allocInfo;
-    parent->getObject()->getAllocInfo(allocInfo);
-    klee_warning_once(0, "flushing %d bytes on read, may be slow and/or crash: %s", 
-                      sizeBound,
-                      allocInfo.c_str());
-  }
-  
   updates.extend(ZExtExpr::create(offset, Expr::Int32), value);
 }
 
@@ -473,14 +859,68 @@ ref<Expr> ObjectStatePlane::read(ref<Expr> offset, Expr::Width width) const {
   return Res;
 }
 
+ref<Expr> ObjectStatePlane::read(ref<Expr> offset, Expr::Width width,
+                                 uint64_t lo, uint64_t hi) const {
+  unsigned NumBytes = width == Expr::Bool ? 1 : width / 8;
+  // Fall back to the whole plane for constant offsets, which need no
+  // array, and for objects whose size is symbolic.
+  if (!SplitObjects || isa<ConstantExpr>(offset) || lo > hi ||
+      hi >= sizeBound || hi + NumBytes > sizeBound ||
+      !isa<ConstantExpr>(object->size))
+    return read(offset, width);
+
+  // The windows are aligned so that nearby reads refer to the same bytes.
+  uint64_t begin = lo / SplitObjects * SplitObjects;
+  uint64_t end = std::min<uint64_t>(
+      sizeBound, (hi + NumBytes + SplitObjects - 1) / SplitObjects *
+                     SplitObjects);
+  UpdateList window(0, 0);
+  if (end - begin >= sizeBound || !getWindow(begin, end, window))
+    return read(offset, width);
+  ++stats::splitObjectReads;
+
+  // The offset is below sizeBound, so truncating it loses nothing.
+  ref<Expr> index = SubExpr::create(ZExtExpr::create(offset, Expr::Int32),
+                                    ConstantExpr::create(begin, Expr::Int32));
+  if (width == Expr::Bool)
+    return ExtractExpr::create(ReadExpr::create(window, index), 0, Expr::Bool);
+
+  ref<Expr> Res(0);
+  for (unsigned i = 0; i != NumBytes; ++i) {
+    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+    ref<Expr> Byte = ReadExpr::create(
+        window, AddExpr::create(index, ConstantExpr::create(idx, Expr::Int32)));
+    Res = i ? ConcatExpr::create(Byte, Res) : Byte;
+  }
+  return Res;
+}
+
 ref<Expr> ObjectStatePlane::read(unsigned offset, Expr::Width width) const {
   // Treat bool specially, it is the only non-byte sized write we allow.
   if (width == Expr::Bool)
     return ExtractExpr::create(read8(offset), 0, Expr::Bool);
 
-  // Otherwise, follow the slow general case.
   unsigned NumBytes = width / 8;
   assert(width == NumBytes * 8 && "Invalid width for read size!");
+
+  // Fast path: the whole word is concrete, read it in one go.
+  if (NumBytes <= 8 && isRangeConcrete(offset, NumBytes)) {
+    uint8_t bytes[8];
+    if (offset + NumBytes <= concreteStore.size()) {
+      concreteStore.read(offset, bytes, NumBytes);
+    } else {
+      for (unsigned i = 0; i != NumBytes; ++i)
+        bytes[i] = getConcreteValue(offset + i);
+    }
+    uint64_t value = 0;
+    for (unsigned i = 0; i != NumBytes; ++i) {
+      unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+      value |= (uint64_t) bytes[idx] << (8 * i);
+    }
+    return ConstantExpr::create(value, width);
+  }
+
+  // Otherwise, follow the slow general case.
   ref<Expr> Res(0);
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
@@ -492,6 +932,11 @@ ref<Expr> ObjectStatePlane::read(unsigned offset, Expr::Width width) const {
 }
 
 void ObjectStatePlane::write(ref<Expr> offset, ref<Expr> value) {
+  write(offset, value, 0, std::numeric_limits<uint64_t>::max());
+}
+
+void ObjectStatePlane::write(ref<Expr> offset, ref<Expr> value, uint64_t lo,
+                             uint64_t hi) {
   // Truncate offset to 32-bits.
   offset = ZExtExpr::create(offset, Expr::Int32);
 
@@ -501,15 +946,33 @@ void ObjectStatePlane::write(ref<Expr> offset, ref<Expr> value) {
     return;
   }
 
-  // Treat bool specially, it is the only non-byte sized write we allow.
+  // Only the bytes the write may reach need to leave the concrete store,
+  // unless the size of the object is symbolic.
   Expr::Width w = value->getWidth();
+  unsigned NumBytes = w == Expr::Bool ? 1 : w / 8;
+  unsigned begin = 0, end = sizeBound;
+  if (SplitObjects && lo <= hi && hi < sizeBound &&
+      hi + NumBytes <= sizeBound && isa<ConstantExpr>(object->size)) {
+    begin = lo;
+    end = hi + NumBytes;
+  }
+  flushForWrite(begin, end);
+
+  if (end - begin > 4096) {
+    std::string allocInfo;
+    object->getAllocInfo(allocInfo);
+    klee_warning_once(0, "flushing %d bytes on write, may be slow and/or crash: %s",
+                      end - begin,
+                      allocInfo.c_str());
+  }
+
+  // Treat bool specially, it is the only non-byte sized write we allow.
   if (w == Expr::Bool) {
     write8(offset, ZExtExpr::create(value, Expr::Int8));
     return;
   }
 
   // Otherwise, follow the slow general case.
-  unsigned NumBytes = w / 8;
   assert(w == NumBytes * 8 && "Invalid write size!");
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
@@ -551,34 +1014,171 @@ void ObjectStatePlane::write(unsigned offset, ref<Expr> value) {
   }
 } 
 
-void ObjectStatePlane::write16(unsigned offset, uint16_t value) {
-  unsigned NumBytes = 2;
+void ObjectStatePlane::writeConcrete(unsigned offset, uint64_t value,
+                                     unsigned NumBytes) {
+  uint8_t bytes[8];
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
+    bytes[idx] = (uint8_t) (value >> (8 * i));
+  }
+
+  // Bytes that are not all concrete need their symbolic state cleared one
+  // by one.
+  if (!isRangeConcrete(offset, NumBytes)) {
+    for (unsigned i = 0; i != NumBytes; ++i)
+      write8(offset + i, bytes[i]);
+    return;
+  }
+
+  if (offset + NumBytes > sizeBound)
+    sizeBound = offset + NumBytes;
+  if (concreteStore.size() < offset + NumBytes)
+    concreteStore.resize(sizeBound, initialValue);
+
+  if (tracksZeroBytes()) {
+    uint8_t old[8];
+    concreteStore.read(offset, old, NumBytes);
+    for (unsigned i = 0; i != NumBytes; ++i) {
+      if (!old[i] && bytes[i])
+        ++nonZeroBytes;
+      else if (old[i] && !bytes[i])
+        --nonZeroBytes;
+    }
   }
+
+  concreteStore.write(offset, bytes, NumBytes);
+  for (unsigned i = 0; i != NumBytes; ++i)
+    markByteUnflushed(offset + i);
+}
+
+void ObjectStatePlane::write16(unsigned offset, uint16_t value) {
+  writeConcrete(offset, value, 2);
 }
 
 void ObjectStatePlane::write32(unsigned offset, uint32_t value) {
-  unsigned NumBytes = 4;
-  for (unsigned i = 0; i != NumBytes; ++i) {
-    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
-  }
+  writeConcrete(offset, value, 4);
 }
 
 void ObjectStatePlane::write64(unsigned offset, uint64_t value) {
-  unsigned NumBytes = 8;
-  for (unsigned i = 0; i != NumBytes; ++i) {
-    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
+  writeConcrete(offset, value, 8);
+}
+
+unsigned ObjectStatePlane::concretizeArrayBytes(
+    const Array *array,
+    const std::vector<std::pair<unsigned, uint8_t>> &values) {
+  if (updates.root != array)
+    return 0;
+
+  // The bytes only known through the update list hold the array's bytes
+  // unless they were written at their offset, or anywhere at a symbolic
+  // one.
+  std::set<uint64_t> written;
+  for (const UpdateNode *un = updates.head; un; un = un->next) {
+    ConstantExpr *index = dyn_cast<ConstantExpr>(un->index);
+    if (!index)
+      return 0;
+    written.insert(index->getZExtValue());
+  }
+  auto holdsArrayByte = [&](unsigned offset) {
+    return offset < sizeBound && !isByteConcrete(offset) &&
+           !isByteKnownSymbolic(offset) && !written.count(offset);
+  };
+
+  unsigned count = 0;
+  std::vector<uint8_t> bytes;
+  for (unsigned i = 0; i != values.size();) {
+    unsigned begin = values[i].first;
+    if (!holdsArrayByte(begin)) {
+      ++i;
+      continue;
+    }
+    bytes.clear();
+    for (; i != values.size() && values[i].first == begin + bytes.size() &&
+           holdsArrayByte(values[i].first);
+         ++i)
+      bytes.push_back(values[i].second);
+
+    if (concreteStore.size() < begin + bytes.size())
+      concreteStore.resize(sizeBound, initialValue);
+    concreteStore.write(begin, bytes.data(), bytes.size());
+    for (unsigned offset = begin; offset != begin + bytes.size(); ++offset) {
+      markByteConcrete(offset);
+      markByteUnflushed(offset);
+    }
+    count += bytes.size();
+  }
+  return count;
+}
+
+void ObjectStatePlane::copyRange(unsigned offset, const ObjectStatePlane &src,
+                                 unsigned srcOffset, unsigned count) {
+  auto copyByte = [&](unsigned i) {
+    if (src.isByteConcrete(srcOffset + i))
+      write8(offset + i, src.getConcreteValue(srcOffset + i));
+    else
+      write8(offset + i, src.read8(srcOffset + i));
+  };
+  // copy backwards if the range would overwrite its own source
+  if (&src == this && srcOffset < offset) {
+    for (unsigned i = count; i != 0; --i)
+      copyByte(i - 1);
+  } else {
+    for (unsigned i = 0; i != count; ++i)
+      copyByte(i);
+  }
+}
+
+void ObjectStatePlane::fill(unsigned offset, ref<Expr> value,
+                            unsigned count) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
+    uint8_t byte = CE->getZExtValue(8);
+    for (unsigned i = 0; i != count; ++i)
+      write8(offset + i, byte);
+  } else {
+    for (unsigned i = 0; i != count; ++i)
+      write8(offset + i, value);
+  }
+}
+
+const std::vector<ref<Expr>> &
+ObjectStatePlane::getStoredWords(Expr::Width width, unsigned first,
+                                 unsigned stride) const {
+  if (storedWords)
+    return *storedWords;
+
+  unsigned bytes = width / 8;
+  unsigned size = sizeBound / stride;
+  auto at = [&](unsigned offset) { return first + stride * offset; };
+  std::set<ref<Expr>> words;
+  for (unsigned offset = 0; offset + bytes <= size; offset += bytes) {
+    // skip the words of concrete zero bytes without building them
+    unsigned i = 0;
+    uint8_t byte;
+    while (i != bytes && getConcreteByte(at(offset + i), byte) && !byte)
+      ++i;
+    if (i == bytes)
+      continue;
+    if (stride == 1) {
+      words.insert(read(offset, width));
+      continue;
+    }
+    ref<Expr> word;
+    for (i = 0; i != bytes; ++i) {
+      unsigned idx = Context::get().isLittleEndian() ? i : (bytes - i - 1);
+      ref<Expr> Byte = read8(at(offset + idx));
+      word = i ? ConcatExpr::create(Byte, word) : Byte;
+    }
+    words.insert(word);
   }
+  storedWords = std::make_shared<const std::vector<ref<Expr>>>(words.begin(),
+                                                               words.end());
+  return *storedWords;
 }
 
 void ObjectStatePlane::print() const {
   llvm::errs() << "-- ObjectState --\n";
-  if (parent)
-    llvm::errs() << "\tMemoryObject ID: " << parent->getObject()->id << "\n";
+  if (object)
+    llvm::errs() << "\tMemoryObject ID: " << object->id << "\n";
   llvm::errs() << "\tRoot Object: " << updates.root << "\n";
   llvm::errs() << "\tSize: " << sizeBound << "\n";
 
@@ -600,14 +1200,20 @@ void ObjectStatePlane::print() const {
 
 /****/
 
+uint64_t ObjectState::versionCounter = 0;
+uint64_t ObjectState::liveObjectStates = 0;
+uint64_t ObjectState::liveObjectStateBytes = 0;
+
 ObjectState::ObjectState(const MemoryObject *mo)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
+    contentsVersion(++versionCounter),
     readOnly(false),
-    segmentPlane(0),
-    offsetPlane(new ObjectStatePlane(this)){
+    offsetPlane(mo) {
   mo->refCount++;
+  ++liveObjectStates;
+  liveObjectStateBytes += object->allocatedSize;
 }
 
 
@@ -615,35 +1221,83 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
+    contentsVersion(++versionCounter),
     readOnly(false),
-    segmentPlane(0),
-    offsetPlane(new ObjectStatePlane(this, array)) {
+    offsetPlane(mo, array) {
   mo->refCount++;
+  ++liveObjectStates;
+  liveObjectStateBytes += object->allocatedSize;
 }
 
 ObjectState::ObjectState(const ObjectState &os)
   : copyOnWriteOwner(0),
     refCount(0),
     object(os.object),
+    contentsVersion(os.contentsVersion),
     readOnly(false),
-    segmentPlane(0),
-    offsetPlane(new ObjectStatePlane(this, *os.offsetPlane)) {
+    segmentPlane(os.segmentPlane),
+    fusedPlane(os.fusedPlane),
+    offsetPlane(os.object, os.offsetPlane) {
+  assert(!os.readOnly && "no need to copy read only object?");
   object->refCount++;
-  if (os.segmentPlane)
-    segmentPlane = new ObjectStatePlane(this, *os.segmentPlane);
+  ++liveObjectStates;
+  liveObjectStateBytes += object->allocatedSize;
 }
 
 ObjectState::ObjectState(const ObjectState &os, const MemoryObject *mo)
-  : ObjectState(os) {
-  object->refCount--;
-  object = mo;
+  : copyOnWriteOwner(0),
+    refCount(0),
+    object(mo),
+    contentsVersion(++versionCounter),
+    readOnly(false),
+    offsetPlane(mo, os.offsetPlane) {
+  assert(!os.readOnly && "no need to copy read only object?");
+  object->refCount++;
+  ++liveObjectStates;
+  liveObjectStateBytes += object->allocatedSize;
+  // planes refer to their memory object, so the segments cannot be shared
+  if (os.segmentPlane)
+    segmentPlane = std::make_shared<ObjectStatePlane>(mo, *os.segmentPlane);
+  if (os.fusedPlane)
+    fusedPlane = std::make_shared<ObjectStatePlane>(mo, *os.fusedPlane);
+}
+
+ObjectState::ObjectState(ObjectState &&os, const MemoryObject *mo)
+  : copyOnWriteOwner(0),
+    refCount(0),
+    object(mo),
+    contentsVersion(++versionCounter),
+    readOnly(false),
+    offsetPlane(mo, std::move(os.offsetPlane)) {
+  assert(!os.readOnly && "no need to copy read only object?");
   object->refCount++;
+  ++liveObjectStates;
+  liveObjectStateBytes += object->allocatedSize;
+  if (os.segmentPlane) {
+    if (os.segmentPlane.use_count() == 1)
+      segmentPlane =
+          std::make_shared<ObjectStatePlane>(mo, std::move(*os.segmentPlane));
+    else
+      segmentPlane = std::make_shared<ObjectStatePlane>(mo, *os.segmentPlane);
+    os.segmentPlane.reset();
+  }
+  if (os.fusedPlane) {
+    if (os.fusedPlane.use_count() == 1)
+      fusedPlane =
+          std::make_shared<ObjectStatePlane>(mo, std::move(*os.fusedPlane));
+    else
+      fusedPlane = std::make_shared<ObjectStatePlane>(mo, *os.fusedPlane);
+    os.fusedPlane.reset();
+  }
 }
 
 ObjectState::~ObjectState() {
-  if (segmentPlane)
-    delete segmentPlane;
-  delete offsetPlane;
+  --liveObjectStates;
+  if (object)
+    liveObjectStateBytes -= object->allocatedSize;
+  // release the (possibly shared) planes before the object goes away
+  segmentPlane.reset();
+  fusedPlane.reset();
   if (object)
   {
     assert(object->refCount > 0);
@@ -656,46 +1310,195 @@ ObjectState::~ObjectState() {
 }
 
 KValue ObjectState::read8(unsigned offset) const {
+  if (fusedPlane)
+    return readFused(offset, Expr::Int8);
   ref<Expr> segment;
   if (segmentPlane) {
     segment = segmentPlane->read8(offset);
   } else {
     segment = ConstantExpr::alloc(0, Expr::Int8);
   }
-  ref<Expr> value = offsetPlane->read8(offset);
+  ref<Expr> value = offsetPlane.read8(offset);
   return KValue(segment, value);
 }
 
 KValue ObjectState::read(unsigned offset, Expr::Width width) const {
+  if (fusedPlane)
+    return readFused(offset, width);
   ref<Expr> segment;
   if (segmentPlane) {
     segment = segmentPlane->read(offset, width);
   } else {
     segment = ConstantExpr::alloc(0, width);
   }
-  ref<Expr> value = offsetPlane->read(offset, width);
+  ref<Expr> value = offsetPlane.read(offset, width);
   return KValue(segment, value);
 }
 
 KValue ObjectState::read(ref<Expr> offset, Expr::Width width) const {
+  if (fusedPlane)
+    return readFused(offset, width, 0, std::numeric_limits<uint64_t>::max());
   ref<Expr> segment;
   if (segmentPlane) {
     segment = segmentPlane->read(offset, width);
   } else {
     segment = ConstantExpr::alloc(0, width);
   }
-  ref<Expr> value = offsetPlane->read(offset, width);
+  ref<Expr> value = offsetPlane.read(offset, width);
+  return KValue(segment, value);
+}
+
+KValue ObjectState::read(ref<Expr> offset, Expr::Width width, uint64_t lo,
+                         uint64_t hi) const {
+  if (fusedPlane)
+    return readFused(offset, width, lo, hi);
+  ref<Expr> segment;
+  if (segmentPlane) {
+    segment = segmentPlane->read(offset, width, lo, hi);
+  } else {
+    segment = ConstantExpr::alloc(0, width);
+  }
+  ref<Expr> value = offsetPlane.read(offset, width, lo, hi);
+  return KValue(segment, value);
+}
+
+/// The index in a fused plane of the offset byte at \p offset.
+static ref<Expr> getFusedIndex(ref<Expr> offset) {
+  return ShlExpr::create(ZExtExpr::create(offset, Expr::Int32),
+                         ConstantExpr::create(1, Expr::Int32));
+}
+
+/// Scale the range [\p lo, \p hi] of offsets to the indices of a fused
+/// plane, or widen it to everything if that would overflow.
+static void getFusedRange(uint64_t &lo, uint64_t &hi) {
+  if (hi <= std::numeric_limits<uint32_t>::max()) {
+    lo *= 2;
+    hi *= 2;
+  } else {
+    lo = 0;
+    hi = std::numeric_limits<uint64_t>::max();
+  }
+}
+
+/// Split the \p width-bit value and segment out of \p bytes, the bytes
+/// read from a fused plane.
+static KValue splitFused(const ref<Expr> &bytes, Expr::Width width) {
+  bool little = Context::get().isLittleEndian();
+  unsigned NumBytes = width == Expr::Bool ? 1 : width / 8;
+  // byte j of the plane is at bit 8j of the read, or 8(2n - 1 - j)
+  auto planeByte = [&](unsigned j) {
+    return ExtractExpr::create(
+        bytes, 8 * (little ? j : 2 * NumBytes - j - 1), Expr::Int8);
+  };
+  ref<Expr> segment, value;
+  for (unsigned i = 0; i != NumBytes; ++i) {
+    unsigned idx = little ? i : (NumBytes - i - 1);
+    ref<Expr> segmentByte = planeByte(2 * idx + 1);
+    ref<Expr> valueByte = planeByte(2 * idx);
+    segment = i ? ConcatExpr::create(segmentByte, segment) : segmentByte;
+    value = i ? ConcatExpr::create(valueByte, value) : valueByte;
+  }
+  if (width == Expr::Bool) {
+    segment = ExtractExpr::create(segment, 0, Expr::Bool);
+    value = ExtractExpr::create(value, 0, Expr::Bool);
+  }
   return KValue(segment, value);
 }
 
+/// The bytes of \p value interleaved with those of its segment, to be
+/// written to a fused plane.
+static ref<Expr> fuseBytes(const KValue &value) {
+  ref<Expr> segment = value.getSegment();
+  ref<Expr> offset = value.getOffset();
+  if (offset->getWidth() == Expr::Bool) {
+    segment = ZExtExpr::create(segment, Expr::Int8);
+    offset = ZExtExpr::create(offset, Expr::Int8);
+  }
+  bool little = Context::get().isLittleEndian();
+  unsigned NumBytes = offset->getWidth() / 8;
+  ref<Expr> Res;
+  for (unsigned i = 0; i != 2 * NumBytes; ++i) {
+    // byte j of the plane holds byte j / 2 of the offset or the segment
+    unsigned j = little ? i : (2 * NumBytes - i - 1);
+    unsigned idx = little ? j / 2 : (NumBytes - j / 2 - 1);
+    ref<Expr> Byte =
+        ExtractExpr::create(j % 2 ? segment : offset, 8 * idx, Expr::Int8);
+    Res = i ? ConcatExpr::create(Byte, Res) : Byte;
+  }
+  return Res;
+}
+
+KValue ObjectState::readFused(unsigned offset, Expr::Width width) const {
+  unsigned NumBytes = width == Expr::Bool ? 1 : width / 8;
+
+  // Fast path: the whole word is concrete, assemble it without expressions.
+  if (NumBytes <= 8) {
+    uint64_t segment = 0, value = 0;
+    unsigned i = 0;
+    for (; i != NumBytes; ++i) {
+      uint8_t segmentByte, valueByte;
+      if (!fusedPlane->getConcreteByte(2 * (offset + i) + 1, segmentByte) ||
+          !fusedPlane->getConcreteByte(2 * (offset + i), valueByte))
+        break;
+      unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+      segment |= (uint64_t) segmentByte << (8 * idx);
+      value |= (uint64_t) valueByte << (8 * idx);
+    }
+    if (i == NumBytes) {
+      if (width == Expr::Bool) {
+        segment &= 1;
+        value &= 1;
+      }
+      return KValue(ConstantExpr::create(segment, width),
+                    ConstantExpr::create(value, width));
+    }
+  }
+
+  return splitFused(fusedPlane->read(2 * offset, 16 * NumBytes), width);
+}
+
+KValue ObjectState::readFused(ref<Expr> offset, Expr::Width width,
+                              uint64_t lo, uint64_t hi) const {
+  // Truncate offset to 32-bits, as the planes do.
+  offset = ZExtExpr::create(offset, Expr::Int32);
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(offset))
+    return readFused(CE->getZExtValue(32), width);
+
+  unsigned NumBytes = width == Expr::Bool ? 1 : width / 8;
+  getFusedRange(lo, hi);
+  return splitFused(
+      fusedPlane->read(getFusedIndex(offset), 16 * NumBytes, lo, hi), width);
+}
+
+void ObjectState::writeFused(unsigned offset, uint64_t segment, uint64_t value,
+                             unsigned NumBytes) {
+  uint8_t bytes[16];
+  for (unsigned i = 0; i != NumBytes; ++i) {
+    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+    bytes[2 * idx] = (uint8_t) (value >> (8 * i));
+    bytes[2 * idx + 1] = (uint8_t) (segment >> (8 * i));
+  }
+  fusedPlane->writeBytes(2 * offset, bytes, 2 * NumBytes);
+}
+
+bool ObjectState::isSplit() const {
+  return SplitObjects && getSizeBound() > SplitObjects &&
+         isa<ConstantExpr>(object->size);
+}
+
 bool ObjectState::prepareSegmentPlane(bool nonzero) {
   if (!segmentPlane) {
     if (nonzero) {
-      segmentPlane = new ObjectStatePlane(this);
+      segmentPlane = std::make_shared<ObjectStatePlane>(object);
       return true;
     }
     return false;
   }
+  // copy-on-write: the plane may still be shared with other copies
+  if (segmentPlane.use_count() > 1)
+    segmentPlane = std::make_shared<ObjectStatePlane>(object, *segmentPlane);
+  else
+    segmentPlane->resetStoredWords();
   return true;
 }
 
@@ -705,51 +1508,306 @@ bool ObjectState::prepareSegmentPlane(ref<Expr> segment) {
   return prepareSegmentPlane(true);
 }
 
+void ObjectState::collapseSegmentPlane() {
+  if (segmentPlane->isKnownZero())
+    segmentPlane.reset();
+}
+
+bool ObjectState::prepareFusedPlane(bool nonzero) {
+  if (!fusedPlane) {
+    // Objects of symbolic contents or size keep separate planes, as do
+    // those that have a segment plane already.
+    if (!nonzero || !FusedPointerLayout || segmentPlane ||
+        offsetPlane.symbolic || !isa<ConstantExpr>(object->size) ||
+        offsetPlane.sizeBound > MaxFusedBytes)
+      return false;
+
+    unsigned size = offsetPlane.sizeBound;
+    fusedPlane = std::make_shared<ObjectStatePlane>(object);
+    fusedPlane->sizeBound = 2 * size;
+    if (offsetPlane.isRangeConcrete(0, size)) {
+      std::vector<uint8_t> bytes(2 * size);
+      for (unsigned i = 0; i != size; ++i)
+        bytes[2 * i] = offsetPlane.getConcreteValue(i);
+      fusedPlane->writeBytes(0, bytes.data(), bytes.size());
+    } else {
+      for (unsigned i = 0; i != size; ++i) {
+        fusedPlane->copyRange(2 * i, offsetPlane, i, 1);
+        fusedPlane->write8(2 * i + 1, 0);
+      }
+    }
+
+    // the offset plane only keeps the size of the object from now on
+    offsetPlane.concreteStore = ConcreteStore();
+    offsetPlane.updates = UpdateList(0, 0);
+    offsetPlane.initialized = true;
+    offsetPlane.initializeToZero();
+    return true;
+  }
+  // copy-on-write: the plane may still be shared with other copies
+  if (fusedPlane.use_count() > 1)
+    fusedPlane = std::make_shared<ObjectStatePlane>(object, *fusedPlane);
+  else
+    fusedPlane->resetStoredWords();
+  return true;
+}
+
+bool ObjectState::prepareFusedPlane(ref<Expr> segment) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(segment))
+    return prepareFusedPlane(!CE->isZero());
+  return prepareFusedPlane(true);
+}
+
 void ObjectState::write8(unsigned offset, uint8_t segment, uint8_t value) {
-  if (prepareSegmentPlane(segment))
+  markDirty();
+  if (prepareFusedPlane(segment)) {
+    writeFused(offset, segment, value, 1);
+    return;
+  }
+  if (prepareSegmentPlane(segment)) {
     segmentPlane->write8(offset, segment);
-  offsetPlane->write8(offset, value);
+    collapseSegmentPlane();
+  }
+  offsetPlane.write8(offset, value);
 }
 
 void ObjectState::write16(unsigned offset, uint16_t segment, uint16_t value) {
-  if (prepareSegmentPlane(segment))
+  markDirty();
+  if (prepareFusedPlane(segment)) {
+    writeFused(offset, segment, value, 2);
+    return;
+  }
+  if (prepareSegmentPlane(segment)) {
     segmentPlane->write16(offset, segment);
-  offsetPlane->write16(offset, value);
+    collapseSegmentPlane();
+  }
+  offsetPlane.write16(offset, value);
 }
 
 void ObjectState::write32(unsigned offset, uint32_t segment, uint32_t value) {
-  if (prepareSegmentPlane(segment))
+  markDirty();
+  if (prepareFusedPlane(segment)) {
+    writeFused(offset, segment, value, 4);
+    return;
+  }
+  if (prepareSegmentPlane(segment)) {
     segmentPlane->write32(offset, segment);
-  offsetPlane->write32(offset, value);
+    collapseSegmentPlane();
+  }
+  offsetPlane.write32(offset, value);
 }
 
 void ObjectState::write64(unsigned offset, uint64_t segment, uint64_t value) {
-  if (prepareSegmentPlane(segment))
+  markDirty();
+  if (prepareFusedPlane(segment)) {
+    writeFused(offset, segment, value, 8);
+    return;
+  }
+  if (prepareSegmentPlane(segment)) {
     segmentPlane->write64(offset, segment);
-  offsetPlane->write64(offset, value);
+    collapseSegmentPlane();
+  }
+  offsetPlane.write64(offset, value);
 }
 
 void ObjectState::write(unsigned offset, const KValue& value) {
-  if (prepareSegmentPlane(value.getSegment()))
+  markDirty();
+  if (prepareFusedPlane(value.getSegment())) {
+    fusedPlane->write(2 * offset, fuseBytes(value));
+    return;
+  }
+  if (prepareSegmentPlane(value.getSegment())) {
     segmentPlane->write(offset, value.getSegment());
-  offsetPlane->write(offset, value.getOffset());
+    collapseSegmentPlane();
+  }
+  offsetPlane.write(offset, value.getOffset());
 }
 
 void ObjectState::write(ref<Expr> offset, const KValue& value) {
-  if (prepareSegmentPlane(value.getSegment()))
-    segmentPlane->write(offset, value.getSegment());
-  offsetPlane->write(offset, value.getOffset());
+  write(offset, value, 0, std::numeric_limits<uint64_t>::max());
+}
+
+void ObjectState::write(ref<Expr> offset, const KValue &value, uint64_t lo,
+                        uint64_t hi) {
+  markDirty();
+  if (prepareFusedPlane(value.getSegment())) {
+    getFusedRange(lo, hi);
+    fusedPlane->write(getFusedIndex(offset), fuseBytes(value), lo, hi);
+    return;
+  }
+  if (prepareSegmentPlane(value.getSegment())) {
+    segmentPlane->write(offset, value.getSegment(), lo, hi);
+    collapseSegmentPlane();
+  }
+  offsetPlane.write(offset, value.getOffset(), lo, hi);
+}
+
+unsigned ObjectState::concretizeArrayBytes(
+    const Array *array,
+    const std::vector<std::pair<unsigned, uint8_t>> &values) {
+  markDirty();
+  return offsetPlane.concretizeArrayBytes(array, values);
+}
+
+void ObjectState::copyRange(unsigned offset, const ObjectState &src,
+                            unsigned srcOffset, unsigned count) {
+  markDirty();
+  if (prepareFusedPlane(src.segmentPlane || src.fusedPlane)) {
+    // after prepareFusedPlane, as src may be this object
+    if (src.fusedPlane) {
+      fusedPlane->copyRange(2 * offset, *src.fusedPlane, 2 * srcOffset,
+                            2 * count);
+      return;
+    }
+    // src is another object then
+    for (unsigned i = 0; i != count; ++i) {
+      fusedPlane->copyRange(2 * (offset + i), src.offsetPlane, srcOffset + i,
+                            1);
+      if (src.segmentPlane)
+        fusedPlane->copyRange(2 * (offset + i) + 1, *src.segmentPlane,
+                              srcOffset + i, 1);
+      else
+        fusedPlane->write8(2 * (offset + i) + 1, 0);
+    }
+    return;
+  }
+  if (prepareSegmentPlane(src.segmentPlane || src.fusedPlane)) {
+    // after prepareSegmentPlane, as src may be this object
+    if (src.segmentPlane) {
+      segmentPlane->copyRange(offset, *src.segmentPlane, srcOffset, count);
+    } else if (src.fusedPlane) {
+      for (unsigned i = 0; i != count; ++i)
+        segmentPlane->copyRange(offset + i, *src.fusedPlane,
+                                2 * (srcOffset + i) + 1, 1);
+    } else {
+      segmentPlane->fill(offset, ConstantExpr::alloc(0, Expr::Int8), count);
+    }
+    collapseSegmentPlane();
+  }
+  if (src.fusedPlane) {
+    for (unsigned i = 0; i != count; ++i)
+      offsetPlane.copyRange(offset + i, *src.fusedPlane, 2 * (srcOffset + i),
+                            1);
+  } else {
+    offsetPlane.copyRange(offset, src.offsetPlane, srcOffset, count);
+  }
+}
+
+void ObjectState::writeBytes(unsigned offset, const uint8_t *src,
+                             unsigned count) {
+  markDirty();
+  if (prepareFusedPlane(false)) {
+    std::vector<uint8_t> bytes(2 * count);
+    for (unsigned i = 0; i != count; ++i)
+      bytes[2 * i] = src[i];
+    fusedPlane->writeBytes(2 * offset, bytes.data(), bytes.size());
+    return;
+  }
+  if (prepareSegmentPlane(false)) {
+    segmentPlane->fill(offset, ConstantExpr::alloc(0, Expr::Int8), count);
+    collapseSegmentPlane();
+  }
+  offsetPlane.writeBytes(offset, src, count);
+}
+
+void ObjectState::fill(unsigned offset, ref<Expr> value, unsigned count) {
+  markDirty();
+  if (prepareFusedPlane(false)) {
+    for (unsigned i = 0; i != count; ++i) {
+      fusedPlane->fill(2 * (offset + i), value, 1);
+      fusedPlane->write8(2 * (offset + i) + 1, 0);
+    }
+    return;
+  }
+  if (prepareSegmentPlane(false)) {
+    segmentPlane->fill(offset, ConstantExpr::alloc(0, Expr::Int8), count);
+    collapseSegmentPlane();
+  }
+  offsetPlane.fill(offset, value, count);
+}
+
+const std::vector<ref<Expr>> &ObjectState::getStoredSegments() const {
+  static const std::vector<ref<Expr>> none;
+  if (fusedPlane)
+    return fusedPlane->getStoredWords(Context::get().getPointerWidth(), 1, 2);
+  if (!segmentPlane)
+    return none;
+  return segmentPlane->getStoredWords(Context::get().getPointerWidth());
 }
 
 void ObjectState::initializeToZero() {
-  offsetPlane->initializeToZero();
+  markDirty();
+  segmentPlane.reset();
+  fusedPlane.reset();
+  offsetPlane.initializeToZero();
 }
 
 void ObjectState::initializeToRandom() {
-  offsetPlane->initializeToRandom();
+  markDirty();
+  segmentPlane.reset();
+  fusedPlane.reset();
+  offsetPlane.initializeToRandom();
 }
 
 ArrayCache* ObjectState::getArrayCache() const {
   assert(object && "object was NULL");
   return object->parent->getArrayCache();
 }
+
+void ObjectState::swapOut(ExprWriter &w) {
+  offsetPlane.swapOut(w);
+  bool ownsSegments = segmentPlane && segmentPlane.use_count() == 1;
+  w.writeInt(ownsSegments);
+  if (ownsSegments)
+    segmentPlane->swapOut(w);
+  bool ownsFused = fusedPlane && fusedPlane.use_count() == 1;
+  w.writeInt(ownsFused);
+  if (ownsFused)
+    fusedPlane->swapOut(w);
+}
+
+void ObjectState::swapIn(ExprReader &r) {
+  offsetPlane.swapIn(r);
+  if (r.readInt())
+    segmentPlane->swapIn(r);
+  if (r.readInt())
+    fusedPlane->swapIn(r);
+}
+
+void ObjectState::copyConcreteTo(uint8_t *dst) const {
+  if (fusedPlane) {
+    for (unsigned i = 0, e = getSizeBound(); i != e; ++i)
+      dst[i] = fusedPlane->getConcreteValue(2 * i);
+    return;
+  }
+  const auto &concreteStore = offsetPlane.concreteStore;
+  concreteStore.copyTo(dst);
+  // the bytes past the concrete store still hold their initial value
+  if (concreteStore.size() < offsetPlane.sizeBound)
+    memset(dst + concreteStore.size(), offsetPlane.initialValue,
+           offsetPlane.sizeBound - concreteStore.size());
+}
+
+bool ObjectState::concreteEquals(const uint8_t *src) const {
+  if (fusedPlane) {
+    for (unsigned i = 0, e = getSizeBound(); i != e; ++i)
+      if (fusedPlane->getConcreteValue(2 * i) != src[i])
+        return false;
+    return true;
+  }
+  return offsetPlane.concreteStore.equals(src);
+}
+
+void ObjectState::copyConcreteFrom(const uint8_t *src) {
+  if (prepareFusedPlane(false)) {
+    auto &concreteStore = fusedPlane->concreteStore;
+    if (concreteStore.size() < fusedPlane->sizeBound)
+      concreteStore.resize(fusedPlane->sizeBound, fusedPlane->initialValue);
+    for (unsigned i = 0, e = getSizeBound(); i != e; ++i)
+      if (concreteStore[2 * i] != src[i])
+        concreteStore.set(2 * i, src[i]);
+  } else {
+    offsetPlane.concreteStore.copyFrom(src);
+  }
+  markDirty();
+}
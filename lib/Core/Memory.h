@@ -13,13 +13,17 @@
 #include "Context.h"
 #include "TimingSolver.h"
 
+#include "klee/Expr/ExprAllocator.h"
 #include "klee/KValue.h"
 #include "klee/util/BitArray.h"
+#include "klee/util/Bits.h"
 
 #include "llvm/ADT/StringExtras.h"
 
-#include <vector>
-#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -30,6 +34,8 @@ namespace llvm {
 namespace klee {
 
 class BitArray;
+class ExprReader;
+class ExprWriter;
 class MemoryManager;
 class Solver;
 class ArrayCache;
@@ -38,12 +44,24 @@ class MemoryObject {
   friend class STPBuilder;
   friend class ObjectState;
   friend class ExecutionState;
+  friend class MemoryManager;
+  template<class T> friend class ref;
 
 private:
-  static int counter;
+  /// Source of object ids, atomic so that ids stay unique should objects
+  /// ever be allocated from more than one thread.
+  static std::atomic<int> counter;
   mutable unsigned refCount;
 
+  /// Neighbours in the list of live objects of the parent MemoryManager.
+  MemoryObject *prevAllocated = nullptr;
+  MemoryObject *nextAllocated = nullptr;
+
 public:
+  /// The id the next object allocated will get; objects with ids below it
+  /// were allocated before.
+  static unsigned getNextId() { return counter; }
+
   unsigned id;
   uint64_t segment;
 
@@ -54,6 +72,20 @@ public:
   uint64_t allocatedSize = 0;
   mutable std::string name;
 
+  /// Real address and ObjectState contents version (see
+  /// ObjectState::contentsVersion) of the last copy out for an external
+  /// call. Zero version means unknown contents at that address.
+  mutable uint64_t copiedOutAddress = 0;
+  mutable uint64_t copiedOutVersion = 0;
+
+  /// Shared segment constant of this object, see getSegmentExpr.
+  mutable ref<ConstantExpr> segmentExpr;
+
+  /// Upper limit on offsets of the last access width checked, see
+  /// getBoundsCheckOffset.
+  mutable unsigned boundsLimitBytes = 0;
+  mutable ref<Expr> boundsLimit;
+
   bool isLocal;
   mutable bool isGlobal;
   bool isFixed;
@@ -73,9 +105,6 @@ public:
   /// should sensibly be only at creation time).
   mutable std::vector< ref<Expr> > cexPreferences;
 
-  /// Symbolic address for poiner comparison
-  llvm::Optional<const Array*> symbolicAddress;
-
   // DO NOT IMPLEMENT
   MemoryObject(const MemoryObject &b);
   MemoryObject &operator=(const MemoryObject &b);
@@ -131,19 +160,16 @@ public:
 
   ~MemoryObject();
 
+  static void *operator new(size_t size) {
+    return ExprAllocator::allocate(size);
+  }
+  static void operator delete(void *p, size_t size) {
+    ExprAllocator::deallocate(p, size);
+  }
+
   /// Get an identifying string for this allocation.
   void getAllocInfo(std::string &result) const;
 
-  /// Initializes symbolic array
-  /// \param array ArrayCache for Creatin the symbolic array
-  void initializeSymbolicArray(klee::ArrayCache &array);
-
-  /// If not initialized, creates symbolic array representing it's address
-  /// and returns ref<Expr> for it
-  /// \param array ArrayCache for creating the symbolic array
-  /// @return symbolic array representing symbolic address of given MO
-  ref<Expr> getSymbolicAddress(klee::ArrayCache &array);
-
   void setName(std::string name) const {
     this->name = name;
   }
@@ -152,7 +178,9 @@ public:
     return segment;
   }
   ref<ConstantExpr> getSegmentExpr() const {
-    return ConstantExpr::create(segment, Context::get().getPointerWidth());
+    if (segmentExpr.isNull())
+      segmentExpr = ConstantExpr::create(segment, Context::get().getPointerWidth());
+    return segmentExpr;
   }
   ref<ConstantExpr> getBaseExpr() const { 
     return ConstantExpr::create(0, Context::get().getPointerWidth());
@@ -190,92 +218,216 @@ public:
             getBoundsCheckOffset(pointer.getOffset(), bytes));
   }
   ref<Expr> getBoundsCheckOffset(ref<Expr> offset) const {
-    if (isa<ConstantExpr>(size) && cast<ConstantExpr>(size)->isZero()) {
-      return EqExpr::create(offset,
-                            ConstantExpr::alloc(0, Context::get().getPointerWidth()));
-    } else {
-      return UltExpr::create(offset, getSizeExpr());
+    if (ConstantExpr *CS = dyn_cast<ConstantExpr>(size)) {
+      if (ConstantExpr *CO = dyn_cast<ConstantExpr>(offset)) {
+        uint64_t limit = CS->getZExtValue();
+        uint64_t value = CO->getZExtValue();
+        return ConstantExpr::alloc(limit ? value < limit : value == 0,
+                                   Expr::Bool);
+      }
+      if (CS->isZero())
+        return EqExpr::create(offset,
+                              ConstantExpr::alloc(0, Context::get().getPointerWidth()));
     }
+    return UltExpr::create(offset, getSizeExpr());
   }
   ref<Expr> getBoundsCheckOffset(ref<Expr> offset, unsigned bytes) const {
-    return UltExpr::create(offset,
-                           SubExpr::create(size,
-                                           ConstantExpr::alloc(bytes - 1,
-                                                               size->getWidth())));
+    if (ConstantExpr *CS = dyn_cast<ConstantExpr>(size)) {
+      if (ConstantExpr *CO = dyn_cast<ConstantExpr>(offset)) {
+        // same wrap-around as the expression below
+        uint64_t limit = bits64::truncateToNBits(
+            CS->getZExtValue() - uint64_t(bytes - 1), size->getWidth());
+        return ConstantExpr::alloc(CO->getZExtValue() < limit, Expr::Bool);
+      }
+    }
+    if (boundsLimitBytes != bytes || boundsLimit.isNull()) {
+      boundsLimit = SubExpr::create(size,
+                                    ConstantExpr::alloc(bytes - 1,
+                                                        size->getWidth()));
+      boundsLimitBytes = bytes;
+    }
+    return UltExpr::create(offset, boundsLimit);
   }
 
 private:
   ref<Expr> getBoundsCheckSegment(ref<Expr> segment) const {
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(segment))
+      return ConstantExpr::alloc(CE->getZExtValue() == this->segment,
+                                 Expr::Bool);
     return EqExpr::create(getSegmentExpr(), segment);
   }
 };
 
-// up to some offset this container is implemented
-// as a vector and from some offset as a map
-// (leveraging the assumption that large offsets will
-// be sparse). Threshold is the maximal number of elements
-// in the vector.
+// A two-level radix table: the offset selects a chunk of entries and the
+// slot in it. Chunks are allocated only when a non-null value is stored
+// into them, and only grow up to the highest slot stored, so a single
+// symbolic byte does not cost a whole chunk. They are shared between
+// copies of the vector until one of the copies writes to them.
 // This class is specialized for our needs, it is not generic...
-template <typename T, const size_t Threshold = (1 << 18)>
+template <typename T, const unsigned ChunkBits = 12>
 class SparseVector {
-    std::vector<T> _vector;
-    std::unordered_map<size_t, T> _map;
+    static const size_t ChunkSize = 1 << ChunkBits;
+    typedef std::vector<T> Chunk;
+
+    std::vector<std::shared_ptr<Chunk> > _chunks;
+
+    const T *getSlot(size_t n) const {
+        size_t idx = n >> ChunkBits, slot = n & (ChunkSize - 1);
+        if (idx >= _chunks.size() || !_chunks[idx] ||
+            slot >= _chunks[idx]->size())
+            return nullptr;
+        return &(*_chunks[idx])[slot];
+    }
 
 public:
     const T& operator[](size_t n) const {
-        if (n < Threshold) {
-            assert(n < _vector.size());
-            assert(_vector[n].get() != nullptr && "Use has() before");
-            return _vector[n];
-        } else {
-            auto it = _map.find(n);
-            if (it == _map.end()) {
-                assert(false && "Cannot happen, must use has() before");
-                abort();
-            }
-            assert(it->second.get() != nullptr);
-            return it->second;
-        }
+        const T *slot = getSlot(n);
+        assert(slot && "Cannot happen, must use has() before");
+        assert(slot->get() != nullptr && "Use has() before");
+        return *slot;
     }
 
     void set(size_t n, const T& val) {
-        if (n < Threshold) {
-            if (_vector.size() <= n) {
-              if (val.get() == nullptr) {
+        size_t idx = n >> ChunkBits, slot = n & (ChunkSize - 1);
+        if (idx >= _chunks.size() || !_chunks[idx]) {
+            if (val.get() == nullptr)
                 return;
-              }
-              // make sure the access will be valid
-              _vector.resize(n + 1);
-            }
-
-            assert(_vector.size() > n);
-            _vector[n] = val;
-        } else {
-            if (val.get() == nullptr) {
-                _map.erase(n);
-            } else
-                _map[n] = val;
+            if (idx >= _chunks.size())
+                _chunks.resize(idx + 1);
+            _chunks[idx] = std::make_shared<Chunk>();
+        } else if (slot >= _chunks[idx]->size() && val.get() == nullptr) {
+            return;
+        } else if (_chunks[idx].use_count() > 1) {
+            _chunks[idx] = std::make_shared<Chunk>(*_chunks[idx]);
         }
+        Chunk &chunk = *_chunks[idx];
+        if (slot >= chunk.size())
+            chunk.resize(slot + 1);
+        chunk[slot] = val;
     }
 
     void clear() {
-        _vector.clear();
-        _map.clear();
+        _chunks.clear();
     }
 
     bool has(size_t n) const {
-        return (_vector.size() > n && _vector[n].get())
-               || (_map.find(n) != _map.end());
+        const T *slot = getSlot(n);
+        return slot && slot->get();
+    }
+
+    /// Call \p f(offset, value) for every non-null entry, in increasing
+    /// order of offsets.
+    template <typename F>
+    void forEach(F f) const {
+        for (size_t idx = 0, e = _chunks.size(); idx != e; ++idx) {
+            const Chunk *chunk = _chunks[idx].get();
+            if (!chunk)
+                continue;
+            for (size_t i = 0, n = chunk->size(); i != n; ++i)
+                if ((*chunk)[i].get())
+                    f((idx << ChunkBits) + i, (*chunk)[i]);
+        }
+    }
+};
+
+/// Concrete bytes of an ObjectStatePlane, split into fixed-size pages.
+/// Pages are shared between copies of the store and cloned only when one
+/// of the copies writes to them, so a write after a fork copies a single
+/// page instead of the whole object. Pages never written are not allocated
+/// and hold the fill value the store was grown with, so a large zeroed
+/// object only takes memory for the pages it uses.
+class ConcreteStore {
+public:
+  static const unsigned PageBits = 12;
+  static const size_t PageSize = 1 << PageBits;
+
+private:
+  typedef std::vector<uint8_t> Page;
+
+  /// The pages, null for the ones holding only \ref fill.
+  std::vector<std::shared_ptr<Page> > pages;
+  size_t _size = 0;
+  uint8_t fill = 0;
+
+  size_t pageLength(size_t index) const {
+    return std::min(PageSize, _size - (index << PageBits));
+  }
+  Page &getWriteablePage(size_t index) {
+    if (!pages[index])
+      pages[index] = std::make_shared<Page>(pageLength(index), fill);
+    else if (pages[index].use_count() > 1)
+      clonePage(index);
+    return *pages[index];
+  }
+  void clonePage(size_t index);
+
+public:
+  size_t size() const { return _size; }
+
+  uint8_t operator[](size_t n) const {
+    assert(n < _size);
+    const auto &page = pages[n >> PageBits];
+    return page ? (*page)[n & (PageSize - 1)] : fill;
+  }
+
+  void set(size_t n, uint8_t value) {
+    assert(n < _size);
+    getWriteablePage(n >> PageBits)[n & (PageSize - 1)] = value;
+  }
+
+  void resize(size_t n, uint8_t value);
+
+  /// Copy the \p n bytes at \p offset to \p dst.
+  void read(size_t offset, uint8_t *dst, size_t n) const {
+    assert(offset + n <= _size);
+    while (n) {
+      size_t in = offset & (PageSize - 1);
+      size_t len = std::min(n, PageSize - in);
+      if (const auto &page = pages[offset >> PageBits])
+        memcpy(dst, page->data() + in, len);
+      else
+        memset(dst, fill, len);
+      dst += len;
+      offset += len;
+      n -= len;
+    }
+  }
+
+  /// Overwrite the \p n bytes at \p offset with \p src.
+  void write(size_t offset, const uint8_t *src, size_t n) {
+    assert(offset + n <= _size);
+    while (n) {
+      size_t in = offset & (PageSize - 1);
+      size_t len = std::min(n, PageSize - in);
+      memcpy(getWriteablePage(offset >> PageBits).data() + in, src, len);
+      src += len;
+      offset += len;
+      n -= len;
     }
+  }
+
+  /// Return the number of bytes which are not zero.
+  size_t countNonZero() const;
+  /// Copy the whole store to the contiguous buffer \p dst.
+  void copyTo(uint8_t *dst) const;
+  /// Overwrite the store with the contents of \p src. Only pages whose
+  /// contents differ are unshared.
+  void copyFrom(const uint8_t *src);
+  /// Return true if the store matches the contents of \p src.
+  bool equals(const uint8_t *src) const;
 };
 
+/// One byte plane (segments or offsets) of an ObjectState. A plane only
+/// refers to the MemoryObject it describes, not to the owning ObjectState,
+/// so that it can be shared between copies of the same object.
 class ObjectStatePlane {
 private:
   friend class AddressSpace;
+  friend class ObjectState;
 
-  const ObjectState *parent;
+  const MemoryObject *object;
 
-  std::vector<uint8_t> concreteStore;
+  ConcreteStore concreteStore;
 
   // XXX cleanup name of flushMask (its backwards or something)
   BitArray concreteMask;
@@ -288,6 +440,20 @@ private:
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
 
+  /// Size of the update list at which compactUpdates() is tried next.
+  mutable unsigned compactionSize;
+
+  /// Number of bytes that are not known to be concrete zero. Only
+  /// maintained while tracksZeroBytes() holds.
+  unsigned nonZeroBytes;
+
+  /// Set once the plane was flushed for a symbolic-offset write; after that
+  /// the contents are tracked only in the update list.
+  bool flushedForWrite;
+
+  /// Result of getStoredWords, until the plane is written.
+  mutable std::shared_ptr<const std::vector<ref<Expr>>> storedWords;
+
 public:
   unsigned sizeBound;
 
@@ -300,13 +466,15 @@ public:
   /// Create a new object state for the given memory object with concrete
   /// contents. The initial contents are undefined, it is the callers
   /// responsibility to initialize the object contents appropriately.
-  ObjectStatePlane(const ObjectState *parent);
+  ObjectStatePlane(const MemoryObject *object);
 
   /// Create a new object state for the given memory object with symbolic
   /// contents.
-  ObjectStatePlane(const ObjectState *parent, const Array *array);
+  ObjectStatePlane(const MemoryObject *object, const Array *array);
 
-  ObjectStatePlane(const ObjectState *parent, const ObjectStatePlane &os);
+  ObjectStatePlane(const MemoryObject *object, const ObjectStatePlane &os);
+  /// Take over the contents of \p os, which must not be used afterwards.
+  ObjectStatePlane(const MemoryObject *object, ObjectStatePlane &&os);
   ~ObjectStatePlane();
 
   // make contents all concrete and zero
@@ -315,19 +483,77 @@ public:
   void initializeToRandom();
 
   ref<Expr> read(ref<Expr> offset, Expr::Width width) const;
+  /// Read at \p offset, which is known to lie in [\p lo, \p hi]. With
+  /// -split-objects, the read only refers to the windows of the plane
+  /// covering that range instead of the whole plane.
+  ref<Expr> read(ref<Expr> offset, Expr::Width width, uint64_t lo,
+                 uint64_t hi) const;
   ref<Expr> read(unsigned offset, Expr::Width width) const;
   ref<Expr> read8(unsigned offset) const;
 
   // return bytes written.
   void write(unsigned offset, ref<Expr> value);
   void write(ref<Expr> offset, ref<Expr> value);
+  /// Write at \p offset, which is known to lie in [\p lo, \p hi]. With
+  /// -split-objects, only the bytes the write may reach are flushed to the
+  /// update list, the others stay concrete.
+  void write(ref<Expr> offset, ref<Expr> value, uint64_t lo, uint64_t hi);
 
   void write8(unsigned offset, uint8_t value);
+  /// Write the \p count concrete bytes at \p src to \p offset, as one
+  /// copy if they are concrete already.
+  void writeBytes(unsigned offset, const uint8_t *src, unsigned count);
   void write16(unsigned offset, uint16_t value);
   void write32(unsigned offset, uint32_t value);
   void write64(unsigned offset, uint64_t value);
+
+  /// Copy \p count bytes at \p srcOffset of \p src to \p offset, as if by
+  /// byte writes: concrete bytes stay concrete and symbolic bytes are
+  /// shared as expressions. \p src may be this plane, overlapping ranges
+  /// are copied as by memmove.
+  /// Number of writes kept in the update list.
+  unsigned getUpdateListLength() const { return updates.getSize(); }
+
+  void copyRange(unsigned offset, const ObjectStatePlane &src,
+                 unsigned srcOffset, unsigned count);
+  /// Write the byte \p value to \p count bytes at \p offset.
+  void fill(unsigned offset, ref<Expr> value, unsigned count);
+
+  /// Make the bytes at the offsets of \p values that still hold the byte
+  /// of \p array at the same offset concrete, with the value given. Runs
+  /// of consecutive bytes are written to the concrete store at once.
+  /// \p values must be sorted by offset. Return the number of bytes made
+  /// concrete.
+  unsigned
+  concretizeArrayBytes(const Array *array,
+                       const std::vector<std::pair<unsigned, uint8_t>> &values);
+
+  /// Return true and set \p value if the byte at \p offset is concrete.
+  bool getConcreteByte(unsigned offset, uint8_t &value) const {
+    if (!isByteConcrete(offset))
+      return false;
+    value = getConcreteValue(offset);
+    return true;
+  }
   void print() const;
 
+  /// The distinct non-zero values of the \p width-bit words at multiples
+  /// of their size, computed on the first call after a write. For the
+  /// segment plane, these are the segments of the pointers stored in the
+  /// object. The words are made of every \p stride-th byte starting at
+  /// \p first, for the segments of a fused plane.
+  const std::vector<ref<Expr>> &getStoredWords(Expr::Width width,
+                                               unsigned first = 0,
+                                               unsigned stride = 1) const;
+  /// Forget the result of getStoredWords, for a write to the plane.
+  void resetStoredWords() { storedWords.reset(); }
+
+  /// Return true if every byte of the plane is known to be concrete zero,
+  /// i.e. the plane carries no information and can be dropped.
+  bool isKnownZero() const {
+    return tracksZeroBytes() && nonZeroBytes == 0;
+  }
+
   /*
     Looks at all the symbolic bytes of this object, gets a value for them
     from the solver and puts them in the concreteStore.
@@ -335,8 +561,21 @@ public:
   void flushToConcreteStore(TimingSolver *solver,
                             const ExecutionState &state);
 
+  /// Write the contents (bytes, masks and symbolic values) to \p w and
+  /// release them. The plane cannot be used until swapIn() is called.
+  void swapOut(ExprWriter &w);
+  void swapIn(ExprReader &r);
+
 private:
+  ArrayCache *getArrayCache() const;
   const UpdateList &getUpdates() const;
+  /// Build an update list over the bytes in [\p begin, \p end) only,
+  /// indexed from \p begin. Return false if some byte is only known
+  /// through an update list over a symbolic array.
+  bool getWindow(unsigned begin, unsigned end, UpdateList &window) const;
+  /// Fold the oldest updates at constant indices of constant values into a
+  /// new constant array.
+  void compactUpdates() const;
 
   void makeConcrete();
 
@@ -345,7 +584,9 @@ private:
   void write8(ref<Expr> offset, ref<Expr> value);
 
   void flushForRead() const;
-  void flushForWrite();
+  /// Move the bytes in [\p begin, \p end) to the update list for a write
+  /// at a symbolic offset that can only reach them.
+  void flushForWrite(unsigned begin, unsigned end);
 
   bool isByteConcrete(unsigned offset) const;
   bool isByteFlushed(unsigned offset) const;
@@ -357,6 +598,12 @@ private:
   void markByteUnflushed(unsigned offset) const;
   void setKnownSymbolic(unsigned offset, Expr *value);
   uint8_t getConcreteValue(unsigned offset) const;
+  bool isByteKnownZero(unsigned offset) const;
+  bool isRangeConcrete(unsigned offset, unsigned count) const;
+  void writeConcrete(unsigned offset, uint64_t value, unsigned NumBytes);
+  bool tracksZeroBytes() const {
+    return !symbolic && initialValue == 0 && !flushedForWrite;
+  }
 };
 
 class ObjectState {
@@ -369,13 +616,33 @@ private:
 
   const MemoryObject *object;
 
+  /// Identifies the current contents: refreshed on every write and kept by
+  /// copies, so equal versions imply equal contents.
+  mutable uint64_t contentsVersion;
+  static uint64_t versionCounter;
+
+  void markDirty() const { contentsVersion = ++versionCounter; }
 
 public:
   bool readOnly;
 
 private:
-  ObjectStatePlane *segmentPlane;
-  ObjectStatePlane *offsetPlane;
+  /// Segments of the stored bytes. The plane is created lazily on the first
+  /// write of a non-zero segment and dropped again once every byte is back
+  /// to VALUES_SEGMENT, so a null plane stands for all-zero segments. It is
+  /// shared between copies of the object and copied only on write.
+  std::shared_ptr<ObjectStatePlane> segmentPlane;
+  /// With -fused-pointer-layout, the offsets and segments of the stored
+  /// bytes interleaved in one plane, the offset of byte i at 2i and its
+  /// segment at 2i + 1, so that a pointer is read through one update list
+  /// instead of two. It replaces the segment plane on the first write of a
+  /// non-zero segment; the offset plane then only keeps the size. Shared
+  /// and copied on write like the segment plane.
+  std::shared_ptr<ObjectStatePlane> fusedPlane;
+  /// Offsets of the stored bytes, part of the object state itself to save
+  /// an allocation per object. Its destruction does not refer to the
+  /// memory object, so it may outlive it by the end of ~ObjectState.
+  ObjectStatePlane offsetPlane;
 
 public:
   /// Create a new object state for the given memory object with concrete
@@ -390,8 +657,20 @@ public:
   ObjectState(const ObjectState &os);
   // Copy for realloc
   ObjectState(const ObjectState &os, const MemoryObject *mo);
+
+  /// Take over the contents of \p os for \p mo without copying them, for
+  /// an object reallocated in place. \p os must not be shared with other
+  /// address spaces and is left empty.
+  ObjectState(ObjectState &&os, const MemoryObject *mo);
   ~ObjectState();
 
+  static void *operator new(size_t size) {
+    return ExprAllocator::allocate(size);
+  }
+  static void operator delete(void *p, size_t size) {
+    ExprAllocator::deallocate(p, size);
+  }
+
   const MemoryObject *getObject() const { return object; }
 
   void setReadOnly(bool ro) {
@@ -400,7 +679,25 @@ public:
 
   // get upper bound on the size of this object if it is known
   uint64_t getSizeBound() const {
-    return offsetPlane->sizeBound;
+    return fusedPlane ? fusedPlane->sizeBound / 2 : offsetPlane.sizeBound;
+  }
+
+  /// Number of object states alive and the sum of the allocated sizes of
+  /// their objects.
+  static uint64_t liveObjectStates;
+  static uint64_t liveObjectStateBytes;
+
+  /// Number of writes kept in the update lists of the planes.
+  unsigned getUpdateListLength() const {
+    return offsetPlane.getUpdateListLength() +
+           (segmentPlane ? segmentPlane->getUpdateListLength() : 0) +
+           (fusedPlane ? fusedPlane->getUpdateListLength() : 0);
+  }
+
+  /// Approximate size of the contents, counting the segment plane, which
+  /// may be shared with copies.
+  uint64_t getContentsBytes() const {
+    return getSizeBound() * (segmentPlane || fusedPlane ? 2 : 1);
   }
 
   // make contents all concrete and zero
@@ -408,29 +705,103 @@ public:
   // make contents all concrete and random
   void initializeToRandom();
 
+  /// The segments of the pointers stored in the object, i.e. the edges of
+  /// the points-to graph leaving it. They are computed once for every
+  /// version of the segment plane, which copies of the object share.
+  const std::vector<ref<Expr>> &getStoredSegments() const;
+
   void flushToConcreteStore(TimingSolver *solver,
-                            const ExecutionState &state) const {
-    offsetPlane->flushToConcreteStore(solver, state);
+                            const ExecutionState &state) {
+    if (prepareFusedPlane(false))
+      fusedPlane->flushToConcreteStore(solver, state);
+    else
+      offsetPlane.flushToConcreteStore(solver, state);
+    markDirty();
   }
 
+  /// Copy the concrete offset bytes to \p dst, for an external call.
+  void copyConcreteTo(uint8_t *dst) const;
+  /// Return true if the concrete offset bytes equal those at \p src.
+  bool concreteEquals(const uint8_t *src) const;
+  /// Overwrite the concrete offset bytes with those at \p src, after an
+  /// external call.
+  void copyConcreteFrom(const uint8_t *src);
+
   KValue read(ref<Expr> offset, Expr::Width width) const;
+  /// Read at \p offset, known to lie in [\p lo, \p hi], see
+  /// ObjectStatePlane::read.
+  KValue read(ref<Expr> offset, Expr::Width width, uint64_t lo,
+              uint64_t hi) const;
   KValue read(unsigned offset, Expr::Width width) const;
   KValue read8(unsigned offset) const;
 
+  /// Return true if accesses at symbolic offsets are worth bounding for
+  /// -split-objects, i.e. the object spans several windows.
+  bool isSplit() const;
+
+  /// Make the bytes that still hold the bytes of \p array, the array the
+  /// object was made symbolic with, concrete where \p values implies their
+  /// value, see ObjectStatePlane::concretizeArrayBytes.
+  unsigned
+  concretizeArrayBytes(const Array *array,
+                       const std::vector<std::pair<unsigned, uint8_t>> &values);
+
   // return bytes written.
   void write(unsigned offset, const KValue &value);
   void write(ref<Expr> offset, const KValue &value);
+  /// Write at \p offset, known to lie in [\p lo, \p hi], see
+  /// ObjectStatePlane::write.
+  void write(ref<Expr> offset, const KValue &value, uint64_t lo, uint64_t hi);
 
   void write8(unsigned offset, uint8_t segment, uint8_t value);
   void write16(unsigned offset, uint16_t segment, uint16_t value);
   void write32(unsigned offset, uint32_t segment, uint32_t value);
   void write64(unsigned offset, uint64_t segment, uint64_t value);
 
+  /// Copy \p count bytes, segments included, at \p srcOffset of \p src to
+  /// \p offset, see ObjectStatePlane::copyRange.
+  void copyRange(unsigned offset, const ObjectState &src, unsigned srcOffset,
+                 unsigned count);
+  /// Write the \p count concrete value bytes at \p src with null segments
+  /// to \p offset.
+  void writeBytes(unsigned offset, const uint8_t *src, unsigned count);
+  /// Write \p count value bytes \p value with a null segment to \p offset.
+  void fill(unsigned offset, ref<Expr> value, unsigned count);
+
+  /// Return true and set \p value if the byte at \p offset is a concrete
+  /// value, i.e. a concrete byte with a null segment.
+  bool getConcreteByte(unsigned offset, uint8_t &value) const {
+    uint8_t segment;
+    if (fusedPlane)
+      return fusedPlane->getConcreteByte(2 * offset + 1, segment) &&
+             !segment && fusedPlane->getConcreteByte(2 * offset, value);
+    if (segmentPlane &&
+        (!segmentPlane->getConcreteByte(offset, segment) || segment))
+      return false;
+    return offsetPlane.getConcreteByte(offset, value);
+  }
+
   ArrayCache *getArrayCache() const;
 
+  /// Move the contents to \p w, see ObjectStatePlane::swapOut. A segment
+  /// plane shared with other copies of the object stays in memory.
+  void swapOut(ExprWriter &w);
+  void swapIn(ExprReader &r);
+
 private:
   bool prepareSegmentPlane(bool nonzero);
   bool prepareSegmentPlane(ref<Expr> value);
+  void collapseSegmentPlane();
+
+  /// Make the fused plane writeable, switching to it first if \p nonzero
+  /// and -fused-pointer-layout allow. Return false if it is not in use.
+  bool prepareFusedPlane(bool nonzero);
+  bool prepareFusedPlane(ref<Expr> segment);
+  KValue readFused(unsigned offset, Expr::Width width) const;
+  KValue readFused(ref<Expr> offset, Expr::Width width, uint64_t lo,
+                   uint64_t hi) const;
+  void writeFused(unsigned offset, uint64_t segment, uint64_t value,
+                  unsigned bytes);
 };
   
 } // End klee namespace
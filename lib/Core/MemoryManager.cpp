@@ -10,6 +10,7 @@
 #include "MemoryManager.h"
 
 #include "CoreStats.h"
+#include "EventTrace.h"
 #include "Memory.h"
 
 #include "klee/Expr/Expr.h"
@@ -56,6 +57,24 @@ llvm::cl::opt<unsigned long long> DeterministicStartAddress(
     llvm::cl::desc("Start address for deterministic allocation. Has to be page "
                    "aligned (default=0x7ff30000000)"),
     llvm::cl::init(0x7ff30000000), llvm::cl::cat(MemoryCat));
+
+llvm::cl::opt<bool> RecycleSegments(
+    "recycle-segments",
+    llvm::cl::desc("Reuse the segments of objects that no state refers to "
+                   "any more, smallest first. A dangling pointer that no "
+                   "state recorded (e.g. to a popped stack frame) may then "
+                   "alias a later allocation (default=false)"),
+    llvm::cl::init(false), llvm::cl::cat(MemoryCat));
+
+llvm::cl::opt<bool> ReallocInPlace(
+    "realloc-in-place",
+    llvm::cl::desc("Let realloc of an object without a concrete or symbolic "
+                   "address keep its segment and move its contents instead "
+                   "of copying them. Pointers to the old object then point "
+                   "into the new one, as after an in-place realloc, so uses "
+                   "of them after the realloc are not reported "
+                   "(default=false)"),
+    llvm::cl::init(false), llvm::cl::cat(MemoryCat));
 } // namespace
 
 MmapAllocation::MmapAllocation(size_t spacesize, void *expectedAddr, int flgs)
@@ -218,13 +237,31 @@ MemoryManager::MemoryManager(ArrayCache *_arrayCache, unsigned pointerWidth)
       lastSegment(FIRST_ORDINARY_SEGMENT) {}
 
 MemoryManager::~MemoryManager() {
-  while (!objects.empty()) {
-    MemoryObject *mo = *objects.begin();
-    objects.erase(mo);
+  while (MemoryObject *mo = objects) {
+    unlink(mo);
+    mo->parent = nullptr;
     delete mo;
   }
 }
 
+void MemoryManager::link(MemoryObject *mo) {
+  mo->prevAllocated = nullptr;
+  mo->nextAllocated = objects;
+  if (objects)
+    objects->prevAllocated = mo;
+  objects = mo;
+}
+
+void MemoryManager::unlink(MemoryObject *mo) {
+  if (mo->prevAllocated)
+    mo->prevAllocated->nextAllocated = mo->nextAllocated;
+  else
+    objects = mo->nextAllocated;
+  if (mo->nextAllocated)
+    mo->nextAllocated->prevAllocated = mo->prevAllocated;
+  mo->prevAllocated = mo->nextAllocated = nullptr;
+}
+
 MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
                                       bool isGlobal,
                                       const llvm::Value *allocSite,
@@ -270,10 +307,28 @@ MemoryObject *MemoryManager::allocate(ref<Expr> size, bool isLocal,
   }
 
   ++stats::allocations;
-  MemoryObject *res = new MemoryObject(++lastSegment,
+  MemoryObject *res = new MemoryObject(nextSegment(),
                                        size, concreteSize,
                                        isLocal, isGlobal, false, allocSite, this);
-  objects.insert(res);
+  EventTrace::record(TraceEvent::Allocate, nullptr, concreteSize);
+  link(res);
+  return res;
+}
+
+MemoryObject *MemoryManager::reallocate(const MemoryObject *mo,
+                                        uint64_t size) {
+  if (!ReallocInPlace || size > 10 * 1024 * 1024)
+    return nullptr;
+
+  ++stats::allocations;
+  ref<Expr> sizeExpr =
+      ConstantExpr::alloc(size, Context::get().getPointerWidth());
+  MemoryObject *res = new MemoryObject(
+      mo->segment, sizeExpr, std::max(size, (uint64_t)1), mo->isLocal,
+      mo->isGlobal, false, mo->allocSite, this);
+  ++sharedSegments[mo->segment];
+  EventTrace::record(TraceEvent::Allocate, nullptr, size);
+  link(res);
   return res;
 }
 
@@ -284,7 +339,7 @@ MemoryObject *MemoryManager::allocateFixed(uint64_t size,
   MemoryObject *res;
   if (!specialSegment) {
     res =
-        new MemoryObject(++lastSegment, sizeExpr, size,
+        new MemoryObject(nextSegment(), sizeExpr, size,
                          false, true, true, allocSite, this);
   }
   else {
@@ -292,14 +347,34 @@ MemoryObject *MemoryManager::allocateFixed(uint64_t size,
         new MemoryObject(specialSegment, sizeExpr, size,
                          false, true, true, allocSite, this);
   }
-  objects.insert(res);
+  link(res);
   return res;
 }
 
 void MemoryManager::deallocate(const MemoryObject *mo) { assert(0); }
 
+uint64_t MemoryManager::nextSegment() {
+  if (freeSegments.empty())
+    return ++lastSegment;
+  uint64_t segment = freeSegments.top();
+  freeSegments.pop();
+  return segment;
+}
+
 void MemoryManager::markFreed(MemoryObject *mo) {
-  objects.erase(mo);
+  unlink(mo);
+  auto shared = sharedSegments.find(mo->segment);
+  if (shared != sharedSegments.end()) {
+    // another object was reallocated in place with this segment
+    if (--shared->second == 0)
+      sharedSegments.erase(shared);
+    return;
+  }
+  // the object is gone from every state, including their records of freed
+  // objects and address layouts, so its segment can be handed out again
+  if (RecycleSegments && mo->segment > FIRST_ORDINARY_SEGMENT &&
+      mo->segment <= lastSegment)
+    freeSegments.push(mo->segment);
 }
 
 size_t MemoryManager::getUsedDeterministicSize() const {
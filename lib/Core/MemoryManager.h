@@ -11,7 +11,10 @@
 #define KLEE_MEMORYMANAGER_H
 
 #include <cstddef>
+#include <functional>
+#include <queue>
 #include <set>
+#include <unordered_map>
 #include <vector>
 #include <cstdint>
 
@@ -83,12 +86,24 @@ public:
 
 class MemoryManager {
 private:
-  typedef std::set<MemoryObject *> objects_ty;
-  objects_ty objects;
+  /// Head of the intrusive list of live objects, linked through
+  /// MemoryObject::prevAllocated and nextAllocated.
+  MemoryObject *objects{nullptr};
+
+  void link(MemoryObject *mo);
+  void unlink(MemoryObject *mo);
   ArrayCache *const arrayCache;
 
   MemoryAllocator allocator;
   uint64_t lastSegment;
+  /// Segments of deleted objects for reuse, see -recycle-segments.
+  std::priority_queue<uint64_t, std::vector<uint64_t>,
+                      std::greater<uint64_t> > freeSegments;
+  /// For segments several live objects were given by reallocate(), the
+  /// number of those objects besides the first.
+  std::unordered_map<uint64_t, unsigned> sharedSegments;
+
+  uint64_t nextSegment();
 public:
   MemoryManager(ArrayCache *arrayCache,
                 unsigned pointerWidth = 64);
@@ -102,6 +117,13 @@ public:
                          const llvm::Value *allocSite, size_t alignment);
   MemoryObject *allocate(ref<Expr> size, bool isLocal, bool isGlobal,
                          const llvm::Value *allocSite, size_t alignment);
+  /// Create an object of the given size in place of \a mo, which keeps its
+  /// segment, so that pointers to \a mo point into it. The segment is
+  /// not recycled before all objects with it are gone.
+  ///
+  /// \return null if objects are not reallocated in place
+  /// (-realloc-in-place) or the size is too large to be.
+  MemoryObject *reallocate(const MemoryObject *mo, uint64_t size);
   MemoryObject *allocateFixed(uint64_t size,
                               const llvm::Value *allocSite, uint64_t specialSegment = 0);
   void deallocate(const MemoryObject *mo);
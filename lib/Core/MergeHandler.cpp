@@ -11,8 +11,11 @@
 
 #include "CoreStats.h"
 #include "Executor.h"
+#include "Subsumption.h"
 #include "klee/ExecutionState.h"
 
+#include <climits>
+
 namespace klee {
 
 /*** Test generation options ***/
@@ -41,6 +44,24 @@ llvm::cl::opt<bool> DebugLogIncompleteMerge(
     llvm::cl::desc("Debug information for incomplete path merging (default=false)"),
     llvm::cl::cat(klee::MergeCat));
 
+llvm::cl::opt<bool> AutoMergeLoops(
+    "auto-merge-loops", llvm::cl::init(false),
+    llvm::cl::desc("Merge the states that forked inside a loop when they "
+                   "leave it, as if the loop was enclosed in klee_open_merge() "
+                   "and klee_close_merge(). Combine with "
+                   "-use-incomplete-merge to not wait for states that stay "
+                   "in the loop (default=false)"),
+    llvm::cl::cat(klee::MergeCat));
+
+namespace {
+llvm::cl::opt<unsigned> AutoMergeMaxJoins(
+    "auto-merge-max-joins", llvm::cl::init(64),
+    llvm::cl::desc("Do not merge states leaving a loop that differ in more "
+                   "than this many local values and memory words "
+                   "(default=64)"),
+    llvm::cl::cat(klee::MergeCat));
+}
+
 double MergeHandler::getMean() {
   if (closedStateCount == 0)
     return 0;
@@ -102,8 +123,16 @@ void MergeHandler::addClosedState(ExecutionState *es,
     auto &cpv = closePoint->second;
     bool mergedSuccessful = false;
 
+    unsigned maxJoins = loop ? AutoMergeMaxJoins : UINT_MAX;
     for (auto& mState: cpv) {
-      if (mState->merge(*es)) {
+      // the state may have waited long enough to be compacted
+      executor->expandState(*mState);
+      if (mState->merge(*es, maxJoins)) {
+        ++stats::mergedStates;
+        mState->mergedStates += 1 + es->mergedStates;
+        // its paths continue in mState, outside of its subtree
+        if (es->subsumptionNode)
+          es->subsumptionNode->markIncomplete();
         executor->terminateState(*es);
         executor->inCloseMerge.erase(es);
         mergedSuccessful = true;
@@ -131,9 +160,11 @@ bool MergeHandler::hasMergedStates() {
   return (!reachedCloseMerge.empty());
 }
 
-MergeHandler::MergeHandler(Executor *_executor, ExecutionState *es)
+MergeHandler::MergeHandler(Executor *_executor, ExecutionState *es,
+                           const llvm::Loop *_loop)
     : executor(_executor), openInstruction(es->steppedInstructions),
-      closedMean(0), closedStateCount(0), refCount(0) {
+      closedMean(0), closedStateCount(0), loop(_loop),
+      loopFrame(es->stack.size()), refCount(0) {
   executor->mergeGroups.push_back(this);
   addOpenState(es);
 }
@@ -0,0 +1,140 @@
+//===-- MetricsServer.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "MetricsServer.h"
+
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace klee;
+
+std::unique_ptr<MetricsServer>
+MetricsServer::create(unsigned port, const std::string &socketPath) {
+  int fd;
+  if (!socketPath.empty()) {
+    sockaddr_un address;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+      klee_warning("metrics socket path too long: %s", socketPath.c_str());
+      return nullptr;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath.c_str());
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    // a socket left behind by an earlier run would make bind fail
+    unlink(socketPath.c_str());
+    if (fd < 0 ||
+        bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address))) {
+      klee_warning("unable to create metrics socket %s: %s",
+                   socketPath.c_str(), strerror(errno));
+      if (fd >= 0)
+        close(fd);
+      return nullptr;
+    }
+  } else {
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int reuse = 1;
+    if (fd < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) ||
+        bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address))) {
+      klee_warning("unable to listen for metrics on port %u: %s", port,
+                   strerror(errno));
+      if (fd >= 0)
+        close(fd);
+      return nullptr;
+    }
+  }
+
+  if (listen(fd, 8)) {
+    klee_warning("unable to listen for metrics: %s", strerror(errno));
+    close(fd);
+    return nullptr;
+  }
+  return std::unique_ptr<MetricsServer>(new MetricsServer(fd, socketPath));
+}
+
+MetricsServer::MetricsServer(int listenFd, std::string socketPath)
+    : listenFd(listenFd), socketPath(std::move(socketPath)), stopping(false),
+      metrics(std::make_shared<const std::string>("# EOF\n")) {
+  thread = std::thread(&MetricsServer::serve, this);
+}
+
+MetricsServer::~MetricsServer() {
+  stopping = true;
+  thread.join();
+  close(listenFd);
+  if (!socketPath.empty())
+    unlink(socketPath.c_str());
+}
+
+void MetricsServer::publish(std::string text) {
+  std::atomic_store(&metrics,
+                    std::make_shared<const std::string>(std::move(text)));
+}
+
+void MetricsServer::serve() {
+  while (!stopping) {
+    // wake up now and then to notice the end of the run
+    pollfd p = {listenFd, POLLIN, 0};
+    if (poll(&p, 1, 200) <= 0)
+      continue;
+    int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+      continue;
+    answer(fd);
+    close(fd);
+  }
+}
+
+void MetricsServer::answer(int fd) {
+  // read the request up to its end, any request gets the metrics
+  char buffer[4096];
+  std::string request;
+  while (request.find("\r\n\r\n") == std::string::npos &&
+         request.size() < 16 * sizeof(buffer)) {
+    pollfd p = {fd, POLLIN, 0};
+    if (poll(&p, 1, 1000) <= 0)
+      return;
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n <= 0)
+      return;
+    request.append(buffer, n);
+  }
+
+  std::shared_ptr<const std::string> text = std::atomic_load(&metrics);
+  std::string response =
+      "HTTP/1.0 200 OK\r\n"
+      "Content-Type: application/openmetrics-text; version=1.0.0; "
+      "charset=utf-8\r\n"
+      "Content-Length: " + std::to_string(text->size()) + "\r\n"
+      "Connection: close\r\n\r\n";
+  response += *text;
+
+  const char *data = response.data();
+  size_t left = response.size();
+  while (left) {
+    ssize_t n = send(fd, data, left, MSG_NOSIGNAL);
+    if (n <= 0)
+      return;
+    data += n;
+    left -= n;
+  }
+}
@@ -0,0 +1,54 @@
+//===-- MetricsServer.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_METRICSSERVER_H
+#define KLEE_METRICSSERVER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace klee {
+
+  /// MetricsServer - Answer HTTP requests on a TCP port or a Unix socket
+  /// with the metrics last published, in the OpenMetrics text format.
+  ///
+  /// Requests are served by a thread of their own from the published
+  /// text, which the exploration thread replaces as a whole, so scraping
+  /// never waits for the executor nor the executor for a scrape.
+  class MetricsServer {
+    int listenFd;
+    /// The path of the Unix socket to remove on exit, if any.
+    std::string socketPath;
+    std::thread thread;
+    std::atomic<bool> stopping;
+    std::shared_ptr<const std::string> metrics;
+
+    MetricsServer(int listenFd, std::string socketPath);
+    void serve();
+    void answer(int fd);
+
+  public:
+    /// Listen on the TCP \a port of all interfaces, or on a Unix socket
+    /// at \a socketPath if it is not empty. Return null if that fails.
+    static std::unique_ptr<MetricsServer> create(unsigned port,
+                                                 const std::string &socketPath);
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer &) = delete;
+    MetricsServer &operator=(const MetricsServer &) = delete;
+
+    /// Serve \a text from now on.
+    void publish(std::string text);
+  };
+
+}
+
+#endif /* KLEE_METRICSSERVER_H */
@@ -0,0 +1,132 @@
+//===-- NativeCoverage.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "NativeCoverage.h"
+
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+/// \a s quoted for /bin/sh.
+std::string shellQuote(const std::string &s) {
+  std::string quoted = "'";
+  for (char c : s) {
+    if (c == '\'')
+      quoted += "'\\''";
+    else
+      quoted += c;
+  }
+  return quoted + "'";
+}
+} // namespace
+
+NativeCoverage::~NativeCoverage() {
+  for (Run &run : running) {
+    kill(run.pid, SIGKILL);
+    waitpid(run.pid, nullptr, 0);
+    close(run.fd);
+  }
+}
+
+void NativeCoverage::submit(const std::string &ktestPath) {
+  if (running.size() < maxJobs)
+    start(ktestPath);
+  else
+    pending.push_back(ktestPath);
+}
+
+void NativeCoverage::start(const std::string &ktestPath) {
+  int fds[2];
+  if (pipe(fds)) {
+    klee_warning("native coverage: pipe: %s", strerror(errno));
+    return;
+  }
+  std::string line = command + " " + shellQuote(ktestPath);
+  pid_t pid = fork();
+  if (pid == 0) {
+    int null = open("/dev/null", O_RDWR);
+    dup2(null, STDIN_FILENO);
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    execl("/bin/sh", "sh", "-c", line.c_str(), (char *)nullptr);
+    _exit(127);
+  }
+  close(fds[1]);
+  if (pid < 0) {
+    klee_warning("native coverage: fork: %s", strerror(errno));
+    close(fds[0]);
+    return;
+  }
+  fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  running.push_back({pid, fds[0], std::string()});
+}
+
+bool NativeCoverage::read(Run &run) {
+  char buffer[4096];
+  for (;;) {
+    ssize_t n = ::read(run.fd, buffer, sizeof(buffer));
+    if (n > 0) {
+      run.output.append(buffer, n);
+      continue;
+    }
+    if (n < 0 && errno == EINTR)
+      continue;
+    return n < 0 && errno == EAGAIN;
+  }
+}
+
+void NativeCoverage::poll(
+    std::vector<std::pair<std::string, unsigned> > &lines) {
+  for (auto it = running.begin(); it != running.end();) {
+    if (read(*it)) {
+      ++it;
+      continue;
+    }
+
+    int status;
+    waitpid(it->pid, &status, 0);
+    close(it->fd);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) == 127)
+      klee_warning_once(0, "native coverage: command failed: %s",
+                        command.c_str());
+
+    // file:line, the file possibly holding colons itself
+    const std::string &output = it->output;
+    for (size_t begin = 0, end; begin < output.size(); begin = end + 1) {
+      end = output.find('\n', begin);
+      if (end == std::string::npos)
+        end = output.size();
+      size_t colon = output.rfind(':', end);
+      if (colon == std::string::npos || colon < begin)
+        continue;
+      char *last;
+      unsigned long line = strtoul(output.c_str() + colon + 1, &last, 10);
+      if (last == output.c_str() + colon + 1 || line == 0)
+        continue;
+      lines.emplace_back(output.substr(begin, colon - begin), line);
+    }
+    it = running.erase(it);
+  }
+
+  while (!pending.empty() && running.size() < maxJobs) {
+    start(pending.front());
+    pending.pop_front();
+  }
+}
@@ -0,0 +1,62 @@
+//===-- NativeCoverage.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_NATIVECOVERAGE_H
+#define KLEE_NATIVECOVERAGE_H
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace klee {
+  /// NativeCoverage - Runs the generated tests natively, in the background,
+  /// to learn the source lines they cover, used by -native-coverage-command.
+  ///
+  /// The command gets the path of a .ktest file as its last argument, and
+  /// is expected to replay it on a coverage-instrumented native build of
+  /// the program (with klee-replay or a -write-harness harness, say) and
+  /// print the source lines it covered, one "file:line" per line. Up to a
+  /// number of commands run at once; the others wait for their turn.
+  class NativeCoverage {
+    struct Run {
+      pid_t pid;
+      int fd;
+      std::string output;
+    };
+
+    std::string command;
+    unsigned maxJobs;
+    std::vector<Run> running;
+    std::deque<std::string> pending;
+
+    void start(const std::string &ktestPath);
+    /// Read what \a run printed so far. \return false at its end.
+    bool read(Run &run);
+
+  public:
+    NativeCoverage(const std::string &command, unsigned maxJobs)
+        : command(command), maxJobs(maxJobs) {}
+    ~NativeCoverage();
+
+    NativeCoverage(const NativeCoverage &) = delete;
+    NativeCoverage &operator=(const NativeCoverage &) = delete;
+
+    /// Queue the test at \a ktestPath to be run.
+    void submit(const std::string &ktestPath);
+
+    /// Add the lines covered by the runs finished since the last call to
+    /// \a lines and start the waiting ones, without blocking.
+    void poll(std::vector<std::pair<std::string, unsigned> > &lines);
+  };
+}
+
+#endif /* KLEE_NATIVECOVERAGE_H */
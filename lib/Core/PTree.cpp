@@ -9,6 +9,8 @@
 
 #include "PTree.h"
 
+#include "PTreeLog.h"
+
 #include "klee/ExecutionState.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprPPrinter.h"
@@ -19,6 +21,8 @@ using namespace klee;
 
 PTree::PTree(ExecutionState *initialState) {
   root = std::make_unique<PTreeNode>(nullptr, initialState);
+  root->id = nextId++;
+  PTreeLog::record(PTreeEvent::Root, root->id);
 }
 
 void PTree::attach(PTreeNode *node, ExecutionState *leftState, ExecutionState *rightState) {
@@ -27,22 +31,34 @@ void PTree::attach(PTreeNode *node, ExecutionState *leftState, ExecutionState *r
   node->state = nullptr;
   node->left = std::make_unique<PTreeNode>(node, leftState);
   node->right = std::make_unique<PTreeNode>(node, rightState);
+  node->left->id = nextId++;
+  node->right->id = nextId++;
+  PTreeLog::record(PTreeEvent::Attach, node->id, node->left->id,
+                   node->right->id);
 }
 
 void PTree::remove(PTreeNode *n) {
   assert(!n->left && !n->right);
-  do {
-    PTreeNode *p = n->parent;
-    if (p) {
-      if (n == p->left.get()) {
-        p->left = nullptr;
-      } else {
-        assert(n == p->right.get());
-        p->right = nullptr;
-      }
-    }
-    n = p;
-  } while (n && !n->left && !n->right);
+  PTreeLog::record(PTreeEvent::Remove, n->id);
+  PTreeNode *p = n->parent;
+  if (!p)
+    return;
+
+  std::unique_ptr<PTreeNode> sibling;
+  if (n == p->left.get()) {
+    sibling = std::move(p->right);
+  } else {
+    assert(n == p->right.get());
+    sibling = std::move(p->left);
+  }
+  assert(sibling && "inner node with a single child");
+
+  PTreeNode *g = p->parent;
+  sibling->parent = g;
+  std::unique_ptr<PTreeNode> &slot =
+      !g ? root : (p == g->left.get() ? g->left : g->right);
+  // releases p and n
+  slot = std::move(sibling);
 }
 
 void PTree::dump(llvm::raw_ostream &os) {
@@ -81,3 +97,26 @@ PTreeNode::PTreeNode(PTreeNode *parent, ExecutionState *state) : parent{parent},
   state->ptreeNode = this;
 }
 
+namespace {
+// never destroyed: nodes may still be released during static destruction
+std::vector<void *> &getFreeNodes() {
+  static std::vector<void *> *freeNodes = new std::vector<void *>();
+  return *freeNodes;
+}
+}
+
+void *PTreeNode::operator new(std::size_t size) {
+  assert(size == sizeof(PTreeNode));
+  std::vector<void *> &freeNodes = getFreeNodes();
+  if (freeNodes.empty())
+    return ::operator new(size);
+  void *ptr = freeNodes.back();
+  freeNodes.pop_back();
+  return ptr;
+}
+
+void PTreeNode::operator delete(void *ptr) {
+  if (ptr)
+    getFreeNodes().push_back(ptr);
+}
+
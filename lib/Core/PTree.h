@@ -12,6 +12,10 @@
 
 #include "klee/Expr/Expr.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
 namespace klee {
   class ExecutionState;
 
@@ -21,20 +25,31 @@ namespace klee {
     std::unique_ptr<PTreeNode> left;
     std::unique_ptr<PTreeNode> right;
     ExecutionState *state = nullptr;
+    /// Identifies the node in the PTree log, see PTreeLog.
+    uint64_t id = 0;
 
     PTreeNode(const PTreeNode&) = delete;
     PTreeNode(PTreeNode *parent, ExecutionState *state);
     ~PTreeNode() = default;
+
+    // nodes are recycled through a free list
+    static void *operator new(std::size_t size);
+    static void operator delete(void *ptr);
   };
 
   class PTree {
+    uint64_t nextId = 1;
+
   public:
     std::unique_ptr<PTreeNode> root;
     explicit PTree(ExecutionState *initialState);
     ~PTree() = default;
 
-    static void attach(PTreeNode *node, ExecutionState *leftState, ExecutionState *rightState);
-    static void remove(PTreeNode *node);
+    void attach(PTreeNode *node, ExecutionState *leftState, ExecutionState *rightState);
+    /// Removes the leaf of a terminated state. Its sibling takes the place
+    /// of their parent, so every inner node has two children and a random
+    /// walk from the root only visits real branch points.
+    void remove(PTreeNode *node);
     void dump(llvm::raw_ostream &os);
   };
 }
@@ -0,0 +1,58 @@
+//===-- PTreeLog.cpp ------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PTreeLog.h"
+
+#include "CoreStats.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <cassert>
+
+using namespace klee;
+
+PTreeLog *PTreeLog::active = nullptr;
+
+namespace {
+  // a megabyte and a quarter of records between writes
+  const size_t BufferRecords = 1 << 15;
+  const char Magic[8] = {'K', 'L', 'E', 'E', 'P', 'T', 'R', '1'};
+}
+
+PTreeLog::PTreeLog(std::unique_ptr<llvm::raw_fd_ostream> _file)
+    : file(std::move(_file)), buffer(BufferRecords) {
+  assert(!active && "only one ptree log may be open");
+  file->write(Magic, sizeof(Magic));
+  active = this;
+}
+
+PTreeLog::~PTreeLog() {
+  flush();
+  active = nullptr;
+}
+
+void PTreeLog::flush() {
+  file->write(reinterpret_cast<const char *>(buffer.data()),
+              used * sizeof(Record));
+  file->flush();
+  used = 0;
+}
+
+void PTreeLog::append(PTreeEvent kind, uint64_t node, uint64_t left,
+                      uint64_t right) {
+  Record &r = buffer[used];
+  r.instructions = stats::instructions;
+  r.node = node;
+  r.left = left;
+  r.right = right;
+  r.kind = static_cast<uint32_t>(kind);
+  r.reserved = 0;
+  if (++used == buffer.size())
+    flush();
+}
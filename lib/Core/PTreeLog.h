@@ -0,0 +1,87 @@
+//===-- PTreeLog.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PTREELOG_H
+#define KLEE_PTREELOG_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace llvm {
+  class raw_fd_ostream;
+}
+
+namespace klee {
+
+  /// The kinds of changes to the process tree in a PTree log. The values
+  /// are part of the file format read by klee-ptree.
+  enum class PTreeEvent : uint32_t {
+    /// The tree was created with the node as its root.
+    Root = 0,
+    /// The leaf node forked into the left and right nodes.
+    Attach = 1,
+    /// The leaf node was removed and its sibling took the place of their
+    /// parent.
+    Remove = 2
+  };
+
+  /// PTreeLog - A binary log of the changes to the process tree, written
+  /// with -write-ptree-log to ptree.log in the output directory, from which
+  /// klee-ptree rebuilds the tree at any point of the run.
+  ///
+  /// Events are appended to a buffer that is written out whenever it fills
+  /// up, see EventTrace. While no log is open, recording costs a load and a
+  /// branch.
+  class PTreeLog {
+  public:
+    /// One event as stored in the file, after an 8 byte magic header. Nodes
+    /// are identified by numbers that are never reused.
+    struct Record {
+      /// The number of instructions executed so far.
+      uint64_t instructions;
+      uint64_t node;
+      /// The children of an Attach event, zero otherwise.
+      uint64_t left;
+      uint64_t right;
+      uint32_t kind;
+      uint32_t reserved;
+    };
+
+  private:
+    static PTreeLog *active;
+
+    std::unique_ptr<llvm::raw_fd_ostream> file;
+    std::vector<Record> buffer;
+    size_t used = 0;
+
+    void append(PTreeEvent kind, uint64_t node, uint64_t left,
+                uint64_t right);
+
+  public:
+    /// Start logging to \a file, which stays active until destroyed.
+    explicit PTreeLog(std::unique_ptr<llvm::raw_fd_ostream> file);
+    ~PTreeLog();
+
+    static bool enabled() { return active != nullptr; }
+
+    static void record(PTreeEvent kind, uint64_t node, uint64_t left = 0,
+                       uint64_t right = 0) {
+      if (active)
+        active->append(kind, node, left, right);
+    }
+
+    /// Write out the buffered events, so that the file shows the tree as it
+    /// is now.
+    void flush();
+  };
+
+}
+
+#endif /* KLEE_PTREELOG_H */
@@ -31,6 +31,7 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Support/CommandLine.h"
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <climits>
@@ -48,6 +49,43 @@ Searcher::~Searcher() {
 
 ///
 
+void StateList::push_back(ExecutionState *es) {
+  bool inserted =
+      positions.insert(std::make_pair(es, dropped + states.size())).second;
+  (void) inserted;
+  assert(inserted && "state added twice");
+  states.push_back(es);
+}
+
+void StateList::remove(ExecutionState *es) {
+  auto it = positions.find(es);
+  assert(it != positions.end() && "invalid state removed");
+  states[it->second - dropped] = nullptr;
+  positions.erase(it);
+  ++holes;
+
+  while (!states.empty() && !states.back()) {
+    states.pop_back();
+    --holes;
+  }
+  while (!states.empty() && !states.front()) {
+    states.pop_front();
+    ++dropped;
+    --holes;
+  }
+
+  if (holes * 2 > states.size()) {
+    states.erase(std::remove(states.begin(), states.end(), nullptr),
+                 states.end());
+    dropped = 0;
+    holes = 0;
+    for (size_t i = 0; i != states.size(); ++i)
+      positions[states[i]] = i;
+  }
+}
+
+///
+
 ExecutionState &DFSSearcher::selectState() {
   return *states.back();
 }
@@ -55,31 +93,10 @@ ExecutionState &DFSSearcher::selectState() {
 void DFSSearcher::update(ExecutionState *current,
                          const std::vector<ExecutionState *> &addedStates,
                          const std::vector<ExecutionState *> &removedStates) {
-  states.insert(states.end(),
-                addedStates.begin(),
-                addedStates.end());
-  for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
-                                                     ie = removedStates.end();
-       it != ie; ++it) {
-    ExecutionState *es = *it;
-    if (es == states.back()) {
-      states.pop_back();
-    } else {
-      bool ok = false;
-
-      for (std::vector<ExecutionState*>::iterator it = states.begin(),
-             ie = states.end(); it != ie; ++it) {
-        if (es==*it) {
-          states.erase(it);
-          ok = true;
-          break;
-        }
-      }
-
-      (void) ok;
-      assert(ok && "invalid state removed");
-    }
-  }
+  for (ExecutionState *es : addedStates)
+    states.push_back(es);
+  for (ExecutionState *es : removedStates)
+    states.remove(es);
 }
 
 ///
@@ -96,37 +113,14 @@ void BFSSearcher::update(ExecutionState *current,
   if (!addedStates.empty() && current &&
       std::find(removedStates.begin(), removedStates.end(), current) ==
           removedStates.end()) {
-    auto pos = std::find(states.begin(), states.end(), current);
-    assert(pos != states.end());
-    states.erase(pos);
+    states.remove(current);
     states.push_back(current);
   }
 
-  states.insert(states.end(),
-                addedStates.begin(),
-                addedStates.end());
-  for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
-                                                     ie = removedStates.end();
-       it != ie; ++it) {
-    ExecutionState *es = *it;
-    if (es == states.front()) {
-      states.pop_front();
-    } else {
-      bool ok = false;
-
-      for (std::deque<ExecutionState*>::iterator it = states.begin(),
-             ie = states.end(); it != ie; ++it) {
-        if (es==*it) {
-          states.erase(it);
-          ok = true;
-          break;
-        }
-      }
-
-      (void) ok;
-      assert(ok && "invalid state removed");
-    }
-  }
+  for (ExecutionState *es : addedStates)
+    states.push_back(es);
+  for (ExecutionState *es : removedStates)
+    states.remove(es);
 }
 
 ///
@@ -139,34 +133,31 @@ void
 RandomSearcher::update(ExecutionState *current,
                        const std::vector<ExecutionState *> &addedStates,
                        const std::vector<ExecutionState *> &removedStates) {
-  states.insert(states.end(),
-                addedStates.begin(),
-                addedStates.end());
-  for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
-                                                     ie = removedStates.end();
-       it != ie; ++it) {
-    ExecutionState *es = *it;
-    __attribute__((unused))
-    bool ok = false;
-
-    for (std::vector<ExecutionState*>::iterator it = states.begin(),
-           ie = states.end(); it != ie; ++it) {
-      if (es==*it) {
-        states.erase(it);
-        ok = true;
-        break;
-      }
+  for (ExecutionState *es : addedStates) {
+    positions[es] = states.size();
+    states.push_back(es);
+  }
+  for (ExecutionState *es : removedStates) {
+    auto it = positions.find(es);
+    assert(it != positions.end() && "invalid state removed");
+    // the order of the states does not matter, fill the gap with the last
+    size_t index = it->second;
+    positions.erase(it);
+    ExecutionState *last = states.back();
+    states.pop_back();
+    if (last != es) {
+      states[index] = last;
+      positions[last] = index;
     }
-    
-    assert(ok && "invalid state removed");
   }
 }
 
 ///
 
-WeightedRandomSearcher::WeightedRandomSearcher(WeightType _type)
+WeightedRandomSearcher::WeightedRandomSearcher(WeightType _type,
+                                               uint64_t refreshInstructions)
   : states(new DiscretePDF<ExecutionState*>()),
-    type(_type) {
+    type(_type), refreshInstructions(refreshInstructions) {
   switch(type) {
   case Depth: 
     updateWeights = false;
@@ -176,6 +167,7 @@ WeightedRandomSearcher::WeightedRandomSearcher(WeightType _type)
   case QueryCost:
   case MinDistToUncovered:
   case CoveringNew:
+  case PredictedQueryCost:
     updateWeights = true;
     break;
   default:
@@ -184,11 +176,42 @@ WeightedRandomSearcher::WeightedRandomSearcher(WeightType _type)
 }
 
 WeightedRandomSearcher::~WeightedRandomSearcher() {
+  if (type == PredictedQueryCost && totalCost > 0)
+    klee_message("predicted query time: %.3fs, actual: %.3fs",
+                 predictedTime, actualTime);
   delete states;
 }
 
 ExecutionState &WeightedRandomSearcher::selectState() {
-  return *states->choose(theRNG.getDoubleL());
+  refreshWeights();
+  ExecutionState *es = states->choose(theRNG.getDoubleL());
+  if (type == PredictedQueryCost) {
+    selected = es;
+    selectedQueryCost = es->queryCost;
+    selectedQueries = es->solverQueries;
+    selectedCost = predictQueryCost(es);
+  }
+  return *es;
+}
+
+double WeightedRandomSearcher::predictQueryCost(const ExecutionState *es) {
+  // the share of the queries of the state that missed all caches, with
+  // one hit and one miss assumed for states that did not query yet
+  double missRate = (es->coreSolverQueries + 1.) / (es->solverQueries + 2.);
+  // queries that miss grow with the constraints and the arrays they mention
+  return missRate * (1. + es->constraints.size()) * (1. + es->symbolics.size());
+}
+
+void WeightedRandomSearcher::recordQueryCost(const ExecutionState *es) {
+  unsigned queries = es->solverQueries - selectedQueries;
+  if (!queries)
+    return;
+  double cost = selectedCost * queries;
+  double time = (es->queryCost - selectedQueryCost).toSeconds();
+  // predict with the time per unit of cost seen so far
+  predictedTime += totalCost > 0 ? cost * actualTime / totalCost : time;
+  totalCost += cost;
+  actualTime += time;
 }
 
 double WeightedRandomSearcher::getWeight(ExecutionState *es) {
@@ -210,6 +233,8 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
   }
   case QueryCost:
     return (es->queryCost.toSeconds() < .1) ? 1. : 1./ es->queryCost.toSeconds();
+  case PredictedQueryCost:
+    return 1. / predictQueryCost(es);
   case CoveringNew:
   case MinDistToUncovered: {
     uint64_t md2u = computeMinDistToUncovered(es->pc,
@@ -231,25 +256,45 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
 void WeightedRandomSearcher::update(
     ExecutionState *current, const std::vector<ExecutionState *> &addedStates,
     const std::vector<ExecutionState *> &removedStates) {
-  if (current && updateWeights &&
-      std::find(removedStates.begin(), removedStates.end(), current) ==
-          removedStates.end())
-    states->update(current, getWeight(current));
-
-  for (std::vector<ExecutionState *>::const_iterator it = addedStates.begin(),
-                                                     ie = addedStates.end();
-       it != ie; ++it) {
-    ExecutionState *es = *it;
-    states->insert(es, getWeight(es));
+  if (type == PredictedQueryCost && current && current == selected)
+    recordQueryCost(current);
+
+  if (current && updateWeights)
+    stale.insert(current);
+
+  if (!addedStates.empty()) {
+    std::vector<std::pair<ExecutionState *, double> > added;
+    added.reserve(addedStates.size());
+    for (ExecutionState *es : addedStates)
+      added.emplace_back(es, getWeight(es));
+    states->insert(added);
   }
 
-  for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
-                                                     ie = removedStates.end();
-       it != ie; ++it) {
-    states->remove(*it);
+  if (!removedStates.empty()) {
+    for (ExecutionState *es : removedStates)
+      stale.erase(es);
+    states->remove(removedStates);
   }
 }
 
+void WeightedRandomSearcher::refreshWeights() {
+  if (stale.empty())
+    return;
+  if (lastEpoch == StatsTracker::epoch() &&
+      stats::instructions - lastRefresh < refreshInstructions)
+    return;
+
+  std::vector<std::pair<ExecutionState *, double> > updated;
+  updated.reserve(stale.size());
+  for (ExecutionState *es : stale)
+    updated.emplace_back(es, getWeight(es));
+  states->update(updated);
+
+  stale.clear();
+  lastRefresh = stats::instructions;
+  lastEpoch = StatsTracker::epoch();
+}
+
 bool WeightedRandomSearcher::empty() { 
   return states->empty(); 
 }
@@ -333,10 +378,12 @@ ExecutionState& MergingSearcher::selectState() {
 
 BatchingSearcher::BatchingSearcher(Searcher *_baseSearcher,
                                    time::Span _timeBudget,
-                                   unsigned _instructionBudget) 
+                                   unsigned _instructionBudget,
+                                   time::Span _solverTimeBudget)
   : baseSearcher(_baseSearcher),
     timeBudget(_timeBudget),
     instructionBudget(_instructionBudget),
+    solverTimeBudget(_solverTimeBudget),
     lastState(0) {
   
 }
@@ -346,13 +393,23 @@ BatchingSearcher::~BatchingSearcher() {
 }
 
 ExecutionState &BatchingSearcher::selectState() {
+  time::Span elapsed, solverTime;
+  if (lastState) {
+    elapsed = time::getWallTime() - lastStartTime;
+    if (solverTimeBudget) {
+      solverTime = lastState->queryCost - lastStartQueryCost;
+      // the solver time is accounted separately
+      elapsed = elapsed > solverTime ? elapsed - solverTime : time::Span();
+    }
+  }
+
   if (!lastState ||
-      (((timeBudget.toSeconds() > 0) &&
-        (time::getWallTime() - lastStartTime) > timeBudget)) ||
+      (((timeBudget.toSeconds() > 0) && elapsed > timeBudget)) ||
       ((instructionBudget > 0) &&
-       (stats::instructions - lastStartInstructions) > instructionBudget)) {
+       (stats::instructions - lastStartInstructions) > instructionBudget) ||
+      (solverTimeBudget && solverTime > solverTimeBudget)) {
     if (lastState) {
-      time::Span delta = time::getWallTime() - lastStartTime;
+      time::Span delta = elapsed;
       auto t = timeBudget;
       t *= 1.1;
       if (delta > t) {
@@ -363,6 +420,7 @@ ExecutionState &BatchingSearcher::selectState() {
     lastState = &baseSearcher->selectState();
     lastStartTime = time::getWallTime();
     lastStartInstructions = stats::instructions;
+    lastStartQueryCost = lastState->queryCost;
     return *lastState;
   } else {
     return *lastState;
@@ -392,7 +450,8 @@ IterativeDeepeningTimeSearcher::~IterativeDeepeningTimeSearcher() {
 
 ExecutionState &IterativeDeepeningTimeSearcher::selectState() {
   ExecutionState &res = baseSearcher->selectState();
-  startTime = time::getWallTime();
+  // budgets start at a second, the scheduler tick is precise enough
+  startTime = time::getCoarseWallTime();
   return res;
 }
 
@@ -400,8 +459,6 @@ void IterativeDeepeningTimeSearcher::update(
     ExecutionState *current, const std::vector<ExecutionState *> &addedStates,
     const std::vector<ExecutionState *> &removedStates) {
 
-  const auto elapsed = time::getWallTime() - startTime;
-
   if (!removedStates.empty()) {
     std::vector<ExecutionState *> alt = removedStates;
     for (std::vector<ExecutionState *>::const_iterator
@@ -423,7 +480,7 @@ void IterativeDeepeningTimeSearcher::update(
   if (current &&
       std::find(removedStates.begin(), removedStates.end(), current) ==
           removedStates.end() &&
-      elapsed > time) {
+      time::getCoarseWallTime() - startTime > time) {
     pausedStates.insert(current);
     baseSearcher->removeState(current);
   }
@@ -441,7 +498,7 @@ void IterativeDeepeningTimeSearcher::update(
 
 InterleavedSearcher::InterleavedSearcher(const std::vector<Searcher*> &_searchers)
   : searchers(_searchers),
-    index(1) {
+    index(1), active(0), pending(_searchers.size()) {
 }
 
 InterleavedSearcher::~InterleavedSearcher() {
@@ -451,15 +508,58 @@ InterleavedSearcher::~InterleavedSearcher() {
 }
 
 ExecutionState &InterleavedSearcher::selectState() {
-  Searcher *s = searchers[--index];
+  unsigned i = --index;
   if (index==0) index = searchers.size();
-  return s->selectState();
+  flushUpdates(i);
+  active = searchers[i];
+  return active->selectState();
 }
 
 void InterleavedSearcher::update(
     ExecutionState *current, const std::vector<ExecutionState *> &addedStates,
     const std::vector<ExecutionState *> &removedStates) {
-  for (std::vector<Searcher*>::const_iterator it = searchers.begin(),
-         ie = searchers.end(); it != ie; ++it)
-    (*it)->update(current, addedStates, removedStates);
+  bool currentRemoved =
+      current && std::find(removedStates.begin(), removedStates.end(),
+                           current) != removedStates.end();
+
+  for (unsigned i = 0; i < searchers.size(); ++i) {
+    if (i == 0 || searchers[i] == active) {
+      searchers[i]->update(current, addedStates, removedStates);
+      continue;
+    }
+
+    // Like the searchers do, take the added states before the removed ones.
+    // A removed state the searcher was not told about yet is just dropped,
+    // it may have been freed and its address reused by a later state.
+    PendingUpdates &p = pending[i];
+    p.added.insert(p.added.end(), addedStates.begin(), addedStates.end());
+    for (ExecutionState *es : removedStates) {
+      auto it = std::find(p.added.begin(), p.added.end(), es);
+      if (it != p.added.end())
+        p.added.erase(it);
+      else
+        p.removed.push_back(es);
+      p.updated.erase(std::remove(p.updated.begin(), p.updated.end(), es),
+                      p.updated.end());
+    }
+    if (current && !currentRemoved &&
+        std::find(p.updated.begin(), p.updated.end(), current) ==
+            p.updated.end())
+      p.updated.push_back(current);
+  }
+}
+
+void InterleavedSearcher::flushUpdates(unsigned i) {
+  PendingUpdates &p = pending[i];
+  const std::vector<ExecutionState *> none;
+  // removals first, an added state may reuse the address of a removed one
+  if (!p.removed.empty())
+    searchers[i]->update(0, none, p.removed);
+  if (!p.added.empty())
+    searchers[i]->update(0, p.added, none);
+  for (ExecutionState *es : p.updated)
+    searchers[i]->update(es, none, none);
+  p.added.clear();
+  p.removed.clear();
+  p.updated.clear();
 }
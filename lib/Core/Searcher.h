@@ -14,9 +14,11 @@
 
 #include "llvm/Support/raw_ostream.h"
 
+#include <deque>
 #include <map>
 #include <queue>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 namespace llvm {
@@ -79,12 +81,32 @@ namespace klee {
       NURS_Depth,
       NURS_ICnt,
       NURS_CPICnt,
-      NURS_QC
+      NURS_QC,
+      NURS_PQC
     };
   };
 
+  /// StateList - States in the order they were added, removable from
+  /// anywhere in constant time. A removed state leaves a hole, which is
+  /// dropped once it reaches either end, or with all the others once holes
+  /// make up half of the list.
+  class StateList {
+    std::deque<ExecutionState *> states;
+    /// Position of every state, counting the states dropped from the front.
+    std::unordered_map<ExecutionState *, size_t> positions;
+    size_t dropped = 0;
+    size_t holes = 0;
+
+  public:
+    bool empty() const { return states.empty(); }
+    ExecutionState *front() const { return states.front(); }
+    ExecutionState *back() const { return states.back(); }
+    void push_back(ExecutionState *es);
+    void remove(ExecutionState *es);
+  };
+
   class DFSSearcher : public Searcher {
-    std::vector<ExecutionState*> states;
+    StateList states;
 
   public:
     ExecutionState &selectState();
@@ -98,7 +120,7 @@ namespace klee {
   };
 
   class BFSSearcher : public Searcher {
-    std::deque<ExecutionState*> states;
+    StateList states;
 
   public:
     ExecutionState &selectState();
@@ -113,6 +135,8 @@ namespace klee {
 
   class RandomSearcher : public Searcher {
     std::vector<ExecutionState*> states;
+    /// Index of every state in states, which removals swap with the last.
+    std::unordered_map<ExecutionState *, size_t> positions;
 
   public:
     ExecutionState &selectState();
@@ -133,18 +157,43 @@ namespace klee {
       InstCount,
       CPInstCount,
       MinDistToUncovered,
-      CoveringNew
+      CoveringNew,
+      PredictedQueryCost
     };
 
   private:
     DiscretePDF<ExecutionState*> *states;
     WeightType type;
     bool updateWeights;
+
+    /// States that ran since their weight was computed. Their weights are
+    /// refreshed together before a selection, at most once every
+    /// refreshInstructions instructions unless the statistics the weights
+    /// depend on were recomputed since the last refresh.
+    std::set<ExecutionState *> stale;
+    uint64_t refreshInstructions;
+    uint64_t lastRefresh = 0;
+    unsigned lastEpoch = 0;
+
+    /// PredictedQueryCost: snapshot of the last selected state, to compare
+    /// the predicted cost of its queries with their actual cost.
+    ExecutionState *selected = nullptr;
+    time::Span selectedQueryCost;
+    unsigned selectedQueries = 0;
+    double selectedCost = 0;
+    /// Totals of the comparison: predicted cost units, and predicted and
+    /// actual query time in seconds.
+    double totalCost = 0, predictedTime = 0, actualTime = 0;
     
     double getWeight(ExecutionState*);
 
+    /// Predicted cost of a query of the state, in arbitrary units.
+    static double predictQueryCost(const ExecutionState *es);
+    void recordQueryCost(const ExecutionState *es);
+    void refreshWeights();
+
   public:
-    WeightedRandomSearcher(WeightType type);
+    WeightedRandomSearcher(WeightType type, uint64_t refreshInstructions = 0);
     ~WeightedRandomSearcher();
 
     ExecutionState &selectState();
@@ -161,6 +210,7 @@ namespace klee {
       case CPInstCount        : os << "CPInstCount\n"; return;
       case MinDistToUncovered : os << "MinDistToUncovered\n"; return;
       case CoveringNew        : os << "CoveringNew\n"; return;
+      case PredictedQueryCost : os << "PredictedQueryCost\n"; return;
       default                 : os << "<unknown type>\n"; return;
       }
     }
@@ -209,19 +259,27 @@ namespace klee {
     }
   };
 
+  /// Keeps running the selected state until it used up one of the budgets.
+  /// With a solver time budget, the time the state spends in the solver is
+  /// accounted against it, and only the remaining time against the time
+  /// budget, so that a state running into a series of expensive queries
+  /// yields even though it executes few instructions.
   class BatchingSearcher : public Searcher {
     Searcher *baseSearcher;
     time::Span timeBudget;
     unsigned instructionBudget;
+    time::Span solverTimeBudget;
 
     ExecutionState *lastState;
     time::Point lastStartTime;
     unsigned lastStartInstructions;
+    time::Span lastStartQueryCost;
 
   public:
     BatchingSearcher(Searcher *baseSearcher, 
                      time::Span _timeBudget,
-                     unsigned _instructionBudget);
+                     unsigned _instructionBudget,
+                     time::Span _solverTimeBudget = time::Span());
     ~BatchingSearcher();
 
     ExecutionState &selectState();
@@ -232,6 +290,7 @@ namespace klee {
     void printName(llvm::raw_ostream &os) {
       os << "<BatchingSearcher> timeBudget: " << timeBudget
          << ", instructionBudget: " << instructionBudget
+         << ", solverTimeBudget: " << solverTimeBudget
          << ", baseSearcher:\n";
       baseSearcher->printName(os);
       os << "</BatchingSearcher>\n";
@@ -258,11 +317,27 @@ namespace klee {
     }
   };
 
+  /// Selects states with each of its searchers in turn. Apart from the
+  /// first searcher, which answers empty(), only the searcher which selected
+  /// the current state is updated right away; the others are updated with
+  /// all that changed meanwhile once it is their turn.
   class InterleavedSearcher : public Searcher {
     typedef std::vector<Searcher*> searchers_ty;
 
+    /// Updates not passed on to a searcher yet.
+    struct PendingUpdates {
+      std::vector<ExecutionState *> added, removed;
+      /// States which were the current state of an update.
+      std::vector<ExecutionState *> updated;
+    };
+
     searchers_ty searchers;
     unsigned index;
+    /// The searcher which selected the last state.
+    Searcher *active;
+    std::vector<PendingUpdates> pending;
+
+    void flushUpdates(unsigned i);
 
   public:
     explicit InterleavedSearcher(const searchers_ty &_searchers);
@@ -23,24 +23,26 @@ KTestObject *SeedInfo::getNextInput(const MemoryObject *mo,
                                    bool byName) {
   if (byName) {
     unsigned i;
+    used.resize(input->numObjects);
     
     for (i=0; i<input->numObjects; ++i) {
       KTestObject *obj = &input->objects[i];
-      if (std::string(obj->name) == mo->name)
-        if (used.insert(obj).second)
-          return obj;
+      if (!used[i] && mo->name == obj->name) {
+        used[i] = true;
+        return obj;
+      }
     }
     
     // If first unused input matches in size then accept that as
     // well.
     for (i=0; i<input->numObjects; ++i)
-      if (!used.count(&input->objects[i]))
+      if (!used[i])
         break;
     if (i<input->numObjects) {
       KTestObject *obj = &input->objects[i];
       if (ConstantExpr *CE = dyn_cast<ConstantExpr>(mo->size)) {
         if (obj->numBytes == CE->getZExtValue()) {
-          used.insert(obj);
+          used[i] = true;
           klee_warning_once(mo, "using seed input %s[%d] for: %s (no name match)",
                             obj->name, obj->numBytes, mo->name.c_str());
           return obj;
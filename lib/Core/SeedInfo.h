@@ -27,7 +27,11 @@ namespace klee {
     VectorAssignment assignment;
     KTest *input;
     unsigned inputPosition;
-    std::set<struct KTestObject*> used;
+    /// The objects of \ref input taken by getNextInput, by index.
+    std::vector<bool> used;
+    /// The conjunction of the constraints the seed violated since it was
+    /// last patched, or null. See Executor::patchSeeds.
+    ref<Expr> unpatched;
     
   public:
     explicit
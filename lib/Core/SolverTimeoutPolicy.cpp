@@ -0,0 +1,84 @@
+//===-- SolverTimeoutPolicy.cpp -------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SolverTimeoutPolicy.h"
+
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+namespace {
+/// Latencies to record before the budgets are trusted.
+const uint64_t MinSamples = 100;
+
+/// The first budget covers the latencies of this fraction of the queries,
+/// times the margin. Queries that run out of it are not recorded, so when
+/// more of them time out, the quantile moves up to the budget and the
+/// margin lets it grow.
+const double BudgetQuantile = 0.99;
+const unsigned BudgetMargin = 2;
+
+/// Nothing below the cost of forking the solver process is worth a limit.
+const time::Span MinBudget = time::milliseconds(10);
+
+/// Growth of the budget between two attempts at a decisive query.
+const unsigned EscalationFactor = 4;
+}
+
+void QueryLatencies::record(time::Span latency) {
+  uint64_t us = latency.toMicroseconds();
+  ++buckets[std::min<unsigned>(us ? llvm::Log2_64(us) + 1 : 0,
+                               buckets.size() - 1)];
+  ++count;
+}
+
+time::Span QueryLatencies::getQuantile(double fraction) const {
+  uint64_t wanted = fraction * count, seen = 0;
+  for (unsigned i = 0; i != buckets.size(); ++i) {
+    seen += buckets[i];
+    if (seen >= wanted && seen)
+      return time::microseconds(UINT64_C(1) << i);
+  }
+  return time::Span();
+}
+
+time::Span
+SolverTimeoutPolicy::getInitialBudget(const QueryLatencies &latencies) const {
+  if (latencies.size() < MinSamples)
+    return time::Span();
+  return std::max(MinBudget,
+                  latencies.getQuantile(BudgetQuantile) * BudgetMargin);
+}
+
+bool SolverTimeoutPolicy::getBudget(const QueryLatencies &latencies,
+                                    Purpose purpose, unsigned attempt,
+                                    time::Span &budget) const {
+  time::Span initial = adaptive && limit ? getInitialBudget(latencies)
+                                         : time::Span();
+  if (!initial || initial >= limit) {
+    budget = limit;
+    return attempt == 0;
+  }
+
+  if (purpose == Speculative) {
+    budget = initial;
+    return attempt == 0;
+  }
+
+  budget = initial;
+  for (unsigned i = 0; i != attempt; ++i) {
+    if (budget >= limit)
+      return false;
+    budget *= EscalationFactor;
+  }
+  budget = std::min(budget, limit);
+  return true;
+}
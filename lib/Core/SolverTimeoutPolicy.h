@@ -0,0 +1,78 @@
+//===-- SolverTimeoutPolicy.h -----------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SOLVERTIMEOUTPOLICY_H
+#define KLEE_SOLVERTIMEOUTPOLICY_H
+
+#include "klee/Internal/System/Time.h"
+
+#include <array>
+#include <cstdint>
+
+namespace klee {
+
+  /// QueryLatencies - The distribution of the time the core solver took to
+  /// answer queries, in buckets of powers of two microseconds.
+  class QueryLatencies {
+    /// Bucket i > 0 counts the latencies in [2^(i-1), 2^i) microseconds,
+    /// the last one all longer latencies too.
+    std::array<uint64_t, 48> buckets{};
+    uint64_t count = 0;
+
+  public:
+    void record(time::Span latency);
+
+    uint64_t size() const { return count; }
+
+    /// \return An upper bound of the latencies of the given \a fraction of
+    /// the queries recorded.
+    time::Span getQuantile(double fraction) const;
+  };
+
+  /// SolverTimeoutPolicy - Decide the time each attempt at a solver query
+  /// may take.
+  ///
+  /// Without adaptation every query gets a single attempt limited by
+  /// --max-solver-time. With -adaptive-solver-timeout, queries start with
+  /// a budget learned from the latencies the solver has shown so far,
+  /// which is rarely exceeded by a query that is going to succeed.
+  /// Speculative queries get that budget only, decisive ones are retried
+  /// with growing budgets up to the limit.
+  class SolverTimeoutPolicy {
+  public:
+    enum Purpose {
+      /// The answer only saves work, the caller copes with a failure.
+      Speculative,
+      /// The answer decides the path, a failure stops the state.
+      Decisive
+    };
+
+  private:
+    time::Span limit;
+    bool adaptive = false;
+
+    /// \return The first budget of a query, or zero while too few
+    /// latencies are known.
+    time::Span getInitialBudget(const QueryLatencies &latencies) const;
+
+  public:
+    SolverTimeoutPolicy() = default;
+    SolverTimeoutPolicy(time::Span limit, bool adaptive)
+        : limit(limit), adaptive(adaptive) {}
+
+    /// Get the budget of an attempt (counting from zero) at a query.
+    ///
+    /// \return false iff the query should not be attempted again.
+    bool getBudget(const QueryLatencies &latencies, Purpose purpose,
+                   unsigned attempt, time::Span &budget) const;
+  };
+
+}
+
+#endif /* KLEE_SOLVERTIMEOUTPOLICY_H */
@@ -15,6 +15,7 @@
 #include "TimingSolver.h"
 
 #include "klee/ExecutionState.h"
+#include "klee/Internal/Module/InstructionInfoTable.h"
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Module/KModule.h"
 #include "klee/Internal/Support/Debug.h"
@@ -99,6 +100,7 @@ static SpecialFunctionHandler::HandlerInfo handlerInfo[] = {
   add("klee_is_symbolic", handleIsSymbolic, true),
   add("klee_make_symbolic", handleMakeSymbolic, false),
   add("klee_mark_global", handleMarkGlobal, false),
+  add("klee_memcpy", handleMemcpy, false),
   add("klee_open_merge", handleOpenMerge, false),
   add("klee_close_merge", handleCloseMerge, false),
   add("klee_prefer_cex", handlePreferCex, false),
@@ -229,30 +231,53 @@ void SpecialFunctionHandler::bind() {
     Function *f = executor.kmodule->module->getFunction(hi.name);
     
     if (f && (!hi.doNotOverride || f->isDeclaration()))
-      handlers[f] = std::make_pair(hi.handler, hi.hasReturnValue);
+      handlers[f] = i;
   }
 }
 
+void SpecialFunctionHandler::bindCall(KInstruction *ki) {
+  handlers_ty::iterator it = handlers.find(ki->callee);
+  if (it == handlers.end())
+    return;
+  ki->specialFunction = it->second + 1;
+
+  Handler h = handlerInfo[it->second].handler;
+  if (h != &SpecialFunctionHandler::handleScopeEnter &&
+      h != &SpecialFunctionHandler::handleScopeLeave)
+    return;
+  Instruction *mem =
+      dyn_cast<Instruction>(ki->inst->getOperand(0)->stripPointerCasts());
+  if (mem && isa<AllocaInst>(mem))
+    ki->scopeAlloca = executor.kmodule->getKInstruction(mem);
+}
+
 
 bool SpecialFunctionHandler::handle(ExecutionState &state, 
                                     Function *f,
                                     KInstruction *target,
                                     const std::vector<Cell> &arguments) {
-  handlers_ty::iterator it = handlers.find(f);
-  if (it != handlers.end()) {    
-    Handler h = it->second.first;
-    bool hasReturnValue = it->second.second;
-     // FIXME: Check this... add test?
-    if (!hasReturnValue && !target->inst->use_empty()) {
-      executor.terminateStateOnExecError(state, 
-                                         "expected return value from void special function");
-    } else {
-      (this->*h)(state, target, arguments);
-    }
-    return true;
+  unsigned index;
+  if (f == target->callee) {
+    if (!target->specialFunction)
+      return false;
+    index = target->specialFunction - 1;
   } else {
-    return false;
+    // called through a pointer
+    handlers_ty::iterator it = handlers.find(f);
+    if (it == handlers.end())
+      return false;
+    index = it->second;
   }
+
+  const HandlerInfo &hi = handlerInfo[index];
+  // FIXME: Check this... add test?
+  if (!hi.hasReturnValue && !target->inst->use_empty()) {
+    executor.terminateStateOnExecError(state, 
+                                       "expected return value from void special function");
+  } else {
+    (this->*hi.handler)(state, target, arguments);
+  }
+  return true;
 }
 
 /****/
@@ -584,6 +609,7 @@ void SpecialFunctionHandler::handleSetForking(ExecutionState &state,
 void SpecialFunctionHandler::handleStackTrace(ExecutionState &state,
                                               KInstruction *target,
                                               const std::vector<Cell> &arguments) {
+  executor.kmodule->infos->computeAssemblyLines();
   state.dumpStack(outs());
 }
 
@@ -833,6 +859,49 @@ void SpecialFunctionHandler::handleCheckMemoryAccess(ExecutionState &state,
   }
 }
 
+void SpecialFunctionHandler::handleMemcpy(ExecutionState &state,
+                                          KInstruction *target,
+                                          const std::vector<Cell> &arguments) {
+  assert(arguments.size()==3 && "invalid number of arguments to klee_memcpy");
+
+  uint64_t length =
+      executor.toConstant(state, arguments[2].getValue(), "klee_memcpy")
+          ->getZExtValue();
+  if (!length)
+    return;
+
+  KValue dst(
+      executor.toConstant(state, arguments[0].getSegment(), "klee_memcpy"),
+      executor.toConstant(state, arguments[0].getOffset(), "klee_memcpy"));
+  KValue src(
+      executor.toConstant(state, arguments[1].getSegment(), "klee_memcpy"),
+      executor.toConstant(state, arguments[1].getOffset(), "klee_memcpy"));
+
+  ObjectPair dstOp, srcOp;
+  unsigned dstOffset, srcOffset;
+  if (!executor.resolveConcreteRange(state, dst, length, dstOp, dstOffset)) {
+    executor.terminateStateOnError(state, "klee_memcpy: memory error",
+                                   Executor::Ptr, NULL,
+                                   executor.getKValueInfo(state, dst));
+    return;
+  }
+  if (!executor.resolveConcreteRange(state, src, length, srcOp, srcOffset)) {
+    executor.terminateStateOnError(state, "klee_memcpy: memory error",
+                                   Executor::Ptr, NULL,
+                                   executor.getKValueInfo(state, src));
+    return;
+  }
+  if (dstOp.second->readOnly) {
+    executor.terminateStateOnError(state, "klee_memcpy: memory error",
+                                   Executor::ReadOnly);
+    return;
+  }
+
+  ObjectState *wos = state.addressSpace.getWriteable(dstOp.first, dstOp.second);
+  const ObjectState *ros = srcOp.first == dstOp.first ? wos : srcOp.second;
+  wos->copyRange(dstOffset, *ros, srcOffset, length);
+}
+
 void SpecialFunctionHandler::handleGetValue(ExecutionState &state,
                                             KInstruction *target,
                                             const std::vector<Cell> &arguments) {
@@ -868,53 +937,48 @@ void SpecialFunctionHandler::handleDefineFixedObject(ExecutionState &state,
 
   MemoryObject *mo = executor.memory->allocateFixed(size, state.prevPC->inst);
   executor.bindObjectInState(state, mo, false);
-  state.addressSpace.concreteAddressMap.insert({address, mo->segment});
+  state.addressSpace.bindConcreteAddress(address, mo->segment);
   state.addressSpace.segmentMap.insert(std::make_pair(mo->segment, mo));
   mo->isUserSpecified = true; // XXX hack;
 }
 
-void SpecialFunctionHandler::handleScopeEnter(ExecutionState &state,
-                                              KInstruction *target,
-                                              const std::vector<Cell> &arguments) {
+KInstruction *SpecialFunctionHandler::getScopeAlloca(ExecutionState &state,
+                                                     KInstruction *target) {
+  if (target->scopeAlloca)
+    return target->scopeAlloca;
+
+  // not resolved by bindCall(): called through a pointer, or not an alloca
   llvm::Instruction *mem
     = llvm::dyn_cast<Instruction>(target->inst->getOperand(0)->stripPointerCasts());
   if (!mem) {
     executor.terminateStateOnExecError(state,
         "Unhandled argument for scope marker (not an instruction).");
-    return;
+    return nullptr;
   }
 
   auto kinstMem = executor.kmodule->getKInstruction(mem);
   if (!llvm::isa<llvm::AllocaInst>(kinstMem->inst)) {
     executor.terminateStateOnExecError(state,
         "Unhandled argument for scope marker (not alloca)");
-    return;
+    return nullptr;
   }
+  return kinstMem;
+}
 
-  executor.executeLifetimeIntrinsic(state, target,
-                                    kinstMem, arguments[0], false /* is end */);
+void SpecialFunctionHandler::handleScopeEnter(ExecutionState &state,
+                                              KInstruction *target,
+                                              const std::vector<Cell> &arguments) {
+  if (KInstruction *kinstMem = getScopeAlloca(state, target))
+    executor.executeLifetimeIntrinsic(state, target, kinstMem, arguments[0],
+                                      false /* is end */);
 }
 
 void SpecialFunctionHandler::handleScopeLeave(ExecutionState &state,
                                               KInstruction *target,
                                               const std::vector<Cell> &arguments) {
-  llvm::Instruction *mem
-    = llvm::dyn_cast<Instruction>(target->inst->getOperand(0)->stripPointerCasts());
-  if (!mem) {
-    executor.terminateStateOnExecError(state,
-        "Unhandled argument for scope marker (not an instruction).");
-    return;
-  }
-
-  auto kinstMem = executor.kmodule->getKInstruction(mem);
-  if (!llvm::isa<llvm::AllocaInst>(kinstMem->inst)) {
-    executor.terminateStateOnExecError(state,
-        "Unhandled argument for scope marker (not alloca)");
-    return;
-  }
-
-  executor.executeLifetimeIntrinsic(state, target,
-                                    kinstMem, arguments[0], true /* is end */);
+  if (KInstruction *kinstMem = getScopeAlloca(state, target))
+    executor.executeLifetimeIntrinsic(state, target, kinstMem, arguments[0],
+                                      true /* is end */);
 }
 
 void SpecialFunctionHandler::handleMakeSymbolic(ExecutionState &state,
@@ -991,7 +1055,7 @@ void SpecialFunctionHandler::handleVerifierNondetType(ExecutionState &state,
                                                       const std::string& name,
                                                       bool isPointer) {
   // create nondet value if we are not replaying
-  if (executor.replayNondet.empty()) {
+  if (executor.replayNondetSites.empty()) {
     executor.bindLocal(target, state,
                        executor.createNondetValue(state, size,
                                                   isSigned, target,
@@ -1011,49 +1075,31 @@ void SpecialFunctionHandler::handleVerifierNondetType(ExecutionState &state,
     return;
   }
 
-  // position in the nondet vector we're in
-  static unsigned position = 0;
-
-  if (position >= executor.replayNondet.size()) {
-   //klee_warning("Got out of nondet values while replaying, using nondet");
-   //executor.bindLocal(target, state,
-   //                   executor.createNondetValue(state, size,
-   //                                              isSigned, target, name));
+  // the site of the call, matched by name and location on its first call
+  auto call = executor.replayNondetCalls.find(target);
+  if (call == executor.replayNondetCalls.end()) {
+    auto site = executor.replayNondetSites.find(
+        std::make_tuple(name, info->line, info->column));
+    call = executor.replayNondetCalls
+               .insert(std::make_pair(
+                   target, site == executor.replayNondetSites.end()
+                               ? nullptr
+                               : &site->second))
+               .first;
+  }
 
-    klee_warning("Got out of nondet values while replaying, using 0");
+  Executor::ReplayNondetSite *site = call->second;
+  if (!site || site->next == site->values.size()) {
+    klee_warning("No nondet value to replay for: %s:%u:%u, using 0",
+                 name.c_str(), info->line, info->column);
     putConcreteValue(state, name, isSigned,
                      target, ConstantExpr::alloc(0, size));
     return;
   }
 
-  auto& nondet = executor.replayNondet[position];
-  //klee_warning("Matching %s:%u:%u", name.c_str(), info->line, info->column);
-
-  if (std::get<0>(nondet) == name &&
-      std::get<1>(nondet) == info->line &&
-      std::get<2>(nondet) == info->column) {
-      auto& val = std::get<3>(nondet);
-
-     //klee_warning("Matched nondet value for: %s:%u:%u to %lu",
-     //             std::get<0>(nondet).c_str(), std::get<1>(nondet),
-     //             std::get<2>(nondet), val.getZExtValue());
-
-      putConcreteValue(state, name, val.isSigned(), target,
-                       ConstantExpr::alloc(val.getZExtValue(), size));
-
-    ++position; // matched, move on
-  } else {
-    klee_warning("Did not match nondet value for: %s:%u:%u, using 0",
-   //              "using nondet value",
-                 std::get<0>(nondet).c_str(), std::get<1>(nondet),
-                 std::get<2>(nondet));
-
-   //executor.bindLocal(target, state,
-   //                   executor.createNondetValue(state, size,
-   //                                              isSigned, target, name));
-    putConcreteValue(state, name, isSigned,
-                     target, ConstantExpr::alloc(0, size));
-  }
+  const ConcreteValue &val = site->values[site->next++];
+  putConcreteValue(state, name, val.isSigned(), target,
+                   ConstantExpr::alloc(val.getZExtValue(), size));
 }
 
 void SpecialFunctionHandler::handleVerifierNondetInt(ExecutionState &state,
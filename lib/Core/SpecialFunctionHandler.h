@@ -34,8 +34,8 @@ namespace klee {
                                                     KInstruction *target, 
                                                     const std::vector<Cell>
                                                       &arguments);
-    typedef std::map<const llvm::Function*, 
-                     std::pair<Handler,bool> > handlers_ty;
+    /// The handled functions, with the index of their handler.
+    typedef std::map<const llvm::Function*, unsigned> handlers_ty;
 
     handlers_ty handlers;
     class Executor &executor;
@@ -88,6 +88,10 @@ namespace klee {
     /// prepared for execution.
     void bind();
 
+    /// Resolve the handler of a call site once, so that handle() does not
+    /// look its callee up on each call.
+    void bindCall(KInstruction *ki);
+
     bool handle(ExecutionState &state, 
                 llvm::Function *f,
                 KInstruction *target,
@@ -97,6 +101,10 @@ namespace klee {
 
     std::string readStringAtAddress(ExecutionState &state, const Cell &address);
 
+    /// The alloca marked by the scope marker call \p target, or null after
+    /// terminating the state if it marks none.
+    KInstruction *getScopeAlloca(ExecutionState &state, KInstruction *target);
+
     void handleVerifierNondetType(ExecutionState &state,
                                   KInstruction *target,
                                   unsigned size,
@@ -134,6 +142,7 @@ namespace klee {
     HANDLER(handleMalloc);
     HANDLER(handleMemalign);
     HANDLER(handleMarkGlobal);
+    HANDLER(handleMemcpy);
     HANDLER(handleOpenMerge);
     HANDLER(handleCloseMerge);
     HANDLER(handleNew);
@@ -12,18 +12,23 @@
 #include "klee/ExecutionState.h"
 #include "klee/Statistics.h"
 #include "klee/Config/Version.h"
+#include "klee/Expr/ExprAllocator.h"
 #include "klee/Internal/Module/InstructionInfoTable.h"
 #include "klee/Internal/Module/KModule.h"
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Support/ModuleUtil.h"
+#include "klee/Internal/Support/Timer.h"
 #include "klee/Internal/System/MemoryUsage.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverStats.h"
 
 #include "CallPathManager.h"
 #include "CoreStats.h"
 #include "Executor.h"
+#include "Memory.h"
 #include "MemoryManager.h"
+#include "MetricsServer.h"
 #include "UserSearcher.h"
 
 #include "llvm/IR/BasicBlock.h"
@@ -40,7 +45,11 @@
 #include "llvm/Support/Path.h"
 #include "llvm/Support/FileSystem.h"
 
+#include <algorithm>
 #include <fstream>
+#include <functional>
+#include <queue>
+#include <unordered_map>
 #include <unistd.h>
 
 using namespace klee;
@@ -59,6 +68,14 @@ cl::opt<bool> TrackInstructionTime(
         "Enable tracking of time for individual instructions (default=false)"),
     cl::cat(StatsCat));
 
+cl::opt<unsigned> InstructionTimeSampleInterval(
+    "instruction-time-sample-interval", cl::init(1),
+    cl::desc("With -track-instruction-time, read the clocks only every n "
+             "instructions and charge the time since the previous reading to "
+             "the instruction executed last. This samples where the time is "
+             "spent instead of timing every instruction (default=1)"),
+    cl::cat(StatsCat));
+
 cl::opt<bool>
     OutputStats("output-stats", cl::init(true),
                 cl::desc("Write running stats trace file (default=true)"),
@@ -93,6 +110,22 @@ cl::opt<std::string> IStatsWriteInterval(
         "Approximate number of seconds between istats writes (default=10s)"),
     cl::cat(StatsCat));
 
+cl::opt<bool> IStatsQueryPurposes(
+    "istats-query-purposes", cl::init(false),
+    cl::desc("Write the solver time spent on each purpose of queries "
+             "(branches, bounds checks, resolution, ...) to run.istats, in "
+             "place of the coverage, state and real time columns. "
+             "KCachegrind reads at most 13 events (default=false)"),
+    cl::cat(StatsCat));
+
+cl::opt<bool> IStatsDeltas(
+    "istats-deltas", cl::init(false),
+    cl::desc("Between the first and the last write of run.istats, append "
+             "the rows whose statistics changed to run.istats.delta "
+             "instead of rewriting run.istats. klee-cov --istats applies "
+             "the deltas (default=false)"),
+    cl::cat(StatsCat));
+
 cl::opt<unsigned> IStatsWriteAfterInstructions(
     "istats-write-after-instructions", cl::init(0),
     cl::desc(
@@ -105,23 +138,84 @@ cl::opt<std::string> UncoveredUpdateInterval(
     cl::desc("Update interval for uncovered instructions (default=30s)"),
     cl::cat(StatsCat));
 
+cl::opt<bool> StatsWriterThread(
+    "stats-writer-thread", cl::init(true),
+    cl::desc("Write run.stats and run.istats on a separate thread from "
+             "snapshots of the statistics, so that writing them does not "
+             "hold up the exploration (default=true)"),
+    cl::cat(StatsCat));
+
+cl::opt<unsigned> MetricsPort(
+    "metrics-port", cl::init(0),
+    cl::desc("Serve the statistics, state count and memory usage in the "
+             "OpenMetrics format over HTTP on this TCP port of all "
+             "interfaces, 0 to disable (default=0)"),
+    cl::cat(StatsCat));
+
+cl::opt<std::string> MetricsSocket(
+    "metrics-socket", cl::init(""),
+    cl::desc("Serve the metrics over HTTP on a Unix socket at this path "
+             "instead of a TCP port"),
+    cl::cat(StatsCat));
+
+cl::opt<std::string> MetricsInterval(
+    "metrics-interval", cl::init("1s"),
+    cl::desc("Approximate time between updates of the served metrics "
+             "(default=1s)"),
+    cl::cat(StatsCat));
+
 cl::opt<bool> UseCallPaths("use-call-paths", cl::init(true),
                            cl::desc("Enable calltree tracking for instruction "
                                     "level statistics (default=true)"),
                            cl::cat(StatsCat));
 
+cl::opt<unsigned> MaxCallPathDepth(
+    "max-call-path-depth", cl::init(0),
+    cl::desc("Merge the calls below this depth of the calltree into a single "
+             "node per call path, to bound the memory of deep recursion "
+             "(default=0 (off))"),
+    cl::cat(StatsCat));
+
+/// The statistics of each query purpose and of each profiled solver layer
+/// in the order of their run.stats columns.
+std::vector<Statistic *> getQueryStatistics() {
+  std::vector<Statistic *> result;
+  for (unsigned i = 0; i != NumQueryPurposes; ++i) {
+    result.push_back(&stats::purposeQueries[i]);
+    result.push_back(&stats::purposeQueryTime[i]);
+    result.push_back(&stats::purposeQueryCacheHits[i]);
+    result.push_back(&stats::purposeQueryTimeouts[i]);
+  }
+  // the layers of the solver chain, if they are profiled
+  if (ProfileSolverChain) {
+    for (unsigned i = 0; i != NumSolverLayers; ++i) {
+      result.push_back(&stats::solverLayerQueries[i]);
+      result.push_back(&stats::solverLayerPassedQueries[i]);
+      result.push_back(&stats::solverLayerHits[i]);
+      result.push_back(&stats::solverLayerTime[i]);
+    }
+  }
+  return result;
+}
+
 } // namespace
 
 ///
 
 bool StatsTracker::useStatistics() {
-  return OutputStats || OutputIStats;
+  return OutputStats || OutputIStats || MetricsPort || !MetricsSocket.empty();
 }
 
 bool StatsTracker::useIStats() {
   return OutputIStats;
 }
 
+static unsigned uncoveredEpoch = 0;
+
+unsigned StatsTracker::epoch() {
+  return uncoveredEpoch;
+}
+
 /// Check for special cases where we statically know an instruction is
 /// uncoverable. Currently the case is an unreachable instruction
 /// following a noreturn call; the instruction is really only there to
@@ -161,6 +255,7 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     numBranches(0),
     fullBranches(0),
     partialBranches(0),
+    callPathManager(MaxCallPathDepth),
     updateMinDistToUncovered(_updateMinDistToUncovered) {
 
   const time::Span statsWriteInterval(StatsWriteInterval);
@@ -278,6 +373,9 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
 
   if (OutputIStats) {
     istatsFile = executor.interpreterHandler->openOutputFile("run.istats");
+    if (IStatsDeltas)
+      istatsDeltaFile =
+          executor.interpreterHandler->openOutputFile("run.istats.delta");
     if (istatsFile) {
       if (iStatsWriteInterval)
         executor.timers.add(std::move(std::make_unique<Timer>(iStatsWriteInterval, [&]{
@@ -287,9 +385,26 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
       klee_error("Unable to open instruction level stats file (run.istats).");
     }
   }
+
+  if (MetricsPort || !MetricsSocket.empty()) {
+    metricsServer = MetricsServer::create(MetricsPort, MetricsSocket);
+    if (metricsServer) {
+      publishMetrics();
+      executor.timers.add(std::make_unique<Timer>(
+          time::Span{MetricsInterval}, [&] { publishMetrics(); }));
+    }
+  }
 }
 
 StatsTracker::~StatsTracker() {  
+  {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    writerStopping = true;
+  }
+  writerCondition.notify_all();
+  if (writer.joinable())
+    writer.join();
+
   if (statsFile) {
     auto rc = sqlite3_step(transactionEndStmt);
     if (rc != SQLITE_DONE) {
@@ -311,8 +426,11 @@ void StatsTracker::done() {
     if (updateMinDistToUncovered)
       computeReachableUncovered();
     if (istatsFile)
-      writeIStats();
+      writeIStats(true);
   }
+  waitForWriter();
+  if (metricsServer)
+    publishMetrics();
 }
 
 void StatsTracker::stepInstruction(ExecutionState &es) {
@@ -320,18 +438,25 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
     if (TrackInstructionTime) {
       static time::Point lastNowTime(time::getWallTime());
       static time::Span lastUserTime;
+      static unsigned untilSample = 0;
 
-      if (!lastUserTime) {
-        lastUserTime = time::getUserTime();
+      if (untilSample) {
+        --untilSample;
       } else {
-        const auto now = time::getWallTime();
-        const auto user = time::getUserTime();
-        const auto delta = user - lastUserTime;
-        const auto deltaNow = now - lastNowTime;
-        stats::instructionTime += delta.toMicroseconds();
-        stats::instructionRealTime += deltaNow.toMicroseconds();
-        lastUserTime = user;
-        lastNowTime = now;
+        untilSample =
+            std::max(InstructionTimeSampleInterval.getValue(), 1u) - 1;
+        if (!lastUserTime) {
+          lastUserTime = time::getUserTime();
+        } else {
+          const auto now = time::getWallTime();
+          const auto user = time::getUserTime();
+          const auto delta = user - lastUserTime;
+          const auto deltaNow = now - lastNowTime;
+          stats::instructionTime += delta.toMicroseconds();
+          stats::instructionRealTime += deltaNow.toMicroseconds();
+          lastUserTime = user;
+          lastNowTime = now;
+        }
       }
     }
 
@@ -345,14 +470,17 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
     if (es.instsSinceCovNew)
       ++es.instsSinceCovNew;
 
-    if (sf.kf->trackCoverage && instructionIsCoverable(inst)) {
-      if (!theStatisticManager->getIndexedValue(stats::coveredInstructions, ii.id)) {
+    // most instructions are covered already, so check that first
+    if (sf.kf->trackCoverage &&
+        !theStatisticManager->getIndexedValue(stats::coveredInstructions,
+                                              ii.id)) {
+      if (instructionIsCoverable(inst)) {
         // Checking for actual stoppoints avoids inconsistencies due
         // to line number propogation.
         //
         // FIXME: This trick no longer works, we should fix this in the line
         // number propogation.
-          es.coveredLines[&ii.file].insert(ii.line);
+        es.coveredInstructions.set(ii.id);
 	es.coveredNew = true;
         es.instsSinceCovNew = 1;
 	++stats::coveredInstructions;
@@ -453,8 +581,15 @@ void StatsTracker::writeStatsHeader() {
 #ifdef KLEE_ARRAY_DEBUG
 	           << "ArrayHashTime INTEGER,"
 #endif
-             << "QueryCexCacheHits INTEGER"
-             << ")";
+             << "QueryCexCacheHits INTEGER,"
+             << "ExprSlabBytes INTEGER,"
+             << "ExprSlabUsedBytes INTEGER,"
+             << "ObjectStates INTEGER,"
+             << "ObjectStateBytes INTEGER,"
+             << "Constraints INTEGER";
+  for (Statistic *s : getQueryStatistics())
+    create << "," << s->getName() << " INTEGER";
+  create << ")";
   char *zErrMsg = nullptr;
   if(sqlite3_exec(statsFile, create.str().c_str(), nullptr, nullptr, &zErrMsg)) {
     klee_error("%s", sqlite3ErrToStringAndFree("ERROR creating table: ", zErrMsg).c_str());
@@ -489,8 +624,15 @@ void StatsTracker::writeStatsHeader() {
 #ifdef KLEE_ARRAY_DEBUG
              << "ArrayHashTime,"
 #endif
-             << "QueryCexCacheHits "
-             << ") VALUES ( "
+             << "QueryCexCacheHits ,"
+             << "ExprSlabBytes ,"
+             << "ExprSlabUsedBytes ,"
+             << "ObjectStates ,"
+             << "ObjectStateBytes ,"
+             << "Constraints ";
+  for (Statistic *s : getQueryStatistics())
+    insert << "," << s->getName() << " ";
+  insert     << ") VALUES ( "
              << "?, "
              << "?, "
              << "?, "
@@ -513,8 +655,15 @@ void StatsTracker::writeStatsHeader() {
 #ifdef KLEE_ARRAY_DEBUG
              << "?, "
 #endif
-             << "? "
-             << ")";
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "? ";
+  for (unsigned i = 0, e = getQueryStatistics().size(); i != e; ++i)
+    insert << ", ?";
+  insert << ")";
 
   if(sqlite3_prepare_v2(statsFile, insert.str().c_str(), -1, &insertStmt, nullptr) != SQLITE_OK) {
     klee_error("Cannot create prepared statement: %s", sqlite3_errmsg(statsFile));
@@ -525,50 +674,128 @@ time::Span StatsTracker::elapsed() {
   return time::getWallTime() - startWallTime;
 }
 
+/// Whether \a a is \a b or a path suffix of it.
+static bool isPathSuffix(const std::string &a, const std::string &b) {
+  if (a.size() > b.size() || b.compare(b.size() - a.size(), a.size(), a))
+    return false;
+  return a.size() == b.size() || b[b.size() - a.size() - 1] == '/';
+}
+
+void StatsTracker::markLinesCovered(
+    const std::vector<std::pair<std::string, unsigned> > &lines) {
+  // the coverage is only tracked along with the instruction statistics
+  if (!OutputIStats || lines.empty())
+    return;
+
+  if (instructionsByLine.empty()) {
+    for (auto &kfp : executor.kmodule->functions) {
+      if (!kfp->trackCoverage)
+        continue;
+      for (unsigned i = 0; i < kfp->numInstructions; ++i) {
+        KInstruction *ki = kfp->instructions[i];
+        const InstructionInfo &ii = *ki->info;
+        if (ii.line && instructionIsCoverable(ki->inst))
+          instructionsByLine[{llvm::sys::path::filename(ii.file).str(),
+                              ii.line}]
+              .push_back(&ii);
+      }
+    }
+  }
+
+  StatisticManager &sm = *theStatisticManager;
+  const unsigned index = sm.getIndex();
+  StatisticRecord *context = sm.getContext();
+  sm.setContext(nullptr);
+  uint64_t newlyCovered = 0;
+  for (const auto &line : lines) {
+    auto it = instructionsByLine.find(
+        {llvm::sys::path::filename(line.first).str(), line.second});
+    if (it == instructionsByLine.end())
+      continue;
+    for (const InstructionInfo *ii : it->second) {
+      if (sm.getIndexedValue(stats::coveredInstructions, ii->id) ||
+          !(isPathSuffix(line.first, ii->file) ||
+            isPathSuffix(ii->file, line.first)))
+        continue;
+      sm.setIndex(ii->id);
+      ++stats::coveredInstructions;
+      stats::uncoveredInstructions += (uint64_t)-1;
+      ++stats::nativelyCoveredInstructions;
+      ++newlyCovered;
+    }
+  }
+  sm.setIndex(index);
+  sm.setContext(context);
+
+  // let the searchers steer away from the newly covered code right away
+  if (newlyCovered && updateMinDistToUncovered)
+    computeReachableUncovered();
+}
+
 void StatsTracker::writeStatsLine() {
-  sqlite3_bind_int64(insertStmt, 1, stats::instructions);
-  sqlite3_bind_int64(insertStmt, 2, fullBranches);
-  sqlite3_bind_int64(insertStmt, 3, partialBranches);
-  sqlite3_bind_int64(insertStmt, 4, numBranches);
-  sqlite3_bind_int64(insertStmt, 5, time::getUserTime().toMicroseconds());
-  sqlite3_bind_int64(insertStmt, 6, executor.states.size());
-  sqlite3_bind_int64(insertStmt, 7, util::GetTotalMallocUsage() + executor.memory->getUsedDeterministicSize());
-  sqlite3_bind_int64(insertStmt, 8, stats::queries);
-  sqlite3_bind_int64(insertStmt, 9, stats::queryConstructs);
-  sqlite3_bind_int64(insertStmt, 10, 0);  // was numObjects
-  sqlite3_bind_int64(insertStmt, 11, elapsed().toMicroseconds());
-  sqlite3_bind_int64(insertStmt, 12, stats::coveredInstructions);
-  sqlite3_bind_int64(insertStmt, 13, stats::uncoveredInstructions);
-  sqlite3_bind_int64(insertStmt, 14, stats::queryTime);
-  sqlite3_bind_int64(insertStmt, 15, stats::solverTime);
-  sqlite3_bind_int64(insertStmt, 16, stats::cexCacheTime);
-  sqlite3_bind_int64(insertStmt, 17, stats::forkTime);
-  sqlite3_bind_int64(insertStmt, 18, stats::resolveTime);
-  sqlite3_bind_int64(insertStmt, 19, stats::queryCexCacheMisses);
-  sqlite3_bind_int64(insertStmt, 20, stats::queryCexCacheHits);
+  // the values in the order of the columns
+  std::vector<int64_t> row = {
+      (int64_t)stats::instructions,
+      fullBranches,
+      partialBranches,
+      numBranches,
+      (int64_t)time::getUserTime().toMicroseconds(),
+      (int64_t)executor.states.size(),
+      (int64_t)(util::GetTotalMallocUsage() +
+                executor.memory->getUsedDeterministicSize()),
+      (int64_t)stats::queries,
+      (int64_t)stats::queryConstructs,
+      0, // was numObjects
+      (int64_t)elapsed().toMicroseconds(),
+      (int64_t)stats::coveredInstructions,
+      (int64_t)stats::uncoveredInstructions,
+      (int64_t)stats::queryTime,
+      (int64_t)stats::solverTime,
+      (int64_t)stats::cexCacheTime,
+      (int64_t)stats::forkTime,
+      (int64_t)stats::resolveTime,
+      (int64_t)stats::queryCexCacheMisses,
+      (int64_t)stats::queryCexCacheHits,
 #ifdef KLEE_ARRAY_DEBUG
-  sqlite3_bind_int64(insertStmt, 21, stats::arrayHashTime);
+      (int64_t)stats::arrayHashTime,
 #endif
-  int errCode = sqlite3_step(insertStmt);
-  if(errCode != SQLITE_DONE) klee_error("Error writing stats data: %s", sqlite3_errmsg(statsFile));
-  sqlite3_reset(insertStmt);
-
-  statsWriteCount++;
-  if(statsWriteCount == statsCommitEvery) {
-    errCode = sqlite3_step(transactionEndStmt);
-    if (errCode != SQLITE_DONE) klee_warning("Transaction commit error: %s", sqlite3_errmsg(statsFile));
-    sqlite3_reset(transactionEndStmt);
-    errCode = sqlite3_step(transactionBeginStmt);
-    if (errCode != SQLITE_DONE) klee_warning("Transaction begin error: %s", sqlite3_errmsg(statsFile));
-    sqlite3_reset(transactionBeginStmt);
-
-    statsWriteCount = 0;
-  }
+  };
+  // the allocator occupancy and query purposes follow the fixed columns
+  row.push_back(ExprAllocator::getSlabBytes());
+  row.push_back(ExprAllocator::getUsedBytes());
+  row.push_back(ObjectState::liveObjectStates);
+  row.push_back(ObjectState::liveObjectStateBytes);
+  uint64_t constraints = 0;
+  for (const ExecutionState *es : executor.states)
+    constraints += es->constraints.size();
+  row.push_back(constraints);
+  for (Statistic *s : getQueryStatistics())
+    row.push_back(*s);
+
+  post([this, row]() {
+    for (size_t i = 0; i != row.size(); ++i)
+      sqlite3_bind_int64(insertStmt, i + 1, row[i]);
+    int errCode = sqlite3_step(insertStmt);
+    if(errCode != SQLITE_DONE) klee_error("Error writing stats data: %s", sqlite3_errmsg(statsFile));
+    sqlite3_reset(insertStmt);
+
+    statsWriteCount++;
+    if(statsWriteCount == statsCommitEvery) {
+      errCode = sqlite3_step(transactionEndStmt);
+      if (errCode != SQLITE_DONE) klee_warning("Transaction commit error: %s", sqlite3_errmsg(statsFile));
+      sqlite3_reset(transactionEndStmt);
+      errCode = sqlite3_step(transactionBeginStmt);
+      if (errCode != SQLITE_DONE) klee_warning("Transaction begin error: %s", sqlite3_errmsg(statsFile));
+      sqlite3_reset(transactionBeginStmt);
+
+      statsWriteCount = 0;
+    }
+  });
 }
 
 void StatsTracker::updateStateStatistics(uint64_t addend) {
-  for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
-         ie = executor.states.end(); it != ie; ++it) {
+  for (auto it = executor.states.begin(), ie = executor.states.end();
+       it != ie; ++it) {
     ExecutionState &state = **it;
     if (!state.pc)
         continue;
@@ -579,44 +806,92 @@ void StatsTracker::updateStateStatistics(uint64_t addend) {
   }
 }
 
-void StatsTracker::writeIStats() {
-  const auto m = executor.kmodule->module.get();
-  uint64_t istatsMask = 0;
-  llvm::raw_fd_ostream &of = *istatsFile;
-  
-  // We assume that we didn't move the file pointer
-  unsigned istatsSize = of.tell();
+void StatsTracker::buildIStatsLayout() {
+  StatisticManager &sm = *theStatisticManager;
+  istatsMask.assign(sm.getNumStatistics(), false);
 
-  of.seek(0);
+  // Max is 13, sadly
+  istatsMask[sm.getStatisticID("Queries")] = true;
+  istatsMask[sm.getStatisticID("QueryTime")] = true;
+  istatsMask[sm.getStatisticID("ResolveTime")] = true;
+  istatsMask[sm.getStatisticID("Instructions")] = true;
+  istatsMask[sm.getStatisticID("InstructionTimes")] = true;
+  istatsMask[sm.getStatisticID("Forks")] = true;
+  if (IStatsQueryPurposes) {
+    for (unsigned i = 0; i != NumQueryPurposes; ++i)
+      istatsMask[stats::purposeQueryTime[i].getID()] = true;
+  } else {
+    istatsMask[sm.getStatisticID("QueriesValid")] = true;
+    istatsMask[sm.getStatisticID("QueriesInvalid")] = true;
+    istatsMask[sm.getStatisticID("InstructionRealTimes")] = true;
+    istatsMask[sm.getStatisticID("CoveredInstructions")] = true;
+    istatsMask[sm.getStatisticID("UncoveredInstructions")] = true;
+    istatsMask[sm.getStatisticID("States")] = true;
+    istatsMask[sm.getStatisticID("MinDistToUncovered")] = true;
+  }
+
+  executor.kmodule->infos->computeAssemblyLines();
+  std::string sourceFile = "";
+  for (Function &fn : *executor.kmodule->module) {
+    if (fn.isDeclaration())
+      continue;
+    IStatsFunction entry;
+    raw_string_ostream header(entry.header);
+    // Always try to write the filename before the function name, as otherwise
+    // KCachegrind can create two entries for the function, one with an
+    // unnamed file and one without.
+    const FunctionInfo &fi = executor.kmodule->infos->getFunctionInfo(fn);
+    if (fi.file != sourceFile) {
+      header << "fl=" << fi.file << "\n";
+      sourceFile = fi.file;
+    }
+    header << "fn=" << fn.getName() << "\n";
+    header.flush();
+
+    entry.begin = istatsRows.size();
+    for (BasicBlock &bb : fn) {
+      for (Instruction &instr : bb) {
+        const InstructionInfo &ii = executor.kmodule->infos->getInfo(instr);
+        std::string row;
+        raw_string_ostream os(row);
+        if (ii.file != sourceFile) {
+          os << "fl=" << ii.file << "\n";
+          sourceFile = ii.file;
+        }
+        os << ii.assemblyLine << " " << ii.line << " ";
+        os.flush();
+        istatsRows.push_back(std::move(row));
+        istatsRowIds.push_back(ii.id);
+        istatsRowAssemblyLines.push_back(ii.assemblyLine);
+        istatsRowInstructions.push_back(&instr);
+      }
+    }
+    entry.end = istatsRows.size();
+    istatsFunctions.push_back(std::move(entry));
+  }
+}
+
+void StatsTracker::writeIStats(bool full) {
+  if (istatsMask.empty())
+    buildIStatsLayout();
 
+  const auto m = executor.kmodule->module.get();
+  StatisticManager &sm = *theStatisticManager;
+  unsigned nStats = sm.getNumStatistics();
+  auto snapshot = std::make_unique<IStatsSnapshot>();
+  snapshot->full = full || !istatsDeltaFile;
+
+  raw_string_ostream of(snapshot->header);
   of << "version: 1\n";
   of << "creator: klee\n";
   of << "pid: " << getpid() << "\n";
   of << "cmd: " << m->getModuleIdentifier() << "\n\n";
   of << "\n";
 
-  StatisticManager &sm = *theStatisticManager;
-  unsigned nStats = sm.getNumStatistics();
-
-  // Max is 13, sadly
-  istatsMask |= 1<<sm.getStatisticID("Queries");
-  istatsMask |= 1<<sm.getStatisticID("QueriesValid");
-  istatsMask |= 1<<sm.getStatisticID("QueriesInvalid");
-  istatsMask |= 1<<sm.getStatisticID("QueryTime");
-  istatsMask |= 1<<sm.getStatisticID("ResolveTime");
-  istatsMask |= 1<<sm.getStatisticID("Instructions");
-  istatsMask |= 1<<sm.getStatisticID("InstructionTimes");
-  istatsMask |= 1<<sm.getStatisticID("InstructionRealTimes");
-  istatsMask |= 1<<sm.getStatisticID("Forks");
-  istatsMask |= 1<<sm.getStatisticID("CoveredInstructions");
-  istatsMask |= 1<<sm.getStatisticID("UncoveredInstructions");
-  istatsMask |= 1<<sm.getStatisticID("States");
-  istatsMask |= 1<<sm.getStatisticID("MinDistToUncovered");
-
   of << "positions: instr line\n";
 
   for (unsigned i=0; i<nStats; i++) {
-    if (istatsMask & (1<<i)) {
+    if (istatsMask[i]) {
       Statistic &s = sm.getStatistic(i);
       of << "event: " << s.getShortName() << " : " 
          << s.getName() << "\n";
@@ -625,112 +900,289 @@ void StatsTracker::writeIStats() {
 
   of << "events: ";
   for (unsigned i=0; i<nStats; i++) {
-    if (istatsMask & (1<<i))
+    if (istatsMask[i])
       of << sm.getStatistic(i).getShortName() << " ";
   }
   of << "\n";
-  
+  of << "ob=" << objectFilename << "\n";
+  of.flush();
+
   // set state counts, decremented after we process so that we don't
   // have to zero all records each time.
-  if (istatsMask & (1<<stats::states.getID()))
+  if (istatsMask[stats::states.getID()])
     updateStateStatistics(1);
 
-  std::string sourceFile = "";
-
-  CallSiteSummaryTable callSiteStats;
-  if (UseCallPaths)
+  std::vector<Statistic *> selected;
+  for (unsigned i = 0; i < nStats; i++)
+    if (istatsMask[i])
+      selected.push_back(&sm.getStatistic(i));
+  snapshot->values.reserve(istatsRows.size() * selected.size());
+  for (unsigned index : istatsRowIds)
+    for (Statistic *s : selected)
+      snapshot->values.push_back(sm.getIndexedValue(*s, index));
+
+  if (UseCallPaths) {
+    CallSiteSummaryTable callSiteStats;
     callPathManager.getSummaryStatistics(callSiteStats);
+    for (size_t row = 0; row != istatsRows.size(); ++row) {
+      const Instruction *instr = istatsRowInstructions[row];
+      if (!isa<CallInst>(instr) && !isa<InvokeInst>(instr))
+        continue;
+      auto it = callSiteStats.find(instr);
+      if (it == callSiteStats.end())
+        continue;
+      const InstructionInfo &ii = executor.kmodule->infos->getInfo(*instr);
+      std::string text;
+      raw_string_ostream os(text);
+      for (auto fit = it->second.begin(), fie = it->second.end();
+           fit != fie; ++fit) {
+        const Function *f = fit->first;
+        CallSiteInfo &csi = fit->second;
+        const FunctionInfo &fii =
+            executor.kmodule->infos->getFunctionInfo(*f);
+
+        if (fii.file!="" && fii.file!=ii.file)
+          os << "cfl=" << fii.file << "\n";
+        os << "cfn=" << f->getName().str() << "\n";
+        os << "calls=" << csi.count << " ";
+        os << fii.assemblyLine << " ";
+        os << fii.line << "\n";
+
+        os << ii.assemblyLine << " ";
+        os << ii.line << " ";
+        for (Statistic *s : selected) {
+          // Hack, ignore things that don't make sense on
+          // call paths.
+          uint64_t value = s == &stats::uncoveredInstructions
+                               ? 0
+                               : csi.statistics.getValue(*s);
+          os << value << " ";
+        }
+        os << "\n";
+      }
+      os.flush();
+      snapshot->callSites.emplace_back(row, std::move(text));
+    }
+  }
 
-  of << "ob=" << objectFilename << "\n";
+  if (istatsMask[stats::states.getID()])
+    updateStateStatistics((uint64_t)-1);
 
-  for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
-       fnIt != fn_ie; ++fnIt) {
-    if (!fnIt->isDeclaration()) {
-      // Always try to write the filename before the function name, as otherwise
-      // KCachegrind can create two entries for the function, one with an
-      // unnamed file and one without.
-      Function *fn = &*fnIt;
-      const FunctionInfo &ii = executor.kmodule->infos->getFunctionInfo(*fn);
-      if (ii.file != sourceFile) {
-        of << "fl=" << ii.file << "\n";
-        sourceFile = ii.file;
+  // a snapshot the writer has not picked up yet is outdated now
+  bool queued;
+  {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    queued = pendingIStats != nullptr;
+    if (queued && pendingIStats->full)
+      snapshot->full = true;
+    pendingIStats = std::move(snapshot);
+  }
+  if (!queued) {
+    post([this]() {
+      std::unique_ptr<IStatsSnapshot> snapshot;
+      {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        snapshot = std::move(pendingIStats);
       }
-      
-      of << "fn=" << fnIt->getName().str() << "\n";
-      for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
-           bbIt != bb_ie; ++bbIt) {
-        for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
-             it != ie; ++it) {
-          Instruction *instr = &*it;
-          const InstructionInfo &ii = executor.kmodule->infos->getInfo(*instr);
-          unsigned index = ii.id;
-          if (ii.file!=sourceFile) {
-            of << "fl=" << ii.file << "\n";
-            sourceFile = ii.file;
-          }
-          of << ii.assemblyLine << " ";
-          of << ii.line << " ";
-          for (unsigned i=0; i<nStats; i++)
-            if (istatsMask&(1<<i))
-              of << sm.getIndexedValue(sm.getStatistic(i), index) << " ";
-          of << "\n";
-
-          if (UseCallPaths && 
-              (isa<CallInst>(instr) || isa<InvokeInst>(instr))) {
-            CallSiteSummaryTable::iterator it = callSiteStats.find(instr);
-            if (it!=callSiteStats.end()) {
-              for (auto fit = it->second.begin(), fie = it->second.end();
-                   fit != fie; ++fit) {
-                const Function *f = fit->first;
-                CallSiteInfo &csi = fit->second;
-                const FunctionInfo &fii =
-                    executor.kmodule->infos->getFunctionInfo(*f);
-
-                if (fii.file!="" && fii.file!=sourceFile)
-                  of << "cfl=" << fii.file << "\n";
-                of << "cfn=" << f->getName().str() << "\n";
-                of << "calls=" << csi.count << " ";
-                of << fii.assemblyLine << " ";
-                of << fii.line << "\n";
-
-                of << ii.assemblyLine << " ";
-                of << ii.line << " ";
-                for (unsigned i=0; i<nStats; i++) {
-                  if (istatsMask&(1<<i)) {
-                    Statistic &s = sm.getStatistic(i);
-                    uint64_t value;
-
-                    // Hack, ignore things that don't make sense on
-                    // call paths.
-                    if (&s == &stats::uncoveredInstructions) {
-                      value = 0;
-                    } else {
-                      value = csi.statistics.getValue(s);
-                    }
-
-                    of << value << " ";
-                  }
-                }
-                of << "\n";
-              }
-            }
-          }
-        }
+      // the first write is in full, so run.istats has all rows
+      if (snapshot->full || istatsWrittenValues.empty())
+        writeIStatsSnapshot(*snapshot);
+      else
+        writeIStatsDelta(*snapshot);
+    });
+  }
+}
+
+void StatsTracker::writeIStatsDelta(const IStatsSnapshot &snapshot) {
+  if (istatsRows.empty())
+    return;
+  llvm::raw_fd_ostream &of = *istatsDeltaFile;
+  size_t nValues = snapshot.values.size() / istatsRows.size();
+  if (istatsDeltaValues.empty())
+    istatsDeltaValues = istatsWrittenValues;
+
+  // rows are named by their assembly line, which is unique
+  of << "delta: " << ++istatsDeltas << "\n";
+  auto values = snapshot.values.begin();
+  auto last = istatsDeltaValues.begin();
+  for (size_t row = 0; row != istatsRows.size(); ++row) {
+    if (std::equal(values, values + nValues, last)) {
+      values += nValues;
+      last += nValues;
+      continue;
+    }
+    of << istatsRowAssemblyLines[row];
+    for (size_t i = 0; i != nValues; ++i, ++last)
+      of << " " << (*last = *values++);
+    of << "\n";
+  }
+  of.flush();
+}
+
+void StatsTracker::writeIStatsSnapshot(const IStatsSnapshot &snapshot) {
+  llvm::raw_fd_ostream &of = *istatsFile;
+  size_t nValues = istatsRows.empty()
+                       ? 0
+                       : snapshot.values.size() / istatsRows.size();
+  if (istatsChunks.empty()) {
+    istatsChunks.resize(istatsFunctions.size());
+    istatsChunkHasCalls.assign(istatsFunctions.size(), false);
+  }
+
+  // We assume that we didn't move the file pointer
+  of.seek(0);
+  of << snapshot.header;
+
+  auto callSite = snapshot.callSites.begin();
+  for (size_t f = 0; f != istatsFunctions.size(); ++f) {
+    const IStatsFunction &fn = istatsFunctions[f];
+    auto values = snapshot.values.begin() + fn.begin * nValues;
+    auto valuesEnd = snapshot.values.begin() + fn.end * nValues;
+    bool hasCalls = callSite != snapshot.callSites.end() &&
+                    callSite->first < fn.end;
+
+    // functions whose statistics did not change keep their text
+    std::string &chunk = istatsChunks[f];
+    if (chunk.empty() || hasCalls || istatsChunkHasCalls[f] ||
+        !std::equal(values, valuesEnd,
+                    istatsWrittenValues.begin() + fn.begin * nValues)) {
+      chunk.clear();
+      raw_string_ostream os(chunk);
+      os << fn.header;
+      for (size_t row = fn.begin; row != fn.end; ++row) {
+        os << istatsRows[row];
+        for (size_t i = 0; i != nValues; ++i)
+          os << *values++ << " ";
+        os << "\n";
+        for (; callSite != snapshot.callSites.end() && callSite->first == row;
+             ++callSite)
+          os << callSite->second;
       }
+      os.flush();
     }
+    istatsChunkHasCalls[f] = hasCalls;
+    of << chunk;
+  }
+  istatsWrittenValues = snapshot.values;
+  istatsDeltaValues.clear();
+  // deltas before this point are older than run.istats now
+  if (istatsDeltaFile) {
+    *istatsDeltaFile << "full\n";
+    istatsDeltaFile->flush();
   }
 
-  if (istatsMask & (1<<stats::states.getID()))
-    updateStateStatistics((uint64_t)-1);
-  
   // Clear then end of the file if necessary (no truncate op?).
-  unsigned pos = of.tell();
-  for (unsigned i=pos; i<istatsSize; ++i)
+  uint64_t pos = of.tell();
+  for (uint64_t i=pos; i<istatsSize; ++i)
     of << '\n';
+  istatsSize = of.tell();
   
   of.flush();
 }
 
+/// Turn a statistic name like QueryCexCacheHits into query_cex_cache_hits.
+static std::string getMetricName(const std::string &name) {
+  std::string result = "klee_";
+  for (size_t i = 0; i != name.size(); ++i) {
+    char c = name[i];
+    if (isupper(c) && i &&
+        (islower(name[i - 1]) ||
+         (i + 1 != name.size() && islower(name[i + 1]))))
+      result += '_';
+    result += tolower(c);
+  }
+  return result;
+}
+
+void StatsTracker::publishMetrics() {
+  std::string text;
+  raw_string_ostream os(text);
+
+  StatisticManager &sm = *theStatisticManager;
+  for (unsigned i = 0, e = sm.getNumStatistics(); i != e; ++i) {
+    Statistic &s = sm.getStatistic(i);
+    // these go up and down or are only meaningful per instruction
+    if (&s == &stats::uncoveredInstructions || &s == &stats::states ||
+        &s == &stats::minDistToUncovered || &s == &stats::minDistToReturn ||
+        &s == &stats::reachableUncovered)
+      continue;
+    std::string name = getMetricName(s.getName());
+    os << "# TYPE " << name << " counter\n"
+       << "# HELP " << name << " " << s.getName()
+       << " (times in microseconds)\n"
+       << name << "_total " << sm.getValue(s) << "\n";
+  }
+
+  auto gauge = [&os](const char *name, const char *help, double value) {
+    os << "# TYPE klee_" << name << " gauge\n"
+       << "# HELP klee_" << name << " " << help << "\n"
+       << "klee_" << name << " " << value << "\n";
+  };
+  auto ratio = [](uint64_t hits, uint64_t misses) {
+    return hits + misses ? (double)hits / (hits + misses) : 0.0;
+  };
+  gauge("active_states", "States being explored",
+        executor.states.size());
+  gauge("memory_bytes", "Memory in use",
+        util::GetTotalMallocUsage() +
+            executor.memory->getUsedDeterministicSize());
+  gauge("uncovered_instructions", "Instructions not covered yet",
+        stats::uncoveredInstructions);
+  gauge("elapsed_seconds", "Wall time since the start of the run",
+        elapsed().toSeconds());
+  gauge("query_cache_hit_ratio", "Hit ratio of the query cache",
+        ratio(stats::queryCacheHits, stats::queryCacheMisses));
+  gauge("cex_cache_hit_ratio", "Hit ratio of the counterexample cache",
+        ratio(stats::queryCexCacheHits, stats::queryCexCacheMisses));
+  gauge("expr_allocations_per_instruction",
+        "Expressions created per executed instruction",
+        stats::instructions ? (double)stats::exprAllocations /
+                                  stats::instructions
+                            : 0.0);
+  os << "# EOF\n";
+  os.flush();
+
+  metricsServer->publish(std::move(text));
+}
+
+void StatsTracker::post(std::function<void()> job) {
+  if (!StatsWriterThread) {
+    job();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    if (!writer.joinable())
+      writer = std::thread(&StatsTracker::runWriter, this);
+    writerJobs.push_back(std::move(job));
+  }
+  writerCondition.notify_all();
+}
+
+void StatsTracker::waitForWriter() {
+  std::unique_lock<std::mutex> lock(writerMutex);
+  writerCondition.wait(lock,
+                       [this] { return writerJobs.empty() && !writerBusy; });
+}
+
+void StatsTracker::runWriter() {
+  std::unique_lock<std::mutex> lock(writerMutex);
+  while (true) {
+    writerCondition.wait(
+        lock, [this] { return writerStopping || !writerJobs.empty(); });
+    if (writerJobs.empty())
+      return;
+    std::function<void()> job = std::move(writerJobs.front());
+    writerJobs.pop_front();
+    writerBusy = true;
+    lock.unlock();
+    job();
+    lock.lock();
+    writerBusy = false;
+    writerCondition.notify_all();
+  }
+}
+
 ///
 
 typedef std::map<Instruction*, std::vector<Function*> > calltargets_ty;
@@ -775,7 +1227,95 @@ uint64_t klee::computeMinDistToUncovered(const KInstruction *ki,
   }
 }
 
+namespace {
+/// An instruction of the graph minDistToUncovered is computed over.
+struct DistanceNode {
+  /// The statistics index of the instruction.
+  unsigned id;
+  /// The distance added by passing through the instruction, 0 if it is a
+  /// call to functions which cannot return.
+  unsigned through;
+  /// The nodes of the instructions which can be followed by this one and
+  /// which can be passed through.
+  std::vector<unsigned> preds;
+};
+}
+
+/// The instruction graph, which does not change once the call targets and
+/// the shortest paths through functions are known, and the number of
+/// covered instructions when the distances were last computed.
+static std::vector<DistanceNode> distanceGraph;
+static uint64_t lastCoveredInstructions = ~0ULL;
+
+static void buildDistanceGraph(Module &m, const InstructionInfoTable &infos) {
+  std::unordered_map<Instruction *, unsigned> nodes;
+  for (Function &fn : m)
+    for (BasicBlock &bb : fn)
+      for (Instruction &inst : bb) {
+        nodes[&inst] = distanceGraph.size();
+        distanceGraph.emplace_back();
+        distanceGraph.back().id = infos.getInfo(inst).id;
+      }
+
+  for (auto &entry : nodes) {
+    Instruction *inst = entry.first;
+    DistanceNode &node = distanceGraph[entry.second];
+    node.through = 0;
+    if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
+      for (Function *f : callTargets[inst]) {
+        uint64_t dist = functionShortestPath[f];
+        if (dist) {
+          dist = 1+dist; // count instruction itself
+          if (node.through==0 || dist<node.through)
+            node.through = dist;
+        }
+      }
+    } else {
+      node.through = 1;
+    }
+    if (!node.through)
+      continue;
+    for (Instruction *succ : getSuccs(inst))
+      distanceGraph[nodes[succ]].preds.push_back(entry.second);
+  }
+}
+
+/// Set minDistToUncovered of every instruction to the shortest distance to
+/// an uncovered instruction, 0 if none is reachable.
+static void computeDistancesToUncovered(StatisticManager &sm) {
+  // 0 is unreachable; uncovered instructions are at distance 1
+  std::vector<uint64_t> dist(distanceGraph.size());
+  typedef std::pair<uint64_t, unsigned> QueueEntry;
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                      std::greater<QueueEntry> > queue;
+  for (unsigned i = 0, e = distanceGraph.size(); i != e; ++i) {
+    dist[i] = sm.getIndexedValue(stats::uncoveredInstructions,
+                                 distanceGraph[i].id);
+    if (dist[i])
+      queue.push(QueueEntry(dist[i], i));
+  }
+
+  while (!queue.empty()) {
+    QueueEntry top = queue.top();
+    queue.pop();
+    if (top.first != dist[top.second])
+      continue;
+    for (unsigned pred : distanceGraph[top.second].preds) {
+      uint64_t val = distanceGraph[pred].through + top.first;
+      if (dist[pred]==0 || val<dist[pred]) {
+        dist[pred] = val;
+        queue.push(QueueEntry(val, pred));
+      }
+    }
+  }
+
+  for (unsigned i = 0, e = distanceGraph.size(); i != e; ++i)
+    sm.setIndexedValue(stats::minDistToUncovered, distanceGraph[i].id,
+                       dist[i]);
+}
+
 void StatsTracker::computeReachableUncovered() {
+  ++uncoveredEpoch;
   KModule *km = executor.kmodule.get();
   const auto m = km->module.get();
   static bool init = true;
@@ -913,87 +1453,18 @@ void StatsTracker::computeReachableUncovered() {
     } while (changed);
   }
 
-  // compute minDistToUncovered, 0 is unreachable
-  std::vector<Instruction *> instructions;
-  for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
-       fnIt != fn_ie; ++fnIt) {
-    // Not sure if I should bother to preorder here.
-    for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
-         bbIt != bb_ie; ++bbIt) {
-      for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
-           it != ie; ++it) {
-        Instruction *inst = &*it;
-        unsigned id = infos.getInfo(*inst).id;
-        instructions.push_back(inst);
-        sm.setIndexedValue(stats::minDistToUncovered, 
-                           id, 
-                           sm.getIndexedValue(stats::uncoveredInstructions, id));
-      }
-    }
-  }
-  
-  std::reverse(instructions.begin(), instructions.end());
-  
-  // I'm so lazy it's not even worklisted.
-  bool changed;
-  do {
-    changed = false;
-    for (std::vector<Instruction*>::iterator it = instructions.begin(),
-           ie = instructions.end(); it != ie; ++it) {
-      Instruction *inst = *it;
-      uint64_t best, cur = best = sm.getIndexedValue(stats::minDistToUncovered,
-                                                     infos.getInfo(*inst).id);
-      unsigned bestThrough = 0;
-      
-      if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
-        std::vector<Function*> &targets = callTargets[inst];
-        for (std::vector<Function*>::iterator fnIt = targets.begin(),
-               ie = targets.end(); fnIt != ie; ++fnIt) {
-          uint64_t dist = functionShortestPath[*fnIt];
-          if (dist) {
-            dist = 1+dist; // count instruction itself
-            if (bestThrough==0 || dist<bestThrough)
-              bestThrough = dist;
-          }
-
-          if (!(*fnIt)->isDeclaration()) {
-            uint64_t calleeDist = sm.getIndexedValue(
-                stats::minDistToUncovered, infos.getFunctionInfo(*(*fnIt)).id);
-            if (calleeDist) {
-              calleeDist = 1+calleeDist; // count instruction itself
-              if (best==0 || calleeDist<best)
-                best = calleeDist;
-            }
-          }
-        }
-      } else {
-        bestThrough = 1;
-      }
-      
-      if (bestThrough) {
-        std::vector<Instruction*> succs = getSuccs(inst);
-        for (std::vector<Instruction*>::iterator it2 = succs.begin(),
-               ie = succs.end(); it2 != ie; ++it2) {
-          uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered,
-                                             infos.getInfo(*(*it2)).id);
-          if (dist) {
-            uint64_t val = bestThrough + dist;
-            if (best==0 || val<best)
-              best = val;
-          }
-        }
-      }
+  if (distanceGraph.empty())
+    buildDistanceGraph(*m, infos);
 
-      if (best != cur) {
-        sm.setIndexedValue(stats::minDistToUncovered, infos.getInfo(*inst).id,
-                           best);
-        changed = true;
-      }
-    }
-  } while (changed);
+  // The distances only change when instructions get covered.
+  uint64_t covered = sm.getValue(stats::coveredInstructions);
+  if (covered != lastCoveredInstructions) {
+    lastCoveredInstructions = covered;
+    computeDistancesToUncovered(sm);
+  }
 
-  for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
-         ie = executor.states.end(); it != ie; ++it) {
+  for (auto it = executor.states.begin(), ie = executor.states.end();
+       it != ie; ++it) {
     ExecutionState *es = *it;
     uint64_t currentFrameMinDist = 0;
     for (ExecutionState::stack_ty::iterator sfIt = es->stack.begin(),
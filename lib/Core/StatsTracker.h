@@ -13,9 +13,17 @@
 #include "CallPathManager.h"
 #include "klee/Internal/System/Time.h"
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <sqlite3.h>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace llvm {
   class BranchInst;
@@ -27,7 +35,9 @@ namespace llvm {
 namespace klee {
   class ExecutionState;
   class Executor;
+  class MetricsServer;
   class InstructionInfoTable;
+  struct InstructionInfo;
   class InterpreterHandler;
   struct KInstruction;
   struct StackFrame;
@@ -40,6 +50,8 @@ namespace klee {
     std::string objectFilename;
 
     std::unique_ptr<llvm::raw_fd_ostream> istatsFile;
+    /// With -istats-deltas, the rows changed between full writes.
+    std::unique_ptr<llvm::raw_fd_ostream> istatsDeltaFile;
     ::sqlite3 *statsFile = nullptr;
     ::sqlite3_stmt *transactionBeginStmt = nullptr;
     ::sqlite3_stmt *transactionEndStmt = nullptr;
@@ -55,15 +67,86 @@ namespace klee {
 
     bool updateMinDistToUncovered;
 
+    /// The stats files are written by a writer thread from snapshots the
+    /// exploration thread takes, see post().
+    std::thread writer;
+    std::mutex writerMutex;
+    std::condition_variable writerCondition;
+    std::deque<std::function<void()> > writerJobs;
+    bool writerBusy = false;
+    bool writerStopping = false;
+
+    /// A snapshot of the instruction level statistics to be written.
+    struct IStatsSnapshot {
+      std::string header;
+      /// The selected statistics of each row of istatsRows in turn.
+      std::vector<uint64_t> values;
+      /// The call site records following rows, by row.
+      std::vector<std::pair<size_t, std::string> > callSites;
+      /// Whether to rewrite run.istats rather than append a delta.
+      bool full;
+    };
+    /// The latest snapshot not picked up by the writer yet, if any.
+    std::unique_ptr<IStatsSnapshot> pendingIStats;
+
+    /// The parts of run.istats that do not change during the run, one row
+    /// per instruction: its source file marker if it differs from the
+    /// previous row, its assembly and source lines.
+    struct IStatsFunction {
+      std::string header;
+      size_t begin, end;
+    };
+    std::vector<IStatsFunction> istatsFunctions;
+    std::vector<std::string> istatsRows;
+    std::vector<unsigned> istatsRowIds;
+    std::vector<unsigned> istatsRowAssemblyLines;
+    std::vector<const llvm::Instruction *> istatsRowInstructions;
+    std::vector<bool> istatsMask;
+
+    /// Owned by the writer: the text of each function as last written and
+    /// the values it was written from, so that unchanged functions are
+    /// not formatted again.
+    std::vector<std::string> istatsChunks;
+    std::vector<uint64_t> istatsWrittenValues;
+    std::vector<bool> istatsChunkHasCalls;
+    uint64_t istatsSize = 0;
+    /// Owned by the writer: the values the last delta was taken against.
+    std::vector<uint64_t> istatsDeltaValues;
+    unsigned istatsDeltas = 0;
+
+    std::unique_ptr<MetricsServer> metricsServer;
+
+    /// The coverable instructions by the file name and line they come
+    /// from, built on the first markLinesCovered().
+    std::map<std::pair<std::string, unsigned>,
+             std::vector<const InstructionInfo *> > instructionsByLine;
+
   public:
     static bool useStatistics();
     static bool useIStats();
 
+    /// Number of times the distances to uncovered instructions were
+    /// recomputed, for consumers caching values derived from them.
+    static unsigned epoch();
+
   private:
     void updateStateStatistics(uint64_t addend);
     void writeStatsHeader();
     void writeStatsLine();
-    void writeIStats();
+    /// Write run.istats, or with -istats-deltas a delta unless \a full.
+    void writeIStats(bool full = false);
+
+    void buildIStatsLayout();
+    void writeIStatsSnapshot(const IStatsSnapshot &snapshot);
+    void writeIStatsDelta(const IStatsSnapshot &snapshot);
+    void publishMetrics();
+
+    /// Run \a job on the writer thread, or right away with
+    /// -stats-writer-thread=false.
+    void post(std::function<void()> job);
+    /// Wait until the writer finished all posted jobs.
+    void waitForWriter();
+    void runWriter();
 
   public:
     StatsTracker(Executor &_executor, std::string _objectFilename,
@@ -97,6 +180,13 @@ namespace klee {
     /// Return duration since execution start.
     time::Span elapsed();
 
+    /// Count the instructions of the source \a lines as covered, given as
+    /// file and line, as when they were covered by running a test natively.
+    /// A file matches the debug information file names it is a path suffix
+    /// of, or which are a path suffix of it.
+    void markLinesCovered(
+        const std::vector<std::pair<std::string, unsigned> > &lines);
+
     void computeReachableUncovered();
   };
 
@@ -0,0 +1,115 @@
+//===-- Subsumption.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Subsumption.h"
+
+#include "klee/Expr/ExprUtil.h"
+
+using namespace klee;
+
+namespace {
+/// Interpolants kept per point, the oldest are dropped first.
+const unsigned MaxInterpolants = 8;
+} // namespace
+
+SubsumptionNode::~SubsumptionNode() {
+  // Close the ancestors this node held the last reference to in a loop, a
+  // long path would release them recursively otherwise.
+  std::shared_ptr<SubsumptionNode> node = close();
+  while (node && node.use_count() == 1) {
+    std::shared_ptr<SubsumptionNode> next = node->close();
+    node = std::move(next);
+  }
+}
+
+std::shared_ptr<SubsumptionNode> SubsumptionNode::close() {
+  if (closed)
+    return nullptr;
+  closed = true;
+  if (complete)
+    table->add(*this);
+  if (parent)
+    parent->arrays.insert(arrays.begin(), arrays.end());
+  return std::move(parent);
+}
+
+void SubsumptionNode::noteQuery(const ref<Expr> &expr) {
+  std::vector<const Array *> read;
+  findSymbolicObjects(expr, read);
+  arrays.insert(read.begin(), read.end());
+}
+
+void SubsumptionNode::markIncomplete() {
+  for (SubsumptionNode *node = this; node && node->complete;
+       node = node->parent.get())
+    node->complete = false;
+}
+
+/***/
+
+const std::vector<const Array *> &
+SubsumptionTable::getArrays(const ref<Expr> &constraint) {
+  auto it = constraintArrays.find(constraint);
+  if (it == constraintArrays.end()) {
+    it = constraintArrays
+             .insert(std::make_pair(constraint, std::vector<const Array *>()))
+             .first;
+    findSymbolicObjects(constraint, it->second);
+  }
+  return it->second;
+}
+
+void SubsumptionTable::add(const SubsumptionNode &node) {
+  // the constraints sharing arrays with the queries, to a fixpoint
+  std::unordered_set<const Array *> relevant = node.arrays;
+  std::vector<ref<Expr> > rest(node.constraints.begin(),
+                               node.constraints.end());
+  std::vector<ref<Expr> > interpolant;
+  for (bool changed = !relevant.empty(); changed;) {
+    changed = false;
+    for (auto it = rest.begin(); it != rest.end();) {
+      const std::vector<const Array *> &read = getArrays(*it);
+      bool shares = false;
+      for (const Array *array : read)
+        if (relevant.count(array)) {
+          shares = true;
+          break;
+        }
+      if (!shares) {
+        ++it;
+        continue;
+      }
+      relevant.insert(read.begin(), read.end());
+      interpolant.push_back(*it);
+      it = rest.erase(it);
+      changed = true;
+    }
+  }
+
+  std::vector<std::vector<ref<Expr> > > &entry =
+      interpolants[node.fingerprint];
+  // an empty interpolant subsumes every state at the point
+  if (interpolant.empty())
+    entry.clear();
+  else if (entry.size() == 1 && entry[0].empty())
+    return;
+  else if (entry.size() == MaxInterpolants)
+    entry.erase(entry.begin());
+  entry.push_back(std::move(interpolant));
+}
+
+std::shared_ptr<SubsumptionNode>
+SubsumptionTable::open(const std::shared_ptr<SubsumptionNode> &node,
+                       uint64_t fingerprint,
+                       const ConstraintManager &constraints) {
+  if (node && node->constraints == constraints)
+    return node;
+  return std::make_shared<SubsumptionNode>(shared_from_this(), node,
+                                           fingerprint, constraints);
+}
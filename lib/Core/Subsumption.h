@@ -0,0 +1,108 @@
+//===-- Subsumption.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SUBSUMPTION_H
+#define KLEE_SUBSUMPTION_H
+
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace klee {
+  class Array;
+  class SubsumptionTable;
+
+  /// SubsumptionNode - The part of the exploration below a point where a
+  /// state entered a basic block with new constraints, used by
+  /// -subsume-states. The states exploring it share the node, and it is
+  /// closed once the last of them is gone.
+  ///
+  /// The node collects the arrays that the queries of these states read.
+  /// Its interpolant is made of the constraints it was opened with that
+  /// share arrays with them, directly or through other such constraints.
+  /// Any other constraint is independent of every query below the node.
+  /// If a later state reaches the point with the same stack and memory,
+  /// and its constraints imply the interpolant, then each of its paths
+  /// was explored below the node already.
+  class SubsumptionNode {
+    friend class SubsumptionTable;
+
+    std::shared_ptr<SubsumptionTable> table;
+    std::shared_ptr<SubsumptionNode> parent;
+    /// The location, stack and memory of the state the node was opened
+    /// for, see ExecutionState::getContextFingerprint.
+    uint64_t fingerprint;
+    ConstraintManager constraints;
+    /// The arrays read by the queries below the node.
+    std::unordered_set<const Array *> arrays;
+    /// Cleared once a state below the node left paths unexplored.
+    bool complete = true;
+    bool closed = false;
+
+    /// Pass the arrays on to the parent and record the interpolant if the
+    /// node is complete. \return the parent.
+    std::shared_ptr<SubsumptionNode> close();
+
+  public:
+    SubsumptionNode(std::shared_ptr<SubsumptionTable> table,
+                    std::shared_ptr<SubsumptionNode> parent,
+                    uint64_t fingerprint, const ConstraintManager &constraints)
+        : table(std::move(table)), parent(std::move(parent)),
+          fingerprint(fingerprint), constraints(constraints) {}
+    ~SubsumptionNode();
+
+    SubsumptionNode(const SubsumptionNode &) = delete;
+    SubsumptionNode &operator=(const SubsumptionNode &) = delete;
+
+    /// Note a query about \p expr by a state below the node.
+    void noteQuery(const ref<Expr> &expr);
+
+    /// Note that a state below the node did not explore all of its paths:
+    /// it ended early or on an error, was merged into another state,
+    /// concretized a value or skipped a fork.
+    void markIncomplete();
+  };
+
+  /// SubsumptionTable - The interpolants of the complete nodes, by the
+  /// fingerprint of their point.
+  class SubsumptionTable
+      : public std::enable_shared_from_this<SubsumptionTable> {
+    friend class SubsumptionNode;
+
+    std::unordered_map<uint64_t, std::vector<std::vector<ref<Expr> > > >
+        interpolants;
+    /// The arrays read by each constraint an interpolant was computed from.
+    ExprHashMap<std::vector<const Array *> > constraintArrays;
+
+    const std::vector<const Array *> &getArrays(const ref<Expr> &constraint);
+    void add(const SubsumptionNode &node);
+
+  public:
+    /// The node of a state entering a block at \p fingerprint with
+    /// \p constraints, whose node so far is \p node. A new node is only
+    /// opened if the constraints changed since.
+    std::shared_ptr<SubsumptionNode>
+    open(const std::shared_ptr<SubsumptionNode> &node, uint64_t fingerprint,
+         const ConstraintManager &constraints);
+
+    /// The interpolants recorded at \p fingerprint, or null.
+    const std::vector<std::vector<ref<Expr> > > *
+    lookup(uint64_t fingerprint) const {
+      auto it = interpolants.find(fingerprint);
+      return it == interpolants.end() ? nullptr : &it->second;
+    }
+  };
+}
+
+#endif /* KLEE_SUBSUMPTION_H */
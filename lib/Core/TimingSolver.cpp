@@ -11,17 +11,144 @@
 
 #include "klee/Config/Version.h"
 #include "klee/ExecutionState.h"
+#include "klee/OptionCategories.h"
 #include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
 #include "klee/Statistics.h"
 #include "klee/TimerStatIncrementer.h"
 
 #include "CoreStats.h"
+#include "EventTrace.h"
+#include "Subsumption.h"
 #include "klee/Expr/Assignment.h"
 #include "klee/Expr/ExprUtil.h"
 
+#include "llvm/Support/CommandLine.h"
+
 using namespace klee;
 using namespace llvm;
 
+namespace {
+cl::opt<bool> UseRangeFastPath(
+    "use-range-fast-path", cl::init(true),
+    cl::desc("Decide queries from the bounds the path constraints put on the "
+             "bytes they read, when possible (default=true)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> ReuseModels(
+    "reuse-models", cl::init(false),
+    cl::desc("Keep the last model the solver found for each state while it "
+             "satisfies the state's constraints, and answer the queries it "
+             "decides from it. Feasibility checks then ask for models "
+             "(default=false)"),
+    cl::cat(SolvingCat));
+}
+
+/// Note a query about \p expr for the subsumption node of the state.
+static void noteQuery(const ExecutionState &state, const ref<Expr> &expr) {
+  if (state.subsumptionNode && !isa<ConstantExpr>(expr))
+    state.subsumptionNode->noteQuery(expr);
+}
+
+/// Decide a boolean expression from the bits known in the expressions it is
+/// built from, whatever the state's constraints.
+static bool decideByKnownBits(const ref<Expr> &expr, bool &value) {
+  if (!expr->isKnownBool(value))
+    return false;
+  ++stats::knownBitsQueries;
+  return true;
+}
+
+bool TimingSolver::decideByRange(const ExecutionState &state, ref<Expr> expr,
+                                 bool &value) {
+  if (!UseRangeFastPath)
+    return false;
+  ValueRange range = state.constraints.getByteBounds().evaluate(expr);
+  if (!range.isFixed())
+    return false;
+  // the path constraints are satisfiable, so a fixed value is reached
+  value = range.min();
+  ++stats::rangeQueries;
+  return true;
+}
+
+ref<ConstantExpr> TimingSolver::evaluateInModel(const ExecutionState &state,
+                                                ref<Expr> expr) {
+  if (!ReuseModels || !state.model)
+    return ref<ConstantExpr>();
+  return dyn_cast<ConstantExpr>(state.model->evaluate(expr));
+}
+
+bool TimingSolver::solveForCounterexample(const ExecutionState &state,
+                                          ref<Expr> expr, bool &valid) {
+  std::shared_ptr<const Assignment> model;
+  bool hasSolution;
+  if (!solver->impl->computeInitialValues(Query(state.constraints, expr),
+                                          model, hasSolution))
+    return false;
+  valid = !hasSolution;
+  if (hasSolution)
+    state.model = model;
+  return true;
+}
+
+bool TimingSolver::evaluateWithModels(const ExecutionState &state,
+                                      ref<Expr> expr,
+                                      Solver::Validity &result) {
+  bool valid;
+  ref<ConstantExpr> value = evaluateInModel(state, expr);
+  if (value.isNull()) {
+    if (!solveForCounterexample(state, expr, valid))
+      return false;
+    if (valid) {
+      result = Solver::True;
+      return true;
+    }
+    value = ConstantExpr::alloc(0, Expr::Bool);
+  } else {
+    ++stats::modelQueries;
+  }
+
+  // the model shows that the expression can take its value, so only the
+  // other one is left to rule out
+  if (value->isTrue()) {
+    if (!solveForCounterexample(state, expr, valid))
+      return false;
+    result = valid ? Solver::True : Solver::Unknown;
+  } else {
+    if (!solveForCounterexample(state, Expr::createIsZero(expr), valid))
+      return false;
+    result = valid ? Solver::False : Solver::Unknown;
+  }
+  return true;
+}
+
+void TimingSolver::chargeQuery(const ExecutionState &state, time::Span cost,
+                               uint64_t coreQueries, bool success) {
+  state.queryCost += cost;
+  if (state.mergedStates)
+    stats::mergedSolverTime += cost.toMicroseconds();
+  ++state.solverQueries;
+  ++stats::purposeQueries[purpose];
+  stats::purposeQueryTime[purpose] += cost.toMicroseconds();
+  if (!success)
+    ++stats::purposeQueryTimeouts[purpose];
+  if (EventTrace::enabled()) {
+    uint64_t arg = purpose | (stats::queries != coreQueries ? 0x100 : 0);
+    EventTrace::record(TraceEvent::Query, &state, arg,
+                       time::getWallTime() - cost, cost);
+  }
+  if (stats::queries == coreQueries) {
+    ++stats::purposeQueryCacheHits[purpose];
+  } else {
+    ++state.coreSolverQueries;
+    // the time of a failed query says how long it was allowed to run
+    if (success)
+      latencies.record(cost);
+  }
+}
+
 /***/
 
 bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
@@ -31,15 +158,36 @@ bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
     result = CE->isTrue() ? Solver::True : Solver::False;
     return true;
   }
+  noteQuery(state, expr);
+
+  // Constraints are only added along a path, so what was decided stays so.
+  if (auto decided = state.decidedExprs.lookup(expr)) {
+    result = decided->second ? Solver::True : Solver::False;
+    ++stats::pathQueries;
+    return true;
+  }
 
   TimerStatIncrementer timer(stats::solverTime);
+  uint64_t coreQueries = stats::queries;
 
+  ref<Expr> original = expr;
   if (simplifyExprs)
     expr = state.constraints.simplifyExpr(expr);
 
-  bool success = solver->evaluate(Query(state.constraints, expr), result);
+  bool value;
+  bool success = true;
+  if (decideByKnownBits(expr, value) || decideByRange(state, expr, value))
+    result = value ? Solver::True : Solver::False;
+  else if (ReuseModels)
+    success = evaluateWithModels(state, expr, result);
+  else
+    success = solver->evaluate(Query(state.constraints, expr), result);
+
+  chargeQuery(state, timer.delta(), coreQueries, success);
 
-  state.queryCost += timer.delta();
+  if (success && result != Solver::Unknown)
+    state.decidedExprs =
+        state.decidedExprs.insert({original, result == Solver::True});
 
   return success;
 }
@@ -51,15 +199,42 @@ bool TimingSolver::mustBeTrue(const ExecutionState& state, ref<Expr> expr,
     result = CE->isTrue() ? true : false;
     return true;
   }
+  noteQuery(state, expr);
+
+  if (auto decided = state.decidedExprs.lookup(expr)) {
+    result = decided->second;
+    ++stats::pathQueries;
+    return true;
+  }
 
   TimerStatIncrementer timer(stats::solverTime);
+  uint64_t coreQueries = stats::queries;
 
+  ref<Expr> original = expr;
   if (simplifyExprs)
     expr = state.constraints.simplifyExpr(expr);
 
-  bool success = solver->mustBeTrue(Query(state.constraints, expr), result);
+  bool value;
+  bool success = true;
+  ref<ConstantExpr> modelValue;
+  if (decideByKnownBits(expr, value) || decideByRange(state, expr, value)) {
+    result = value;
+  } else if (!(modelValue = evaluateInModel(state, expr)).isNull() &&
+             modelValue->isFalse()) {
+    // the model is a counterexample
+    result = false;
+    ++stats::modelQueries;
+  } else if (ReuseModels) {
+    success = solveForCounterexample(state, expr, result);
+  } else {
+    success = solver->mustBeTrue(Query(state.constraints, expr), result);
+  }
+
+  chargeQuery(state, timer.delta(), coreQueries, success);
 
-  state.queryCost += timer.delta();
+  // that it may be false may change with more constraints
+  if (success && result)
+    state.decidedExprs = state.decidedExprs.insert({original, true});
 
   return success;
 }
@@ -78,6 +253,65 @@ bool TimingSolver::mayBeTrue(const ExecutionState& state, ref<Expr> expr,
   return true;
 }
 
+bool TimingSolver::mayBeTrue(const ExecutionState &state,
+                             const std::vector<ref<Expr>> &exprs,
+                             std::vector<bool> &results) {
+  results.assign(exprs.size(), false);
+  for (const ref<Expr> &expr : exprs)
+    noteQuery(state, expr);
+
+  // Fast path, to avoid timer and OS overhead.
+  std::vector<unsigned> pending;
+  for (unsigned i = 0; i != exprs.size(); ++i) {
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(exprs[i]))
+      results[i] = CE->isTrue();
+    else
+      pending.push_back(i);
+  }
+  if (pending.empty())
+    return true;
+
+  TimerStatIncrementer timer(stats::solverTime);
+  uint64_t coreQueries = stats::queries;
+
+  std::vector<ref<Expr>> asked;
+  std::vector<unsigned> positions;
+  for (unsigned i : pending) {
+    ref<Expr> expr = exprs[i];
+    if (simplifyExprs)
+      expr = state.constraints.simplifyExpr(expr);
+
+    bool value;
+    ref<ConstantExpr> modelValue;
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr)) {
+      results[i] = CE->isTrue();
+    } else if (decideByKnownBits(expr, value) ||
+               decideByRange(state, expr, value)) {
+      results[i] = value;
+    } else if (!(modelValue = evaluateInModel(state, expr)).isNull() &&
+               modelValue->isTrue()) {
+      results[i] = true;
+      ++stats::modelQueries;
+    } else {
+      asked.push_back(expr);
+      positions.push_back(i);
+    }
+  }
+
+  bool success = true;
+  if (!asked.empty()) {
+    std::vector<bool> answers;
+    success = solver->mayBeTrue(state.constraints, asked, answers);
+    if (success)
+      for (unsigned i = 0; i != positions.size(); ++i)
+        results[positions[i]] = answers[i];
+  }
+
+  chargeQuery(state, timer.delta(), coreQueries, success);
+
+  return success;
+}
+
 bool TimingSolver::mayBeFalse(const ExecutionState& state, ref<Expr> expr, 
                               bool &result) {
   bool res;
@@ -94,15 +328,26 @@ bool TimingSolver::getValue(const ExecutionState& state, ref<Expr> expr,
     result = CE;
     return true;
   }
+  // the value picked may differ for another state with the same paths
+  if (state.subsumptionNode)
+    state.subsumptionNode->markIncomplete();
   
   TimerStatIncrementer timer(stats::solverTime);
+  uint64_t coreQueries = stats::queries;
 
   if (simplifyExprs)
     expr = state.constraints.simplifyExpr(expr);
 
-  bool success = solver->getValue(Query(state.constraints, expr), result);
+  bool success = true;
+  ref<ConstantExpr> modelValue = evaluateInModel(state, expr);
+  if (!modelValue.isNull()) {
+    result = modelValue;
+    ++stats::modelQueries;
+  } else {
+    success = solver->getValue(Query(state.constraints, expr), result);
+  }
 
-  state.queryCost += timer.delta();
+  chargeQuery(state, timer.delta(), coreQueries, success);
 
   return success;
 }
@@ -119,23 +364,37 @@ bool TimingSolver::getValue(const ExecutionState& state, KValue value,
     offsetResult = CE;
     return getValue(state, segment, segmentResult);
   }
+  if (state.subsumptionNode)
+    state.subsumptionNode->markIncomplete();
 
   TimerStatIncrementer timer(stats::solverTime);
+  uint64_t coreQueries = stats::queries;
 
   if (simplifyExprs) {
     segment = state.constraints.simplifyExpr(segment);
     offset = state.constraints.simplifyExpr(offset);
   }
 
-  Query query(state.constraints, ConstantExpr::alloc(0, Expr::Bool));
-  std::shared_ptr<const Assignment> assignment;
-  bool success = solver->getInitialValues(query, assignment);
-  if (success) {
-    segmentResult = cast<ConstantExpr>(assignment->evaluate(segment));
-    offsetResult = cast<ConstantExpr>(assignment->evaluate(offset));
+  bool success = true;
+  ref<ConstantExpr> segmentValue = evaluateInModel(state, segment);
+  ref<ConstantExpr> offsetValue = evaluateInModel(state, offset);
+  if (!segmentValue.isNull() && !offsetValue.isNull()) {
+    segmentResult = segmentValue;
+    offsetResult = offsetValue;
+    ++stats::modelQueries;
+  } else {
+    Query query(state.constraints, ConstantExpr::alloc(0, Expr::Bool));
+    std::shared_ptr<const Assignment> assignment;
+    success = solver->getInitialValues(query, assignment);
+    if (success) {
+      segmentResult = cast<ConstantExpr>(assignment->evaluate(segment));
+      offsetResult = cast<ConstantExpr>(assignment->evaluate(offset));
+      if (ReuseModels)
+        state.model = assignment;
+    }
   }
 
-  state.queryCost += timer.delta() / 1e6;
+  chargeQuery(state, timer.delta() / 1e6, coreQueries, success);
 
   return success;
 }
@@ -144,17 +403,50 @@ bool
 TimingSolver::getInitialValues(const ExecutionState& state,
                                std::shared_ptr<const Assignment> &result) {
   TimerStatIncrementer timer(stats::solverTime);
+  uint64_t coreQueries = stats::queries;
 
   bool success = solver->getInitialValues(Query(state.constraints,
                                                 ConstantExpr::alloc(0, Expr::Bool)), 
                                           result);
+  if (success && ReuseModels)
+    state.model = result;
+
+  chargeQuery(state, timer.delta(), coreQueries, success);
+
+  return success;
+}
+
+bool
+TimingSolver::getInitialValues(const ExecutionState& state,
+                               const std::vector<ref<Expr> > &assumptions,
+                               std::shared_ptr<const Assignment> &result,
+                               bool &hasSolution) {
+  TimerStatIncrementer timer(stats::solverTime);
+  uint64_t coreQueries = stats::queries;
+
+  std::vector<ref<Expr> > constraints(state.constraints.begin(),
+                                      state.constraints.end());
+  for (const ref<Expr> &assumption : assumptions) {
+    noteQuery(state, assumption);
+    constraints.push_back(simplifyExprs
+                              ? state.constraints.simplifyExpr(assumption)
+                              : assumption);
+  }
+  ConstraintManager cm(constraints);
+
+  bool success = solver->impl->computeInitialValues(
+      Query(cm, ConstantExpr::alloc(0, Expr::Bool)), result, hasSolution);
+  // a model with the assumptions is also one without them
+  if (success && hasSolution && ReuseModels)
+    state.model = result;
 
-  state.queryCost += timer.delta();
+  chargeQuery(state, timer.delta(), coreQueries, success);
 
   return success;
 }
 
 std::pair< ref<ConstantExpr>, ref<ConstantExpr> >
 TimingSolver::getRange(const ExecutionState& state, ref<Expr> expr) {
+  noteQuery(state, expr);
   return solver->getRange(Query(state.constraints, expr));
 }
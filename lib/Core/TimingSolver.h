@@ -16,12 +16,29 @@
 #include "klee/KValue.h"
 #include "klee/Expr/Assignment.h"
 
+#include "SolverTimeoutPolicy.h"
+
 #include <vector>
 
 namespace klee {
   class ExecutionState;
   class Solver;  
 
+  /// What a solver query is asked for. The queries, their time, cache hits
+  /// and timeouts are counted for each purpose, see CoreStats.h.
+  enum QueryPurpose {
+    OtherQuery,
+    BranchQuery,
+    BoundsCheckQuery,
+    ResolutionQuery,
+    /// Branches on comparisons of pointers into different objects, which
+    /// are decided on the symbolic addresses of the objects.
+    PointerComparisonQuery,
+    ConcretizationQuery,
+    TestGenerationQuery,
+    NumQueryPurposes
+  };
+
   /// TimingSolver - A simple class which wraps a solver and handles
   /// tracking the statistics that we care about.
   class TimingSolver {
@@ -29,6 +46,41 @@ namespace klee {
     Solver *solver;
     bool simplifyExprs;
 
+    /// The latencies of the queries answered by the core solver.
+    QueryLatencies latencies;
+
+    /// The purpose the queries are accounted to, see QueryPurposeScope.
+    QueryPurpose purpose = OtherQuery;
+
+  private:
+    /// Charge the cost of a query to the state and count whether it had to
+    /// be answered by the core solver.
+    void chargeQuery(const ExecutionState &state, time::Span cost,
+                     uint64_t coreQueries, bool success);
+
+    /// Decide a boolean expression from the bounds the state's constraints
+    /// put on the bytes it reads.
+    ///
+    /// \return false iff the bounds do not decide it.
+    bool decideByRange(const ExecutionState &state, ref<Expr> expr,
+                       bool &value);
+
+    /// Evaluate an expression in the model kept for the state.
+    ///
+    /// \return null iff no model is kept, or it does not fix the value.
+    ref<ConstantExpr> evaluateInModel(const ExecutionState &state,
+                                      ref<Expr> expr);
+
+    /// Decide whether an expression is valid by asking for a counterexample,
+    /// which is kept as the model of the state if there is one.
+    bool solveForCounterexample(const ExecutionState &state, ref<Expr> expr,
+                                bool &valid);
+
+    /// Evaluate an expression with counterexample queries only, of which
+    /// the model kept for the state saves one.
+    bool evaluateWithModels(const ExecutionState &state, ref<Expr> expr,
+                            Solver::Validity &result);
+
   public:
     /// TimingSolver - Construct a new timing solver.
     ///
@@ -57,6 +109,12 @@ namespace klee {
 
     bool mayBeTrue(const ExecutionState&, ref<Expr>, bool &result);
 
+    /// Determine for each of the expressions whether it may be true, asking
+    /// the solver chain about all of those the fast paths do not decide at
+    /// once. The batch is charged to the state as a single query.
+    bool mayBeTrue(const ExecutionState&, const std::vector<ref<Expr>> &exprs,
+                   std::vector<bool> &results);
+
     bool mayBeFalse(const ExecutionState&, ref<Expr>, bool &result);
 
     bool getValue(const ExecutionState &, ref<Expr> expr, 
@@ -67,10 +125,34 @@ namespace klee {
     bool getInitialValues(const ExecutionState&,
                           std::shared_ptr<const Assignment> &result);
 
+    /// Get a model of the state's constraints together with the given
+    /// \a assumptions.
+    ///
+    /// \param[out] hasSolution false iff the assumptions are infeasible.
+    /// \return false iff the solver failed.
+    bool getInitialValues(const ExecutionState&,
+                          const std::vector<ref<Expr> > &assumptions,
+                          std::shared_ptr<const Assignment> &result,
+                          bool &hasSolution);
+
     std::pair< ref<ConstantExpr>, ref<ConstantExpr> >
     getRange(const ExecutionState&, ref<Expr> query);
   };
 
+  /// QueryPurposeScope - Account the queries asked through a TimingSolver
+  /// while the scope lives to the given purpose.
+  class QueryPurposeScope {
+    TimingSolver &solver;
+    QueryPurpose saved;
+
+  public:
+    QueryPurposeScope(TimingSolver &solver, QueryPurpose purpose)
+        : solver(solver), saved(solver.purpose) {
+      solver.purpose = purpose;
+    }
+    ~QueryPurposeScope() { solver.purpose = saved; }
+  };
+
 }
 
 #endif /* KLEE_TIMINGSOLVER_H */
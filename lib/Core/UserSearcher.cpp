@@ -47,10 +47,21 @@ cl::list<Searcher::CoreSearchType> CoreSearch(
                    "use NURS with Instr-Count"),
         clEnumValN(Searcher::NURS_CPICnt, "nurs:cpicnt",
                    "use NURS with CallPath-Instr-Count"),
-        clEnumValN(Searcher::NURS_QC, "nurs:qc", "use NURS with Query-Cost")
+        clEnumValN(Searcher::NURS_QC, "nurs:qc", "use NURS with Query-Cost"),
+        clEnumValN(Searcher::NURS_PQC, "nurs:pqc",
+                   "use NURS with Predicted-Query-Cost, preferring states "
+                   "whose queries are likely answered from the caches")
             KLEE_LLVM_CL_VAL_END),
     cl::cat(SearchCat));
 
+cl::opt<unsigned> WeightRefreshInstructions(
+    "weight-refresh-instructions",
+    cl::desc("Recompute the weights of the states that ran in a weighted "
+             "random search (nurs:*) at most once every this many "
+             "instructions, unless the coverage statistics were updated "
+             "(default=0 (refresh before every selection))"),
+    cl::init(0), cl::cat(SearchCat));
+
 cl::opt<bool> UseIterativeDeepeningTimeSearch(
     "use-iterative-deepening-time-search",
     cl::desc(
@@ -80,14 +91,24 @@ cl::opt<std::string> BatchTime(
     cl::init("5s"),
     cl::cat(SearchCat));
 
+cl::opt<std::string> BatchSolverTime(
+    "batch-solver-time",
+    cl::desc("Amount of solver time a state may spend before it yields "
+             "when using --use-batching-search. The solver time is then not "
+             "counted against --batch-time. Set to 0s to disable "
+             "(default=0s)"),
+    cl::init("0s"),
+    cl::cat(SearchCat));
+
 } // namespace
 
 void klee::initializeSearchOptions() {
   // default values
   if (CoreSearch.empty()) {
-    if (UseMerge){
+    if (UseMerge || AutoMergeLoops){
       CoreSearch.push_back(Searcher::NURS_CovNew);
-      klee_warning("--use-merge enabled. Using NURS_CovNew as default searcher.");
+      klee_warning("%s enabled. Using NURS_CovNew as default searcher.",
+                   UseMerge ? "--use-merge" : "--auto-merge-loops");
     } else {
       CoreSearch.push_back(Searcher::RandomPath);
       CoreSearch.push_back(Searcher::NURS_CovNew);
@@ -111,12 +132,13 @@ Searcher *getNewSearcher(Searcher::CoreSearchType type, Executor &executor) {
   case Searcher::BFS: searcher = new BFSSearcher(); break;
   case Searcher::RandomState: searcher = new RandomSearcher(); break;
   case Searcher::RandomPath: searcher = new RandomPathSearcher(executor); break;
-  case Searcher::NURS_CovNew: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CoveringNew); break;
-  case Searcher::NURS_MD2U: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::MinDistToUncovered); break;
-  case Searcher::NURS_Depth: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::Depth); break;
-  case Searcher::NURS_ICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::InstCount); break;
-  case Searcher::NURS_CPICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CPInstCount); break;
-  case Searcher::NURS_QC: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::QueryCost); break;
+  case Searcher::NURS_CovNew: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CoveringNew, WeightRefreshInstructions); break;
+  case Searcher::NURS_MD2U: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::MinDistToUncovered, WeightRefreshInstructions); break;
+  case Searcher::NURS_Depth: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::Depth, WeightRefreshInstructions); break;
+  case Searcher::NURS_ICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::InstCount, WeightRefreshInstructions); break;
+  case Searcher::NURS_CPICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CPInstCount, WeightRefreshInstructions); break;
+  case Searcher::NURS_QC: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::QueryCost, WeightRefreshInstructions); break;
+  case Searcher::NURS_PQC: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::PredictedQueryCost, WeightRefreshInstructions); break;
   }
 
   return searcher;
@@ -136,17 +158,19 @@ Searcher *klee::constructUserSearcher(Executor &executor) {
     searcher = new InterleavedSearcher(s);
   }
 
-  if (UseMerge) {
+  if (UseMerge || AutoMergeLoops) {
     if (std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::RandomPath) != CoreSearch.end()){
       klee_error("use-merge currently does not support random-path, please use another search strategy");
     }
   }
 
   if (UseBatchingSearch) {
-    searcher = new BatchingSearcher(searcher, time::Span(BatchTime), BatchInstructions);
+    searcher = new BatchingSearcher(searcher, time::Span(BatchTime),
+                                    BatchInstructions,
+                                    time::Span(BatchSolverTime));
   }
 
-  if (UseMerge && UseIncompleteMerge) {
+  if ((UseMerge || AutoMergeLoops) && UseIncompleteMerge) {
     searcher = new MergingSearcher(executor, searcher);
   }
 
@@ -3,16 +3,23 @@
 namespace klee {
 
 ArrayCache::~ArrayCache() {
-  // Free Allocated Array objects
+  // Free Allocated Array objects, leaving the ones which are still
+  // referenced to their last reference.
   for (ArrayHashMap::iterator ai = cachedSymbolicArrays.begin(),
                               e = cachedSymbolicArrays.end();
        ai != e; ++ai) {
-    delete *ai;
+    if (ai->second->refCount)
+      ai->second->cache = nullptr;
+    else
+      delete ai->second;
   }
-  for (ArrayPtrVec::iterator ai = concreteArrays.begin(),
+  for (ArrayPtrSet::iterator ai = concreteArrays.begin(),
                              e = concreteArrays.end();
        ai != e; ++ai) {
-    delete *ai;
+    if ((*ai)->refCount)
+      (*ai)->cache = nullptr;
+    else
+      delete *ai;
   }
 }
 
@@ -21,27 +28,64 @@ ArrayCache::CreateArray(const std::string &_name, uint64_t _size,
                         const ref<ConstantExpr> *constantValuesBegin,
                         const ref<ConstantExpr> *constantValuesEnd,
                         Expr::Width _domain, Expr::Width _range) {
-
-  const Array *array = new Array(_name, _size, constantValuesBegin,
-                                 constantValuesEnd, _domain, _range);
-  if (array->isSymbolicArray()) {
-    std::pair<ArrayHashMap::const_iterator, bool> success =
-        cachedSymbolicArrays.insert(array);
-    if (success.second) {
-      // Cache miss
+  const ArrayName *name = ArrayName::intern(_name);
+  if (constantValuesBegin == constantValuesEnd) {
+    std::pair<ArrayHashMap::iterator, bool> success =
+        cachedSymbolicArrays.insert(
+            std::make_pair(SymbolicKey(name, _size), nullptr));
+    if (!success.second) {
+      // Cache hit
+      const Array *array = success.first->second;
+      assert(array->isSymbolicArray() &&
+             "Cached symbolic array is no longer symbolic");
       return array;
     }
-    // Cache hit
-    delete array;
-    array = *(success.first);
-    assert(array->isSymbolicArray() &&
-           "Cached symbolic array is no longer symbolic");
+    // Cache miss
+    Array *array = new Array(name, _size, 0, 0, _domain, _range);
+    array->cache = this;
+    success.first->second = array;
     return array;
   } else {
     // Treat every constant array as distinct so we never cache them
+    Array *array = new Array(name, _size, constantValuesBegin,
+                             constantValuesEnd, _domain, _range);
     assert(array->isConstantArray());
-    concreteArrays.push_back(array); // For deletion later
+    array->cache = this;
+    concreteArrays.insert(array); // For deletion later
     return array;
   }
 }
+
+size_t ArrayCache::collect() {
+  size_t freed = 0;
+  for (const Array *array : released) {
+    array->queuedForCollection = false;
+    if (!array->refCount) {
+      freeArray(array);
+      ++freed;
+    }
+  }
+  released.clear();
+  return freed;
+}
+
+void ArrayCache::freeArray(const Array *array) {
+  if (array->isSymbolicArray())
+    cachedSymbolicArrays.erase(SymbolicKey(array->pooledName, array->size));
+  else
+    concreteArrays.erase(array);
+  delete array;
+}
+
+void Array::release() const {
+  assert(refCount > 0 && "Array released more often than retained");
+  if (--refCount)
+    return;
+  if (!cache) {
+    delete this;
+  } else if (!queuedForCollection) {
+    queuedForCollection = true;
+    cache->released.push_back(this);
+  }
+}
 }
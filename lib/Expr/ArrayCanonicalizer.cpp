@@ -0,0 +1,102 @@
+//===-- ArrayCanonicalizer.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ArrayCanonicalizer.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Assignment.h"
+
+#include "llvm/ADT/Twine.h"
+
+#include <vector>
+
+using namespace klee;
+
+const Array *ArrayCanonicalizer::getCanonical(const Array *array) {
+  if (array->isConstantArray())
+    return array;
+  auto it = canonical.find(array);
+  if (it != canonical.end())
+    return it->second;
+
+  // the cache tells arrays apart by name and size only
+  std::string name = (llvm::Twine("canonical") + llvm::Twine(canonical.size()) +
+                      "_" + llvm::Twine(array->domain) + "_" +
+                      llvm::Twine(array->range))
+                         .str();
+  const Array *result = arrayCache.CreateArray(name, array->size, 0, 0,
+                                               array->domain, array->range);
+  canonical.insert(std::make_pair(array, result));
+  original.insert(std::make_pair(result, array));
+  return result;
+}
+
+UpdateList ArrayCanonicalizer::visit(const UpdateList &ul) {
+  // the nodes not renamed yet, newest first
+  std::vector<const UpdateNode *> pending;
+  const UpdateNode *un = ul.head;
+  for (; un && !updates.count(un); un = un->next)
+    pending.push_back(un);
+
+  UpdateList result = un ? updates.find(un)->second
+                         : UpdateList(getCanonical(ul.root), 0);
+  for (auto it = pending.rbegin(), ie = pending.rend(); it != ie; ++it) {
+    result.extend(visit((*it)->index), visit((*it)->value));
+    updates.insert(std::make_pair(*it, result));
+  }
+  return result;
+}
+
+ref<Expr> ArrayCanonicalizer::visit(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return e;
+  auto it = visited.find(e);
+  if (it != visited.end())
+    return it->second;
+
+  ref<Expr> result;
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+    UpdateList ul = visit(re->updates);
+    ref<Expr> index = visit(re->index);
+    // keep the read as it was built, its array is all that changes
+    if (ul.root == re->updates.root && ul.head == re->updates.head &&
+        index == re->index)
+      result = e;
+    else
+      result = ReadExpr::alloc(ul, index);
+  } else {
+    ref<Expr> kids[8];
+    bool changed = false;
+    for (unsigned i = 0, n = e->getNumKids(); i != n; ++i) {
+      kids[i] = visit(e->getKid(i));
+      changed |= kids[i] != e->getKid(i);
+    }
+    result = changed ? e->rebuild(kids) : e;
+  }
+  visited.insert(std::make_pair(e, result));
+  return result;
+}
+
+std::shared_ptr<const Assignment>
+ArrayCanonicalizer::toCanonical(const Assignment &a) const {
+  Assignment::bindings_ty bindings;
+  for (const auto &entry : canonical)
+    if (const CompactArrayModel *model = a.getBindingsOrNull(entry.first))
+      bindings.insert(std::make_pair(entry.second, *model));
+  return std::make_shared<Assignment>(bindings);
+}
+
+std::shared_ptr<const Assignment>
+ArrayCanonicalizer::toOriginal(const Assignment &a) const {
+  Assignment::bindings_ty bindings;
+  for (const auto &entry : original)
+    if (const CompactArrayModel *model = a.getBindingsOrNull(entry.first))
+      bindings.insert(std::make_pair(entry.second, *model));
+  return std::make_shared<Assignment>(bindings);
+}
@@ -17,6 +17,7 @@
 #include "klee/Expr/ExprBuilder.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/OptionCategories.h"
+#include "klee/Statistic.h"
 #include "klee/util/BitArray.h"
 
 #include <llvm/ADT/APInt.h>
@@ -58,8 +59,21 @@ llvm::cl::opt<double> ArrayValueSymbRatio(
                    "the mixed value-based transformations are applied."),
     llvm::cl::init(1.0), llvm::cl::value_desc("Symbolic Values / Array Size"),
     llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<unsigned> OptimizeArrayCacheSize(
+    "optimize-array-cache-size",
+    llvm::cl::desc("Maximum number of expressions and of reads whose array "
+                   "optimization is remembered, 0 for no limit "
+                   "(default=65536)"),
+    llvm::cl::init(65536), llvm::cl::cat(klee::SolvingCat));
 }; // namespace klee
 
+namespace {
+klee::Statistic arrayOptCacheHits("ArrayOptCacheHits", "AOChits");
+klee::Statistic arrayOptCacheMisses("ArrayOptCacheMisses", "AOCmisses");
+klee::Statistic arrayOptCacheEvictions("ArrayOptCacheEvictions", "AOCevict");
+} // namespace
+
 ref<Expr> extendRead(const UpdateList &ul, const ref<Expr> index,
                      Expr::Width w) {
   switch (w) {
@@ -101,6 +115,42 @@ ref<Expr> extendRead(const UpdateList &ul, const ref<Expr> index,
   }
 }
 
+ExprOptimizer::ExprOptimizer()
+    : cacheExprOptimized(OptimizeArrayCacheSize),
+      cacheReadExprOptimized(OptimizeArrayCacheSize) {}
+
+const ref<Expr> *ExprOptimizer::lookupExpr(const ref<Expr> &e) {
+  const ref<Expr> *cached = cacheExprOptimized.lookup(e);
+  if (cached)
+    ++arrayOptCacheHits;
+  else
+    ++arrayOptCacheMisses;
+  return cached;
+}
+
+void ExprOptimizer::cacheExpr(const ref<Expr> &e, const ref<Expr> &result) {
+  cacheExprOptimized.insert(e, result);
+  arrayOptCacheEvictions += cacheExprOptimized.takeEvicted();
+}
+
+const ref<Expr> *ExprOptimizer::lookupRead(const ReadExpr *read,
+                                           Expr::Width width) {
+  auto cached = cacheReadExprOptimized.lookup(const_cast<ReadExpr *>(read));
+  if (cached && cached->first == width) {
+    ++arrayOptCacheHits;
+    return &cached->second;
+  }
+  ++arrayOptCacheMisses;
+  return nullptr;
+}
+
+void ExprOptimizer::cacheRead(const ReadExpr *read, Expr::Width width,
+                              const ref<Expr> &result) {
+  cacheReadExprOptimized.insert(const_cast<ReadExpr *>(read),
+                                std::make_pair(width, result));
+  arrayOptCacheEvictions += cacheReadExprOptimized.takeEvicted();
+}
+
 ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
   // Nothing to optimise for constant expressions
   if (isa<ConstantExpr>(e))
@@ -110,14 +160,9 @@ ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
   if (OptimizeArray == NONE)
     return e;
 
-  unsigned hash = e->hash();
-  if (cacheExprUnapplicable.find(hash) != cacheExprUnapplicable.end())
-    return e;
-
   // Find cached expressions
-  auto cached = cacheExprOptimized.find(hash);
-  if (cached != cacheExprOptimized.end())
-    return cached->second;
+  if (const ref<Expr> *cached = lookupExpr(e))
+    return cached->isNull() ? e : *cached;
 
   ref<Expr> result;
   // ----------------------- INDEX-BASED OPTIMIZATION -------------------------
@@ -132,7 +177,7 @@ ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
       // If we cannot optimize the expression, we return a failure only
       // when we are not combining the optimizations
       if (OptimizeArray == INDEX) {
-        cacheExprUnapplicable.insert(hash);
+        cacheExpr(e, ref<Expr>());
         return e;
       }
     } else {
@@ -150,13 +195,13 @@ ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
         // Add new expression to cache
         if (result.get()) {
           klee_warning("OPT_I: successful");
-          cacheExprOptimized[hash] = result;
+          cacheExpr(e, result);
         } else {
           klee_warning("OPT_I: unsuccessful");
         }
       } else {
         klee_warning("OPT_I: unsuccessful");
-        cacheExprUnapplicable.insert(hash);
+        cacheExpr(e, ref<Expr>());
       }
     }
   }
@@ -170,7 +215,7 @@ ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
     std::reverse(reads.begin(), reads.end());
 
     if (reads.empty() || are.isIncompatible()) {
-      cacheExprUnapplicable.insert(hash);
+      cacheExpr(e, ref<Expr>());
       return e;
     }
 
@@ -179,10 +224,10 @@ ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
     if (selectOpt.get()) {
       klee_warning("OPT_V: successful");
       result = selectOpt;
-      cacheExprOptimized[hash] = result;
+      cacheExpr(e, result);
     } else {
       klee_warning("OPT_V: unsuccessful");
-      cacheExprUnapplicable.insert(hash);
+      cacheExpr(e, ref<Expr>());
     }
   }
   if (result.isNull())
@@ -263,15 +308,14 @@ ref<Expr> ExprOptimizer::getSelectOptExpr(
     std::map<unsigned, ref<Expr>> optimized;
     for (auto &read : reads) {
       auto info = readInfo[read];
-      auto cached = cacheReadExprOptimized.find(read->hash());
-      if (cached != cacheReadExprOptimized.end()) {
-        optimized.insert(std::make_pair(info.first, (*cached).second));
-        continue;
-      }
       Expr::Width width = read->getWidth();
       if (info.second > width) {
         width = info.second;
       }
+      if (const ref<Expr> *cached = lookupRead(read, width)) {
+        optimized.insert(std::make_pair(info.first, *cached));
+        continue;
+      }
       unsigned size = read->updates.root->getSize();
       if (size == 0) // symbolic-sized array
           return e;
@@ -317,7 +361,7 @@ ref<Expr> ExprOptimizer::getSelectOptExpr(
       ref<Expr> opt =
           buildConstantSelectExpr(index, arrayValues, width, elementsInArray);
       if (opt.get()) {
-        cacheReadExprOptimized[read->hash()] = opt;
+        cacheRead(read, width, opt);
         optimized.insert(std::make_pair(info.first, opt));
       }
     }
@@ -333,15 +377,14 @@ ref<Expr> ExprOptimizer::getSelectOptExpr(
     std::map<unsigned, ref<Expr>> optimized;
     for (auto &read : reads) {
       auto info = readInfo[read];
-      auto cached = cacheReadExprOptimized.find(read->hash());
-      if (cached != cacheReadExprOptimized.end()) {
-        optimized.insert(std::make_pair(info.first, (*cached).second));
-        continue;
-      }
       Expr::Width width = read->getWidth();
       if (info.second > width) {
         width = info.second;
       }
+      if (const ref<Expr> *cached = lookupRead(read, width)) {
+        optimized.insert(std::make_pair(info.first, *cached));
+        continue;
+      }
       unsigned size = read->updates.root->getConstantSize();
       unsigned bytesPerElement = width / 8;
       unsigned elementsInArray = size / bytesPerElement;
@@ -406,7 +449,7 @@ ref<Expr> ExprOptimizer::getSelectOptExpr(
         ref<Expr> opt =
             buildMixedSelectExpr(read, arrayValues, width, elementsInArray);
         if (opt.get()) {
-          cacheReadExprOptimized[read->hash()] = opt;
+          cacheRead(read, width, opt);
           optimized.insert(std::make_pair(info.first, opt));
         }
       }
@@ -12,12 +12,11 @@
 
 #include <cstdint>
 #include <map>
-#include <unordered_map>
-#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
 #include "klee/util/Ref.h"
 
 namespace klee {
@@ -27,13 +26,66 @@ enum ArrayOptimizationType { NONE, ALL, INDEX, VALUE };
 using array2idx_ty = std::map<const Array *, std::vector<ref<Expr>>>;
 using mapIndexOptimizedExpr_ty = std::map<ref<Expr>, std::vector<ref<Expr>>>;
 
+/// Results of the optimizer by expression. With a limit they are kept in
+/// two generations: once the young one holds half of the limit, the old one
+/// is dropped and the young one takes its place. Hits in the old generation
+/// move back.
+template <class T> class OptimizationCache {
+  ExprHashMap<T> young, old;
+  size_t limit;
+  uint64_t evicted = 0;
+
+public:
+  /// \arg limit - The maximum number of entries, 0 for no limit.
+  explicit OptimizationCache(size_t limit) : limit(limit) {}
+
+  /// \return The entry of \arg e, or null.
+  T *lookup(const ref<Expr> &e) {
+    auto it = young.find(e);
+    if (it != young.end())
+      return &it->second;
+    auto oit = old.find(e);
+    if (oit == old.end())
+      return nullptr;
+    T value = oit->second;
+    old.erase(oit);
+    return &insert(e, value);
+  }
+
+  /// Set the entry of \arg e.
+  T &insert(const ref<Expr> &e, const T &value) {
+    if (limit && young.size() >= limit / 2 && !young.count(e)) {
+      evicted += old.size();
+      old.clear();
+      old.swap(young);
+    }
+    return young[e] = value;
+  }
+
+  /// \return The number of entries dropped since the last call.
+  uint64_t takeEvicted() {
+    uint64_t result = evicted;
+    evicted = 0;
+    return result;
+  }
+};
+
 class ExprOptimizer {
 private:
-  std::unordered_map<unsigned, ref<Expr>> cacheExprOptimized;
-  std::unordered_set<unsigned> cacheExprUnapplicable;
-  std::unordered_map<unsigned, ref<Expr>> cacheReadExprOptimized;
+  /// The optimized expressions, null for those that cannot be optimized.
+  OptimizationCache<ref<Expr>> cacheExprOptimized;
+  /// The optimized reads, with the width they were optimized for.
+  OptimizationCache<std::pair<Expr::Width, ref<Expr>>> cacheReadExprOptimized;
+
+  const ref<Expr> *lookupExpr(const ref<Expr> &e);
+  void cacheExpr(const ref<Expr> &e, const ref<Expr> &result);
+  const ref<Expr> *lookupRead(const ReadExpr *read, Expr::Width width);
+  void cacheRead(const ReadExpr *read, Expr::Width width,
+                 const ref<Expr> &result);
 
 public:
+  ExprOptimizer();
+
   /// Returns the optimised version of e.
   /// @param e expression to optimise
   /// @param valueOnly XXX document
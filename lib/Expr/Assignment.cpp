@@ -16,7 +16,7 @@ void Assignment::dump() const {
     llvm::errs() << "No bindings\n";
     return;
   }
-  for (bindings_ty::const_iterator i = bindings.begin(), e = bindings.end(); i != e;
+  for (auto i = bindings.begin(), e = bindings.end(); i != e;
        ++i) {
     llvm::errs() << (*i).first->name << "\n[";
     i->second.dump();
@@ -27,7 +27,7 @@ void Assignment::dump() const {
 void Assignment::createConstraintsFromAssignment(
     std::vector<ref<Expr> > &out) const {
   assert(out.size() == 0 && "out should be empty");
-  for (bindings_ty::const_iterator it = bindings.begin(), ie = bindings.end();
+  for (auto it = bindings.begin(), ie = bindings.end();
        it != ie; ++it) {
     const Array *array = it->first;
     const auto &values = it->second;
@@ -42,72 +42,47 @@ void Assignment::createConstraintsFromAssignment(
   }
 }
 
-void MapArrayModel::toCompact(CompactArrayModel& model) const {
-  model.skipRanges.clear();
-  model.values.clear();
-  unsigned cursor = 0;
-  for (const auto &item : content) {
-    unsigned difference = item.first - cursor;
-    if (shouldSkip(difference)) {
-      model.skipRanges.push_back(std::make_pair(cursor, difference));
-    } else {
-      model.values.resize(model.values.size() + difference);
-    }
-    model.values.push_back(item.second);
-    cursor = item.first + 1;
-  }
-}
-
-uint8_t CompactArrayModel::get(unsigned index) const {
-  unsigned skipTotal = 0;
-  for (const auto &item : skipRanges) {
-    unsigned skipStart = item.first;
-    unsigned skipCount = item.second;
-    unsigned skipEnd = skipStart + skipCount;
-    if (index < skipEnd) {
-      if (index >= skipStart) {
-        // it's within skipped range, so it can be anything, for example 0
-        return 0;
-      } else {
-        return values[index - skipTotal];
-      }
-    }
-    skipTotal += skipCount;
-  }
-  if (index - skipTotal < values.size())
-    return values[index - skipTotal];
-  return 0;
+uint8_t CompactArrayModel::getFromRuns(unsigned index) const {
+  auto it = std::upper_bound(
+      runs.begin(), runs.end(), index,
+      [](unsigned index, const std::pair<uint32_t, uint32_t> &run) {
+        return index < run.first;
+      });
+  if (it == runs.begin())
+    return 0;
+  uint32_t end = it == runs.end() ? values.size() : it->second;
+  --it;
+  uint32_t position = it->second + (index - it->first);
+  // between the runs, any value does, for example 0
+  return position < end ? values[position] : 0;
 }
 
 std::map<uint32_t, uint8_t> CompactArrayModel::asMap() const {
   std::map<uint32_t, uint8_t> retMap;
-  unsigned index = 0;
-  unsigned cursor = 0;
-  for (const auto &item : skipRanges) {
-    for (; index < item.first; index++, cursor++) {
-      retMap[index] = values[cursor];
-    }
-    index += item.second;
+  if (runs.empty()) {
+    for (unsigned i = 0; i != values.size(); ++i)
+      retMap.emplace_hint(retMap.end(), i, values[i]);
+    return retMap;
   }
-  for (; cursor < values.size(); cursor++, index++) {
-    retMap[index] = values[cursor];
+  for (unsigned r = 0; r != runs.size(); ++r) {
+    uint32_t end = r + 1 == runs.size() ? values.size() : runs[r + 1].second;
+    for (uint32_t position = runs[r].second; position != end; ++position)
+      retMap.emplace_hint(retMap.end(),
+                          runs[r].first + (position - runs[r].second),
+                          values[position]);
   }
   return retMap;
 }
 
 std::vector<uint8_t> CompactArrayModel::asVector() const {
-  std::vector<uint8_t> result;
-  unsigned index = 0;
-  unsigned cursor = 0;
-  for (const auto &item : skipRanges) {
-    for (; index < item.first; index++, cursor++) {
-      result.push_back(values[cursor]);
-    }
-    index += item.second;
-    result.resize(result.size() + item.second);
-  }
-  for (; cursor < values.size(); cursor++, index++) {
-    result.push_back(values[cursor]);
+  if (runs.empty())
+    return values;
+  const auto &last = runs.back();
+  std::vector<uint8_t> result(last.first + (values.size() - last.second));
+  for (unsigned r = 0; r != runs.size(); ++r) {
+    uint32_t end = r + 1 == runs.size() ? values.size() : runs[r + 1].second;
+    std::copy(values.begin() + runs[r].second, values.begin() + end,
+              result.begin() + runs[r].first);
   }
   return result;
 }
@@ -120,10 +95,7 @@ void CompactArrayModel::dump() const {
 void Assignment::addBinding(const Array*array,
                             const std::vector<unsigned char>& values) {
     assert(!hasBindings(array));
-
-    MapArrayModel mapModel(values);
-    auto &binding = bindings[array];
-    mapModel.toCompact(binding);
+    getBindings(array).assign(values);
 }
 
 }
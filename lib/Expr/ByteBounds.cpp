@@ -0,0 +1,192 @@
+//===-- ByteBounds.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ByteBounds.h"
+
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Expr/ExprRangeEvaluator.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+namespace {
+/// Collect the bytes an expression consists of, most significant first,
+/// if it is a read or concatenation of reads at constant indices of the
+/// initial contents of symbolic arrays.
+bool getBytes(const ref<Expr> &e, std::vector<ByteBounds::Byte> &bytes) {
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+    const ConstantExpr *index = dyn_cast<ConstantExpr>(re->index);
+    if (!index || re->updates.head || re->updates.root->isConstantArray() ||
+        re->getWidth() != Expr::Int8)
+      return false;
+    bytes.push_back(
+        std::make_pair(re->updates.root, (unsigned)index->getZExtValue()));
+    return true;
+  }
+  if (const ConcatExpr *ce = dyn_cast<ConcatExpr>(e))
+    return getBytes(ce->getLeft(), bytes) && getBytes(ce->getRight(), bytes);
+  return false;
+}
+
+/// Get the range [min, max] of the values a comparison with a constant
+/// allows for its other side, \a term.
+bool getComparisonRange(const ref<Expr> &e, ref<Expr> &term, uint64_t &min,
+                        uint64_t &max) {
+  bool negated = false;
+  ref<Expr> cmp = e;
+  if (const EqExpr *ee = dyn_cast<EqExpr>(e)) {
+    if (ee->right->getWidth() == Expr::Bool && ee->left->isFalse() &&
+        !isa<EqExpr>(ee->right)) {
+      negated = true;
+      cmp = ee->right;
+    }
+  }
+
+  const BinaryExpr *be = dyn_cast<BinaryExpr>(cmp);
+  if (!be || (be->getKind() != Expr::Eq && be->getKind() != Expr::Ult &&
+              be->getKind() != Expr::Ule))
+    return false;
+  if (be->getKind() == Expr::Eq && negated)
+    return false;
+
+  bool constantLeft = isa<ConstantExpr>(be->left);
+  const ConstantExpr *ce =
+      dyn_cast<ConstantExpr>(constantLeft ? be->left : be->right);
+  term = constantLeft ? be->right : be->left;
+  if (!ce || isa<ConstantExpr>(term) || term->getWidth() > 64)
+    return false;
+  if (const ZExtExpr *ze = dyn_cast<ZExtExpr>(term)) {
+    if (ze->src->getWidth() == Expr::Int8)
+      term = ze->src;
+  }
+
+  uint64_t c = ce->getZExtValue();
+  uint64_t limit = bits64::maxValueOfNBits(be->left->getWidth());
+  min = 0;
+  max = limit;
+  // Negation swaps the sides and the strictness of an inequality.
+  bool strict = (be->getKind() == Expr::Ult) != negated;
+  bool upper = !constantLeft != negated;
+  switch (be->getKind()) {
+  case Expr::Eq:
+    min = max = c;
+    break;
+  default:
+    if (upper) {
+      if (strict && c == 0)
+        return min = 1, max = 0, true;
+      max = strict ? c - 1 : c;
+    } else {
+      if (strict && c == limit)
+        return min = 1, max = 0, true;
+      min = strict ? c + 1 : c;
+    }
+  }
+
+  // A zero-extended byte cannot exceed a byte.
+  if (term->getWidth() == Expr::Int8 && max > 255)
+    max = 255;
+  return true;
+}
+
+/// The range evaluator does not share the results for common
+/// subexpressions, so the expressions it visits are limited in size.
+const uint64_t MaxEvaluationCost = 4096;
+
+/// Get the number of expressions the range evaluator visits for \a e,
+/// saturated at MaxEvaluationCost + 1, and at that if it is too wide.
+uint64_t getEvaluationCost(const ref<Expr> &e,
+                           ExprHashMap<uint64_t> &costs) {
+  const uint64_t unsupported = MaxEvaluationCost + 1;
+  if (e->getWidth() > 64)
+    return unsupported;
+  auto it = costs.find(e);
+  if (it != costs.end())
+    return it->second;
+
+  uint64_t cost = 1;
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+    for (const UpdateNode *un = re->updates.head; un && cost < unsupported;
+         un = un->next)
+      cost += getEvaluationCost(un->index, costs) +
+              getEvaluationCost(un->value, costs);
+  }
+  for (unsigned i = 0; i != e->getNumKids() && cost < unsupported; ++i)
+    cost += getEvaluationCost(e->getKid(i), costs);
+
+  cost = std::min(cost, unsupported);
+  costs.insert(std::make_pair(e, cost));
+  return cost;
+}
+
+class BoundsEvaluator : public ExprRangeEvaluator<ValueRange> {
+  const ByteBounds &bounds;
+
+protected:
+  ValueRange getInitialReadRange(const Array &array, ValueRange index) {
+    if (!index.isFixed())
+      return ValueRange(0, 255);
+    if (!array.isConstantArray())
+      return bounds.get(&array, index.min());
+    if (index.min() < array.constantValues.size())
+      return ValueRange(array.constantValues[index.min()]->getZExtValue(8));
+    return ValueRange(0, 255);
+  }
+
+public:
+  BoundsEvaluator(const ByteBounds &bounds) : bounds(bounds) {}
+};
+}
+
+bool ByteBounds::getBounds(const ref<Expr> &e, std::vector<Bound> &result,
+                           bool &exact) {
+  ref<Expr> term;
+  uint64_t min, max;
+  std::vector<Byte> bytes;
+  if (!getComparisonRange(e, term, min, max) || !getBytes(term, bytes))
+    return false;
+
+  exact = bytes.size() == 1;
+  if (min > max) {
+    result.push_back({bytes[0], ValueRange(1, 0)});
+    return true;
+  }
+  for (unsigned i = 0; i != bytes.size(); ++i) {
+    unsigned shift = 8 * (bytes.size() - 1 - i);
+    // Only the most significant byte is bounded from below.
+    ValueRange range(i ? 0 : min >> shift,
+                     std::min<uint64_t>(max >> shift, 255));
+    if (!range.isFullRange(8))
+      result.push_back({bytes[i], range});
+  }
+  return true;
+}
+
+bool ByteBounds::add(const ref<Expr> &e) {
+  std::vector<Bound> narrowed;
+  bool exact;
+  if (!getBounds(e, narrowed, exact))
+    return false;
+  for (const Bound &b : narrowed) {
+    ValueRange range =
+        get(b.byte.first, b.byte.second).set_intersection(b.range);
+    contradictory |= range.isEmpty();
+    bounds = bounds.replace(std::make_pair(b.byte, range));
+  }
+  return true;
+}
+
+ValueRange ByteBounds::evaluate(const ref<Expr> &e) const {
+  ExprHashMap<uint64_t> costs;
+  if (contradictory || getEvaluationCost(e, costs) > MaxEvaluationCost)
+    return ValueRange(0,
+                      bits64::maxValueOfNBits(std::min(e->getWidth(), 64u)));
+  return BoundsEvaluator(*this).evaluate(e);
+}
@@ -10,6 +10,7 @@
 #include "klee/Expr/Constraints.h"
 
 #include "klee/Expr/ExprPPrinter.h"
+#include "klee/Expr/ExprUtil.h"
 #include "klee/Expr/ExprVisitor.h"
 #include "klee/Internal/Module/KModule.h"
 #include "klee/OptionCategories.h"
@@ -17,7 +18,9 @@
 #include "llvm/IR/Function.h"
 #include "llvm/Support/CommandLine.h"
 
-#include <map>
+#include <algorithm>
+#include <tuple>
+#include <unordered_map>
 
 using namespace klee;
 
@@ -28,6 +31,66 @@ llvm::cl::opt<bool> RewriteEqualities(
                    "constant is added (default=true)"),
     llvm::cl::init(true),
     llvm::cl::cat(SolvingCat));
+
+llvm::cl::opt<unsigned> SimplifyCacheSize(
+    "simplify-cache-size",
+    llvm::cl::desc("Maximum number of simplified expressions remembered per "
+                   "constraint set (default=4096)"),
+    llvm::cl::init(4096),
+    llvm::cl::cat(SolvingCat));
+
+std::vector<const Array *> getSortedArrays(const ref<Expr> &e) {
+  std::vector<const Array *> result;
+  findSymbolicObjects(e, result);
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+bool intersect(const std::vector<const Array *> &a,
+               const std::vector<const Array *> &b) {
+  auto ia = a.begin(), ib = b.begin();
+  while (ia != a.end() && ib != b.end()) {
+    if (*ia < *ib)
+      ++ia;
+    else if (*ib < *ia)
+      ++ib;
+    else
+      return true;
+  }
+  return false;
+}
+
+/// Constraints rewritten with an equality, remembered across managers:
+/// states that forked before adding the same equality (e.g. after
+/// resolving the same pointer) get the rewritten constraints of the
+/// first one without visiting them again, and share the results.
+class RewriteCache {
+  // the constraint, the term replaced and its replacement
+  using Key = std::tuple<ref<Expr>, ref<Expr>, ref<Expr>>;
+  struct KeyHash {
+    std::size_t operator()(const Key &k) const {
+      return (std::get<0>(k)->hash() * 31 + std::get<1>(k)->hash()) * 31 +
+             std::get<2>(k)->hash();
+    }
+  };
+  std::unordered_map<Key, ref<Expr>, KeyHash> results;
+
+public:
+  const ref<Expr> *find(const ref<Expr> &constraint, const ref<Expr> &src,
+                        const ref<Expr> &dst) const {
+    auto it = results.find(std::make_tuple(constraint, src, dst));
+    return it == results.end() ? nullptr : &it->second;
+  }
+
+  void insert(const ref<Expr> &constraint, const ref<Expr> &src,
+              const ref<Expr> &dst, const ref<Expr> &result) {
+    if (results.size() >= SimplifyCacheSize)
+      results.clear();
+    results.emplace(std::make_tuple(constraint, src, dst), result);
+  }
+};
+
+thread_local RewriteCache rewriteCache;
 }
 
 class ExprReplaceVisitor : public ExprVisitor {
@@ -56,43 +119,124 @@ public:
 
 class ExprReplaceVisitor2 : public ExprVisitor {
 private:
-  const std::map< ref<Expr>, ref<Expr> > &replacements;
+  const ConstraintManager::equalities_ty &replacements;
 
 public:
-  ExprReplaceVisitor2(const std::map< ref<Expr>, ref<Expr> > &_replacements) 
+  ExprReplaceVisitor2(const ConstraintManager::equalities_ty &_replacements)
     : ExprVisitor(true),
       replacements(_replacements) {}
 
   Action visitExprPost(const Expr &e) {
-    std::map< ref<Expr>, ref<Expr> >::const_iterator it =
-      replacements.find(ref<Expr>(const_cast<Expr*>(&e)));
-    if (it!=replacements.end()) {
-      return Action::changeTo(it->second);
+    if (const auto *res =
+            replacements.lookup(ref<Expr>(const_cast<Expr*>(&e)))) {
+      return Action::changeTo(res->second);
     } else {
       return Action::doChildren();
     }
   }
 };
 
-bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
-  ConstraintManager::constraints_ty old;
+void ConstraintManager::push(const ref<Expr> &e) {
+  constraints.push_back(e);
+  hashValue ^= e->hash();
+  simplifyCache.reset();
+
+  const EqExpr *ee = dyn_cast<EqExpr>(e);
+  if (ee && isa<ConstantExpr>(ee->left))
+    equalities = equalities.insert(std::make_pair(ee->right, ee->left));
+  else
+    equalities = equalities.insert(
+        std::make_pair(e, ConstantExpr::alloc(1, Expr::Bool)));
+}
+
+const IndependentPartitions &
+ConstraintManager::getIndependentPartitions() const {
+  if (partitioned == constraints.size())
+    return partitions;
+  auto it = constraints.begin();
+  for (std::size_t i = 0; i != partitioned; ++i)
+    ++it;
+  for (auto ie = constraints.end(); it != ie; ++it, ++partitioned)
+    partitions.add(partitioned, *it);
+  return partitions;
+}
+
+const ByteBounds &ConstraintManager::getByteBounds() const {
+  if (bounded == constraints.size())
+    return bounds;
+  auto it = constraints.begin();
+  for (std::size_t i = 0; i != bounded; ++i)
+    ++it;
+  for (auto ie = constraints.end(); it != ie; ++it, ++bounded)
+    bounds.add(*it);
+  return bounds;
+}
+
+bool ConstraintManager::rewriteConstraints(const ref<Expr> &src,
+                                           const ref<Expr> &dst) {
+  // catch up with the constraints added since the last rewrite
+  for (std::size_t i = arrays.size(), e = constraints.size(); i != e; ++i)
+    arrays.push_back(getSortedArrays(constraints[i]));
+
+  // a term without reads could appear anywhere
+  std::vector<const Array *> srcArrays = getSortedArrays(src);
+  ExprReplaceVisitor visitor(src, dst);
+
+  std::vector<ref<Expr>> rewritten;
+  rewritten.reserve(constraints.size());
   bool changed = false;
 
-  constraints.swap(old);
-  for (ConstraintManager::constraints_ty::iterator 
-         it = old.begin(), ie = old.end(); it != ie; ++it) {
-    ref<Expr> &ce = *it;
-    ref<Expr> e = visitor.visit(ce);
+  auto ai = arrays.begin();
+  for (const auto &ce : constraints) {
+    const std::vector<const Array *> &ceArrays = *ai;
+    ++ai;
+    if (!srcArrays.empty() && !intersect(srcArrays, ceArrays)) {
+      rewritten.push_back(ce);
+      continue;
+    }
+    if (const ref<Expr> *res = rewriteCache.find(ce, src, dst)) {
+      rewritten.push_back(*res);
+    } else {
+      rewritten.push_back(visitor.visit(ce));
+      rewriteCache.insert(ce, src, dst, rewritten.back());
+    }
+    changed |= rewritten.back() != ce;
+  }
+
+  // keep sharing the list with the other states if nothing changed
+  if (!changed)
+    return false;
+
+  constraints_ty old = constraints;
+  ImmutableList<std::vector<const Array *>> oldArrays = arrays;
+  constraints = constraints_ty();
+  arrays = ImmutableList<std::vector<const Array *>>();
+  equalities = equalities_ty();
+  hashValue = 0;
+  partitions = IndependentPartitions();
+  partitioned = 0;
+  bounds = ByteBounds();
+  bounded = 0;
 
-    if (e!=ce) {
+  auto it = old.begin();
+  ai = oldArrays.begin();
+  for (const auto &e : rewritten) {
+    if (e != *it) {
+      std::size_t first = constraints.size();
       addConstraintInternal(e); // enable further reductions
-      changed = true;
+      for (std::size_t i = std::max(first, arrays.size()),
+                       end = constraints.size();
+           i != end; ++i)
+        arrays.push_back(getSortedArrays(constraints[i]));
     } else {
-      constraints.push_back(ce);
+      push(e);
+      arrays.push_back(*ai);
     }
+    ++it;
+    ++ai;
   }
 
-  return changed;
+  return true;
 }
 
 void ConstraintManager::simplifyForValidConstraint(ref<Expr> e) {
@@ -100,28 +244,20 @@ void ConstraintManager::simplifyForValidConstraint(ref<Expr> e) {
 }
 
 ref<Expr> ConstraintManager::simplifyExpr(ref<Expr> e) const {
-  if (isa<ConstantExpr>(e))
+  if (isa<ConstantExpr>(e) || equalities.empty())
     return e;
 
-  std::map< ref<Expr>, ref<Expr> > equalities;
-  
-  for (ConstraintManager::constraints_ty::const_iterator 
-         it = constraints.begin(), ie = constraints.end(); it != ie; ++it) {
-    if (const EqExpr *ee = dyn_cast<EqExpr>(*it)) {
-      if (isa<ConstantExpr>(ee->left)) {
-        equalities.insert(std::make_pair(ee->right,
-                                         ee->left));
-      } else {
-        equalities.insert(std::make_pair(*it,
-                                         ConstantExpr::alloc(1, Expr::Bool)));
-      }
-    } else {
-      equalities.insert(std::make_pair(*it,
-                                       ConstantExpr::alloc(1, Expr::Bool)));
-    }
-  }
+  if (!simplifyCache)
+    simplifyCache = std::make_shared<ExprHashMap<ref<Expr>>>();
+  auto it = simplifyCache->find(e);
+  if (it != simplifyCache->end())
+    return it->second;
 
-  return ExprReplaceVisitor2(equalities).visit(e);
+  ref<Expr> res = ExprReplaceVisitor2(equalities).visit(e);
+  if (simplifyCache->size() >= SimplifyCacheSize)
+    simplifyCache->clear();
+  simplifyCache->insert(std::make_pair(e, res));
+  return res;
 }
 
 void ConstraintManager::addConstraintInternal(ref<Expr> e) {
@@ -150,16 +286,15 @@ void ConstraintManager::addConstraintInternal(ref<Expr> e) {
       // (byte-constant comparison).
       BinaryExpr *be = cast<BinaryExpr>(e);
       if (isa<ConstantExpr>(be->left)) {
-	ExprReplaceVisitor visitor(be->right, be->left);
-	rewriteConstraints(visitor);
+        rewriteConstraints(be->right, be->left);
       }
     }
-    constraints.push_back(e);
+    push(e);
     break;
   }
     
   default:
-    constraints.push_back(e);
+    push(e);
     break;
   }
 }
@@ -11,6 +11,7 @@
 
 #include "klee/Config/Version.h"
 #include "klee/Expr/ExprPPrinter.h"
+#include "klee/Expr/ExprScalarEvaluator.h"
 // FIXME: We shouldn't need this once fast constant support moves into
 // Core. If we need to do arithmetic, we probably want to use APInt.
 #include "klee/Internal/Support/IntEvaluation.h"
@@ -20,7 +21,9 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <sstream>
+#include <unordered_set>
 
 using namespace klee;
 using namespace llvm;
@@ -42,6 +45,20 @@ cl::opt<bool> ConstArrayOpt(
 /***/
 
 unsigned Expr::count = 0;
+uint64_t Expr::allocations = 0;
+
+ref<ConstantExpr> ConstantExpr::allocInterned(uint64_t v, Width w) {
+  assert(w <= 64 && v < InternedValues && "constant is not interned");
+  // never destroyed: constants may still be released during static destruction
+  static ref<ConstantExpr> *interned[65] = {};
+  ref<ConstantExpr> *&values = interned[w];
+  if (!values)
+    values = new ref<ConstantExpr>[InternedValues];
+  ref<ConstantExpr> &r = values[v];
+  if (r.isNull())
+    r = allocNew(APInt(w, v));
+  return r;
+}
 
 ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
   UpdateList ul(array, 0);
@@ -189,6 +206,282 @@ unsigned Expr::computeHash() {
   return hashValue;
 }
 
+void Expr::computeDepth() {
+  unsigned res = 0;
+  for (unsigned i = 0, n = getNumKids(); i != n; ++i)
+    res = std::max(res, getKid(i)->depth);
+  depth = res + 1;
+}
+
+namespace {
+/// The known bits of an expression of at most 64 bits.
+struct KnownBits {
+  uint64_t zeros, ones, mask;
+  unsigned width;
+
+  explicit KnownBits(const Expr *e)
+      : zeros(e->getKnownZeros()), ones(e->getKnownOnes()), mask(0),
+        width(e->getWidth()) {
+    if (width <= 64)
+      mask = bits64::maxValueOfNBits(width);
+  }
+
+  uint64_t known() const { return zeros | ones; }
+
+  uint64_t umin() const { return ones; }
+  uint64_t umax() const { return ~zeros & mask; }
+
+  int64_t smin() const {
+    uint64_t sign = UINT64_C(1) << (width - 1);
+    return toSigned(ones | (~known() & mask & sign));
+  }
+  int64_t smax() const {
+    uint64_t sign = UINT64_C(1) << (width - 1);
+    return toSigned(ones | (~known() & mask & ~sign));
+  }
+  int64_t toSigned(uint64_t v) const {
+    return (int64_t)(v << (64 - width)) >> (64 - width);
+  }
+
+  unsigned leadingZeros() const {
+    return countLeadingOnes(zeros << (64 - width));
+  }
+  unsigned trailingZeros() const {
+    return std::min(countTrailingOnes(zeros), width);
+  }
+};
+} // namespace
+
+/// Returns the mask of the `n` high bits of a `width` bits value.
+static uint64_t highBits(unsigned width, unsigned n) {
+  return bits64::maxValueOfNBits(width) & ~bits64::maxValueOfNBits(width - n);
+}
+
+/// Computes the known bits of `l + r + carry`, a bit of the sum is known when
+/// the bits of both terms and the carry into it are.
+static void addKnownBits(const KnownBits &l, uint64_t rZeros, uint64_t rOnes,
+                         bool carry, uint64_t &zeros, uint64_t &ones) {
+  uint64_t mask = l.mask;
+  uint64_t maxSum = (l.umax() + (~rZeros & mask) + carry) & mask;
+  uint64_t minSum = (l.umin() + rOnes + carry) & mask;
+  uint64_t carryZeros = ~(maxSum ^ l.zeros ^ rZeros) & mask;
+  uint64_t carryOnes = minSum ^ l.ones ^ rOnes;
+  uint64_t known = l.known() & (rZeros | rOnes) & (carryZeros | carryOnes);
+  zeros = ~maxSum & known;
+  ones = minSum & known;
+}
+
+bool Expr::decideByKnownBits(Kind k, const Expr *l, const Expr *r,
+                             bool &value) {
+  if (l->getWidth() > 64)
+    return false;
+  KnownBits lk(l), rk(r);
+
+  switch (k) {
+  case Expr::Eq:
+  case Expr::Ne:
+    if ((lk.zeros & rk.ones) | (lk.ones & rk.zeros))
+      value = false;
+    else if (lk.known() == lk.mask && rk.known() == rk.mask)
+      value = lk.ones == rk.ones;
+    else
+      return false;
+    if (k == Expr::Ne)
+      value = !value;
+    return true;
+  case Expr::Ult:
+    if (lk.umax() < rk.umin())
+      value = true;
+    else if (lk.umin() >= rk.umax())
+      value = false;
+    else
+      return false;
+    return true;
+  case Expr::Ule:
+    if (lk.umax() <= rk.umin())
+      value = true;
+    else if (lk.umin() > rk.umax())
+      value = false;
+    else
+      return false;
+    return true;
+  case Expr::Slt:
+    if (lk.smax() < rk.smin())
+      value = true;
+    else if (lk.smin() >= rk.smax())
+      value = false;
+    else
+      return false;
+    return true;
+  case Expr::Sle:
+    if (lk.smax() <= rk.smin())
+      value = true;
+    else if (lk.smin() > rk.smax())
+      value = false;
+    else
+      return false;
+    return true;
+  case Expr::Ugt:
+    return decideByKnownBits(Expr::Ult, r, l, value);
+  case Expr::Uge:
+    return decideByKnownBits(Expr::Ule, r, l, value);
+  case Expr::Sgt:
+    return decideByKnownBits(Expr::Slt, r, l, value);
+  case Expr::Sge:
+    return decideByKnownBits(Expr::Sle, r, l, value);
+  default:
+    return false;
+  }
+}
+
+void Expr::computeKnownBits() {
+  knownZeros = knownOnes = 0;
+  Width w = getWidth();
+  if (w > 64)
+    return;
+  uint64_t mask = bits64::maxValueOfNBits(w);
+
+  switch (getKind()) {
+  case Constant:
+    knownOnes = cast<ConstantExpr>(this)->getZExtValue();
+    knownZeros = ~knownOnes & mask;
+    return;
+
+  case NotOptimized: {
+    const Expr *src = cast<NotOptimizedExpr>(this)->src.get();
+    knownZeros = src->knownZeros;
+    knownOnes = src->knownOnes;
+    return;
+  }
+
+  case Select: {
+    const SelectExpr *se = cast<SelectExpr>(this);
+    bool cond;
+    if (se->cond->isKnownBool(cond)) {
+      const Expr *e = cond ? se->trueExpr.get() : se->falseExpr.get();
+      knownZeros = e->knownZeros;
+      knownOnes = e->knownOnes;
+    } else {
+      knownZeros = se->trueExpr->knownZeros & se->falseExpr->knownZeros;
+      knownOnes = se->trueExpr->knownOnes & se->falseExpr->knownOnes;
+    }
+    return;
+  }
+
+  case Concat: {
+    const ConcatExpr *ce = cast<ConcatExpr>(this);
+    unsigned rw = ce->getRight()->getWidth();
+    knownZeros = ce->getLeft()->knownZeros << rw | ce->getRight()->knownZeros;
+    knownOnes = ce->getLeft()->knownOnes << rw | ce->getRight()->knownOnes;
+    return;
+  }
+
+  case Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(this);
+    if (ee->expr->getWidth() > 64)
+      return;
+    knownZeros = (ee->expr->knownZeros >> ee->offset) & mask;
+    knownOnes = (ee->expr->knownOnes >> ee->offset) & mask;
+    return;
+  }
+
+  case Not: {
+    const Expr *e = cast<NotExpr>(this)->expr.get();
+    knownZeros = e->knownOnes;
+    knownOnes = e->knownZeros;
+    return;
+  }
+
+  case ZExt:
+  case SExt: {
+    KnownBits src(cast<CastExpr>(this)->src.get());
+    uint64_t ext = mask & ~src.mask;
+    uint64_t sign = UINT64_C(1) << (src.width - 1);
+    knownZeros = src.zeros;
+    knownOnes = src.ones;
+    if (getKind() == ZExt || (src.zeros & sign))
+      knownZeros |= ext;
+    else if (src.ones & sign)
+      knownOnes |= ext;
+    return;
+  }
+
+  default:
+    break;
+  }
+
+  if (!isa<BinaryExpr>(this))
+    return;
+  const BinaryExpr *be = cast<BinaryExpr>(this);
+  KnownBits l(be->left.get()), r(be->right.get());
+
+  switch (getKind()) {
+  case And:
+    knownZeros = l.zeros | r.zeros;
+    knownOnes = l.ones & r.ones;
+    return;
+  case Or:
+    knownZeros = l.zeros & r.zeros;
+    knownOnes = l.ones | r.ones;
+    return;
+  case Xor: {
+    uint64_t known = l.known() & r.known();
+    knownOnes = (l.ones ^ r.ones) & known;
+    knownZeros = ~knownOnes & known;
+    return;
+  }
+  case Add:
+    addKnownBits(l, r.zeros, r.ones, false, knownZeros, knownOnes);
+    return;
+  case Sub:
+    // l - r == l + ~r + 1
+    addKnownBits(l, r.ones, r.zeros, true, knownZeros, knownOnes);
+    return;
+  case Mul:
+    knownZeros = bits64::maxValueOfNBits(
+        std::min(l.trailingZeros() + r.trailingZeros(), w));
+    return;
+  case UDiv:
+    // the quotient is at most l
+    knownZeros = highBits(w, l.leadingZeros());
+    return;
+  case URem:
+    // the remainder is at most l and less than r
+    knownZeros = highBits(w, std::max(l.leadingZeros(), r.leadingZeros()));
+    return;
+  case Shl:
+  case LShr:
+  case AShr: {
+    const ConstantExpr *ce = dyn_cast<ConstantExpr>(be->right);
+    if (!ce || ce->getZExtValue() >= w)
+      return;
+    unsigned shift = ce->getZExtValue();
+    if (getKind() == Shl) {
+      knownZeros = ((l.zeros << shift) | bits64::maxValueOfNBits(shift)) & mask;
+      knownOnes = (l.ones << shift) & mask;
+      return;
+    }
+    uint64_t sign = UINT64_C(1) << (w - 1);
+    knownZeros = l.zeros >> shift;
+    knownOnes = l.ones >> shift;
+    if (getKind() == LShr || (l.zeros & sign))
+      knownZeros |= highBits(w, shift);
+    else if (l.ones & sign)
+      knownOnes |= highBits(w, shift);
+    return;
+  }
+  default:
+    break;
+  }
+
+  bool value;
+  if (getKind() >= CmpKindFirst && getKind() <= CmpKindLast &&
+      decideByKnownBits(getKind(), be->left.get(), be->right.get(), value)) {
+    knownZeros = !value;
+    knownOnes = value;
+  }
+}
+
 unsigned ConstantExpr::computeHash() {
   Expr::Width w = getWidth();
   if (w <= 64)
@@ -369,6 +662,39 @@ void ConstantExpr::toString(std::string &Res, unsigned radix) const {
   Res = value.toString(radix, false);
 }
 
+const ref<ConstantExpr> &ConstantExpr::getTrue() {
+  // never destroyed, like the interned constants
+  static const ref<ConstantExpr> *r =
+      new ref<ConstantExpr>(allocInterned(1, Expr::Bool));
+  return *r;
+}
+
+const ref<ConstantExpr> &ConstantExpr::getFalse() {
+  static const ref<ConstantExpr> *r =
+      new ref<ConstantExpr>(allocInterned(0, Expr::Bool));
+  return *r;
+}
+
+// Constants of at most 64 bits fold on native integers, specialized for the
+// common widths; APInt is left for wider ones and divisions by zero.
+#define FOLD_NATIVE(_op)                                                       \
+  do {                                                                         \
+    uint64_t res;                                                              \
+    if (ExprScalarEvaluator::evaluateBinary(Expr::_op, getWidth(),             \
+                                            getLimitedValue(),                 \
+                                            RHS->getLimitedValue(), res))      \
+      return ConstantExpr::alloc(res, getWidth());                             \
+  } while (0)
+
+#define FOLD_NATIVE_CMP(_op)                                                   \
+  do {                                                                         \
+    uint64_t res;                                                              \
+    if (ExprScalarEvaluator::evaluateBinary(Expr::_op, getWidth(),             \
+                                            getLimitedValue(),                 \
+                                            RHS->getLimitedValue(), res))      \
+      return res ? getTrue() : getFalse();                                     \
+  } while (0)
+
 ref<ConstantExpr> ConstantExpr::Concat(const ref<ConstantExpr> &RHS) {
   Expr::Width W = getWidth() + RHS->getWidth();
   APInt Tmp(value);
@@ -392,6 +718,7 @@ ref<ConstantExpr> ConstantExpr::SExt(Width W) {
 }
 
 ref<ConstantExpr> ConstantExpr::Add(const ref<ConstantExpr> &RHS) {
+  FOLD_NATIVE(Add);
   return ConstantExpr::alloc(value + RHS->value);
 }
 
@@ -400,50 +727,62 @@ ref<ConstantExpr> ConstantExpr::Neg() {
 }
 
 ref<ConstantExpr> ConstantExpr::Sub(const ref<ConstantExpr> &RHS) {
+  FOLD_NATIVE(Sub);
   return ConstantExpr::alloc(value - RHS->value);
 }
 
 ref<ConstantExpr> ConstantExpr::Mul(const ref<ConstantExpr> &RHS) {
+  FOLD_NATIVE(Mul);
   return ConstantExpr::alloc(value * RHS->value);
 }
 
 ref<ConstantExpr> ConstantExpr::UDiv(const ref<ConstantExpr> &RHS) {
+  FOLD_NATIVE(UDiv);
   return ConstantExpr::alloc(value.udiv(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::SDiv(const ref<ConstantExpr> &RHS) {
+  FOLD_NATIVE(SDiv);
   return ConstantExpr::alloc(value.sdiv(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::URem(const ref<ConstantExpr> &RHS) {
+  FOLD_NATIVE(URem);
   return ConstantExpr::alloc(value.urem(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::SRem(const ref<ConstantExpr> &RHS) {
+  FOLD_NATIVE(SRem);
   return ConstantExpr::alloc(value.srem(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::And(const ref<ConstantExpr> &RHS) {
+  FOLD_NATIVE(And);
   return ConstantExpr::alloc(value & RHS->value);
 }
 
 ref<ConstantExpr> ConstantExpr::Or(const ref<ConstantExpr> &RHS) {
+  FOLD_NATIVE(Or);
   return ConstantExpr::alloc(value | RHS->value);
 }
 
 ref<ConstantExpr> ConstantExpr::Xor(const ref<ConstantExpr> &RHS) {
+  FOLD_NATIVE(Xor);
   return ConstantExpr::alloc(value ^ RHS->value);
 }
 
 ref<ConstantExpr> ConstantExpr::Shl(const ref<ConstantExpr> &RHS) {
+  FOLD_NATIVE(Shl);
   return ConstantExpr::alloc(value.shl(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::LShr(const ref<ConstantExpr> &RHS) {
+  FOLD_NATIVE(LShr);
   return ConstantExpr::alloc(value.lshr(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::AShr(const ref<ConstantExpr> &RHS) {
+  FOLD_NATIVE(AShr);
   return ConstantExpr::alloc(value.ashr(RHS->value));
 }
 
@@ -452,45 +791,58 @@ ref<ConstantExpr> ConstantExpr::Not() {
 }
 
 ref<ConstantExpr> ConstantExpr::Eq(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value == RHS->value, Expr::Bool);
+  FOLD_NATIVE_CMP(Eq);
+  return value == RHS->value ? getTrue() : getFalse();
 }
 
 ref<ConstantExpr> ConstantExpr::Ne(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value != RHS->value, Expr::Bool);
+  FOLD_NATIVE_CMP(Ne);
+  return value != RHS->value ? getTrue() : getFalse();
 }
 
 ref<ConstantExpr> ConstantExpr::Ult(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.ult(RHS->value), Expr::Bool);
+  FOLD_NATIVE_CMP(Ult);
+  return value.ult(RHS->value) ? getTrue() : getFalse();
 }
 
 ref<ConstantExpr> ConstantExpr::Ule(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.ule(RHS->value), Expr::Bool);
+  FOLD_NATIVE_CMP(Ule);
+  return value.ule(RHS->value) ? getTrue() : getFalse();
 }
 
 ref<ConstantExpr> ConstantExpr::Ugt(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.ugt(RHS->value), Expr::Bool);
+  FOLD_NATIVE_CMP(Ugt);
+  return value.ugt(RHS->value) ? getTrue() : getFalse();
 }
 
 ref<ConstantExpr> ConstantExpr::Uge(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.uge(RHS->value), Expr::Bool);
+  FOLD_NATIVE_CMP(Uge);
+  return value.uge(RHS->value) ? getTrue() : getFalse();
 }
 
 ref<ConstantExpr> ConstantExpr::Slt(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.slt(RHS->value), Expr::Bool);
+  FOLD_NATIVE_CMP(Slt);
+  return value.slt(RHS->value) ? getTrue() : getFalse();
 }
 
 ref<ConstantExpr> ConstantExpr::Sle(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.sle(RHS->value), Expr::Bool);
+  FOLD_NATIVE_CMP(Sle);
+  return value.sle(RHS->value) ? getTrue() : getFalse();
 }
 
 ref<ConstantExpr> ConstantExpr::Sgt(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.sgt(RHS->value), Expr::Bool);
+  FOLD_NATIVE_CMP(Sgt);
+  return value.sgt(RHS->value) ? getTrue() : getFalse();
 }
 
 ref<ConstantExpr> ConstantExpr::Sge(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.sge(RHS->value), Expr::Bool);
+  FOLD_NATIVE_CMP(Sge);
+  return value.sge(RHS->value) ? getTrue() : getFalse();
 }
 
+#undef FOLD_NATIVE
+#undef FOLD_NATIVE_CMP
+
 /***/
 
 ref<Expr>  NotOptimizedExpr::create(ref<Expr> src) {
@@ -499,12 +851,57 @@ ref<Expr>  NotOptimizedExpr::create(ref<Expr> src) {
 
 /***/
 
-Array::Array(const std::string &_name, uint64_t _size,
+namespace {
+struct ArrayNameHashFn {
+  size_t operator()(const ArrayName *name) const { return name->hash; }
+};
+
+struct ArrayNameCmpFn {
+  bool operator()(const ArrayName *a, const ArrayName *b) const {
+    return a == b || a->str == b->str;
+  }
+};
+
+typedef std::unordered_set<const ArrayName *, ArrayNameHashFn, ArrayNameCmpFn>
+    ArrayNamePool;
+
+/// The names of all live arrays. It is never destroyed, as arrays can
+/// outlive their cache and be freed during static destruction.
+ArrayNamePool &getArrayNamePool() {
+  static ArrayNamePool *pool = new ArrayNamePool();
+  return *pool;
+}
+}
+
+ArrayName::ArrayName(const std::string &_str)
+    : uses(0), str(_str), hash(hashString(_str)) {}
+
+unsigned ArrayName::hashString(const std::string &str) {
+  unsigned res = 0;
+  for (unsigned i = 0, e = str.size(); i != e; ++i)
+    res = (res * Expr::MAGIC_HASH_CONSTANT) + str[i];
+  return res;
+}
+
+const ArrayName *ArrayName::intern(const std::string &str) {
+  ArrayNamePool &pool = getArrayNamePool();
+  ArrayName key(str);
+  ArrayNamePool::iterator it = pool.find(&key);
+  if (it != pool.end())
+    return *it;
+  const ArrayName *name = new ArrayName(str);
+  pool.insert(name);
+  return name;
+}
+
+Array::Array(const ArrayName *_name, uint64_t _size,
              const ref<ConstantExpr> *constantValuesBegin,
              const ref<ConstantExpr> *constantValuesEnd, Expr::Width _domain,
              Expr::Width _range)
-    : name(_name), size(_size), domain(_domain), range(_range),
-      constantValues(constantValuesBegin, constantValuesEnd) {
+    : pooledName(_name), refCount(0), queuedForCollection(false),
+      cache(nullptr), name(_name->str), size(_size), domain(_domain),
+      range(_range), constantValues(constantValuesBegin, constantValuesEnd) {
+  ++const_cast<ArrayName *>(pooledName)->uses;
 
   assert((isSymbolicArray() || constantValues.size() == size) &&
          "Invalid size for constant array!");
@@ -518,12 +915,16 @@ Array::Array(const std::string &_name, uint64_t _size,
 }
 
 Array::~Array() {
+  assert(refCount == 0 && "freeing a referenced array");
+  ArrayName *n = const_cast<ArrayName *>(pooledName);
+  if (--n->uses == 0) {
+    getArrayNamePool().erase(n);
+    delete n;
+  }
 }
 
 unsigned Array::computeHash() {
-  unsigned res = 0;
-  for (unsigned i = 0, e = name.size(); i != e; ++i)
-    res = (res * Expr::MAGIC_HASH_CONSTANT) + name[i];
+  unsigned res = pooledName->hash;
   res = (res * Expr::MAGIC_HASH_CONSTANT) + size;
   hashValue = res;
   return hashValue; 
@@ -539,6 +940,16 @@ ref<Expr> ReadExpr::create(const UpdateList &ul, ref<Expr> index) {
   // array element has been updated
   const UpdateNode *un = ul.head;
   bool updateListHasSymbolicWrites = false;
+  // The run of writes at constant indices is indexed.
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(index)) {
+    if (un && CE->getWidth() <= 64) {
+      const UpdateNode *rest;
+      if (const UpdateNode *write =
+              un->findConstantWrite(CE->getZExtValue(), rest))
+        return write->value;
+      un = rest;
+    }
+  }
   for (; un; un=un->next) {
     // Check if we have an equivalent concrete index
     ref<Expr> cond = EqExpr::create(index, un->index);
@@ -903,7 +1314,7 @@ static ref<Expr> XorExpr_createPartialR(const ref<ConstantExpr> &cl, Expr *r) {
   if (cl->isZero()) {
     return r;
   } else if (cl->getWidth() == Expr::Bool) {
-    return EqExpr_createPartial(r, ConstantExpr::create(0, Expr::Bool));
+    return EqExpr_createPartial(r, ConstantExpr::getFalse());
   } else {
     return XorExpr::alloc(cl, r);
   }
@@ -934,7 +1345,7 @@ static ref<Expr> SDivExpr_create(const ref<Expr> &l, const ref<Expr> &r) {
 
 static ref<Expr> URemExpr_create(const ref<Expr> &l, const ref<Expr> &r) {
   if (l->getWidth() == Expr::Bool) { // r must be 1
-    return ConstantExpr::create(0, Expr::Bool);
+    return ConstantExpr::getFalse();
   } else{
     return URemExpr::alloc(l, r);
   }
@@ -942,7 +1353,7 @@ static ref<Expr> URemExpr_create(const ref<Expr> &l, const ref<Expr> &r) {
 
 static ref<Expr> SRemExpr_create(const ref<Expr> &l, const ref<Expr> &r) {
   if (l->getWidth() == Expr::Bool) { // r must be 1
-    return ConstantExpr::create(0, Expr::Bool);
+    return ConstantExpr::getFalse();
   } else{
     return SRemExpr::alloc(l, r);
   }
@@ -1033,8 +1444,11 @@ ref<Expr>  _e_op ::create(const ref<Expr> &l, const ref<Expr> &r) {    \
   
 
 static ref<Expr> EqExpr_create(const ref<Expr> &l, const ref<Expr> &r) {
+  bool value;
   if (l == r) {
-    return ConstantExpr::alloc(1, Expr::Bool);
+    return ConstantExpr::getTrue();
+  } else if (Expr::decideByKnownBits(Expr::Eq, l.get(), r.get(), value)) {
+    return ConstantExpr::alloc(value, Expr::Bool);
   } else {
     return EqExpr::alloc(l, r);
   }
@@ -1055,7 +1469,7 @@ static ref<Expr> TryConstArrayOpt(const ref<ConstantExpr> &cl,
 
   // for now, just assume standard "flushing" of a concrete array,
   // where the concrete array has one update for each index, in order
-  ref<Expr> res = ConstantExpr::alloc(0, Expr::Bool);
+  ref<Expr> res = ConstantExpr::getFalse();
   for (unsigned i = 0, e = rd->updates.root->size; i != e; ++i) {
     if (cl == rd->updates.root->constantValues[i]) {
       // Arbitrary maximum on the size of disjunction.
@@ -1111,7 +1525,7 @@ static ref<Expr> EqExpr_createPartialR(const ref<ConstantExpr> &cl, Expr *r) {
     if (cl == trunc->SExt(width)) {
       return EqExpr::create(see->src, trunc);
     } else {
-      return ConstantExpr::create(0, Expr::Bool);
+      return ConstantExpr::getFalse();
     }
   } else if (rk == Expr::ZExt) {
     // (zext(a,T)==c) == (a==c)
@@ -1124,7 +1538,7 @@ static ref<Expr> EqExpr_createPartialR(const ref<ConstantExpr> &cl, Expr *r) {
     if (cl == trunc->ZExt(width)) {
       return EqExpr::create(zee->src, trunc);
     } else {
-      return ConstantExpr::create(0, Expr::Bool);
+      return ConstantExpr::getFalse();
     }
   } else if (rk==Expr::Add) {
     const AddExpr *ae = cast<AddExpr>(r);
@@ -1154,7 +1568,7 @@ static ref<Expr> EqExpr_createPartial(Expr *l, const ref<ConstantExpr> &cr) {
 }
   
 ref<Expr> NeExpr::create(const ref<Expr> &l, const ref<Expr> &r) {
-  return EqExpr::create(ConstantExpr::create(0, Expr::Bool),
+  return EqExpr::create(ConstantExpr::getFalse(),
                         EqExpr::create(l, r));
 }
 
@@ -1173,33 +1587,45 @@ ref<Expr> SgeExpr::create(const ref<Expr> &l, const ref<Expr> &r) {
 }
 
 static ref<Expr> UltExpr_create(const ref<Expr> &l, const ref<Expr> &r) {
+  bool value;
   Expr::Width t = l->getWidth();
   if (t == Expr::Bool) { // !l && r
     return AndExpr::create(Expr::createIsZero(l), r);
+  } else if (Expr::decideByKnownBits(Expr::Ult, l.get(), r.get(), value)) {
+    return ConstantExpr::alloc(value, Expr::Bool);
   } else {
     return UltExpr::alloc(l, r);
   }
 }
 
 static ref<Expr> UleExpr_create(const ref<Expr> &l, const ref<Expr> &r) {
+  bool value;
   if (l->getWidth() == Expr::Bool) { // !(l && !r)
     return OrExpr::create(Expr::createIsZero(l), r);
+  } else if (Expr::decideByKnownBits(Expr::Ule, l.get(), r.get(), value)) {
+    return ConstantExpr::alloc(value, Expr::Bool);
   } else {
     return UleExpr::alloc(l, r);
   }
 }
 
 static ref<Expr> SltExpr_create(const ref<Expr> &l, const ref<Expr> &r) {
+  bool value;
   if (l->getWidth() == Expr::Bool) { // l && !r
     return AndExpr::create(l, Expr::createIsZero(r));
+  } else if (Expr::decideByKnownBits(Expr::Slt, l.get(), r.get(), value)) {
+    return ConstantExpr::alloc(value, Expr::Bool);
   } else {
     return SltExpr::alloc(l, r);
   }
 }
 
 static ref<Expr> SleExpr_create(const ref<Expr> &l, const ref<Expr> &r) {
+  bool value;
   if (l->getWidth() == Expr::Bool) { // !(!l && r)
     return OrExpr::create(l, Expr::createIsZero(r));
+  } else if (Expr::decideByKnownBits(Expr::Sle, l.get(), r.get(), value)) {
+    return ConstantExpr::alloc(value, Expr::Bool);
   } else {
     return SleExpr::alloc(l, r);
   }
@@ -0,0 +1,89 @@
+//===-- ExprAllocator.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ExprAllocator.h"
+
+#include <new>
+
+using namespace klee;
+
+namespace {
+/// Sizes of the classes are multiples of this, which keeps the nodes of a
+/// slab aligned for their pointers and 64-bit words. Most nodes take 24 to
+/// 48 bytes, so coarser classes would waste a good part of each.
+const size_t Granularity = 8;
+const size_t NumClasses = ExprAllocator::MaxSize / Granularity;
+const size_t SlabSize = 64 * 1024;
+
+#if defined(__SANITIZE_ADDRESS__)
+#define KLEE_EXPR_SLABS 0
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(memory_sanitizer)
+#define KLEE_EXPR_SLABS 0
+#endif
+#endif
+#ifndef KLEE_EXPR_SLABS
+// Sanitizers do not see into the slabs, so they get plain allocations.
+#define KLEE_EXPR_SLABS 1
+#endif
+
+struct FreeNode {
+  FreeNode *next;
+};
+
+// Plain static storage without constructors or destructors, so that nodes
+// can still be allocated and freed during static initialisation and
+// destruction.
+FreeNode *freeLists[NumClasses];
+char *slabCursors[NumClasses];
+char *slabEnds[NumClasses];
+uint64_t slabBytes;
+uint64_t usedBytes;
+}
+
+void *ExprAllocator::allocate(size_t size) {
+  if (!KLEE_EXPR_SLABS || size > MaxSize || size == 0)
+    return ::operator new(size);
+
+  size_t sizeClass = (size - 1) / Granularity;
+  size_t classSize = (sizeClass + 1) * Granularity;
+  usedBytes += classSize;
+  if (FreeNode *node = freeLists[sizeClass]) {
+    freeLists[sizeClass] = node->next;
+    return node;
+  }
+
+  if (static_cast<size_t>(slabEnds[sizeClass] - slabCursors[sizeClass]) <
+      classSize) {
+    // the rest of the previous slab, if any, is left unused
+    slabCursors[sizeClass] = static_cast<char *>(::operator new(SlabSize));
+    slabEnds[sizeClass] = slabCursors[sizeClass] + SlabSize;
+    slabBytes += SlabSize;
+  }
+  void *p = slabCursors[sizeClass];
+  slabCursors[sizeClass] += classSize;
+  return p;
+}
+
+void ExprAllocator::deallocate(void *p, size_t size) {
+  if (!KLEE_EXPR_SLABS || size > MaxSize || size == 0) {
+    ::operator delete(p);
+    return;
+  }
+
+  size_t sizeClass = (size - 1) / Granularity;
+  usedBytes -= (sizeClass + 1) * Granularity;
+  FreeNode *node = static_cast<FreeNode *>(p);
+  node->next = freeLists[sizeClass];
+  freeLists[sizeClass] = node;
+}
+
+uint64_t ExprAllocator::getSlabBytes() { return slabBytes; }
+
+uint64_t ExprAllocator::getUsedBytes() { return usedBytes; }
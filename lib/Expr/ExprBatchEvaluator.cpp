@@ -0,0 +1,300 @@
+//===-- ExprBatchEvaluator.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ExprBatchEvaluator.h"
+
+#include "klee/Expr/Assignment.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+// Instructions use the kind of the expression they compute, except for
+// the read of an array before its updates.
+enum { ReadInitial = Expr::LastKind + 1 };
+
+static inline uint64_t getMask(Expr::Width width) {
+  return width >= 64 ? ~uint64_t(0) : (uint64_t(1) << width) - 1;
+}
+
+static inline int64_t signExtend(uint64_t value, Expr::Width width) {
+  if (width >= 64)
+    return static_cast<int64_t>(value);
+  return static_cast<int64_t>(value << (64 - width)) >> (64 - width);
+}
+
+static inline uint64_t readInitial(const Array *array, uint64_t index,
+                                   const Assignment *assignment) {
+  if (array->isConstantArray() && index < array->constantValues.size())
+    return array->constantValues[index]->getZExtValue(8);
+  return assignment->getValue(array, index);
+}
+
+ExprBatchEvaluator::ExprBatchEvaluator(const std::vector<ref<Expr> > &exprs)
+    : exprs(exprs), compiled(true) {
+  ExprHashMap<unsigned> registers;
+  for (const auto &e : exprs) {
+    results.push_back(compile(e, registers));
+    if (!compiled)
+      break;
+  }
+}
+
+ExprBatchEvaluator::~ExprBatchEvaluator() {}
+
+unsigned ExprBatchEvaluator::emit(const Instruction &instruction) {
+  program.push_back(instruction);
+  return program.size() - 1;
+}
+
+unsigned ExprBatchEvaluator::compile(const ref<Expr> &e,
+                                     ExprHashMap<unsigned> &registers) {
+  auto it = registers.find(e);
+  if (it != registers.end())
+    return it->second;
+  if (!compiled || e->getWidth() > 64) {
+    compiled = false;
+    return 0;
+  }
+
+  Instruction instruction = {static_cast<unsigned>(e->getKind()),
+                             e->getWidth(), 0, 0, 0, 0, 0};
+  switch (e->getKind()) {
+  case Expr::Constant:
+    instruction.imm = cast<ConstantExpr>(e)->getZExtValue();
+    break;
+
+  case Expr::NotOptimized: {
+    unsigned reg = compile(e->getKid(0), registers);
+    registers.insert(std::make_pair(e, reg));
+    return reg;
+  }
+
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    unsigned index = compile(re->index, registers);
+    std::vector<const UpdateNode *> updates;
+    for (const UpdateNode *un = re->updates.head; un; un = un->next)
+      updates.push_back(un);
+
+    // a later update overrides an earlier one to the same index
+    Instruction read = {ReadInitial, e->getWidth(), index, 0, 0, 0,
+                        re->updates.root};
+    unsigned reg = emit(read);
+    for (auto uit = updates.rbegin(), uie = updates.rend(); uit != uie;
+         ++uit) {
+      unsigned updateIndex = compile((*uit)->index, registers);
+      unsigned updateValue = compile((*uit)->value, registers);
+      if (!compiled)
+        return 0;
+      Instruction eq = {Expr::Eq, Expr::Bool, index, updateIndex, 0,
+                        re->index->getWidth(), 0};
+      Instruction select = {Expr::Select, e->getWidth(), emit(eq),
+                            updateValue, reg, 0, 0};
+      reg = emit(select);
+    }
+    registers.insert(std::make_pair(e, reg));
+    return reg;
+  }
+
+  case Expr::Extract:
+    instruction.a = compile(e->getKid(0), registers);
+    instruction.imm = cast<ExtractExpr>(e)->offset;
+    break;
+
+  default: {
+    unsigned *operands[3] = {&instruction.a, &instruction.b, &instruction.c};
+    for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+      *operands[i] = compile(e->getKid(i), registers);
+    if (e->getNumKids()) {
+      // the width of the right operand for concatenations, of the left
+      // one for casts, comparisons and signed operations
+      unsigned kid = e->getKind() == Expr::Concat ? 1 : 0;
+      instruction.imm = e->getKid(kid)->getWidth();
+    }
+    break;
+  }
+  }
+
+  if (!compiled)
+    return 0;
+  unsigned reg = emit(instruction);
+  registers.insert(std::make_pair(e, reg));
+  return reg;
+}
+
+void ExprBatchEvaluator::run(const Assignment *const *assignments,
+                             unsigned count, uint64_t *registers,
+                             bool *inexact) const {
+  std::fill(inexact, inexact + Lanes, false);
+
+  for (unsigned i = 0, n = program.size(); i != n; ++i) {
+    const Instruction &ins = program[i];
+    uint64_t *d = registers + i * Lanes;
+    const uint64_t *x = registers + ins.a * Lanes;
+    const uint64_t *y = registers + ins.b * Lanes;
+    const uint64_t *z = registers + ins.c * Lanes;
+    const uint64_t mask = getMask(ins.width);
+    const unsigned w = ins.imm;
+
+#define LANES(value)                                                           \
+  for (unsigned l = 0; l != Lanes; ++l)                                        \
+    d[l] = (value);                                                            \
+  break
+
+    switch (ins.op) {
+    case Expr::Constant:
+      LANES(ins.imm);
+    case ReadInitial:
+      for (unsigned l = 0; l != Lanes; ++l)
+        d[l] = l < count ? readInitial(ins.array, x[l], assignments[l]) : 0;
+      break;
+
+    case Expr::Select:
+      LANES(x[l] ? y[l] : z[l]);
+    case Expr::Concat:
+      LANES((x[l] << w | y[l]) & mask);
+    case Expr::Extract:
+      LANES((x[l] >> w) & mask);
+    case Expr::Not:
+      LANES(~x[l] & mask);
+    case Expr::ZExt:
+      LANES(x[l]);
+    case Expr::SExt:
+      LANES(static_cast<uint64_t>(signExtend(x[l], w)) & mask);
+
+    case Expr::Add:
+      LANES((x[l] + y[l]) & mask);
+    case Expr::Sub:
+      LANES((x[l] - y[l]) & mask);
+    case Expr::Mul:
+      LANES((x[l] * y[l]) & mask);
+    case Expr::And:
+      LANES(x[l] & y[l]);
+    case Expr::Or:
+      LANES(x[l] | y[l]);
+    case Expr::Xor:
+      LANES(x[l] ^ y[l]);
+    case Expr::Shl:
+      LANES(y[l] >= ins.width ? 0 : (x[l] << y[l]) & mask);
+    case Expr::LShr:
+      LANES(y[l] >= ins.width ? 0 : x[l] >> y[l]);
+    case Expr::AShr:
+      LANES(static_cast<uint64_t>(
+                signExtend(x[l], ins.width) >>
+                std::min<uint64_t>(y[l], ins.width - 1)) &
+            mask);
+
+    // a division by zero leaves the lane to ExprEvaluator
+    case Expr::UDiv:
+    case Expr::URem:
+    case Expr::SDiv:
+    case Expr::SRem:
+      for (unsigned l = 0; l != Lanes; ++l) {
+        if (!y[l]) {
+          inexact[l] = true;
+          d[l] = 0;
+          continue;
+        }
+        if (ins.op == Expr::UDiv) {
+          d[l] = x[l] / y[l];
+        } else if (ins.op == Expr::URem) {
+          d[l] = x[l] % y[l];
+        } else {
+          int64_t sx = signExtend(x[l], w), sy = signExtend(y[l], w);
+          // wraps around as APInt does, without overflowing here
+          if (sy == -1)
+            d[l] = ins.op == Expr::SDiv ? uint64_t(0) - uint64_t(sx) : 0;
+          else
+            d[l] = ins.op == Expr::SDiv ? sx / sy : sx % sy;
+          d[l] &= mask;
+        }
+      }
+      break;
+
+    case Expr::Eq:
+      LANES(x[l] == y[l]);
+    case Expr::Ne:
+      LANES(x[l] != y[l]);
+    case Expr::Ult:
+      LANES(x[l] < y[l]);
+    case Expr::Ule:
+      LANES(x[l] <= y[l]);
+    case Expr::Ugt:
+      LANES(x[l] > y[l]);
+    case Expr::Uge:
+      LANES(x[l] >= y[l]);
+    case Expr::Slt:
+      LANES(signExtend(x[l], w) < signExtend(y[l], w));
+    case Expr::Sle:
+      LANES(signExtend(x[l], w) <= signExtend(y[l], w));
+    case Expr::Sgt:
+      LANES(signExtend(x[l], w) > signExtend(y[l], w));
+    case Expr::Sge:
+      LANES(signExtend(x[l], w) >= signExtend(y[l], w));
+
+    default:
+      assert(0 && "invalid instruction");
+    }
+
+#undef LANES
+  }
+}
+
+void ExprBatchEvaluator::evaluate(
+    const std::vector<const Assignment *> &assignments,
+    std::vector<std::vector<uint64_t> > &values,
+    std::vector<bool> &exact) const {
+  assert(compiled && "evaluating expressions that were not compiled");
+  values.assign(assignments.size(), std::vector<uint64_t>(exprs.size()));
+  exact.assign(assignments.size(), true);
+
+  std::vector<uint64_t> registers(program.size() * Lanes);
+  bool inexact[Lanes];
+  for (size_t base = 0; base < assignments.size(); base += Lanes) {
+    unsigned count = std::min<size_t>(Lanes, assignments.size() - base);
+    run(&assignments[base], count, registers.data(), inexact);
+    for (unsigned l = 0; l != count; ++l) {
+      exact[base + l] = !inexact[l];
+      for (unsigned j = 0; j != exprs.size(); ++j)
+        values[base + l][j] = registers[results[j] * Lanes + l];
+    }
+  }
+}
+
+int ExprBatchEvaluator::findSatisfying(
+    const std::vector<const Assignment *> &assignments) const {
+  if (!compiled) {
+    for (unsigned i = 0; i != assignments.size(); ++i)
+      if (assignments[i]->satisfies(exprs.begin(), exprs.end()))
+        return i;
+    return -1;
+  }
+
+  std::vector<uint64_t> registers(program.size() * Lanes);
+  bool inexact[Lanes];
+  for (size_t base = 0; base < assignments.size(); base += Lanes) {
+    unsigned count = std::min<size_t>(Lanes, assignments.size() - base);
+    run(&assignments[base], count, registers.data(), inexact);
+    for (unsigned l = 0; l != count; ++l) {
+      if (inexact[l]) {
+        if (assignments[base + l]->satisfies(exprs.begin(), exprs.end()))
+          return base + l;
+        continue;
+      }
+      bool satisfied = true;
+      for (unsigned j = 0; j != exprs.size() && satisfied; ++j)
+        satisfied = exprs[j]->getWidth() == Expr::Bool &&
+                    registers[results[j] * Lanes + l];
+      if (satisfied)
+        return base + l;
+    }
+  }
+  return -1;
+}
@@ -8,6 +8,9 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/Expr/ExprBuilder.h"
+#include "klee/Expr/ExprHashMap.h"
+
+#include <unordered_set>
 
 using namespace klee;
 
@@ -151,6 +154,314 @@ namespace {
     }
   };
 
+  /// CanonicalExprBuilder - Builds expressions with the create functions of
+  /// the expression classes, in the canonical form the rest of KLEE expects.
+  class CanonicalExprBuilder : public ExprBuilder {
+    virtual ref<Expr> Constant(const llvm::APInt &Value) {
+      return ConstantExpr::alloc(Value);
+    }
+
+    virtual ref<Expr> NotOptimized(const ref<Expr> &Index) {
+      return NotOptimizedExpr::create(Index);
+    }
+
+    virtual ref<Expr> Read(const UpdateList &Updates,
+                           const ref<Expr> &Index) {
+      return ReadExpr::create(Updates, Index);
+    }
+
+    virtual ref<Expr> Select(const ref<Expr> &Cond,
+                             const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SelectExpr::create(Cond, LHS, RHS);
+    }
+
+    virtual ref<Expr> Concat(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return ConcatExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Extract(const ref<Expr> &LHS,
+                              unsigned Offset, Expr::Width W) {
+      return ExtractExpr::create(LHS, Offset, W);
+    }
+
+    virtual ref<Expr> ZExt(const ref<Expr> &LHS, Expr::Width W) {
+      return ZExtExpr::create(LHS, W);
+    }
+
+    virtual ref<Expr> SExt(const ref<Expr> &LHS, Expr::Width W) {
+      return SExtExpr::create(LHS, W);
+    }
+
+    virtual ref<Expr> Add(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return AddExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Sub(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SubExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Mul(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return MulExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> UDiv(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return UDivExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> SDiv(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SDivExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> URem(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return URemExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> SRem(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SRemExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Not(const ref<Expr> &LHS) {
+      // booleans are negated by comparing them with false
+      if (LHS->getWidth() == Expr::Bool)
+        return Expr::createIsZero(LHS);
+      return NotExpr::create(LHS);
+    }
+
+    virtual ref<Expr> And(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return AndExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Or(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return OrExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Xor(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return XorExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Shl(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return ShlExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> LShr(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return LShrExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> AShr(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return AShrExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Eq(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return EqExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Ne(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return NeExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Ult(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return UltExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Ule(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return UleExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Ugt(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return UgtExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Uge(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return UgeExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Slt(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SltExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Sle(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SleExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Sgt(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SgtExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Sge(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SgeExpr::create(LHS, RHS);
+    }
+  };
+
+  /// HashConsingExprBuilder - Uniques all expressions returned by its base
+  /// builder, so that structurally equal expressions built through it are
+  /// the same node. When the kids were built through it as well, lookups
+  /// only compare them by pointer. Entries referenced only by the table are
+  /// dropped whenever it grows past a limit.
+  class HashConsingExprBuilder : public ExprBuilder {
+    ExprBuilder *Base;
+    std::unordered_set<ref<Expr>, util::ExprHash, util::ExprCmp> Table;
+    size_t SweepLimit;
+
+    static const size_t MinSweepLimit = 1 << 12;
+
+    void sweep() {
+      for (auto it = Table.begin(); it != Table.end();) {
+        if (it->get()->refCount == 1)
+          it = Table.erase(it);
+        else
+          ++it;
+      }
+      SweepLimit = 2 * Table.size();
+      if (SweepLimit < MinSweepLimit)
+        SweepLimit = MinSweepLimit;
+    }
+
+    ref<Expr> intern(const ref<Expr> &E) {
+      auto res = Table.insert(E);
+      if (res.second && Table.size() > SweepLimit) {
+        sweep();
+        return E;
+      }
+      return *res.first;
+    }
+
+  public:
+    HashConsingExprBuilder(ExprBuilder *Base)
+      : Base(Base), SweepLimit(MinSweepLimit) {}
+    ~HashConsingExprBuilder() { delete Base; }
+
+    virtual ref<Expr> Constant(const llvm::APInt &Value) {
+      return intern(Base->Constant(Value));
+    }
+
+    virtual ref<Expr> NotOptimized(const ref<Expr> &Index) {
+      return intern(Base->NotOptimized(Index));
+    }
+
+    virtual ref<Expr> Read(const UpdateList &Updates,
+                           const ref<Expr> &Index) {
+      return intern(Base->Read(Updates, Index));
+    }
+
+    virtual ref<Expr> Select(const ref<Expr> &Cond,
+                             const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Select(Cond, LHS, RHS));
+    }
+
+    virtual ref<Expr> Extract(const ref<Expr> &LHS,
+                              unsigned Offset, Expr::Width W) {
+      return intern(Base->Extract(LHS, Offset, W));
+    }
+
+    virtual ref<Expr> ZExt(const ref<Expr> &LHS, Expr::Width W) {
+      return intern(Base->ZExt(LHS, W));
+    }
+
+    virtual ref<Expr> SExt(const ref<Expr> &LHS, Expr::Width W) {
+      return intern(Base->SExt(LHS, W));
+    }
+
+    virtual ref<Expr> Not(const ref<Expr> &LHS) {
+      return intern(Base->Not(LHS));
+    }
+
+    virtual ref<Expr> Concat(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Concat(LHS, RHS));
+    }
+
+    virtual ref<Expr> Add(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Add(LHS, RHS));
+    }
+
+    virtual ref<Expr> Sub(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Sub(LHS, RHS));
+    }
+
+    virtual ref<Expr> Mul(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Mul(LHS, RHS));
+    }
+
+    virtual ref<Expr> UDiv(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->UDiv(LHS, RHS));
+    }
+
+    virtual ref<Expr> SDiv(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->SDiv(LHS, RHS));
+    }
+
+    virtual ref<Expr> URem(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->URem(LHS, RHS));
+    }
+
+    virtual ref<Expr> SRem(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->SRem(LHS, RHS));
+    }
+
+    virtual ref<Expr> And(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->And(LHS, RHS));
+    }
+
+    virtual ref<Expr> Or(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Or(LHS, RHS));
+    }
+
+    virtual ref<Expr> Xor(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Xor(LHS, RHS));
+    }
+
+    virtual ref<Expr> Shl(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Shl(LHS, RHS));
+    }
+
+    virtual ref<Expr> LShr(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->LShr(LHS, RHS));
+    }
+
+    virtual ref<Expr> AShr(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->AShr(LHS, RHS));
+    }
+
+    virtual ref<Expr> Eq(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Eq(LHS, RHS));
+    }
+
+    virtual ref<Expr> Ne(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Ne(LHS, RHS));
+    }
+
+    virtual ref<Expr> Ult(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Ult(LHS, RHS));
+    }
+
+    virtual ref<Expr> Ule(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Ule(LHS, RHS));
+    }
+
+    virtual ref<Expr> Ugt(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Ugt(LHS, RHS));
+    }
+
+    virtual ref<Expr> Uge(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Uge(LHS, RHS));
+    }
+
+    virtual ref<Expr> Slt(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Slt(LHS, RHS));
+    }
+
+    virtual ref<Expr> Sle(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Sle(LHS, RHS));
+    }
+
+    virtual ref<Expr> Sgt(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Sgt(LHS, RHS));
+    }
+
+    virtual ref<Expr> Sge(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return intern(Base->Sge(LHS, RHS));
+    }
+  };
+
   /// ChainedBuilder - Helper class for construct specialized expression
   /// builders, which implements (non-virtual) methods which forward to a base
   /// expression builder, for all expressions.
@@ -982,14 +1293,90 @@ namespace {
     ConstantFoldingExprBuilder;
 
   class SimplifyingBuilder : public ChainedBuilder {
+    /// getConstantSelect - Return \arg E as a select between two constants,
+    /// such as the segment of a pointer that may point to two objects, or
+    /// null if it is none.
+    static const SelectExpr *getConstantSelect(const ref<Expr> &E) {
+      const SelectExpr *SE = dyn_cast<SelectExpr>(E);
+      if (SE && isa<ConstantExpr>(SE->trueExpr) &&
+          isa<ConstantExpr>(SE->falseExpr))
+        return SE;
+      return 0;
+    }
+
   public:
     SimplifyingBuilder(ExprBuilder *Builder, ExprBuilder *Base)
       : ChainedBuilder(Builder, Base) {}
 
+    ref<Expr> Extract(const ref<NonConstantExpr> &LHS,
+                      unsigned Offset, Expr::Width W) {
+      if (const ZExtExpr *ZE = dyn_cast<ZExtExpr>(LHS)) {
+        Expr::Width SrcWidth = ZE->src->getWidth();
+        // extract(zext(X)) ==> extract(X), within X
+        if (Offset + W <= SrcWidth)
+          return Builder->Extract(ZE->src, Offset, W);
+        // extract(zext(X)) ==> 0, above X
+        if (Offset >= SrcWidth)
+          return Builder->Constant(0, W);
+      }
+
+      // extract(select(C, A, B)) ==> select(C, extract(A), extract(B))
+      if (const SelectExpr *SE = getConstantSelect(LHS))
+        return Builder->Select(SE->cond,
+                               Builder->Extract(SE->trueExpr, Offset, W),
+                               Builder->Extract(SE->falseExpr, Offset, W));
+
+      return Base->Extract(LHS, Offset, W);
+    }
+
+    ref<Expr> ZExt(const ref<NonConstantExpr> &LHS, Expr::Width W) {
+      if (W > LHS->getWidth()) {
+        // zext(zext(X)) ==> zext(X)
+        if (const ZExtExpr *ZE = dyn_cast<ZExtExpr>(LHS))
+          return Builder->ZExt(ZE->src, W);
+
+        // zext(select(C, A, B)) ==> select(C, zext(A), zext(B))
+        if (const SelectExpr *SE = getConstantSelect(LHS))
+          return Builder->Select(SE->cond, Builder->ZExt(SE->trueExpr, W),
+                                 Builder->ZExt(SE->falseExpr, W));
+      }
+
+      return Base->ZExt(LHS, W);
+    }
+
+    ref<Expr> SExt(const ref<NonConstantExpr> &LHS, Expr::Width W) {
+      if (W > LHS->getWidth()) {
+        // sext(sext(X)) ==> sext(X)
+        if (const SExtExpr *SE = dyn_cast<SExtExpr>(LHS))
+          return Builder->SExt(SE->src, W);
+
+        // sext(zext(X)) ==> zext(X), the sign bit being zero
+        if (const ZExtExpr *ZE = dyn_cast<ZExtExpr>(LHS))
+          return Builder->ZExt(ZE->src, W);
+
+        // sext(select(C, A, B)) ==> select(C, sext(A), sext(B))
+        if (const SelectExpr *SE = getConstantSelect(LHS))
+          return Builder->Select(SE->cond, Builder->SExt(SE->trueExpr, W),
+                                 Builder->SExt(SE->falseExpr, W));
+      }
+
+      return Base->SExt(LHS, W);
+    }
+
     ref<Expr> Eq(const ref<ConstantExpr> &LHS, 
                  const ref<NonConstantExpr> &RHS) {
       Expr::Width Width = LHS->getWidth();
+
+      // C == select(X, A, B) ==> select(X, C == A, C == B), which folds
+      if (const SelectExpr *SE = getConstantSelect(RHS))
+        return Builder->Select(SE->cond, Builder->Eq(LHS, SE->trueExpr),
+                               Builder->Eq(LHS, SE->falseExpr));
       
+      // C == X ==> false, when a bit known in X differs from C
+      bool Value;
+      if (Expr::decideByKnownBits(Expr::Eq, LHS.get(), RHS.get(), Value))
+        return Builder->Constant(Value, Expr::Bool);
+
       if (Width == Expr::Bool) {
         // true == X ==> X
         if (LHS->isTrue())
@@ -1013,6 +1400,19 @@ namespace {
       if (LHS == RHS)
           return Builder->True();
 
+      // select(X, A, B) == select(X, C, D) ==> select(X, A == C, B == D)
+      const SelectExpr *LSE = getConstantSelect(LHS);
+      const SelectExpr *RSE = getConstantSelect(RHS);
+      if (LSE && RSE && LSE->cond == RSE->cond)
+        return Builder->Select(LSE->cond,
+                               Builder->Eq(LSE->trueExpr, RSE->trueExpr),
+                               Builder->Eq(LSE->falseExpr, RSE->falseExpr));
+
+      // X == Y ==> false, when a bit known in both differs
+      bool Value;
+      if (Expr::decideByKnownBits(Expr::Eq, LHS.get(), RHS.get(), Value))
+        return Builder->Constant(Value, Expr::Bool);
+
       return Base->Eq(LHS, RHS);
     }
 
@@ -1029,6 +1429,38 @@ namespace {
       return Builder->Not(Builder->Eq(LHS, RHS));
     }
 
+    ref<Expr> Ult(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      // X u< Y ==> true or false, when the known bits of X and Y decide it
+      bool Value;
+      if (Expr::decideByKnownBits(Expr::Ult, LHS.get(), RHS.get(), Value))
+        return Builder->Constant(Value, Expr::Bool);
+      return Base->Ult(LHS, RHS);
+    }
+
+    ref<Expr> Ule(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      // X u<= Y ==> true or false, when the known bits of X and Y decide it
+      bool Value;
+      if (Expr::decideByKnownBits(Expr::Ule, LHS.get(), RHS.get(), Value))
+        return Builder->Constant(Value, Expr::Bool);
+      return Base->Ule(LHS, RHS);
+    }
+
+    ref<Expr> Slt(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      // X s< Y ==> true or false, when the known bits of X and Y decide it
+      bool Value;
+      if (Expr::decideByKnownBits(Expr::Slt, LHS.get(), RHS.get(), Value))
+        return Builder->Constant(Value, Expr::Bool);
+      return Base->Slt(LHS, RHS);
+    }
+
+    ref<Expr> Sle(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      // X s<= Y ==> true or false, when the known bits of X and Y decide it
+      bool Value;
+      if (Expr::decideByKnownBits(Expr::Sle, LHS.get(), RHS.get(), Value))
+        return Builder->Constant(Value, Expr::Bool);
+      return Base->Sle(LHS, RHS);
+    }
+
     ref<Expr> Ugt(const ref<Expr> &LHS, const ref<Expr> &RHS) {
       // X u> Y ==> Y u< X
       return Builder->Ult(RHS, LHS);
@@ -1058,6 +1490,14 @@ ExprBuilder *klee::createDefaultExprBuilder() {
   return new DefaultExprBuilder();
 }
 
+ExprBuilder *klee::createCanonicalExprBuilder() {
+  return new CanonicalExprBuilder();
+}
+
+ExprBuilder *klee::createHashConsingExprBuilder(ExprBuilder *Base) {
+  return new HashConsingExprBuilder(Base);
+}
+
 ExprBuilder *klee::createConstantFoldingExprBuilder(ExprBuilder *Base) {
   return new ConstantFoldingExprBuilder(Base);
 }
@@ -138,10 +138,7 @@ void ExprSMTLIBPrinter::printConstant(const ref<ConstantExpr> &e) {
     *p << "#b";
 
     zeroPad = e->getWidth() - value.length();
-
-    for (unsigned int count = 0; count < zeroPad; count++)
-      *p << "0";
-
+    value.insert(0, zeroPad, '0');
     *p << value;
     break;
 
@@ -150,9 +147,7 @@ void ExprSMTLIBPrinter::printConstant(const ref<ConstantExpr> &e) {
     *p << "#x";
 
     zeroPad = (e->getWidth() / 4) - value.length();
-    for (unsigned int count = 0; count < zeroPad; count++)
-      *p << "0";
-
+    value.insert(0, zeroPad, '0');
     *p << value;
     break;
 
@@ -524,6 +519,12 @@ void ExprSMTLIBPrinter::generateOutput() {
     return;
   }
 
+  // Queries are printed in many small pieces, collect them in a buffer if
+  // the stream writes each of them through right away.
+  bool unbuffered = o->GetBufferSize() == 0;
+  if (unbuffered)
+    o->SetBufferSize(64 * 1024);
+
   if (humanReadable)
     printNotice();
   printOptions();
@@ -537,6 +538,9 @@ void ExprSMTLIBPrinter::generateOutput() {
 
   printAction();
   printExit();
+
+  if (unbuffered)
+    o->SetUnbuffered();
 }
 
 void ExprSMTLIBPrinter::printSetLogic() {
@@ -598,6 +602,16 @@ void ExprSMTLIBPrinter::printArrayDeclarations() {
         for (std::vector<ref<ConstantExpr> >::const_iterator
                  ce = array->constantValues.begin();
              ce != array->constantValues.end(); ce++, byteIndex++) {
+          if (!humanReadable) {
+            // There is no indentation to keep track of, skip the print
+            // context for everything but the value.
+            *o << "(assert (=  (select " << array->name << " (_ bv"
+               << byteIndex << " " << array->getDomain() << ") ) ";
+            printConstant(*ce);
+            *o << " ) )\n";
+            continue;
+          }
+
           *p << "(assert (";
           p->pushIndent();
           *p << "= ";
@@ -659,8 +673,8 @@ void ExprSMTLIBPrinter::printQueryInSingleAssert() {
   ref<Expr> queryAssert = Expr::createIsZero(query->expr);
 
   // Print constraints inside the main query to reuse the Expr bindings
-  for (std::vector<ref<Expr> >::const_iterator i = query->constraints.begin(),
-                                               e = query->constraints.end();
+  for (ConstraintManager::const_iterator i = query->constraints.begin(),
+                                         e = query->constraints.end();
        i != e; ++i) {
     queryAssert = AndExpr::create(queryAssert, *i);
   }
@@ -881,7 +895,7 @@ void ExprSMTLIBPrinter::printAssert(const ref<Expr> &e) {
 
     // Print each binding on its level
     for (unsigned i = 0; i < orderedBindings.size(); ++i) {
-      BindingMap levelBindings = orderedBindings[i];
+      const BindingMap &levelBindings = orderedBindings[i];
       for (BindingMap::const_iterator j = levelBindings.begin();
            j != levelBindings.end(); ++j) {
         printSeperator();
@@ -0,0 +1,273 @@
+//===-- ExprScalarEvaluator.cpp -------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ExprScalarEvaluator.h"
+
+#include "klee/Expr/Assignment.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+static inline uint64_t getMask(Expr::Width width) {
+  return width >= 64 ? ~uint64_t(0) : (uint64_t(1) << width) - 1;
+}
+
+static inline int64_t signExtend(uint64_t value, Expr::Width width) {
+  if (width >= 64)
+    return static_cast<int64_t>(value);
+  return static_cast<int64_t>(value << (64 - width)) >> (64 - width);
+}
+
+namespace {
+/// A width known at compile time, so that masks and sign extensions fold.
+template <Expr::Width W> struct FixedWidth {
+  Expr::Width get() const { return W; }
+};
+
+struct AnyWidth {
+  Expr::Width width;
+  Expr::Width get() const { return width; }
+};
+}
+
+/// Compute a binary operation on operands of width \arg w, with the results
+/// of ConstantExpr.
+template <typename WidthT>
+static inline bool evaluateBinaryAt(Expr::Kind kind, WidthT w, uint64_t l,
+                                    uint64_t r, uint64_t &result) {
+  const Expr::Width width = w.get();
+  const uint64_t mask = getMask(width);
+  switch (kind) {
+  case Expr::Add:
+    result = (l + r) & mask;
+    return true;
+  case Expr::Sub:
+    result = (l - r) & mask;
+    return true;
+  case Expr::Mul:
+    result = (l * r) & mask;
+    return true;
+  case Expr::And:
+    result = l & r;
+    return true;
+  case Expr::Or:
+    result = l | r;
+    return true;
+  case Expr::Xor:
+    result = l ^ r;
+    return true;
+  case Expr::Shl:
+    result = r >= width ? 0 : (l << r) & mask;
+    return true;
+  case Expr::LShr:
+    result = r >= width ? 0 : l >> r;
+    return true;
+  case Expr::AShr:
+    result = static_cast<uint64_t>(signExtend(l, width) >>
+                                   std::min<uint64_t>(r, width - 1)) &
+             mask;
+    return true;
+
+  case Expr::UDiv:
+  case Expr::URem:
+  case Expr::SDiv:
+  case Expr::SRem: {
+    if (!r)
+      return false;
+    if (kind == Expr::UDiv) {
+      result = l / r;
+      return true;
+    }
+    if (kind == Expr::URem) {
+      result = l % r;
+      return true;
+    }
+    int64_t sl = signExtend(l, width), sr = signExtend(r, width);
+    // wraps around as APInt does, without overflowing here
+    if (sr == -1)
+      result = kind == Expr::SDiv ? uint64_t(0) - uint64_t(sl) : 0;
+    else
+      result = kind == Expr::SDiv ? sl / sr : sl % sr;
+    result &= mask;
+    return true;
+  }
+
+  case Expr::Eq:
+    result = l == r;
+    return true;
+  case Expr::Ne:
+    result = l != r;
+    return true;
+  case Expr::Ult:
+    result = l < r;
+    return true;
+  case Expr::Ule:
+    result = l <= r;
+    return true;
+  case Expr::Ugt:
+    result = l > r;
+    return true;
+  case Expr::Uge:
+    result = l >= r;
+    return true;
+  case Expr::Slt:
+    result = signExtend(l, width) < signExtend(r, width);
+    return true;
+  case Expr::Sle:
+    result = signExtend(l, width) <= signExtend(r, width);
+    return true;
+  case Expr::Sgt:
+    result = signExtend(l, width) > signExtend(r, width);
+    return true;
+  case Expr::Sge:
+    result = signExtend(l, width) >= signExtend(r, width);
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+bool ExprScalarEvaluator::evaluateBinary(Expr::Kind kind, Expr::Width width,
+                                         uint64_t l, uint64_t r,
+                                         uint64_t &result) {
+  switch (width) {
+  case Expr::Bool:
+    return evaluateBinaryAt(kind, FixedWidth<Expr::Bool>(), l, r, result);
+  case Expr::Int8:
+    return evaluateBinaryAt(kind, FixedWidth<Expr::Int8>(), l, r, result);
+  case Expr::Int16:
+    return evaluateBinaryAt(kind, FixedWidth<Expr::Int16>(), l, r, result);
+  case Expr::Int32:
+    return evaluateBinaryAt(kind, FixedWidth<Expr::Int32>(), l, r, result);
+  case Expr::Int64:
+    return evaluateBinaryAt(kind, FixedWidth<Expr::Int64>(), l, r, result);
+  default:
+    if (width > 64)
+      return false;
+    return evaluateBinaryAt(kind, AnyWidth{width}, l, r, result);
+  }
+}
+
+bool ExprScalarEvaluator::evaluateRead(const ReadExpr &re, uint64_t &value) {
+  uint64_t index64;
+  if (!evaluateNode(*re.index, index64))
+    return false;
+  // arrays are indexed by 32 bits, as by ExprEvaluator
+  unsigned index = index64;
+
+  for (const UpdateNode *un = re.updates.head; un; un = un->next) {
+    uint64_t updateIndex;
+    if (!evaluateNode(*un->index, updateIndex))
+      return false;
+    if (updateIndex == index)
+      return evaluateNode(*un->value, value);
+  }
+
+  const Array *root = re.updates.root;
+  if (root->isConstantArray() && index < root->constantValues.size())
+    value = root->constantValues[index]->getZExtValue();
+  else
+    value = assignment.getValue(root, index);
+  return true;
+}
+
+bool ExprScalarEvaluator::evaluateNode(const Expr &e, uint64_t &value) {
+  Expr::Width width = e.getWidth();
+  if (width > 64)
+    return false;
+  if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(&e)) {
+    value = ce->getZExtValue();
+    return true;
+  }
+  auto it = values.find(&e);
+  if (it != values.end()) {
+    value = it->second;
+    return true;
+  }
+
+  uint64_t l, r;
+  switch (e.getKind()) {
+  case Expr::NotOptimized:
+    if (!evaluateNode(*e.getKid(0), value))
+      return false;
+    break;
+
+  case Expr::Read:
+    if (!evaluateRead(cast<ReadExpr>(e), value))
+      return false;
+    break;
+
+  // only the branch taken, which may be all ExprEvaluator can evaluate
+  case Expr::Select: {
+    const SelectExpr &se = cast<SelectExpr>(e);
+    if (!evaluateNode(*se.cond, l) ||
+        !evaluateNode(l ? *se.trueExpr : *se.falseExpr, value))
+      return false;
+    break;
+  }
+
+  case Expr::Concat: {
+    const ConcatExpr &ce = cast<ConcatExpr>(e);
+    if (!evaluateNode(*ce.getLeft(), l) || !evaluateNode(*ce.getRight(), r))
+      return false;
+    value = l << ce.getRight()->getWidth() | r;
+    break;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr &ee = cast<ExtractExpr>(e);
+    if (!evaluateNode(*ee.expr, l))
+      return false;
+    value = (l >> ee.offset) & getMask(width);
+    break;
+  }
+
+  case Expr::Not:
+    if (!evaluateNode(*e.getKid(0), l))
+      return false;
+    value = ~l & getMask(width);
+    break;
+
+  case Expr::ZExt:
+    if (!evaluateNode(*e.getKid(0), value))
+      return false;
+    break;
+
+  case Expr::SExt: {
+    const ref<Expr> &kid = e.getKid(0);
+    if (!evaluateNode(*kid, l))
+      return false;
+    value = static_cast<uint64_t>(signExtend(l, kid->getWidth())) &
+            getMask(width);
+    break;
+  }
+
+  default: {
+    const BinaryExpr &be = cast<BinaryExpr>(e);
+    if (!evaluateNode(*be.left, l))
+      return false;
+    // a constant operand decides a boolean conjunction or disjunction, as
+    // when ExprEvaluator rebuilds it
+    if (width == Expr::Bool && ((e.getKind() == Expr::And && !l) ||
+                                (e.getKind() == Expr::Or && l))) {
+      value = l;
+      break;
+    }
+    if (!evaluateNode(*be.right, r) ||
+        !evaluateBinary(e.getKind(), be.left->getWidth(), l, r, value))
+      return false;
+    break;
+  }
+  }
+
+  values.insert(std::make_pair(&e, value));
+  return true;
+}
@@ -0,0 +1,315 @@
+//===-- ExprSerializer.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ExprSerializer.h"
+
+#include "klee/Expr/ArrayCache.h"
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/ArrayRef.h"
+
+#include <cassert>
+
+using namespace klee;
+
+// An expression reference is 0 for null, Definition for a node written in
+// place, or the number of an earlier node offset by FirstId.
+enum { Definition = 1, FirstId = 2 };
+
+void ExprWriter::writeInt(uint64_t value) {
+  char buf[10];
+  unsigned n = 0;
+  for (; value >= 0x80; value >>= 7)
+    buf[n++] = static_cast<char>(value | 0x80);
+  buf[n++] = static_cast<char>(value);
+  os.write(buf, n);
+}
+
+void ExprWriter::writeBytes(const void *data, size_t size) {
+  os.write(static_cast<const char *>(data), size);
+}
+
+void ExprWriter::write(const ref<Expr> &e) {
+  if (e.isNull()) {
+    writeInt(0);
+    return;
+  }
+  auto it = exprIds.find(e.get());
+  if (it != exprIds.end()) {
+    writeInt(it->second + FirstId);
+    return;
+  }
+
+  writeInt(Definition);
+  writeInt(e->getKind());
+  switch (e->getKind()) {
+  case Expr::Constant: {
+    const llvm::APInt &value = cast<ConstantExpr>(e)->getAPValue();
+    writeInt(value.getBitWidth());
+    for (unsigned i = 0, n = value.getNumWords(); i != n; ++i)
+      writeInt(value.getRawData()[i]);
+    break;
+  }
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    write(re->updates);
+    write(re->index);
+    break;
+  }
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    write(ee->expr);
+    writeInt(ee->offset);
+    writeInt(ee->width);
+    break;
+  }
+  case Expr::ZExt:
+  case Expr::SExt:
+    write(e->getKid(0));
+    writeInt(e->getWidth());
+    break;
+  default:
+    for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+      write(e->getKid(i));
+    break;
+  }
+  // numbered after the kids, as the reader creates the node only then
+  uint64_t id = exprIds.size();
+  exprIds[e.get()] = id;
+  exprs.push_back(e);
+}
+
+void ExprWriter::write(const UpdateList &updates) {
+  write(updates.root);
+
+  // the nodes not written yet, newest first
+  std::vector<const UpdateNode *> pending;
+  const UpdateNode *un = updates.head;
+  for (; un && !nodeIds.count(un); un = un->next)
+    pending.push_back(un);
+  writeInt(un ? nodeIds[un] + 1 : 0);
+
+  writeInt(pending.size());
+  for (auto it = pending.rbegin(), ie = pending.rend(); it != ie; ++it) {
+    write((*it)->index);
+    write((*it)->value);
+    uint64_t id = nodeIds.size();
+    nodeIds[*it] = id;
+    nodes.push_back(UpdateList(updates.root, *it));
+  }
+}
+
+void ExprWriter::write(const Array *array) {
+  if (!defineArrays) {
+    writeInt(reinterpret_cast<uintptr_t>(array));
+    return;
+  }
+  // 0 for a definition, or the number of an earlier array offset by 1
+  auto it = arrayIds.find(array);
+  if (it != arrayIds.end()) {
+    writeInt(it->second + 1);
+    return;
+  }
+
+  writeInt(0);
+  writeInt(array->name.size());
+  writeBytes(array->name.data(), array->name.size());
+  writeInt(array->size);
+  writeInt(array->domain);
+  writeInt(array->range);
+  writeInt(array->constantValues.size());
+  for (const ref<ConstantExpr> &value : array->constantValues)
+    write(value);
+  uint64_t id = arrayIds.size();
+  arrayIds[array] = id;
+  array->retain();
+}
+
+void ExprWriter::clear() {
+  exprIds.clear();
+  nodeIds.clear();
+  for (const auto &entry : arrayIds)
+    entry.first->release();
+  arrayIds.clear();
+  exprs.clear();
+  nodes.clear();
+}
+
+/***/
+
+uint64_t ExprReader::readInt() {
+  uint64_t value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    int c = is.get();
+    if (c == std::char_traits<char>::eof())
+      break;
+    value |= uint64_t(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      break;
+  }
+  return value;
+}
+
+void ExprReader::readBytes(void *data, size_t size) {
+  is.read(static_cast<char *>(data), size);
+}
+
+ref<Expr> ExprReader::readExpr() {
+  uint64_t tag = readInt();
+  if (tag == 0)
+    return ref<Expr>();
+  if (tag != Definition) {
+    assert(tag - FirstId < exprs.size() && "invalid expression reference");
+    return exprs[tag - FirstId];
+  }
+
+  ref<Expr> e;
+  Expr::Kind k = static_cast<Expr::Kind>(readInt());
+  // rebuild the nodes as they were, without simplifying them again
+  switch (k) {
+  case Expr::Constant: {
+    unsigned width = readInt();
+    std::vector<uint64_t> words((width + 63) / 64);
+    for (uint64_t &word : words)
+      word = readInt();
+    e = ConstantExpr::alloc(llvm::APInt(width, llvm::ArrayRef<uint64_t>(words)));
+    break;
+  }
+  case Expr::Read: {
+    UpdateList updates = readUpdateList();
+    ref<Expr> index = readExpr();
+    e = ReadExpr::alloc(updates, index);
+    break;
+  }
+  case Expr::Extract: {
+    ref<Expr> kid = readExpr();
+    unsigned offset = readInt();
+    Expr::Width width = readInt();
+    e = ExtractExpr::alloc(kid, offset, width);
+    break;
+  }
+  case Expr::NotOptimized:
+    e = NotOptimizedExpr::alloc(readExpr());
+    break;
+  case Expr::Not:
+    e = NotExpr::alloc(readExpr());
+    break;
+  case Expr::Select: {
+    ref<Expr> c = readExpr();
+    ref<Expr> t = readExpr();
+    ref<Expr> f = readExpr();
+    e = SelectExpr::alloc(c, t, f);
+    break;
+  }
+
+#define CAST_EXPR_CASE(T)                                                      \
+  case Expr::T: {                                                              \
+    ref<Expr> kid = readExpr();                                                \
+    Expr::Width width = readInt();                                             \
+    e = T##Expr::alloc(kid, width);                                            \
+    break;                                                                     \
+  }
+
+#define BINARY_EXPR_CASE(T)                                                    \
+  case Expr::T: {                                                              \
+    ref<Expr> l = readExpr();                                                  \
+    ref<Expr> r = readExpr();                                                  \
+    e = T##Expr::alloc(l, r);                                                  \
+    break;                                                                     \
+  }
+
+  CAST_EXPR_CASE(ZExt);
+  CAST_EXPR_CASE(SExt);
+
+  BINARY_EXPR_CASE(Concat);
+  BINARY_EXPR_CASE(Add);
+  BINARY_EXPR_CASE(Sub);
+  BINARY_EXPR_CASE(Mul);
+  BINARY_EXPR_CASE(UDiv);
+  BINARY_EXPR_CASE(SDiv);
+  BINARY_EXPR_CASE(URem);
+  BINARY_EXPR_CASE(SRem);
+  BINARY_EXPR_CASE(And);
+  BINARY_EXPR_CASE(Or);
+  BINARY_EXPR_CASE(Xor);
+  BINARY_EXPR_CASE(Shl);
+  BINARY_EXPR_CASE(LShr);
+  BINARY_EXPR_CASE(AShr);
+
+  BINARY_EXPR_CASE(Eq);
+  BINARY_EXPR_CASE(Ne);
+  BINARY_EXPR_CASE(Ult);
+  BINARY_EXPR_CASE(Ule);
+  BINARY_EXPR_CASE(Ugt);
+  BINARY_EXPR_CASE(Uge);
+  BINARY_EXPR_CASE(Slt);
+  BINARY_EXPR_CASE(Sle);
+  BINARY_EXPR_CASE(Sgt);
+  BINARY_EXPR_CASE(Sge);
+
+#undef CAST_EXPR_CASE
+#undef BINARY_EXPR_CASE
+
+  default:
+    assert(0 && "invalid expression kind");
+  }
+  exprs.push_back(e);
+  return e;
+}
+
+UpdateList ExprReader::readUpdateList() {
+  const Array *root = readArray();
+  uint64_t tip = readInt();
+  assert(tip <= nodes.size() && "invalid update node reference");
+  UpdateList updates(root, tip ? nodes[tip - 1].head : 0);
+
+  for (uint64_t n = readInt(); n != 0; --n) {
+    ref<Expr> index = readExpr();
+    ref<Expr> value = readExpr();
+    updates.extend(index, value);
+    nodes.push_back(updates);
+  }
+  return updates;
+}
+
+const Array *ExprReader::readArray() {
+  if (!arrayCache)
+    return reinterpret_cast<const Array *>(readInt());
+  uint64_t tag = readInt();
+  if (tag) {
+    assert(tag - 1 < arrays.size() && "invalid array reference");
+    return arrays[tag - 1];
+  }
+
+  std::string name(readInt(), '\0');
+  readBytes(&name[0], name.size());
+  uint64_t size = readInt();
+  Expr::Width domain = readInt();
+  Expr::Width range = readInt();
+  std::vector<ref<ConstantExpr> > values;
+  for (uint64_t n = readInt(); n != 0; --n) {
+    ref<Expr> value = readExpr();
+    assert(isa<ConstantExpr>(value) && "invalid array contents");
+    values.push_back(cast<ConstantExpr>(value));
+  }
+  const Array *array = arrayCache->CreateArray(
+      name, size, values.empty() ? 0 : &values[0],
+      values.empty() ? 0 : &values[0] + values.size(), domain, range);
+  arrays.push_back(array);
+  array->retain();
+  return array;
+}
+
+void ExprReader::clear() {
+  exprs.clear();
+  nodes.clear();
+  for (const Array *array : arrays)
+    array->release();
+  arrays.clear();
+}
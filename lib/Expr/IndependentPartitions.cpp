@@ -0,0 +1,158 @@
+//===-- IndependentPartitions.cpp -----------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/IndependentPartitions.h"
+
+#include "klee/Expr/ExprUtil.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+const uint64_t IndependentPartitions::WholeArray;
+
+const IndependentPartitions::ordered_ty &
+IndependentPartitions::Partition::getOrdered() const {
+  if (!ordered) {
+    auto sorted = std::make_shared<ordered_ty>(constraints.begin(),
+                                               constraints.end());
+    std::sort(sorted->begin(), sorted->end(),
+              [](const std::pair<unsigned, ref<Expr> > &a,
+                 const std::pair<unsigned, ref<Expr> > &b) {
+                return a.first < b.first;
+              });
+    ordered = sorted;
+  }
+  return *ordered;
+}
+
+void IndependentPartitions::Partition::getConstraints(
+    std::vector<ref<Expr> > &result) const {
+  for (const auto &entry : getOrdered())
+    result.push_back(entry.second);
+}
+
+void IndependentPartitions::getVariables(const ref<Expr> &e,
+                                         std::vector<Variable> &variables) {
+  std::vector<ref<ReadExpr> > reads;
+  findReads(e, /* visitUpdates= */ true, reads);
+  for (const auto &re : reads) {
+    const Array *array = re->updates.root;
+    // Reads of a constant array don't alias.
+    if (array->isConstantArray() && !re->updates.head)
+      continue;
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index))
+      variables.push_back(std::make_pair(array, CE->getZExtValue(32)));
+    else
+      variables.push_back(std::make_pair(array, WholeArray));
+  }
+  std::sort(variables.begin(), variables.end());
+  variables.erase(std::unique(variables.begin(), variables.end()),
+                  variables.end());
+}
+
+void IndependentPartitions::getPartitionIds(
+    const std::vector<Variable> &variables,
+    std::vector<unsigned> &ids) const {
+  for (const Variable &v : variables) {
+    // a whole array is in the same partition as all of its bytes
+    if (const auto *whole = owners.lookup(std::make_pair(v.first, WholeArray))) {
+      ids.push_back(whole->second);
+    } else if (v.second == WholeArray) {
+      for (auto it = owners.lower_bound(std::make_pair(v.first, uint64_t(0))),
+                ie = owners.end();
+           it != ie && it->first.first == v.first; ++it)
+        ids.push_back(it->second);
+    } else if (const auto *owner = owners.lookup(v)) {
+      ids.push_back(owner->second);
+    }
+  }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+
+void IndependentPartitions::add(unsigned position, const ref<Expr> &e) {
+  std::vector<Variable> variables;
+  getVariables(e, variables);
+  if (variables.empty())
+    return;
+
+  std::vector<unsigned> ids;
+  getPartitionIds(variables, ids);
+
+  // merge into the largest partition, so that a variable is relabeled
+  // only when its partition at least doubles
+  unsigned target = nextId;
+  size_t targetSize = 0;
+  for (unsigned id : ids) {
+    size_t size = partitions.lookup(id)->second->variables.size();
+    if (target == nextId || size > targetSize) {
+      target = id;
+      targetSize = size;
+    }
+  }
+
+  Partition merged;
+  if (target == nextId)
+    ++nextId;
+  else
+    merged = *partitions.lookup(target)->second;
+  merged.ordered.reset();
+
+  for (unsigned id : ids) {
+    if (id == target)
+      continue;
+    const Partition &p = *partitions.lookup(id)->second;
+    for (const auto &constraint : p.constraints)
+      merged.constraints.push_back(constraint);
+    for (const Variable &v : p.variables) {
+      merged.variables.push_back(v);
+      owners = owners.replace(std::make_pair(v, target));
+    }
+    partitions = partitions.remove(id);
+  }
+
+  merged.constraints.push_back(std::make_pair(position, e));
+  for (const Variable &v : variables) {
+    if (owners.count(v))
+      continue;
+    merged.variables.push_back(v);
+    owners = owners.insert(std::make_pair(v, target));
+  }
+  partitions = partitions.replace(
+      std::make_pair(target, std::make_shared<const Partition>(merged)));
+}
+
+void IndependentPartitions::getDependencies(
+    const ref<Expr> &e, std::vector<ref<Expr> > &result) const {
+  std::vector<Variable> variables;
+  getVariables(e, variables);
+  std::vector<unsigned> ids;
+  getPartitionIds(variables, ids);
+
+  if (ids.size() == 1) {
+    partitions.lookup(ids[0])->second->getConstraints(result);
+    return;
+  }
+
+  // merge the ordered constraints of the partitions, which are disjoint
+  ordered_ty all;
+  for (unsigned id : ids) {
+    const ordered_ty &ordered = partitions.lookup(id)->second->getOrdered();
+    size_t middle = all.size();
+    all.insert(all.end(), ordered.begin(), ordered.end());
+    std::inplace_merge(all.begin(), all.begin() + middle, all.end(),
+                       [](const std::pair<unsigned, ref<Expr> > &a,
+                          const std::pair<unsigned, ref<Expr> > &b) {
+                         return a.first < b.first;
+                       });
+  }
+  for (const auto &entry : all)
+    result.push_back(entry.second);
+}
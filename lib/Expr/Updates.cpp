@@ -9,17 +9,101 @@
 
 #include "klee/Expr/Expr.h"
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Hashing.h"
+
 #include <cassert>
 
 using namespace klee;
 
-UpdateNode::UpdateNode(const UpdateNode *_next, 
+namespace {
+/// Updates of a run at constant indices are indexed in spans of powers of
+/// this many updates.
+const unsigned IndexSpan = 16;
+
+/// The index of an update at a constant index, or false if it has not
+/// got one.
+bool getConstantIndex(const ref<Expr> &index, uint64_t &result) {
+  const ConstantExpr *CE = dyn_cast<ConstantExpr>(index);
+  if (!CE || CE->getWidth() > 64)
+    return false;
+  result = CE->getZExtValue();
+  return true;
+}
+
+/// An update looked up among the interned ones.
+struct UpdateKey {
+  const Array *root;
+  const UpdateNode *next;
+  const ref<Expr> &index, &value;
+};
+
+unsigned hashUpdate(const Array *root, const UpdateNode *next,
+                    const ref<Expr> &index, const ref<Expr> &value) {
+  return llvm::hash_combine(root, next, index->hash(), value->hash());
+}
+
+/// Updates are equal if they are made to the same array, on the same
+/// (interned) older updates, with structurally equal index and value.
+struct UpdateNodeInfo {
+  static const UpdateNode *getEmptyKey() {
+    return llvm::DenseMapInfo<const UpdateNode *>::getEmptyKey();
+  }
+  static const UpdateNode *getTombstoneKey() {
+    return llvm::DenseMapInfo<const UpdateNode *>::getTombstoneKey();
+  }
+  static unsigned getHashValue(const UpdateNode *un) {
+    return hashUpdate(un->getRoot(), un->next, un->index, un->value);
+  }
+  static unsigned getHashValue(const UpdateKey &key) {
+    return hashUpdate(key.root, key.next, key.index, key.value);
+  }
+  static bool isEqual(const UpdateNode *a, const UpdateNode *b) {
+    return a == b;
+  }
+  static bool isEqual(const UpdateKey &key, const UpdateNode *un) {
+    return un != getEmptyKey() && un != getTombstoneKey() &&
+           key.root == un->getRoot() && key.next == un->next &&
+           key.index == un->index && key.value == un->value;
+  }
+};
+
+typedef llvm::DenseSet<const UpdateNode *, UpdateNodeInfo> UpdateNodeSet;
+
+/// The live update nodes, so that updates repeated on the same older ones
+/// are shared, and equal update lists have the same head.
+UpdateNodeSet &getInternedUpdates() {
+  // never destroyed, the nodes of static update lists outlive it otherwise
+  static UpdateNodeSet *updates = new UpdateNodeSet();
+  return *updates;
+}
+}
+
+/// The index of a span of a run of updates at constant indices, kept at its
+/// most recent update. Spans of IndexSpan^k updates end at every update
+/// whose position in the run is a multiple of IndexSpan^k, and are indexed
+/// at the largest k, so that a lookup passes at most IndexSpan - 1 spans of
+/// each size.
+struct UpdateNode::RunIndex {
+  /// The most recent update of the span at each index.
+  llvm::DenseMap<uint64_t, const UpdateNode *> latest;
+  /// Number of updates in the span.
+  unsigned span;
+  /// The update right below the span.
+  const UpdateNode *below;
+};
+
+UpdateNode::UpdateNode(const Array *_root,
+                       const UpdateNode *_next, 
                        const ref<Expr> &_index, 
                        const ref<Expr> &_value) 
   : refCount(0),    
     next(_next),
     index(_index),
-    value(_value) {
+    value(_value),
+    root(_root),
+    runIndex(0) {
   // FIXME: What we need to check here instead is that _value is of the same width 
   // as the range of the array that the update node is part of.
   /*
@@ -32,6 +116,40 @@ UpdateNode::UpdateNode(const UpdateNode *_next,
     size = 1 + next->size;
   }
   else size = 1;
+
+  uint64_t constantIndex;
+  if (!getConstantIndex(index, constantIndex)) {
+    constantRun = 0;
+    return;
+  }
+  constantRun = 1 + (next ? next->constantRun : 0);
+  if (constantRun % IndexSpan)
+    return;
+
+  unsigned span = IndexSpan;
+  while (span <= constantRun / IndexSpan && constantRun % (span * IndexSpan) == 0)
+    span *= IndexSpan;
+  RunIndex *ri = new RunIndex();
+  ri->span = span;
+  ri->latest[constantIndex] = this;
+  // The smaller spans below are merged, the more recent updates first.
+  const UpdateNode *un = next;
+  for (unsigned covered = 1; covered != span;) {
+    if (un->runIndex) {
+      for (const auto &entry : un->runIndex->latest)
+        ri->latest.insert(entry);
+      covered += un->runIndex->span;
+      un = un->runIndex->below;
+    } else {
+      uint64_t i;
+      getConstantIndex(un->index, i);
+      ri->latest.insert(std::make_pair(i, un));
+      ++covered;
+      un = un->next;
+    }
+  }
+  ri->below = un;
+  runIndex = ri;
 }
 
 extern "C" void vc_DeleteExpr(void*);
@@ -42,6 +160,41 @@ extern "C" void vc_DeleteExpr(void*);
 // non-recursively.
 UpdateNode::~UpdateNode() {
     assert(refCount == 0 && "Deleted UpdateNode when a reference is still held");
+    getInternedUpdates().erase(this);
+    delete runIndex;
+}
+
+const UpdateNode *UpdateNode::intern(const Array *root, const UpdateNode *next,
+                                     const ref<Expr> &index,
+                                     const ref<Expr> &value) {
+  auto &interned = getInternedUpdates();
+  auto it = interned.find_as(UpdateKey{root, next, index, value});
+  if (it != interned.end())
+    return *it;
+  const UpdateNode *un = new UpdateNode(root, next, index, value);
+  interned.insert(un);
+  return un;
+}
+
+const UpdateNode *UpdateNode::findConstantWrite(uint64_t index,
+                                                const UpdateNode *&rest) const {
+  const UpdateNode *un = this;
+  while (un && un->constantRun) {
+    if (un->runIndex) {
+      auto it = un->runIndex->latest.find(index);
+      if (it != un->runIndex->latest.end())
+        return it->second;
+      un = un->runIndex->below;
+    } else {
+      uint64_t i;
+      getConstantIndex(un->index, i);
+      if (i == index)
+        return un;
+      un = un->next;
+    }
+  }
+  rest = un;
+  return 0;
 }
 
 int UpdateNode::compare(const UpdateNode &b) const {
@@ -62,17 +215,20 @@ unsigned UpdateNode::computeHash() {
 UpdateList::UpdateList(const Array *_root, const UpdateNode *_head)
   : root(_root),
     head(_head) {
+  if (root) root->retain();
   if (head) ++head->refCount;
 }
 
 UpdateList::UpdateList(const UpdateList &b)
   : root(b.root),
     head(b.head) {
+  if (root) root->retain();
   if (head) ++head->refCount;
 }
 
 UpdateList::~UpdateList() {
     tryFreeNodes();
+    if (root) root->release();
 }
 
 void UpdateList::tryFreeNodes() {
@@ -133,10 +289,12 @@ void UpdateList::tryFreeNodes() {
 }
 
 UpdateList &UpdateList::operator=(const UpdateList &b) {
+  if (b.root) b.root->retain();
   if (b.head) ++b.head->refCount;
   // Drop reference to the current head and free a chain of nodes
   // if we are the only UpdateList referencing them
   tryFreeNodes();
+  if (root) root->release();
   root = b.root;
   head = b.head;
   return *this;
@@ -149,13 +307,15 @@ void UpdateList::extend(const ref<Expr> &index, const ref<Expr> &value) {
     assert(root->getRange() == value->getWidth());
   }
 
+  // an interned node on top of the head holds a reference to it as well
   if (head) --head->refCount;
-  head = new UpdateNode(head, index, value);
+  head = UpdateNode::intern(root, head, index, value);
   ++head->refCount;
 }
 
 int UpdateList::compare(const UpdateList &b) const {
-  if (root->name != b.root->name)
+  // interned names are equal exactly if they are the same
+  if (!root->hasSameName(*b.root))
     return root->name < b.root->name ? -1 : 1;
 
   // Check the root itself in case we have separate objects with the
@@ -166,7 +326,9 @@ int UpdateList::compare(const UpdateList &b) const {
   if (getSize() < b.getSize()) return -1;
   else if (getSize() > b.getSize()) return 1;    
 
-  // XXX build comparison into update, make fast
+  // Update nodes are interned, so equal lists extended on this root have
+  // the same head and the loop ends at once. Only lists made up of nodes
+  // of another root are compared node by node.
   const UpdateNode *an=head, *bn=b.head;
   for (; an && bn; an=an->next,bn=bn->next) {
     if (an==bn) { // exploit shared list structure
@@ -181,9 +343,7 @@ int UpdateList::compare(const UpdateList &b) const {
 }
 
 unsigned UpdateList::hash() const {
-  unsigned res = 0;
-  for (unsigned i = 0, e = root->name.size(); i != e; ++i)
-    res = (res * Expr::MAGIC_HASH_CONSTANT) + root->name[i];
+  unsigned res = root->getNameHash();
   if (head)
     res ^= head->hash();
   return res;
@@ -13,9 +13,12 @@
 
 #include "KLEEIRMetaData.h"
 
+#include "klee/Internal/Support/ErrorHandling.h"
+
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/InstrTypes.h"
@@ -29,15 +32,253 @@
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
+#include <algorithm>
+#include <memory>
+
 using namespace llvm;
 using namespace klee;
 
+namespace {
+/// Unsigned and signed bounds of an integer of at most 64 bits, both
+/// inclusive. The value may be anything within both of them; an empty
+/// range stands for a value that is never computed.
+struct ValueRange {
+  uint64_t umin, umax;
+  int64_t smin, smax;
+
+  explicit ValueRange(unsigned width)
+      : umin(0), umax(~uint64_t(0) >> (64 - width)),
+        smin(width == 64 ? INT64_MIN : -(int64_t(1) << (width - 1))),
+        smax(int64_t(umax >> 1)) {}
+
+  bool isEmpty() const { return umin > umax || smin > smax; }
+
+  /// Narrow the unsigned bounds, and the signed ones as far as they agree.
+  void limitUnsigned(uint64_t lo, uint64_t hi) {
+    umin = std::max(umin, lo);
+    umax = std::min(umax, hi);
+    if (umax <= uint64_t(smax) && smin <= 0) {
+      smin = std::max(smin, int64_t(umin));
+      smax = std::min(smax, int64_t(umax));
+    }
+  }
+
+  void limitSigned(int64_t lo, int64_t hi) {
+    smin = std::max(smin, lo);
+    smax = std::min(smax, hi);
+    if (smin >= 0)
+      limitUnsigned(smin, smax);
+  }
+
+  bool isNonZero() const {
+    return isEmpty() || umin > 0 || smin > 0 || smax < 0;
+  }
+
+  bool isBelow(uint64_t bound) const { return isEmpty() || umax < bound; }
+};
+
+/// Bound the operands of divisions and shifts from the instructions that
+/// compute them and from the comparisons of the branches that dominate
+/// their uses, to find the checks that cannot fail.
+class OperandRanges {
+  DominatorTree dt;
+
+  ValueRange compute(Value *v, Instruction *at, unsigned depth);
+  void applyCondition(ValueRange &range, Value *v, ICmpInst *cmp,
+                      bool holds);
+
+public:
+  explicit OperandRanges(Function &f) : dt(f) {}
+
+  /// The range of \p v wherever \p at executes.
+  ValueRange get(Value *v, Instruction *at) { return compute(v, at, 0); }
+};
+
+ValueRange OperandRanges::compute(Value *v, Instruction *at,
+                                  unsigned depth) {
+  auto *type = dyn_cast<IntegerType>(v->getType());
+  if (!type || type->getBitWidth() > 64)
+    return ValueRange(64);
+  unsigned width = type->getBitWidth();
+  ValueRange range(width);
+
+  if (auto *c = dyn_cast<ConstantInt>(v)) {
+    range.limitUnsigned(c->getZExtValue(), c->getZExtValue());
+    return range;
+  }
+
+  // what the instruction computing the value implies
+  auto *inst = dyn_cast<Instruction>(v);
+  if (inst && depth < 4) {
+    auto operand = [&](unsigned i) {
+      return compute(inst->getOperand(i), at, depth + 1);
+    };
+    switch (inst->getOpcode()) {
+    case Instruction::ZExt:
+    case Instruction::SExt: {
+      ValueRange r = operand(0);
+      if (inst->getOpcode() == Instruction::ZExt)
+        range.limitUnsigned(r.umin, r.umax);
+      else
+        range.limitSigned(r.smin, r.smax);
+      // extensions of non-zero values are not zero either
+      if (r.isNonZero())
+        range.limitUnsigned(1, range.umax);
+      break;
+    }
+    case Instruction::Trunc: {
+      ValueRange r = operand(0);
+      if (r.umax <= range.umax)
+        range.limitUnsigned(r.umin, r.umax);
+      break;
+    }
+    case Instruction::And:
+      range.limitUnsigned(0, std::min(operand(0).umax, operand(1).umax));
+      break;
+    case Instruction::Or: {
+      ValueRange a = operand(0), b = operand(1);
+      range.limitUnsigned(std::max(a.umin, b.umin), range.umax);
+      break;
+    }
+    case Instruction::URem: {
+      ValueRange b = operand(1);
+      if (b.umax)
+        range.limitUnsigned(0, b.umax - 1);
+      range.limitUnsigned(0, operand(0).umax);
+      break;
+    }
+    case Instruction::UDiv:
+      if (auto *c = dyn_cast<ConstantInt>(inst->getOperand(1))) {
+        if (!c->isZero()) {
+          ValueRange a = operand(0);
+          range.limitUnsigned(a.umin / c->getZExtValue(),
+                              a.umax / c->getZExtValue());
+        }
+      }
+      break;
+    case Instruction::LShr:
+      if (auto *c = dyn_cast<ConstantInt>(inst->getOperand(1))) {
+        if (c->getZExtValue() < width) {
+          ValueRange a = operand(0);
+          range.limitUnsigned(a.umin >> c->getZExtValue(),
+                              a.umax >> c->getZExtValue());
+        }
+      }
+      break;
+    case Instruction::Select: {
+      ValueRange a = operand(1), b = operand(2);
+      if (a.isEmpty())
+        a = b;
+      else if (b.isEmpty())
+        b = a;
+      range.limitUnsigned(std::min(a.umin, b.umin), std::max(a.umax, b.umax));
+      range.limitSigned(std::min(a.smin, b.smin), std::max(a.smax, b.smax));
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  // what the branches leading to the use imply, looking at every
+  // dominator of its block
+  BasicBlock *bb = at->getParent();
+  DomTreeNode *node = dt.getNode(bb);
+  for (; node && node->getIDom(); node = node->getIDom()) {
+    BasicBlock *dom = node->getIDom()->getBlock();
+    auto *br = dyn_cast<BranchInst>(dom->getTerminator());
+    if (!br || !br->isConditional())
+      continue;
+    auto *cmp = dyn_cast<ICmpInst>(br->getCondition());
+    if (!cmp || (cmp->getOperand(0) != v && cmp->getOperand(1) != v))
+      continue;
+    for (unsigned i = 0; i != 2; ++i) {
+      if (br->getSuccessor(0) == br->getSuccessor(1))
+        break;
+      BasicBlockEdge edge(dom, br->getSuccessor(i));
+      if (dt.dominates(edge, bb))
+        applyCondition(range, v, cmp, i == 0);
+    }
+  }
+  return range;
+}
+
+void OperandRanges::applyCondition(ValueRange &range, Value *v,
+                                   ICmpInst *cmp, bool holds) {
+  CmpInst::Predicate pred =
+      holds ? cmp->getPredicate() : cmp->getInversePredicate();
+  Value *other = cmp->getOperand(1);
+  if (other == v) {
+    other = cmp->getOperand(0);
+    pred = CmpInst::getSwappedPredicate(pred);
+  }
+  auto *c = dyn_cast<ConstantInt>(other);
+  if (!c)
+    return;
+  uint64_t u = c->getZExtValue();
+  int64_t s = c->getSExtValue();
+  ValueRange full(c->getBitWidth());
+
+  switch (pred) {
+  case CmpInst::ICMP_EQ:
+    range.limitUnsigned(u, u);
+    break;
+  case CmpInst::ICMP_NE:
+    if (u == range.umin && u != full.umax)
+      range.limitUnsigned(u + 1, full.umax);
+    else if (u == range.umax && u)
+      range.limitUnsigned(0, u - 1);
+    break;
+  case CmpInst::ICMP_ULT:
+    if (!u)
+      range.limitUnsigned(1, 0);
+    else
+      range.limitUnsigned(0, u - 1);
+    break;
+  case CmpInst::ICMP_ULE:
+    range.limitUnsigned(0, u);
+    break;
+  case CmpInst::ICMP_UGT:
+    if (u == full.umax)
+      range.limitUnsigned(1, 0);
+    else
+      range.limitUnsigned(u + 1, full.umax);
+    break;
+  case CmpInst::ICMP_UGE:
+    range.limitUnsigned(u, full.umax);
+    break;
+  case CmpInst::ICMP_SLT:
+    if (s == full.smin)
+      range.limitSigned(0, -1);
+    else
+      range.limitSigned(full.smin, s - 1);
+    break;
+  case CmpInst::ICMP_SLE:
+    range.limitSigned(full.smin, s);
+    break;
+  case CmpInst::ICMP_SGT:
+    if (s == full.smax)
+      range.limitSigned(0, -1);
+    else
+      range.limitSigned(s + 1, full.smax);
+    break;
+  case CmpInst::ICMP_SGE:
+    range.limitSigned(s, full.smax);
+    break;
+  default:
+    break;
+  }
+}
+}
+
 char DivCheckPass::ID;
 
 bool DivCheckPass::runOnModule(Module &M) {
   std::vector<llvm::BinaryOperator *> divInstruction;
+  unsigned provenSafe = 0;
 
   for (auto &F : M) {
+    std::unique_ptr<OperandRanges> ranges;
     for (auto &BB : F) {
       for (auto &I : BB) {
         auto binOp = dyn_cast<BinaryOperator>(&I);
@@ -60,11 +301,23 @@ bool DivCheckPass::runOnModule(Module &M) {
         // Check if the operand is already checked by "klee_div_zero_check"
         if (KleeIRMetaData::hasAnnotation(I, "klee.check.div", "True"))
           continue;
+
+        // Skip the divisors that cannot be zero where they are used
+        if (!ranges)
+          ranges.reset(new OperandRanges(F));
+        if (ranges->get(operand, binOp).isNonZero()) {
+          ++provenSafe;
+          continue;
+        }
         divInstruction.push_back(binOp);
       }
     }
   }
 
+  if (provenSafe)
+    klee_message("Inserted %u division checks, %u divisors proven non-zero",
+                 (unsigned)divInstruction.size(), provenSafe);
+
   // If nothing to do, return
   if (divInstruction.empty())
     return false;
@@ -92,7 +345,9 @@ char OvershiftCheckPass::ID;
 
 bool OvershiftCheckPass::runOnModule(Module &M) {
   std::vector<llvm::BinaryOperator *> shiftInstructions;
+  unsigned provenSafe = 0;
   for (auto &F : M) {
+    std::unique_ptr<OperandRanges> ranges;
     for (auto &BB : F) {
       for (auto &I : BB) {
         auto binOp = dyn_cast<BinaryOperator>(&I);
@@ -119,11 +374,25 @@ bool OvershiftCheckPass::runOnModule(Module &M) {
         if (KleeIRMetaData::hasAnnotation(I, "klee.check.shift", "True"))
           continue;
 
+        // Skip the shifts known to be smaller than the width where they
+        // are used
+        if (!ranges)
+          ranges.reset(new OperandRanges(F));
+        if (ranges->get(operand, binOp)
+                .isBelow(binOp->getType()->getScalarSizeInBits())) {
+          ++provenSafe;
+          continue;
+        }
+
         shiftInstructions.push_back(binOp);
       }
     }
   }
 
+  if (provenSafe)
+    klee_message("Inserted %u overshift checks, %u shifts proven in range",
+                 (unsigned)shiftInstructions.size(), provenSafe);
+
   if (shiftInstructions.empty())
     return false;
 
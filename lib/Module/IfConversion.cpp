@@ -0,0 +1,143 @@
+//===-- IfConversion.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "KLEEIRMetaData.h"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+#include <vector>
+
+using namespace llvm;
+
+char klee::IfConversionPass::ID = 0;
+
+/// Whether \a arm, a block branching unconditionally to \a join, only
+/// computes values and has \a pred as its only predecessor, so that it can
+/// be executed ahead of the branch of \a pred.
+bool klee::IfConversionPass::canHoist(BasicBlock *arm, BasicBlock *pred,
+                                      BasicBlock *join) const {
+  if (arm->getSinglePredecessor() != pred || arm->hasAddressTaken())
+    return false;
+  BranchInst *br = dyn_cast<BranchInst>(arm->getTerminator());
+  if (!br || br->isConditional() || br->getSuccessor(0) != join)
+    return false;
+
+  unsigned count = 0;
+  for (Instruction &i : *arm) {
+    if (&i == br || isa<DbgInfoIntrinsic>(i))
+      continue;
+    if (isa<PHINode>(i) || i.mayReadOrWriteMemory() ||
+        !isSafeToSpeculativelyExecute(&i) || ++count > maxInstructions)
+      return false;
+  }
+  return true;
+}
+
+/// Replace the branch at the end of \a bb, to \a thenBB and \a elseBB of
+/// which the ones different from \a join are hoisted, by a branch to
+/// \a join, selecting the values of its phi nodes.
+void klee::IfConversionPass::convert(BasicBlock *bb, BasicBlock *thenBB,
+                                     BasicBlock *elseBB, BasicBlock *join) {
+  BranchInst *br = cast<BranchInst>(bb->getTerminator());
+  Value *cond = br->getCondition();
+
+  for (BasicBlock *arm : {thenBB, elseBB}) {
+    if (arm == join)
+      continue;
+    while (&arm->front() != arm->getTerminator())
+      arm->front().moveBefore(br);
+  }
+
+  KleeIRMetaData md(bb->getContext());
+  for (Instruction &i : *join) {
+    PHINode *phi = dyn_cast<PHINode>(&i);
+    if (!phi)
+      break;
+    Value *t = phi->getIncomingValueForBlock(thenBB == join ? bb : thenBB);
+    Value *f = phi->getIncomingValueForBlock(elseBB == join ? bb : elseBB);
+    for (BasicBlock *arm : {thenBB, elseBB, bb}) {
+      if (arm == join)
+        continue;
+      int index;
+      while ((index = phi->getBasicBlockIndex(arm)) >= 0)
+        phi->removeIncomingValue(index, false);
+    }
+    Value *v = t;
+    if (t != f) {
+      SelectInst *select =
+          SelectInst::Create(cond, t, f, phi->getName() + ".ifconv", br);
+      md.addAnnotation(*select, "klee.if-converted", "True");
+      v = select;
+    }
+    phi->addIncoming(v, bb);
+  }
+
+  BranchInst::Create(join, br);
+  br->eraseFromParent();
+  for (BasicBlock *arm : {thenBB, elseBB})
+    if (arm != join)
+      arm->eraseFromParent();
+}
+
+bool klee::IfConversionPass::runOnFunction(Function &f) {
+  bool changed = false;
+  // a sweep converts the innermost of nested diamonds, the next one the
+  // diamonds around them
+  for (bool again = true; again;) {
+    again = false;
+    std::vector<BasicBlock *> blocks;
+    for (BasicBlock &bb : f)
+      blocks.push_back(&bb);
+    SmallPtrSet<BasicBlock *, 16> erased;
+    for (BasicBlock *bb : blocks) {
+      if (erased.count(bb))
+        continue;
+      BranchInst *br = dyn_cast<BranchInst>(bb->getTerminator());
+      if (!br || !br->isConditional())
+        continue;
+      BasicBlock *thenBB = br->getSuccessor(0);
+      BasicBlock *elseBB = br->getSuccessor(1);
+      if (thenBB == elseBB || thenBB == bb || elseBB == bb)
+        continue;
+
+      // a triangle with one of the successors as the join, or a diamond
+      BasicBlock *join = nullptr;
+      if (canHoist(elseBB, bb, thenBB))
+        join = thenBB;
+      else if (canHoist(thenBB, bb, elseBB))
+        join = elseBB;
+      else if (BasicBlock *succ = thenBB->getSingleSuccessor())
+        if (succ != bb && canHoist(thenBB, bb, succ) &&
+            canHoist(elseBB, bb, succ))
+          join = succ;
+      if (!join)
+        continue;
+
+      for (BasicBlock *arm : {thenBB, elseBB})
+        if (arm != join)
+          erased.insert(arm);
+      convert(bb, thenBB, elseBB, join);
+      // so that a diamond around this one has single block arms
+      if (join->getSinglePredecessor() == bb &&
+          MergeBlockIntoPredecessor(join))
+        erased.insert(join);
+      changed = again = true;
+    }
+  }
+  return changed;
+}
@@ -26,9 +26,12 @@
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
-#include <map>
 #include <string>
+#include <thread>
+#include <unordered_map>
 
 using namespace klee;
 
@@ -47,10 +50,19 @@ public:
   }
 };
 
-static std::map<uintptr_t, uint64_t>
+static size_t countInstructions(const llvm::Module &m) {
+  size_t count = 0;
+  for (const auto &Func : m)
+    for (const auto &BB : Func)
+      count += BB.size();
+  return count;
+}
+
+static std::unordered_map<uintptr_t, uint64_t>
 buildInstructionToLineMap(const llvm::Module &m) {
 
-  std::map<uintptr_t, uint64_t> mapping;
+  std::unordered_map<uintptr_t, uint64_t> mapping;
+  mapping.reserve(countInstructions(m) + m.size());
   InstructionToLineAnnotator a;
   std::string str;
 
@@ -89,101 +101,147 @@ static std::string getFullPath(llvm::StringRef Directory,
   return file_pathname.str();
 }
 
-class DebugInfoExtractor {
-  std::vector<std::unique_ptr<std::string>> &internedStrings;
-  std::map<uintptr_t, uint64_t> lineTable;
+namespace {
+/// The debug location of an instruction before its file is interned. The
+/// file refers to the string of the debug metadata.
+struct InstructionLocation {
+  llvm::StringRef file;
+  unsigned line;
+  unsigned column;
+  bool known;
+};
 
-  const llvm::Module &module;
+/// The debug locations of a function and of its instructions.
+struct FunctionLocations {
+  std::string file;
+  unsigned line = 0;
+  std::vector<InstructionLocation> instructions;
+};
+} // namespace
 
-public:
-  DebugInfoExtractor(
-      std::vector<std::unique_ptr<std::string>> &_internedStrings,
-      const llvm::Module &_module)
-      : internedStrings(_internedStrings), module(_module) {
-    lineTable = buildInstructionToLineMap(module);
+/// Collect the debug locations of a function. This only reads the debug
+/// metadata, so it may run for several functions at once.
+static void extractLocations(const llvm::Function &Func,
+                             FunctionLocations &result) {
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 9)
+  auto dsub = Func.getSubprogram();
+#else
+  auto dsub = llvm::getDISubprogram(&Func);
+#endif
+  if (dsub != nullptr) {
+    result.file = getFullPath(dsub->getDirectory(), dsub->getFilename());
+    result.line = dsub->getLine();
   }
 
+  for (auto it = llvm::inst_begin(Func), ie = llvm::inst_end(Func); it != ie;
+       ++it) {
+    // Retrieve debug information associated with instruction, without copying
+    // the location as that would track it
+    const llvm::DILocation *dl = it->getDebugLoc().get();
+    if (dl == nullptr) {
+      result.instructions.push_back({llvm::StringRef(), 0, 0, false});
+      continue;
+    }
+
+    unsigned line = dl->getLine();
+    unsigned column = dl->getColumn();
+    // Still, if the line is unknown, take the context of the instruction to
+    // narrow it down
+    if (line == 0) {
+      if (auto LexicalBlock =
+              llvm::dyn_cast<llvm::DILexicalBlock>(dl->getScope())) {
+        line = LexicalBlock->getLine();
+        column = LexicalBlock->getColumn();
+      }
+    }
+    result.instructions.push_back({dl->getFilename(), line, column, true});
+  }
+}
+
+namespace {
+class StringInterner {
+  std::vector<std::unique_ptr<std::string>> &internedStrings;
+  std::unordered_map<std::string, std::string *> internedIndex;
+  /// The interned strings by the data of the debug metadata strings, which
+  /// are unique per module, so that each file name is only hashed once.
+  std::unordered_map<const char *, std::string *> metadataIndex;
+
+public:
+  explicit StringInterner(
+      std::vector<std::unique_ptr<std::string>> &_internedStrings)
+      : internedStrings(_internedStrings) {}
+
   std::string &getInternedString(const std::string &s) {
-    auto found = std::find_if(internedStrings.begin(), internedStrings.end(),
-                              [&s](const std::unique_ptr<std::string> &item) {
-                                return *item.get() == s;
-                              });
-    if (found != internedStrings.end())
-      return *found->get();
+    auto found = internedIndex.find(s);
+    if (found != internedIndex.end())
+      return *found->second;
 
     auto newItem = std::unique_ptr<std::string>(new std::string(s));
     auto result = newItem.get();
 
     internedStrings.emplace_back(std::move(newItem));
+    internedIndex.insert(std::make_pair(s, result));
     return *result;
   }
 
-  std::unique_ptr<FunctionInfo> getFunctionInfo(const llvm::Function &Func) {
-    auto asmLine = lineTable.at(reinterpret_cast<std::uintptr_t>(&Func));
-#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 9)
-    auto dsub = Func.getSubprogram();
-#else
-    auto dsub = llvm::getDISubprogram(&Func);
-#endif
-    if (dsub != nullptr) {
-      auto path = getFullPath(dsub->getDirectory(), dsub->getFilename());
-      return std::unique_ptr<FunctionInfo>(new FunctionInfo(
-          0, getInternedString(path), dsub->getLine(), asmLine));
-    }
+  std::string &getInternedMetadataString(llvm::StringRef s) {
+    auto found = metadataIndex.find(s.data());
+    if (found != metadataIndex.end())
+      return *found->second;
 
-    // Fallback: Mark as unknown
-    return std::unique_ptr<FunctionInfo>(
-        new FunctionInfo(0, getInternedString(""), 0, asmLine));
-  }
-
-  std::unique_ptr<InstructionInfo>
-  getInstructionInfo(const llvm::Instruction &Inst, const FunctionInfo *f) {
-    auto asmLine = lineTable.at(reinterpret_cast<std::uintptr_t>(&Inst));
-
-    // Retrieve debug information associated with instruction
-    auto dl = Inst.getDebugLoc();
-
-    // Check if a valid debug location is assigned to the instruction.
-    if (dl.get() != nullptr) {
-      auto full_path = dl.get()->getFilename();
-      auto line = dl.getLine();
-      auto column = dl.getCol();
-
-      // Still, if the line is unknown, take the context of the instruction to
-      // narrow it down
-      if (line == 0) {
-        if (auto LexicalBlock =
-                llvm::dyn_cast<llvm::DILexicalBlock>(dl.getScope())) {
-          line = LexicalBlock->getLine();
-          column = LexicalBlock->getColumn();
-        }
-      }
-      return std::unique_ptr<InstructionInfo>(new InstructionInfo(
-          0, getInternedString(full_path), line, column, asmLine));
-    }
-
-    if (f != nullptr)
-      // If nothing found, use the surrounding function
-      return std::unique_ptr<InstructionInfo>(
-          new InstructionInfo(0, f->file, f->line, 0, asmLine));
-    // If nothing found, use the surrounding function
-    return std::unique_ptr<InstructionInfo>(
-        new InstructionInfo(0, getInternedString(""), 0, 0, asmLine));
+    std::string &result = getInternedString(s.str());
+    metadataIndex.insert(std::make_pair(s.data(), &result));
+    return result;
   }
 };
+} // namespace
+
+InstructionInfoTable::InstructionInfoTable(const llvm::Module &m) : module(m) {
+  std::vector<const llvm::Function *> functions;
+  functions.reserve(m.size());
+  for (const auto &Func : m)
+    functions.push_back(&Func);
+
+  // Extract the debug locations of the functions in parallel
+  std::vector<FunctionLocations> locations(functions.size());
+  std::atomic<size_t> next(0);
+  auto extract = [&]() {
+    for (size_t i; (i = next++) < functions.size();)
+      extractLocations(*functions[i], locations[i]);
+  };
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min<size_t>(threads, functions.size() / 64 + 1);
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < threads; ++i)
+    workers.emplace_back(extract);
+  extract();
+  for (auto &worker : workers)
+    worker.join();
 
-InstructionInfoTable::InstructionInfoTable(const llvm::Module &m) {
   // Generate all debug instruction information
-  DebugInfoExtractor DI(internedStrings, m);
-  for (const auto &Func : m) {
-    auto F = DI.getFunctionInfo(Func);
+  StringInterner interner(internedStrings);
+  infos.reserve(countInstructions(m));
+  functionInfos.reserve(m.size());
+  for (size_t i = 0; i != functions.size(); ++i) {
+    const llvm::Function &Func = *functions[i];
+    const FunctionLocations &fl = locations[i];
+    auto F = std::unique_ptr<FunctionInfo>(new FunctionInfo(
+        0, interner.getInternedString(fl.file), fl.line, 0));
     auto FR = F.get();
     functionInfos.insert(std::make_pair(&Func, std::move(F)));
 
+    auto loc = fl.instructions.begin();
     for (auto it = llvm::inst_begin(Func), ie = llvm::inst_end(Func); it != ie;
-         ++it) {
-      auto instr = &*it;
-      infos.insert(std::make_pair(instr, DI.getInstructionInfo(*instr, FR)));
+         ++it, ++loc) {
+      // If nothing found, use the surrounding function
+      auto info =
+          loc->known
+              ? new InstructionInfo(
+                    0, interner.getInternedMetadataString(loc->file),
+                    loc->line, loc->column, 0)
+              : new InstructionInfo(0, FR->file, FR->line, 0, 0);
+      infos.insert(
+          std::make_pair(&*it, std::unique_ptr<InstructionInfo>(info)));
     }
   }
 
@@ -195,6 +253,18 @@ InstructionInfoTable::InstructionInfoTable(const llvm::Module &m) {
     item.second->id = idCounter++;
 }
 
+void InstructionInfoTable::computeAssemblyLines() const {
+  std::call_once(assemblyLinesComputed, [this]() {
+    auto lineTable = buildInstructionToLineMap(module);
+    for (auto &item : infos)
+      item.second->assemblyLine =
+          lineTable.at(reinterpret_cast<std::uintptr_t>(item.first));
+    for (auto &item : functionInfos)
+      item.second->assemblyLine =
+          lineTable.at(reinterpret_cast<std::uintptr_t>(item.first));
+  });
+}
+
 unsigned InstructionInfoTable::getMaxID() const {
   return infos.size() + functionInfos.size();
 }
@@ -36,12 +36,24 @@ bool checkOperandTypeIsScalarInt(const Instruction *i, unsigned opNum) {
   return true;
 }
 
-bool checkOperandTypeIsScalarIntOrPointer(const Instruction *i,
-                                          unsigned opNum) {
+// Integer vectors are left by the Scalarizer where the Executor executes
+// them lane by lane (see -native-vectors).
+bool checkOperandTypeIsIntOrIntVector(const Instruction *i, unsigned opNum) {
   assert(opNum < i->getNumOperands());
   llvm::Type *ty = i->getOperand(opNum)->getType();
-  if (!(ty->isIntegerTy() || ty->isPointerTy())) {
-    printOperandWarning("scalar integer or pointer", i, ty, opNum);
+  if (!(ty->isIntOrIntVectorTy())) {
+    printOperandWarning("integer or integer vector", i, ty, opNum);
+    return false;
+  }
+  return true;
+}
+
+bool checkOperandTypeIsIntOrIntVectorOrPointer(const Instruction *i,
+                                               unsigned opNum) {
+  assert(opNum < i->getNumOperands());
+  llvm::Type *ty = i->getOperand(opNum)->getType();
+  if (!(ty->isIntOrIntVectorTy() || ty->isPointerTy())) {
+    printOperandWarning("integer, integer vector or pointer", i, ty, opNum);
     return false;
   }
   return true;
@@ -94,7 +106,7 @@ bool checkInstruction(const Instruction *i) {
     // scalarizer pass might not remove these. This could be selecting which
     // vector operand to feed to another instruction. The Executor can handle
     // this so case so this is not a problem
-    return checkOperandTypeIsScalarInt(i, 0) &
+    return checkOperandTypeIsIntOrIntVector(i, 0) &
            checkOperandsHaveSameType(i, 1, 2);
   }
   // Integer arithmetic, logical and shifting
@@ -111,18 +123,20 @@ bool checkInstruction(const Instruction *i) {
   case Instruction::Shl:
   case Instruction::LShr:
   case Instruction::AShr: {
-    return checkOperandTypeIsScalarInt(i, 0) &
-           checkOperandTypeIsScalarInt(i, 1);
+    return checkOperandTypeIsIntOrIntVector(i, 0) &
+           checkOperandTypeIsIntOrIntVector(i, 1);
   }
   // Integer comparison
   case Instruction::ICmp: {
-    return checkOperandTypeIsScalarIntOrPointer(i, 0) &
-           checkOperandTypeIsScalarIntOrPointer(i, 1);
+    return checkOperandTypeIsIntOrIntVectorOrPointer(i, 0) &
+           checkOperandTypeIsIntOrIntVectorOrPointer(i, 1);
   }
   // Integer Conversion
   case Instruction::Trunc:
   case Instruction::ZExt:
-  case Instruction::SExt:
+  case Instruction::SExt: {
+    return checkOperandTypeIsIntOrIntVector(i, 0);
+  }
   case Instruction::IntToPtr: {
     return checkOperandTypeIsScalarInt(i, 0);
   }
@@ -119,72 +119,62 @@ bool IntrinsicCleanerPass::runOnBasicBlock(BasicBlock &b, Module &M) {
         Value *op2 = ii->getArgOperand(1);
 
         Value *result = 0;
-        Value *result_ext = 0;
         Value *overflow = 0;
 
         unsigned int bw = op1->getType()->getPrimitiveSizeInBits();
         unsigned int bw2 = op1->getType()->getPrimitiveSizeInBits() * 2;
 
-        if ((ii->getIntrinsicID() == Intrinsic::uadd_with_overflow) ||
-            (ii->getIntrinsicID() == Intrinsic::usub_with_overflow) ||
-            (ii->getIntrinsicID() == Intrinsic::umul_with_overflow)) {
-
-          Value *op1ext =
-              builder.CreateZExt(op1, IntegerType::get(M.getContext(), bw2));
-          Value *op2ext =
-              builder.CreateZExt(op2, IntegerType::get(M.getContext(), bw2));
-          Value *int_max_s =
-              ConstantInt::get(op1->getType(), APInt::getMaxValue(bw));
-          Value *int_max = builder.CreateZExt(
-              int_max_s, IntegerType::get(M.getContext(), bw2));
-
-          if (ii->getIntrinsicID() == Intrinsic::uadd_with_overflow) {
-            result_ext = builder.CreateAdd(op1ext, op2ext);
-          } else if (ii->getIntrinsicID() == Intrinsic::usub_with_overflow) {
-            result_ext = builder.CreateSub(op1ext, op2ext);
-          } else if (ii->getIntrinsicID() == Intrinsic::umul_with_overflow) {
-            result_ext = builder.CreateMul(op1ext, op2ext);
-          }
-          overflow = builder.CreateICmpUGT(result_ext, int_max);
-
-        } else if ((ii->getIntrinsicID() == Intrinsic::sadd_with_overflow) ||
-                   (ii->getIntrinsicID() == Intrinsic::ssub_with_overflow) ||
-                   (ii->getIntrinsicID() == Intrinsic::smul_with_overflow)) {
-
-          Value *op1ext =
-              builder.CreateSExt(op1, IntegerType::get(M.getContext(), bw2));
-          Value *op2ext =
-              builder.CreateSExt(op2, IntegerType::get(M.getContext(), bw2));
-          Value *int_max_s =
-              ConstantInt::get(op1->getType(), APInt::getSignedMaxValue(bw));
-          Value *int_min_s =
-              ConstantInt::get(op1->getType(), APInt::getSignedMinValue(bw));
-          Value *int_max = builder.CreateSExt(
-              int_max_s, IntegerType::get(M.getContext(), bw2));
-          Value *int_min = builder.CreateSExt(
-              int_min_s, IntegerType::get(M.getContext(), bw2));
-
-          if (ii->getIntrinsicID() == Intrinsic::sadd_with_overflow) {
-            result_ext = builder.CreateAdd(op1ext, op2ext);
-          } else if (ii->getIntrinsicID() == Intrinsic::ssub_with_overflow) {
-            result_ext = builder.CreateSub(op1ext, op2ext);
-          } else if (ii->getIntrinsicID() == Intrinsic::smul_with_overflow) {
-            result_ext = builder.CreateMul(op1ext, op2ext);
-          }
-          overflow =
-              builder.CreateOr(builder.CreateICmpSGT(result_ext, int_max),
-                               builder.CreateICmpSLT(result_ext, int_min));
+        // Additions and subtractions are checked in their own width, from
+        // the carry or the sign bits, which the solver handles much better
+        // than arithmetic in twice the width. Concrete operands fold to a
+        // constant flag either way.
+        switch (ii->getIntrinsicID()) {
+        case Intrinsic::uadd_with_overflow:
+          result = builder.CreateAdd(op1, op2);
+          overflow = builder.CreateICmpULT(result, op1);
+          break;
+        case Intrinsic::usub_with_overflow:
+          result = builder.CreateSub(op1, op2);
+          overflow = builder.CreateICmpULT(op1, op2);
+          break;
+        case Intrinsic::sadd_with_overflow:
+          // the operands have the same sign and the result another one
+          result = builder.CreateAdd(op1, op2);
+          overflow = builder.CreateICmpSLT(
+              builder.CreateAnd(builder.CreateXor(op1, result),
+                                builder.CreateXor(op2, result)),
+              ConstantInt::get(op1->getType(), 0));
+          break;
+        case Intrinsic::ssub_with_overflow:
+          // the operands have different signs and the result that of op2
+          result = builder.CreateSub(op1, op2);
+          overflow = builder.CreateICmpSLT(
+              builder.CreateAnd(builder.CreateXor(op1, op2),
+                                builder.CreateXor(op1, result)),
+              ConstantInt::get(op1->getType(), 0));
+          break;
+        default: {
+          // Multiplications overflow iff the upper half of the product in
+          // twice the width is not the extension of the lower half
+          IntegerType *wide = IntegerType::get(M.getContext(), bw2);
+          bool isSigned =
+              ii->getIntrinsicID() == Intrinsic::smul_with_overflow;
+          Value *product =
+              isSigned ? builder.CreateMul(builder.CreateSExt(op1, wide),
+                                           builder.CreateSExt(op2, wide))
+                       : builder.CreateMul(builder.CreateZExt(op1, wide),
+                                           builder.CreateZExt(op2, wide));
+          result = builder.CreateTrunc(product, op1->getType());
+          Value *high = builder.CreateTrunc(builder.CreateLShr(product, bw),
+                                            op1->getType());
+          Value *extension =
+              isSigned ? builder.CreateAShr(result, bw - 1)
+                       : ConstantInt::get(op1->getType(), 0);
+          overflow = builder.CreateICmpNE(high, extension);
+          break;
+        }
         }
 
-        // This trunc cound be replaced by a more general trunc replacement
-        // that allows to detect also undefined behavior in assignments or
-        // overflow in operation with integers whose dimension is smaller than
-        // int's dimension, e.g.
-        //     uint8_t = uint8_t + uint8_t;
-        // if one desires the wrapping should write
-        //     uint8_t = (uint8_t + uint8_t) & 0xFF;
-        // before this, must check if it has side effects on other operations
-        result = builder.CreateTrunc(result_ext, op1->getType());
         Value *resultStruct = builder.CreateInsertValue(
             UndefValue::get(ii->getType()), result, 0);
         resultStruct = builder.CreateInsertValue(resultStruct, overflow, 1);
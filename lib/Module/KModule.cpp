@@ -7,8 +7,6 @@
 //
 //===----------------------------------------------------------------------===//
 
-#define DEBUG_TYPE "KModule"
-
 #include "Passes.h"
 
 #include "klee/Config/Version.h"
@@ -18,10 +16,13 @@
 #include "klee/Internal/Module/KModule.h"
 #include "klee/Internal/Support/Debug.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/FileHandling.h"
 #include "klee/Internal/Support/ModuleUtil.h"
 #include "klee/Interpreter.h"
 #include "klee/OptionCategories.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/LoopInfo.h"
 #if LLVM_VERSION_CODE >= LLVM_VERSION(4, 0)
 #include "llvm/Bitcode/BitcodeWriter.h"
 #else
@@ -29,8 +30,11 @@
 #endif
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
@@ -38,6 +42,8 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/raw_os_ostream.h"
@@ -52,6 +58,8 @@
 
 #include <sstream>
 
+#define DEBUG_TYPE "KModule"
+
 using namespace llvm;
 using namespace klee;
 
@@ -92,6 +100,23 @@ namespace {
              cl::init(eSwitchTypeInternal),
 	     cl::cat(ModuleCat));
   
+  cl::opt<unsigned>
+  IfConvert("if-convert",
+            cl::desc("Replace the branches around blocks of up to this many "
+                     "instructions that only compute values by selects, so "
+                     "that symbolic conditions do not fork there.  Set to 0 "
+                     "to disable (default=0)"),
+            cl::init(0),
+            cl::cat(ModuleCat));
+
+  cl::opt<bool>
+  NativeVectors("native-vectors",
+                cl::desc("Execute integer vector arithmetic, comparisons, "
+                         "selects, casts and shuffles lane by lane rather "
+                         "than scalarizing the functions using only those "
+                         "vector instructions (default=true)"),
+                cl::init(true), cl::cat(ModuleCat));
+
   cl::opt<bool>
   DebugPrintEscapingFunctions("debug-print-escaping-functions", 
                               cl::desc("Print functions whose address is taken (default=false)"),
@@ -108,6 +133,22 @@ namespace {
                              cl::desc("Allow optimization of functions that "
                                       "contain KLEE calls (default=true)"),
                              cl::init(true), cl::cat(ModuleCat));
+
+  cl::opt<std::string>
+  PreparedModuleCache("prepared-module-cache",
+                      cl::desc("Directory in which to cache the linked, "
+                               "instrumented and optimised module, keyed by "
+                               "the input bitcode and module options.  Clear "
+                               "it after changing optimisation pass options "
+                               "(default=off)"),
+                      cl::init(""), cl::cat(ModuleCat));
+
+  cl::opt<bool>
+  PruneUnreachable("prune-unreachable",
+                   cl::desc("Remove functions and globals that cannot be "
+                            "reached from the entry point before execution "
+                            "(default=true)"),
+                   cl::init(true), cl::cat(ModuleCat));
 }
 
 /***/
@@ -199,6 +240,98 @@ injectStaticConstructorsAndDestructors(Module *m,
   }
 }
 
+static void collectReferencedGlobals(const Constant *c,
+                                     SmallPtrSetImpl<const Constant *> &seen,
+                                     std::vector<GlobalValue *> &worklist) {
+  if (!seen.insert(c).second)
+    return;
+  if (auto gv = dyn_cast<GlobalValue>(c)) {
+    worklist.push_back(const_cast<GlobalValue *>(gv));
+    return;
+  }
+  if (auto ba = dyn_cast<BlockAddress>(c)) {
+    worklist.push_back(ba->getFunction());
+    return;
+  }
+  for (const auto &op : c->operands())
+    if (auto oc = dyn_cast<Constant>(op))
+      collectReferencedGlobals(oc, seen, worklist);
+}
+
+/// Remove every function and global variable that is not transitively
+/// referenced from the given roots.  Address-taken functions stay alive
+/// through the constants that take their address, so everything that may
+/// end up in the functions segment is kept.
+static void pruneUnreachableGlobals(Module *m,
+                                    llvm::ArrayRef<const char *> roots) {
+  SmallPtrSet<const Constant *, 32> seen;
+  std::vector<GlobalValue *> worklist;
+
+  for (const char *name : roots)
+    if (GlobalValue *gv = m->getNamedValue(name))
+      collectReferencedGlobals(gv, seen, worklist);
+  // llvm.used, ctor/dtor lists and aliases are kept as they are
+  for (auto &gv : m->globals())
+    if (gv.getName().startswith("llvm."))
+      collectReferencedGlobals(&gv, seen, worklist);
+  for (auto &ga : m->aliases())
+    collectReferencedGlobals(&ga, seen, worklist);
+
+  while (!worklist.empty()) {
+    GlobalValue *gv = worklist.back();
+    worklist.pop_back();
+
+    if (auto f = dyn_cast<Function>(gv)) {
+      for (auto &inst : instructions(*f))
+        for (const auto &op : inst.operands())
+          if (auto c = dyn_cast<Constant>(op))
+            collectReferencedGlobals(c, seen, worklist);
+    } else if (auto var = dyn_cast<GlobalVariable>(gv)) {
+      if (var->hasInitializer())
+        collectReferencedGlobals(var->getInitializer(), seen, worklist);
+    } else if (auto ga = dyn_cast<GlobalAlias>(gv)) {
+      collectReferencedGlobals(ga->getAliasee(), seen, worklist);
+    }
+  }
+
+  std::vector<Function *> deadFunctions;
+  for (auto &f : *m)
+    if (!seen.count(&f))
+      deadFunctions.push_back(&f);
+  std::vector<GlobalVariable *> deadGlobals;
+  for (auto &gv : m->globals())
+    if (!seen.count(&gv))
+      deadGlobals.push_back(&gv);
+
+  // Dead code may refer to other dead code, so drop all bodies and
+  // initializers first and only then erase what no longer has users
+  for (auto f : deadFunctions)
+    f->deleteBody();
+  for (auto gv : deadGlobals)
+    if (gv->hasInitializer())
+      gv->setInitializer(nullptr);
+
+  unsigned numFunctions = 0, numGlobals = 0;
+  for (auto f : deadFunctions) {
+    f->removeDeadConstantUsers();
+    if (f->use_empty()) {
+      f->eraseFromParent();
+      ++numFunctions;
+    }
+  }
+  for (auto gv : deadGlobals) {
+    gv->removeDeadConstantUsers();
+    if (gv->use_empty()) {
+      gv->eraseFromParent();
+      ++numGlobals;
+    }
+  }
+
+  if (numFunctions || numGlobals)
+    klee_message("Pruned %u unreachable functions and %u unused globals",
+                 numFunctions, numGlobals);
+}
+
 void KModule::addInternalFunction(const char* functionName){
   Function* internalFunction = module->getFunction(functionName);
   if (!internalFunction) {
@@ -210,6 +343,15 @@ void KModule::addInternalFunction(const char* functionName){
   internalFunctions.insert(internalFunction);
 }
 
+void KModule::addInternalFunctions(const Interpreter::ModuleOptions &opts) {
+  // Add internal functions which are not used to check if instructions
+  // have been already visited
+  if (opts.CheckDivZero)
+    addInternalFunction("klee_div_zero_check");
+  if (opts.CheckOvershift)
+    addInternalFunction("klee_overshift_check");
+}
+
 bool KModule::link(std::vector<std::unique_ptr<llvm::Module>> &modules,
                    const std::string &entryPoint) {
   auto numRemainingModules = modules.size();
@@ -227,22 +369,99 @@ bool KModule::link(std::vector<std::unique_ptr<llvm::Module>> &modules,
   return modules.size() != numRemainingModules;
 }
 
+/// Whether the Executor executes each vector instruction of \a f as it is,
+/// so that \a f needs not be scalarized.
+static bool
+hasOnlyNativeVectorInstructions(const Function &f,
+                                const Interpreter::ModuleOptions &opts) {
+  for (const Instruction &i : instructions(f)) {
+    bool vector = i.getType()->isVectorTy();
+    for (const Use &op : i.operands())
+      vector |= op->getType()->isVectorTy();
+    if (!vector)
+      continue;
+
+    switch (i.getOpcode()) {
+    case Instruction::Add:
+    case Instruction::Sub:
+    case Instruction::Mul:
+    case Instruction::And:
+    case Instruction::Or:
+    case Instruction::Xor:
+    case Instruction::Trunc:
+    case Instruction::ZExt:
+    case Instruction::SExt:
+    case Instruction::ICmp:
+      // lane by lane on integers only, pointers are compared in the
+      // address space
+      if (!i.getOperand(0)->getType()->isIntOrIntVectorTy())
+        return false;
+      break;
+    // the checks are inserted for scalar operands only
+    case Instruction::UDiv:
+    case Instruction::SDiv:
+    case Instruction::URem:
+    case Instruction::SRem:
+      if (opts.CheckDivZero)
+        return false;
+      break;
+    case Instruction::Shl:
+    case Instruction::LShr:
+    case Instruction::AShr:
+      if (opts.CheckOvershift)
+        return false;
+      break;
+    case Instruction::Call:
+      if (isa<IntrinsicInst>(i))
+        return false;
+      break;
+    case Instruction::Select:
+    case Instruction::ExtractElement:
+    case Instruction::InsertElement:
+    case Instruction::ShuffleVector:
+    case Instruction::BitCast:
+    case Instruction::Load:
+    case Instruction::Store:
+    case Instruction::PHI:
+    case Instruction::Ret:
+    case Instruction::ExtractValue:
+    case Instruction::InsertValue:
+      break;
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
 void KModule::instrument(const Interpreter::ModuleOptions &opts) {
   // Inject checks prior to optimization... we also perform the
   // invariant transformations that we will end up doing later so that
   // optimize is seeing what is as close as possible to the final
   // module.
-  legacy::PassManager pm;
-  pm.add(new RaiseAsmPass());
+  legacy::PassManager raisePM;
+  raisePM.add(new RaiseAsmPass());
+  raisePM.run(*module);
 
   // This pass will scalarize as much code as possible so that the Executor
   // does not need to handle operands of vector type for most instructions
-  // other than InsertElementInst and ExtractElementInst.
+  // other than InsertElementInst and ExtractElementInst. With
+  // -native-vectors, the functions whose vector instructions the Executor
+  // executes lane by lane are left alone, sparing it the scalar
+  // instructions and the element traffic between them.
   //
   // NOTE: Must come before division/overshift checks because those passes
   // don't know how to handle vector instructions.
-  pm.add(createScalarizerPass());
+  legacy::FunctionPassManager scalarizer(module.get());
+  scalarizer.add(createScalarizerPass());
+  scalarizer.doInitialization();
+  for (Function &f : *module)
+    if (!f.isDeclaration() &&
+        !(NativeVectors && hasOnlyNativeVectorInstructions(f, opts)))
+      scalarizer.run(f);
+  scalarizer.doFinalization();
 
+  legacy::PassManager pm;
   // This pass will replace atomic instructions with non-atomic operations
   pm.add(createLowerAtomicPass());
   if (opts.CheckDivZero) pm.add(new DivCheckPass());
@@ -252,6 +471,94 @@ void KModule::instrument(const Interpreter::ModuleOptions &opts) {
   pm.run(*module);
 }
 
+std::string KModule::getPreparedModulePath(
+    const std::vector<std::unique_ptr<llvm::Module>> &modules,
+    const Interpreter::ModuleOptions &opts) {
+  if (PreparedModuleCache.empty())
+    return "";
+
+  // Everything that influences the prepared module goes into the key; the
+  // inputs are hashed in their serialized form so that identical bitcode
+  // maps to the same entry regardless of where it was loaded from.
+  MD5 hash;
+  for (const auto &m : modules) {
+    SmallString<0> buffer;
+    raw_svector_ostream os(buffer);
+#if LLVM_VERSION_CODE >= LLVM_VERSION(7, 0)
+    WriteBitcodeToFile(*m, os);
+#else
+    WriteBitcodeToFile(m.get(), os);
+#endif
+    hash.update(buffer.str());
+  }
+  std::string config;
+  raw_string_ostream cs(config);
+  cs << LLVM_VERSION_CODE << ':' << opts.EntryPoint << ':' << opts.Optimize
+     << opts.CheckDivZero << opts.CheckOvershift << ':' << (int)SwitchType
+     << OptimiseKLEECall << PruneUnreachable << NativeVectors;
+  for (const auto &entry : opts.ExtraEntryPoints)
+    cs << ':' << entry;
+  hash.update(cs.str());
+
+  MD5::MD5Result result;
+  hash.final(result);
+  SmallString<32> digest;
+  MD5::stringifyResult(result, digest);
+
+  SmallString<128> path(PreparedModuleCache);
+  sys::path::append(path, digest.str() + ".bc");
+  return path.str().str();
+}
+
+bool KModule::loadPrepared(const std::string &path, LLVMContext &context,
+                           const Interpreter::ModuleOptions &opts) {
+  if (!sys::fs::exists(path))
+    return false;
+
+  std::vector<std::unique_ptr<llvm::Module>> loaded;
+  std::string error;
+  if (!klee::loadFile(path, context, loaded, error) || loaded.size() != 1) {
+    klee_warning("Ignoring unreadable prepared module %s: %s", path.c_str(),
+                 error.c_str());
+    return false;
+  }
+
+  module = std::move(loaded.front());
+  targetData = std::unique_ptr<llvm::DataLayout>(new DataLayout(module.get()));
+  addInternalFunctions(opts);
+  klee_message("Using prepared module %s", path.c_str());
+  return true;
+}
+
+void KModule::storePrepared(const std::string &path) {
+  if (auto ec = sys::fs::create_directories(PreparedModuleCache)) {
+    klee_warning("Unable to create prepared module cache %s: %s",
+                 PreparedModuleCache.c_str(), ec.message().c_str());
+    return;
+  }
+
+  // Write to a temporary first so that concurrent runs never observe a
+  // partially written module.
+  std::string tmpPath = path + ".tmp";
+  std::string error;
+  {
+    auto f = klee_open_output_file(tmpPath, error);
+    if (!f) {
+      klee_warning("Unable to write prepared module %s: %s", tmpPath.c_str(),
+                   error.c_str());
+      return;
+    }
+#if LLVM_VERSION_CODE >= LLVM_VERSION(7, 0)
+    WriteBitcodeToFile(*module, *f);
+#else
+    WriteBitcodeToFile(module.get(), *f);
+#endif
+  }
+  if (auto ec = sys::fs::rename(tmpPath, path))
+    klee_warning("Unable to store prepared module %s: %s", path.c_str(),
+                 ec.message().c_str());
+}
+
 void KModule::optimiseAndPrepare(
     const Interpreter::ModuleOptions &opts,
     llvm::ArrayRef<const char *> preservedFunctions) {
@@ -266,16 +573,11 @@ void KModule::optimiseAndPrepare(
   if (opts.Optimize)
     Optimize(module.get(), preservedFunctions);
 
-  // Add internal functions which are not used to check if instructions
-  // have been already visited
-  if (opts.CheckDivZero)
-    addInternalFunction("klee_div_zero_check");
-  if (opts.CheckOvershift)
-    addInternalFunction("klee_overshift_check");
-
   // Needs to happen after linking (since ctors/dtors can be modified)
   // and optimization (since global optimization can rewrite lists).
   injectStaticConstructorsAndDestructors(module.get(), opts.EntryPoint);
+  for (const auto &entry : opts.ExtraEntryPoints)
+    injectStaticConstructorsAndDestructors(module.get(), entry);
 
   // Finally, run the passes that maintain invariants we expect during
   // interpretation. We run the intrinsic cleaner just in case we
@@ -284,6 +586,8 @@ void KModule::optimiseAndPrepare(
   // directly I think?
   legacy::PassManager pm3;
   pm3.add(createCFGSimplificationPass());
+  if (IfConvert)
+    pm3.add(new IfConversionPass(IfConvert));
   switch(SwitchType) {
   case eSwitchTypeInternal: break;
   case eSwitchTypeSimple: pm3.add(new LowerSwitchPass()); break;
@@ -294,6 +598,12 @@ void KModule::optimiseAndPrepare(
   pm3.add(new PhiCleanerPass());
   pm3.add(new FunctionAliasPass());
   pm3.run(*module);
+
+  // Only prune once all passes that may introduce or redirect calls ran
+  if (PruneUnreachable)
+    pruneUnreachableGlobals(module.get(), preservedFunctions);
+
+  addInternalFunctions(opts);
 }
 
 void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput) {
@@ -318,6 +628,7 @@ void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput) {
       new InstructionInfoTable(*module.get()));
 
   std::vector<Function *> declarations;
+  functionMap.reserve(module->size());
 
   for (auto &Function : *module) {
     if (Function.isDeclaration()) {
@@ -406,7 +717,7 @@ KConstant::KConstant(llvm::Constant* _ct, unsigned _id, KInstruction* _ki) {
 /***/
 
 static int getOperandNum(Value *v,
-                         std::map<Instruction*, unsigned> &registerMap,
+                         std::unordered_map<Instruction*, unsigned> &registerMap,
                          KModule *km,
                          KInstruction *ki) {
   if (Instruction *inst = dyn_cast<Instruction>(v)) {
@@ -429,6 +740,8 @@ KFunction::KFunction(llvm::Function *_function,
     numArgs(function->arg_size()),
     numInstructions(0),
     trackCoverage(true) {
+  basicBlockEntry.reserve(function->size());
+
   // Assign unique instruction IDs to each basic block
   for (auto &BasicBlock : *function) {
     basicBlockEntry[&BasicBlock] = numInstructions;
@@ -437,7 +750,9 @@ KFunction::KFunction(llvm::Function *_function,
 
   instructions = new KInstruction*[numInstructions];
 
-  std::map<Instruction*, unsigned> registerMap;
+  std::unordered_map<Instruction*, unsigned> registerMap;
+  registerMap.reserve(numInstructions);
+  instructionsMap.reserve(numInstructions);
 
   // The first arg_size() registers are reserved for formals.
   unsigned rnum = numArgs;
@@ -468,6 +783,14 @@ KFunction::KFunction(llvm::Function *_function,
       Instruction *inst = &*it;
       ki->inst = inst;
       ki->dest = registerMap[inst];
+      ki->opcode = inst->getOpcode();
+      ki->predicate = 0;
+      if (CmpInst *ci = dyn_cast<CmpInst>(inst))
+        ki->predicate = ci->getPredicate();
+      // set by Executor::bindInstructionConstants
+      ki->width = 0;
+      ki->lanes = 0;
+      ki->callee = nullptr;
       instructionsMap[inst] = ki;
 
       if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
@@ -500,6 +823,14 @@ KFunction::~KFunction() {
   delete[] instructions;
 }
 
+const llvm::LoopInfo &KFunction::getLoopInfo() {
+  if (!loopInfo) {
+    llvm::DominatorTree dt(*function);
+    loopInfo.reset(new llvm::LoopInfo(dt));
+  }
+  return *loopInfo;
+}
+
 KInstruction *KModule::getKInstruction(llvm::Instruction *I) const {
     auto it = functionMap.find(I->getParent()->getParent());
     assert(it != functionMap.end());
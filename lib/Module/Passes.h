@@ -92,6 +92,27 @@ public:
   bool runOnFunction(llvm::Function &f) override;
 };
 
+/// IfConversionPass - Replace the branches around small blocks that only
+/// compute values, diamonds and triangles, by selects of the values, so
+/// that a symbolic condition gives a select expression instead of a fork.
+/// The blocks hoisted may have at most a given number of instructions,
+/// none of which may access memory or trap.
+class IfConversionPass : public llvm::FunctionPass {
+  static char ID;
+  unsigned maxInstructions;
+
+  bool canHoist(llvm::BasicBlock *arm, llvm::BasicBlock *pred,
+                llvm::BasicBlock *join) const;
+  void convert(llvm::BasicBlock *bb, llvm::BasicBlock *thenBB,
+               llvm::BasicBlock *elseBB, llvm::BasicBlock *join);
+
+public:
+  explicit IfConversionPass(unsigned maxInstructions)
+      : llvm::FunctionPass(ID), maxInstructions(maxInstructions) {}
+
+  bool runOnFunction(llvm::Function &f) override;
+};
+
 class DivCheckPass : public llvm::ModulePass {
   static char ID;
 
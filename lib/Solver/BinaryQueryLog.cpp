@@ -0,0 +1,153 @@
+//===-- BinaryQueryLog.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/BinaryQueryLog.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstring>
+
+using namespace klee;
+
+namespace {
+const char FileMagic[8] = {'K', 'L', 'E', 'E', 'Q', 'L', '0', '1'};
+
+// Each record starts with one of these; 0 is read at the end of the file.
+enum RecordTag { QueryTag = 1, ClearTag = 2 };
+
+/// The number of entries of the tables above which they are cleared.
+const size_t MaxDefinitions = 1 << 20;
+}
+
+const char *LoggedQuery::getKindName(Kind kind) {
+  switch (kind) {
+  case Truth:
+    return "Truth";
+  case Validity:
+    return "Validity";
+  case Value:
+    return "Value";
+  case InitialValues:
+    return "InitialValues";
+  }
+  return "Unknown";
+}
+
+/***/
+
+BinaryQueryLogWriter::BinaryQueryLogWriter(llvm::raw_ostream &os)
+    : os(os), writer(buffer, /*defineArrays=*/true) {
+  os.write(FileMagic, sizeof(FileMagic));
+}
+
+void BinaryQueryLogWriter::write(const LoggedQuery &query) {
+  if (writer.getNumDefinitions() > MaxDefinitions) {
+    writer.clear();
+    writer.writeInt(ClearTag);
+  }
+
+  writer.writeInt(QueryTag);
+  writer.writeInt(query.kind);
+  writer.writeInt(query.constraints.size());
+  for (const ref<Expr> &constraint : query.constraints)
+    writer.write(constraint);
+  writer.write(query.expr);
+  writer.writeInt(query.objects.size());
+  for (const Array *array : query.objects)
+    writer.write(array);
+
+  writer.writeInt(query.success);
+  writer.writeInt(query.elapsed.toMicroseconds());
+  if (query.success) {
+    switch (query.kind) {
+    case LoggedQuery::Validity:
+      // -1, 0 or 1
+      writer.writeInt(query.result + 1);
+      break;
+    case LoggedQuery::Value:
+      writer.write(query.value);
+      break;
+    case LoggedQuery::Truth:
+    case LoggedQuery::InitialValues:
+      writer.writeInt(query.result);
+      break;
+    }
+    if (query.kind == LoggedQuery::InitialValues && query.result) {
+      for (const auto &bytes : query.values) {
+        writer.writeInt(bytes.size());
+        writer.writeBytes(bytes.data(), bytes.size());
+      }
+    }
+  }
+
+  const std::string &data = buffer.str();
+  os.write(data.data(), data.size());
+  os.flush();
+  buffer.str("");
+}
+
+/***/
+
+BinaryQueryLogReader::BinaryQueryLogReader(std::istream &is,
+                                           ArrayCache &arrayCache)
+    : is(is), reader(is, &arrayCache) {
+  char magic[sizeof(FileMagic)];
+  is.read(magic, sizeof(magic));
+  valid = is && hasHeader(magic, sizeof(magic));
+}
+
+bool BinaryQueryLogReader::hasHeader(const char *data, size_t size) {
+  return size >= sizeof(FileMagic) &&
+         !memcmp(data, FileMagic, sizeof(FileMagic));
+}
+
+bool BinaryQueryLogReader::read(LoggedQuery &query) {
+  if (!valid)
+    return false;
+
+  uint64_t tag = reader.readInt();
+  for (; tag == ClearTag; tag = reader.readInt())
+    reader.clear();
+  if (tag != QueryTag || !is)
+    return false;
+
+  query = LoggedQuery();
+  query.kind = static_cast<LoggedQuery::Kind>(reader.readInt());
+  for (uint64_t n = reader.readInt(); n != 0 && is; --n)
+    query.constraints.push_back(reader.readExpr());
+  query.expr = reader.readExpr();
+  for (uint64_t n = reader.readInt(); n != 0 && is; --n)
+    query.objects.push_back(reader.readArray());
+
+  query.success = reader.readInt();
+  query.elapsed = time::microseconds(reader.readInt());
+  if (query.success) {
+    switch (query.kind) {
+    case LoggedQuery::Validity:
+      query.result = static_cast<int>(reader.readInt()) - 1;
+      break;
+    case LoggedQuery::Value:
+      query.value = reader.readExpr();
+      break;
+    case LoggedQuery::Truth:
+    case LoggedQuery::InitialValues:
+      query.result = reader.readInt();
+      break;
+    }
+    if (query.kind == LoggedQuery::InitialValues && query.result) {
+      for (size_t i = 0; i != query.objects.size() && is; ++i) {
+        std::vector<unsigned char> bytes(reader.readInt());
+        reader.readBytes(bytes.data(), bytes.size());
+        query.values.push_back(std::move(bytes));
+      }
+    }
+  }
+  // false for a record cut short by the end of the file
+  return static_cast<bool>(is);
+}
@@ -0,0 +1,165 @@
+//===-- BinaryQueryLoggingSolver.cpp --------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/FileHandling.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/Solver/BinaryQueryLog.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+using namespace klee;
+
+namespace {
+/// Log queries with their results to a binary query log, which kleaver
+/// reads back much faster than a .kquery file.
+///
+/// Unlike the text logs, a query is written only once it has been
+/// answered, with the answer; which queries are kept follows the same
+/// settings.
+class BinaryQueryLoggingSolver : public SolverImpl {
+  Solver *solver;
+  std::unique_ptr<llvm::raw_ostream> os;
+  std::unique_ptr<BinaryQueryLogWriter> writer;
+  time::Span minQueryTimeToLog;
+  bool logTimedOutQueries;
+
+  void startQuery(LoggedQuery &logged, LoggedQuery::Kind kind,
+                  const Query &query);
+  void finishQuery(LoggedQuery &logged, bool success, time::Point start);
+
+public:
+  BinaryQueryLoggingSolver(Solver *solver, std::string path,
+                           time::Span minQueryTimeToLog, bool logTimedOut);
+  ~BinaryQueryLoggingSolver() { delete solver; }
+
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+}
+
+BinaryQueryLoggingSolver::BinaryQueryLoggingSolver(Solver *solver,
+                                                   std::string path,
+                                                   time::Span minQueryTimeToLog,
+                                                   bool logTimedOut)
+    : solver(solver), minQueryTimeToLog(minQueryTimeToLog),
+      logTimedOutQueries(logTimedOut) {
+  std::string error;
+  os = klee_open_output_file(path, error);
+  if (!os)
+    klee_error("Could not open file %s : %s", path.c_str(), error.c_str());
+  writer.reset(new BinaryQueryLogWriter(*os));
+}
+
+void BinaryQueryLoggingSolver::startQuery(LoggedQuery &logged,
+                                          LoggedQuery::Kind kind,
+                                          const Query &query) {
+  logged.kind = kind;
+  logged.constraints.assign(query.constraints.begin(), query.constraints.end());
+  logged.expr = query.expr;
+}
+
+void BinaryQueryLoggingSolver::finishQuery(LoggedQuery &logged, bool success,
+                                           time::Point start) {
+  logged.success = success;
+  logged.elapsed = time::getWallTime() - start;
+
+  // the same choice as QueryLoggingSolver::flushBuffer
+  if (minQueryTimeToLog && logged.elapsed <= minQueryTimeToLog &&
+      !(logTimedOutQueries && SOLVER_RUN_STATUS_TIMEOUT ==
+                                  solver->impl->getOperationStatusCode()))
+    return;
+  writer->write(logged);
+}
+
+bool BinaryQueryLoggingSolver::computeTruth(const Query &query,
+                                            bool &isValid) {
+  LoggedQuery logged;
+  startQuery(logged, LoggedQuery::Truth, query);
+  time::Point start = time::getWallTime();
+  bool success = solver->impl->computeTruth(query, isValid);
+  logged.result = success && isValid;
+  finishQuery(logged, success, start);
+  return success;
+}
+
+bool BinaryQueryLoggingSolver::computeValidity(const Query &query,
+                                               Solver::Validity &result) {
+  LoggedQuery logged;
+  startQuery(logged, LoggedQuery::Validity, query);
+  time::Point start = time::getWallTime();
+  bool success = solver->impl->computeValidity(query, result);
+  logged.result = success ? result : 0;
+  finishQuery(logged, success, start);
+  return success;
+}
+
+bool BinaryQueryLoggingSolver::computeValue(const Query &query,
+                                            ref<Expr> &result) {
+  LoggedQuery logged;
+  startQuery(logged, LoggedQuery::Value, query);
+  time::Point start = time::getWallTime();
+  bool success = solver->impl->computeValue(query, result);
+  if (success)
+    logged.value = result;
+  finishQuery(logged, success, start);
+  return success;
+}
+
+bool BinaryQueryLoggingSolver::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  LoggedQuery logged;
+  startQuery(logged, LoggedQuery::InitialValues, query);
+  findSymbolicObjects(query.constraints.begin(), query.constraints.end(),
+                      logged.objects);
+  findSymbolicObjects(query.expr, logged.objects);
+  time::Point start = time::getWallTime();
+  bool success =
+      solver->impl->computeInitialValues(query, result, hasSolution);
+  if (success) {
+    logged.result = hasSolution;
+    if (hasSolution) {
+      for (const Array *array : logged.objects) {
+        std::vector<unsigned char> bytes(array->size);
+        for (unsigned i = 0; i != array->size; ++i)
+          bytes[i] = result->getValue(array, i);
+        logged.values.push_back(std::move(bytes));
+      }
+    }
+  }
+  finishQuery(logged, success, start);
+  return success;
+}
+
+Solver *klee::createBinaryQueryLoggingSolver(Solver *solver, std::string path,
+                                             time::Span minQueryTimeToLog,
+                                             bool logTimedOut) {
+  return new Solver(new BinaryQueryLoggingSolver(solver, path,
+                                                 minQueryTimeToLog,
+                                                 logTimedOut));
+}
@@ -10,9 +10,13 @@
 
 #include "klee/Solver/Solver.h"
 
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/ArrayCanonicalizer.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Solver/IncompleteSolver.h"
+#include "klee/Solver/PersistentQueryCache.h"
+#include "klee/Solver/SolverCmdLine.h"
 #include "klee/Solver/SolverImpl.h"
 #include "klee/Solver/SolverStats.h"
 
@@ -55,25 +59,25 @@ private:
 
   struct CacheEntryHash {
     unsigned operator()(const CacheEntry &ce) const {
-      unsigned result = ce.query->hash();
-
-      for (auto const &constraint : ce.constraints) {
-        result ^= constraint->hash();
-      }
-
-      return result;
+      return ce.query->hash() ^ ce.constraints.hash();
     }
   };
 
   typedef unordered_map<CacheEntry, 
                         IncompleteSolver::PartialValidity, 
                         CacheEntryHash> cache_map;
+
+  CacheEntry getCacheEntry(const Query &query, bool &negationUsed);
   
   Solver *solver;
+  /// The arrays of the renamed queries, if -canonicalize-cache-arrays.
+  ArrayCache canonicalArrays;
   cache_map cache;
+  /// Results shared with other runs, if enabled.
+  std::unique_ptr<PersistentQueryCache> persistent;
 
 public:
-  CachingSolver(Solver *s) : solver(s) {}
+  CachingSolver(Solver *s) : solver(s), persistent(PersistentQueryCache::open()) {}
   ~CachingSolver() { cache.clear(); delete solver; }
 
   bool computeValidity(const Query&, Solver::Validity &result);
@@ -110,14 +114,29 @@ ref<Expr> CachingSolver::canonicalizeQuery(ref<Expr> originalQuery,
   }
 }
 
+/// @returns the cache entry for the given query, with its arrays renamed
+/// by first occurrence if enabled.
+CachingSolver::CacheEntry CachingSolver::getCacheEntry(const Query &query,
+                                                       bool &negationUsed) {
+  if (!CanonicalizeCacheArrays)
+    return CacheEntry(query.constraints,
+                      canonicalizeQuery(query.expr, negationUsed));
+
+  ArrayCanonicalizer canonicalizer(canonicalArrays);
+  std::vector<ref<Expr> > constraints;
+  for (const auto &constraint : query.constraints)
+    constraints.push_back(canonicalizer.visit(constraint));
+  ref<Expr> expr = canonicalizer.visit(query.expr);
+  return CacheEntry(ConstraintManager(constraints),
+                    canonicalizeQuery(expr, negationUsed));
+}
+
 /** @returns true on a cache hit, false of a cache miss.  Reference
     value result only valid on a cache hit. */
 bool CachingSolver::cacheLookup(const Query& query,
                                 IncompleteSolver::PartialValidity &result) {
   bool negationUsed;
-  ref<Expr> canonicalQuery = canonicalizeQuery(query.expr, negationUsed);
-
-  CacheEntry ce(query.constraints, canonicalQuery);
+  CacheEntry ce = getCacheEntry(query, negationUsed);
   cache_map::iterator it = cache.find(ce);
   
   if (it != cache.end()) {
@@ -126,7 +145,26 @@ bool CachingSolver::cacheLookup(const Query& query,
               it->second);
     return true;
   }
-  
+
+  if (persistent) {
+    PersistentQueryCache::Key key(
+        'V', std::vector<ref<Expr> >(ce.constraints.begin(),
+                                     ce.constraints.end()),
+        ce.query);
+    std::string value;
+    if (persistent->lookup(key, value) && value.size() == 1) {
+      IncompleteSolver::PartialValidity cachedResult =
+          static_cast<IncompleteSolver::PartialValidity>(
+              static_cast<signed char>(value[0]));
+      ++stats::queryPersistentCacheHits;
+      cache.insert(std::make_pair(ce, cachedResult));
+      result = (negationUsed ?
+                IncompleteSolver::negatePartialValidity(cachedResult) :
+                cachedResult);
+      return true;
+    }
+  }
+
   return false;
 }
 
@@ -134,13 +172,19 @@ bool CachingSolver::cacheLookup(const Query& query,
 void CachingSolver::cacheInsert(const Query& query,
                                 IncompleteSolver::PartialValidity result) {
   bool negationUsed;
-  ref<Expr> canonicalQuery = canonicalizeQuery(query.expr, negationUsed);
-
-  CacheEntry ce(query.constraints, canonicalQuery);
+  CacheEntry ce = getCacheEntry(query, negationUsed);
   IncompleteSolver::PartialValidity cachedResult = 
     (negationUsed ? IncompleteSolver::negatePartialValidity(result) : result);
   
   cache.insert(std::make_pair(ce, cachedResult));
+
+  if (persistent) {
+    PersistentQueryCache::Key key(
+        'V', std::vector<ref<Expr> >(ce.constraints.begin(),
+                                     ce.constraints.end()),
+        ce.query);
+    persistent->insert(key, std::string(1, static_cast<char>(cachedResult)));
+  }
 }
 
 bool CachingSolver::computeValidity(const Query& query,
@@ -9,21 +9,26 @@
 
 #include "klee/Solver/Solver.h"
 
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/ArrayCanonicalizer.h"
 #include "klee/Expr/Assignment.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprBatchEvaluator.h"
+#include "klee/Expr/ExprHashMap.h"
 #include "klee/Expr/ExprUtil.h"
 #include "klee/Expr/ExprVisitor.h"
-#include "klee/Internal/ADT/MapOfSets.h"
+#include "klee/Internal/ADT/SetIndex.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/OptionCategories.h"
+#include "klee/Solver/PersistentQueryCache.h"
+#include "klee/Solver/SolverCmdLine.h"
 #include "klee/Solver/SolverImpl.h"
 #include "klee/Solver/SolverStats.h"
 #include "klee/TimerStatIncrementer.h"
 #include "klee/Expr/Assignment.h"
 #include "klee/Expr/ExprUtil.h"
 #include "klee/Expr/ExprVisitor.h"
-#include "klee/Internal/ADT/MapOfSets.h"
 
 #include "klee/Solver/SolverStats.h"
 
@@ -31,6 +36,9 @@
 
 #include "llvm/Support/CommandLine.h"
 
+#include <algorithm>
+#include <deque>
+
 using namespace klee;
 using namespace llvm;
 
@@ -53,6 +61,19 @@ cl::opt<bool>
                               "before asking the SMT solver (default=false)"),
                      cl::cat(SolvingCat));
 
+cl::opt<unsigned> CexCacheMaxEntries(
+    "cex-cache-max-entries", cl::init(100000),
+    cl::desc("Maximum number of constraint sets in the counterexample cache, "
+             "least recently used ones are dropped first; 0 for no limit "
+             "(default=100000)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> CexCacheRecent(
+    "cex-cache-recent", cl::init(8),
+    cl::desc("Number of most recent counterexamples tried on a query before "
+             "searching the counterexample cache (default=8)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool> CexCacheExperimental(
     "cex-cache-exp", cl::init(false),
     cl::desc("Optimization for validity queries (default=false)"),
@@ -69,28 +90,47 @@ class CexCachingSolver : public SolverImpl {
           assignmentsTable_ty;
 
   Solver *solver;
-  
-  MapOfSets<ref<Expr>, std::shared_ptr<const Assignment>> cache;
+
+  /// The arrays of the renamed queries, if -canonicalize-cache-arrays.
+  ArrayCache canonicalArrays;
+  SetIndex<ref<Expr>, std::shared_ptr<const Assignment>, util::ExprHash> cache;
   // memo table
   assignmentsTable_ty assignmentsTable;
+  // the assignments that solved a query last, most recent first
+  std::deque<std::shared_ptr<const Assignment> > recentAssignments;
+  /// Results shared with other runs, if enabled.
+  std::unique_ptr<PersistentQueryCache> persistent;
+
+  void addRecentAssignment(const std::shared_ptr<const Assignment> &a);
+
+  void memoize(KeyType &key, const std::shared_ptr<const Assignment> &result);
 
   bool searchForAssignment(KeyType &key, 
                            std::shared_ptr<const Assignment> &result);
   
   bool lookupAssignment(const Query& query, KeyType &key,
+                        ArrayCanonicalizer *canonicalizer,
                         std::shared_ptr<const Assignment> &result);
 
   bool lookupAssignment(const Query& query,
                         std::shared_ptr<const Assignment> &result) {
     KeyType key;
-    return lookupAssignment(query, key, result);
+    std::unique_ptr<ArrayCanonicalizer> canonicalizer(getCanonicalizer());
+    return lookupAssignment(query, key, canonicalizer.get(), result);
+  }
+
+  ArrayCanonicalizer *getCanonicalizer() {
+    return CanonicalizeCacheArrays ? new ArrayCanonicalizer(canonicalArrays)
+                                   : 0;
   }
 
   bool getAssignment(const Query& query,
                      std::shared_ptr<const Assignment> &result);
   
 public:
-  CexCachingSolver(Solver *_solver) : solver(_solver) {}
+  CexCachingSolver(Solver *_solver)
+      : solver(_solver), cache(CexCacheMaxEntries),
+        persistent(PersistentQueryCache::open()) {}
   ~CexCachingSolver();
   
   bool computeTruth(const Query&, bool &isValid);
@@ -124,6 +164,20 @@ struct NullOrSatisfyingAssignment {
   }
 };
 
+/// addRecentAssignment - Move \arg a to the front of the assignments tried
+/// first on the next queries.
+void CexCachingSolver::addRecentAssignment(
+    const std::shared_ptr<const Assignment> &a) {
+  if (!CexCacheRecent)
+    return;
+  auto it = std::find(recentAssignments.begin(), recentAssignments.end(), a);
+  if (it != recentAssignments.end())
+    recentAssignments.erase(it);
+  else if (recentAssignments.size() == CexCacheRecent)
+    recentAssignments.pop_back();
+  recentAssignments.push_front(a);
+}
+
 /// searchForAssignment - Look for a cached solution for a query.
 ///
 /// \param key - The query to look up.
@@ -139,6 +193,22 @@ bool CexCachingSolver::searchForAssignment(KeyType &key,
     return true;
   }
 
+  // Candidate assignments are checked all at once against the compiled
+  // query rather than by walking the query for each of them.
+  ExprBatchEvaluator evaluator(std::vector<ref<Expr> >(key.begin(), key.end()));
+  std::vector<const Assignment *> candidates;
+
+  // Consecutive queries tend to come from the same path, so one of the
+  // last solutions often satisfies the query without any search.
+  for (const auto &a : recentAssignments)
+    candidates.push_back(a.get());
+  int found = evaluator.findSatisfying(candidates);
+  if (found != -1) {
+    result = recentAssignments[found];
+    addRecentAssignment(result);
+    return true;
+  }
+
   if (CexCacheTryAll) {
     // Look for a satisfying assignment for a superset, which is trivially an
     // assignment for any subset.
@@ -153,18 +223,23 @@ bool CexCachingSolver::searchForAssignment(KeyType &key,
     // If either lookup succeeded, then we have a cached solution.
     if (lookup) {
       result = *lookup;
+      if (result)
+        addRecentAssignment(result);
       return true;
     }
 
     // Otherwise, iterate through the set of current assignments to see if one
     // of them satisfies the query.
-    for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
-           ie = assignmentsTable.end(); it != ie; ++it) {
-      std::shared_ptr<const Assignment> a = *it;
-      if (a->satisfies(key.begin(), key.end())) {
-        result = a;
-        return true;
-      }
+    std::vector<std::shared_ptr<const Assignment> > table(
+        assignmentsTable.begin(), assignmentsTable.end());
+    candidates.clear();
+    for (const auto &a : table)
+      candidates.push_back(a.get());
+    found = evaluator.findSatisfying(candidates);
+    if (found != -1) {
+      result = table[found];
+      addRecentAssignment(result);
+      return true;
     }
   } else {
     // FIXME: Which order? one is sure to be better.
@@ -186,6 +261,8 @@ bool CexCachingSolver::searchForAssignment(KeyType &key,
     // If either lookup succeeded, then we have a cached solution.
     if (lookup) {
       result = *lookup;
+      if (result)
+        addRecentAssignment(result);
       return true;
     }
   }
@@ -197,14 +274,18 @@ bool CexCachingSolver::searchForAssignment(KeyType &key,
 ///
 /// \param query - The query to lookup.
 /// \param key [out] - On return, the key constructed for the query.
+/// \param canonicalizer - If not null, renames the arrays of the key.
 /// \param result [out] - The cached result, if the lookup is succesful. This is
 /// either a satisfying assignment (for a satisfiable query), or 0 (for an
 /// unsatisfiable query).
 /// \return True if a cached result was found.
 bool CexCachingSolver::lookupAssignment(const Query &query, 
                                         KeyType &key,
+                                        ArrayCanonicalizer *canonicalizer,
                                         std::shared_ptr<const Assignment> &result) {
-  key = KeyType(query.constraints.begin(), query.constraints.end());
+  key.clear();
+  for (const auto &constraint : query.constraints)
+    key.insert(canonicalizer ? canonicalizer->visit(constraint) : constraint);
   ref<Expr> neg = Expr::createIsZero(query.expr);
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(neg)) {
     if (CE->isFalse()) {
@@ -213,10 +294,12 @@ bool CexCachingSolver::lookupAssignment(const Query &query,
       return true;
     }
   } else {
-    key.insert(neg);
+    key.insert(canonicalizer ? canonicalizer->visit(neg) : neg);
   }
 
   bool found = searchForAssignment(key, result);
+  if (found && canonicalizer && result)
+    result = canonicalizer->toOriginal(*result);
   if (found)
     ++stats::queryCexCacheHits;
   else ++stats::queryCexCacheMisses;
@@ -224,26 +307,58 @@ bool CexCachingSolver::lookupAssignment(const Query &query,
   return found;
 }
 
+/// memoize - Remember \arg result (null if unsatisfiable) for \arg key.
+void CexCachingSolver::memoize(KeyType &key,
+                               const std::shared_ptr<const Assignment> &result) {
+  if (result) {
+    assignmentsTable.insert(result);
+    addRecentAssignment(result);
+  }
+
+  // Every memoized assignment belongs to the one set it was computed for.
+  std::shared_ptr<const Assignment> evicted;
+  if (cache.insert(key, result, &evicted) && evicted)
+    assignmentsTable.erase(evicted);
+}
+
 bool CexCachingSolver::getAssignment(const Query& query,
                                      std::shared_ptr<const Assignment> &result) {
   KeyType key;
-  if (lookupAssignment(query, key, result))
+  std::unique_ptr<ArrayCanonicalizer> canonicalizer(getCanonicalizer());
+  if (lookupAssignment(query, key, canonicalizer.get(), result))
     return true;
 
+  std::unique_ptr<PersistentQueryCache::Key> persistentKey;
+  if (persistent) {
+    persistentKey.reset(new PersistentQueryCache::Key(
+        'C', std::vector<ref<Expr> >(key.begin(), key.end())));
+    std::string value;
+    if (persistent->lookup(*persistentKey, value) &&
+        PersistentQueryCache::decodeAssignment(*persistentKey, value,
+                                               result)) {
+      ++stats::queryPersistentCacheHits;
+      memoize(key, result);
+      if (canonicalizer && result)
+        result = canonicalizer->toOriginal(*result);
+      return true;
+    }
+  }
+
   bool hasSolution;
   if (!solver->impl->computeInitialValues(query, result,
                                           hasSolution))
     return false;
 
-    
-  if (hasSolution) {
-    // Memoize the result.
-    assignmentsTable.insert(result);
-  } else {
+  if (!hasSolution)
     result = 0;
-  }
-  
-  cache.insert(key, result);
+  // the cache only holds assignments for the arrays of its keys
+  std::shared_ptr<const Assignment> memoized =
+      canonicalizer && result ? canonicalizer->toCanonical(*result) : result;
+  memoize(key, memoized);
+
+  if (persistent)
+    persistent->insert(*persistentKey, PersistentQueryCache::encodeAssignment(
+                                           *persistentKey, memoized.get()));
 
   return true;
 }
@@ -24,54 +24,100 @@ Solver *constructSolverChain(Solver *coreSolver,
                              std::string querySMT2LogPath,
                              std::string baseSolverQuerySMT2LogPath,
                              std::string queryKQueryLogPath,
-                             std::string baseSolverQueryKQueryLogPath) {
+                             std::string baseSolverQueryKQueryLogPath,
+                             std::string queryBinaryLogPath,
+                             std::string baseSolverQueryBinaryLogPath) {
   Solver *solver = coreSolver;
   const time::Span minQueryTimeToLog(MinQueryTimeToLog);
 
+  // with -profile-solver-chain, the queries of each layer are accounted to it
+  if (ProfileSolverChain)
+    solver = createProfilingSolver(solver, CoreSolverLayer);
+  auto addLayer = [&solver](Solver *layerSolver, SolverLayer layer) {
+    if (ProfileSolverChain && layerSolver != solver)
+      layerSolver = createProfilingSolver(layerSolver, layer);
+    solver = layerSolver;
+  };
+
+  if (UseUnsatCoreCache)
+    addLayer(createUnsatCoreCachingSolver(solver), UnsatCoreCacheLayer);
+
   if (QueryLoggingOptions.isSet(SOLVER_KQUERY)) {
-    solver = createKQueryLoggingSolver(solver, baseSolverQueryKQueryLogPath, minQueryTimeToLog, LogTimedOutQueries);
+    addLayer(createKQueryLoggingSolver(solver, baseSolverQueryKQueryLogPath, minQueryTimeToLog, LogTimedOutQueries),
+             SolverQueryLoggingLayer);
     klee_message("Logging queries that reach solver in .kquery format to %s\n",
                  baseSolverQueryKQueryLogPath.c_str());
   }
 
   if (QueryLoggingOptions.isSet(SOLVER_SMTLIB)) {
-    solver = createSMTLIBLoggingSolver(solver, baseSolverQuerySMT2LogPath, minQueryTimeToLog, LogTimedOutQueries);
+    addLayer(createSMTLIBLoggingSolver(solver, baseSolverQuerySMT2LogPath, minQueryTimeToLog, LogTimedOutQueries),
+             SolverQueryLoggingLayer);
     klee_message("Logging queries that reach solver in .smt2 format to %s\n",
                  baseSolverQuerySMT2LogPath.c_str());
   }
 
+  if (QueryLoggingOptions.isSet(SOLVER_BINARY)) {
+    addLayer(createBinaryQueryLoggingSolver(solver, baseSolverQueryBinaryLogPath,
+                                            minQueryTimeToLog,
+                                            LogTimedOutQueries),
+             SolverQueryLoggingLayer);
+    klee_message("Logging queries that reach solver in .kqb format to %s\n",
+                 baseSolverQueryBinaryLogPath.c_str());
+  }
+
   if (UseAssignmentValidatingSolver)
-    solver = createAssignmentValidatingSolver(solver);
+    addLayer(createAssignmentValidatingSolver(solver),
+             AssignmentValidatingLayer);
 
   if (UseFastCexSolver)
-    solver = createFastCexSolver(solver);
+    addLayer(createFastCexSolver(solver), FastCexLayer);
 
   if (UseCexCache)
-    solver = createCexCachingSolver(solver);
+    addLayer(createCexCachingSolver(solver), CexCacheLayer);
 
   if (UseBranchCache)
-    solver = createCachingSolver(solver);
+    addLayer(createCachingSolver(solver), BranchCacheLayer);
+
+  if (PreprocessingRewrites.getBits())
+    addLayer(createPreprocessingSolver(solver, PreprocessingRewrites.getBits()),
+             PreprocessingLayer);
 
   if (UseIndependentSolver)
-    solver = createIndependentSolver(solver);
+    addLayer(createIndependentSolver(solver), IndependentLayer);
 
   if (DebugValidateSolver)
-    solver = createValidatingSolver(solver, coreSolver);
+    addLayer(createValidatingSolver(solver, coreSolver,
+                                    DebugValidateSolverRate,
+                                    DebugValidateSolverCachedOnly,
+                                    DebugValidateSolverJobs),
+             ValidatingLayer);
 
   if (QueryLoggingOptions.isSet(ALL_KQUERY)) {
-    solver = createKQueryLoggingSolver(solver, queryKQueryLogPath, minQueryTimeToLog, LogTimedOutQueries);
+    addLayer(createKQueryLoggingSolver(solver, queryKQueryLogPath, minQueryTimeToLog, LogTimedOutQueries),
+             QueryLoggingLayer);
     klee_message("Logging all queries in .kquery format to %s\n",
                  queryKQueryLogPath.c_str());
   }
 
   if (QueryLoggingOptions.isSet(ALL_SMTLIB)) {
-    solver = createSMTLIBLoggingSolver(solver, querySMT2LogPath, minQueryTimeToLog, LogTimedOutQueries);
+    addLayer(createSMTLIBLoggingSolver(solver, querySMT2LogPath, minQueryTimeToLog, LogTimedOutQueries),
+             QueryLoggingLayer);
     klee_message("Logging all queries in .smt2 format to %s\n",
                  querySMT2LogPath.c_str());
   }
+
+  if (QueryLoggingOptions.isSet(ALL_BINARY)) {
+    addLayer(createBinaryQueryLoggingSolver(solver, queryBinaryLogPath,
+                                            minQueryTimeToLog,
+                                            LogTimedOutQueries),
+             QueryLoggingLayer);
+    klee_message("Logging all queries in .kqb format to %s\n",
+                 queryBinaryLogPath.c_str());
+  }
   if (DebugCrossCheckCoreSolverWith != NO_SOLVER) {
     Solver *oracleSolver = createCoreSolver(DebugCrossCheckCoreSolverWith);
-    solver = createValidatingSolver(/*s=*/solver, /*oracle=*/oracleSolver);
+    addLayer(createValidatingSolver(/*s=*/solver, /*oracle=*/oracleSolver),
+             ValidatingLayer);
   }
 
   return solver;
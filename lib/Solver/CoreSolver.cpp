@@ -10,15 +10,18 @@
 #include "STPSolver.h"
 #include "Z3Solver.h"
 #include "MetaSMTSolver.h"
+#include "SMTLIBSolver.h"
 
 #include "klee/Solver/SolverCmdLine.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Solver/RemoteSolver.h"
 #include "klee/Solver/Solver.h"
 
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <string>
+#include <vector>
 
 namespace klee {
 
@@ -50,6 +53,34 @@ Solver *createCoreSolver(CoreSolverType cst) {
     klee_message("Not compiled with Z3 support");
     return NULL;
 #endif
+  case SMTLIB_SOLVER:
+    klee_message("Using SMT-LIBv2 solver backend (%s)",
+                 SMTLIBSolverCommand.c_str());
+    return new SMTLIBSolver(SMTLIBSolverCommand);
+  case PORTFOLIO_SOLVER: {
+    std::vector<Solver *> solvers;
+#ifdef ENABLE_Z3
+    solvers.push_back(new Z3Solver());
+#endif
+#ifdef ENABLE_STP
+    // forked, as that is the only way STP honours a timeout
+    solvers.push_back(new STPSolver(true, CoreSolverOptimizeDivides));
+#endif
+#ifdef ENABLE_METASMT
+    solvers.push_back(createMetaSMTSolver());
+#endif
+    if (solvers.empty()) {
+      klee_message("Not compiled with any solver backend");
+      return NULL;
+    }
+    klee_message("Using portfolio solver backend (%u backends)",
+                 static_cast<unsigned>(solvers.size()));
+    return createPortfolioSolver(solvers);
+  }
+  case REMOTE_SOLVER:
+    klee_message("Using remote solver backend (%s)",
+                 RemoteSolverAddress.c_str());
+    return new RemoteSolver(RemoteSolverAddress);
   case NO_SOLVER:
     klee_message("Invalid solver");
     return NULL;
@@ -13,393 +13,90 @@
 #include "klee/Expr/Assignment.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
-#include "klee/Expr/ExprUtil.h"
 #include "klee/Internal/Support/Debug.h"
+#include "klee/OptionCategories.h"
 #include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
 
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
-#include <list>
 #include <map>
 #include <ostream>
+#include <set>
+#include <unordered_map>
 #include <vector>
 
 using namespace klee;
 using namespace llvm;
 
-template<class T>
-class DenseSet {
-  typedef std::set<T> set_ty;
-  set_ty s;
-
-public:
-  DenseSet() {}
-
-  void add(T x) {
-    s.insert(x);
-  }
-  void add(T start, T end) {
-    for (; start<end; start++)
-      s.insert(start);
-  }
-
-  // returns true iff set is changed by addition
-  bool add(const DenseSet &b) {
-    bool modified = false;
-    for (typename set_ty::const_iterator it = b.s.begin(), ie = b.s.end(); 
-         it != ie; ++it) {
-      if (modified || !s.count(*it)) {
-        modified = true;
-        s.insert(*it);
-      }
-    }
-    return modified;
-  }
-
-  bool intersects(const DenseSet &b) {
-    for (typename set_ty::iterator it = s.begin(), ie = s.end(); 
-         it != ie; ++it)
-      if (b.s.count(*it))
-        return true;
-    return false;
-  }
-
-  std::set<unsigned>::iterator begin(){
-    return s.begin();
-  }
-
-  std::set<unsigned>::iterator end(){
-    return s.end();
-  }
-
-  void print(llvm::raw_ostream &os) const {
-    bool first = true;
-    os << "{";
-    for (typename set_ty::iterator it = s.begin(), ie = s.end(); 
-         it != ie; ++it) {
-      if (first) {
-        first = false;
-      } else {
-        os << ",";
-      }
-      os << *it;
-    }
-    os << "}";
-  }
-};
-
-template <class T>
-inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
-                                     const ::DenseSet<T> &dis) {
-  dis.print(os);
-  return os;
+namespace {
+cl::opt<unsigned> FactorCacheSize(
+    "independent-factor-cache-size",
+    cl::desc("Maximum number of independent factors whose models are "
+             "remembered, 0 to disable (default=16384)"),
+    cl::init(16384), cl::cat(SolvingCat));
 }
 
-class IndependentElementSet {
-public:
-  typedef std::map<const Array*, ::DenseSet<unsigned> > elements_ty;
-  elements_ty elements;                 // Represents individual elements of array accesses (arr[1])
-  std::set<const Array*> wholeObjects;  // Represents symbolically accessed arrays (arr[x])
-  std::vector<ref<Expr> > exprs;        // All expressions that are associated with this factor
-                                        // Although order doesn't matter, we use a vector to match
-                                        // the ConstraintManager constructor that will eventually
-                                        // be invoked.
-
-  IndependentElementSet() {}
-  IndependentElementSet(ref<Expr> e) {
-    exprs.push_back(e);
-    // Track all reads in the program.  Determines whether reads are
-    // concrete or symbolic.  If they are symbolic, "collapses" array
-    // by adding it to wholeObjects.  Otherwise, creates a mapping of
-    // the form Map<array, set<index>> which tracks which parts of the
-    // array are being accessed.
-    std::vector< ref<ReadExpr> > reads;
-    findReads(e, /* visitUpdates= */ true, reads);
-    for (unsigned i = 0; i != reads.size(); ++i) {
-      ReadExpr *re = reads[i].get();
-      const Array *array = re->updates.root;
-      
-      // Reads of a constant array don't alias.
-      if (re->updates.root->isConstantArray() &&
-          !re->updates.head)
-        continue;
-
-      if (!wholeObjects.count(array)) {
-        if (ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
-          // if index constant, then add to set of constraints operating
-          // on that array (actually, don't add constraint, just set index)
-          ::DenseSet<unsigned> &dis = elements[array];
-          dis.add((unsigned) CE->getZExtValue(32));
-        } else {
-          elements_ty::iterator it2 = elements.find(array);
-          if (it2!=elements.end())
-            elements.erase(it2);
-          wholeObjects.insert(array);
-        }
-      }
-    }
-  }
-  IndependentElementSet(const IndependentElementSet &ies) : 
-    elements(ies.elements),
-    wholeObjects(ies.wholeObjects),
-    exprs(ies.exprs) {}
-
-  IndependentElementSet &operator=(const IndependentElementSet &ies) {
-    elements = ies.elements;
-    wholeObjects = ies.wholeObjects;
-    exprs = ies.exprs;
-    return *this;
-  }
-
-  void print(llvm::raw_ostream &os) const {
-    os << "{";
-    bool first = true;
-    for (std::set<const Array*>::iterator it = wholeObjects.begin(), 
-           ie = wholeObjects.end(); it != ie; ++it) {
-      const Array *array = *it;
-
-      if (first) {
-        first = false;
-      } else {
-        os << ", ";
-      }
-
-      os << "MO" << array->name;
-    }
-    for (elements_ty::const_iterator it = elements.begin(), ie = elements.end();
-         it != ie; ++it) {
-      const Array *array = it->first;
-      const ::DenseSet<unsigned> &dis = it->second;
-
-      if (first) {
-        first = false;
-      } else {
-        os << ", ";
-      }
-
-      os << "MO" << array->name << " : " << dis;
-    }
-    os << "}";
-  }
-
-  // more efficient when this is the smaller set
-  bool intersects(const IndependentElementSet &b) {
-    // If there are any symbolic arrays in our query that b accesses
-    for (std::set<const Array*>::iterator it = wholeObjects.begin(), 
-           ie = wholeObjects.end(); it != ie; ++it) {
-      const Array *array = *it;
-      if (b.wholeObjects.count(array) || 
-          b.elements.find(array) != b.elements.end())
-        return true;
-    }
-    for (elements_ty::iterator it = elements.begin(), ie = elements.end();
-         it != ie; ++it) {
-      const Array *array = it->first;
-      // if the array we access is symbolic in b
-      if (b.wholeObjects.count(array))
-        return true;
-      elements_ty::const_iterator it2 = b.elements.find(array);
-      // if any of the elements we access are also accessed by b
-      if (it2 != b.elements.end()) {
-        if (it->second.intersects(it2->second))
-          return true;
-      }
-    }
-    return false;
-  }
-
-  // returns true iff set is changed by addition
-  bool add(const IndependentElementSet &b) {
-    for(unsigned i = 0; i < b.exprs.size(); i ++){
-      ref<Expr> expr = b.exprs[i];
-      exprs.push_back(expr);
-    }
-
-    bool modified = false;
-    for (std::set<const Array*>::const_iterator it = b.wholeObjects.begin(), 
-           ie = b.wholeObjects.end(); it != ie; ++it) {
-      const Array *array = *it;
-      elements_ty::iterator it2 = elements.find(array);
-      if (it2!=elements.end()) {
-        modified = true;
-        elements.erase(it2);
-        wholeObjects.insert(array);
-      } else {
-        if (!wholeObjects.count(array)) {
-          modified = true;
-          wholeObjects.insert(array);
-        }
-      }
-    }
-    for (elements_ty::const_iterator it = b.elements.begin(), 
-           ie = b.elements.end(); it != ie; ++it) {
-      const Array *array = it->first;
-      if (!wholeObjects.count(array)) {
-        elements_ty::iterator it2 = elements.find(array);
-        if (it2==elements.end()) {
-          modified = true;
-          elements.insert(*it);
-        } else {
-          // Now need to see if there are any (z=?)'s
-          if (it2->second.add(it->second))
-            modified = true;
-        }
-      }
-    }
-    return modified;
-  }
-};
-
-inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
-                                     const IndependentElementSet &ies) {
-  ies.print(os);
-  return os;
-}
-
-// Breaks down a constraint into all of it's individual pieces, returning a
-// list of IndependentElementSets or the independent factors.
-//
-// Caller takes ownership of returned std::list.
-static std::list<IndependentElementSet>*
-getAllIndependentConstraintsSets(const Query &query) {
-  std::list<IndependentElementSet> *factors = new std::list<IndependentElementSet>();
-  ConstantExpr *CE = dyn_cast<ConstantExpr>(query.expr);
-  if (CE) {
-    assert(CE && CE->isFalse() && "the expr should always be false and "
-                                  "therefore not included in factors");
-  } else {
-    ref<Expr> neg = Expr::createIsZero(query.expr);
-    factors->push_back(IndependentElementSet(neg));
-  }
-
-  for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                         ie = query.constraints.end();
-       it != ie; ++it) {
-    // iterate through all the previously separated constraints.  Until we
-    // actually return, factors is treated as a queue of expressions to be
-    // evaluated.  If the queue property isn't maintained, then the exprs
-    // could be returned in an order different from how they came it, negatively
-    // affecting later stages.
-    factors->push_back(IndependentElementSet(*it));
-  }
-
-  bool doneLoop = false;
-  do {
-    doneLoop = true;
-    std::list<IndependentElementSet> *done =
-        new std::list<IndependentElementSet>;
-    while (factors->size() > 0) {
-      IndependentElementSet current = factors->front();
-      factors->pop_front();
-      // This list represents the set of factors that are separate from current.
-      // Those that are not inserted into this list (queue) intersect with
-      // current.
-      std::list<IndependentElementSet> *keep =
-          new std::list<IndependentElementSet>;
-      while (factors->size() > 0) {
-        IndependentElementSet compare = factors->front();
-        factors->pop_front();
-        if (current.intersects(compare)) {
-          if (current.add(compare)) {
-            // Means that we have added (z=y)added to (x=y)
-            // Now need to see if there are any (z=?)'s
-            doneLoop = false;
-          }
-        } else {
-          keep->push_back(compare);
-        }
-      }
-      done->push_back(current);
-      delete factors;
-      factors = keep;
-    }
-    delete factors;
-    factors = done;
-  } while (!doneLoop);
-
-  return factors;
-}
-
-static 
-IndependentElementSet getIndependentConstraints(const Query& query,
-                                                std::vector< ref<Expr> > &result) {
-  IndependentElementSet eltsClosure(query.expr);
-  std::vector< std::pair<ref<Expr>, IndependentElementSet> > worklist;
-
-  for (ConstraintManager::const_iterator it = query.constraints.begin(), 
-         ie = query.constraints.end(); it != ie; ++it)
-    worklist.push_back(std::make_pair(*it, IndependentElementSet(*it)));
-
-  // XXX This should be more efficient (in terms of low level copy stuff).
-  bool done = false;
-  do {
-    done = true;
-    std::vector< std::pair<ref<Expr>, IndependentElementSet> > newWorklist;
-    for (std::vector< std::pair<ref<Expr>, IndependentElementSet> >::iterator
-           it = worklist.begin(), ie = worklist.end(); it != ie; ++it) {
-      if (it->second.intersects(eltsClosure)) {
-        if (eltsClosure.add(it->second))
-          done = false;
-        result.push_back(it->first);
-        // Means that we have added (z=y)added to (x=y)
-        // Now need to see if there are any (z=?)'s
-      } else {
-        newWorklist.push_back(*it);
-      }
-    }
-    worklist.swap(newWorklist);
-  } while (!done);
+static void getIndependentConstraints(const Query &query,
+                                      std::vector<ref<Expr> > &result) {
+  query.constraints.getIndependentConstraints(query.expr, result);
 
   KLEE_DEBUG(
     std::set< ref<Expr> > reqset(result.begin(), result.end());
     errs() << "--\n";
     errs() << "Q: " << query.expr << "\n";
-    errs() << "\telts: " << IndependentElementSet(query.expr) << "\n";
     int i = 0;
     for (ConstraintManager::const_iterator it = query.constraints.begin(),
         ie = query.constraints.end(); it != ie; ++it) {
       errs() << "C" << i++ << ": " << *it;
       errs() << " " << (reqset.count(*it) ? "(required)" : "(independent)") << "\n";
-      errs() << "\telts: " << IndependentElementSet(*it) << "\n";
     }
-    errs() << "elts closure: " << eltsClosure << "\n";
- );
-
-
-  return eltsClosure;
+  );
 }
 
-
-// Extracts which arrays are referenced from a particular independent set.  Examines both
-// the actual known array accesses arr[1] plus the undetermined accesses arr[x].
-static
-void calculateArrayReferences(const IndependentElementSet & ie,
-                              std::vector<const Array *> &returnVector){
-  std::set<const Array*> thisSeen;
-  for(std::map<const Array*, ::DenseSet<unsigned> >::const_iterator it = ie.elements.begin();
-      it != ie.elements.end(); it ++){
-    thisSeen.insert(it->first);
-  }
-  for(std::set<const Array *>::iterator it = ie.wholeObjects.begin();
-      it != ie.wholeObjects.end(); it ++){
-    thisSeen.insert(*it);
-  }
-  for(std::set<const Array *>::iterator it = thisSeen.begin(); it != thisSeen.end();
-      it ++){
-    returnVector.push_back(*it);
+// Extracts which arrays are referenced from a particular independent set,
+// together with the bytes referenced at constant indices of each. A whole
+// array (one read at a symbolic index) has no byte list.
+static void
+calculateArrayReferences(const IndependentPartitions::Partition &partition,
+                         std::map<const Array *, std::vector<unsigned> > &arrays) {
+  for (const auto &v : partition.variables) {
+    std::vector<unsigned> &indices = arrays[v.first];
+    if (v.second != IndependentPartitions::WholeArray)
+      indices.push_back(v.second);
   }
 }
 
 class IndependentSolver : public SolverImpl {
 private:
+  struct FactorHash {
+    size_t operator()(const ConstraintManager &factor) const {
+      return factor.hash();
+    }
+  };
+
   Solver *solver;
 
+  /// Models of the factors solved so far, null for an unsatisfiable one.
+  /// Test cases of related states mostly share their factors.
+  std::unordered_map<ConstraintManager, std::shared_ptr<const Assignment>,
+                     FactorHash>
+      factorModels;
+
+  bool solveFactor(const ConstraintManager &factor,
+                   std::shared_ptr<const Assignment> &result,
+                   bool &hasSolution);
+
 public:
   IndependentSolver(Solver *_solver) 
     : solver(_solver) {}
   ~IndependentSolver() { delete solver; }
 
   bool computeTruth(const Query&, bool &isValid);
+  bool computeTruths(const ConstraintManager &constraints,
+                     const std::vector<ref<Expr>> &exprs,
+                     std::vector<bool> &isValid);
   bool computeValidity(const Query&, Solver::Validity &result);
   bool computeValue(const Query&, ref<Expr> &result);
   bool computeInitialValues(const Query& query,
@@ -413,8 +110,7 @@ public:
 bool IndependentSolver::computeValidity(const Query& query,
                                         Solver::Validity &result) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure =
-    getIndependentConstraints(query, required);
+  getIndependentConstraints(query, required);
   ConstraintManager tmp(required);
   return solver->impl->computeValidity(Query(tmp, query.expr), 
                                        result);
@@ -422,17 +118,41 @@ bool IndependentSolver::computeValidity(const Query& query,
 
 bool IndependentSolver::computeTruth(const Query& query, bool &isValid) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure = 
-    getIndependentConstraints(query, required);
+  getIndependentConstraints(query, required);
   ConstraintManager tmp(required);
   return solver->impl->computeTruth(Query(tmp, query.expr), 
                                     isValid);
 }
 
+bool IndependentSolver::computeTruths(const ConstraintManager &constraints,
+                                      const std::vector<ref<Expr>> &exprs,
+                                      std::vector<bool> &isValid) {
+  // Ask the expressions that depend on the same constraints together.
+  std::map<std::vector<ref<Expr>>, std::vector<unsigned>> groups;
+  for (unsigned i = 0; i != exprs.size(); ++i) {
+    std::vector< ref<Expr> > required;
+    getIndependentConstraints(Query(constraints, exprs[i]), required);
+    groups[required].push_back(i);
+  }
+
+  isValid.assign(exprs.size(), false);
+  for (const auto &group : groups) {
+    ConstraintManager tmp(group.first);
+    std::vector<ref<Expr>> members;
+    for (unsigned i : group.second)
+      members.push_back(exprs[i]);
+    std::vector<bool> results;
+    if (!solver->impl->computeTruths(tmp, members, results))
+      return false;
+    for (unsigned i = 0; i != group.second.size(); ++i)
+      isValid[group.second[i]] = results[i];
+  }
+  return true;
+}
+
 bool IndependentSolver::computeValue(const Query& query, ref<Expr> &result) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure = 
-    getIndependentConstraints(query, required);
+  getIndependentConstraints(query, required);
   ConstraintManager tmp(required);
   return solver->impl->computeValue(Query(tmp, query.expr), result);
 }
@@ -458,6 +178,30 @@ bool assertCreatedPointEvaluatesToTrue(const Query &query,
   return cast<ConstantExpr>(q)->isTrue();
 }
 
+bool IndependentSolver::solveFactor(const ConstraintManager &factor,
+                                    std::shared_ptr<const Assignment> &result,
+                                    bool &hasSolution) {
+  auto it = factorModels.find(factor);
+  if (it != factorModels.end()) {
+    ++stats::queryFactorCacheHits;
+    result = it->second;
+    hasSolution = bool(result);
+    return true;
+  }
+
+  if (!solver->impl->computeInitialValues(
+          Query(factor, ConstantExpr::alloc(0, Expr::Bool)), result,
+          hasSolution))
+    return false;
+
+  if (FactorCacheSize) {
+    if (factorModels.size() >= FactorCacheSize)
+      factorModels.clear();
+    factorModels.emplace(factor, hasSolution ? result : nullptr);
+  }
+  return true;
+}
+
 bool IndependentSolver::computeInitialValues(const Query& query,
                                              std::shared_ptr<const Assignment> &result,
                                              bool &hasSolution){
@@ -465,44 +209,49 @@ bool IndependentSolver::computeInitialValues(const Query& query,
   // This is important in case we don't have any constraints but
   // we need initial values for requested array objects.
   hasSolution = true;
-  // FIXME: When we switch to C++11 this should be a std::unique_ptr so we don't need
-  // to remember to manually call delete
-  std::list<IndependentElementSet> *factors = getAllIndependentConstraintsSets(query);
+  // The partitions of the constraints are kept by the constraint manager;
+  // the negated query only joins a copy of them.
+  IndependentPartitions partitions =
+      query.constraints.getIndependentPartitions();
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(query.expr)) {
+    assert(CE->isFalse() && "the expr should always be false and "
+                            "therefore not included in factors");
+    (void) CE;
+  } else {
+    partitions.add(query.constraints.size(), Expr::createIsZero(query.expr));
+  }
 
   // Used to build the result
   Assignment::map_bindings_ty retMap;
-  for (std::list<IndependentElementSet>::iterator it = factors->begin();
-       it != factors->end(); ++it) {
-    std::vector<const Array*> arraysInFactor;
-    calculateArrayReferences(*it, arraysInFactor);
+  for (const auto &entry : partitions.getPartitions()) {
+    const IndependentPartitions::Partition &factor = *entry.second;
+    std::map<const Array *, std::vector<unsigned> > arraysInFactor;
+    calculateArrayReferences(factor, arraysInFactor);
     // Going to use this as the "fresh" expression for the Query() invocation below
-    assert(it->exprs.size() >= 1 && "No null/empty factors");
-    if (arraysInFactor.size() == 0){
-      continue;
-    }
-    ConstraintManager tmp(it->exprs);
+    assert(factor.constraints.size() >= 1 && "No null/empty factors");
+
+    std::vector<ref<Expr> > exprs;
+    factor.getConstraints(exprs);
+    ConstraintManager tmp(exprs);
     std::shared_ptr<const Assignment> tempAssignment;
-    if (!solver->impl->computeInitialValues(Query(tmp, ConstantExpr::alloc(0, Expr::Bool)),
-                                            tempAssignment, hasSolution)){
-      delete factors;
+    if (!solveFactor(tmp, tempAssignment, hasSolution)){
       return false;
     } else if (!hasSolution){
-      delete factors;
       return true;
     } else {
-      for (const Array *array : arraysInFactor){
-        if (retMap.count(array)){
+      for (const auto &array : arraysInFactor){
+        if (retMap.count(array.first)){
           // We already have an array with some partially correct answers,
           // so we need to place the answers to the new query into the right
           // spot while avoiding the undetermined values also in the array
-          for (unsigned index : it->elements[array]){
-            unsigned char value = tempAssignment->getValue(array, index);
-            retMap[array].add(index, value);
+          for (unsigned index : array.second){
+            unsigned char value = tempAssignment->getValue(array.first, index);
+            retMap[array.first].add(index, value);
           }
         } else {
-          auto &tempPtr = retMap[array];
+          auto &tempPtr = retMap[array.first];
           // Dump all the new values into the array
-          if (auto val = tempAssignment->getBindingsOrNull(array))
+          if (auto val = tempAssignment->getBindingsOrNull(array.first))
             tempPtr = MapArrayModel(*val);
         }
       }
@@ -510,7 +259,6 @@ bool IndependentSolver::computeInitialValues(const Query& query,
   }
   result = std::make_shared<Assignment>(retMap);
   assert(assertCreatedPointEvaluatesToTrue(query, result) && "should satisfy the equation");
-  delete factors;
 
   return true;
 }
@@ -0,0 +1,408 @@
+//===-- PersistentQueryCache.cpp ------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/PersistentQueryCache.h"
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/OptionCategories.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <numeric>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+cl::opt<std::string> PersistentQueryCacheFile(
+    "persistent-query-cache",
+    cl::desc("File keeping solver results across runs; several runs may "
+             "share it at the same time (default=none)"),
+    cl::init(""), cl::cat(SolvingCat));
+
+const char FileMagic[8] = {'K', 'L', 'E', 'E', 'Q', 'C', '0', '1'};
+const uint32_t RecordMagic = 0x51435245;
+
+struct RecordHeader {
+  uint32_t magic;
+  uint32_t keySize;
+  uint32_t valueSize;
+  uint32_t checksum;
+  uint64_t hash;
+};
+
+// FNV-1a, which unlike std::hash is the same in every process
+uint64_t fnv1a(const char *data, size_t size,
+               uint64_t h = 0xcbf29ce484222325ULL) {
+  for (size_t i = 0; i != size; ++i) {
+    h ^= static_cast<unsigned char>(data[i]);
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+uint32_t checksum(const char *key, size_t keySize, const char *value,
+                  size_t valueSize) {
+  return fnv1a(value, valueSize, fnv1a(key, keySize));
+}
+
+void writeInt(std::string &out, uint64_t value) {
+  do {
+    unsigned char byte = value & 0x7f;
+    value >>= 7;
+    out.push_back(value ? byte | 0x80 : byte);
+  } while (value);
+}
+
+bool readInt(const std::string &in, size_t &pos, uint64_t &value) {
+  value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (pos == in.size())
+      return false;
+    unsigned char byte = in[pos++];
+    value |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+/// Writes expressions with their arrays numbered by first occurrence, so
+/// that the encoding does not depend on the names of the arrays.
+class CanonicalEncoder {
+  std::string &out;
+  ExprHashMap<unsigned> exprIds;
+  std::unordered_map<const UpdateNode *, unsigned> nodeIds;
+  std::map<const Array *, unsigned> arrayIds;
+
+public:
+  std::vector<const Array *> arrays;
+
+  explicit CanonicalEncoder(std::string &out) : out(out) {}
+
+  void write(const Array *array) {
+    auto it = arrayIds.find(array);
+    if (it != arrayIds.end()) {
+      out.push_back('a');
+      writeInt(out, it->second);
+      return;
+    }
+    out.push_back('A');
+    writeInt(out, array->size);
+    writeInt(out, array->domain);
+    writeInt(out, array->range);
+    writeInt(out, array->constantValues.size());
+    for (const auto &value : array->constantValues)
+      writeInt(out, value->getZExtValue());
+    arrayIds.insert(std::make_pair(array, arrays.size()));
+    arrays.push_back(array);
+  }
+
+  void write(const UpdateList &updates) {
+    write(updates.root);
+    // the nodes not written yet, newest first
+    std::vector<const UpdateNode *> pending;
+    const UpdateNode *un = updates.head;
+    for (; un && !nodeIds.count(un); un = un->next)
+      pending.push_back(un);
+    writeInt(out, un ? nodeIds[un] + 1 : 0);
+    writeInt(out, pending.size());
+    for (auto it = pending.rbegin(), ie = pending.rend(); it != ie; ++it) {
+      write((*it)->index);
+      write((*it)->value);
+      unsigned id = nodeIds.size();
+      nodeIds[*it] = id;
+    }
+  }
+
+  void write(const ref<Expr> &e) {
+    auto it = exprIds.find(e);
+    if (it != exprIds.end()) {
+      out.push_back('r');
+      writeInt(out, it->second);
+      return;
+    }
+    out.push_back('e');
+    writeInt(out, e->getKind());
+    writeInt(out, e->getWidth());
+    switch (e->getKind()) {
+    case Expr::Constant: {
+      const llvm::APInt &value = cast<ConstantExpr>(e)->getAPValue();
+      for (unsigned i = 0, n = value.getNumWords(); i != n; ++i)
+        writeInt(out, value.getRawData()[i]);
+      break;
+    }
+    case Expr::Read: {
+      const ReadExpr *re = cast<ReadExpr>(e);
+      write(re->updates);
+      write(re->index);
+      break;
+    }
+    case Expr::Extract:
+      writeInt(out, cast<ExtractExpr>(e)->offset);
+      write(e->getKid(0));
+      break;
+    default:
+      for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+        write(e->getKid(i));
+      break;
+    }
+    unsigned id = exprIds.size();
+    exprIds.insert(std::make_pair(e, id));
+  }
+};
+} // namespace
+
+PersistentQueryCache::Key::Key(char kind, const std::vector<ref<Expr> > &exprs,
+                               const ref<Expr> &query) {
+  // Order the expressions by their own encodings, which do not depend on
+  // the order they came in. Expressions encoded alike may still number
+  // their arrays differently, costing a hit but never a wrong result.
+  std::vector<std::string> encodings(exprs.size());
+  for (unsigned i = 0; i != exprs.size(); ++i)
+    CanonicalEncoder(encodings[i]).write(exprs[i]);
+  std::vector<unsigned> order(exprs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&encodings](unsigned a, unsigned b) {
+                     return encodings[a] < encodings[b];
+                   });
+
+  bytes.push_back(kind);
+  CanonicalEncoder encoder(bytes);
+  writeInt(bytes, exprs.size());
+  for (unsigned i : order)
+    encoder.write(exprs[i]);
+  if (query.isNull()) {
+    bytes.push_back('-');
+  } else {
+    bytes.push_back('q');
+    encoder.write(query);
+  }
+  arrays = encoder.arrays;
+  hash = fnv1a(bytes.data(), bytes.size());
+}
+
+PersistentQueryCache::PersistentQueryCache(int fd)
+    : fd(fd), data(0), mappedSize(0), scanned(sizeof(FileMagic)) {}
+
+PersistentQueryCache::~PersistentQueryCache() {
+  if (data)
+    munmap(const_cast<char *>(data), mappedSize);
+  close(fd);
+}
+
+std::unique_ptr<PersistentQueryCache> PersistentQueryCache::open() {
+  if (PersistentQueryCacheFile.empty())
+    return nullptr;
+
+  const char *path = PersistentQueryCacheFile.c_str();
+  int fd = ::open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    klee_warning("Cannot open persistent query cache %s: %s", path,
+                 strerror(errno));
+    return nullptr;
+  }
+
+  // the first process to take the lock writes the header
+  flock(fd, LOCK_EX);
+  struct stat st;
+  bool valid = fstat(fd, &st) == 0;
+  if (valid && st.st_size == 0) {
+    valid = write(fd, FileMagic, sizeof(FileMagic)) == sizeof(FileMagic);
+  } else if (valid) {
+    char magic[sizeof(FileMagic)];
+    valid = pread(fd, magic, sizeof(magic), 0) == sizeof(magic) &&
+            !memcmp(magic, FileMagic, sizeof(magic));
+  }
+  flock(fd, LOCK_UN);
+
+  if (!valid) {
+    klee_warning("Ignoring persistent query cache %s: not a query cache",
+                 path);
+    close(fd);
+    return nullptr;
+  }
+  return std::unique_ptr<PersistentQueryCache>(new PersistentQueryCache(fd));
+}
+
+/// Map the records appended since the last call.
+void PersistentQueryCache::refresh() {
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+    return;
+  size_t size = st.st_size;
+
+  if (size != mappedSize) {
+    if (data)
+      munmap(const_cast<char *>(data), mappedSize);
+    data = 0;
+    mappedSize = 0;
+    // a writer cut off a record left incomplete by a crashed process
+    if (size < scanned) {
+      index.clear();
+      scanned = sizeof(FileMagic);
+    }
+    void *p = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+      return;
+    data = static_cast<const char *>(p);
+    mappedSize = size;
+  }
+
+  while (scanned + sizeof(RecordHeader) <= mappedSize) {
+    RecordHeader header;
+    memcpy(&header, data + scanned, sizeof(header));
+    size_t end = scanned + sizeof(header) + header.keySize + header.valueSize;
+    // a record still being written, or a broken one
+    if (header.magic != RecordMagic || end > mappedSize)
+      break;
+    const char *key = data + scanned + sizeof(header);
+    if (header.checksum != checksum(key, header.keySize, key + header.keySize,
+                                    header.valueSize))
+      break;
+    index[header.hash].push_back(scanned);
+    scanned = end;
+  }
+}
+
+bool PersistentQueryCache::find(const Key &key, std::string &value) {
+  auto it = index.find(key.hash);
+  if (it == index.end())
+    return false;
+  for (auto oit = it->second.rbegin(), oie = it->second.rend(); oit != oie;
+       ++oit) {
+    RecordHeader header;
+    memcpy(&header, data + *oit, sizeof(header));
+    const char *bytes = data + *oit + sizeof(header);
+    if (header.keySize == key.bytes.size() &&
+        !memcmp(bytes, key.bytes.data(), header.keySize)) {
+      value.assign(bytes + header.keySize, header.valueSize);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool PersistentQueryCache::lookup(const Key &key, std::string &value) {
+  // other processes may have stored a newer value since the last call
+  refresh();
+  return find(key, value);
+}
+
+void PersistentQueryCache::insert(const Key &key, const std::string &value) {
+  std::string current;
+  if (find(key, current) && current == value)
+    return;
+
+  flock(fd, LOCK_EX);
+  refresh();
+  if (!(find(key, current) && current == value)) {
+    // nobody else is writing, so what is left after the last record was
+    // never finished
+    if (scanned < mappedSize && ftruncate(fd, scanned) != 0)
+      klee_warning_once(this, "Cannot truncate persistent query cache: %s",
+                        strerror(errno));
+
+    RecordHeader header = {RecordMagic, uint32_t(key.bytes.size()),
+                           uint32_t(value.size()),
+                           checksum(key.bytes.data(), key.bytes.size(),
+                                    value.data(), value.size()),
+                           key.hash};
+    std::string record(reinterpret_cast<const char *>(&header),
+                       sizeof(header));
+    record += key.bytes;
+    record += value;
+    for (size_t written = 0; written != record.size();) {
+      ssize_t n = write(fd, record.data() + written, record.size() - written);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0) {
+        klee_warning_once(this, "Cannot write persistent query cache: %s",
+                          strerror(errno));
+        break;
+      }
+      written += n;
+    }
+  }
+  flock(fd, LOCK_UN);
+  refresh();
+}
+
+std::string
+PersistentQueryCache::encodeAssignment(const Key &key,
+                                       const Assignment *assignment) {
+  std::string value;
+  if (!assignment) {
+    value.push_back(0);
+    return value;
+  }
+  value.push_back(1);
+  for (const Array *array : key.arrays) {
+    const CompactArrayModel *bindings = assignment->getBindingsOrNull(array);
+    if (!bindings) {
+      value.push_back(0);
+      continue;
+    }
+    value.push_back(1);
+    std::map<uint32_t, uint8_t> values = bindings->asMap();
+    writeInt(value, values.size());
+    for (const auto &entry : values) {
+      writeInt(value, entry.first);
+      value.push_back(entry.second);
+    }
+  }
+  return value;
+}
+
+bool PersistentQueryCache::decodeAssignment(
+    const Key &key, const std::string &value,
+    std::shared_ptr<const Assignment> &result) {
+  if (value.empty())
+    return false;
+  if (value[0] == 0) {
+    result = nullptr;
+    return value.size() == 1;
+  }
+
+  Assignment::map_bindings_ty bindings;
+  size_t pos = 1;
+  for (const Array *array : key.arrays) {
+    if (pos == value.size())
+      return false;
+    if (!value[pos++])
+      continue;
+    MapArrayModel &model = bindings[array];
+    uint64_t count;
+    if (!readInt(value, pos, count))
+      return false;
+    for (; count; --count) {
+      uint64_t index;
+      if (!readInt(value, pos, index) || pos == value.size())
+        return false;
+      model.add(index, value[pos++]);
+    }
+  }
+  if (pos != value.size())
+    return false;
+  result = std::make_shared<Assignment>(bindings);
+  return true;
+}
@@ -0,0 +1,414 @@
+//===-- PortfolioSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/OptionCategories.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Errno.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+cl::opt<unsigned> PortfolioRaceAfter(
+    "portfolio-race-after",
+    cl::desc("Time in milliseconds the preferred backend of the portfolio "
+             "solver gets before all backends race on the query, raised to "
+             "four times its average solving time (default=100)"),
+    cl::init(100), cl::cat(SolvingCat));
+}
+
+namespace klee {
+
+class PortfolioSolverImpl : public SolverImpl {
+private:
+  std::vector<Solver *> solvers;
+  time::Span timeout;
+  SolverRunStatus runStatusCode;
+
+  /// The backend that last won a race, by query shape.
+  std::map<unsigned, unsigned> winners;
+  /// Moving average of the queries solved without a race.
+  time::Span averageTime;
+
+  static unsigned getShape(const Query &query);
+
+  SolverRunStatus runBackend(unsigned index, const Query &query,
+                             bool needsModel,
+                             std::shared_ptr<const Assignment> &result,
+                             bool &hasSolution, time::Span timeout);
+  /// Run all backends in child processes and take the first answer.
+  /// Returns the index of the winner, or -1 if none of them answered.
+  int race(const Query &query, bool needsModel,
+           std::shared_ptr<const Assignment> &result, bool &hasSolution,
+           time::Span timeout);
+  bool solve(const Query &query, bool needsModel,
+             std::shared_ptr<const Assignment> &result, bool &hasSolution);
+
+public:
+  explicit PortfolioSolverImpl(const std::vector<Solver *> &solvers)
+      : solvers(solvers), runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+    assert(!solvers.empty() && "portfolio without backends");
+  }
+  ~PortfolioSolverImpl() {
+    for (Solver *s : solvers)
+      delete s;
+  }
+
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() { return runStatusCode; }
+  char *getConstraintLog(const Query &query) {
+    return solvers[0]->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span _timeout) { timeout = _timeout; }
+};
+
+unsigned PortfolioSolverImpl::getShape(const Query &query) {
+  enum { HasReads = 1, HasUpdates = 2, HasNonLinear = 4 };
+  unsigned shape = 0;
+
+  std::vector<ref<Expr> > stack(query.constraints.begin(),
+                                query.constraints.end());
+  stack.push_back(query.expr);
+  ExprHashSet visited;
+  while (!stack.empty()) {
+    ref<Expr> e = stack.back();
+    stack.pop_back();
+    if (isa<ConstantExpr>(e) || !visited.insert(e).second)
+      continue;
+
+    switch (e->getKind()) {
+    case Expr::Read:
+      shape |= HasReads;
+      if (cast<ReadExpr>(e)->updates.head)
+        shape |= HasUpdates;
+      break;
+    case Expr::Mul:
+    case Expr::UDiv:
+    case Expr::SDiv:
+    case Expr::URem:
+    case Expr::SRem:
+      if (!isa<ConstantExpr>(e->getKid(0)) && !isa<ConstantExpr>(e->getKid(1)))
+        shape |= HasNonLinear;
+      break;
+    default:
+      break;
+    }
+    for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+      stack.push_back(e->getKid(i));
+  }
+
+  // bucket the number of constraints logarithmically
+  unsigned bucket = 0;
+  for (size_t n = query.constraints.size(); n > 1 && bucket < 7; n >>= 2)
+    ++bucket;
+  return shape | bucket << 3;
+}
+
+SolverImpl::SolverRunStatus PortfolioSolverImpl::runBackend(
+    unsigned index, const Query &query, bool needsModel,
+    std::shared_ptr<const Assignment> &result, bool &hasSolution,
+    time::Span timeout) {
+  SolverImpl *impl = solvers[index]->impl;
+  impl->setCoreSolverTimeout(timeout);
+
+  bool success;
+  if (needsModel) {
+    success = impl->computeInitialValues(query, result, hasSolution);
+  } else {
+    bool isValid;
+    success = impl->computeTruth(query, isValid);
+    hasSolution = !isValid;
+  }
+  if (!success)
+    return impl->getOperationStatusCode();
+  return hasSolution ? SOLVER_RUN_STATUS_SUCCESS_SOLVABLE
+                     : SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+}
+
+static void appendInt(std::string &buffer, uint32_t value) {
+  buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static uint32_t readInt(const std::string &buffer, size_t &pos) {
+  uint32_t value = 0;
+  if (pos + sizeof(value) <= buffer.size())
+    buffer.copy(reinterpret_cast<char *>(&value), sizeof(value), pos);
+  pos += sizeof(value);
+  return value;
+}
+
+int PortfolioSolverImpl::race(const Query &query, bool needsModel,
+                              std::shared_ptr<const Assignment> &result,
+                              bool &hasSolution, time::Span timeout) {
+  // The children send back the model for these arrays, which they share
+  // with the parent as they were forked from it.
+  std::vector<const Array *> objects;
+  if (needsModel) {
+    std::vector<ref<Expr> > exprs(query.constraints.begin(),
+                                  query.constraints.end());
+    exprs.push_back(query.expr);
+    findSymbolicObjects(exprs.begin(), exprs.end(), objects);
+  }
+
+  struct Racer {
+    pid_t pid;
+    int fd;
+    std::string message;
+  };
+  std::vector<Racer> racers(solvers.size(), Racer{-1, -1, std::string()});
+
+  fflush(stdout);
+  fflush(stderr);
+
+  for (unsigned i = 0; i != solvers.size(); ++i) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+      klee_warning("pipe failed (for portfolio solver) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      break;
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+      klee_warning("fork failed (for portfolio solver) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      close(fds[0]);
+      close(fds[1]);
+      break;
+    }
+    // - child: solve, send the answer and exit
+    if (pid == 0) {
+      close(fds[0]);
+      // own process group, so that processes spawned by the backend are
+      // killed together with it
+      setpgid(0, 0);
+      std::shared_ptr<const Assignment> model;
+      bool solvable = false;
+      SolverRunStatus status =
+          runBackend(i, query, needsModel, model, solvable, timeout);
+
+      std::string message(1, static_cast<char>(status));
+      if (status == SOLVER_RUN_STATUS_SUCCESS_SOLVABLE && needsModel) {
+        for (const Array *array : objects) {
+          const CompactArrayModel *bindings = model->getBindingsOrNull(array);
+          message.push_back(bindings != 0);
+          if (!bindings)
+            continue;
+          std::map<uint32_t, uint8_t> values = bindings->asMap();
+          appendInt(message, values.size());
+          for (const auto &value : values) {
+            appendInt(message, value.first);
+            message.push_back(static_cast<char>(value.second));
+          }
+        }
+      }
+      for (size_t pos = 0; pos < message.size();) {
+        ssize_t n = write(fds[1], message.data() + pos, message.size() - pos);
+        if (n < 0 && errno == EINTR)
+          continue;
+        if (n <= 0)
+          break;
+        pos += n;
+      }
+      _exit(0);
+    }
+    // - parent
+    close(fds[1]);
+    setpgid(pid, pid);
+    racers[i].pid = pid;
+    racers[i].fd = fds[0];
+  }
+
+  int winner = -1;
+  time::Point deadline = time::getWallTime() + timeout;
+  while (winner == -1) {
+    std::vector<pollfd> fds;
+    std::vector<unsigned> owners;
+    for (unsigned i = 0; i != racers.size(); ++i) {
+      if (racers[i].fd != -1) {
+        fds.push_back(pollfd{racers[i].fd, POLLIN, 0});
+        owners.push_back(i);
+      }
+    }
+    if (fds.empty())
+      break;
+
+    int wait = -1;
+    if (timeout) {
+      time::Point now = time::getWallTime();
+      if (now >= deadline)
+        break;
+      wait = std::max<int>(1, (deadline - now).toMicroseconds() / 1000);
+    }
+    int ready = poll(fds.data(), fds.size(), wait);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready <= 0)
+      break;
+
+    for (unsigned j = 0; j != fds.size() && winner == -1; ++j) {
+      if (!fds[j].revents)
+        continue;
+      Racer &racer = racers[owners[j]];
+      char buffer[4096];
+      ssize_t n = read(racer.fd, buffer, sizeof(buffer));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n > 0) {
+        racer.message.append(buffer, n);
+        continue;
+      }
+      // the child is done: it answered if it had a success to report
+      close(racer.fd);
+      racer.fd = -1;
+      if (racer.message.empty())
+        continue;
+      SolverRunStatus status = static_cast<SolverRunStatus>(racer.message[0]);
+      if (status == SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
+          status == SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE)
+        winner = owners[j];
+    }
+  }
+
+  for (Racer &racer : racers) {
+    if (racer.pid == -1)
+      continue;
+    if (racer.fd != -1) {
+      close(racer.fd);
+      kill(-racer.pid, SIGKILL);
+    }
+    int status;
+    while (waitpid(racer.pid, &status, 0) < 0 && errno == EINTR)
+      ;
+  }
+
+  if (winner == -1)
+    return -1;
+
+  const std::string &message = racers[winner].message;
+  hasSolution = static_cast<SolverRunStatus>(message[0]) ==
+                SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  if (hasSolution && needsModel) {
+    Assignment::map_bindings_ty bindings;
+    size_t pos = 1;
+    for (const Array *array : objects) {
+      if (pos >= message.size() || !message[pos++])
+        continue;
+      MapArrayModel &model = bindings[array];
+      for (uint32_t n = readInt(message, pos); n != 0; --n) {
+        uint32_t index = readInt(message, pos);
+        model.add(index, pos < message.size() ? message[pos] : 0);
+        ++pos;
+      }
+    }
+    result = std::make_shared<Assignment>(bindings);
+  }
+  return winner;
+}
+
+bool PortfolioSolverImpl::solve(const Query &query, bool needsModel,
+                                std::shared_ptr<const Assignment> &result,
+                                bool &hasSolution) {
+  unsigned shape = getShape(query);
+  auto it = winners.find(shape);
+  unsigned preferred = it == winners.end() ? 0 : it->second;
+
+  // Easy queries are solved in this process by the backend that is most
+  // likely to be fast for them; only those that take much longer than
+  // usual are worth the forks. A zero budget races every query.
+  time::Span budget =
+      std::max(time::milliseconds(PortfolioRaceAfter), averageTime * 4u);
+  if (solvers.size() == 1 || (timeout && timeout <= budget)) {
+    runStatusCode =
+        runBackend(preferred, query, needsModel, result, hasSolution, timeout);
+    return runStatusCode == SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
+           runStatusCode == SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+  }
+
+  if (budget) {
+    time::Point start = time::getWallTime();
+    runStatusCode =
+        runBackend(preferred, query, needsModel, result, hasSolution, budget);
+    if (runStatusCode != SOLVER_RUN_STATUS_TIMEOUT) {
+      averageTime = averageTime * 0.9 + (time::getWallTime() - start) * 0.1;
+      return runStatusCode == SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
+             runStatusCode == SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+    }
+  }
+
+  ++stats::queryPortfolioRaces;
+  int winner = race(query, needsModel, result, hasSolution,
+                    timeout ? timeout - budget : time::Span());
+  if (winner == -1) {
+    runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+    return false;
+  }
+  winners[shape] = winner;
+  runStatusCode = hasSolution ? SOLVER_RUN_STATUS_SUCCESS_SOLVABLE
+                              : SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+  return true;
+}
+
+bool PortfolioSolverImpl::computeTruth(const Query &query, bool &isValid) {
+  std::shared_ptr<const Assignment> result;
+  bool hasSolution;
+  if (!solve(query, false, result, hasSolution))
+    return false;
+  isValid = !hasSolution;
+  return true;
+}
+
+bool PortfolioSolverImpl::computeValue(const Query &query, ref<Expr> &result) {
+  std::shared_ptr<const Assignment> assignment;
+  bool hasSolution;
+
+  if (!computeInitialValues(query.withFalse(), assignment, hasSolution))
+    return false;
+  assert(hasSolution && "state has invalid constraint set");
+
+  // Evaluate the expression with the computed assignment.
+  result = assignment->evaluate(query.expr);
+
+  return true;
+}
+
+bool PortfolioSolverImpl::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  return solve(query, true, result, hasSolution);
+}
+
+Solver *createPortfolioSolver(const std::vector<Solver *> &solvers) {
+  return new Solver(new PortfolioSolverImpl(solvers));
+}
+}
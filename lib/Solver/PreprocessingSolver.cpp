@@ -0,0 +1,499 @@
+//===-- PreprocessingSolver.cpp -------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ByteBounds.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Expr/ExprVisitor.h"
+#include "klee/OptionCategories.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverCmdLine.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+cl::opt<unsigned> ReadExpansionLimit(
+    "preprocess-read-expansion-limit",
+    cl::desc("Maximum number of indices a read at a symbolic index may take "
+             "to be expanded into reads at constant indices (default=8)"),
+    cl::init(8), cl::cat(SolvingCat));
+
+cl::opt<unsigned> TableExpansionLimit(
+    "preprocess-table-expansion-limit",
+    cl::desc("Maximum number of indices a read of a constant array at a "
+             "symbolic index may take to be replaced by a choice among the "
+             "values at those indices (default=64)"),
+    cl::init(64), cl::cat(SolvingCat));
+
+cl::opt<unsigned> TableInversionLimit(
+    "preprocess-table-inversion-limit",
+    cl::desc("Maximum number of indices of a constant array holding a value "
+             "for a comparison of a read of the array with the value to be "
+             "replaced by comparisons of the index (default=16)"),
+    cl::init(16), cl::cat(SolvingCat));
+
+/// The bounds a constraint puts on a byte. The bound is exact iff it is
+/// all the constraint says.
+struct ByteBound {
+  unsigned constraint;
+  ByteBounds::Bound bound;
+  bool exact;
+};
+
+class SubstitutionVisitor : public ExprVisitor {
+  const ExprHashMap<ref<Expr>> &substitutions;
+
+public:
+  SubstitutionVisitor(const ExprHashMap<ref<Expr>> &substitutions)
+      : ExprVisitor(true), substitutions(substitutions) {}
+
+  Action visitExprPost(const Expr &e) {
+    auto it = substitutions.find(ref<Expr>(const_cast<Expr *>(&e)));
+    if (it == substitutions.end())
+      return Action::doChildren();
+    return Action::changeTo(it->second);
+  }
+};
+
+/// Replace reads at symbolic indices that can only take a few values by a
+/// choice among the reads at those indices.
+class ReadExpansionVisitor : public ExprVisitor {
+  const ByteBounds &bounds;
+
+public:
+  unsigned expanded = 0;
+
+  ReadExpansionVisitor(const ByteBounds &bounds) : bounds(bounds) {}
+
+  Action visitRead(const ReadExpr &re) {
+    if (isa<ConstantExpr>(re.index))
+      return Action::doChildren();
+    ValueRange index = bounds.evaluate(re.index);
+    if (index.isEmpty() || index.max() >= re.updates.root->size ||
+        index.max() - index.min() >= ReadExpansionLimit)
+      return Action::doChildren();
+
+    Expr::Width width = re.index->getWidth();
+    ref<Expr> result = ReadExpr::create(
+        re.updates, ConstantExpr::alloc(index.max(), width));
+    for (uint64_t i = index.max(); i-- > index.min();) {
+      ref<Expr> at = ConstantExpr::alloc(i, width);
+      result = SelectExpr::create(EqExpr::create(at, re.index),
+                                  ReadExpr::create(re.updates, at), result);
+    }
+    ++expanded;
+    return Action::changeTo(result);
+  }
+};
+
+/// The indices of each byte value in a constant array, in increasing order.
+typedef std::map<const Array *, std::vector<std::vector<uint64_t>>>
+    TableIndices;
+
+/// Replace reads at symbolic indices of constant arrays, leaving the arrays
+/// out of the query: by a choice among the values at the indices a read may
+/// take, and in comparisons with a constant by comparisons of the index with
+/// the indices holding the constant.
+class TableVisitor : public ExprVisitor {
+  const ByteBounds &bounds;
+  TableIndices &tableIndices;
+
+  /// Whether \a e reads a constant array, without updates, at a symbolic
+  /// index within the array; if so sets \a index to the range of the index.
+  static const ReadExpr *getTableRead(const ByteBounds &bounds,
+                                      const ref<Expr> &e, ValueRange &index) {
+    const ReadExpr *re = dyn_cast<ReadExpr>(e);
+    if (!re || isa<ConstantExpr>(re->index) || re->updates.head ||
+        !re->updates.root->isConstantArray() ||
+        re->updates.root->range != Expr::Int8)
+      return 0;
+    index = bounds.evaluate(re->index);
+    if (index.isEmpty() || index.max() >= re->updates.root->size)
+      return 0;
+    return re;
+  }
+
+  const std::vector<std::vector<uint64_t>> &getIndices(const Array *array) {
+    std::vector<std::vector<uint64_t>> &indices = tableIndices[array];
+    if (indices.empty()) {
+      indices.resize(256);
+      for (uint64_t i = 0; i != array->size; ++i)
+        indices[array->constantValues[i]->getZExtValue()].push_back(i);
+    }
+    return indices;
+  }
+
+public:
+  unsigned expanded = 0;
+  unsigned inverted = 0;
+
+  TableVisitor(const ByteBounds &bounds, TableIndices &tableIndices)
+      : bounds(bounds), tableIndices(tableIndices) {}
+
+  Action visitEq(const EqExpr &ee) {
+    // constants are on the left of comparisons
+    const ConstantExpr *value = dyn_cast<ConstantExpr>(ee.left);
+    ValueRange index;
+    const ReadExpr *re =
+        value ? getTableRead(bounds, ee.right, index) : 0;
+    if (!re)
+      return Action::doChildren();
+
+    const std::vector<uint64_t> &at =
+        getIndices(re->updates.root)[value->getZExtValue()];
+    auto begin = std::lower_bound(at.begin(), at.end(), index.min());
+    auto end = std::upper_bound(begin, at.end(), index.max());
+    if (static_cast<uint64_t>(end - begin) > TableInversionLimit)
+      return Action::doChildren();
+
+    Expr::Width width = re->index->getWidth();
+    ref<Expr> result = ConstantExpr::alloc(0, Expr::Bool);
+    while (end != begin)
+      result = OrExpr::create(
+          EqExpr::create(ConstantExpr::alloc(*--end, width), re->index),
+          result);
+    ++inverted;
+    return Action::changeTo(result);
+  }
+
+  Action visitRead(const ReadExpr &re) {
+    ValueRange index;
+    if (!getTableRead(bounds, ref<Expr>(const_cast<ReadExpr *>(&re)), index) ||
+        index.max() - index.min() >= TableExpansionLimit)
+      return Action::doChildren();
+
+    // One choice for each run of equal values, from the last one down.
+    const std::vector<ref<ConstantExpr>> &values =
+        re.updates.root->constantValues;
+    Expr::Width width = re.index->getWidth();
+    ref<Expr> result = values[index.max()];
+    for (uint64_t i = index.max(); i-- > index.min();) {
+      if (values[i] == values[i + 1])
+        continue;
+      result = SelectExpr::create(
+          UleExpr::create(re.index, ConstantExpr::alloc(i, width)), values[i],
+          result);
+    }
+    ++expanded;
+    return Action::changeTo(result);
+  }
+};
+
+class PreprocessingSolver : public SolverImpl {
+private:
+  Solver *solver;
+  unsigned rewrites;
+  /// The indices of the values of the constant arrays seen so far.
+  TableIndices tableIndices;
+  /// Whether the last query was answered without the underlying solver.
+  bool answered = false;
+
+  bool isEnabled(PreprocessingRewrite rewrite) const {
+    return rewrites & (1u << rewrite);
+  }
+
+  /// Rewrite a query, for a model of its constraints if \a forModel.
+  ///
+  /// \return false iff the query is to be passed on unchanged.
+  bool preprocess(const Query &query, bool forModel,
+                  std::vector<ref<Expr>> &constraints, ref<Expr> &expr);
+
+public:
+  PreprocessingSolver(Solver *solver, unsigned rewrites)
+      : solver(solver), rewrites(rewrites) {}
+  ~PreprocessingSolver() { delete solver; }
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(time::Span timeout);
+};
+}
+
+bool PreprocessingSolver::preprocess(const Query &query, bool forModel,
+                                     std::vector<ref<Expr>> &constraints,
+                                     ref<Expr> &expr) {
+  constraints.assign(query.constraints.begin(), query.constraints.end());
+  expr = query.expr;
+  bool changed = false;
+
+  // Bounds on bytes, from comparisons with constants. The bounds are only
+  // derived once; every rewrite below keeps the constraints implying them,
+  // and leaves the comparisons they come from in place.
+  const ByteBounds &bounds = query.constraints.getByteBounds();
+  if (bounds.isContradictory())
+    return false;
+  std::vector<ByteBound> byteBounds;
+  std::vector<bool> isBound(constraints.size(), false);
+  for (unsigned i = 0; i != constraints.size(); ++i) {
+    std::vector<ByteBounds::Bound> narrowed;
+    bool exact;
+    if (!ByteBounds::getBounds(constraints[i], narrowed, exact))
+      continue;
+    isBound[i] = true;
+    for (const auto &b : narrowed)
+      byteBounds.push_back({i, b, exact});
+  }
+
+  std::vector<bool> dropped(constraints.size(), false);
+  if (isEnabled(PREPROCESS_BOUNDS)) {
+    // Drop exact bounds the others on the same byte already imply.
+    std::map<ByteBounds::Byte, std::vector<const ByteBound *>> boundsOfByte;
+    for (const ByteBound &bound : byteBounds)
+      boundsOfByte[bound.bound.byte].push_back(&bound);
+    for (const ByteBound &bound : byteBounds) {
+      if (!bound.exact)
+        continue;
+      ValueRange others(0, 255);
+      for (const ByteBound *other : boundsOfByte[bound.bound.byte])
+        if (other->constraint != bound.constraint &&
+            !dropped[other->constraint])
+          others = others.set_intersection(other->bound.range);
+      if (others.set_intersection(bound.bound.range) == others) {
+        dropped[bound.constraint] = true;
+        ++stats::preprocessImpliedConstraints;
+      }
+    }
+  }
+
+  if (isEnabled(PREPROCESS_EQUALITIES)) {
+    // Bounds that fix a byte make an equality to substitute.
+    ExprHashSet known(constraints.begin(), constraints.end());
+    for (const auto &bound : bounds) {
+      if (!bound.second.isFixed())
+        continue;
+      const Array *array = bound.first.first;
+      ref<Expr> eq = EqExpr::create(
+          ConstantExpr::alloc(bound.second.min(), Expr::Int8),
+          ReadExpr::create(UpdateList(array, 0),
+                           ConstantExpr::alloc(bound.first.second,
+                                               array->getDomain())));
+      if (known.insert(eq).second) {
+        constraints.push_back(eq);
+        isBound.push_back(true);
+        dropped.push_back(false);
+        changed = true;
+      }
+    }
+  }
+
+  std::vector<ref<Expr>> kept;
+  std::vector<bool> keptIsBound;
+  for (unsigned i = 0; i != constraints.size(); ++i) {
+    if (dropped[i]) {
+      changed = true;
+      continue;
+    }
+    kept.push_back(constraints[i]);
+    keptIsBound.push_back(isBound[i]);
+  }
+  constraints.swap(kept);
+  isBound.swap(keptIsBound);
+  kept.clear();
+  keptIsBound.clear();
+
+  if (isEnabled(PREPROCESS_EQUALITIES)) {
+    ExprHashMap<ref<Expr>> substitutions;
+    std::vector<bool> isSource(constraints.size(), false);
+    for (unsigned i = 0; i != constraints.size(); ++i) {
+      const EqExpr *ee = dyn_cast<EqExpr>(constraints[i]);
+      if (ee && isa<ConstantExpr>(ee->left) && !isa<ConstantExpr>(ee->right)) {
+        substitutions.insert(std::make_pair(ee->right, ee->left));
+        isSource[i] = true;
+      }
+    }
+
+    if (!substitutions.empty()) {
+      SubstitutionVisitor visitor(substitutions);
+      for (unsigned i = 0; i != constraints.size(); ++i) {
+        ref<Expr> rewritten =
+            isSource[i] ? constraints[i] : visitor.visit(constraints[i]);
+        if (rewritten != constraints[i]) {
+          ++stats::preprocessSubstitutions;
+          changed = true;
+          if (rewritten->isFalse())
+            return false;
+          if (rewritten->isTrue())
+            continue;
+        }
+        kept.push_back(rewritten);
+        keptIsBound.push_back(isBound[i]);
+      }
+      ref<Expr> rewritten = visitor.visit(expr);
+      if (rewritten != expr) {
+        ++stats::preprocessSubstitutions;
+        changed = true;
+        expr = rewritten;
+      }
+      constraints.swap(kept);
+      isBound.swap(keptIsBound);
+      kept.clear();
+      keptIsBound.clear();
+    }
+  }
+
+  if (isEnabled(PREPROCESS_READS)) {
+    ReadExpansionVisitor visitor(bounds);
+    for (auto &constraint : constraints)
+      constraint = visitor.visit(constraint);
+    expr = visitor.visit(expr);
+    if (visitor.expanded) {
+      stats::preprocessExpandedReads += visitor.expanded;
+      changed = true;
+    }
+  }
+
+  if (isEnabled(PREPROCESS_TABLES)) {
+    TableVisitor visitor(bounds, tableIndices);
+    for (auto &constraint : constraints)
+      constraint = visitor.visit(constraint);
+    expr = visitor.visit(expr);
+    if (visitor.expanded || visitor.inverted) {
+      stats::preprocessExpandedTableReads += visitor.expanded;
+      stats::preprocessInvertedTableReads += visitor.inverted;
+      changed = true;
+    }
+  }
+
+  if (isEnabled(PREPROCESS_BOUNDS) && !bounds.empty()) {
+    // The comparisons the bounds come from cannot be checked against them.
+    for (unsigned i = 0; i != constraints.size(); ++i) {
+      if (!isBound[i] &&
+          bounds.evaluate(constraints[i]).mustEqual(1)) {
+        ++stats::preprocessImpliedConstraints;
+        changed = true;
+        continue;
+      }
+      kept.push_back(constraints[i]);
+    }
+    constraints.swap(kept);
+    kept.clear();
+
+    if (!isa<ConstantExpr>(expr) && expr->getWidth() == Expr::Bool) {
+      ValueRange range = bounds.evaluate(expr);
+      if (range.isFixed()) {
+        expr = ConstantExpr::alloc(range.min(), Expr::Bool);
+        changed = true;
+      }
+    }
+  }
+
+  // A model has to bind every array of the constraints, so it needs them
+  // all.
+  if (isEnabled(PREPROCESS_DEAD) && !forModel && !isa<ConstantExpr>(expr)) {
+    ConstraintManager tmp(constraints);
+    tmp.getIndependentConstraints(expr, kept);
+    if (kept.size() != constraints.size()) {
+      stats::preprocessDeadConstraints += constraints.size() - kept.size();
+      changed = true;
+      constraints.swap(kept);
+    }
+  }
+
+  return changed;
+}
+
+bool PreprocessingSolver::computeValidity(const Query &query,
+                                          Solver::Validity &result) {
+  std::vector<ref<Expr>> constraints;
+  ref<Expr> expr;
+  answered = false;
+  if (!preprocess(query, false, constraints, expr))
+    return solver->impl->computeValidity(query, result);
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr)) {
+    result = CE->isTrue() ? Solver::True : Solver::False;
+    answered = true;
+    return true;
+  }
+  ConstraintManager tmp(constraints);
+  return solver->impl->computeValidity(Query(tmp, expr), result);
+}
+
+bool PreprocessingSolver::computeTruth(const Query &query, bool &isValid) {
+  std::vector<ref<Expr>> constraints;
+  ref<Expr> expr;
+  answered = false;
+  if (!preprocess(query, false, constraints, expr))
+    return solver->impl->computeTruth(query, isValid);
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr)) {
+    isValid = CE->isTrue();
+    answered = true;
+    return true;
+  }
+  ConstraintManager tmp(constraints);
+  return solver->impl->computeTruth(Query(tmp, expr), isValid);
+}
+
+bool PreprocessingSolver::computeValue(const Query &query, ref<Expr> &result) {
+  std::vector<ref<Expr>> constraints;
+  ref<Expr> expr;
+  answered = false;
+  if (!preprocess(query, false, constraints, expr))
+    return solver->impl->computeValue(query, result);
+  if (isa<ConstantExpr>(expr)) {
+    result = expr;
+    answered = true;
+    return true;
+  }
+  ConstraintManager tmp(constraints);
+  return solver->impl->computeValue(Query(tmp, expr), result);
+}
+
+bool PreprocessingSolver::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  std::vector<ref<Expr>> constraints;
+  ref<Expr> expr;
+  answered = false;
+  if (!preprocess(query, true, constraints, expr))
+    return solver->impl->computeInitialValues(query, result, hasSolution);
+  // The model is of the constraints and the negated expression.
+  if (expr->isTrue()) {
+    hasSolution = false;
+    answered = true;
+    return true;
+  }
+  ConstraintManager tmp(constraints);
+  return solver->impl->computeInitialValues(Query(tmp, expr), result,
+                                            hasSolution);
+}
+
+SolverImpl::SolverRunStatus PreprocessingSolver::getOperationStatusCode() {
+  if (answered)
+    return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  return solver->impl->getOperationStatusCode();
+}
+
+char *PreprocessingSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void PreprocessingSolver::setCoreSolverTimeout(time::Span timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+Solver *klee::createPreprocessingSolver(Solver *s, unsigned rewrites) {
+  return new Solver(new PreprocessingSolver(s, rewrites));
+}
@@ -0,0 +1,180 @@
+//===-- ProfilingSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace klee;
+
+namespace {
+enum QueryKind {
+  ValidityQuery,
+  TruthQuery,
+  TruthsQuery,
+  ValueQuery,
+  InitialValuesQuery,
+  NumQueryKinds
+};
+
+// indexed by SolverLayer
+const char *const layerNames[] = {"core",
+                                  "unsat core cache",
+                                  "solver query log",
+                                  "assignment validation",
+                                  "fast cex",
+                                  "cex cache",
+                                  "branch cache",
+                                  "preprocessing",
+                                  "independence",
+                                  "validation",
+                                  "query log"};
+static_assert(sizeof(layerNames) / sizeof(*layerNames) == NumSolverLayers,
+              "a layer without a name");
+
+const char *const queryKindNames[] = {"validity", "truth", "truths", "value",
+                                      "initial values"};
+
+struct LayerProfile {
+  uint64_t queries = 0;
+  uint64_t passed = 0;
+  uint64_t hits = 0;
+  time::Span time;
+  time::Span ownTime;
+};
+
+LayerProfile profiles[NumSolverLayers][NumQueryKinds];
+
+/// A query running in a profiled layer. The queries of the layers below it
+/// are nested in it, so it knows how much of its time they took.
+class ProfiledQuery {
+  /// The innermost profiled query on this thread
+  static thread_local ProfiledQuery *current;
+
+  SolverLayer layer;
+  QueryKind kind;
+  ProfiledQuery *parent;
+  time::Point start;
+  time::Span nestedTime;
+  bool passed = false;
+
+public:
+  ProfiledQuery(SolverLayer layer, QueryKind kind)
+      : layer(layer), kind(kind), parent(current),
+        start(time::getWallTime()) {
+    if (parent) {
+      parent->passed = true;
+      ++profiles[parent->layer][parent->kind].passed;
+      ++stats::solverLayerPassedQueries[parent->layer];
+    }
+    ++profiles[layer][kind].queries;
+    ++stats::solverLayerQueries[layer];
+    current = this;
+  }
+
+  ~ProfiledQuery() {
+    time::Span elapsed = time::getWallTime() - start;
+    time::Span ownTime = elapsed - nestedTime;
+    LayerProfile &profile = profiles[layer][kind];
+    profile.time += elapsed;
+    profile.ownTime += ownTime;
+    stats::solverLayerTime[layer] += ownTime.toMicroseconds();
+    if (!passed) {
+      ++profile.hits;
+      ++stats::solverLayerHits[layer];
+    }
+    if (parent)
+      parent->nestedTime += elapsed;
+    current = parent;
+  }
+};
+
+thread_local ProfiledQuery *ProfiledQuery::current = nullptr;
+
+/// Forward all queries to the layer below, accounting them to a layer of
+/// the solver chain (see -profile-solver-chain).
+class ProfilingSolver : public SolverImpl {
+  Solver *solver;
+  SolverLayer layer;
+
+public:
+  ProfilingSolver(Solver *solver, SolverLayer layer)
+      : solver(solver), layer(layer) {}
+  ~ProfilingSolver() { delete solver; }
+
+  bool computeValidity(const Query &query, Solver::Validity &result) {
+    ProfiledQuery profiled(layer, ValidityQuery);
+    return solver->impl->computeValidity(query, result);
+  }
+  bool computeTruth(const Query &query, bool &isValid) {
+    ProfiledQuery profiled(layer, TruthQuery);
+    return solver->impl->computeTruth(query, isValid);
+  }
+  bool computeTruths(const ConstraintManager &constraints,
+                     const std::vector<ref<Expr>> &exprs,
+                     std::vector<bool> &isValid) {
+    ProfiledQuery profiled(layer, TruthsQuery);
+    return solver->impl->computeTruths(constraints, exprs, isValid);
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    ProfiledQuery profiled(layer, ValueQuery);
+    return solver->impl->computeValue(query, result);
+  }
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) {
+    ProfiledQuery profiled(layer, InitialValuesQuery);
+    return solver->impl->computeInitialValues(query, result, hasSolution);
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+  bool enableUnsatCores() { return solver->impl->enableUnsatCores(); }
+  bool getUnsatCore(std::vector<ref<Expr> > &core) {
+    return solver->impl->getUnsatCore(core);
+  }
+};
+} // namespace
+
+Solver *klee::createProfilingSolver(Solver *s, SolverLayer layer) {
+  return new Solver(new ProfilingSolver(s, layer));
+}
+
+void klee::printSolverChainProfile(llvm::raw_ostream &os) {
+  os << "Solver chain profile (times in seconds, own time without the "
+        "layers below):\n";
+  os << "layer                  query           "
+        "   queries     passed   answered       time   own time\n";
+  // from the top of the chain down
+  for (unsigned layer = NumSolverLayers; layer-- != 0;) {
+    for (unsigned kind = 0; kind != NumQueryKinds; ++kind) {
+      const LayerProfile &profile = profiles[layer][kind];
+      if (!profile.queries)
+        continue;
+      os << llvm::format("%-22s %-15s %10llu %10llu %10llu %10.3f %10.3f\n",
+                         layerNames[layer], queryKindNames[kind],
+                         (unsigned long long) profile.queries,
+                         (unsigned long long) profile.passed,
+                         (unsigned long long) profile.hits,
+                         profile.time.toSeconds(),
+                         profile.ownTime.toSeconds());
+    }
+  }
+}
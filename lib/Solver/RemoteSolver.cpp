@@ -0,0 +1,401 @@
+//===-- RemoteSolver.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/RemoteSolver.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Solver/BinaryQueryLog.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/TimerStatIncrementer.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <netdb.h>
+#include <poll.h>
+#include <streambuf>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+/// How much longer than its timeout the client waits for the answer to a
+/// query before giving up on the connection.
+const time::Span AnswerGrace = time::seconds(10);
+
+/// Reads from a socket, failing once a deadline has passed.
+class SocketStreamBuf : public std::streambuf {
+  int fd;
+  char buffer[4096];
+
+public:
+  /// The time reading fails at, if \ref hasDeadline.
+  time::Point deadline;
+  bool hasDeadline = false;
+
+  explicit SocketStreamBuf(int fd) : fd(fd) {}
+
+protected:
+  int_type underflow() override {
+    for (;;) {
+      int wait = -1;
+      if (hasDeadline) {
+        time::Point now = time::getWallTime();
+        if (now >= deadline)
+          return traits_type::eof();
+        wait = std::max<int64_t>(1, (deadline - now).toMicroseconds() / 1000);
+      }
+      struct pollfd pfd = {fd, POLLIN, 0};
+      int ready = poll(&pfd, 1, wait);
+      if (ready < 0 && errno != EINTR)
+        return traits_type::eof();
+      if (ready <= 0)
+        continue;
+
+      ssize_t n = read(fd, buffer, sizeof(buffer));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return traits_type::eof();
+      setg(buffer, buffer, buffer + n);
+      return traits_type::to_int_type(buffer[0]);
+    }
+  }
+};
+
+/// Writes to a socket, without raising SIGPIPE once the peer is gone.
+class SocketOStream : public llvm::raw_ostream {
+  int fd;
+  uint64_t written = 0;
+
+  void write_impl(const char *ptr, size_t size) override {
+    while (size && !failed) {
+      ssize_t n = send(fd, ptr, size, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0) {
+        failed = true;
+        break;
+      }
+      ptr += n;
+      size -= n;
+      written += n;
+    }
+  }
+  uint64_t current_pos() const override { return written; }
+
+public:
+  bool failed = false;
+
+  explicit SocketOStream(int fd) : fd(fd) {}
+  ~SocketOStream() override { flush(); }
+};
+
+/// The two binary query logs of a connection.
+struct Connection {
+  int fd;
+  SocketStreamBuf inBuffer;
+  std::istream in;
+  SocketOStream out;
+  BinaryQueryLogWriter writer;
+  std::unique_ptr<BinaryQueryLogReader> reader;
+
+  /// \arg arrayCache - Where the arrays read are created.
+  Connection(int fd, ArrayCache &arrayCache)
+      : fd(fd), inBuffer(fd), in(&inBuffer), out(fd), writer(out) {
+    // the header has to reach the peer before it is waited for in return
+    out.flush();
+    reader.reset(new BinaryQueryLogReader(in, arrayCache));
+  }
+  ~Connection() {
+    reader.reset();
+    out.flush();
+    close(fd);
+  }
+
+  bool isValid() const { return !out.failed && reader->isValid(); }
+};
+
+class RemoteSolverImpl : public SolverImpl {
+  std::string address;
+  time::Span timeout;
+  SolverRunStatus runStatusCode;
+  /// The arrays of the answers, which are only used to know their number.
+  ArrayCache arrayCache;
+  std::unique_ptr<Connection> connection;
+
+  bool connect();
+  /// Send \arg query and read its answer into it.
+  bool ask(LoggedQuery &query);
+
+public:
+  RemoteSolverImpl(const std::string &address)
+      : address(address), runStatusCode(SOLVER_RUN_STATUS_FAILURE) {}
+
+  void setCoreSolverTimeout(time::Span _timeout) { timeout = _timeout; }
+
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() { return runStatusCode; }
+};
+
+bool RemoteSolverImpl::connect() {
+  size_t colon = address.rfind(':');
+  if (colon == std::string::npos) {
+    klee_warning("remote solver: address %s is not host:port",
+                 address.c_str());
+    return false;
+  }
+  std::string host = address.substr(0, colon);
+  std::string port = address.substr(colon + 1);
+
+  struct addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *addresses;
+  if (int error = getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses)) {
+    klee_warning("remote solver: cannot resolve %s: %s", address.c_str(),
+                 gai_strerror(error));
+    return false;
+  }
+  int fd = -1;
+  for (struct addrinfo *ai = addresses; ai && fd == -1; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                ai->ai_protocol);
+    if (fd != -1 && ::connect(fd, ai->ai_addr, ai->ai_addrlen)) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (fd == -1) {
+    klee_warning("remote solver: cannot connect to %s: %s", address.c_str(),
+                 strerror(errno));
+    return false;
+  }
+
+  connection.reset(new Connection(fd, arrayCache));
+  if (!connection->isValid()) {
+    klee_warning("remote solver: %s is not a solver service",
+                 address.c_str());
+    connection.reset();
+    return false;
+  }
+  return true;
+}
+
+bool RemoteSolverImpl::ask(LoggedQuery &query) {
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+  if (!connection && !connect())
+    return false;
+
+  query.elapsed = timeout;
+  connection->writer.write(query);
+  connection->inBuffer.hasDeadline = static_cast<bool>(timeout);
+  if (timeout)
+    connection->inBuffer.deadline = time::getWallTime() + timeout + AnswerGrace;
+
+  LoggedQuery answer;
+  if (connection->out.failed || !connection->reader->read(answer) ||
+      answer.kind != query.kind ||
+      (answer.success && answer.kind == LoggedQuery::InitialValues &&
+       answer.result && answer.values.size() != query.objects.size())) {
+    // the service may still be busy with the query, so its answer cannot
+    // be told apart from the next one anymore
+    bool timedOut = connection->inBuffer.hasDeadline &&
+                    time::getWallTime() >= connection->inBuffer.deadline;
+    if (timedOut)
+      runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+    else
+      klee_warning("remote solver: lost the connection to %s",
+                   address.c_str());
+    connection.reset();
+    return false;
+  }
+
+  if (!answer.success) {
+    if (timeout && answer.elapsed >= timeout)
+      runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+    return false;
+  }
+  query.success = true;
+  query.result = answer.result;
+  query.value = answer.value;
+  query.values = std::move(answer.values);
+  return true;
+}
+
+bool RemoteSolverImpl::computeTruth(const Query &query, bool &isValid) {
+  TimerStatIncrementer t(stats::queryTime);
+  ++stats::queries;
+  LoggedQuery logged;
+  logged.kind = LoggedQuery::Truth;
+  logged.constraints.assign(query.constraints.begin(), query.constraints.end());
+  logged.expr = query.expr;
+  if (!ask(logged))
+    return false;
+
+  isValid = logged.result;
+  runStatusCode = isValid ? SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE
+                          : SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  if (isValid)
+    ++stats::queriesValid;
+  else
+    ++stats::queriesInvalid;
+  return true;
+}
+
+bool RemoteSolverImpl::computeValidity(const Query &query,
+                                       Solver::Validity &result) {
+  TimerStatIncrementer t(stats::queryTime);
+  ++stats::queries;
+  LoggedQuery logged;
+  logged.kind = LoggedQuery::Validity;
+  logged.constraints.assign(query.constraints.begin(), query.constraints.end());
+  logged.expr = query.expr;
+  if (!ask(logged))
+    return false;
+
+  result = static_cast<Solver::Validity>(logged.result);
+  runStatusCode = SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  return true;
+}
+
+bool RemoteSolverImpl::computeValue(const Query &query, ref<Expr> &result) {
+  TimerStatIncrementer t(stats::queryTime);
+  ++stats::queries;
+  ++stats::queryCounterexamples;
+  LoggedQuery logged;
+  logged.kind = LoggedQuery::Value;
+  logged.constraints.assign(query.constraints.begin(), query.constraints.end());
+  logged.expr = query.expr;
+  if (!ask(logged))
+    return false;
+
+  result = logged.value;
+  runStatusCode = SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  return true;
+}
+
+bool RemoteSolverImpl::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  TimerStatIncrementer t(stats::queryTime);
+  ++stats::queries;
+  ++stats::queryCounterexamples;
+  LoggedQuery logged;
+  logged.kind = LoggedQuery::InitialValues;
+  logged.constraints.assign(query.constraints.begin(), query.constraints.end());
+  logged.expr = query.expr;
+  std::vector<ref<Expr> > exprs(logged.constraints);
+  exprs.push_back(query.expr);
+  findSymbolicObjects(exprs.begin(), exprs.end(), logged.objects);
+  if (!ask(logged))
+    return false;
+
+  hasSolution = logged.result;
+  runStatusCode = hasSolution ? SOLVER_RUN_STATUS_SUCCESS_SOLVABLE
+                              : SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+  if (hasSolution) {
+    ++stats::queriesInvalid;
+    auto assignment = std::make_shared<Assignment>();
+    for (size_t i = 0; i != logged.objects.size(); ++i)
+      assignment->addBinding(logged.objects[i], logged.values[i]);
+    result = assignment;
+  } else {
+    ++stats::queriesValid;
+  }
+  return true;
+}
+} // namespace
+
+RemoteSolver::RemoteSolver(const std::string &address)
+    : Solver(new RemoteSolverImpl(address)) {}
+
+void RemoteSolver::setCoreSolverTimeout(time::Span timeout) {
+  impl->setCoreSolverTimeout(timeout);
+}
+
+/***/
+
+void klee::serveRemoteSolver(Solver *solver, ArrayCache &arrayCache, int fd,
+                             time::Span maxTimeout) {
+  Connection connection(fd, arrayCache);
+  if (!connection.isValid())
+    return;
+
+  for (LoggedQuery query; connection.reader->read(query);) {
+    time::Span timeout = query.elapsed;
+    if (maxTimeout && (!timeout || maxTimeout < timeout))
+      timeout = maxTimeout;
+    solver->setCoreSolverTimeout(timeout);
+
+    // only the results and the number of objects are sent back
+    LoggedQuery answer;
+    answer.kind = query.kind;
+    answer.expr = ConstantExpr::create(1, Expr::Bool);
+    answer.objects = query.objects;
+
+    ConstraintManager constraints(query.constraints);
+    Query q(constraints, query.expr);
+    time::Point start = time::getWallTime();
+    switch (query.kind) {
+    case LoggedQuery::Truth: {
+      bool isValid;
+      answer.success = solver->impl->computeTruth(q, isValid);
+      answer.result = answer.success && isValid;
+      break;
+    }
+    case LoggedQuery::Validity: {
+      Solver::Validity validity;
+      answer.success = solver->impl->computeValidity(q, validity);
+      answer.result = answer.success ? validity : 0;
+      break;
+    }
+    case LoggedQuery::Value:
+      answer.success = solver->impl->computeValue(q, answer.value);
+      break;
+    case LoggedQuery::InitialValues: {
+      std::shared_ptr<const Assignment> solution;
+      bool hasSolution;
+      answer.success =
+          solver->impl->computeInitialValues(q, solution, hasSolution);
+      answer.result = answer.success && hasSolution;
+      if (answer.result) {
+        for (const Array *array : query.objects) {
+          std::vector<unsigned char> bytes(array->size);
+          for (unsigned i = 0; i != array->size; ++i)
+            bytes[i] = solution->getValue(array, i);
+          answer.values.push_back(std::move(bytes));
+        }
+      }
+      break;
+    }
+    }
+    answer.elapsed = time::getWallTime() - start;
+
+    connection.writer.write(answer);
+    if (connection.out.failed)
+      break;
+  }
+}
@@ -0,0 +1,527 @@
+//===-- SMTLIBSolver.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SMTLIBSolver.h"
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprSMTLIBPrinter.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/TimerStatIncrementer.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace klee {
+
+namespace {
+/// A parsed S-expression of a solver response.
+struct SExpr {
+  std::string atom;
+  std::vector<SExpr> list;
+  bool isAtom() const { return !atom.empty(); }
+};
+
+/// Find the end of the first S-expression in \a s at or after \a begin.
+///
+/// \return The position past its end, or std::string::npos if it is not
+/// complete yet.
+size_t findSExprEnd(const std::string &s, size_t &begin) {
+  while (begin != s.size() && isspace((unsigned char)s[begin]))
+    ++begin;
+  if (begin == s.size())
+    return std::string::npos;
+
+  size_t i = begin;
+  if (s[i] != '(') {
+    // an atom ends before a space or parenthesis, which has to be read to
+    // know it is complete
+    if (s[i] == '|' || s[i] == '"') {
+      size_t close = s.find(s[i], i + 1);
+      return close == std::string::npos ? close : close + 1;
+    }
+    while (i != s.size() && !isspace((unsigned char)s[i]) && s[i] != '(' &&
+           s[i] != ')')
+      ++i;
+    return i == s.size() ? std::string::npos : i;
+  }
+
+  unsigned depth = 0;
+  for (; i != s.size(); ++i) {
+    char c = s[i];
+    if (c == '|' || c == '"') {
+      // a quoted symbol or string literal (with "" escaping a quote)
+      size_t close = s.find(c, i + 1);
+      if (close == std::string::npos)
+        return std::string::npos;
+      i = close;
+    } else if (c == '(') {
+      ++depth;
+    } else if (c == ')' && --depth == 0) {
+      return i + 1;
+    }
+  }
+  return std::string::npos;
+}
+
+/// Parse the S-expression starting at \a pos of a complete response.
+void parseSExpr(const std::string &s, size_t &pos, SExpr &result) {
+  while (pos != s.size() && isspace((unsigned char)s[pos]))
+    ++pos;
+  if (pos == s.size())
+    return;
+  if (s[pos] == '(') {
+    ++pos;
+    for (;;) {
+      while (pos != s.size() && isspace((unsigned char)s[pos]))
+        ++pos;
+      if (pos == s.size() || s[pos] == ')')
+        break;
+      result.list.push_back(SExpr());
+      parseSExpr(s, pos, result.list.back());
+    }
+    if (pos != s.size())
+      ++pos;
+    return;
+  }
+  size_t begin = pos;
+  if (s[pos] == '|' || s[pos] == '"') {
+    size_t close = s.find(s[pos], pos + 1);
+    pos = close == std::string::npos ? s.size() : close + 1;
+  } else {
+    while (pos != s.size() && !isspace((unsigned char)s[pos]) &&
+           s[pos] != '(' && s[pos] != ')')
+      ++pos;
+  }
+  result.atom = s.substr(begin, pos - begin);
+}
+
+/// Read a bitvector constant in any of the forms #x.., #b.. or (_ bvN W).
+bool parseBitVector(const SExpr &e, uint64_t &value) {
+  const char *digits;
+  int base;
+  if (e.isAtom() && e.atom.compare(0, 2, "#x") == 0) {
+    digits = e.atom.c_str() + 2;
+    base = 16;
+  } else if (e.isAtom() && e.atom.compare(0, 2, "#b") == 0) {
+    digits = e.atom.c_str() + 2;
+    base = 2;
+  } else if (e.list.size() == 3 && e.list[0].atom == "_" &&
+             e.list[1].atom.compare(0, 2, "bv") == 0) {
+    digits = e.list[1].atom.c_str() + 2;
+    base = 10;
+  } else {
+    return false;
+  }
+  char *end;
+  value = strtoull(digits, &end, base);
+  return end != digits && *end == '\0';
+}
+
+/// Prints the pieces of a query one command at a time, so that they can
+/// be streamed to a solver between push and pop.
+class StreamingPrinter : public ExprSMTLIBPrinter {
+public:
+  StreamingPrinter() { setHumanReadable(false); }
+
+  /// Print (assert \a e), preceded by the declarations of the arrays it
+  /// uses which are not in \a arrays yet. These are added to \a arrays at
+  /// \a level.
+  void printAssertion(const ref<Expr> &e,
+                      std::map<const Array *, size_t> &arrays, size_t level) {
+    ConstraintManager noConstraints;
+    Query assertion(noConstraints, Expr::createIsZero(e));
+    setQuery(assertion);
+
+    for (const Array *array : usedArrays) {
+      if (!arrays.emplace(array, level).second)
+        continue;
+      *o << "(declare-fun " << array->name << " () (Array (_ BitVec "
+         << array->getDomain() << ") (_ BitVec " << array->getRange()
+         << ")))\n";
+      for (unsigned i = 0; i != array->constantValues.size(); ++i) {
+        *o << "(assert (= (select " << array->name << " (_ bv" << i << " "
+           << array->getDomain() << ")) ";
+        printConstant(array->constantValues[i]);
+        *o << "))\n";
+      }
+    }
+
+    // negates the negation of e
+    printQueryInSingleAssert();
+  }
+};
+}
+
+class SMTLIBSolverImpl : public SolverImpl {
+private:
+  std::string command;
+  time::Span timeout;
+  SolverRunStatus runStatusCode;
+
+  pid_t pid = -1;
+  /// The socket connected to both the standard input and output of the
+  /// solver process.
+  int fd = -1;
+  /// Output of the solver read, but not parsed yet.
+  std::string pending;
+
+  /// The constraints asserted in the solver, each in its own scope, so that
+  /// it can be popped back to the prefix it shares with the next query.
+  std::vector<ref<Expr> > asserted;
+  /// Number of scopes at the point an array was declared.
+  std::map<const Array *, size_t> arrays;
+
+  std::string buffer;
+  llvm::raw_string_ostream stream;
+  StreamingPrinter printer;
+
+  bool start();
+  void stop();
+  bool send(const std::string &commands);
+  /// Read the next S-expression the solver prints.
+  bool receive(std::string &response, time::Point deadline);
+
+  bool internalRunSolver(const Query &,
+                         std::shared_ptr<const Assignment> &result,
+                         bool &hasSolution, bool needsModel);
+  bool getModel(const Query &query, time::Point deadline,
+                std::shared_ptr<const Assignment> &result);
+
+public:
+  SMTLIBSolverImpl(const std::string &command);
+  ~SMTLIBSolverImpl();
+
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(time::Span _timeout) { timeout = _timeout; }
+
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+};
+
+SMTLIBSolverImpl::SMTLIBSolverImpl(const std::string &command)
+    : command(command), runStatusCode(SOLVER_RUN_STATUS_FAILURE),
+      stream(buffer) {
+  printer.setOutput(stream);
+}
+
+SMTLIBSolverImpl::~SMTLIBSolverImpl() { stop(); }
+
+bool SMTLIBSolverImpl::start() {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds)) {
+    klee_warning("SMT-LIB solver: socketpair failed: %s", strerror(errno));
+    return false;
+  }
+
+  pid = fork();
+  if (pid == -1) {
+    klee_warning("SMT-LIB solver: fork failed: %s", strerror(errno));
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+  if (pid == 0) {
+    // dup2 clears close-on-exec for the copies
+    dup2(fds[1], STDIN_FILENO);
+    dup2(fds[1], STDOUT_FILENO);
+    execl("/bin/sh", "sh", "-c", command.c_str(), (char *)0);
+    _exit(127);
+  }
+
+  close(fds[1]);
+  fd = fds[0];
+  pending.clear();
+  asserted.clear();
+  arrays.clear();
+  return send("(set-option :print-success false)\n"
+              "(set-option :produce-models true)\n"
+              "(set-logic QF_ABV)\n");
+}
+
+void SMTLIBSolverImpl::stop() {
+  if (fd != -1)
+    close(fd);
+  if (pid > 0) {
+    kill(pid, SIGKILL);
+    while (waitpid(pid, 0, 0) == -1 && errno == EINTR)
+      ;
+  }
+  fd = -1;
+  pid = -1;
+}
+
+bool SMTLIBSolverImpl::send(const std::string &commands) {
+  for (size_t written = 0; written != commands.size();) {
+    ssize_t n = ::send(fd, commands.data() + written,
+                       commands.size() - written, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return false;
+    written += n;
+  }
+  return true;
+}
+
+bool SMTLIBSolverImpl::receive(std::string &response, time::Point deadline) {
+  for (;;) {
+    size_t begin = 0, end = findSExprEnd(pending, begin);
+    if (end != std::string::npos) {
+      response = pending.substr(begin, end - begin);
+      pending.erase(0, end);
+      return true;
+    }
+
+    int wait = -1;
+    if (timeout) {
+      time::Point now = time::getWallTime();
+      if (now >= deadline) {
+        runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+        return false;
+      }
+      wait = std::max<int64_t>(1, (deadline - now).toMicroseconds() / 1000);
+    }
+    struct pollfd pfd = {fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, wait);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready < 0)
+      return false;
+    if (ready == 0) {
+      runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+      return false;
+    }
+
+    char chunk[4096];
+    ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      klee_warning_once(0, "SMT-LIB solver: the solver process (%s) stopped",
+                        command.c_str());
+      return false;
+    }
+    pending.append(chunk, n);
+  }
+}
+
+char *SMTLIBSolverImpl::getConstraintLog(const Query &query) {
+  std::string log;
+  llvm::raw_string_ostream os(log);
+  ExprSMTLIBPrinter logPrinter;
+  logPrinter.setOutput(os);
+  logPrinter.setQuery(query);
+  logPrinter.generateOutput();
+  os.flush();
+  // Client is responsible for freeing the returned C-string
+  return strdup(log.c_str());
+}
+
+bool SMTLIBSolverImpl::computeTruth(const Query &query, bool &isValid) {
+  bool hasSolution = false;
+  std::shared_ptr<const Assignment> result;
+  bool status = internalRunSolver(query, result, hasSolution, false);
+  isValid = !hasSolution;
+  return status;
+}
+
+bool SMTLIBSolverImpl::computeValue(const Query &query, ref<Expr> &result) {
+  std::shared_ptr<const Assignment> assignment;
+  bool hasSolution;
+
+  if (!computeInitialValues(query.withFalse(), assignment, hasSolution))
+    return false;
+  assert(hasSolution && "state has invalid constraint set");
+
+  // Evaluate the expression with the computed assignment.
+  result = assignment->evaluate(query.expr);
+
+  return true;
+}
+
+bool SMTLIBSolverImpl::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  return internalRunSolver(query, result, hasSolution, true);
+}
+
+bool SMTLIBSolverImpl::internalRunSolver(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution, bool needsModel) {
+  TimerStatIncrementer t(stats::queryTime);
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+  if (fd == -1 && !start()) {
+    stop();
+    return false;
+  }
+
+  // pop back to the prefix shared with the query
+  size_t common = 0;
+  auto it = query.constraints.begin(), ie = query.constraints.end();
+  for (; common != asserted.size() && it != ie; ++common, ++it)
+    if (asserted[common].get() != it->get())
+      break;
+  stats::queryIncrementalReuses += common;
+
+  buffer.clear();
+  if (size_t pop = asserted.size() - common) {
+    stream << "(pop " << pop << ")\n";
+    asserted.resize(common);
+    for (auto ai = arrays.begin(); ai != arrays.end();) {
+      if (ai->second > common)
+        ai = arrays.erase(ai);
+      else
+        ++ai;
+    }
+  }
+  for (; it != ie; ++it) {
+    stream << "(push 1)\n";
+    asserted.push_back(*it);
+    printer.printAssertion(*it, arrays, asserted.size());
+    ++stats::queryIncrementalAsserts;
+  }
+
+  // The query expression is not a literal, so rather than as an assumption
+  // of check-sat-assuming it is asserted in a scope of its own.
+  //
+  // KLEE Queries are validity queries i.e.
+  // ∀ X Constraints(X) → query(X)
+  // but SMT-LIB works in terms of satisfiability so instead we ask the
+  // negation of the equivalent i.e.
+  // ∃ X Constraints(X) ∧ ¬ query(X)
+  stream << "(push 1)\n";
+  std::map<const Array *, size_t> queryArrays(arrays);
+  printer.printAssertion(Expr::createIsZero(query.expr), queryArrays,
+                         asserted.size() + 1);
+  stream << "(check-sat)\n";
+  stream.flush();
+
+  ++stats::queries;
+  if (needsModel)
+    ++stats::queryCounterexamples;
+
+  time::Point deadline = time::getWallTime() + timeout;
+  std::string response;
+  bool success = send(buffer) && receive(response, deadline);
+  if (success && response == "sat") {
+    hasSolution = true;
+    if (needsModel)
+      success = getModel(query, deadline, result);
+  } else if (success && response == "unsat") {
+    hasSolution = false;
+  } else if (success) {
+    if (response != "unknown")
+      klee_warning("SMT-LIB solver: unexpected response: %s",
+                   response.c_str());
+    success = false;
+  }
+  if (success)
+    success = send("(pop 1)\n");
+
+  if (!success) {
+    // The solver state is unknown (e.g. it is still busy with a query that
+    // timed out), so it is started afresh for the next query.
+    stop();
+    return false;
+  }
+
+  runStatusCode = hasSolution ? SOLVER_RUN_STATUS_SUCCESS_SOLVABLE
+                              : SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+  if (hasSolution) {
+    ++stats::queriesInvalid;
+  } else {
+    ++stats::queriesValid;
+  }
+  return true;
+}
+
+bool SMTLIBSolverImpl::getModel(const Query &query, time::Point deadline,
+                                std::shared_ptr<const Assignment> &result) {
+  std::vector<ref<Expr> > exprs(query.constraints.begin(),
+                                query.constraints.end());
+  exprs.push_back(query.expr);
+  std::vector<const Array *> objects;
+  findSymbolicObjects(exprs.begin(), exprs.end(), objects);
+
+  auto assignment = std::make_shared<Assignment>();
+  for (const Array *array : objects) {
+    if (array->isConstantArray() || !array->size)
+      continue;
+
+    buffer.clear();
+    stream << "(get-value (";
+    for (unsigned i = 0; i != array->size; ++i)
+      stream << "(select " << array->name << " (_ bv" << i << " "
+             << array->getDomain() << ")) ";
+    stream << "))\n";
+    stream.flush();
+
+    std::string response;
+    if (!send(buffer) || !receive(response, deadline))
+      return false;
+
+    // ((term value) (term value) ...)
+    SExpr values;
+    size_t pos = 0;
+    parseSExpr(response, pos, values);
+    if (values.list.size() != array->size) {
+      klee_warning("SMT-LIB solver: unexpected model: %s", response.c_str());
+      return false;
+    }
+    std::vector<unsigned char> data(array->size);
+    for (unsigned i = 0; i != array->size; ++i) {
+      uint64_t value;
+      if (values.list[i].list.size() != 2 ||
+          !parseBitVector(values.list[i].list[1], value)) {
+        klee_warning("SMT-LIB solver: unexpected model: %s",
+                     response.c_str());
+        return false;
+      }
+      data[i] = value;
+    }
+    assignment->addBinding(array, data);
+  }
+
+  result = assignment;
+  return true;
+}
+
+SolverImpl::SolverRunStatus SMTLIBSolverImpl::getOperationStatusCode() {
+  return runStatusCode;
+}
+
+SMTLIBSolver::SMTLIBSolver(const std::string &command)
+    : Solver(new SMTLIBSolverImpl(command)) {}
+
+char *SMTLIBSolver::getConstraintLog(const Query &query) {
+  return impl->getConstraintLog(query);
+}
+
+void SMTLIBSolver::setCoreSolverTimeout(time::Span timeout) {
+  impl->setCoreSolverTimeout(timeout);
+}
+}
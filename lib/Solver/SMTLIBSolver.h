@@ -0,0 +1,40 @@
+//===-- SMTLIBSolver.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SMTLIBSOLVER_H
+#define KLEE_SMTLIBSOLVER_H
+
+#include "klee/Solver/Solver.h"
+
+#include <string>
+
+namespace klee {
+/// SMTLIBSolver - A complete solver that talks SMT-LIBv2 to an external
+/// solver process (e.g. Bitwuzla, Yices2 or CVC5) kept running in
+/// interactive mode across queries.
+class SMTLIBSolver : public Solver {
+public:
+  /// SMTLIBSolver - Construct a new SMTLIBSolver.
+  ///
+  /// \param command - The shell command starting the solver, which has to
+  /// read SMT-LIBv2 commands from its standard input and answer them on its
+  /// standard output.
+  SMTLIBSolver(const std::string &command);
+
+  /// Get the query in SMT-LIBv2 format.
+  /// \return A C-style string. The caller is responsible for freeing this.
+  virtual char *getConstraintLog(const Query &);
+
+  /// setCoreSolverTimeout - Set constraint solver timeout delay to the given
+  /// value; 0 is off.
+  virtual void setCoreSolverTimeout(time::Span timeout);
+};
+}
+
+#endif /* KLEE_SMTLIBSOLVER_H */
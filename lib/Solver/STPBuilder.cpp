@@ -11,6 +11,7 @@
 #include "STPBuilder.h"
 
 #include "klee/Expr/Expr.h"
+#include "klee/OptionCategories.h"
 #include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverStats.h"
 #include "klee/util/Bits.h"
@@ -48,6 +49,13 @@ namespace {
                    llvm::cl::desc("Use hash-consing during STP query construction (default=true)"),
                    llvm::cl::init(true),
                    llvm::cl::cat(klee::ExprCat));
+
+  llvm::cl::opt<unsigned> STPUpdateCacheSize(
+      "stp-update-cache-size",
+      llvm::cl::desc("Number of array updates whose STP encoding is kept "
+                     "across queries, 0 to keep them all (default=100000)"),
+      llvm::cl::init(100000),
+      llvm::cl::cat(klee::SolvingCat));
 }
 
 ///
@@ -63,14 +71,24 @@ STPArrayExprHash::~STPArrayExprHash() {
   }
 
 
+  clearUpdateNodes();
+}
+
+void STPArrayExprHash::hashUpdateList(const UpdateList &ul, ::VCExpr exp) {
+  assert(ul.head && !_update_node_hash.count(ul.head));
+  hashUpdateNodeExpr(ul.head, exp);
+  updateLists.push_back(ul);
+}
+
+void STPArrayExprHash::clearUpdateNodes() {
   for (UpdateNodeHashConstIter it = _update_node_hash.begin();
       it != _update_node_hash.end(); ++it) {
     ::VCExpr un_expr = it->second;
-    if (un_expr) {
+    if (un_expr)
       ::vc_DeleteExpr(un_expr);
-      un_expr = 0;
-    }
   }
+  _update_node_hash.clear();
+  updateLists.clear();
 }
 
 /***/
@@ -485,13 +503,19 @@ ExprHandle STPBuilder::getInitialRead(const Array *root, unsigned index) {
                                construct(un->index, 0),
                                construct(un->value, 0));
 	
-	_arr_hash.hashUpdateNodeExpr(un, un_expr);
+	_arr_hash.hashUpdateList(UpdateList(root, un), un_expr);
       }
       
       return un_expr;
   }
 }
 
+void STPBuilder::limitCache() {
+  // The arrays stay, STP tells them apart by the names they were given.
+  if (STPUpdateCacheSize && _arr_hash.numUpdateNodes() > STPUpdateCacheSize)
+    _arr_hash.clearUpdateNodes();
+}
+
 /** if *width_out!=1 then result is a bitvector,
     otherwise it is a bool */
 ExprHandle STPBuilder::construct(ref<Expr> e, int *width_out) {
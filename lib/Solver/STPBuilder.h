@@ -56,10 +56,20 @@ namespace klee {
   class STPArrayExprHash : public ArrayExprHash< ::VCExpr > {
     
     friend class STPBuilder;
-    
+
+    /// The update lists whose heads are hashed, which keep the update
+    /// nodes alive for as long as they are, so that the hash can be kept
+    /// across queries.
+    std::vector<UpdateList> updateLists;
+
   public:
     STPArrayExprHash() {};
     virtual ~STPArrayExprHash();
+
+    void hashUpdateList(const UpdateList &ul, ::VCExpr exp);
+    size_t numUpdateNodes() const { return _update_node_hash.size(); }
+    /// Forget the hashed update nodes, releasing them.
+    void clearUpdateNodes();
   };
 
 class STPBuilder {
@@ -119,6 +129,10 @@ public:
   ExprHandle getFalse();
   ExprHandle getInitialRead(const Array *os, unsigned index);
 
+  /// Drop the encodings of update lists kept from earlier queries if there
+  /// are too many of them. Must not be called while a query is being built.
+  void limitCache();
+
   ExprHandle construct(ref<Expr> e) { 
     ExprHandle res = construct(e, 0);
     constructed.clear();
@@ -15,17 +15,26 @@
 
 #include "klee/Expr/Assignment.h"
 #include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprBuilder.h"
+#include "klee/Expr/ExprPPrinter.h"
 #include "klee/Expr/ExprUtil.h"
+#include "klee/Expr/Parser/Parser.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/Time.h"
 #include "klee/OptionCategories.h"
 #include "klee/Solver/SolverImpl.h"
 
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Errno.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include <csignal>
-#include <sys/ipc.h>
-#include <sys/shm.h>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <poll.h>
+#include <sys/socket.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -44,19 +53,6 @@ llvm::cl::opt<bool> IgnoreSolverFailures(
 
 #define vc_bvBoolExtract IAMTHESPAWNOFSATAN
 
-static unsigned char *shared_memory_ptr = nullptr;
-static int shared_memory_id = 0;
-// Darwin by default has a very small limit on the maximum amount of shared
-// memory, which will quickly be exhausted by KLEE running its tests in
-// parallel. For now, we work around this by just requesting a smaller size --
-// in practice users hitting this limit on counterexample sizes probably already
-// are hitting more serious scalability issues.
-#ifdef __APPLE__
-static const unsigned shared_memory_size = 1 << 16;
-#else
-static const unsigned shared_memory_size = 1 << 20;
-#endif
-
 static void stp_error_handler(const char *err_msg) {
   fprintf(stderr, "error: STP Error: %s\n", err_msg);
   abort();
@@ -64,12 +60,49 @@ static void stp_error_handler(const char *err_msg) {
 
 namespace klee {
 
+/// STPWorkerPool - STP processes that solve queries sent to them as KQuery
+/// text, so that a forked solver does not cost a fork of the whole KLEE
+/// process for every query. The workers are forked by a spawner process
+/// that is itself forked when the solver is created, while KLEE is still
+/// small; it passes the socket of each new worker back over a UNIX socket.
+class STPWorkerPool {
+private:
+  struct Worker {
+    pid_t pid;
+    int fd;
+    unsigned queries;
+  };
+
+  VC vc;
+  bool optimizeDivides;
+  pid_t spawnerPid;
+  int spawner;
+  /// Workers ready for the next query.
+  std::vector<Worker> idle;
+
+  void runSpawner();
+  void runWorker(int fd);
+  std::string solveInWorker(const std::string &text);
+  bool spawn(Worker &worker);
+  void kill(Worker &worker);
+
+public:
+  STPWorkerPool(VC vc, bool optimizeDivides);
+  ~STPWorkerPool();
+
+  SolverImpl::SolverRunStatus
+  solve(const Query &query, const std::vector<const Array *> &objects,
+        std::vector<std::vector<unsigned char>> &values, bool &hasSolution,
+        time::Span timeout);
+};
+
 class STPSolverImpl : public SolverImpl {
 private:
   VC vc;
   STPBuilder *builder;
   time::Span timeout;
   bool useForkedSTP;
+  STPWorkerPool *workers;
   SolverRunStatus runStatusCode;
 
 public:
@@ -91,7 +124,8 @@ public:
 STPSolverImpl::STPSolverImpl(bool useForkedSTP, bool optimizeDivides)
     : vc(vc_createValidityChecker()),
       builder(new STPBuilder(vc, optimizeDivides)),
-      useForkedSTP(useForkedSTP), runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+      useForkedSTP(useForkedSTP), workers(nullptr),
+      runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
   assert(vc && "unable to create validity checker");
   assert(builder && "unable to create STPBuilder");
 
@@ -107,24 +141,12 @@ STPSolverImpl::STPSolverImpl(bool useForkedSTP, bool optimizeDivides)
 
   vc_registerErrorHandler(::stp_error_handler);
 
-  if (useForkedSTP) {
-    assert(shared_memory_id == 0 && "shared memory id already allocated");
-    shared_memory_id =
-        shmget(IPC_PRIVATE, shared_memory_size, IPC_CREAT | 0700);
-    if (shared_memory_id < 0)
-      llvm::report_fatal_error("unable to allocate shared memory region");
-    shared_memory_ptr = (unsigned char *)shmat(shared_memory_id, nullptr, 0);
-    if (shared_memory_ptr == (void *)-1)
-      llvm::report_fatal_error("unable to attach shared memory region");
-    shmctl(shared_memory_id, IPC_RMID, nullptr);
-  }
+  if (useForkedSTP)
+    workers = new STPWorkerPool(vc, optimizeDivides);
 }
 
 STPSolverImpl::~STPSolverImpl() {
-  // Detach the memory region.
-  shmdt(shared_memory_ptr);
-  shared_memory_ptr = nullptr;
-  shared_memory_id = 0;
+  delete workers;
 
   delete builder;
 
@@ -134,6 +156,7 @@ STPSolverImpl::~STPSolverImpl() {
 /***/
 
 char *STPSolverImpl::getConstraintLog(const Query &query) {
+  builder->limitCache();
   vc_push(vc);
 
   for (const auto &constraint : query.constraints)
@@ -207,112 +230,303 @@ runAndGetCex(::VC vc, STPBuilder *builder, ::VCExpr q,
   return SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
 }
 
-static void stpTimeoutHandler(int x) { _exit(52); }
+/***/
 
-static SolverImpl::SolverRunStatus
-runAndGetCexForked(::VC vc, STPBuilder *builder, ::VCExpr q,
-                   const std::vector<const Array *> &objects,
-                   std::vector<std::vector<unsigned char>> &values,
-                   bool &hasSolution, time::Span timeout) {
-  unsigned char *pos = shared_memory_ptr;
-  unsigned sum = 0;
-  for (const auto object : objects)
-    sum += object->size;
-  if (sum >= shared_memory_size)
-    llvm::report_fatal_error("not enough shared memory for counterexample");
+// A worker is retired after this many queries, so that what STP keeps
+// allocated for old queries does not pile up.
+static const unsigned maxWorkerQueries = 1000;
+
+// Result codes sent back by a worker, in front of the counterexample.
+enum { WorkerSolvable, WorkerUnsolvable, WorkerFailed };
+
+static bool writeAll(int fd, const char *data, size_t size) {
+  while (size) {
+    ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool readAll(int fd, char *data, size_t size) {
+  while (size) {
+    ssize_t n = read(fd, data, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool writeMessage(int fd, const std::string &message) {
+  uint32_t size = message.size();
+  return writeAll(fd, reinterpret_cast<const char *>(&size), sizeof(size)) &&
+         writeAll(fd, message.data(), size);
+}
+
+static bool readMessage(int fd, std::string &message) {
+  uint32_t size;
+  if (!readAll(fd, reinterpret_cast<char *>(&size), sizeof(size)))
+    return false;
+  message.resize(size);
+  return readAll(fd, &message[0], size);
+}
+
+STPWorkerPool::STPWorkerPool(VC vc, bool optimizeDivides)
+    : vc(vc), optimizeDivides(optimizeDivides), spawnerPid(-1), spawner(-1) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+    llvm::report_fatal_error("unable to create socket for STP workers");
 
   fflush(stdout);
   fflush(stderr);
-
-  // fork solver
-  int pid = fork();
-  // - error
-  if (pid == -1) {
-    klee_warning("fork failed (for STP) - %s", llvm::sys::StrError(errno).c_str());
-    if (!IgnoreSolverFailures)
-      exit(1);
-    return SolverImpl::SOLVER_RUN_STATUS_FORK_FAILED;
+  spawnerPid = fork();
+  if (spawnerPid == -1)
+    llvm::report_fatal_error("unable to fork STP worker spawner");
+  if (spawnerPid == 0) {
+    close(fds[0]);
+    spawner = fds[1];
+    runSpawner();
+    _exit(0);
   }
-  // - child (solver)
-  if (pid == 0) {
-    if (timeout) {
-      ::alarm(0); /* Turn off alarm so we can safely set signal handler */
-      ::signal(SIGALRM, stpTimeoutHandler);
-      ::alarm(std::max(1u, static_cast<unsigned>(timeout.toSeconds())));
-    }
-    int res = vc_query(vc, q);
-    if (!res) {
-      for (const auto object : objects) {
-        for (unsigned offset = 0; offset < object->size; offset++) {
-          ExprHandle counter =
-              vc_getCounterExample(vc, builder->getInitialRead(object, offset));
-          *pos++ = static_cast<unsigned char>(getBVUnsigned(counter));
-        }
+  close(fds[1]);
+  spawner = fds[0];
+}
+
+STPWorkerPool::~STPWorkerPool() {
+  for (Worker &worker : idle)
+    kill(worker);
+  // the spawner exits once its socket is closed
+  close(spawner);
+  int status;
+  while (waitpid(spawnerPid, &status, 0) < 0 && errno == EINTR)
+    ;
+}
+
+void STPWorkerPool::runSpawner() {
+  // the workers are not waited for
+  ::signal(SIGCHLD, SIG_IGN);
+
+  char request;
+  while (readAll(spawner, &request, 1)) {
+    int fds[2];
+    pid_t pid = -1;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0) {
+      pid = fork();
+      if (pid == 0) {
+        close(spawner);
+        close(fds[0]);
+        ::signal(SIGCHLD, SIG_DFL);
+        runWorker(fds[1]);
+        _exit(0);
       }
+      close(fds[1]);
     }
-    _exit(res);
-  // - parent
-  } else {
-    int status;
-    pid_t res;
 
+    // send the pid, and the socket of the worker along with it
+    struct msghdr msg = {};
+    struct iovec iov = {&pid, sizeof(pid)};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    if (pid > 0) {
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+      memcpy(CMSG_DATA(cmsg), &fds[0], sizeof(int));
+    }
+    ssize_t sent;
     do {
-      res = waitpid(pid, &status, 0);
-    } while (res < 0 && errno == EINTR);
-
-    if (res < 0) {
-      klee_warning("waitpid() for STP failed");
-      if (!IgnoreSolverFailures)
-        exit(1);
-      return SolverImpl::SOLVER_RUN_STATUS_WAITPID_FAILED;
+      sent = sendmsg(spawner, &msg, 0);
+    } while (sent < 0 && errno == EINTR);
+    if (pid > 0)
+      close(fds[0]);
+    if (sent < 0)
+      break;
+  }
+}
+
+void STPWorkerPool::runWorker(int fd) {
+  std::string text;
+  while (readMessage(fd, text)) {
+    if (!writeMessage(fd, solveInWorker(text)))
+      break;
+  }
+}
+
+std::string STPWorkerPool::solveInWorker(const std::string &text) {
+  std::string result(1, WorkerFailed);
+
+  // The arrays of a query only live as long as its parser, which is why
+  // every query gets a fresh builder.
+  std::unique_ptr<llvm::MemoryBuffer> MB =
+      llvm::MemoryBuffer::getMemBuffer(text, "stp-query", false);
+  std::unique_ptr<ExprBuilder> exprBuilder(createDefaultExprBuilder());
+  std::unique_ptr<expr::Parser> P(
+      expr::Parser::Create("stp-query", MB.get(), exprBuilder.get(), false));
+  std::vector<expr::Decl *> decls;
+  expr::QueryCommand *QC = 0;
+  while (expr::Decl *D = P->ParseTopLevelDecl()) {
+    decls.push_back(D);
+    if (!QC)
+      QC = dyn_cast<expr::QueryCommand>(D);
+  }
+
+  if (QC && !P->GetNumErrors()) {
+    STPBuilder builder(vc, optimizeDivides);
+    vc_push(vc);
+    for (const auto &constraint : QC->Constraints)
+      vc_assertFormula(vc, builder.construct(constraint));
+    ExprHandle stp_e = builder.construct(QC->Query);
+
+    if (DebugDumpSTPQueries) {
+      char *buf;
+      unsigned long len;
+      vc_printQueryStateToBuffer(vc, stp_e, &buf, &len, false);
+      klee_warning("STP query:\n%.*s\n", (unsigned)len, buf);
+      free(buf);
     }
 
-    // From timed_run.py: It appears that linux at least will on
-    // "occasion" return a status when the process was terminated by a
-    // signal, so test signal first.
-    if (WIFSIGNALED(status) || !WIFEXITED(status)) {
-      klee_warning("STP did not return successfully.  Most likely you forgot "
-                   "to run 'ulimit -s unlimited'");
-      if (!IgnoreSolverFailures) {
-        exit(1);
+    if (vc_query(vc, stp_e)) {
+      result[0] = WorkerUnsolvable;
+    } else {
+      result[0] = WorkerSolvable;
+      for (const auto object : QC->Objects) {
+        for (unsigned offset = 0; offset < object->size; offset++) {
+          ExprHandle counter =
+              vc_getCounterExample(vc, builder.getInitialRead(object, offset));
+          result.push_back(static_cast<char>(getBVUnsigned(counter)));
+        }
       }
-      return SolverImpl::SOLVER_RUN_STATUS_INTERRUPTED;
     }
+    vc_pop(vc);
+  }
 
-    int exitcode = WEXITSTATUS(status);
+  for (expr::Decl *D : decls)
+    delete D;
+  return result;
+}
 
-    // solvable
-    if (exitcode == 0) {
-      hasSolution = true;
+bool STPWorkerPool::spawn(Worker &worker) {
+  char request = 0;
+  if (!writeAll(spawner, &request, 1))
+    return false;
 
-      values.reserve(objects.size());
-      for (const auto object : objects) {
-        values.emplace_back(pos, pos + object->size);
-        pos += object->size;
-      }
+  pid_t pid = -1;
+  struct msghdr msg = {};
+  struct iovec iov = {&pid, sizeof(pid)};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  char control[CMSG_SPACE(sizeof(int))] = {};
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t received;
+  do {
+    received = recvmsg(spawner, &msg, 0);
+  } while (received < 0 && errno == EINTR);
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (received != sizeof(pid) || pid <= 0 || !cmsg ||
+      cmsg->cmsg_type != SCM_RIGHTS)
+    return false;
+  worker.pid = pid;
+  memcpy(&worker.fd, CMSG_DATA(cmsg), sizeof(int));
+  worker.queries = 0;
+  return true;
+}
 
-      return SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
-    }
+void STPWorkerPool::kill(Worker &worker) {
+  // the spawner reaps it
+  ::kill(worker.pid, SIGKILL);
+  close(worker.fd);
+}
 
-    // unsolvable
-    if (exitcode == 1) {
-      hasSolution = false;
-      return SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
-    }
+SolverImpl::SolverRunStatus STPWorkerPool::solve(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char>> &values, bool &hasSolution,
+    time::Span timeout) {
+  Worker worker;
+  if (!idle.empty()) {
+    worker = idle.back();
+    idle.pop_back();
+  } else if (!spawn(worker)) {
+    klee_warning("unable to start an STP worker - %s",
+                 llvm::sys::StrError(errno).c_str());
+    if (!IgnoreSolverFailures)
+      exit(1);
+    return SolverImpl::SOLVER_RUN_STATUS_FORK_FAILED;
+  }
+
+  std::string text;
+  llvm::raw_string_ostream os(text);
+  ExprPPrinter::printQuery(os, query.constraints, query.expr, 0, 0,
+                           objects.data(), objects.data() + objects.size());
+  os.flush();
+
+  bool answered = writeMessage(worker.fd, text);
+  if (answered) {
+    struct pollfd pfd = {worker.fd, POLLIN, 0};
+    time::Point deadline = time::getWallTime() + timeout;
+    int ready;
+    do {
+      int wait = -1;
+      if (timeout) {
+        time::Point now = time::getWallTime();
+        wait = now < deadline ? (deadline - now).toMicroseconds() / 1000 : 0;
+      }
+      ready = poll(&pfd, 1, wait);
+    } while (ready < 0 && errno == EINTR);
 
-    // timeout
-    if (exitcode == 52) {
+    if (ready == 0) {
+      kill(worker);
       klee_warning("STP timed out");
       // mark that a timeout occurred
       return SolverImpl::SOLVER_RUN_STATUS_TIMEOUT;
     }
+    answered = ready > 0 && readMessage(worker.fd, text);
+  }
 
-    // unknown return code
-    klee_warning("STP did not return a recognized code");
+  if (!answered || text.empty() || text[0] == WorkerFailed) {
+    kill(worker);
+    klee_warning("STP did not return successfully.  Most likely you forgot "
+                 "to run 'ulimit -s unlimited'");
     if (!IgnoreSolverFailures)
       exit(1);
-    return SolverImpl::SOLVER_RUN_STATUS_UNEXPECTED_EXIT_CODE;
+    return SolverImpl::SOLVER_RUN_STATUS_INTERRUPTED;
+  }
+
+  if (++worker.queries < maxWorkerQueries) {
+    idle.push_back(worker);
+  } else {
+    // the worker exits once its socket is closed
+    close(worker.fd);
   }
+
+  if (text[0] == WorkerUnsolvable) {
+    hasSolution = false;
+    return SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+  }
+
+  hasSolution = true;
+  values.reserve(objects.size());
+  const char *pos = text.data() + 1, *end = text.data() + text.size();
+  for (const auto object : objects) {
+    if (static_cast<size_t>(end - pos) < object->size)
+      llvm::report_fatal_error("truncated counterexample from STP worker");
+    values.emplace_back(pos, pos + object->size);
+    pos += object->size;
+  }
+  return SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
 }
 
 bool STPSolverImpl::computeInitialValues(
@@ -321,34 +535,39 @@ bool STPSolverImpl::computeInitialValues(
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
   TimerStatIncrementer t(stats::queryTime);
 
-  vc_push(vc);
-
-  for (const auto &constraint : query.constraints)
-    vc_assertFormula(vc, builder->construct(constraint));
-
   ++stats::queries;
   ++stats::queryCounterexamples;
 
-  ExprHandle stp_e = builder->construct(query.expr);
-
-  if (DebugDumpSTPQueries) {
-    char *buf;
-    unsigned long len;
-    vc_printQueryStateToBuffer(vc, stp_e, &buf, &len, false);
-    klee_warning("STP query:\n%.*s\n", (unsigned)len, buf);
-    free(buf);
-  }
-
   bool success;
   if (useForkedSTP) {
-    runStatusCode = runAndGetCexForked(vc, builder, stp_e, objects, values,
-                                       hasSolution, timeout);
+    // the worker builds the query itself
+    runStatusCode =
+        workers->solve(query, objects, values, hasSolution, timeout);
     success = ((SOLVER_RUN_STATUS_SUCCESS_SOLVABLE == runStatusCode) ||
                (SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE == runStatusCode));
   } else {
+    // the encodings of update lists are kept from one query to the next
+    builder->limitCache();
+    vc_push(vc);
+
+    for (const auto &constraint : query.constraints)
+      vc_assertFormula(vc, builder->construct(constraint));
+
+    ExprHandle stp_e = builder->construct(query.expr);
+
+    if (DebugDumpSTPQueries) {
+      char *buf;
+      unsigned long len;
+      vc_printQueryStateToBuffer(vc, stp_e, &buf, &len, false);
+      klee_warning("STP query:\n%.*s\n", (unsigned)len, buf);
+      free(buf);
+    }
+
     runStatusCode =
         runAndGetCex(vc, builder, stp_e, objects, values, hasSolution);
     success = true;
+
+    vc_pop(vc);
   }
 
   if (success) {
@@ -358,8 +577,6 @@ bool STPSolverImpl::computeInitialValues(
       ++stats::queriesValid;
   }
 
-  vc_pop(vc);
-
   return success;
 }
 
@@ -70,6 +70,35 @@ bool Solver::mayBeTrue(const Query& query, bool &result) {
   return true;
 }
 
+bool Solver::mayBeTrue(const ConstraintManager &constraints,
+                       const std::vector<ref<Expr>> &exprs,
+                       std::vector<bool> &results) {
+  results.assign(exprs.size(), false);
+
+  // Maintain invariants implementations expect.
+  std::vector<ref<Expr>> negated;
+  std::vector<unsigned> positions;
+  for (unsigned i = 0; i != exprs.size(); ++i) {
+    assert(exprs[i]->getWidth() == Expr::Bool && "Invalid expression type!");
+    ref<Expr> e = Expr::createIsZero(exprs[i]);
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
+      results[i] = CE->isFalse();
+      continue;
+    }
+    negated.push_back(e);
+    positions.push_back(i);
+  }
+  if (negated.empty())
+    return true;
+
+  std::vector<bool> valid;
+  if (!impl->computeTruths(constraints, negated, valid))
+    return false;
+  for (unsigned i = 0; i != positions.size(); ++i)
+    results[positions[i]] = !valid[i];
+  return true;
+}
+
 bool Solver::mayBeFalse(const Query& query, bool &result) {
   bool res;
   if (!mustBeTrue(query, res))
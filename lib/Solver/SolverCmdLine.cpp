@@ -51,6 +51,22 @@ cl::opt<bool> UseBranchCache("use-branch-cache", cl::init(true),
                              cl::desc("Use the branch cache (default=true)"),
                              cl::cat(SolvingCat));
 
+cl::opt<bool> UseUnsatCoreCache(
+    "use-unsat-core-cache", cl::init(false),
+    cl::desc("Remember why the queries the core solver finds infeasible are, "
+             "and answer the queries including such a reason without asking "
+             "it. Only supported by Z3 without -z3-incremental "
+             "(default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> CanonicalizeCacheArrays(
+    "canonicalize-cache-arrays", cl::init(false),
+    cl::desc("Rename the arrays of a query by first occurrence before looking "
+             "it up in the branch and counterexample caches, so that queries "
+             "of different states differing only in array names share "
+             "entries (default=false)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool>
     UseIndependentSolver("use-independent-solver", cl::init(true),
                          cl::desc("Use constraint independence (default=true)"),
@@ -62,6 +78,25 @@ cl::opt<bool> DebugValidateSolver(
              "with the results of the core solver (default=false)"),
     cl::cat(SolvingCat));
 
+cl::opt<unsigned> DebugValidateSolverRate(
+    "debug-validate-solver-rate", cl::init(100),
+    cl::desc("Percentage of the queries -debug-validate-solver crosschecks, "
+             "spread evenly over the run (default=100)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> DebugValidateSolverCachedOnly(
+    "debug-validate-solver-cached-only", cl::init(false),
+    cl::desc("Only crosscheck the queries the solver chain answered without "
+             "querying the core solver, e.g. from its caches (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> DebugValidateSolverJobs(
+    "debug-validate-solver-jobs", cl::init(0),
+    cl::desc("Crosscheck in up to this many forked processes, without waiting "
+             "for them, instead of in place. Queries arriving while all of "
+             "them are busy are not crosschecked (default=0)"),
+    cl::cat(SolvingCat));
+
 cl::opt<std::string> MinQueryTimeToLog(
     "min-query-time-to-log",
     cl::desc("Set time threshold for queries logged in files. "
@@ -90,6 +125,21 @@ cl::opt<bool> CoreSolverOptimizeDivides(
              "passing them to the core SMT solver (default=false)"),
     cl::init(false), cl::cat(SolvingCat));
 
+cl::opt<std::string> SMTLIBSolverCommand(
+    "smtlib-solver-command",
+    cl::desc("Shell command starting the solver used by "
+             "-solver-backend=smtlib, which has to read SMT-LIBv2 from its "
+             "standard input, e.g. \"yices-smt2 --incremental\" or "
+             "\"cvc5 --lang smt2 --incremental\" (default=bitwuzla)"),
+    cl::init("bitwuzla"), cl::cat(SolvingCat));
+
+cl::opt<std::string> RemoteSolverAddress(
+    "remote-solver-address",
+    cl::desc("The solver service (kleaver -serve) used by "
+             "-solver-backend=remote, as host:port "
+             "(default=localhost:7447)"),
+    cl::init("localhost:7447"), cl::cat(SolvingCat));
+
 cl::bits<QueryLoggingSolverType> QueryLoggingOptions(
     "use-query-log",
     cl::desc("Log queries to a file. Multiple options can be specified "
@@ -104,10 +154,46 @@ cl::bits<QueryLoggingSolverType> QueryLoggingOptions(
             "All queries reaching the solver in .kquery (KQuery) format"),
         clEnumValN(
             SOLVER_SMTLIB, "solver:smt2",
-            "All queries reaching the solver in .smt2 (SMT-LIBv2) format")
+            "All queries reaching the solver in .smt2 (SMT-LIBv2) format"),
+        clEnumValN(ALL_BINARY, "all:kqb",
+                   "All queries and their results in the binary .kqb "
+                   "format, which kleaver reads much faster"),
+        clEnumValN(SOLVER_BINARY, "solver:kqb",
+                   "All queries reaching the solver and their results in "
+                   "the binary .kqb format")
+            KLEE_LLVM_CL_VAL_END),
+    cl::CommaSeparated, cl::cat(SolvingCat));
+
+cl::bits<PreprocessingRewrite> PreprocessingRewrites(
+    "preprocess",
+    cl::desc("Rewrite queries before they reach the caching solvers. Multiple "
+             "rewrites can be specified separated by a comma. By default "
+             "queries are not rewritten."),
+    cl::values(
+        clEnumValN(PREPROCESS_EQUALITIES, "equalities",
+                   "Substitute equalities with constants, including bytes "
+                   "fixed by bounds"),
+        clEnumValN(PREPROCESS_READS, "reads",
+                   "Expand reads at symbolic indices taking few values into "
+                   "reads at constant indices"),
+        clEnumValN(PREPROCESS_TABLES, "tables",
+                   "Replace reads at symbolic indices of constant arrays by "
+                   "the few values they may take, or comparisons of them by "
+                   "the few indices holding the value"),
+        clEnumValN(PREPROCESS_BOUNDS, "bounds",
+                   "Drop constraints implied by the bounds on bytes"),
+        clEnumValN(PREPROCESS_DEAD, "dead",
+                   "Drop constraints unrelated to the query")
             KLEE_LLVM_CL_VAL_END),
     cl::CommaSeparated, cl::cat(SolvingCat));
 
+cl::opt<bool> ProfileSolverChain(
+    "profile-solver-chain", cl::init(false),
+    cl::desc("Measure the queries, the queries passed on, the queries "
+             "answered and the own time of each layer of the solver chain, "
+             "for run.stats and the info file (default=false)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool> UseAssignmentValidatingSolver(
     "debug-assignment-validating-solver", cl::init(false),
     cl::desc("Debug the correctness of generated assignments (default=false)"),
@@ -195,7 +281,15 @@ cl::opt<CoreSolverType> CoreSolverToUse(
                clEnumValN(METASMT_SOLVER, "metasmt",
                           "metaSMT" METASMT_IS_DEFAULT_STR),
                clEnumValN(DUMMY_SOLVER, "dummy", "Dummy solver"),
-               clEnumValN(Z3_SOLVER, "z3", "Z3" Z3_IS_DEFAULT_STR)
+               clEnumValN(Z3_SOLVER, "z3", "Z3" Z3_IS_DEFAULT_STR),
+               clEnumValN(SMTLIB_SOLVER, "smtlib",
+                          "An SMT-LIBv2 solver process, see "
+                          "-smtlib-solver-command"),
+               clEnumValN(PORTFOLIO_SOLVER, "portfolio",
+                          "Race all available backends on hard queries"),
+               clEnumValN(REMOTE_SOLVER, "remote",
+                          "A solver service shared with other processes, "
+                          "see -remote-solver-address")
                    KLEE_LLVM_CL_VAL_END),
     cl::init(DEFAULT_CORE_SOLVER), cl::cat(SolvingCat));
 
@@ -207,6 +301,7 @@ cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith(
                clEnumValN(METASMT_SOLVER, "metasmt", "metaSMT"),
                clEnumValN(DUMMY_SOLVER, "dummy", "Dummy solver"),
                clEnumValN(Z3_SOLVER, "z3", "Z3"),
+               clEnumValN(SMTLIB_SOLVER, "smtlib", "An SMT-LIBv2 solver process"),
                clEnumValN(NO_SOLVER, "none", "Do not crosscheck (default)")
                    KLEE_LLVM_CL_VAL_END),
     cl::init(NO_SOLVER), cl::cat(SolvingCat));
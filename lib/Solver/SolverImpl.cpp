@@ -28,6 +28,19 @@ bool SolverImpl::computeValidity(const Query &query, Solver::Validity &result) {
   return true;
 }
 
+bool SolverImpl::computeTruths(const ConstraintManager &constraints,
+                               const std::vector<ref<Expr>> &exprs,
+                               std::vector<bool> &isValid) {
+  isValid.assign(exprs.size(), false);
+  for (unsigned i = 0; i != exprs.size(); ++i) {
+    bool result;
+    if (!computeTruth(Query(constraints, exprs[i]), result))
+      return false;
+    isValid[i] = result;
+  }
+  return true;
+}
+
 const char *SolverImpl::getOperationStatusString(SolverRunStatus statusCode) {
   switch (statusCode) {
   case SOLVER_RUN_STATUS_SUCCESS_SOLVABLE:
@@ -12,6 +12,15 @@
 using namespace klee;
 
 Statistic stats::cexCacheTime("CexCacheTime", "CCtime");
+Statistic stats::preprocessDeadConstraints("PreprocessDeadConstraints", "PPdead");
+Statistic stats::preprocessExpandedReads("PreprocessExpandedReads", "PPreads");
+Statistic stats::preprocessExpandedTableReads("PreprocessExpandedTableReads",
+                                              "PPtables");
+Statistic stats::preprocessImpliedConstraints("PreprocessImpliedConstraints",
+                                              "PPimplied");
+Statistic stats::preprocessInvertedTableReads("PreprocessInvertedTableReads",
+                                              "PPinverted");
+Statistic stats::preprocessSubstitutions("PreprocessSubstitutions", "PPsubst");
 Statistic stats::queries("Queries", "Q");
 Statistic stats::queriesInvalid("QueriesInvalid", "Qiv");
 Statistic stats::queriesValid("QueriesValid", "Qv");
@@ -19,10 +28,77 @@ Statistic stats::queryCacheHits("QueryCacheHits", "QChits") ;
 Statistic stats::queryCacheMisses("QueryCacheMisses", "QCmisses");
 Statistic stats::queryCexCacheHits("QueryCexCacheHits", "QCexHits") ;
 Statistic stats::queryCexCacheMisses("QueryCexCacheMisses", "QCexMisses");
+Statistic stats::queryConstructCacheHits("QueryConstructCacheHits", "QBhits");
+Statistic stats::queryConstructCacheMisses("QueryConstructCacheMisses", "QBmisses");
 Statistic stats::queryConstructTime("QueryConstructTime", "QBtime") ;
 Statistic stats::queryConstructs("QueriesConstructs", "QB");
 Statistic stats::queryCounterexamples("QueriesCEX", "Qcex");
+Statistic stats::queryCoreCacheHits("QueryCoreCacheHits", "QCoreHits");
+Statistic stats::queryCores("QueryCores", "QCores");
+Statistic stats::queryFactorCacheHits("QueryFactorCacheHits", "QFhits");
+Statistic stats::queryIncrementalAsserts("QueryIncrementalAsserts", "QIasserts");
+Statistic stats::queryIncrementalResets("QueryIncrementalResets", "QIresets");
+Statistic stats::queryIncrementalReuses("QueryIncrementalReuses", "QIreuses");
+Statistic stats::queryPersistentCacheHits("QueryPersistentCacheHits", "QPChits");
+Statistic stats::queryPortfolioRaces("QueryPortfolioRaces", "QPraces");
 Statistic stats::queryTime("QueryTime", "Qtime");
+Statistic stats::queryValidationMismatches("QueryValidationMismatches",
+                                          "QValMis");
+Statistic stats::queryValidations("QueryValidations", "QVal");
+
+// indexed by SolverLayer
+Statistic stats::solverLayerQueries[] = {
+    {"CoreLayerQueries", "CoreQ"},
+    {"UnsatCoreCacheLayerQueries", "UCCQ"},
+    {"SolverQueryLoggingLayerQueries", "SLogQ"},
+    {"AssignmentValidatingLayerQueries", "AValQ"},
+    {"FastCexLayerQueries", "FCexQ"},
+    {"CexCacheLayerQueries", "CexCQ"},
+    {"BranchCacheLayerQueries", "BrCQ"},
+    {"PreprocessingLayerQueries", "PPQ"},
+    {"IndependentLayerQueries", "IndQ"},
+    {"ValidatingLayerQueries", "ValQ"},
+    {"QueryLoggingLayerQueries", "QLogQ"}
+};
+Statistic stats::solverLayerPassedQueries[] = {
+    {"CoreLayerPassedQueries", "CoreQpassed"},
+    {"UnsatCoreCacheLayerPassedQueries", "UCCQpassed"},
+    {"SolverQueryLoggingLayerPassedQueries", "SLogQpassed"},
+    {"AssignmentValidatingLayerPassedQueries", "AValQpassed"},
+    {"FastCexLayerPassedQueries", "FCexQpassed"},
+    {"CexCacheLayerPassedQueries", "CexCQpassed"},
+    {"BranchCacheLayerPassedQueries", "BrCQpassed"},
+    {"PreprocessingLayerPassedQueries", "PPQpassed"},
+    {"IndependentLayerPassedQueries", "IndQpassed"},
+    {"ValidatingLayerPassedQueries", "ValQpassed"},
+    {"QueryLoggingLayerPassedQueries", "QLogQpassed"}
+};
+Statistic stats::solverLayerHits[] = {
+    {"CoreLayerHits", "Corehits"},
+    {"UnsatCoreCacheLayerHits", "UCChits"},
+    {"SolverQueryLoggingLayerHits", "SLoghits"},
+    {"AssignmentValidatingLayerHits", "AValhits"},
+    {"FastCexLayerHits", "FCexhits"},
+    {"CexCacheLayerHits", "CexChits"},
+    {"BranchCacheLayerHits", "BrChits"},
+    {"PreprocessingLayerHits", "PPhits"},
+    {"IndependentLayerHits", "Indhits"},
+    {"ValidatingLayerHits", "Valhits"},
+    {"QueryLoggingLayerHits", "QLoghits"}
+};
+Statistic stats::solverLayerTime[] = {
+    {"CoreLayerTime", "Coretime"},
+    {"UnsatCoreCacheLayerTime", "UCCtime"},
+    {"SolverQueryLoggingLayerTime", "SLogtime"},
+    {"AssignmentValidatingLayerTime", "AValtime"},
+    {"FastCexLayerTime", "FCextime"},
+    {"CexCacheLayerTime", "CexCtime"},
+    {"BranchCacheLayerTime", "BrCtime"},
+    {"PreprocessingLayerTime", "PPtime"},
+    {"IndependentLayerTime", "Indtime"},
+    {"ValidatingLayerTime", "Valtime"},
+    {"QueryLoggingLayerTime", "QLogtime"}
+};
 
 #ifdef KLEE_ARRAY_DEBUG
 Statistic stats::arrayHashTime("ArrayHashTime", "AHtime");
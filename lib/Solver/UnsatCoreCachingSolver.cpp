@@ -0,0 +1,151 @@
+//===-- UnsatCoreCachingSolver.cpp ----------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// Answers the queries which include a reason the core solver gave for an
+/// earlier query to be infeasible, an unsat core, as infeasible too. Unlike
+/// the counterexample cache, which needs a recorded constraint set to be a
+/// subset of the query, a core is usually a few constraints, so that it
+/// rules out the queries of all the states sharing them.
+class UnsatCoreCachingSolver : public SolverImpl {
+  Solver *solver;
+
+  /// The cores recorded, each a set of expressions.
+  std::vector<std::vector<ref<Expr> > > cores;
+  /// The cores by their first expression, each of them is looked up under
+  /// the expressions of the query in turn.
+  ExprHashMap<std::vector<unsigned> > coresByExpr;
+
+  /// Whether the last query was answered from a core.
+  bool lastHit;
+
+  /// The constraints of the query and the negation of its expression.
+  static void getConjuncts(const Query &query, ExprHashSet &conjuncts);
+  bool lookup(const Query &query);
+  void record();
+
+public:
+  UnsatCoreCachingSolver(Solver *solver) : solver(solver), lastHit(false) {}
+  ~UnsatCoreCachingSolver() { delete solver; }
+
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    lastHit = false;
+    return solver->impl->computeValue(query, result);
+  }
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() {
+    return lastHit ? SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE
+                   : solver->impl->getOperationStatusCode();
+  }
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+
+void UnsatCoreCachingSolver::getConjuncts(const Query &query,
+                                          ExprHashSet &conjuncts) {
+  conjuncts.insert(query.constraints.begin(), query.constraints.end());
+  conjuncts.insert(Expr::createIsZero(query.expr));
+}
+
+bool UnsatCoreCachingSolver::lookup(const Query &query) {
+  if (cores.empty())
+    return false;
+
+  ExprHashSet conjuncts;
+  getConjuncts(query, conjuncts);
+  for (const ref<Expr> &e : conjuncts) {
+    auto it = coresByExpr.find(e);
+    if (it == coresByExpr.end())
+      continue;
+    for (unsigned index : it->second) {
+      const std::vector<ref<Expr> > &core = cores[index];
+      bool included = true;
+      for (const ref<Expr> &c : core) {
+        if (!conjuncts.count(c)) {
+          included = false;
+          break;
+        }
+      }
+      if (included) {
+        ++stats::queryCoreCacheHits;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void UnsatCoreCachingSolver::record() {
+  std::vector<ref<Expr> > core;
+  if (!solver->impl->getUnsatCore(core) || core.empty())
+    return;
+  ++stats::queryCores;
+  coresByExpr[core[0]].push_back(cores.size());
+  cores.push_back(std::move(core));
+}
+
+bool UnsatCoreCachingSolver::computeTruth(const Query &query, bool &isValid) {
+  lastHit = lookup(query);
+  if (lastHit) {
+    isValid = true;
+    return true;
+  }
+
+  if (!solver->impl->computeTruth(query, isValid))
+    return false;
+  if (isValid)
+    record();
+  return true;
+}
+
+bool UnsatCoreCachingSolver::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  lastHit = lookup(query);
+  if (lastHit) {
+    hasSolution = false;
+    return true;
+  }
+
+  if (!solver->impl->computeInitialValues(query, result, hasSolution))
+    return false;
+  if (!hasSolution)
+    record();
+  return true;
+}
+
+} // namespace
+
+Solver *klee::createUnsatCoreCachingSolver(Solver *s) {
+  if (!s->impl->enableUnsatCores()) {
+    klee_warning("the core solver does not find unsat cores, "
+                 "-use-unsat-core-cache has no effect");
+    return s;
+  }
+  return new Solver(new UnsatCoreCachingSolver(s));
+}
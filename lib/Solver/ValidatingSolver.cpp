@@ -8,23 +8,64 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/Expr/Constraints.h"
+#include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
 
 #include "klee/Expr/ExprUtil.h"
 
+#include "llvm/Support/Errno.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
 #include <vector>
 
+#include <sys/wait.h>
+#include <unistd.h>
+
 namespace klee {
 
 class ValidatingSolver : public SolverImpl {
 private:
   Solver *solver, *oracle;
 
+  /// The percentage of the queries to validate.
+  unsigned rate;
+  /// Whether to only validate the queries answered above the core solver.
+  bool cachedOnly;
+  /// The number of processes to validate in, none to validate in place.
+  unsigned jobs;
+
+  /// The percentage accumulated since the last query validated.
+  unsigned credit;
+  /// The processes validating a query.
+  std::vector<pid_t> children;
+
+  /// Whether to validate the query just answered, given the number of core
+  /// solver queries before it.
+  bool sample(uint64_t coreQueries);
+
+  /// Run `check`, which tells whether the result of the query agrees with
+  /// the oracle, in place or in a forked process.
+  template <typename Check>
+  void validate(const char *method, const Query &query, Check check);
+  void reportMismatch(const char *method, const Query &query);
+
+  /// Count the mismatches found by the processes which exited, waiting for
+  /// all of them if `wait` is set.
+  void reapChildren(bool wait);
+
 public:
-  ValidatingSolver(Solver *_solver, Solver *_oracle)
-      : solver(_solver), oracle(_oracle) {}
-  ~ValidatingSolver() { delete solver; }
+  ValidatingSolver(Solver *_solver, Solver *_oracle, unsigned _rate,
+                   bool _cachedOnly, unsigned _jobs)
+      : solver(_solver), oracle(_oracle), rate(_rate),
+        cachedOnly(_cachedOnly), jobs(_jobs), credit(0) {}
+  ~ValidatingSolver() {
+    reapChildren(true);
+    delete solver;
+  }
 
   bool computeValidity(const Query &, Solver::Validity &result);
   bool computeTruth(const Query &, bool &isValid);
@@ -37,66 +78,143 @@ public:
   void setCoreSolverTimeout(time::Span timeout);
 };
 
-bool ValidatingSolver::computeTruth(const Query &query, bool &isValid) {
-  bool answer;
-
-  if (!solver->impl->computeTruth(query, isValid))
+bool ValidatingSolver::sample(uint64_t coreQueries) {
+  if (cachedOnly && stats::queries != coreQueries)
     return false;
-  if (!oracle->impl->computeTruth(query, answer))
+  credit += rate;
+  if (credit < 100)
     return false;
+  credit -= 100;
+  return true;
+}
+
+template <typename Check>
+void ValidatingSolver::validate(const char *method, const Query &query,
+                                Check check) {
+  if (!jobs) {
+    ++stats::queryValidations;
+    if (!check())
+      reportMismatch(method, query);
+    return;
+  }
+
+  reapChildren(false);
+  if (children.size() >= jobs)
+    return;
+
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid == -1) {
+    klee_warning("fork failed (for validating solver) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return;
+  }
+  // - child: validate and exit, the status telling whether it agreed
+  if (pid == 0) {
+    bool agreed = check();
+    if (!agreed)
+      reportMismatch(method, query);
+    _exit(agreed ? 0 : 1);
+  }
+  // - parent
+  ++stats::queryValidations;
+  children.push_back(pid);
+}
+
+void ValidatingSolver::reportMismatch(const char *method,
+                                      const Query &query) {
+  ++stats::queryValidationMismatches;
+  char *log = solver->impl->getConstraintLog(query);
+  klee_warning("invalid solver result (%s) for query:\n%s", method,
+               log ? log : "");
+  free(log);
+  if (rate >= 100 && !cachedOnly && !jobs)
+    assert(0 && "invalid solver result");
+}
+
+void ValidatingSolver::reapChildren(bool wait) {
+  for (unsigned i = 0; i != children.size();) {
+    int status;
+    pid_t res = waitpid(children[i], &status, wait ? 0 : WNOHANG);
+    if (res == 0) {
+      ++i;
+      continue;
+    }
+    if (res == children[i] && WIFEXITED(status) && WEXITSTATUS(status) == 1)
+      ++stats::queryValidationMismatches;
+    children[i] = children.back();
+    children.pop_back();
+  }
+}
 
-  if (isValid != answer)
-    assert(0 && "invalid solver result (computeTruth)");
+// A failure of the oracle leaves the result unchecked: the primary solver
+// answered and its result stands.
 
+bool ValidatingSolver::computeTruth(const Query &query, bool &isValid) {
+  uint64_t coreQueries = stats::queries;
+  if (!solver->impl->computeTruth(query, isValid))
+    return false;
+
+  if (sample(coreQueries))
+    validate("computeTruth", query, [&]() {
+      bool answer;
+      return !oracle->impl->computeTruth(query, answer) || isValid == answer;
+    });
   return true;
 }
 
 bool ValidatingSolver::computeValidity(const Query &query,
                                        Solver::Validity &result) {
-  Solver::Validity answer;
-
+  uint64_t coreQueries = stats::queries;
   if (!solver->impl->computeValidity(query, result))
     return false;
-  if (!oracle->impl->computeValidity(query, answer))
-    return false;
-
-  if (result != answer)
-    assert(0 && "invalid solver result (computeValidity)");
 
+  if (sample(coreQueries))
+    validate("computeValidity", query, [&]() {
+      Solver::Validity answer;
+      return !oracle->impl->computeValidity(query, answer) || result == answer;
+    });
   return true;
 }
 
 bool ValidatingSolver::computeValue(const Query &query, ref<Expr> &result) {
-  bool answer;
-
+  uint64_t coreQueries = stats::queries;
   if (!solver->impl->computeValue(query, result))
     return false;
+
   // We don't want to compare, but just make sure this is a legal
   // solution.
-  if (!oracle->impl->computeTruth(
-          query.withExpr(NeExpr::create(query.expr, result)), answer))
-    return false;
-
-  if (answer)
-    assert(0 && "invalid solver result (computeValue)");
-
+  if (sample(coreQueries))
+    validate("computeValue", query, [&]() {
+      bool answer;
+      return !oracle->impl->computeTruth(
+                 query.withExpr(NeExpr::create(query.expr, result)), answer) ||
+             !answer;
+    });
   return true;
 }
 
 bool ValidatingSolver::computeInitialValues(
     const Query &query,
     std::shared_ptr<const Assignment> &result, bool &hasSolution) {
-  bool answer;
-
+  uint64_t coreQueries = stats::queries;
   if (!solver->impl->computeInitialValues(query, result, hasSolution))
     return false;
+  if (!sample(coreQueries))
+    return true;
+
+  validate("computeInitialValues", query, [&]() {
+    bool answer;
+    if (!hasSolution)
+      return !oracle->impl->computeTruth(query, answer) || answer;
 
-  std::vector<const Array*> objects;
-  findSymbolicObjects(query.constraints.begin(), query.constraints.end(), objects);
-  findSymbolicObjects(query.expr, objects);
-  if (hasSolution) {
     // Assert the bindings as constraints, and verify that the
     // conjunction of the actual constraints is satisfiable.
+    std::vector<const Array*> objects;
+    findSymbolicObjects(query.constraints.begin(), query.constraints.end(),
+                        objects);
+    findSymbolicObjects(query.expr, objects);
     std::vector<ref<Expr> > bindings;
     for (unsigned i = 0; i != objects.size(); ++i) {
       const Array *array = objects[i];
@@ -116,17 +234,9 @@ bool ValidatingSolver::computeInitialValues(
          it != ie; ++it)
       constraints = AndExpr::create(constraints, *it);
 
-    if (!oracle->impl->computeTruth(Query(tmp, constraints), answer))
-      return false;
-    if (!answer)
-      assert(0 && "invalid solver result (computeInitialValues)");
-  } else {
-    if (!oracle->impl->computeTruth(query, answer))
-      return false;
-    if (!answer)
-      assert(0 && "invalid solver result (computeInitialValues)");
-  }
-
+    return !oracle->impl->computeTruth(Query(tmp, constraints), answer) ||
+           answer;
+  });
   return true;
 }
 
@@ -142,7 +252,8 @@ void ValidatingSolver::setCoreSolverTimeout(time::Span timeout) {
   solver->impl->setCoreSolverTimeout(timeout);
 }
 
-Solver *createValidatingSolver(Solver *s, Solver *oracle) {
-  return new Solver(new ValidatingSolver(s, oracle));
+Solver *createValidatingSolver(Solver *s, Solver *oracle, unsigned rate,
+                               bool cachedOnly, unsigned jobs) {
+  return new Solver(new ValidatingSolver(s, oracle, rate, cachedOnly, jobs));
 }
 }
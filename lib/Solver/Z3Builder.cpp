@@ -12,6 +12,7 @@
 
 #include "klee/Expr/Expr.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/OptionCategories.h"
 #include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverStats.h"
 #include "klee/util/Bits.h"
@@ -28,6 +29,15 @@ llvm::cl::opt<bool> UseConstructHashZ3(
     llvm::cl::init(true),
     llvm::cl::cat(klee::ExprCat));
 
+llvm::cl::opt<unsigned> Z3ConstructCacheSize(
+    "z3-construct-cache-size",
+    llvm::cl::desc("Keep up to this many translated expressions and update "
+                   "nodes between Z3 queries, evicting the least recently "
+                   "used half when full. 0 translates every query anew "
+                   "(default=0)"),
+    llvm::cl::init(0),
+    llvm::cl::cat(klee::SolvingCat));
+
 // FIXME: This should be std::atomic<bool>. Need C++11 for that.
 bool Z3InterationLogOpen = false;
 }
@@ -71,11 +81,12 @@ Z3ArrayExprHash::~Z3ArrayExprHash() {}
 
 void Z3ArrayExprHash::clear() {
   _update_node_hash.clear();
-  _array_hash.clear();
+  clearArrays();
 }
 
 Z3Builder::Z3Builder(bool autoClearConstructCache, const char* z3LogInteractionFileArg)
-    : autoClearConstructCache(autoClearConstructCache), z3LogInteractionFile("") {
+    : constructCacheLimit(autoClearConstructCache ? 0 : Z3ConstructCacheSize),
+      autoClearConstructCache(autoClearConstructCache), z3LogInteractionFile("") {
   if (z3LogInteractionFileArg)
     this->z3LogInteractionFile = std::string(z3LogInteractionFileArg);
   if (z3LogInteractionFile.length() > 0) {
@@ -430,24 +441,66 @@ Z3ASTHandle Z3Builder::getInitialRead(const Array *root, unsigned index) {
   return readExpr(getInitialArray(root), indexExpr);
 }
 
-Z3ASTHandle Z3Builder::getArrayForUpdate(const Array *root,
-                                         const UpdateNode *un) {
-  if (!un) {
-    return (getInitialArray(root));
-  } else {
-    // FIXME: This really needs to be non-recursive.
-    Z3ASTHandle un_expr;
-    bool hashed = _arr_hash.lookupUpdateNodeExpr(un, un_expr);
+bool Z3Builder::lookupUpdateNode(const UpdateNode *un,
+                                 Z3ASTHandle &encoding) {
+  if (!constructCacheLimit)
+    return _arr_hash.lookupUpdateNodeExpr(un, encoding);
+
+  auto it = updateNodes.find(un);
+  if (it == updateNodes.end()) {
+    auto old = oldUpdateNodes.find(un);
+    if (old == oldUpdateNodes.end())
+      return false;
+    it = updateNodes.insert(*old).first;
+    oldUpdateNodes.erase(old);
+  }
+  encoding = it->second.encoding;
+  return true;
+}
+
+void Z3Builder::cacheUpdateNode(const Array *root, const UpdateNode *un,
+                                const Z3ASTHandle &encoding) {
+  if (!constructCacheLimit) {
+    Z3ASTHandle e = encoding;
+    _arr_hash.hashUpdateNodeExpr(un, e);
+    return;
+  }
+  makeRoomInConstructCache();
+  updateNodes.insert(
+      std::make_pair(un, UpdateNodeEncoding{UpdateList(root, un), encoding}));
+}
 
-    if (!hashed) {
-      un_expr = writeExpr(getArrayForUpdate(root, un->next),
-                          construct(un->index, 0), construct(un->value, 0));
+void Z3Builder::makeRoomInConstructCache() {
+  if (constructed.size() + updateNodes.size() < constructCacheLimit / 2 + 1)
+    return;
+  oldConstructed.clear();
+  oldConstructed.swap(constructed);
+  oldUpdateNodes.clear();
+  oldUpdateNodes.swap(updateNodes);
+}
 
-      _arr_hash.hashUpdateNodeExpr(un, un_expr);
+Z3ASTHandle Z3Builder::getArrayForUpdate(const Array *root,
+                                         const UpdateNode *un) {
+  // encode only the newest nodes, on top of the first one already encoded
+  std::vector<const UpdateNode *> pending;
+  Z3ASTHandle un_expr;
+  for (; un; un = un->next) {
+    if (lookupUpdateNode(un, un_expr)) {
+      ++stats::queryConstructCacheHits;
+      break;
     }
+    pending.push_back(un);
+  }
+  if (!un)
+    un_expr = getInitialArray(root);
 
-    return (un_expr);
+  for (auto it = pending.rbegin(), ie = pending.rend(); it != ie; ++it) {
+    ++stats::queryConstructCacheMisses;
+    un_expr = writeExpr(un_expr, construct((*it)->index, 0),
+                        construct((*it)->value, 0));
+    cacheUpdateNode(root, *it, un_expr);
   }
+  return un_expr;
 }
 
 /** if *width_out!=1 then result is a bitvector,
@@ -460,15 +513,26 @@ Z3ASTHandle Z3Builder::construct(ref<Expr> e, int *width_out) {
   } else {
     ExprHashMap<std::pair<Z3ASTHandle, unsigned> >::iterator it =
         constructed.find(e);
+    if (it == constructed.end() && constructCacheLimit) {
+      auto old = oldConstructed.find(e);
+      if (old != oldConstructed.end()) {
+        it = constructed.insert(*old).first;
+        oldConstructed.erase(old);
+      }
+    }
     if (it != constructed.end()) {
+      ++stats::queryConstructCacheHits;
       if (width_out)
         *width_out = it->second.second;
       return it->second.first;
     } else {
+      ++stats::queryConstructCacheMisses;
       int width;
       if (!width_out)
         width_out = &width;
       Z3ASTHandle res = constructActual(e, width_out);
+      if (constructCacheLimit)
+        makeRoomInConstructCache();
       constructed.insert(std::make_pair(e, std::make_pair(res, *width_out)));
       return res;
     }
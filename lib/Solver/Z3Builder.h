@@ -104,9 +104,30 @@ public:
 };
 
 class Z3Builder {
-  ExprHashMap<std::pair<Z3ASTHandle, unsigned> > constructed;
+  /// Translated expressions. With a construct cache limit (see
+  /// -z3-construct-cache-size) they are kept in two generations: once the
+  /// young one holds half of the limit, the old one is dropped and the
+  /// young one takes its place. Hits in the old generation move back.
+  ExprHashMap<std::pair<Z3ASTHandle, unsigned> > constructed, oldConstructed;
   Z3ArrayExprHash _arr_hash;
 
+  /// Encodings of update nodes, by node identity, used instead of the
+  /// unbounded ones in \ref _arr_hash when there is a limit. The lists
+  /// keep the nodes alive so that their addresses are not reused.
+  struct UpdateNodeEncoding {
+    UpdateList updates;
+    Z3ASTHandle encoding;
+  };
+  typedef std::unordered_map<const UpdateNode *, UpdateNodeEncoding>
+      UpdateNodeEncodings;
+  UpdateNodeEncodings updateNodes, oldUpdateNodes;
+  size_t constructCacheLimit;
+
+  bool lookupUpdateNode(const UpdateNode *un, Z3ASTHandle &encoding);
+  void cacheUpdateNode(const Array *root, const UpdateNode *un,
+                       const Z3ASTHandle &encoding);
+  void makeRoomInConstructCache();
+
 private:
   Z3ASTHandle bvOne(unsigned width);
   Z3ASTHandle bvZero(unsigned width);
@@ -157,7 +178,6 @@ private:
   Z3ASTHandle constructAShrByConstant(Z3ASTHandle expr, unsigned shift,
                                       Z3ASTHandle isSigned);
 
-  Z3ASTHandle getInitialArray(const Array *os);
   Z3ASTHandle getArrayForUpdate(const Array *root, const UpdateNode *un);
 
   Z3ASTHandle constructActual(ref<Expr> e, int *width_out);
@@ -180,6 +200,7 @@ public:
 
   Z3ASTHandle getTrue();
   Z3ASTHandle getFalse();
+  Z3ASTHandle getInitialArray(const Array *os);
   Z3ASTHandle getInitialRead(const Array *os, unsigned index);
 
   Z3ASTHandle construct(ref<Expr> e) {
@@ -189,7 +210,19 @@ public:
     return res;
   }
 
-  void clearConstructCache() { constructed.clear(); }
+  void clearConstructCache() {
+    constructed.clear();
+    oldConstructed.clear();
+    updateNodes.clear();
+    oldUpdateNodes.clear();
+  }
+
+  /// To be called after each query: drops the translations unless they
+  /// are kept in a bounded cache.
+  void finishQuery() {
+    if (!constructCacheLimit)
+      clearConstructCache();
+  }
 };
 }
 
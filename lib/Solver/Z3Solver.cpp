@@ -19,6 +19,7 @@
 
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Assignment.h"
+#include "klee/Expr/ExprHashMap.h"
 #include "klee/Expr/ExprUtil.h"
 #include "klee/Expr/ExprVisitor.h"
 #include "klee/Solver/Solver.h"
@@ -27,6 +28,9 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <unordered_map>
+
 namespace {
 // NOTE: Very useful for debugging Z3 behaviour. These files can be given to
 // the z3 binary to replay all Z3 API calls using its `-log` option.
@@ -45,6 +49,25 @@ llvm::cl::opt<bool> Z3ValidateModels(
     llvm::cl::desc("When generating Z3 models validate these against the query"),
     llvm::cl::cat(klee::SolvingCat));
 
+llvm::cl::opt<bool> Z3Incremental(
+    "z3-incremental", llvm::cl::init(false),
+    llvm::cl::desc("Keep Z3 solvers between queries and assert only the "
+                   "constraints that extend the prefix already asserted, "
+                   "checking the query as an assumption (default=false)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<unsigned> Z3IncrementalMaxPop(
+    "z3-incremental-max-pop", llvm::cl::init(16),
+    llvm::cl::desc("Solve from scratch instead of popping more than this "
+                   "many constraints off an incremental solver (default=16)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<unsigned> Z3IncrementalSolvers(
+    "z3-incremental-solvers", llvm::cl::init(4),
+    llvm::cl::desc("Number of incremental solvers kept for different "
+                   "constraint prefixes (default=4)"),
+    llvm::cl::cat(klee::SolvingCat));
+
 llvm::cl::opt<unsigned>
     Z3VerbosityLevel("debug-z3-verbosity", llvm::cl::init(0),
                      llvm::cl::desc("Z3 verbosity level (default=0)"),
@@ -65,11 +88,37 @@ private:
   // Parameter symbols
   ::Z3_symbol timeoutParamStrSymbol;
 
+  /// A solver kept between queries (see -z3-incremental), with one scope
+  /// per asserted constraint so that it can be popped back to the prefix
+  /// it shares with the next query.
+  struct IncrementalSolver {
+    ::Z3_solver solver;
+    std::vector<ref<Expr> > asserted;
+    /// Number of scopes at the point the axioms of a constant array were
+    /// asserted.
+    std::map<const Array *, size_t> arrays;
+    uint64_t lastUse;
+  };
+  std::vector<IncrementalSolver> incrementalSolvers;
+  uint64_t incrementalClock = 0;
+
+  /// Whether queries are asked under assumptions standing for their
+  /// constraints, to get the unsat core of the infeasible ones.
+  bool trackUnsatCores = false;
+  /// The unsat core of the last query, if it was infeasible.
+  std::vector<ref<Expr> > unsatCore;
+  bool haveUnsatCore = false;
+
+  IncrementalSolver &getIncrementalSolver(const Query &query);
+
   bool internalRunSolver(const Query &,
                          std::shared_ptr<const Assignment> &result,
                          bool &hasSolution,
                          bool needsModel);
   bool validateZ3Model(::Z3_solver &theSolver, ::Z3_model &theModel);
+  void extractArrayModel(::Z3_model theModel, const Array *root,
+                         const std::vector<uint32_t> &indices,
+                         CompactArrayModel &model);
 
 public:
   Z3SolverImpl();
@@ -97,6 +146,20 @@ public:
                        std::shared_ptr<const Assignment> &result,
                        bool &hasSolution, bool needsModel);
   SolverRunStatus getOperationStatusCode();
+
+  bool enableUnsatCores() {
+    // the incremental solvers assume only the query itself
+    if (Z3Incremental)
+      return false;
+    trackUnsatCores = true;
+    return true;
+  }
+  bool getUnsatCore(std::vector<ref<Expr> > &core) {
+    if (!haveUnsatCore)
+      return false;
+    core = unsatCore;
+    return true;
+  }
 };
 
 Z3SolverImpl::Z3SolverImpl()
@@ -133,6 +196,8 @@ Z3SolverImpl::Z3SolverImpl()
 }
 
 Z3SolverImpl::~Z3SolverImpl() {
+  for (IncrementalSolver &is : incrementalSolvers)
+    Z3_solver_dec_ref(builder->ctx, is.solver);
   Z3_params_dec_ref(builder->ctx, solverParameters);
   delete builder;
 }
@@ -250,21 +315,72 @@ bool Z3SolverImpl::internalRunSolver(
 
   TimerStatIncrementer t(stats::queryTime);
   // NOTE: Z3 will switch to using a slower solver internally if push/pop are
-  // used so for now it is likely that creating a new solver each time is the
-  // right way to go until Z3 changes its behaviour.
+  // used so by default a new solver is created each time, unless the
+  // constraint prefix is worth keeping (-z3-incremental).
   //
   // TODO: Investigate using a custom tactic as described in
   // https://github.com/klee/klee/issues/653
-  Z3_solver theSolver = Z3_mk_solver(builder->ctx);
-  Z3_solver_inc_ref(builder->ctx, theSolver);
+  IncrementalSolver *is = Z3Incremental ? &getIncrementalSolver(query) : 0;
+  Z3_solver theSolver;
+  if (is) {
+    theSolver = is->solver;
+  } else {
+    theSolver = Z3_mk_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, theSolver);
+  }
   Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
 
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+  haveUnsatCore = false;
+  unsatCore.clear();
+
+  // For unsat cores, each constraint and the negated query are asserted
+  // under a literal of their own, which the solver is asked to assume.
+  bool tracking = trackUnsatCores && !is;
+  std::vector<Z3ASTHandle> coreLiterals;
+  auto assertTracked = [&](Z3ASTHandle e) {
+    Z3ASTHandle literal(
+        Z3_mk_fresh_const(builder->ctx, "core", Z3_mk_bool_sort(builder->ctx)),
+        builder->ctx);
+    Z3_solver_assert(
+        builder->ctx, theSolver,
+        Z3ASTHandle(Z3_mk_implies(builder->ctx, literal, e), builder->ctx));
+    coreLiterals.push_back(literal);
+  };
 
   ConstantArrayFinder constant_arrays_in_query;
-  for (auto const &constraint : query.constraints) {
-    Z3_solver_assert(builder->ctx, theSolver, builder->construct(constraint));
-    constant_arrays_in_query.visit(constraint);
+  if (is) {
+    // assert the constraints past the shared prefix, each in its own scope
+    auto it = query.constraints.begin(), ie = query.constraints.end();
+    for (size_t i = 0; i != is->asserted.size(); ++i)
+      ++it;
+    for (; it != ie; ++it) {
+      Z3_solver_push(builder->ctx, theSolver);
+      Z3_solver_assert(builder->ctx, theSolver, builder->construct(*it));
+      is->asserted.push_back(*it);
+      ++stats::queryIncrementalAsserts;
+
+      ConstantArrayFinder arrays;
+      arrays.visit(*it);
+      for (const Array *array : arrays.results) {
+        assert(builder->constant_array_assertions.count(array) == 1 &&
+               "Constant array found in query, but not handled by Z3Builder");
+        if (!is->arrays.emplace(array, is->asserted.size()).second)
+          continue;
+        for (auto const &arrayIndexValueExpr :
+             builder->constant_array_assertions[array])
+          Z3_solver_assert(builder->ctx, theSolver, arrayIndexValueExpr);
+      }
+    }
+  } else {
+    for (auto const &constraint : query.constraints) {
+      if (tracking)
+        assertTracked(builder->construct(constraint));
+      else
+        Z3_solver_assert(builder->ctx, theSolver,
+                         builder->construct(constraint));
+      constant_arrays_in_query.visit(constraint);
+    }
   }
   ++stats::queries;
   if (needsModel)
@@ -274,12 +390,17 @@ bool Z3SolverImpl::internalRunSolver(
       Z3ASTHandle(builder->construct(query.expr), builder->ctx);
   constant_arrays_in_query.visit(query.expr);
 
+  // what has to hold only for this query: assumptions for an incremental
+  // solver, assertions otherwise
+  std::vector<Z3ASTHandle> queryAssumptions;
   for (auto const &constant_array : constant_arrays_in_query.results) {
     assert(builder->constant_array_assertions.count(constant_array) == 1 &&
            "Constant array found in query, but not handled by Z3Builder");
+    if (is && is->arrays.count(constant_array))
+      continue;
     for (auto const &arrayIndexValueExpr :
          builder->constant_array_assertions[constant_array]) {
-      Z3_solver_assert(builder->ctx, theSolver, arrayIndexValueExpr);
+      queryAssumptions.push_back(arrayIndexValueExpr);
     }
   }
 
@@ -288,30 +409,75 @@ bool Z3SolverImpl::internalRunSolver(
   // but Z3 works in terms of satisfiability so instead we ask the
   // negation of the equivalent i.e.
   // ∃ X Constraints(X) ∧ ¬ query(X)
-  Z3_solver_assert(
-      builder->ctx, theSolver,
+  queryAssumptions.push_back(
       Z3ASTHandle(Z3_mk_not(builder->ctx, z3QueryExpr), builder->ctx));
+  if (tracking) {
+    assertTracked(queryAssumptions.back());
+    queryAssumptions.pop_back();
+  }
+  if (!is) {
+    for (auto const &assumption : queryAssumptions)
+      Z3_solver_assert(builder->ctx, theSolver, assumption);
+  }
+  if (tracking)
+    queryAssumptions = coreLiterals;
 
   if (dumpedQueriesFile) {
     *dumpedQueriesFile << "; start Z3 query\n";
     *dumpedQueriesFile << Z3_solver_to_string(builder->ctx, theSolver);
-    *dumpedQueriesFile << "(check-sat)\n";
+    if (is || tracking) {
+      *dumpedQueriesFile << "(check-sat-assuming (";
+      for (auto const &assumption : queryAssumptions)
+        *dumpedQueriesFile << Z3_ast_to_string(builder->ctx, assumption)
+                           << " ";
+      *dumpedQueriesFile << "))\n";
+    } else {
+      *dumpedQueriesFile << "(check-sat)\n";
+    }
     *dumpedQueriesFile << "(reset)\n";
     *dumpedQueriesFile << "; end Z3 query\n\n";
     dumpedQueriesFile->flush();
   }
 
-  ::Z3_lbool satisfiable = Z3_solver_check(builder->ctx, theSolver);
+  ::Z3_lbool satisfiable;
+  if (is || tracking) {
+    std::vector< ::Z3_ast> assumptions(queryAssumptions.begin(),
+                                       queryAssumptions.end());
+    satisfiable = Z3_solver_check_assumptions(
+        builder->ctx, theSolver, assumptions.size(), assumptions.data());
+  } else {
+    satisfiable = Z3_solver_check(builder->ctx, theSolver);
+  }
   runStatusCode = handleSolverResponse(query, theSolver, satisfiable, result,
                                        hasSolution, needsModel);
 
-  Z3_solver_dec_ref(builder->ctx, theSolver);
-  // Clear the builder's cache to prevent memory usage exploding.
-  // By using ``autoClearConstructCache=false`` and clearning now
-  // we allow Z3_ast expressions to be shared from an entire
+  if (tracking && satisfiable == Z3_L_FALSE) {
+    std::unordered_map< ::Z3_ast, ref<Expr> > literals;
+    auto literal = coreLiterals.begin();
+    for (auto const &constraint : query.constraints)
+      literals[*literal++] = constraint;
+    literals[*literal] = Expr::createIsZero(query.expr);
+
+    ::Z3_ast_vector core = Z3_solver_get_unsat_core(builder->ctx, theSolver);
+    Z3_ast_vector_inc_ref(builder->ctx, core);
+    for (unsigned i = 0, e = Z3_ast_vector_size(builder->ctx, core); i != e;
+         ++i) {
+      auto it = literals.find(Z3_ast_vector_get(builder->ctx, core, i));
+      if (it != literals.end())
+        unsatCore.push_back(it->second);
+    }
+    Z3_ast_vector_dec_ref(builder->ctx, core);
+    haveUnsatCore = true;
+  }
+
+  if (!is)
+    Z3_solver_dec_ref(builder->ctx, theSolver);
+  // Clear the builder's cache to prevent memory usage exploding, unless
+  // it is bounded. By using ``autoClearConstructCache=false`` and clearing
+  // now we allow Z3_ast expressions to be shared from an entire
   // ``Query`` rather than only sharing within a single call to
   // ``builder->construct()``.
-  builder->clearConstructCache();
+  builder->finishQuery();
 
   if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
       runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
@@ -325,6 +491,61 @@ bool Z3SolverImpl::internalRunSolver(
   return false; // failed
 }
 
+Z3SolverImpl::IncrementalSolver &
+Z3SolverImpl::getIncrementalSolver(const Query &query) {
+  // pick the solver sharing the longest prefix with the query, among those
+  // that do not need to pop too far
+  IncrementalSolver *best = 0;
+  size_t bestCommon = 0;
+  for (IncrementalSolver &is : incrementalSolvers) {
+    size_t common = 0;
+    auto it = query.constraints.begin(), ie = query.constraints.end();
+    for (; common != is.asserted.size() && it != ie; ++common, ++it)
+      if (is.asserted[common].get() != it->get())
+        break;
+    if (is.asserted.size() - common > Z3IncrementalMaxPop)
+      continue;
+    if (!best || common > bestCommon) {
+      best = &is;
+      bestCommon = common;
+    }
+  }
+
+  if (!best) {
+    if (incrementalSolvers.size() < std::max(1u, unsigned(Z3IncrementalSolvers))) {
+      ::Z3_solver solver = Z3_mk_solver(builder->ctx);
+      Z3_solver_inc_ref(builder->ctx, solver);
+      incrementalSolvers.push_back(IncrementalSolver());
+      best = &incrementalSolvers.back();
+      best->solver = solver;
+    } else {
+      // start over with the least recently used solver
+      best = &*std::min_element(
+          incrementalSolvers.begin(), incrementalSolvers.end(),
+          [](const IncrementalSolver &a, const IncrementalSolver &b) {
+            return a.lastUse < b.lastUse;
+          });
+      Z3_solver_reset(builder->ctx, best->solver);
+      best->asserted.clear();
+      best->arrays.clear();
+      ++stats::queryIncrementalResets;
+    }
+  } else if (size_t pop = best->asserted.size() - bestCommon) {
+    Z3_solver_pop(builder->ctx, best->solver, pop);
+    best->asserted.resize(bestCommon);
+    for (auto it = best->arrays.begin(); it != best->arrays.end();) {
+      if (it->second > bestCommon)
+        it = best->arrays.erase(it);
+      else
+        ++it;
+    }
+  }
+
+  stats::queryIncrementalReuses += bestCommon;
+  best->lastUse = ++incrementalClock;
+  return *best;
+}
+
 SolverImpl::SolverRunStatus Z3SolverImpl::handleSolverResponse(
     const Query &query,
     ::Z3_solver theSolver, ::Z3_lbool satisfiable,
@@ -346,47 +567,43 @@ SolverImpl::SolverRunStatus Z3SolverImpl::handleSolverResponse(
     for (const auto &constraint: query.constraints)
       findReads(constraint, true, reads);
 
-    Assignment::map_bindings_ty bindings;
+    // Collect the indices read from each array. The same index is often
+    // read many times, and most indices are constants that need no model.
+    std::map<const Array *, ExprHashSet> seenIndices;
+    std::map<const Array *, std::vector<uint32_t> > indices;
     for (ref<ReadExpr> read : reads) {
-      bool success;
+      const Array *root = read->updates.root;
+      if (!seenIndices[root].insert(read->index).second)
+        continue;
+
+      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(read->index)) {
+        indices[root].push_back(CE->getZExtValue());
+        continue;
+      }
+
       // Get the model of the index
-      unsigned index;
       Z3ASTHandle indexExpr = builder->construct(read->index); // should be cached
-      // We can't use Z3ASTHandle here so have to do ref counting manually
-      ::Z3_ast indexEvaluated;
-      success = Z3_model_eval(builder->ctx, theModel, indexExpr,
-                            /*model_completion=*/Z3_FALSE, &indexEvaluated);
+      ::Z3_ast rawIndex;
+      bool success = Z3_model_eval(builder->ctx, theModel, indexExpr,
+                                   /*model_completion=*/Z3_FALSE, &rawIndex);
       assert(success && "Failed to evaluate index model");
-      Z3_inc_ref(builder->ctx, indexEvaluated);
-      if (Z3_get_ast_kind(builder->ctx, indexEvaluated) != Z3_NUMERAL_AST) {
-        // if the index is not numeric, it means that it's a "don't care" value
-        Z3_dec_ref(builder->ctx, indexEvaluated);
+      Z3ASTHandle indexEvaluated(rawIndex, builder->ctx);
+      unsigned index;
+      // if the index is not numeric, it means that it's a "don't care" value
+      if (Z3_get_ast_kind(builder->ctx, indexEvaluated) != Z3_NUMERAL_AST ||
+          !Z3_get_numeral_uint(builder->ctx, indexEvaluated, &index))
         continue;
-      }
-      success = Z3_get_numeral_uint(builder->ctx, indexEvaluated,
-                                            &index);
-      assert(success && "failed to get value back");
-      Z3_dec_ref(builder->ctx, indexEvaluated);
-
-      // Get the model of the read value
-      int value = 0;
-      // We can't use Z3ASTHandle here so have to do ref counting manually
-      ::Z3_ast valueEvaluated;
-      Z3ASTHandle initialRead = builder->getInitialRead(read->updates.root, index);
-      success = Z3_model_eval(builder->ctx, theModel, initialRead,
-                             /*model_completion=*/Z3_TRUE, &valueEvaluated);
-      assert(success && "Failed to evaluate model");
-      Z3_inc_ref(builder->ctx, valueEvaluated);
-      assert(Z3_get_ast_kind(builder->ctx, valueEvaluated) == Z3_NUMERAL_AST &&
-             "Evaluated expression has wrong sort");
-
-      success = Z3_get_numeral_int(builder->ctx, valueEvaluated, &value);
-      assert(success && "failed to get value back");
-      assert(value >= 0 && value <= 255 &&
-             "Integer from model is out of range");
-      Z3_dec_ref(builder->ctx, valueEvaluated);
-
-      bindings[read->updates.root].add(index, value);
+      indices[root].push_back(index);
+    }
+
+    Assignment::bindings_ty bindings;
+    for (auto &it : indices) {
+      std::vector<uint32_t> &arrayIndices = it.second;
+      std::sort(arrayIndices.begin(), arrayIndices.end());
+      arrayIndices.erase(
+          std::unique(arrayIndices.begin(), arrayIndices.end()),
+          arrayIndices.end());
+      extractArrayModel(theModel, it.first, arrayIndices, bindings[it.first]);
     }
 
     result = std::make_shared<Assignment>(bindings);
@@ -422,6 +639,78 @@ SolverImpl::SolverRunStatus Z3SolverImpl::handleSolverResponse(
   }
 }
 
+void Z3SolverImpl::extractArrayModel(::Z3_model theModel, const Array *root,
+                                     const std::vector<uint32_t> &indices,
+                                     CompactArrayModel &model) {
+  ::Z3_context ctx = builder->ctx;
+  auto getByte = [ctx](::Z3_ast ast, unsigned &value) {
+    return ast && Z3_get_ast_kind(ctx, ast) == Z3_NUMERAL_AST &&
+           Z3_get_numeral_uint(ctx, ast, &value) && value <= 255;
+  };
+  std::vector<std::pair<uint32_t, uint8_t> > values;
+  values.reserve(indices.size());
+
+  // Z3 mostly models an array as a function given by its entries and a
+  // default value, which gives all the bytes read at once
+  Z3ASTHandle array = builder->getInitialArray(root);
+  ::Z3_ast rawInterpretation = Z3_model_get_const_interp(
+      ctx, theModel, Z3_get_app_decl(ctx, Z3_to_app(ctx, array)));
+  Z3ASTHandle interpretation(rawInterpretation, ctx);
+  if (rawInterpretation && Z3_is_as_array(ctx, interpretation)) {
+    ::Z3_func_interp function = Z3_model_get_func_interp(
+        ctx, theModel, Z3_get_as_array_func_decl(ctx, interpretation));
+    if (function) {
+      Z3_func_interp_inc_ref(ctx, function);
+      std::unordered_map<uint32_t, uint8_t> entries;
+      bool numeric = true;
+      for (unsigned i = 0, e = Z3_func_interp_get_num_entries(ctx, function);
+           numeric && i != e; ++i) {
+        ::Z3_func_entry entry = Z3_func_interp_get_entry(ctx, function, i);
+        Z3_func_entry_inc_ref(ctx, entry);
+        Z3ASTHandle index(Z3_func_entry_get_arg(ctx, entry, 0), ctx);
+        Z3ASTHandle value(Z3_func_entry_get_value(ctx, entry), ctx);
+        unsigned indexValue, byte;
+        numeric = Z3_get_ast_kind(ctx, index) == Z3_NUMERAL_AST &&
+                  Z3_get_numeral_uint(ctx, index, &indexValue) &&
+                  getByte(value, byte);
+        if (numeric)
+          entries.emplace(indexValue, byte);
+        Z3_func_entry_dec_ref(ctx, entry);
+      }
+      Z3ASTHandle otherwise(Z3_func_interp_get_else(ctx, function), ctx);
+      unsigned fallback = 0;
+      numeric = numeric && getByte(otherwise, fallback);
+      Z3_func_interp_dec_ref(ctx, function);
+
+      if (numeric) {
+        for (uint32_t index : indices) {
+          auto it = entries.find(index);
+          values.emplace_back(index, it != entries.end() ? it->second
+                                                         : fallback);
+        }
+        model.assign(values.begin(), values.end());
+        return;
+      }
+    }
+  }
+
+  // otherwise evaluate the bytes one by one
+  for (uint32_t index : indices) {
+    ::Z3_ast rawValue;
+    bool success = Z3_model_eval(ctx, theModel,
+                                 builder->getInitialRead(root, index),
+                                 /*model_completion=*/Z3_TRUE, &rawValue);
+    assert(success && "Failed to evaluate model");
+    Z3ASTHandle valueEvaluated(rawValue, ctx);
+    unsigned byte = 0;
+    success = getByte(valueEvaluated, byte);
+    assert(success && "Integer from model is out of range");
+    (void) success;
+    values.emplace_back(index, byte);
+  }
+  model.assign(values.begin(), values.end());
+}
+
 bool Z3SolverImpl::validateZ3Model(::Z3_solver &theSolver, ::Z3_model &theModel) {
   bool success = true;
   ::Z3_ast_vector constraints =
@@ -0,0 +1,112 @@
+//===-- ArchiveWriter.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/ArchiveWriter.h"
+
+#include "klee/Config/config.h"
+#include "klee/Internal/Support/FileHandling.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+using namespace klee;
+
+namespace {
+  const size_t BlockSize = 512;
+
+  void putOctal(char *field, size_t width, unsigned long long value) {
+    // width - 1 digits and the terminator
+    snprintf(field, width, "%0*llo", static_cast<int>(width - 1), value);
+  }
+}
+
+std::unique_ptr<ArchiveWriter>
+ArchiveWriter::create(const std::string &path, bool compress,
+                      std::string &error) {
+  std::unique_ptr<llvm::raw_ostream> file;
+#ifdef HAVE_ZLIB_H
+  if (compress)
+    file = klee_open_compressed_output_file(path, error);
+  else
+#endif
+    file = klee_open_output_file(path, error);
+  if (!file)
+    return nullptr;
+  return std::unique_ptr<ArchiveWriter>(new ArchiveWriter(std::move(file)));
+}
+
+ArchiveWriter::ArchiveWriter(std::unique_ptr<llvm::raw_ostream> _file)
+    : file(std::move(_file)) {
+  thread = std::thread(&ArchiveWriter::run, this);
+}
+
+ArchiveWriter::~ArchiveWriter() {
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    closing = true;
+  }
+  wakeup.notify_one();
+  thread.join();
+
+  // the end of the archive is marked by two empty blocks
+  std::string end(2 * BlockSize, '\0');
+  file->write(end.data(), end.size());
+  file->flush();
+}
+
+void ArchiveWriter::appendMember(std::string &members,
+                                 const std::string &name,
+                                 const std::string &contents) {
+  // a ustar header, the names of test files fit its name field
+  char header[BlockSize];
+  memset(header, 0, sizeof(header));
+  strncpy(header, name.c_str(), 99);
+  putOctal(header + 100, 8, 0644);
+  putOctal(header + 108, 8, 0);
+  putOctal(header + 116, 8, 0);
+  putOctal(header + 124, 12, contents.size());
+  putOctal(header + 136, 12, time(nullptr));
+  header[156] = '0';
+  memcpy(header + 257, "ustar", 6);
+  memcpy(header + 263, "00", 2);
+
+  // the checksum is taken with its own field filled with spaces
+  memset(header + 148, ' ', 8);
+  unsigned checksum = 0;
+  for (unsigned char c : header)
+    checksum += c;
+  snprintf(header + 148, 8, "%06o", checksum);
+
+  members.append(header, sizeof(header));
+  members += contents;
+  members.append((BlockSize - contents.size() % BlockSize) % BlockSize, '\0');
+}
+
+void ArchiveWriter::add(std::string members) {
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    pending.push_back(std::move(members));
+  }
+  wakeup.notify_one();
+}
+
+void ArchiveWriter::run() {
+  std::unique_lock<std::mutex> guard(mutex);
+  for (;;) {
+    wakeup.wait(guard, [this] { return closing || !pending.empty(); });
+    if (pending.empty())
+      return;
+    std::string members = std::move(pending.front());
+    pending.pop_front();
+    guard.unlock();
+    file->write(members.data(), members.size());
+    guard.lock();
+  }
+}
@@ -11,11 +11,15 @@
 
 #include "klee/Config/config.h"
 
+#ifdef HAVE_JEMALLOC_JEMALLOC_H
+#include "jemalloc/jemalloc.h"
+#endif
+
 #ifdef HAVE_GPERFTOOLS_MALLOC_EXTENSION_H
 #include "gperftools/malloc_extension.h"
 #endif
 
-#ifdef HAVE_MALLINFO
+#if defined(HAVE_MALLINFO) || defined(HAVE_MALLINFO2)
 #include <malloc.h>
 #endif
 #ifdef HAVE_MALLOC_ZONE_STATISTICS
@@ -90,11 +94,24 @@ size_t util::GetTotalMallocUsage() {
   return ASAN_GET_ALLOCATED_MEM_FUNCTION();
 #endif
 
-#ifdef HAVE_GPERFTOOLS_MALLOC_EXTENSION_H
+#ifdef HAVE_JEMALLOC_JEMALLOC_H
+  // the statistics are a snapshot taken when the epoch advances
+  uint64_t epoch = 1;
+  size_t size = sizeof(epoch);
+  mallctl("epoch", &epoch, &size, &epoch, size);
+  size_t allocated = 0;
+  size = sizeof(allocated);
+  mallctl("stats.allocated", &allocated, &size, nullptr, 0);
+  return allocated;
+#elif defined(HAVE_GPERFTOOLS_MALLOC_EXTENSION_H)
   size_t value = 0;
   MallocExtension::instance()->GetNumericProperty(
       "generic.current_allocated_bytes", &value);
   return value;
+#elif defined(HAVE_MALLINFO2)
+  // unlike mallinfo(), does not wrap around past 4 GB
+  struct mallinfo2 mi = ::mallinfo2();
+  return mi.uordblks + mi.hblkhd;
 #elif defined(HAVE_MALLINFO)
   struct mallinfo mi = ::mallinfo();
   // The malloc implementation in glibc (pmalloc2)
@@ -120,3 +137,21 @@ size_t util::GetTotalMallocUsage() {
 
 #endif
 }
+
+const char *util::GetMallocImplementation() {
+#ifdef KLEE_ASAN_BUILD
+  return "asan";
+#elif defined(HAVE_JEMALLOC_JEMALLOC_H)
+  return "jemalloc";
+#elif defined(HAVE_GPERFTOOLS_MALLOC_EXTENSION_H)
+  return "tcmalloc";
+#elif defined(HAVE_MALLINFO2)
+  return "mallinfo2";
+#elif defined(HAVE_MALLINFO)
+  return "mallinfo";
+#elif defined(HAVE_MALLOC_ZONE_STATISTICS)
+  return "malloc_zone_statistics";
+#else
+  return "none";
+#endif
+}
@@ -12,6 +12,7 @@
 
 
 #include <cstdint>
+#include <ctime>
 #include <regex>
 #include <sstream>
 #include <tuple>
@@ -207,3 +208,17 @@ time::Point time::getWallTime() {
   return time::Point(std::chrono::steady_clock::now());
 }
 
+time::Point time::getCoarseWallTime() {
+#ifdef CLOCK_MONOTONIC_COARSE
+  // steady_clock reads CLOCK_MONOTONIC, the coarse variant has the same
+  // origin and is read without going to the clock source
+  struct timespec ts;
+  if (!clock_gettime(CLOCK_MONOTONIC_COARSE, &ts))
+    return time::Point(std::chrono::steady_clock::time_point(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::seconds(ts.tv_sec) +
+            std::chrono::nanoseconds(ts.tv_nsec))));
+#endif
+  return getWallTime();
+}
+
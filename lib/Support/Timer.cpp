@@ -48,18 +48,39 @@ void Timer::reset(const time::Point &currentTime) {
 // TimerGroup
 
 TimerGroup::TimerGroup(const time::Span &minInterval) :
-  invocationTimer{
-    minInterval,
-    [&]{
-      // invoke timers
-      for (auto &timer : timers)
-        timer->invoke(currentTime);
-    }
-  } {};
+  minInterval{minInterval} {};
+
+TimerGroup::~TimerGroup() {
+  stop();
+}
+
+void TimerGroup::stop() {
+  if (!ticker.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(tickerMutex);
+    stopping = true;
+  }
+  tickerStop.notify_one();
+  ticker.join();
+  stopping = false;
+}
+
+void TimerGroup::tick() {
+  // deadlines are absolute so that late wake-ups do not add up
+  const std::chrono::microseconds interval(minInterval.toMicroseconds());
+  auto deadline = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(tickerMutex);
+  for (;;) {
+    deadline += interval;
+    if (tickerStop.wait_until(lock, deadline, [this] { return stopping; }))
+      return;
+    ticks.fetch_add(1, std::memory_order_relaxed);
+  }
+}
 
 void TimerGroup::add(std::unique_ptr<klee::Timer> timer) {
   const auto &interval = timer->getInterval();
-  const auto &minInterval = invocationTimer.getInterval();
   if (interval < minInterval)
     klee_warning("Timer interval below minimum timer interval (-timer-interval)");
   if (interval.toMicroseconds() % minInterval.toMicroseconds())
@@ -68,14 +89,24 @@ void TimerGroup::add(std::unique_ptr<klee::Timer> timer) {
   timers.emplace_back(std::move(timer));
 }
 
-void TimerGroup::invoke() {
-  currentTime = time::getWallTime();
-  invocationTimer.invoke(currentTime);
+void TimerGroup::invokeTimers() {
+  // the timers see time in whole ticks, so one whose interval is a
+  // multiple of the minimum interval is due on exactly every k-th tick
+  seenTicks = ticks.load(std::memory_order_relaxed);
+  const auto currentTime = start + minInterval * static_cast<unsigned>(seenTicks);
+  for (auto &timer : timers)
+    timer->invoke(currentTime);
 }
 
 void TimerGroup::reset() {
-  currentTime = time::getWallTime();
-  invocationTimer.reset(currentTime);
+  stop();
+
+  start = time::getWallTime();
   for (auto &timer : timers)
-    timer->reset(currentTime);
+    timer->reset(start);
+
+  ticks.store(0, std::memory_order_relaxed);
+  seenTicks = 0;
+  if (minInterval)
+    ticker = std::thread(&TimerGroup::tick, this);
 }
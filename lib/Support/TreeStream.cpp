@@ -23,11 +23,40 @@
 
 using namespace klee;
 
+namespace {
+  // records start with varints, small ids and runs take a byte or two
+  void writeVarint(std::ostream &os, uint64_t value) {
+    char bytes[10];
+    unsigned n = 0;
+    do {
+      bytes[n++] = (value & 0x7f) | (value > 0x7f ? 0x80 : 0);
+      value >>= 7;
+    } while (value);
+    os.write(bytes, n);
+  }
+
+  bool readVarint(std::istream &is, uint64_t &value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      int c = is.get();
+      if (c == EOF)
+        return false;
+      value |= uint64_t(c & 0x7f) << shift;
+      if (!(c & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  // the tag of a record, forks have the lowest bit set
+  const uint64_t ForkTag = 1;
+}
+
 ///
 
 TreeStreamWriter::TreeStreamWriter(const std::string &_path) 
   : lastID(0),
-    bufferCount(0),
+    bufferBits(0),
     path(_path),
     output(new std::ofstream(path.c_str(), 
                              std::ios::out | std::ios::binary)),
@@ -55,36 +84,46 @@ TreeOStream TreeStreamWriter::open(const TreeOStream &os) {
   assert(output && os.writer==this);
   flushBuffer();
   unsigned id = ids++;
-  output->write(reinterpret_cast<const char*>(&os.id), 4);
-  unsigned tag = id | (1<<31);
-  output->write(reinterpret_cast<const char*>(&tag), 4);
+  writeRecord(os.id, (uint64_t(id) << 1) | ForkTag);
   return TreeOStream(*this, id);
 }
 
-void TreeStreamWriter::write(TreeOStream &os, const char *s, unsigned size) {
-  if (bufferCount && 
-      (os.id!=lastID || size+bufferCount>bufferSize))
+void TreeStreamWriter::writeRecord(unsigned id, uint64_t tag) {
+  writeVarint(*output, id);
+  writeVarint(*output, tag);
+}
+
+void TreeStreamWriter::write(TreeOStream &os, const unsigned char *bits,
+                             unsigned count) {
+  if (bufferBits && 
+      (os.id!=lastID || count+bufferBits>bufferSize*8))
     flushBuffer();
-  if (bufferCount) { // (os.id==lastID && size+bufferCount<=bufferSize)
-    memcpy(&buffer[bufferCount], s, size);
-    bufferCount += size;
-  } else if (size<bufferSize) {
-    lastID = os.id;
-    memcpy(buffer, s, size);
-    bufferCount = size;
-  } else {
-    output->write(reinterpret_cast<const char*>(&os.id), 4);
-    output->write(reinterpret_cast<const char*>(&size), 4);
-    output->write(s, size);
+  if (!bufferBits && count>=bufferSize*8) {
+    writeRecord(os.id, uint64_t(count) << 1);
+    output->write(reinterpret_cast<const char*>(bits), (count+7)/8);
+    return;
+  }
+
+  lastID = os.id;
+  if (bufferBits%8 == 0 && count%8 == 0) {
+    memcpy(&buffer[bufferBits/8], bits, count/8);
+    bufferBits += count;
+    return;
+  }
+  for (unsigned i=0; i<count; i++, bufferBits++) {
+    unsigned char mask = 1 << (bufferBits%8);
+    if (bits[i/8] & (1 << (i%8)))
+      buffer[bufferBits/8] |= mask;
+    else
+      buffer[bufferBits/8] &= ~mask;
   }
 }
 
 void TreeStreamWriter::flushBuffer() {
-  if (bufferCount) {    
-    output->write(reinterpret_cast<const char*>(&lastID), 4);
-    output->write(reinterpret_cast<const char*>(&bufferCount), 4);
-    output->write(buffer, bufferCount);
-    bufferCount = 0;
+  if (bufferBits) {    
+    writeRecord(lastID, uint64_t(bufferBits) << 1);
+    output->write(reinterpret_cast<const char*>(buffer), (bufferBits+7)/8);
+    bufferBits = 0;
   }
 }
 
@@ -93,8 +132,8 @@ void TreeStreamWriter::flush() {
   output->flush();
 }
 
-void TreeStreamWriter::readStream(TreeStreamID streamID,
-                                  std::vector<unsigned char> &out) {
+void TreeStreamWriter::readBits(TreeStreamID streamID,
+                                std::vector<bool> &out) {
   assert(streamID>0 && streamID<ids);
   flush();
   
@@ -106,13 +145,12 @@ void TreeStreamWriter::readStream(TreeStreamID streamID,
   std::map<unsigned,unsigned> parents;
   std::vector<unsigned> roots;
   for (;;) {
-    assert(is.good());
-    unsigned id;
-    unsigned tag;
-    is.read(reinterpret_cast<char*>(&id), 4);
-    is.read(reinterpret_cast<char*>(&tag), 4);
-    if (tag&(1<<31)) { // fork
-      unsigned child = tag ^ (1<<31);
+    uint64_t id, tag;
+    bool ok = readVarint(is, id) && readVarint(is, tag);
+    assert(ok && "stream not found");
+    (void) ok;
+    if (tag & ForkTag) {
+      unsigned child = tag >> 1;
 
       if (child==streamID) {
         roots.push_back(child);
@@ -127,8 +165,7 @@ void TreeStreamWriter::readStream(TreeStreamID streamID,
         parents.insert(std::make_pair(child,id));
       }
     } else {
-      unsigned size = tag;
-      while (size--) is.get();
+      is.ignore(((tag >> 1) + 7) / 8);
     }
   }
   KLEE_DEBUG({
@@ -138,28 +175,49 @@ void TreeStreamWriter::readStream(TreeStreamID streamID,
       }
       llvm::errs() << "\n";
     });
+  is.clear();
   is.seekg(0, std::ios::beg);
+  std::vector<unsigned char> bytes;
   for (;;) {
-    unsigned id;
-    unsigned tag;
-    is.read(reinterpret_cast<char*>(&id), 4);
-    is.read(reinterpret_cast<char*>(&tag), 4);
-    if (!is.good()) break;
-    if (tag&(1<<31)) { // fork
-      unsigned child = tag ^ (1<<31);
+    uint64_t id, tag;
+    if (!readVarint(is, id) || !readVarint(is, tag))
+      break;
+    if (tag & ForkTag) {
+      unsigned child = tag >> 1;
       if (id==roots.back() && roots.size()>1 && child==roots[roots.size()-2])
         roots.pop_back();
     } else {
-      unsigned size = tag;
+      uint64_t count = tag >> 1;
       if (id==roots.back()) {
-        while (size--) out.push_back(is.get());
+        bytes.resize((count + 7) / 8);
+        is.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+        for (uint64_t i = 0; i < count; i++)
+          out.push_back(bytes[i/8] & (1 << (i%8)));
       } else {
-        while (size--) is.get();
+        is.ignore((count + 7) / 8);
       }
     }
   }  
 }
 
+void TreeStreamWriter::readStream(TreeStreamID streamID,
+                                  std::vector<bool> &out) {
+  readBits(streamID, out);
+}
+
+void TreeStreamWriter::readStream(TreeStreamID streamID,
+                                  std::vector<unsigned char> &out) {
+  std::vector<bool> bits;
+  readBits(streamID, bits);
+  assert(bits.size()%8 == 0 && "not a stream of bytes");
+  for (size_t i = 0; i < bits.size(); i += 8) {
+    unsigned char c = 0;
+    for (unsigned j = 0; j < 8; j++)
+      c |= bits[i+j] << j;
+    out.push_back(c);
+  }
+}
+
 ///
 
 TreeOStream::TreeOStream()
@@ -182,7 +240,8 @@ unsigned TreeOStream::getID() const {
 
 void TreeOStream::write(const char *buffer, unsigned size) {
   assert(writer);
-  writer->write(*this, buffer, size);
+  writer->write(*this, reinterpret_cast<const unsigned char*>(buffer),
+                size*8);
 }
 
 TreeOStream &TreeOStream::operator<<(const std::string &s) {
@@ -191,6 +250,12 @@ TreeOStream &TreeOStream::operator<<(const std::string &s) {
   return *this;
 }
 
+void TreeOStream::writeBranch(bool taken) {
+  assert(writer);
+  unsigned char bit = taken;
+  writer->write(*this, &bit, 1);
+}
+
 void TreeOStream::flush() {
   assert(writer);
   writer->flush();
@@ -59,6 +59,7 @@ static exe_disk_file_t *__get_sym_file(const char *pathname) {
 static void *__concretize_ptr(const void *p);
 static size_t __concretize_size(size_t s);
 static const char *__concretize_string(const char *s);
+static void __copy_contents(void *dest, const void *src, size_t n);
 
 /* Returns pointer to the file entry for a valid fd */
 static exe_file_t *__get_file(int fd) {
@@ -383,7 +384,7 @@ ssize_t read(int fd, void *buf, size_t count) {
       count = f->dfile->size - f->off;
     }
     
-    memcpy(buf, f->dfile->contents + f->off, count);
+    __copy_contents(buf, f->dfile->contents + f->off, count);
     f->off += count;
     
     return count;
@@ -447,7 +448,7 @@ ssize_t write(int fd, const void *buf, size_t count) {
     }
     
     if (actual_count)
-      memcpy(f->dfile->contents + f->off, buf, actual_count);
+      __copy_contents(f->dfile->contents + f->off, buf, actual_count);
     
     if (count != actual_count)
       klee_warning("write() ignores bytes.\n");
@@ -1335,6 +1336,17 @@ char *getcwd(char *buf, size_t size) {
 
 /*** Helper functions ***/
 
+/* Copy to or from the contents of a symbolic file. Copies at concrete places
+   are done natively, symbolic ones go through memcpy so that they are not
+   concretized. */
+static void __copy_contents(void *dest, const void *src, size_t n) {
+  if (klee_is_symbolic(n) || klee_is_symbolic((uintptr_t) dest) ||
+      klee_is_symbolic((uintptr_t) src))
+    memcpy(dest, src, n);
+  else
+    klee_memcpy(dest, src, n);
+}
+
 static void *__concretize_ptr(const void *p) {
   /* XXX 32-bit assumption */
   char *pc = (char*) klee_get_valuel((long) p);
@@ -0,0 +1,38 @@
+// Check that --batch-entry-points explores each function with its own
+// test directory, and that static constructors run for all of them.
+//
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --batch-entry-points=first,second %t.bc 2>&1 | FileCheck %s
+// RUN: test -f %t.klee-out/first/test000001.ktest
+// RUN: test -f %t.klee-out/first/test000002.ktest
+// RUN: not test -f %t.klee-out/first/test000003.ktest
+// RUN: test -f %t.klee-out/second/test000001.ktest
+// RUN: not test -f %t.klee-out/second/test000002.ktest
+// RUN: FileCheck -check-prefix=CHECK-INFO -input-file=%t.klee-out/info %s
+#include "klee/klee.h"
+
+#include <assert.h>
+
+static int initialized;
+
+__attribute__((constructor)) static void init(void) { initialized = 1; }
+
+int first(void) {
+  assert(initialized);
+  if (klee_int("x") > 0)
+    return 1;
+  return 0;
+}
+
+int second(void) {
+  assert(initialized);
+  return 0;
+}
+
+int main(void) { return first() + second(); }
+// CHECK: exploring entry point 'first'
+// CHECK: exploring entry point 'second'
+
+// CHECK-INFO: KLEE: session first: completed paths = 2, generated tests = 2
+// CHECK-INFO: KLEE: session second: completed paths = 1, generated tests = 1
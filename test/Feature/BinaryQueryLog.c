@@ -0,0 +1,26 @@
+// Check that the binary query log replays with the results it logged.
+//
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-cex-cache=false --use-query-log=all:kqb,solver:kqb %t.bc
+// RUN: %kleaver -replay-benchmark %t.klee-out/all-queries.kqb | FileCheck %s
+// RUN: %kleaver -replay-benchmark %t.klee-out/solver-queries.kqb | FileCheck %s
+// RUN: %kleaver -evaluate %t.klee-out/all-queries.kqb | FileCheck -check-prefix=CHECK-EVAL %s
+#include "klee/klee.h"
+
+int main() {
+  char buf[4];
+  klee_make_symbolic(buf, sizeof buf, "buf");
+
+  int x = *(int *)buf;
+  if (x > 100 && buf[0] == 'a')
+    return 1;
+  if (x % 7 == 3)
+    return 2;
+  return 0;
+}
+// CHECK-NOT: differs from the logged
+// CHECK: replayed queries = {{[1-9]}}
+
+// CHECK-EVAL: Query 0:
+// CHECK-EVAL-NOT: FAIL
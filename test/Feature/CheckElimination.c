@@ -0,0 +1,29 @@
+// Check that divisions and shifts whose operands are known to be in range
+// get no checks, and the others still do.
+//
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --check-div-zero --check-overshift %t.bc 2>&1 | FileCheck %s -check-prefix=CHECK-MSG
+// RUN: FileCheck %s -input-file=%t.klee-out/assembly.ll
+#include "klee/klee.h"
+
+int main(void) {
+  unsigned a, b, s;
+  klee_make_symbolic(&a, sizeof(a), "a");
+  klee_make_symbolic(&b, sizeof(b), "b");
+  klee_make_symbolic(&s, sizeof(s), "s");
+
+  // CHECK-MSG: Inserted {{[0-9]+}} division checks, {{[1-9][0-9]*}} divisors proven non-zero
+  // CHECK-MSG: Inserted {{[0-9]+}} overshift checks, {{[1-9][0-9]*}} shifts proven in range
+
+  // CHECK-LABEL: @main(
+  // CHECK: call void @klee_overshift_check
+  // CHECK-NEXT: shl {{.*}} !klee.check.shift
+  // CHECK: call void @klee_div_zero_check
+  // CHECK-NEXT: udiv {{.*}} !klee.check.div
+  // CHECK-NOT: call void @klee_{{overshift_check|div_zero_check}}
+  // CHECK: ret i32
+  unsigned r = (a << s) + a / b;
+  r += (a << (s & 31)) + a / (b | 1);
+  return r == 7;
+}
@@ -0,0 +1,41 @@
+// Check that --check-leaks follows pointers stored in heap objects and in
+// integers, and still reports the objects no pointer is left to.
+//
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --check-leaks %t.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out/ | grep .leak.err | wc -l | grep 1
+#include "klee/klee.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+struct node {
+  struct node *next;
+};
+
+struct node *head;
+uintptr_t hidden;
+
+int main(void) {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+
+  // reachable only through another heap object
+  head = malloc(sizeof(struct node));
+  head->next = malloc(sizeof(struct node));
+  head->next->next = NULL;
+
+  // reachable only through an integer
+  hidden = (uintptr_t)malloc(16);
+
+  struct node *lost = malloc(sizeof(struct node));
+  lost->next = NULL;
+  if (x) {
+    // CHECK: memory error: memory leak detected
+    lost = NULL;
+    return 0;
+  }
+  head->next->next = lost;
+  return 0;
+}
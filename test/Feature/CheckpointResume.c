@@ -0,0 +1,30 @@
+// Check that --resume-from explores exactly the paths a halted run left
+// unfinished at its checkpoint.
+//
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.klee-resumed
+// RUN: %klee --output-dir=%t.klee-out --search=dfs --checkpoint-interval=1h --max-instructions=2000 --dump-states-on-halt=false %t.bc
+// RUN: test -f %t.klee-out/checkpoint
+// RUN: not test -f %t.klee-out/test000008.ktest
+// RUN: %klee --output-dir=%t.klee-resumed --search=dfs --resume-from=%t.klee-out %t.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out/ %t.klee-resumed/ | grep .ktest | wc -l | grep 8
+#include "klee/klee.h"
+
+int main(void) {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+
+  int n = 0;
+  if (x & 1)
+    n++;
+  if (x & 2)
+    n++;
+  if (x & 4)
+    n++;
+
+  // CHECK: resuming {{[0-9]+}} forks from the checkpoint
+  volatile int sum = 0;
+  for (int i = 0; i < 100; i++)
+    sum += i * n;
+  return 0;
+}
@@ -0,0 +1,34 @@
+// Check that states compacted while waiting for their turn continue with
+// their constraints, registers and memory intact.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --compact-states-after=1 --search=bfs %t.bc 2>&1 | FileCheck %s
+#include "klee/klee.h"
+
+#include <assert.h>
+
+int main() {
+  int x, y;
+  int buffer[4];
+  klee_make_symbolic(&x, sizeof x, "x");
+  klee_make_symbolic(&y, sizeof y, "y");
+  klee_assume(x > 0 & x < 4);
+
+  buffer[0] = x;
+  buffer[x] = y;
+  int sum = 0;
+  for (int i = 0; i < 4; ++i) {
+    if (y > i * 10)
+      sum += i;
+  }
+
+  assert(buffer[0] == x);
+  assert(buffer[x] == y);
+  assert(x > 0 && x < 4);
+  assert(sum >= 0 && sum <= 6);
+  return 0;
+}
+
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 5
@@ -0,0 +1,29 @@
+// Check that a constant table read at a symbolic index yields its contents,
+// for tables of bytes and of wider integers.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=CHECK-INFO %s < %t.klee-out/info
+#include "klee/klee.h"
+
+#include <assert.h>
+
+static const char digits[] = "0123456789abcdef";
+static const int squares[] = {0, 1, 4, 9, 16, 25, 36, 49};
+
+int main() {
+  unsigned i = klee_range(0, 16, "i");
+  unsigned j = klee_range(0, 8, "j");
+
+  assert((i >= 10) | (digits[i] == '0' + i));
+  assert((i < 10) | (digits[i] == 'a' + i - 10));
+  assert(squares[j] == (int)(j * j));
+
+  // CHECK-NOT: ASSERTION FAIL
+  if (squares[j] == 49)
+    return 1;
+  return 0;
+}
+
+// CHECK-INFO: KLEE: done: completed paths = 2
@@ -0,0 +1,26 @@
+// Check that the .cov files only hold the lines their test covered first,
+// that klee-cov merges them, and that it applies run.istats.delta.
+//
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --write-cov --istats-deltas --istats-write-after-instructions=10 %t.bc 2>&1 | FileCheck %s
+// RUN: klee-cov %t.klee-out | FileCheck -check-prefix=CHECK-COV %s
+// RUN: klee-cov --growth %t.klee-out | FileCheck -check-prefix=CHECK-GROWTH %s
+// RUN: grep "^delta: 1" %t.klee-out/run.istats.delta
+// RUN: tail -n 1 %t.klee-out/run.istats.delta | grep full
+// RUN: klee-cov --istats %t.klee-out > %t.istats
+// RUN: diff %t.istats %t.klee-out/run.istats
+#include "klee/klee.h"
+
+int main() {
+  int x, sum = 0;
+  klee_make_symbolic(&x, sizeof x, "x");
+  for (int i = 0; i < 100; ++i)
+    sum += i;
+  if (x > sum)
+    return 1; // CHECK-COV-DAG: CoverageDeltas.c:[[@LINE]]
+  return 0;   // CHECK-COV-DAG: CoverageDeltas.c:[[@LINE]]
+}
+// CHECK: KLEE: done: generated tests = 2
+// CHECK-GROWTH: test000001: +{{[0-9]+}}
+// CHECK-GROWTH: test000002: +{{[0-9]+}}
@@ -0,0 +1,34 @@
+// Check that -deterministic-test-ids names the tests after their paths, the
+// same whatever order the searcher explores them in.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.dfs.klee-out %t.bfs.klee-out
+// RUN: %klee --output-dir=%t.dfs.klee-out --deterministic-test-ids --search=dfs %t.bc
+// RUN: %klee --output-dir=%t.bfs.klee-out --deterministic-test-ids --search=bfs %t.bc
+// RUN: ls %t.dfs.klee-out | grep -c "^test[0-9a-f]\{16\}\.ktest$" | grep 8
+// RUN: ls %t.dfs.klee-out | grep "^test" > %t.dfs.tests
+// RUN: ls %t.bfs.klee-out | grep "^test" > %t.bfs.tests
+// RUN: diff %t.dfs.tests %t.bfs.tests
+#include "klee/klee.h"
+
+#include <assert.h>
+
+int main() {
+  int x, y;
+  klee_make_symbolic(&x, sizeof x, "x");
+  klee_make_symbolic(&y, sizeof y, "y");
+
+  int r = 0;
+  if (x > 10)
+    r += 1;
+  if (y > 10)
+    r += 2;
+  switch (x & 3) {
+  case 1:
+    assert(r != 3);
+    break;
+  default:
+    break;
+  }
+  return r;
+}
@@ -0,0 +1,18 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -trace-events %t.bc 2> %t.log
+// RUN: klee-trace %t.klee-out > %t.json
+// RUN: FileCheck -input-file=%t.json %s
+#include "klee/klee.h"
+
+int main() {
+  int a;
+  klee_make_symbolic(&a, sizeof(a), "a");
+  if (a > 10)
+    return 1;
+  return 0;
+}
+// CHECK: "traceEvents"
+// CHECK-DAG: "name": "query branch"
+// CHECK-DAG: "name": "fork"
+// CHECK-DAG: "name": "terminate"
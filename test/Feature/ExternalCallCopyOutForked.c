@@ -0,0 +1,41 @@
+// Check that memory changed by an external call on one path is copied out
+// again before an external call on another path, which must see its own
+// contents and not those left behind by the first path.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --search=dfs %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --search=bfs %t.bc 2>&1 | FileCheck %s
+#include "klee/klee.h"
+
+#include <string.h>
+
+char first[8] = "initial";
+char second[8] = "initial";
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  // both objects are now copied out and up to date
+  strlen(first);
+
+  // each path lets external code change a different object
+  if (x)
+    strcpy(first, "changed");
+  else
+    strcpy(second, "changed");
+
+  // and calls out again, copying out its own contents
+  strlen(first);
+  strlen(second);
+
+  if (first[0] != (x ? 'c' : 'i'))
+    klee_report_error(__FILE__, __LINE__, "stale first", "copyout");
+  if (second[0] != (x ? 'i' : 'c'))
+    klee_report_error(__FILE__, __LINE__, "stale second", "copyout");
+  return 0;
+}
+// CHECK-NOT: ERROR
+// CHECK: KLEE: done: completed paths = 2
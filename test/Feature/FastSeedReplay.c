@@ -0,0 +1,42 @@
+// Check that -fast-seed-replay follows the seeds, and that the sides no
+// seed takes are explored once they are found feasible.
+//
+// RUN: %clang -emit-llvm -c -g %s -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc "initial"
+// RUN: test -f %t.klee-out/test000001.ktest
+// RUN: not test -f %t.klee-out/test000002.ktest
+
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --fast-seed-replay --seed-file %t.klee-out/test000001.ktest %t.bc > %t.log
+// RUN: FileCheck -input-file=%t.log %s
+// RUN: FileCheck -check-prefix=CHECK-INFO -input-file=%t.klee-out-2/info %s
+
+#include "klee/klee.h"
+
+#include <stdio.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+  int x;
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  if (argc == 2 && strcmp(argv[1], "initial") == 0) {
+    klee_assume(x == 5);
+    return 0;
+  }
+
+  // CHECK-DAG: small
+  // CHECK-DAG: big
+  if (x > 10)
+    printf("big\n");
+  else if (x == 5)
+    printf("small\n");
+
+  // the seed fixes x, the other side of this branch is infeasible
+  if (x == 5 && x != 5)
+    printf("impossible\n");
+  // CHECK-NOT: impossible
+  return 0;
+}
+// CHECK-INFO: KLEE: done: completed paths = 3
@@ -0,0 +1,48 @@
+// Check that objects storing pointers read and write right when their
+// segments and offsets are interleaved in one array.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -fused-pointer-layout %t.bc 2>&1 | FileCheck %s
+#include "klee/klee.h"
+
+#include <string.h>
+
+int values[4] = {10, 20, 30, 40};
+
+struct node {
+  int value;
+  int *ptr;
+};
+
+int main() {
+  unsigned i, j;
+  klee_make_symbolic(&i, sizeof i, "i");
+  klee_make_symbolic(&j, sizeof j, "j");
+  klee_assume(i < 4 & j < 4);
+
+  // concrete bytes written before the first pointer keep their value
+  struct node nodes[4];
+  for (unsigned k = 0; k != 4; ++k)
+    nodes[k].value = k;
+  for (unsigned k = 0; k != 4; ++k)
+    nodes[k].ptr = &values[k];
+
+  // a pointer read at a symbolic offset keeps its segment
+  if (*nodes[i].ptr != values[i] || nodes[i].value != (int)i)
+    klee_report_error(__FILE__, __LINE__, "wrong pointer", "fused");
+
+  // and so does one written at a symbolic offset
+  nodes[j].ptr = &values[3 - j];
+  if (*nodes[j].ptr != 40 - 10 * (int)j)
+    klee_report_error(__FILE__, __LINE__, "wrong pointer", "fused");
+
+  // copies between fused and plain objects
+  struct node copy[4];
+  memcpy(copy, nodes, sizeof copy);
+  if (*copy[3].ptr != (j == 3 ? 10 : 40) || copy[2].value != 2)
+    klee_report_error(__FILE__, __LINE__, "wrong copy", "fused");
+  return 0;
+}
+// CHECK-NOT: ERROR
+// CHECK: KLEE: done
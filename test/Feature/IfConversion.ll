@@ -0,0 +1,52 @@
+; Check that -if-convert turns the branches on a symbolic value around small
+; side-effect free blocks into selects, so that the state does not fork.
+;
+; RUN: rm -rf %t.klee-out
+; RUN: llvm-as -f %s -o %t.bc
+; RUN: %klee --output-dir=%t.klee-out --if-convert=4 %t.bc
+; RUN: FileCheck --input-file=%t.klee-out/info %s
+; CHECK: KLEE: done: completed paths = 1
+
+target triple = "x86_64-pc-linux-gnu"
+
+@.str = private unnamed_addr constant [2 x i8] c"x\00", align 1
+
+define i32 @main() {
+entry:
+  %p = alloca i32, align 4
+  %0 = bitcast i32* %p to i8*
+  call void @klee_make_symbolic(i8* %0, i64 4, i8* getelementptr inbounds ([2 x i8], [2 x i8]* @.str, i32 0, i32 0))
+  %x = load i32, i32* %p, align 4
+  %c = icmp sgt i32 %x, 10
+  br i1 %c, label %then, label %else
+
+then:
+  %t1 = mul i32 %x, 3
+  %t2 = xor i32 %t1, 5
+  %t3 = add i32 %t2, 1
+  br label %join
+
+else:
+  %e1 = shl i32 %x, 2
+  %e2 = sub i32 %e1, 7
+  %e3 = and i32 %e2, 255
+  br label %join
+
+join:
+  %v = phi i32 [ %t3, %then ], [ %e3, %else ]
+  %c2 = icmp eq i32 %x, 0
+  br i1 %c2, label %zero, label %done
+
+zero:
+  %z1 = or i32 %v, 16
+  %z2 = mul i32 %z1, %v
+  br label %done
+
+done:
+  %r = phi i32 [ %z2, %zero ], [ %v, %join ]
+  %c3 = icmp ne i32 %r, 0
+  %ret = zext i1 %c3 to i32
+  ret i32 %ret
+}
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
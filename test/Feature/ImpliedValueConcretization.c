@@ -0,0 +1,28 @@
+// Check that bytes of a symbolic object pinned by a constraint are written
+// back as concrete bytes, while the others stay symbolic.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --implied-value-concretization %t.bc 2>&1 | FileCheck %s
+#include "klee/klee.h"
+
+#include <assert.h>
+
+int main() {
+  unsigned x[2];
+  klee_make_symbolic(x, sizeof x, "x");
+
+  klee_assume(x[0] == 0x01020304);
+  assert(!klee_is_symbolic(x[0]));
+  assert(x[0] == 0x01020304);
+  assert(klee_is_symbolic(x[1]));
+
+  // a byte written before the constraint keeps the value written
+  ((unsigned char *)x)[4] = 7;
+  klee_assume(x[1] == 0x0a0b0c07);
+  assert(!klee_is_symbolic(x[1]));
+  assert(x[1] == 0x0a0b0c07);
+  return 0;
+}
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 1
@@ -0,0 +1,32 @@
+// Check that the tests of a run packed into a ktest pack seed and replay
+// the same paths as the .ktest files they were packed from.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.ktestpack
+// RUN: %klee --output-dir=%t.klee-out %t.bc
+// RUN: %ktest-pack -o %t.ktestpack %t.klee-out
+// RUN: %ktest-pack -l %t.ktestpack | FileCheck -check-prefix=CHECK-LIST %s
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --only-replay-seeds --seed-file %t.ktestpack %t.bc 2>&1 | FileCheck -check-prefix=CHECK-SEED %s
+// RUN: rm -rf %t.klee-out-3
+// RUN: %klee --output-dir=%t.klee-out-3 --replay-ktest-file %t.ktestpack %t.bc 2>&1 | FileCheck -check-prefix=CHECK-REPLAY %s
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof x, "x");
+  if (x > 10)
+    return 1;
+  if (x < 0)
+    return 2;
+  return 0;
+}
+// CHECK-LIST: test000001.ktest: 1 objects, 4 bytes
+// CHECK-LIST: test000002.ktest: 1 objects, 4 bytes
+// CHECK-LIST: test000003.ktest: 1 objects, 4 bytes
+
+// CHECK-SEED: using 3 seeds
+// CHECK-SEED: generated tests = 3
+
+// CHECK-REPLAY: replaying: {{.*}}test000001.ktest (4 bytes) (1/3)
+// CHECK-REPLAY: replaying: {{.*}}test000003.ktest (4 bytes) (3/3)
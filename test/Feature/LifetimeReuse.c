@@ -0,0 +1,30 @@
+// Check that a block-scoped local gets the same object in every iteration
+// of a loop, and that it is dead between its lifetimes.
+//
+// RUN: %clang %s -emit-llvm -g -O1 -Xclang -disable-llvm-passes -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck %s
+// RUN: %clang %s -emit-llvm -g -O1 -Xclang -disable-llvm-passes -DUSE_AFTER_SCOPE -c -o %t2.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t2.bc 2>&1 | FileCheck -check-prefix=CHECK-UAS %s
+#include "klee/klee.h"
+
+int main() {
+  volatile char *first = 0;
+  volatile char *last = 0;
+  for (int i = 0; i < 100; ++i) {
+    volatile char buf[16];
+    buf[i % 16] = i;
+    if (!first)
+      first = buf;
+    last = buf;
+  }
+  klee_assert(first == last);
+#ifdef USE_AFTER_SCOPE
+  return last[0];
+#endif
+  return 0;
+}
+// CHECK-NOT: KLEE: ERROR
+// CHECK: KLEE: done: completed paths = 1
+// CHECK-UAS: KLEE: ERROR: {{.*}}memory error
@@ -0,0 +1,29 @@
+// Check that values whose expressions grow deeper than -max-expr-depth are
+// concretized, noted in the test info and reported by instruction.
+//
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --optimize -max-expr-depth=16 -write-test-info %t.bc 2>&1 | FileCheck %s
+// RUN: FileCheck -check-prefix=CHECK-INFO -input-file=%t.klee-out/test000001.info %s
+// RUN: FileCheck -check-prefix=CHECK-RUN -input-file=%t.klee-out/info %s
+#include "klee/klee.h"
+
+int main() {
+  unsigned x, h = 0;
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  for (unsigned i = 0; i < 64; ++i)
+    h = h * 31 + (x ^ i);
+
+  if (h == 0x12345678)
+    return 1;
+  return 0;
+}
+// CHECK: silently concretizing (reason: max-expr-depth)
+// CHECK: KLEE: concretized {{[0-9]+}} values exceeding -max-expr-depth, most often at {{.*}}MaxExprDepth.c:16
+// CHECK: KLEE: done: completed paths =
+
+// CHECK-INFO: concretized a value of depth {{[0-9]+}} (limit 16) at {{.*}}MaxExprDepth.c:16
+
+// CHECK-RUN: Values concretized by -max-expr-depth, by instruction:
+// CHECK-RUN-NEXT: {{[0-9]+}} at {{.*}}MaxExprDepth.c:16
@@ -0,0 +1,46 @@
+// Check that a call reading only concrete memory is run once for all the
+// paths calling it with the same arguments, and that it is run again once
+// the memory it read changed.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -memoize-calls %t.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=CHECK-INFO %s < %t.klee-out/info
+#include "klee/klee.h"
+
+unsigned char data[64];
+
+unsigned checksum(const unsigned char *p, unsigned n) {
+  unsigned sum = 0;
+  for (unsigned i = 0; i < n; ++i)
+    sum = sum * 31 + p[i];
+  return sum;
+}
+
+int main() {
+  unsigned expected = 0;
+  for (unsigned i = 0; i < sizeof data; ++i) {
+    data[i] = i;
+    expected = expected * 31 + i;
+  }
+
+  int x;
+  klee_make_symbolic(&x, sizeof x, "x");
+  if (x > 0) {
+    if (checksum(data, sizeof data) != expected)
+      klee_report_error(__FILE__, __LINE__, "wrong checksum", "memo");
+  } else {
+    if (checksum(data, sizeof data) != expected)
+      klee_report_error(__FILE__, __LINE__, "wrong checksum", "memo");
+    // the cached result no longer holds
+    data[7] = 0;
+    if (checksum(data, sizeof data) == expected)
+      klee_report_error(__FILE__, __LINE__, "stale checksum", "memo");
+  }
+  return 0;
+}
+// CHECK-NOT: ERROR
+// CHECK: KLEE: done: completed paths = 2
+
+// CHECK-INFO: Calls memoized by -memoize-calls, by function:
+// CHECK-INFO-NEXT: checksum: 1 of 3 calls hit (33%), 2 results cached
@@ -0,0 +1,64 @@
+// Check that the floating point instructions computed natively agree with
+// APFloat on concrete operands, including the edge cases.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -debug-validate-native-floating-point %t.bc 2>&1 | FileCheck %s
+#include <float.h>
+#include <math.h>
+
+volatile double doubles[] = {0.0, -0.0, 1.0, -1.5, 3.0, 1e308, DBL_MIN / 4,
+                             DBL_MAX, 2.5e-3, 9007199254740993.0, 4e18,
+                             -9.3e18, 1e20};
+volatile float floats[] = {0.0f, -0.0f, 1.0f, -1.5f, 3.0f, 1e38f,
+                           FLT_MIN / 4, FLT_MAX, 2.5e-3f, 16777217.0f};
+volatile long long ints[] = {0, -1, 1, 16777217, 9007199254740993LL,
+                             -9223372036854775807LL - 1};
+
+int main() {
+  unsigned nd = sizeof doubles / sizeof doubles[0];
+  unsigned nf = sizeof floats / sizeof floats[0];
+  volatile double d;
+  volatile float f;
+  volatile int c;
+  volatile long long l;
+  volatile unsigned long long u;
+
+  for (unsigned i = 0; i < nd; ++i) {
+    for (unsigned j = 0; j < nd; ++j) {
+      d = doubles[i] + doubles[j];
+      d = doubles[i] - doubles[j];
+      d = doubles[i] * doubles[j];
+      d = doubles[i] / doubles[j];
+      c = doubles[i] < doubles[j];
+      c = doubles[i] == doubles[j];
+      c = doubles[i] >= doubles[j];
+    }
+    f = (float)doubles[i];
+    if (doubles[i] > -9.2e18 && doubles[i] < 9.2e18)
+      l = (long long)doubles[i];
+    if (doubles[i] >= 0 && doubles[i] < 1.8e19)
+      u = (unsigned long long)doubles[i];
+  }
+
+  for (unsigned i = 0; i < nf; ++i) {
+    for (unsigned j = 0; j < nf; ++j) {
+      f = floats[i] + floats[j];
+      f = floats[i] * floats[j];
+      f = floats[i] / floats[j];
+      c = floats[i] != floats[j];
+    }
+    d = floats[i];
+    if (floats[i] > -2e9f && floats[i] < 2e9f)
+      c = (int)floats[i];
+  }
+
+  for (unsigned i = 0; i < sizeof ints / sizeof ints[0]; ++i) {
+    f = (float)ints[i];
+    d = (double)ints[i];
+    d = (double)(unsigned long long)ints[i];
+  }
+  return 0;
+}
+// CHECK-NOT: differs
+// CHECK: KLEE: done
@@ -0,0 +1,47 @@
+// Check that copying memory directly keeps symbolic bytes, pointers and
+// overlapping moves intact, and leaves out-of-bounds calls to the library.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -native-memory-functions=false %t.bc 2>&1 | FileCheck %s
+#include "klee/klee.h"
+
+#include <string.h>
+
+int main() {
+  unsigned char src[16], dst[16];
+  int x, *ptrs[2] = {&x, 0}, *copy[2];
+  unsigned char c;
+  klee_make_symbolic(&c, sizeof c, "c");
+
+  for (unsigned i = 0; i < sizeof src; ++i)
+    src[i] = i;
+  src[3] = c;
+
+  memcpy(dst, src, sizeof src);
+  if (dst[3] != c || dst[15] != 15)
+    klee_report_error(__FILE__, __LINE__, "wrong copy", "native");
+
+  // overlapping, towards higher addresses
+  memmove(dst + 1, dst, 8);
+  if (dst[0] != 0 || dst[4] != c || dst[8] != 7 || dst[9] != 9)
+    klee_report_error(__FILE__, __LINE__, "wrong move", "native");
+
+  memset(dst, c, 4);
+  if (dst[0] != c || dst[3] != c || dst[4] != c)
+    klee_report_error(__FILE__, __LINE__, "wrong fill", "native");
+
+  memcpy(copy, ptrs, sizeof ptrs);
+  *copy[0] = 42;
+  if (x != 42 || copy[1])
+    klee_report_error(__FILE__, __LINE__, "wrong pointer", "native");
+
+  // reported by the library function
+  memcpy(dst + 8, src, 9);
+  return 0;
+}
+// CHECK-NOT: wrong
+// CHECK: memory error: out of bound pointer
+// CHECK-NOT: wrong
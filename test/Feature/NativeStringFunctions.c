@@ -0,0 +1,39 @@
+// Check that the string functions computed natively agree with the library
+// and leave strings with symbolic bytes to it.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --libc=klee %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --libc=klee -native-string-functions=false %t.bc 2>&1 | FileCheck %s
+#include "klee/klee.h"
+
+#include <string.h>
+
+int main() {
+  char buf[16], sym[4] = "ab";
+  const char *s = "hello";
+
+  if (strlen(s) != 5 || strcmp(s, "help") >= 0 || strcmp(s, "hello") ||
+      strncmp(s, "helium", 3) || strncmp(s, "helium", 4) <= 0)
+    klee_report_error(__FILE__, __LINE__, "wrong compare", "native");
+
+  if (strchr(s, 'l') != s + 2 || strchr(s, 'x') || strchr(s, 0) != s + 5)
+    klee_report_error(__FILE__, __LINE__, "wrong strchr", "native");
+
+  memset(buf, 'x', sizeof buf);
+  strncpy(buf, s, 8);
+  if (strcmp(buf, s) || buf[7] != 0 || buf[8] != 'x')
+    klee_report_error(__FILE__, __LINE__, "wrong strncpy", "native");
+  strcpy(buf + 1, s);
+  if (buf[0] != 'h' || strcmp(buf + 1, s))
+    klee_report_error(__FILE__, __LINE__, "wrong strcpy", "native");
+
+  // a symbolic byte goes to the library, which forks on it
+  klee_make_symbolic(&sym[1], 1, "c");
+  if (strlen(sym) == 1)
+    return 1;
+  return 0;
+}
+// CHECK-NOT: wrong
+// CHECK: KLEE: done: completed paths = 2
@@ -0,0 +1,26 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -write-ptree-log %t.bc 2> %t.log
+// RUN: klee-ptree %t.klee-out > %t.dot
+// RUN: FileCheck -check-prefix=CHECK-DOT -input-file=%t.dot %s
+// RUN: klee-ptree --json %t.klee-out > %t.json
+// RUN: FileCheck -check-prefix=CHECK-JSON -input-file=%t.json %s
+#include "klee/klee.h"
+
+int main() {
+  int a, b;
+  klee_make_symbolic(&a, sizeof(a), "a");
+  klee_make_symbolic(&b, sizeof(b), "b");
+  int r = 0;
+  if (a > 10)
+    r += 1;
+  if (b > 10)
+    r += 2;
+  return r;
+}
+// CHECK-DOT: digraph G {
+// CHECK-DOT: [shape=diamond,fillcolor=green];
+// CHECK-DOT-NEXT: }
+
+// Once all states terminated, only the leaf of the last one is left
+// CHECK-JSON: "nodes": [{"id": {{[0-9]+}}, "parent": null}]
@@ -0,0 +1,30 @@
+// Check that a value concretized on a path is reused by later
+// concretizations of the same expression, by klee_get_value and by the
+// states forked afterwards.
+//
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error %t.bc 2>&1 | FileCheck %s
+#include "klee/klee.h"
+
+#include <assert.h>
+
+int main() {
+  int x = klee_int("x");
+  klee_assume(x > 10);
+  klee_assume(x < 20);
+
+  // concretized for the conversion, which pins x
+  double d = x;
+  assert(klee_get_value_i32(x) == (int)d);
+
+  int y = klee_int("y");
+  if (y > 0)
+    assert((double)x == d);
+  else
+    assert(klee_get_value_i32(x) == (int)d);
+  return 0;
+}
+// CHECK: silently concretizing (reason: floating point)
+// CHECK-NOT: silently concretizing
+// CHECK: KLEE: done: completed paths = 2
@@ -0,0 +1,27 @@
+// Check that -profile-solver-chain reports the queries of each layer of the
+// solver chain, from the top down, and adds their columns to run.stats.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --profile-solver-chain %t.bc
+// RUN: FileCheck %s < %t.klee-out/info
+// RUN: klee-stats --to-csv %t.klee-out > %t.stats.csv
+// RUN: FileCheck -check-prefix=CHECK-STATS -input-file=%t.stats.csv %s
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof x, "x");
+  if (x > 10)
+    return 1;
+  if (x > 5)
+    return 2;
+  return 0;
+}
+
+// CHECK: Solver chain profile
+// CHECK: independence
+// CHECK: branch cache
+// CHECK: cex cache
+// CHECK: core
+// CHECK-STATS: CoreLayerQueries,CoreLayerPassedQueries,CoreLayerHits,CoreLayerTime
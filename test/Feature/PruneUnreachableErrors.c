@@ -0,0 +1,38 @@
+// Check that -prune-unreachable-errors explores only the paths that may
+// still call the error function.
+//
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --error-fn=__VERIFIER_error --prune-unreachable-errors %t.bc 2>&1 | FileCheck %s
+// RUN: test -f %t.klee-out/test000001.assert.err
+// RUN: not test -f %t.klee-out/test000002.ktest
+#include "klee/klee.h"
+
+extern void __VERIFIER_error(void);
+
+static int count(int y) {
+  int n = 0;
+  if (y & 1)
+    n++;
+  if (y & 2)
+    n++;
+  if (y & 4)
+    n++;
+  return n;
+}
+
+int main(void) {
+  int x, y;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&y, sizeof(y), "y");
+
+  // the calls returning here may still reach the error below
+  int n = count(y);
+  if (x > 0)
+    return n;
+
+  if (x == -5 && n == 3)
+    // CHECK: ASSERTION FAIL: __VERIFIER_error called
+    __VERIFIER_error();
+  return 0;
+}
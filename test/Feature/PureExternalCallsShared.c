@@ -0,0 +1,26 @@
+// Check that with -external-calls=pure the calls of an undefined function
+// with equal arguments return the same value, and that the calls with
+// arguments that only may be equal return the same value when they are.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --external-calls=pure %t.bc 2>&1 | FileCheck %s
+#include "klee/klee.h"
+
+extern int undefined_hash(int);
+
+int main() {
+  int x, y;
+  klee_make_symbolic(&x, sizeof x, "x");
+  klee_make_symbolic(&y, sizeof y, "y");
+
+  if (undefined_hash(x) != undefined_hash(x))
+    klee_report_error(__FILE__, __LINE__, "different results", "pure");
+  if (undefined_hash(3) != undefined_hash(3))
+    klee_report_error(__FILE__, __LINE__, "different results", "pure");
+  if (x == y && undefined_hash(x) != undefined_hash(y))
+    klee_report_error(__FILE__, __LINE__, "different results", "pure");
+  return 0;
+}
+// CHECK-NOT: ERROR
+// CHECK: KLEE: done
@@ -0,0 +1,25 @@
+// Check that solver queries are accounted to their purposes in run.stats and,
+// with --istats-query-purposes, in run.istats.
+//
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --istats-query-purposes %t.bc 2> %t.log
+// RUN: FileCheck -check-prefix=CHECK-ISTATS -input-file=%t.klee-out/run.istats %s
+// RUN: klee-stats --to-csv %t.klee-out > %t.stats.csv
+// RUN: FileCheck -check-prefix=CHECK-STATS -input-file=%t.stats.csv %s
+#include "klee/klee.h"
+
+int main() {
+  int a;
+  klee_make_symbolic(&a, sizeof(int), "a");
+  if (a > 10)
+    return 1;
+  return 0;
+}
+
+// CHECK-ISTATS-NOT: event: Iuncov :
+// CHECK-ISTATS: event: BrQtime : BranchQueryTime
+// CHECK-ISTATS-NOT: event: Iuncov :
+// CHECK-ISTATS: events:
+
+// CHECK-STATS: BranchQueries,BranchQueryTime,BranchQueryCacheHits,BranchQueryTimeouts
@@ -0,0 +1,41 @@
+// Check that growing and shrinking an object with realloc keeps its
+// contents, in place and, by default, not.
+//
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --realloc-in-place %t.bc 2>&1 | FileCheck -check-prefix=CHECK-IN-PLACE %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck -check-prefix=CHECK-COPY %s
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int main() {
+  unsigned char x;
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  unsigned size = 16;
+  unsigned char *p = malloc(size);
+  unsigned char *first = p;
+  p[0] = x;
+  for (unsigned i = 1; i < size; ++i)
+    p[i] = i;
+  while (size < 4096) {
+    p = realloc(p, size * 2);
+    for (unsigned i = size; i < size * 2; ++i)
+      p[i] = i;
+    size *= 2;
+  }
+  p = realloc(p, 8);
+
+  assert(p[0] == x);
+  for (unsigned i = 1; i < 8; ++i)
+    assert(p[i] == i);
+  printf("%s\n", p == first ? "same" : "moved");
+  free(p);
+  return 0;
+}
+// CHECK-IN-PLACE: same
+// CHECK-COPY: moved
@@ -7,6 +7,11 @@
 // RUN: %klee --output-dir=%t.klee-out-2 --replay-path %t.klee-out/test000001.path %t2.bc > %t3.log
 // RUN: diff %t3.log %t3.good
 
+// RUN: rm -rf %t.klee-out-3 %t.klee-out-4
+// RUN: %klee --output-dir=%t.klee-out-3 --write-paths --compact-paths %t1.bc > %t4.good
+// RUN: %klee --output-dir=%t.klee-out-4 --replay-path %t.klee-out-3/test000001.path %t2.bc > %t4.log
+// RUN: diff %t4.log %t4.good
+
 #include <unistd.h>
 #include <stdio.h>
 
@@ -0,0 +1,23 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --write-paths --max-depth=1 %t.bc 2>&1 | FileCheck --check-prefix=CHECK-PREFIX %s
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --replay-path %t.klee-out/test000001.path %t.bc 2>&1 | FileCheck --check-prefix=CHECK-SUBTREE %s
+
+// Replaying a path prefix explores the whole subtree below it.
+
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  if (x & 1) x++;
+  if (x & 2) x++;
+  if (x & 4) x++;
+
+  return 0;
+}
+
+// CHECK-PREFIX: KLEE: done: completed paths = 2
+// CHECK-SUBTREE: KLEE: done: completed paths = 4
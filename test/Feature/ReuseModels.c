@@ -0,0 +1,24 @@
+// Check that answering queries from the models kept for the states does not
+// change the explored paths.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -reuse-models -search=dfs %t.bc 2>&1 | FileCheck %s
+#include "klee/klee.h"
+
+int main() {
+  unsigned char buf[4];
+  int count = 0;
+  klee_make_symbolic(buf, sizeof buf, "buf");
+  for (int i = 0; i < 4; ++i)
+    if (buf[i] > 'a' + i)
+      ++count;
+
+  // a value of the model satisfies the path constraints
+  unsigned char first = klee_get_value_i32(buf[0]);
+  if (count == 4 && first <= 'a')
+    klee_report_error(__FILE__, __LINE__, "value violates the path", "model");
+  return count;
+}
+// CHECK-NOT: ERROR
+// CHECK: KLEE: done: completed paths = 16
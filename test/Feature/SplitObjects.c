@@ -0,0 +1,35 @@
+// Check that reads at bounded symbolic offsets into a large object only refer
+// to the windows around the offsets and still see the right contents.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -split-objects=256 %t.bc 2>&1 | FileCheck %s
+#include "klee/klee.h"
+
+unsigned char table[1 << 16];
+
+int main() {
+  unsigned i;
+  unsigned char c;
+  klee_make_symbolic(&i, sizeof i, "i");
+  klee_make_symbolic(&c, sizeof c, "c");
+  klee_assume(i >= 1000 & i < 1010);
+
+  for (unsigned k = 0; k < sizeof table; ++k)
+    table[k] = k * 7;
+  table[1005] = c;
+
+  // a symbolic byte in the window is read back as written
+  unsigned char expected = i == 1005 ? c : (unsigned char)(i * 7);
+  if (table[i] != expected)
+    klee_report_error(__FILE__, __LINE__, "wrong contents", "split");
+
+  // a read straddling two windows
+  unsigned short word = *(unsigned short *)&table[i + 20];
+  if (word != (unsigned short)((i + 20) * 7 & 0xff | ((i + 21) * 7 & 0xff) << 8))
+    klee_report_error(__FILE__, __LINE__, "wrong contents", "split");
+  return 0;
+}
+// CHECK-NOT: flushing
+// CHECK-NOT: ERROR
+// CHECK: KLEE: done: completed paths = 2
@@ -0,0 +1,36 @@
+// Check that a write at a bounded symbolic offset into a large object only
+// flushes the bytes it may reach, and that the object reads back right.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -split-objects=256 %t.bc 2>&1 | FileCheck %s
+#include "klee/klee.h"
+
+unsigned char table[1 << 16];
+
+int main() {
+  unsigned i, j;
+  klee_make_symbolic(&i, sizeof i, "i");
+  klee_make_symbolic(&j, sizeof j, "j");
+  klee_assume(i >= 1000 & i < 1010);
+  klee_assume(j >= 990 & j < 1020);
+
+  for (unsigned k = 0; k < sizeof table; ++k)
+    table[k] = k * 7;
+  *(unsigned short *)&table[i] = 0xffff;
+
+  // bytes out of reach of the write keep their contents
+  if (table[999] != (unsigned char)(999 * 7) ||
+      table[1011] != (unsigned char)(1011 * 7) ||
+      table[40000] != (unsigned char)(40000 * 7))
+    klee_report_error(__FILE__, __LINE__, "wrong contents", "split");
+
+  // and so do the ones the write may reach but did not
+  unsigned char expected = j == i || j == i + 1 ? 0xff : (unsigned char)(j * 7);
+  if (table[j] != expected)
+    klee_report_error(__FILE__, __LINE__, "wrong contents", "split");
+  return 0;
+}
+// CHECK-NOT: flushing
+// CHECK-NOT: ERROR
+// CHECK: KLEE: done
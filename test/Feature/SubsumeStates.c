@@ -0,0 +1,39 @@
+// Check that states meeting an explored subtree are only dropped when the
+// subtree did not depend on the constraints they differ in.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --subsume-states --search=dfs %t.bc 2>&1 | FileCheck %s
+#include "klee/klee.h"
+
+int main() {
+  unsigned char a0, a1, a2, a3, b;
+  klee_make_symbolic(&a0, sizeof a0, "a0");
+  klee_make_symbolic(&a1, sizeof a1, "a1");
+  klee_make_symbolic(&a2, sizeof a2, "a2");
+  klee_make_symbolic(&a3, sizeof a3, "a3");
+  klee_make_symbolic(&b, sizeof b, "b");
+
+  // the paths join again with the same memory and registers
+  if (a0 > 100) {
+  }
+  if (a1 > 100) {
+  }
+  if (a2 > 100) {
+  }
+  if (a3 > 100) {
+  }
+
+  // depends on b only, explored once for all the paths above
+  if (b > 10) {
+    if (b > 20) {
+    }
+  }
+
+  // depends on a3, so the paths differing in it are not dropped
+  if (b == 42 && a3 == 142)
+    klee_report_error(__FILE__, __LINE__, "reached", "subsume");
+  return 0;
+}
+// CHECK: ERROR: {{.*}}SubsumeStates.c:{{[0-9]+}}: reached
+// CHECK: KLEE: done
@@ -0,0 +1,28 @@
+// Check that a function on integers is explored once and that its calls
+// bind the values of its paths instead of forking in it.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -summarize-functions %t.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=CHECK-INFO %s < %t.klee-out/info
+#include "klee/klee.h"
+
+int clamp(int x) {
+  int r = x;
+  if (x < 0)
+    r = 0;
+  else if (x > 100)
+    r = 100;
+  return r;
+}
+
+int main() {
+  int a = klee_int("a"), b = klee_int("b"), c = klee_int("c");
+  int sum = clamp(a) + clamp(b) + clamp(c);
+  klee_assert(sum >= 0 && sum <= 300);
+  if (clamp(a) == 100 && a < 100)
+    klee_assert(0);
+  return 0;
+}
+// CHECK-NOT: ASSERTION FAIL
+// CHECK-INFO: KLEE: done: completed paths = 2
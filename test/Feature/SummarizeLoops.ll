@@ -0,0 +1,52 @@
+; Check that -summarize-loops runs a loop up to a symbolic bound in a single
+; step: the state only forks on the bound check and on the element read
+; after the loop.
+;
+; RUN: rm -rf %t.klee-out
+; RUN: llvm-as -f %s -o %t.bc
+; RUN: %klee --output-dir=%t.klee-out --summarize-loops %t.bc
+; RUN: FileCheck --input-file=%t.klee-out/info %s
+; CHECK: KLEE: done: completed paths = 3
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+@a = global [10 x i32] zeroinitializer, align 16
+@.str = private unnamed_addr constant [2 x i8] c"n\00", align 1
+
+define i32 @main() {
+entry:
+  %p = alloca i32, align 4
+  %0 = bitcast i32* %p to i8*
+  call void @klee_make_symbolic(i8* %0, i64 4, i8* getelementptr inbounds ([2 x i8], [2 x i8]* @.str, i32 0, i32 0))
+  %n = load i32, i32* %p, align 4
+  %big = icmp sgt i32 %n, 10
+  br i1 %big, label %done, label %header
+
+header:
+  %i = phi i32 [ 0, %entry ], [ %inc, %body ]
+  %c = icmp slt i32 %i, %n
+  br i1 %c, label %body, label %exit
+
+body:
+  %idx = sext i32 %i to i64
+  %elem = getelementptr inbounds [10 x i32], [10 x i32]* @a, i64 0, i64 %idx
+  store i32 5, i32* %elem, align 4
+  %inc = add nsw i32 %i, 1
+  br label %header
+
+exit:
+  %last = phi i32 [ %i, %header ]
+  %elem3 = getelementptr inbounds [10 x i32], [10 x i32]* @a, i64 0, i64 3
+  %v = load i32, i32* %elem3, align 4
+  %written = icmp eq i32 %v, 5
+  br i1 %written, label %yes, label %done
+
+yes:
+  ret i32 1
+
+done:
+  ret i32 0
+}
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
@@ -0,0 +1,39 @@
+// Check that enumerating the targets of a symbolic switch forks the same
+// states as checking each case, also for cases the constraints rule out.
+//
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --switch-type=internal --enumerate-switch-targets %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --switch-type=internal --enumerate-switch-targets=false %t.bc 2>&1 | FileCheck %s
+#include "klee/klee.h"
+
+int classify(unsigned char c) {
+  switch (c) {
+  case '0': case '1': case '2': case '3': case '4':
+  case '5': case '6': case '7': case '8': case '9':
+    return 1;
+  case 'a': case 'b': case 'c': case 'd': case 'e': case 'f':
+    return 2;
+  case ' ': case '\t':
+    return 3;
+  case 'x':
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+int main() {
+  unsigned char c, d;
+  klee_make_symbolic(&c, sizeof c, "c");
+  klee_make_symbolic(&d, sizeof d, "d");
+  // every target is feasible
+  int a = classify(c);
+  // only digits are left
+  if (d >= '0' && d <= '9')
+    a += classify(d);
+  return a;
+}
+// 5 targets for c, times the digit or not for d
+// CHECK: KLEE: done: generated tests = 10
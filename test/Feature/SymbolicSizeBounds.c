@@ -0,0 +1,38 @@
+// Check that accesses at constant offsets into an object of symbolic size
+// are bounded by what the path knows about the size.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -symbolic-size-range %t.bc 2>&1 | FileCheck %s
+#include "klee/klee.h"
+
+#include <stdlib.h>
+
+int main() {
+  unsigned n;
+  klee_make_symbolic(&n, sizeof n, "n");
+  klee_assume(n >= 4);
+  klee_assume(n <= 16);
+
+  char *p = malloc(n);
+  p[0] = 1;
+  p[3] = 2;
+  p[1] = p[0] + p[3];
+  if (p[1] != 3)
+    klee_report_error(__FILE__, __LINE__, "wrong value", "size");
+
+  if (n > 8) {
+    p[8] = 4;
+    if (p[8] != 4)
+      klee_report_error(__FILE__, __LINE__, "wrong value", "size");
+  }
+
+  // out of bounds on every path
+  p[16] = 0;
+  return 0;
+}
+// CHECK-NOT: wrong value
+// CHECK: memory error: out of bound pointer
+// CHECK-NOT: wrong value
@@ -0,0 +1,31 @@
+// Check that the test files go into the test archive, also from forked
+// test writers, and that klee-extract gets them out again.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --test-archive --write-testcases %t.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out/ | not grep test0
+// RUN: tar tf %t.klee-out/tests.tar | grep .ktest | wc -l | grep 8
+// RUN: tar tf %t.klee-out/tests.tar | grep .xml | wc -l | grep 8
+// RUN: rm -rf %t.extracted && mkdir %t.extracted
+// RUN: klee-extract -d %t.extracted %t.klee-out 3
+// RUN: %ktest-tool %t.extracted/test000003.ktest | FileCheck -check-prefix=CHECK-KTEST %s
+// RUN: not ls %t.extracted/test000004.ktest
+//
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --test-archive --test-writer-jobs=2 --write-testcases %t.bc 2>&1 | FileCheck %s
+// RUN: tar tf %t.klee-out/tests.tar | grep .ktest | wc -l | grep 8
+// RUN: tar tf %t.klee-out/tests.tar | grep .xml | wc -l | grep 8
+#include "klee/klee.h"
+
+int main() {
+  unsigned char buf[3];
+  int count = 0;
+  klee_make_symbolic(buf, sizeof buf, "buf");
+  for (int i = 0; i < 3; ++i)
+    if (buf[i] > 'a' + i)
+      ++count;
+  return count;
+}
+// CHECK: KLEE: done: generated tests = 8
+// CHECK-KTEST: name: 'buf'
@@ -0,0 +1,19 @@
+// REQUIRES: zlib
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --test-archive --compress-test-archive --test-writer-jobs=2 %t.bc 2>&1 | FileCheck %s
+// RUN: tar tzf %t.klee-out/tests.tar.gz | grep .ktest | wc -l | grep 4
+// RUN: klee-extract -l %t.klee-out 2 | FileCheck -check-prefix=CHECK-LIST %s
+#include "klee/klee.h"
+
+int main() {
+  unsigned char buf[2];
+  klee_make_symbolic(buf, sizeof buf, "buf");
+  if (buf[0] > 'a')
+    buf[0] = 0;
+  if (buf[1] > 'b')
+    buf[1] = 0;
+  return buf[0] + buf[1];
+}
+// CHECK: KLEE: done: generated tests = 4
+// CHECK-LIST: test000002.ktest
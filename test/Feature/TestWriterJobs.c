@@ -0,0 +1,20 @@
+// Check that the test files written by forked test writers are all there
+// and counted once the exploration ends.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --test-writer-jobs=2 --write-testcases %t.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out/ | grep .ktest | wc -l | grep 8
+// RUN: ls %t.klee-out/ | grep .xml | wc -l | grep 8
+#include "klee/klee.h"
+
+int main() {
+  unsigned char buf[3];
+  int count = 0;
+  klee_make_symbolic(buf, sizeof buf, "buf");
+  for (int i = 0; i < 3; ++i)
+    if (buf[i] > 'a' + i)
+      ++count;
+  return count;
+}
+// CHECK: KLEE: done: generated tests = 8
@@ -0,0 +1,26 @@
+// Check that a sampled crosscheck of the solver chain, in the background,
+// agrees with the core solver and does not change the exploration.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -debug-validate-solver -debug-validate-solver-rate=50 -debug-validate-solver-jobs=2 %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -debug-validate-solver -debug-validate-solver-cached-only %t.bc 2>&1 | FileCheck %s
+#include "klee/klee.h"
+
+int main() {
+  int x, y;
+  klee_make_symbolic(&x, sizeof x, "x");
+  klee_make_symbolic(&y, sizeof y, "y");
+
+  int n = 0;
+  if (x > 10)
+    n++;
+  if (y < x)
+    n++;
+  if (x > 10 && y == 3)
+    n++;
+  return n;
+}
+// CHECK-NOT: invalid solver result
+// CHECK: KLEE: done: completed paths = 5
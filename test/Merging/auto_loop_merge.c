@@ -0,0 +1,30 @@
+// RUN: %clang -emit-llvm -g -c -o %t.bc %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --auto-merge-loops --search=bfs %t.bc 2>&1 | FileCheck %s
+// RUN: FileCheck -check-prefix=CHECK-INFO -input-file=%t.klee-out/info %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --auto-merge-loops --search=dfs %t.bc 2>&1 | FileCheck %s
+// RUN: FileCheck -check-prefix=CHECK-INFO -input-file=%t.klee-out/info %s
+
+// The loop forks 2^8 states, which are all merged when they leave it, so the
+// branch after the loop is reached by a single state.
+// CHECK: generated tests = 1{{$}}
+// CHECK-INFO: merged states = 255
+
+#include "klee/klee.h"
+
+int main(int argc, char **args) {
+  int a[8];
+  int i, count = 0;
+
+  klee_make_symbolic(a, sizeof(a), "a");
+
+  for (i = 0; i < 8; ++i) {
+    if (a[i] > 0)
+      ++count;
+  }
+
+  if (count > 8)
+    return 1;
+  return 0;
+}
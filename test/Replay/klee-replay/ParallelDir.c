@@ -0,0 +1,23 @@
+// Check that the tests of a directory are replayed in parallel and that
+// their outcomes are summarised.
+//
+// RUN: rm -rf %t.out
+// RUN: mkdir -p %t.out
+// RUN: %gen-bout --bout-file %t.out/test000001.ktest 0
+// RUN: %gen-bout --bout-file %t.out/test000002.ktest 3
+// RUN: %gen-bout --bout-file %t.out/test000003.ktest 0
+// RUN: %cc %s -O0 -o %t
+// RUN: %klee-replay -j 2 %t %t.out 2> %t.log
+// RUN: FileCheck --input-file=%t.log %s
+
+// CHECK-DAG: Test file: {{.*}}test000001.ktest
+// CHECK-DAG: Test file: {{.*}}test000002.ktest
+// CHECK-DAG: Test file: {{.*}}test000003.ktest
+// CHECK-DAG: EXIT STATUS: ABNORMAL 3
+// CHECK: Replayed 3 tests: 2 normal, 1 abnormal, 0 crashed, 0 failed to replay
+
+#include <stdlib.h>
+
+int main(int argc, char **argv) {
+  return argc > 1 ? atoi(argv[1]) : 0;
+}
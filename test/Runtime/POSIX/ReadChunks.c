@@ -0,0 +1,44 @@
+// Check that reading and writing a symbolic file in small chunks copies the
+// contents right, whether the count is concrete or symbolic.
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error --posix-runtime %t.bc --sym-files 1 8 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+  char whole[8], chunks[8];
+
+  int fd = open("A", O_RDWR);
+  assert(fd != -1);
+  assert(read(fd, whole, sizeof(whole)) == sizeof(whole));
+
+  lseek(fd, 0, SEEK_SET);
+  for (unsigned i = 0; i != sizeof(chunks); ++i)
+    assert(read(fd, &chunks[i], 1) == 1);
+  for (unsigned i = 0; i != sizeof(chunks); ++i)
+    assert(chunks[i] == whole[i]);
+
+  // writes go back to the contents
+  lseek(fd, 2, SEEK_SET);
+  assert(write(fd, "xy", 2) == 2);
+  lseek(fd, 0, SEEK_SET);
+  assert(read(fd, chunks, sizeof(chunks)) == sizeof(chunks));
+  assert(chunks[1] == whole[1] && chunks[2] == 'x' && chunks[3] == 'y' &&
+         chunks[4] == whole[4]);
+
+  // a symbolic count is not concretized
+  unsigned count;
+  klee_make_symbolic(&count, sizeof(count), "count");
+  klee_assume(count >= 1 & count <= 2);
+  lseek(fd, 0, SEEK_SET);
+  assert(read(fd, chunks, count) == count);
+  return 0;
+}
+// CHECK-NOT: silently concretizing
+// CHECK: KLEE: done: completed paths = 2
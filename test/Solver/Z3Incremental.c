@@ -0,0 +1,19 @@
+// REQUIRES: z3
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -solver-backend=z3 -z3-incremental -search=dfs %t1.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=INFO %s < %t.klee-out/info
+
+#include "klee/klee.h"
+
+int main() {
+  unsigned char buf[4];
+  int count = 0;
+  klee_make_symbolic(buf, sizeof buf, "buf");
+  for (int i = 0; i < 4; ++i)
+    if (buf[i] > 'a' + i)
+      ++count;
+  return count;
+}
+// CHECK: KLEE: done: completed paths = 16
+// INFO: KLEE: done: reused incremental constraints =
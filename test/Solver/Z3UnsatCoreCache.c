@@ -0,0 +1,25 @@
+// REQUIRES: z3
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -solver-backend=z3 -use-unsat-core-cache -use-cex-cache=false -use-branch-cache=false -use-independent-solver=false %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+int main() {
+  unsigned char buf[3];
+  unsigned x;
+  klee_make_symbolic(buf, sizeof buf, "buf");
+  klee_make_symbolic(&x, sizeof x, "x");
+  klee_assume(x < 10);
+  int count = 0;
+  for (int i = 0; i < 3; ++i) {
+    if (buf[i] > 'a')
+      ++count;
+    // infeasible for the same reason on every path
+    if (x > 20)
+      klee_report_error(__FILE__, __LINE__, "unreachable", "core");
+  }
+  return count;
+}
+// CHECK-NOT: unreachable
+// CHECK: KLEE: done: completed paths = 8
@@ -0,0 +1,56 @@
+// RUN: %clang %s -emit-llvm %O0opt -g -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// NOTE: Have to pass `--optimize=false` to avoid vector operations being
+// constant folded away, and disable the checks so that the divisions and
+// shifts are not scalarized.
+// RUN: %klee --output-dir=%t.klee-out --optimize=false --exit-on-error --check-div-zero=false --check-overshift=false %t1.bc
+// RUN: FileCheck %s < %t.klee-out/info
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --optimize=false --exit-on-error --check-div-zero=false --check-overshift=false --native-vectors=false %t1.bc
+// RUN: FileCheck %s < %t.klee-out/info
+#include "klee/klee.h"
+#include <assert.h>
+#include <stdint.h>
+
+typedef uint32_t v4ui __attribute__((vector_size(16)));
+typedef int32_t v4si __attribute__((vector_size(16)));
+typedef uint16_t v4us __attribute__((vector_size(8)));
+
+int main() {
+  v4ui a = {1, 2, 3, 4};
+  v4ui b;
+  klee_make_symbolic(&b, sizeof(b), "b");
+  klee_assume(b[0] > 0 & b[1] > 0 & b[2] > 0 & b[3] > 0);
+
+  v4ui c = a + b;
+  v4ui d = (c ^ b) * a;
+  v4ui q = c / b;
+  v4ui s = (a << 2) >> 1;
+  for (int i = 0; i != 4; ++i) {
+    assert(c[i] == a[i] + b[i]);
+    assert(d[i] == ((a[i] + b[i]) ^ b[i]) * a[i]);
+    assert(q[i] == (a[i] + b[i]) / b[i]);
+    assert(s[i] == a[i] * 2);
+  }
+
+  v4si n = {-1, 2, -3, 4};
+  v4si less = n < (v4si){0, 0, 0, 0};
+  v4si picked = (less & n) | (~less & -n);
+  v4ui shuffled = __builtin_shufflevector(a, c, 7, 0, 5, 2);
+  v4us narrow = __builtin_convertvector(a, v4us);
+  for (int i = 0; i != 4; ++i) {
+    assert(less[i] == (n[i] < 0 ? -1 : 0));
+    assert(picked[i] == (i % 2 ? -n[i] : n[i]));
+    assert(narrow[i] == a[i]);
+  }
+  assert(shuffled[0] == c[3] & shuffled[1] == 1 & shuffled[2] == c[1] &
+         shuffled[3] == 3);
+
+  // one path per outcome of a lane of the symbolic vector
+  v4ui big = b > (v4ui){100, 100, 100, 100};
+  if (big[2])
+    return 1;
+  return 0;
+}
+
+// CHECK: KLEE: done: completed paths = 2
@@ -9,6 +9,8 @@
 
 #include "klee/Common.h"
 #include "klee/Config/Version.h"
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Assignment.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprBuilder.h"
@@ -17,20 +19,39 @@
 #include "klee/Expr/ExprVisitor.h"
 #include "klee/Expr/Parser/Lexer.h"
 #include "klee/Expr/Parser/Parser.h"
+#include "klee/Internal/Support/FileHandling.h"
 #include "klee/Internal/Support/PrintVersion.h"
 #include "klee/OptionCategories.h"
+#include "klee/Solver/BinaryQueryLog.h"
+#include "klee/Solver/RemoteSolver.h"
 #include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverCmdLine.h"
 #include "klee/Solver/SolverImpl.h"
 #include "klee/Statistics.h"
 
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <streambuf>
+#include <tuple>
+#include <vector>
+
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <set>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 
@@ -45,7 +66,16 @@ llvm::cl::opt<std::string> InputFile(llvm::cl::desc("<input query log>"),
                                      llvm::cl::Positional, llvm::cl::init("-"),
                                      llvm::cl::cat(klee::ExprCat));
 
-enum ToolActions { PrintTokens, PrintAST, PrintSMTLIBv2, Evaluate };
+enum ToolActions {
+  PrintTokens,
+  PrintAST,
+  PrintSMTLIBv2,
+  PrintBinary,
+  Evaluate,
+  ReplayBenchmark,
+  Benchmark,
+  Serve
+};
 
 static llvm::cl::opt<ToolActions> ToolAction(
     llvm::cl::desc("Tool actions:"), llvm::cl::init(Evaluate),
@@ -55,8 +85,23 @@ static llvm::cl::opt<ToolActions> ToolAction(
                                 "Print parsed input file as SMT-LIBv2 query."),
                      clEnumValN(PrintAST, "print-ast",
                                 "Print parsed AST nodes from the input file."),
+                     clEnumValN(PrintBinary, "print-binary",
+                                "Print the queries of the input file as a "
+                                "binary (.kqb) query log."),
                      clEnumValN(Evaluate, "evaluate",
-                                "Evaluate parsed AST nodes from the input file.")
+                                "Evaluate parsed AST nodes from the input file."),
+                     clEnumValN(ReplayBenchmark, "replay-benchmark",
+                                "Replay the queries of a binary (.kqb) query "
+                                "log as they were asked, and compare the time "
+                                "and the results with the logged ones."),
+                     clEnumValN(Benchmark, "benchmark",
+                                "Time the solver chain on the queries of the "
+                                "input file (.kquery or .kqb), see "
+                                "-benchmark-*."),
+                     clEnumValN(Serve, "serve",
+                                "Answer the queries of KLEE processes run "
+                                "with -solver-backend=remote instead of "
+                                "reading an input file, see -serve-*.")
                          KLEE_LLVM_CL_VAL_END),
     llvm::cl::cat(klee::SolvingCat));
 
@@ -78,6 +123,12 @@ static llvm::cl::opt<BuilderKinds> BuilderKind(
                          KLEE_LLVM_CL_VAL_END),
     llvm::cl::cat(klee::ExprCat));
 
+static llvm::cl::opt<bool> HashConsExprs(
+    "hash-cons-exprs",
+    llvm::cl::desc("Share one node between structurally equal expressions "
+                   "(default=false)"),
+    llvm::cl::init(false), llvm::cl::cat(klee::ExprCat));
+
 llvm::cl::opt<std::string> DirectoryToWriteQueryLogs(
     "query-log-dir",
     llvm::cl::desc(
@@ -89,6 +140,79 @@ llvm::cl::opt<bool> ClearArrayAfterQuery(
     llvm::cl::desc("Discard the previous array declarations after a query "
                    "is performed (default=false)"),
     llvm::cl::init(false), llvm::cl::cat(klee::ExprCat));
+
+llvm::cl::OptionCategory ServeCat("Serve options",
+                                  "These options control -serve.");
+
+llvm::cl::opt<unsigned> ServePort(
+    "serve-port",
+    llvm::cl::desc("TCP port to accept the remote solver clients on "
+                   "(default=7447)"),
+    llvm::cl::init(7447), llvm::cl::cat(ServeCat));
+
+llvm::cl::opt<unsigned> ServeJobs(
+    "serve-jobs",
+    llvm::cl::desc("Number of worker processes, each with its own solver "
+                   "chain and serving one client at a time; 0 for one per "
+                   "core (default=0)"),
+    llvm::cl::init(0), llvm::cl::cat(ServeCat));
+
+llvm::cl::OptionCategory BenchmarkCat("Benchmark options",
+                                      "These options control -benchmark.");
+
+llvm::cl::opt<unsigned> BenchmarkRepetitions(
+    "benchmark-repetitions",
+    llvm::cl::desc("Number of times each query is timed (default=1)"),
+    llvm::cl::init(1), llvm::cl::cat(BenchmarkCat));
+
+llvm::cl::opt<unsigned> BenchmarkWarmup(
+    "benchmark-warmup",
+    llvm::cl::desc("Number of times each query is asked before it is timed, "
+                   "which also fills the caches of the solver chain "
+                   "(default=0)"),
+    llvm::cl::init(0), llvm::cl::cat(BenchmarkCat));
+
+llvm::cl::opt<unsigned> BenchmarkJobs(
+    "benchmark-jobs",
+    llvm::cl::desc("Number of processes the queries are split between, each "
+                   "with its own solver chains; 0 for one per core "
+                   "(default=1)"),
+    llvm::cl::init(1), llvm::cl::cat(BenchmarkCat));
+
+llvm::cl::list<CoreSolverType> BenchmarkBackends(
+    "benchmark-backends",
+    llvm::cl::desc("Comma-separated list of the core solvers to compare, the "
+                   "first being the reference for the results (default=the "
+                   "-solver-backend)"),
+    llvm::cl::values(clEnumValN(STP_SOLVER, "stp", "STP"),
+                     clEnumValN(METASMT_SOLVER, "metasmt", "metaSMT"),
+                     clEnumValN(DUMMY_SOLVER, "dummy", "Dummy solver"),
+                     clEnumValN(Z3_SOLVER, "z3", "Z3"),
+                     clEnumValN(SMTLIB_SOLVER, "smtlib",
+                                "An SMT-LIBv2 solver process"),
+                     clEnumValN(PORTFOLIO_SOLVER, "portfolio",
+                                "Race all available backends")
+                         KLEE_LLVM_CL_VAL_END),
+    llvm::cl::CommaSeparated, llvm::cl::cat(BenchmarkCat));
+
+enum BenchmarkFormats { BenchmarkCSV, BenchmarkJSON };
+
+llvm::cl::opt<BenchmarkFormats> BenchmarkFormat(
+    "benchmark-format",
+    llvm::cl::desc("Format of the per-query measurements (default=csv)"),
+    llvm::cl::values(clEnumValN(BenchmarkCSV, "csv",
+                                "One row per measurement, with a summary "
+                                "per backend on stderr"),
+                     clEnumValN(BenchmarkJSON, "json",
+                                "The measurements and the summary as one "
+                                "JSON object")
+                         KLEE_LLVM_CL_VAL_END),
+    llvm::cl::init(BenchmarkCSV), llvm::cl::cat(BenchmarkCat));
+
+llvm::cl::opt<std::string> BenchmarkOutput(
+    "benchmark-output",
+    llvm::cl::desc("File to write the measurements to (default=stdout)"),
+    llvm::cl::init("-"), llvm::cl::cat(BenchmarkCat));
 } // namespace
 
 static std::string getQueryLogPath(const char filename[])
@@ -183,6 +307,109 @@ static bool PrintInputAST(const char *Filename,
   return success;
 }
 
+static Solver *createSolver(CoreSolverType Backend = CoreSolverToUse) {
+  Solver *coreSolver = klee::createCoreSolver(Backend);
+
+  if (Backend != DUMMY_SOLVER) {
+    const time::Span maxCoreSolverTime(MaxCoreSolverTime);
+    if (maxCoreSolverTime) {
+      coreSolver->setCoreSolverTimeout(maxCoreSolverTime);
+    }
+  }
+
+  return constructSolverChain(coreSolver,
+                              getQueryLogPath(ALL_QUERIES_SMT2_FILE_NAME),
+                              getQueryLogPath(SOLVER_QUERIES_SMT2_FILE_NAME),
+                              getQueryLogPath(ALL_QUERIES_KQUERY_FILE_NAME),
+                              getQueryLogPath(SOLVER_QUERIES_KQUERY_FILE_NAME),
+                              getQueryLogPath(ALL_QUERIES_BINARY_FILE_NAME),
+                              getQueryLogPath(SOLVER_QUERIES_BINARY_FILE_NAME));
+}
+
+/// Evaluate a query command and print the result.
+static void EvaluateQuery(Solver *S, const std::vector<ExprHandle> &Constraints,
+                          const ExprHandle &Q,
+                          const std::vector<ExprHandle> &Values,
+                          const std::vector<const Array *> &Objects) {
+  assert("FIXME: Support counterexample query commands!");
+  if (Values.empty() && Objects.empty()) {
+    bool result;
+    if (S->mustBeTrue(Query(ConstraintManager(Constraints), Q), result)) {
+      llvm::outs() << (result ? "VALID" : "INVALID");
+    } else {
+      llvm::outs() << "FAIL (reason: "
+                << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
+                << ")";
+    }
+  } else if (!Values.empty()) {
+    assert(Objects.empty() && 
+           "FIXME: Support counterexamples for values and objects!");
+    assert(Values.size() == 1 &&
+           "FIXME: Support counterexamples for multiple values!");
+    assert(Q->isFalse() &&
+           "FIXME: Support counterexamples with non-trivial query!");
+    ref<ConstantExpr> result;
+    if (S->getValue(Query(ConstraintManager(Constraints), Values[0]),
+                    result)) {
+      llvm::outs() << "INVALID\n";
+      llvm::outs() << "\tExpr 0:\t" << result;
+    } else {
+      llvm::outs() << "FAIL (reason: "
+                << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
+                << ")";
+    }
+  } else {
+    std::shared_ptr<const Assignment> result;
+    
+    if (S->getInitialValues(Query(ConstraintManager(Constraints), Q),
+                            result)) {
+      llvm::outs() << "INVALID\n";
+
+      for (unsigned i = 0, e = Objects.size(); i != e; ++i) {
+        llvm::outs() << "\tArray " << i << ":\t"
+                   << Objects[i]->name
+                   << "[";
+        for (unsigned j = 0; j != Objects[i]->size; ++j) {
+          llvm::outs() << (unsigned) result->getValue(Objects[i], j);
+          if (j + 1 != Objects[i]->size)
+            llvm::outs() << ", ";
+        }
+        llvm::outs() << "]";
+        if (i + 1 != e)
+          llvm::outs() << "\n";
+      }
+    } else {
+      SolverImpl::SolverRunStatus retCode = S->impl->getOperationStatusCode();
+      if (SolverImpl::SOLVER_RUN_STATUS_TIMEOUT == retCode) {
+        llvm::outs() << " FAIL (reason: "
+                  << SolverImpl::getOperationStatusString(retCode)
+                  << ")";
+      }           
+      else {
+        llvm::outs() << "VALID (counterexample request ignored)";
+      }
+    }
+  }
+
+  llvm::outs() << "\n";
+}
+
+static void PrintQueryStatistics() {
+  if (uint64_t queries = *theStatisticManager->getStatisticByName("Queries")) {
+    llvm::outs()
+      << "--\n"
+      << "total queries = " << queries << "\n"
+      << "total queries constructs = " 
+      << *theStatisticManager->getStatisticByName("QueriesConstructs") << "\n"
+      << "valid queries = " 
+      << *theStatisticManager->getStatisticByName("QueriesValid") << "\n"
+      << "invalid queries = " 
+      << *theStatisticManager->getStatisticByName("QueriesInvalid") << "\n"
+      << "query cex = " 
+      << *theStatisticManager->getStatisticByName("QueriesCEX") << "\n";
+  }
+}
+
 static bool EvaluateInputAST(const char *Filename,
                              const MemoryBuffer *MB,
                              ExprBuilder *Builder) {
@@ -202,20 +429,7 @@ static bool EvaluateInputAST(const char *Filename,
   if (!success)
     return false;
 
-  Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
-
-  if (CoreSolverToUse != DUMMY_SOLVER) {
-    const time::Span maxCoreSolverTime(MaxCoreSolverTime);
-    if (maxCoreSolverTime) {
-      coreSolver->setCoreSolverTimeout(maxCoreSolverTime);
-    }
-  }
-
-  Solver *S = constructSolverChain(coreSolver,
-                                   getQueryLogPath(ALL_QUERIES_SMT2_FILE_NAME),
-                                   getQueryLogPath(SOLVER_QUERIES_SMT2_FILE_NAME),
-                                   getQueryLogPath(ALL_QUERIES_KQUERY_FILE_NAME),
-                                   getQueryLogPath(SOLVER_QUERIES_KQUERY_FILE_NAME));
+  Solver *S = createSolver();
 
   unsigned Index = 0;
   for (std::vector<Decl*>::iterator it = Decls.begin(),
@@ -223,71 +437,7 @@ static bool EvaluateInputAST(const char *Filename,
     Decl *D = *it;
     if (QueryCommand *QC = dyn_cast<QueryCommand>(D)) {
       llvm::outs() << "Query " << Index << ":\t";
-
-      assert("FIXME: Support counterexample query commands!");
-      if (QC->Values.empty() && QC->Objects.empty()) {
-        bool result;
-        if (S->mustBeTrue(Query(ConstraintManager(QC->Constraints), QC->Query),
-                          result)) {
-          llvm::outs() << (result ? "VALID" : "INVALID");
-        } else {
-          llvm::outs() << "FAIL (reason: "
-                    << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
-                    << ")";
-        }
-      } else if (!QC->Values.empty()) {
-        assert(QC->Objects.empty() && 
-               "FIXME: Support counterexamples for values and objects!");
-        assert(QC->Values.size() == 1 &&
-               "FIXME: Support counterexamples for multiple values!");
-        assert(QC->Query->isFalse() &&
-               "FIXME: Support counterexamples with non-trivial query!");
-        ref<ConstantExpr> result;
-        if (S->getValue(Query(ConstraintManager(QC->Constraints), 
-                              QC->Values[0]),
-                        result)) {
-          llvm::outs() << "INVALID\n";
-          llvm::outs() << "\tExpr 0:\t" << result;
-        } else {
-          llvm::outs() << "FAIL (reason: "
-                    << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
-                    << ")";
-        }
-      } else {
-        std::shared_ptr<const Assignment> result;
-        
-        if (S->getInitialValues(Query(ConstraintManager(QC->Constraints), 
-                                      QC->Query),
-                                result)) {
-          llvm::outs() << "INVALID\n";
-
-          for (unsigned i = 0, e = QC->Objects.size(); i != e; ++i) {
-            llvm::outs() << "\tArray " << i << ":\t"
-                       << QC->Objects[i]->name
-                       << "[";
-            for (unsigned j = 0; j != QC->Objects[i]->size; ++j) {
-              llvm::outs() << (unsigned) result->getValue(QC->Objects[i], j);
-              if (j + 1 != QC->Objects[i]->size)
-                llvm::outs() << ", ";
-            }
-            llvm::outs() << "]";
-            if (i + 1 != e)
-              llvm::outs() << "\n";
-          }
-        } else {
-          SolverImpl::SolverRunStatus retCode = S->impl->getOperationStatusCode();
-          if (SolverImpl::SOLVER_RUN_STATUS_TIMEOUT == retCode) {
-            llvm::outs() << " FAIL (reason: "
-                      << SolverImpl::getOperationStatusString(retCode)
-                      << ")";
-          }           
-          else {
-            llvm::outs() << "VALID (counterexample request ignored)";
-          }
-        }
-      }
-
-      llvm::outs() << "\n";
+      EvaluateQuery(S, QC->Constraints, QC->Query, QC->Values, QC->Objects);
       ++Index;
     }
   }
@@ -299,23 +449,558 @@ static bool EvaluateInputAST(const char *Filename,
 
   delete S;
 
-  if (uint64_t queries = *theStatisticManager->getStatisticByName("Queries")) {
-    llvm::outs()
-      << "--\n"
-      << "total queries = " << queries << "\n"
-      << "total queries constructs = " 
-      << *theStatisticManager->getStatisticByName("QueriesConstructs") << "\n"
-      << "valid queries = " 
-      << *theStatisticManager->getStatisticByName("QueriesValid") << "\n"
-      << "invalid queries = " 
-      << *theStatisticManager->getStatisticByName("QueriesInvalid") << "\n"
-      << "query cex = " 
-      << *theStatisticManager->getStatisticByName("QueriesCEX") << "\n";
+  PrintQueryStatistics();
+
+  return success;
+}
+
+namespace {
+/// A stream buffer reading from memory, so that a binary query log is
+/// read in place rather than copied.
+class MemoryStreamBuf : public std::streambuf {
+public:
+  explicit MemoryStreamBuf(const MemoryBuffer *MB) {
+    char *start = const_cast<char *>(MB->getBufferStart());
+    setg(start, start, start + MB->getBufferSize());
+  }
+};
+}
+
+/// Evaluate the queries of a binary query log as if they were the query
+/// commands of a .kquery file.
+static bool EvaluateBinaryLog(const char *Filename, const MemoryBuffer *MB) {
+  MemoryStreamBuf Buf(MB);
+  std::istream Is(&Buf);
+  ArrayCache Arrays;
+  BinaryQueryLogReader Reader(Is, Arrays);
+  if (!Reader.isValid()) {
+    llvm::errs() << Filename << ": not a binary query log.\n";
+    return false;
+  }
+
+  Solver *S = createSolver();
+  std::vector<ExprHandle> NoValues;
+  std::vector<const Array *> NoObjects;
+  LoggedQuery Q;
+  unsigned Index = 0;
+  for (; Reader.read(Q); ++Index) {
+    llvm::outs() << "Query " << Index << ":\t";
+    switch (Q.kind) {
+    case LoggedQuery::Truth:
+    case LoggedQuery::Validity:
+      EvaluateQuery(S, Q.constraints, Q.expr, NoValues, NoObjects);
+      break;
+    case LoggedQuery::Value:
+      EvaluateQuery(S, Q.constraints, ConstantExpr::alloc(0, Expr::Bool),
+                    std::vector<ExprHandle>(1, Q.expr), NoObjects);
+      break;
+    case LoggedQuery::InitialValues:
+      EvaluateQuery(S, Q.constraints, Q.expr, NoValues, Q.objects);
+      break;
+    }
+  }
+  delete S;
+
+  PrintQueryStatistics();
+  return true;
+}
+
+/// Ask \arg Q through the SolverImpl operation it was logged from.
+///
+/// \param [out] Result - On success, as LoggedQuery::result.
+static bool ReplayQuery(Solver *S, const LoggedQuery &Q, int &Result) {
+  // a named ConstraintManager, as the query keeps a reference to it
+  ConstraintManager Constraints(Q.constraints);
+  Query query(Constraints, Q.expr);
+  switch (Q.kind) {
+  case LoggedQuery::Truth: {
+    bool IsValid;
+    bool Success = S->impl->computeTruth(query, IsValid);
+    Result = IsValid;
+    return Success;
+  }
+  case LoggedQuery::Validity: {
+    Solver::Validity Validity;
+    bool Success = S->impl->computeValidity(query, Validity);
+    Result = Validity;
+    return Success;
+  }
+  case LoggedQuery::Value: {
+    ref<Expr> Value;
+    return S->impl->computeValue(query, Value);
+  }
+  case LoggedQuery::InitialValues: {
+    std::shared_ptr<const Assignment> Solution;
+    bool HasSolution;
+    bool Success = S->impl->computeInitialValues(query, Solution, HasSolution);
+    Result = HasSolution;
+    return Success;
+  }
+  }
+  return false;
+}
+
+/// Replay the queries of a binary query log through the same operations
+/// they were logged from, and compare the results and the time taken with
+/// the logged ones. Values and models may differ between solvers, so only
+/// their existence is compared.
+static bool ReplayBinaryLog(const char *Filename, const MemoryBuffer *MB) {
+  MemoryStreamBuf Buf(MB);
+  std::istream Is(&Buf);
+  ArrayCache Arrays;
+  BinaryQueryLogReader Reader(Is, Arrays);
+  if (!Reader.isValid()) {
+    llvm::errs() << Filename << ": not a binary query log.\n";
+    return false;
+  }
+
+  struct KindStats {
+    uint64_t queries = 0, failures = 0, mismatches = 0;
+    time::Span logged, replayed;
+  };
+  std::map<LoggedQuery::Kind, KindStats> Stats;
+
+  Solver *S = createSolver();
+  LoggedQuery Q;
+  unsigned Index = 0;
+  time::Point ReadStart = time::getWallTime();
+  time::Span ReadTime;
+  for (; Reader.read(Q); ++Index) {
+    time::Point Start = time::getWallTime();
+    ReadTime += Start - ReadStart;
+    int Result = 0;
+    bool Success = ReplayQuery(S, Q, Result);
+    ReadStart = time::getWallTime();
+
+    KindStats &KS = Stats[Q.kind];
+    ++KS.queries;
+    KS.logged += Q.elapsed;
+    KS.replayed += ReadStart - Start;
+    if (!Success) {
+      ++KS.failures;
+    } else if (Q.success && Q.kind != LoggedQuery::Value &&
+               Result != Q.result) {
+      ++KS.mismatches;
+      llvm::outs() << "Query " << Index << ": "
+                   << LoggedQuery::getKindName(Q.kind) << " result "
+                   << Result << " differs from the logged " << Q.result
+                   << "\n";
+    }
+  }
+  delete S;
+
+  bool Agree = true;
+  llvm::outs() << "kind\tqueries\tfailed\tdiffer\tlogged\treplayed\n";
+  for (const auto &Entry : Stats) {
+    const KindStats &KS = Entry.second;
+    llvm::outs() << LoggedQuery::getKindName(Entry.first) << "\t"
+                 << KS.queries << "\t" << KS.failures << "\t"
+                 << KS.mismatches << "\t" << KS.logged << "\t"
+                 << KS.replayed << "\n";
+    Agree = Agree && !KS.mismatches;
+  }
+  llvm::outs() << "--\n"
+               << "replayed queries = " << Index << "\n"
+               << "time reading the log = " << ReadTime << "\n";
+  return Agree;
+}
+
+/// The query asked by a query command, unanswered.
+static LoggedQuery ToLoggedQuery(const QueryCommand &QC) {
+  LoggedQuery Q;
+  Q.constraints = QC.Constraints;
+  if (!QC.Values.empty()) {
+    assert(QC.Values.size() == 1 &&
+           "FIXME: Support counterexamples for multiple values!");
+    Q.kind = LoggedQuery::Value;
+    Q.expr = QC.Values[0];
+  } else {
+    Q.kind = QC.Objects.empty() ? LoggedQuery::Truth
+                                : LoggedQuery::InitialValues;
+    Q.expr = QC.Query;
+    Q.objects = QC.Objects;
+  }
+  return Q;
+}
+
+/// Write the query commands of a .kquery file as a binary query log, as
+/// unanswered queries.
+static bool PrintInputAsBinary(const char *Filename, const MemoryBuffer *MB,
+                               ExprBuilder *Builder) {
+  std::vector<Decl*> Decls;
+  Parser *P = Parser::Create(Filename, MB, Builder, ClearArrayAfterQuery);
+  P->SetMaxErrors(20);
+  while (Decl *D = P->ParseTopLevelDecl()) {
+    Decls.push_back(D);
+  }
+
+  bool success = true;
+  if (unsigned N = P->GetNumErrors()) {
+    llvm::errs() << Filename << ": parse failure: " << N << " errors.\n";
+    success = false;
   }
 
+  if (success) {
+    BinaryQueryLogWriter Writer(llvm::outs());
+    for (Decl *D : Decls) {
+      QueryCommand *QC = dyn_cast<QueryCommand>(D);
+      if (!QC)
+        continue;
+      Writer.write(ToLoggedQuery(*QC));
+    }
+  }
+
+  for (Decl *D : Decls)
+    delete D;
+  delete P;
+
   return success;
 }
 
+namespace {
+/// The statistics whose increments are recorded for each timed query, to
+/// tell which part of the solver chain answered it.
+const char *const BenchmarkStatNames[] = {
+    "QueryCacheHits", "QueryCexCacheHits", "QueryFactorCacheHits",
+    "QueryPersistentCacheHits", "Queries"};
+const char *const BenchmarkStatColumns[] = {
+    "cache_hits", "cex_cache_hits", "factor_cache_hits",
+    "persistent_cache_hits", "core_queries"};
+const unsigned NumBenchmarkStats =
+    sizeof(BenchmarkStatNames) / sizeof(BenchmarkStatNames[0]);
+
+/// One timing of a query on a backend. Plain data, as the worker processes
+/// pass them back through a file.
+struct BenchmarkSample {
+  uint32_t Query;
+  uint32_t Backend;
+  uint32_t Repetition;
+  uint32_t Success;
+  int32_t Result;
+  uint64_t Microseconds;
+  uint64_t Stats[NumBenchmarkStats];
+};
+}
+
+static const char *getBackendName(CoreSolverType Backend) {
+  switch (Backend) {
+  case STP_SOLVER:
+    return "stp";
+  case METASMT_SOLVER:
+    return "metasmt";
+  case DUMMY_SOLVER:
+    return "dummy";
+  case Z3_SOLVER:
+    return "z3";
+  case SMTLIB_SOLVER:
+    return "smtlib";
+  case PORTFOLIO_SOLVER:
+    return "portfolio";
+  case REMOTE_SOLVER:
+    return "remote";
+  case NO_SOLVER:
+    break;
+  }
+  return "none";
+}
+
+/// Time the queries whose index is \arg Job modulo \arg Jobs on each of
+/// \arg Backends, with a solver chain per backend.
+static std::vector<BenchmarkSample>
+RunBenchmarkShare(const std::vector<LoggedQuery> &Queries,
+                  const std::vector<CoreSolverType> &Backends, unsigned Job,
+                  unsigned Jobs) {
+  std::vector<Solver *> Solvers;
+  for (CoreSolverType Backend : Backends)
+    Solvers.push_back(createSolver(Backend));
+  Statistic *Stats[NumBenchmarkStats];
+  for (unsigned k = 0; k != NumBenchmarkStats; ++k)
+    Stats[k] = theStatisticManager->getStatisticByName(BenchmarkStatNames[k]);
+
+  std::vector<BenchmarkSample> Samples;
+  for (size_t i = Job; i < Queries.size(); i += Jobs) {
+    for (unsigned b = 0; b != Solvers.size(); ++b) {
+      for (unsigned r = 0; r != BenchmarkWarmup + BenchmarkRepetitions; ++r) {
+        BenchmarkSample Sample = BenchmarkSample();
+        for (unsigned k = 0; k != NumBenchmarkStats; ++k)
+          Sample.Stats[k] = Stats[k] ? Stats[k]->getValue() : 0;
+
+        int Result = 0;
+        time::Point Start = time::getWallTime();
+        bool Success = ReplayQuery(Solvers[b], Queries[i], Result);
+        time::Span Elapsed = time::getWallTime() - Start;
+        if (r < BenchmarkWarmup)
+          continue;
+
+        Sample.Query = i;
+        Sample.Backend = b;
+        Sample.Repetition = r - BenchmarkWarmup;
+        Sample.Success = Success;
+        Sample.Result = Result;
+        Sample.Microseconds = Elapsed.toMicroseconds();
+        for (unsigned k = 0; k != NumBenchmarkStats; ++k)
+          Sample.Stats[k] =
+              (Stats[k] ? Stats[k]->getValue() : 0) - Sample.Stats[k];
+        Samples.push_back(Sample);
+      }
+    }
+  }
+
+  for (Solver *S : Solvers)
+    delete S;
+  return Samples;
+}
+
+/// Run the shares of the queries in \arg Jobs worker processes, and collect
+/// their samples.
+static bool RunBenchmarkJobs(const std::vector<LoggedQuery> &Queries,
+                             const std::vector<CoreSolverType> &Backends,
+                             unsigned Jobs,
+                             std::vector<BenchmarkSample> &Samples) {
+  struct Worker {
+    pid_t Pid;
+    SmallString<128> Path;
+  };
+  std::vector<Worker> Workers(Jobs);
+  llvm::outs().flush();
+  llvm::errs().flush();
+  bool Success = true;
+  for (unsigned j = 0; j != Jobs; ++j) {
+    int FD;
+    if (std::error_code EC = llvm::sys::fs::createTemporaryFile(
+            "kleaver-benchmark", "samples", FD, Workers[j].Path)) {
+      llvm::errs() << "error: cannot create a temporary file: "
+                   << EC.message() << "\n";
+      Workers.resize(j);
+      Success = false;
+      break;
+    }
+    pid_t Pid = fork();
+    if (Pid == 0) {
+      std::vector<BenchmarkSample> Share =
+          RunBenchmarkShare(Queries, Backends, j, Jobs);
+      const char *Data = reinterpret_cast<const char *>(Share.data());
+      size_t Size = Share.size() * sizeof(BenchmarkSample);
+      while (Size) {
+        ssize_t Written = ::write(FD, Data, Size);
+        if (Written < 0)
+          _exit(1);
+        Data += Written;
+        Size -= Written;
+      }
+      // skip the destructors of the state shared with the parent
+      _exit(0);
+    }
+    ::close(FD);
+    Workers[j].Pid = Pid;
+    if (Pid < 0) {
+      llvm::errs() << "error: cannot fork a benchmark worker\n";
+      llvm::sys::fs::remove(Workers[j].Path);
+      Workers.resize(j);
+      Success = false;
+      break;
+    }
+  }
+
+  for (Worker &W : Workers) {
+    int Status;
+    if (waitpid(W.Pid, &Status, 0) < 0 || !WIFEXITED(Status) ||
+        WEXITSTATUS(Status)) {
+      llvm::errs() << "error: benchmark worker " << W.Pid << " failed\n";
+      Success = false;
+    } else if (auto MB = MemoryBuffer::getFile(W.Path)) {
+      const BenchmarkSample *Begin =
+          reinterpret_cast<const BenchmarkSample *>((*MB)->getBufferStart());
+      Samples.insert(Samples.end(), Begin,
+                     Begin + (*MB)->getBufferSize() / sizeof(BenchmarkSample));
+    } else {
+      Success = false;
+    }
+    llvm::sys::fs::remove(W.Path);
+  }
+
+  std::sort(Samples.begin(), Samples.end(),
+            [](const BenchmarkSample &A, const BenchmarkSample &B) {
+              return std::make_tuple(A.Query, A.Backend, A.Repetition) <
+                     std::make_tuple(B.Query, B.Backend, B.Repetition);
+            });
+  return Success;
+}
+
+/// Time the solver chain on the queries of the input file, as many times as
+/// asked, on each backend of -benchmark-backends, and write one measurement
+/// per timing with a summary per backend.
+static bool BenchmarkInput(const char *Filename, const MemoryBuffer *MB,
+                           ExprBuilder *Builder, bool Binary) {
+  // The queries refer to the arrays (and the expressions) of the parser or
+  // of the cache, which therefore live as long as they do.
+  ArrayCache Arrays;
+  std::unique_ptr<Parser> P;
+  std::vector<Decl *> Decls;
+  std::vector<LoggedQuery> Queries;
+  if (Binary) {
+    MemoryStreamBuf Buf(MB);
+    std::istream Is(&Buf);
+    BinaryQueryLogReader Reader(Is, Arrays);
+    for (LoggedQuery Q; Reader.read(Q);)
+      Queries.push_back(Q);
+  } else {
+    P.reset(Parser::Create(Filename, MB, Builder, ClearArrayAfterQuery));
+    P->SetMaxErrors(20);
+    while (Decl *D = P->ParseTopLevelDecl()) {
+      Decls.push_back(D);
+      if (QueryCommand *QC = dyn_cast<QueryCommand>(D))
+        Queries.push_back(ToLoggedQuery(*QC));
+    }
+    if (unsigned N = P->GetNumErrors()) {
+      llvm::errs() << Filename << ": parse failure: " << N << " errors.\n";
+      for (Decl *D : Decls)
+        delete D;
+      return false;
+    }
+  }
+
+  std::vector<CoreSolverType> Backends(BenchmarkBackends.begin(),
+                                       BenchmarkBackends.end());
+  if (Backends.empty())
+    Backends.push_back(CoreSolverToUse);
+  unsigned Jobs = BenchmarkJobs;
+  if (!Jobs)
+    Jobs = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+  Jobs = std::max<size_t>(1, std::min<size_t>(Jobs, Queries.size()));
+
+  bool Success = true;
+  std::vector<BenchmarkSample> Samples;
+  if (Jobs > 1 && QueryLoggingOptions.getBits()) {
+    llvm::errs() << "error: -use-query-log cannot be used with more than one "
+                 << "-benchmark-jobs\n";
+    Success = false;
+  } else if (Jobs == 1) {
+    Samples = RunBenchmarkShare(Queries, Backends, 0, 1);
+  } else {
+    Success = RunBenchmarkJobs(Queries, Backends, Jobs, Samples);
+  }
+  for (Decl *D : Decls)
+    delete D;
+  if (!Success)
+    return false;
+
+  // Agreement is with the first timing of the query on the first backend.
+  // Values and models may differ between solvers, so only their existence
+  // is compared.
+  std::vector<const BenchmarkSample *> Reference(Queries.size());
+  for (const BenchmarkSample &S : Samples)
+    if (!Reference[S.Query] && S.Success)
+      Reference[S.Query] = &S;
+  auto Agrees = [&](const BenchmarkSample &S) {
+    const BenchmarkSample *R = Reference[S.Query];
+    return !R || !S.Success || Queries[S.Query].kind == LoggedQuery::Value ||
+           R->Result == S.Result;
+  };
+
+  struct BackendSummary {
+    uint64_t Samples = 0, Failures = 0, Disagreements = 0, Total = 0;
+    uint64_t Stats[NumBenchmarkStats] = {};
+    std::vector<uint64_t> Latencies;
+  };
+  std::vector<BackendSummary> Summaries(Backends.size());
+  for (const BenchmarkSample &S : Samples) {
+    BackendSummary &BS = Summaries[S.Backend];
+    ++BS.Samples;
+    BS.Failures += !S.Success;
+    BS.Disagreements += !Agrees(S);
+    BS.Total += S.Microseconds;
+    for (unsigned k = 0; k != NumBenchmarkStats; ++k)
+      BS.Stats[k] += S.Stats[k];
+    BS.Latencies.push_back(S.Microseconds);
+  }
+  for (BackendSummary &BS : Summaries)
+    std::sort(BS.Latencies.begin(), BS.Latencies.end());
+  auto Percentile = [](const BackendSummary &BS, unsigned Percent) {
+    if (BS.Latencies.empty())
+      return uint64_t(0);
+    return BS.Latencies[(BS.Latencies.size() - 1) * Percent / 100];
+  };
+
+  std::unique_ptr<llvm::raw_fd_ostream> File;
+  if (BenchmarkOutput != "-") {
+    std::string Error;
+    File = klee_open_output_file(BenchmarkOutput, Error);
+    if (!File) {
+      llvm::errs() << "error: cannot open " << BenchmarkOutput << ": " << Error
+                   << "\n";
+      return false;
+    }
+  }
+  llvm::raw_ostream &OS = File ? *File : llvm::outs();
+
+  if (BenchmarkFormat == BenchmarkCSV) {
+    OS << "query,kind,backend,repetition,success,result,agrees,latency_us";
+    for (const char *Column : BenchmarkStatColumns)
+      OS << "," << Column;
+    OS << "\n";
+    for (const BenchmarkSample &S : Samples) {
+      OS << S.Query << "," << LoggedQuery::getKindName(Queries[S.Query].kind)
+         << "," << getBackendName(Backends[S.Backend]) << "," << S.Repetition
+         << "," << S.Success << "," << S.Result << "," << Agrees(S) << ","
+         << S.Microseconds;
+      for (uint64_t Stat : S.Stats)
+        OS << "," << Stat;
+      OS << "\n";
+    }
+
+    llvm::errs() << "backend\tsamples\tfailed\tdiffer\ttotal_us\tmedian_us"
+                 << "\tp90_us";
+    for (const char *Column : BenchmarkStatColumns)
+      llvm::errs() << "\t" << Column;
+    llvm::errs() << "\n";
+    for (unsigned b = 0; b != Backends.size(); ++b) {
+      const BackendSummary &BS = Summaries[b];
+      llvm::errs() << getBackendName(Backends[b]) << "\t" << BS.Samples
+                   << "\t" << BS.Failures << "\t" << BS.Disagreements << "\t"
+                   << BS.Total << "\t" << Percentile(BS, 50) << "\t"
+                   << Percentile(BS, 90);
+      for (uint64_t Stat : BS.Stats)
+        llvm::errs() << "\t" << Stat;
+      llvm::errs() << "\n";
+    }
+  } else {
+    OS << "{\n  \"samples\": [";
+    for (size_t i = 0; i != Samples.size(); ++i) {
+      const BenchmarkSample &S = Samples[i];
+      OS << (i ? ",\n" : "\n") << "    {\"query\": " << S.Query
+         << ", \"kind\": \"" << LoggedQuery::getKindName(Queries[S.Query].kind)
+         << "\", \"backend\": \"" << getBackendName(Backends[S.Backend])
+         << "\", \"repetition\": " << S.Repetition << ", \"success\": "
+         << (S.Success ? "true" : "false") << ", \"result\": " << S.Result
+         << ", \"agrees\": " << (Agrees(S) ? "true" : "false")
+         << ", \"latency_us\": " << S.Microseconds;
+      for (unsigned k = 0; k != NumBenchmarkStats; ++k)
+        OS << ", \"" << BenchmarkStatColumns[k] << "\": " << S.Stats[k];
+      OS << "}";
+    }
+    OS << "\n  ],\n  \"summary\": [";
+    for (unsigned b = 0; b != Backends.size(); ++b) {
+      const BackendSummary &BS = Summaries[b];
+      OS << (b ? ",\n" : "\n") << "    {\"backend\": \""
+         << getBackendName(Backends[b]) << "\", \"samples\": " << BS.Samples
+         << ", \"failures\": " << BS.Failures << ", \"disagreements\": "
+         << BS.Disagreements << ", \"total_us\": " << BS.Total
+         << ", \"median_us\": " << Percentile(BS, 50)
+         << ", \"p90_us\": " << Percentile(BS, 90);
+      for (unsigned k = 0; k != NumBenchmarkStats; ++k)
+        OS << ", \"" << BenchmarkStatColumns[k] << "\": " << BS.Stats[k];
+      OS << "}";
+    }
+    OS << "\n  ]\n}\n";
+  }
+
+  for (const BackendSummary &BS : Summaries)
+    if (BS.Disagreements)
+      return false;
+  return true;
+}
+
 static bool printInputAsSMTLIBv2(const char *Filename,
                              const MemoryBuffer *MB,
                              ExprBuilder *Builder)
@@ -387,6 +1072,93 @@ static bool printInputAsSMTLIBv2(const char *Filename,
 	return true;
 }
 
+/// Answer the clients accepted on \arg ListenFd one after the other.
+static void ServeClients(int ListenFd) {
+  Solver *S = createSolver();
+  // one for all clients, as the caches of the chain outlive them
+  ArrayCache Arrays;
+  const time::Span MaxTime(MaxCoreSolverTime);
+  for (;;) {
+    int Fd = accept4(ListenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (Fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      llvm::errs() << "kleaver: accept: " << strerror(errno) << "\n";
+      break;
+    }
+    serveRemoteSolver(S, Arrays, Fd, MaxTime);
+  }
+  delete S;
+}
+
+/// Serve -solver-backend=remote clients on -serve-port with -serve-jobs
+/// worker processes. A query is only solved again by another worker, or
+/// after a restart, if the chain has a -persistent-query-cache, which the
+/// workers share.
+static bool ServeSolver() {
+  if (CoreSolverToUse == REMOTE_SOLVER) {
+    llvm::errs() << "kleaver: error: cannot serve with the remote backend\n";
+    return false;
+  }
+
+  int ListenFd = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int One = 1, Zero = 0;
+  struct sockaddr_in6 Addr = {};
+  Addr.sin6_family = AF_INET6;
+  Addr.sin6_addr = in6addr_any;
+  Addr.sin6_port = htons(ServePort);
+  if (ListenFd < 0 ||
+      setsockopt(ListenFd, SOL_SOCKET, SO_REUSEADDR, &One, sizeof(One)) ||
+      setsockopt(ListenFd, IPPROTO_IPV6, IPV6_V6ONLY, &Zero, sizeof(Zero)) ||
+      bind(ListenFd, reinterpret_cast<struct sockaddr *>(&Addr),
+           sizeof(Addr)) ||
+      listen(ListenFd, SOMAXCONN)) {
+    llvm::errs() << "kleaver: error: cannot listen on port " << ServePort
+                 << ": " << strerror(errno) << "\n";
+    return false;
+  }
+
+  unsigned Jobs = ServeJobs;
+  if (!Jobs)
+    Jobs = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+  auto StartWorker = [ListenFd]() {
+    pid_t Pid = fork();
+    if (Pid == 0) {
+      ServeClients(ListenFd);
+      _exit(1);
+    }
+    return Pid;
+  };
+  std::set<pid_t> Workers;
+  for (unsigned I = 0; I != Jobs; ++I) {
+    pid_t Pid = StartWorker();
+    if (Pid > 0)
+      Workers.insert(Pid);
+  }
+  llvm::errs() << "kleaver: serving on port " << ServePort << " with "
+               << Workers.size() << " workers\n";
+
+  // replace the workers killed by a signal, e.g. a solver crash
+  while (!Workers.empty()) {
+    int Status;
+    pid_t Pid = wait(&Status);
+    if (Pid < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (!Workers.erase(Pid) || !WIFSIGNALED(Status))
+      continue;
+    llvm::errs() << "kleaver: worker " << Pid << " killed by signal "
+                 << WTERMSIG(Status) << ", restarting it\n";
+    Pid = StartWorker();
+    if (Pid > 0)
+      Workers.insert(Pid);
+  }
+  close(ListenFd);
+  return false;
+}
+
 int main(int argc, char **argv) {
 
   KCommandLine::HideOptions(llvm::cl::GeneralCategory);
@@ -402,7 +1174,13 @@ int main(int argc, char **argv) {
   llvm::cl::ParseCommandLineOptions(argc, argv);
 
   std::string ErrorStr;
-  
+
+  if (ToolAction == Serve) {
+    success = ServeSolver();
+    llvm::llvm_shutdown();
+    return success ? 0 : 1;
+  }
+
   auto MBResult = MemoryBuffer::getFileOrSTDIN(InputFile.c_str());
   if (!MBResult) {
     llvm::errs() << argv[0] << ": error: " << MBResult.getError().message()
@@ -411,22 +1189,32 @@ int main(int argc, char **argv) {
   }
   std::unique_ptr<MemoryBuffer> &MB = *MBResult;
   
-  ExprBuilder *Builder = 0;
+  ExprBuilder *Builder = createDefaultExprBuilder();
+  if (HashConsExprs)
+    Builder = createHashConsingExprBuilder(Builder);
   switch (BuilderKind) {
   case DefaultBuilder:
-    Builder = createDefaultExprBuilder();
     break;
   case ConstantFoldingBuilder:
-    Builder = createDefaultExprBuilder();
     Builder = createConstantFoldingExprBuilder(Builder);
     break;
   case SimplifyingBuilder:
-    Builder = createDefaultExprBuilder();
     Builder = createConstantFoldingExprBuilder(Builder);
     Builder = createSimplifyingExprBuilder(Builder);
     break;
   }
 
+  const char *Filename = InputFile == "-" ? "<stdin>" : InputFile.c_str();
+  bool Binary = BinaryQueryLogReader::hasHeader(MB->getBufferStart(),
+                                                MB->getBufferSize());
+  if (Binary && ToolAction != Evaluate && ToolAction != ReplayBenchmark &&
+      ToolAction != Benchmark) {
+    llvm::errs() << argv[0] << ": error: " << Filename
+                 << " is a binary query log, which can only be evaluated, "
+                 << "replayed or benchmarked\n";
+    return 1;
+  }
+
   switch (ToolAction) {
   case PrintTokens:
     PrintInputTokens(MB.get());
@@ -436,8 +1224,25 @@ int main(int argc, char **argv) {
                             Builder);
     break;
   case Evaluate:
-    success = EvaluateInputAST(InputFile=="-" ? "<stdin>" : InputFile.c_str(),
-                               MB.get(), Builder);
+    if (Binary)
+      success = EvaluateBinaryLog(Filename, MB.get());
+    else
+      success = EvaluateInputAST(Filename, MB.get(), Builder);
+    break;
+  case ReplayBenchmark:
+    if (!Binary) {
+      llvm::errs() << argv[0] << ": error: " << Filename
+                   << " is not a binary query log\n";
+      success = false;
+      break;
+    }
+    success = ReplayBinaryLog(Filename, MB.get());
+    break;
+  case Benchmark:
+    success = BenchmarkInput(Filename, MB.get(), Builder, Binary);
+    break;
+  case PrintBinary:
+    success = PrintInputAsBinary(Filename, MB.get(), Builder);
     break;
   case PrintSMTLIBv2:
     success = printInputAsSMTLIBv2(InputFile=="-"? "<stdin>" : InputFile.c_str(), MB.get(),Builder);
@@ -12,6 +12,7 @@
 #include "klee/Internal/ADT/KTest.h"
 
 #include <assert.h>
+#include <dirent.h>
 #include <errno.h>
 #include <getopt.h>
 #include <stdint.h>
@@ -49,6 +50,7 @@ static struct option long_options[] = {
   {"chroot-to-dir", required_argument, 0, 'r'},
   {"help", no_argument, 0, 'h'},
   {"keep-replay-dir", no_argument, 0, 'k'},
+  {"jobs", required_argument, 0, 'j'},
   {0, 0, 0, 0},
 };
 
@@ -261,13 +263,16 @@ void ensure_capsyschroot(const char *executable) {
 
 static void usage(void) {
   fprintf(stderr,
-    "Usage: %s [option]... <executable> <ktest-file>...\n"
+    "Usage: %s [option]... <executable> <ktest-file or directory>...\n"
     "   or: %s --create-files-only <ktest-file>\n"
     "\n"
     "-r, --chroot-to-dir=DIR  use chroot jail, requires CAP_SYS_CHROOT\n"
     "-k, --keep-replay-dir    do not delete replay directory\n"
+    "-j, --jobs=N             replay N tests at a time and report a summary\n"
     "-h, --help               display this help and exit\n"
     "\n"
+    "The .ktest files of a directory are replayed in the order of their names.\n"
+    "\n"
     "Use KLEE_REPLAY_TIMEOUT environment variable to set a timeout (in seconds).\n",
     progname, progname);
   exit(1);
@@ -276,6 +281,216 @@ static void usage(void) {
 
 int keep_temps = 0;
 
+/* Append \a path to the NULL terminated list \a tests of \a count entries. */
+static char **add_test(char **tests, unsigned *count, char *path) {
+  tests = realloc(tests, (*count + 2) * sizeof(*tests));
+  if (!tests) {
+    perror("realloc");
+    exit(1);
+  }
+  tests[(*count)++] = path;
+  tests[*count] = NULL;
+  return tests;
+}
+
+static int compare_names(const void *a, const void *b) {
+  return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/* Return the NULL terminated list of the tests to replay: the files given,
+   with each directory replaced by the .ktest files in it. */
+static char **collect_tests(int argc, char **argv) {
+  char **tests = calloc(1, sizeof(*tests));
+  unsigned count = 0;
+  if (!tests) {
+    perror("calloc");
+    exit(1);
+  }
+
+  int i;
+  for (i = 0; i != argc; ++i) {
+    DIR *dir = opendir(argv[i]);
+    if (!dir) {
+      tests = add_test(tests, &count, argv[i]);
+      continue;
+    }
+
+    unsigned first = count;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+      size_t length = strlen(entry->d_name);
+      if (length < 6 || strcmp(entry->d_name + length - 6, ".ktest") != 0)
+        continue;
+      char *path = malloc(strlen(argv[i]) + length + 2);
+      if (!path) {
+        perror("malloc");
+        exit(1);
+      }
+      sprintf(path, "%s/%s", argv[i], entry->d_name);
+      tests = add_test(tests, &count, path);
+    }
+    closedir(dir);
+    qsort(tests + first, count - first, sizeof(*tests), compare_names);
+  }
+  return tests;
+}
+
+/* Replay \a input_fname and return the wait status of the process that ran
+   the executable, whose exit code tells how the executable ended, see
+   process_status. */
+static int replay_test(char *executable, char *argv0, char *input_fname,
+                       int first) {
+  int prg_argc;
+  char ** prg_argv;
+  unsigned i;
+
+  input = kTest_fromFile(input_fname);
+  if (!input) {
+    fprintf(stderr, "KLEE-REPLAY: ERROR: input file %s not valid.\n",
+            input_fname);
+    exit(1);
+  }
+
+  obj_index = 0;
+  prg_argc = input->numArgs;
+  prg_argv = input->args;
+  prg_argv[0] = argv0;
+  klee_init_env(&prg_argc, &prg_argv);
+  if (!first)
+    fputc('\n', stderr);
+  fprintf(stderr, "KLEE-REPLAY: NOTE: Test file: %s\n"
+                  "KLEE-REPLAY: NOTE: Arguments: ", input_fname);
+  for (i=0; i != (unsigned) prg_argc; ++i) {
+    char *s = prg_argv[i];
+    if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
+    fprintf(stderr, "\"%s\" ", prg_argv[i]);
+  }
+  fputc('\n', stderr);
+
+  /* Create the input files, pipes, etc. */
+  replay_create_files(&__exe_fs);
+
+  /* Run the test case machinery in a subprocess, eventually this parent
+     process should be a script or something which shells out to the actual
+     execution tool. */
+  int pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    _exit(66);
+  } else if (pid == 0) {
+    /* Run the executable */
+    run_monitored(executable, prg_argc, prg_argv);
+    _exit(0);
+  }
+
+  /* Wait for the executable to finish. */
+  int res, status;
+
+  do {
+    res = waitpid(pid, &status, 0);
+  } while (res < 0 && errno == EINTR);
+
+  // Delete all files in the replay directory
+  replay_delete_files();
+
+  if (res < 0) {
+    perror("waitpid");
+    _exit(66);
+  }
+  return status;
+}
+
+/* A test being replayed by a worker process of replay_in_parallel. */
+struct worker {
+  int pid;
+  char *test;
+  /* What the worker printed, shown once it is done so that the output of
+     different tests does not interleave. */
+  FILE *log;
+};
+
+/* Replay the \a tests with up to \a jobs worker processes forked from this
+   one, each of which replays a single test, and summarise the outcomes. */
+static void replay_in_parallel(char *executable, char *argv0, char **tests,
+                               unsigned jobs) {
+  struct worker *workers = calloc(jobs, sizeof(*workers));
+  if (!workers) {
+    perror("calloc");
+    exit(1);
+  }
+  unsigned running = 0, replayed = 0, normal = 0, abnormal = 0, crashed = 0,
+           failed = 0;
+  char **next = tests;
+
+  fflush(stderr);
+  while (*next || running) {
+    if (*next && running < jobs) {
+      struct worker *w = workers;
+      while (w->pid)
+        ++w;
+      w->test = *next++;
+      w->log = tmpfile();
+      if (!w->log) {
+        perror("tmpfile");
+        exit(1);
+      }
+      w->pid = fork();
+      if (w->pid < 0) {
+        perror("fork");
+        exit(1);
+      } else if (w->pid == 0) {
+        dup2(fileno(w->log), 2);
+        int status = replay_test(executable, argv0, w->test, 1);
+        _exit(WIFEXITED(status) ? WEXITSTATUS(status) : 66);
+      }
+      ++running;
+      continue;
+    }
+
+    int status;
+    int pid = wait(&status);
+    if (pid < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("wait");
+      exit(1);
+    }
+    struct worker *w = workers;
+    while (w != workers + jobs && w->pid != pid)
+      ++w;
+    if (w == workers + jobs)
+      continue;
+
+    if (replayed)
+      fputc('\n', stderr);
+    rewind(w->log);
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), w->log)))
+      fwrite(buffer, 1, n, stderr);
+    fclose(w->log);
+
+    int rc = WIFEXITED(status) ? WEXITSTATUS(status) : 66;
+    if (rc == 0)
+      ++normal;
+    else if (rc == 77)
+      ++crashed;
+    else if (rc == 66)
+      ++failed;
+    else
+      ++abnormal;
+    ++replayed;
+    w->pid = 0;
+    --running;
+  }
+  free(workers);
+
+  fprintf(stderr,
+          "\nKLEE-REPLAY: NOTE: Replayed %u tests: %u normal, %u abnormal, "
+          "%u crashed, %u failed to replay\n",
+          replayed, normal, abnormal, crashed, failed);
+}
+
 int main(int argc, char** argv) {
   int prg_argc;
   char ** prg_argv;
@@ -286,7 +501,8 @@ int main(int argc, char** argv) {
     usage();
 
   int c, opt_index;
-  while ((c = getopt_long(argc, argv, "f:r:k", long_options, &opt_index)) != -1) {
+  unsigned jobs = 1;
+  while ((c = getopt_long(argc, argv, "f:r:kj:", long_options, &opt_index)) != -1) {
     switch (c) {
     case 'f': {
       /* Special case hack for only creating files and not actually executing
@@ -318,6 +534,15 @@ int main(int argc, char** argv) {
     case 'k':
       keep_temps = 1;
       break;
+
+    case 'j':
+      jobs = atoi(optarg);
+      if (jobs == 0) {
+        fprintf(stderr, "KLEE-REPLAY: ERROR: invalid number of jobs (%s)\n",
+                optarg);
+        exit(1);
+      }
+      break;
     }
   }
 
@@ -344,64 +569,13 @@ int main(int argc, char** argv) {
     exit(1);
   }
 
-  int idx = 0;
-  for (idx = optind + 1; idx != argc; ++idx) {
-    char* input_fname = argv[idx];
-    unsigned i;
-
-    input = kTest_fromFile(input_fname);
-    if (!input) {
-      fprintf(stderr, "KLEE-REPLAY: ERROR: input file %s not valid.\n",
-              input_fname);
-      exit(1);
-    }
-
-    obj_index = 0;
-    prg_argc = input->numArgs;
-    prg_argv = input->args;
-    prg_argv[0] = argv[optind];
-    klee_init_env(&prg_argc, &prg_argv);
-    if (idx > 2)
-      fputc('\n', stderr);
-    fprintf(stderr, "KLEE-REPLAY: NOTE: Test file: %s\n"
-                    "KLEE-REPLAY: NOTE: Arguments: ", input_fname);
-    for (i=0; i != (unsigned) prg_argc; ++i) {
-      char *s = prg_argv[i];
-      if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
-      fprintf(stderr, "\"%s\" ", prg_argv[i]);
-    }
-    fputc('\n', stderr);
-
-    /* Create the input files, pipes, etc. */
-    replay_create_files(&__exe_fs);
-
-    /* Run the test case machinery in a subprocess, eventually this parent
-       process should be a script or something which shells out to the actual
-       execution tool. */
-    int pid = fork();
-    if (pid < 0) {
-      perror("fork");
-      _exit(66);
-    } else if (pid == 0) {
-      /* Run the executable */
-      run_monitored(executable, prg_argc, prg_argv);
-      _exit(0);
-    } else {
-      /* Wait for the executable to finish. */
-      int res, status;
-
-      do {
-        res = waitpid(pid, &status, 0);
-      } while (res < 0 && errno == EINTR);
-
-      // Delete all files in the replay directory
-      replay_delete_files();
-
-      if (res < 0) {
-        perror("waitpid");
-        _exit(66);
-      }
-    }
+  char **tests = collect_tests(argc - optind - 1, argv + optind + 1);
+  if (jobs > 1) {
+    replay_in_parallel(executable, argv[optind], tests, jobs);
+  } else {
+    char **test;
+    for (test = tests; *test; ++test)
+      replay_test(executable, argv[optind], *test, test == tests);
   }
 
   return 0;
@@ -10,10 +10,12 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/Config/Version.h"
+#include "klee/Config/config.h"
 #include "klee/ExecutionState.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Internal/ADT/KTest.h"
 #include "klee/Internal/ADT/TreeStream.h"
+#include "klee/Internal/Support/ArchiveWriter.h"
 #include "klee/Internal/Support/Debug.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/Internal/Support/FileHandling.h"
@@ -22,6 +24,7 @@
 #include "klee/Internal/System/Time.h"
 #include "klee/Interpreter.h"
 #include "klee/OptionCategories.h"
+#include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverCmdLine.h"
 #include "klee/Statistics.h"
 
@@ -51,6 +54,8 @@
 #endif
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
 #include <unistd.h>
 #include <sys/stat.h>
@@ -115,6 +120,40 @@ namespace {
 
 
 
+  cl::opt<unsigned>
+  TestWriterJobs("test-writer-jobs",
+                 cl::desc("Solve for the test inputs and write the .ktest, "
+                          ".xml, .graphml and .harness.c files in up to this "
+                          "many forked processes while the exploration "
+                          "continues, 0 to write them synchronously "
+                          "(default=0)"),
+                 cl::init(0),
+                 cl::cat(TestCaseCat));
+
+  cl::opt<bool>
+  TestArchive("test-archive",
+              cl::desc("Write the test files into tests.tar in the output "
+                       "directory, on a thread of its own, instead of a "
+                       "file each (default=false)"),
+              cl::cat(TestCaseCat));
+
+  cl::opt<bool>
+  DeterministicTestIds("deterministic-test-ids",
+                       cl::desc("Name the test files after a hash of the "
+                                "path of their state instead of the order "
+                                "the states terminated in, and make the "
+                                "random choices of a state depend on its path "
+                                "only (default=false)"),
+                       cl::cat(TestCaseCat));
+
+#ifdef HAVE_ZLIB_H
+  cl::opt<bool>
+  CompressTestArchive("compress-test-archive",
+                      cl::desc("Compress the test archive in gzip format, "
+                               "writing tests.tar.gz (default=false)"),
+                      cl::cat(TestCaseCat));
+#endif
+
   cl::opt<bool>
   WriteKQueries("write-kqueries",
                 cl::desc("Write .kquery files for each test case (default=false)"),
@@ -127,7 +166,8 @@ namespace {
 
   cl::opt<bool>
   WriteCov("write-cov",
-           cl::desc("Write coverage information for each test case (default=false)"),
+           cl::desc("Write the source lines each test case was the first to "
+                    "cover, klee-cov merges them (default=false)"),
            cl::cat(TestCaseCat));
 
   cl::opt<bool>
@@ -145,6 +185,13 @@ namespace {
                 cl::desc("Write .sym.path files for each test case (default=false)"),
                 cl::cat(TestCaseCat));
 
+  cl::opt<bool>
+  CompactPaths("compact-paths",
+               cl::desc("Write .path and .sym.path files with a bit per "
+                        "branch instead of a line, --replay-path reads "
+                        "both (default=false)"),
+               cl::cat(TestCaseCat));
+
 
   /*** Startup options ***/
 
@@ -157,6 +204,17 @@ namespace {
              cl::init("main"),
              cl::cat(StartCat));
 
+  cl::list<std::string>
+  BatchEntryPoints("batch-entry-points",
+                   cl::CommaSeparated,
+                   cl::desc("Explore each of these functions in turn instead "
+                            "of the entry point, preparing the module once. "
+                            "The test cases of each go to a subdirectory of "
+                            "the output directory named after it, and "
+                            "-max-time applies to each."),
+                   cl::value_desc("function,..."),
+                   cl::cat(StartCat));
+
   cl::opt<std::string>
   RunInDir("run-in-dir",
            cl::desc("Change to the given directory before starting execution (default=location of tested file)."),
@@ -260,7 +318,8 @@ namespace {
 
   cl::list<std::string>
   ReplayKTestFile("replay-ktest-file",
-                  cl::desc("Specify a ktest file to use for replay"),
+                  cl::desc("Specify a ktest file or ktest pack to use for "
+                           "replay"),
                   cl::value_desc("ktest file"),
                   cl::cat(ReplayCat));
 
@@ -271,13 +330,17 @@ namespace {
 
   cl::list<std::string>
   ReplayKTestDir("replay-ktest-dir",
-                 cl::desc("Specify a directory to replay ktest files from"),
+                 cl::desc("Specify a directory to replay ktest files and "
+                          "ktest packs from"),
                  cl::value_desc("output directory"),
                  cl::cat(ReplayCat));
 
   cl::opt<std::string>
   ReplayPathFile("replay-path",
-                 cl::desc("Specify a path file to replay"),
+                 cl::desc("Specify a path file to replay. Exploration "
+                          "continues normally after its last branch, so a "
+                          "path written for a state terminated by "
+                          "--max-depth explores the subtree below it"),
                  cl::value_desc("path file"),
                  cl::cat(ReplayCat));
 
@@ -285,12 +348,13 @@ namespace {
 
   cl::list<std::string>
   SeedOutFile("seed-file",
-              cl::desc(".ktest file to be used as seed"),
+              cl::desc(".ktest file or ktest pack to be used as seed"),
               cl::cat(SeedingCat));
 
   cl::list<std::string>
   SeedOutDir("seed-dir",
-             cl::desc("Directory with .ktest files to be used as seeds"),
+             cl::desc("Directory with .ktest files and ktest packs to be "
+                      "used as seeds"),
              cl::cat(SeedingCat));
 
   cl::opt<unsigned>
@@ -334,10 +398,39 @@ private:
 
   SmallString<128> m_outputDirectory;
 
+  /// The subdirectory of the current --batch-entry-points session
+  std::string m_sessionDirectory;
+
   unsigned m_numTotalTests;     // Number of tests received from the interpreter
   unsigned m_numGeneratedTests; // Number of tests successfully generated
   unsigned m_pathsExplored; // number of paths explored so far
 
+  /// A running test writer (see --test-writer-jobs)
+  struct TestWriter {
+    uint64_t id;
+    /// The pipe the test files come through with --test-archive, or -1
+    int pipe;
+    std::string members;
+  };
+  std::map<pid_t, TestWriter> m_testWriters;
+
+  /// The archive the test files go to with --test-archive
+  std::unique_ptr<ArchiveWriter> m_testArchive;
+  /// In a test writer, the archive members to pass on to the parent
+  std::string *m_testMembers;
+  /// The .ktest files written since the last takeWrittenKTests
+  std::vector<std::string> m_writtenKTests;
+
+  /// The files writeSolvedTestFiles failed to write, as its result and the
+  /// exit status of the test writers
+  enum TestFileFailure {
+    NoSolution = 1,
+    KTestFailed = 2,
+    TestCaseFailed = 4,
+    WitnessFailed = 8,
+    HarnessFailed = 16
+  };
+
   // used for writing .ktest files
   int m_argc;
   char **m_argv;
@@ -359,18 +452,47 @@ public:
 
   void setInterpreter(Interpreter *i);
 
+  /// Send the test files to the subdirectory \a name of the output
+  /// directory from now on, numbered from 1 again.
+  void beginSession(const std::string &name);
+
   void processTestCase(const ExecutionState  &state,
                        const char *errorMessage,
                        const char *errorSuffix);
 
+  /// Wait until the test writers have written their files
+  void waitForTestWriters();
+
+  void takeWrittenKTests(std::vector<std::string> &paths) {
+    reapTestWriters(false);
+    paths.insert(paths.end(), m_writtenKTests.begin(), m_writtenKTests.end());
+    m_writtenKTests.clear();
+  }
+
+private:
+  unsigned writeSolvedTestFiles(const ExecutionState &state, uint64_t id,
+                                const char *errorMessage);
+  void reportTestFiles(uint64_t id, unsigned failures);
+  void forkTestWriter(const ExecutionState &state, uint64_t id,
+                      const char *errorMessage);
+  void reapTestWriters(bool block);
+  bool readTestWriter(TestWriter &writer, bool block);
+
+public:
+
   std::string getOutputFilename(const std::string &filename);
   std::unique_ptr<llvm::raw_fd_ostream> openOutputFile(const std::string &filename);
-  std::string getTestFilename(const std::string &suffix, unsigned id);
-  std::unique_ptr<llvm::raw_fd_ostream> openTestFile(const std::string &suffix, unsigned id);
+  std::string getTestFilename(const std::string &suffix, uint64_t id);
+  std::unique_ptr<llvm::raw_ostream> openTestFile(const std::string &suffix, uint64_t id);
+  /// Add a test file to the test archive
+  void addTestFile(const std::string &filename, const std::string &contents);
 
   // load a .path file
   static void loadPathFile(std::string name,
                            std::vector<bool> &buffer);
+  // write a .path file, as a line or a bit per branch (see --compact-paths)
+  static void writePathFile(llvm::raw_ostream &os,
+                            const std::vector<bool> &branches);
 
   static void getKTestFilesInDir(std::string directoryPath,
                                  std::vector<std::string> &results);
@@ -381,7 +503,8 @@ public:
 KleeHandler::KleeHandler(int argc, char **argv)
     : m_interpreter(0), m_pathWriter(0), m_symPathWriter(0),
       m_outputDirectory(), m_numTotalTests(0), m_numGeneratedTests(0),
-      m_pathsExplored(0), m_argc(argc), m_argv(argv) {
+      m_pathsExplored(0), m_testMembers(nullptr), m_argc(argc),
+      m_argv(argv) {
 
   // create output directory (OutputDir or "klee-out-<i>")
   bool dir_given = OutputDir != "";
@@ -453,9 +576,24 @@ KleeHandler::KleeHandler(int argc, char **argv)
 
   // open info
   m_infoFile = openOutputFile("info");
+
+  if (TestArchive) {
+    bool compress = false;
+#ifdef HAVE_ZLIB_H
+    compress = CompressTestArchive;
+#endif
+    std::string error;
+    file_path = getOutputFilename(compress ? "tests.tar.gz" : "tests.tar");
+    m_testArchive = ArchiveWriter::create(file_path, compress, error);
+    if (!m_testArchive)
+      klee_error("cannot open file \"%s\": %s", file_path.c_str(),
+                 error.c_str());
+  }
 }
 
 KleeHandler::~KleeHandler() {
+  waitForTestWriters();
+  m_testArchive.reset();
   delete m_pathWriter;
   delete m_symPathWriter;
   fclose(klee_warning_file);
@@ -478,6 +616,15 @@ void KleeHandler::setInterpreter(Interpreter *i) {
   }
 }
 
+void KleeHandler::beginSession(const std::string &name) {
+  waitForTestWriters();
+  std::string directory = getOutputFilename(name);
+  if (mkdir(directory.c_str(), 0775) < 0 && errno != EEXIST)
+    klee_error("cannot create \"%s\": %s", directory.c_str(), strerror(errno));
+  m_sessionDirectory = name;
+  m_numTotalTests = 0;
+}
+
 std::string KleeHandler::getOutputFilename(const std::string &filename) {
   SmallString<128> path = m_outputDirectory;
   sys::path::append(path,filename);
@@ -499,17 +646,61 @@ KleeHandler::openOutputFile(const std::string &filename) {
   return f;
 }
 
-std::string KleeHandler::getTestFilename(const std::string &suffix, unsigned id) {
+std::string KleeHandler::getTestFilename(const std::string &suffix, uint64_t id) {
   std::stringstream filename;
-  filename << "test" << std::setfill('0') << std::setw(6) << id << '.' << suffix;
+  if (!m_sessionDirectory.empty())
+    filename << m_sessionDirectory << '/';
+  filename << "test" << std::setfill('0');
+  if (DeterministicTestIds)
+    filename << std::hex << std::setw(16);
+  else
+    filename << std::setw(6);
+  filename << id << '.' << suffix;
   return filename.str();
 }
 
-std::unique_ptr<llvm::raw_fd_ostream>
-KleeHandler::openTestFile(const std::string &suffix, unsigned id) {
+namespace {
+/// A test file on its way into the test archive, added when the stream is
+/// destroyed
+class TestArchiveStream : public llvm::raw_ostream {
+  KleeHandler &handler;
+  std::string filename;
+  std::string contents;
+
+  void write_impl(const char *ptr, size_t size) override {
+    contents.append(ptr, size);
+  }
+  uint64_t current_pos() const override { return contents.size(); }
+
+public:
+  TestArchiveStream(KleeHandler &handler, std::string filename)
+      : handler(handler), filename(std::move(filename)) {}
+  ~TestArchiveStream() override {
+    flush();
+    handler.addTestFile(filename, contents);
+  }
+};
+}
+
+std::unique_ptr<llvm::raw_ostream>
+KleeHandler::openTestFile(const std::string &suffix, uint64_t id) {
+  if (m_testArchive)
+    return std::unique_ptr<llvm::raw_ostream>(
+        new TestArchiveStream(*this, getTestFilename(suffix, id)));
   return openOutputFile(getTestFilename(suffix, id));
 }
 
+void KleeHandler::addTestFile(const std::string &filename,
+                              const std::string &contents) {
+  if (m_testMembers) {
+    ArchiveWriter::appendMember(*m_testMembers, filename, contents);
+    return;
+  }
+  std::string members;
+  ArchiveWriter::appendMember(members, filename, contents);
+  m_testArchive->add(std::move(members));
+}
+
 static std::string getDecl(const std::string& fun, unsigned bitwidth,
                            bool isSigned, llvm::Module *module) {
     auto F = module->getFunction(fun);
@@ -548,135 +739,117 @@ static std::string getDecl(const std::string& fun, unsigned bitwidth,
 }
 
 
-/* Outputs all files (.ktest, .kquery, .cov etc.) describing a test case */
-void KleeHandler::processTestCase(const ExecutionState &state,
-                                  const char *errorMessage,
-                                  const char *errorSuffix) {
-  if (!WriteNone) {
-    const auto start_time = time::getWallTime();
-    unsigned id = ++m_numTotalTests;
-
-    if (WriteKTests) {
-      std::vector< std::pair<std::string, std::vector<unsigned char> > > out;
-      bool success = m_interpreter->getSymbolicSolution(state, out);
-
-      if (!success)
-        klee_warning("unable to get symbolic solution, losing test case");
-
-      if (success) {
-        KTest b;
-        b.numArgs = m_argc;
-        b.args = m_argv;
-        b.symArgvs = 0;
-        b.symArgvLen = 0;
-        b.numObjects = out.size();
-        b.objects = new KTestObject[b.numObjects];
-        assert(b.objects);
-        for (unsigned i=0; i<b.numObjects; i++) {
-          KTestObject *o = &b.objects[i];
-          o->name = const_cast<char*>(out[i].first.c_str());
-          o->numBytes = out[i].second.size();
-          o->bytes = new unsigned char[o->numBytes];
-          assert(o->bytes);
-          std::copy(out[i].second.begin(), out[i].second.end(), o->bytes);
-        }
+/* Solves the state and writes the files that need its solution, returns the
+   TestFileFailure flags of the files it failed to write */
+unsigned KleeHandler::writeSolvedTestFiles(const ExecutionState &state,
+                                           uint64_t id,
+                                           const char *errorMessage) {
+  unsigned failures = 0;
+
+  // the .xml, .graphml and .harness.c files share the test vector
+  std::vector<NamedConcreteValue> testVector;
+  bool hasTestVector = false;
+  auto getTestVector = [&]() -> const std::vector<NamedConcreteValue> & {
+    if (!hasTestVector) {
+      testVector = m_interpreter->getTestVector(state);
+      hasTestVector = true;
+    }
+    return testVector;
+  };
+
+  if (WriteKTests) {
+    std::vector< std::pair<std::string, std::vector<unsigned char> > > out;
+    bool success = m_interpreter->getSymbolicSolution(state, out);
+
+    if (!success)
+      failures |= NoSolution;
+
+    if (success) {
+      KTest b;
+      b.numArgs = m_argc;
+      b.args = m_argv;
+      b.symArgvs = 0;
+      b.symArgvLen = 0;
+      b.numObjects = out.size();
+      b.objects = new KTestObject[b.numObjects];
+      assert(b.objects);
+      for (unsigned i=0; i<b.numObjects; i++) {
+        KTestObject *o = &b.objects[i];
+        o->name = const_cast<char*>(out[i].first.c_str());
+        o->numBytes = out[i].second.size();
+        o->bytes = new unsigned char[o->numBytes];
+        assert(o->bytes);
+        std::copy(out[i].second.begin(), out[i].second.end(), o->bytes);
+      }
 
-        if (!kTest_toFile(&b, getOutputFilename(getTestFilename("ktest", id)).c_str())) {
-          klee_warning("unable to write output test case, losing it");
+      if (m_testArchive) {
+        unsigned char *data;
+        size_t size;
+        if (kTest_toBuffer(&b, &data, &size)) {
+          addTestFile(getTestFilename("ktest", id),
+                      std::string(reinterpret_cast<char *>(data), size));
+          free(data);
         } else {
-          ++m_numGeneratedTests;
+          failures |= KTestFailed;
         }
-
-        for (unsigned i=0; i<b.numObjects; i++)
-          delete[] b.objects[i].bytes;
-        delete[] b.objects;
+      } else if (!kTest_toFile(&b, getOutputFilename(getTestFilename("ktest", id)).c_str())) {
+        failures |= KTestFailed;
       }
-    }
 
-    if (errorMessage) {
-      auto f = openTestFile(errorSuffix, id);
-      if (f)
-        *f << errorMessage;
+      for (unsigned i=0; i<b.numObjects; i++)
+        delete[] b.objects[i].bytes;
+      delete[] b.objects;
     }
+  }
 
-    if (WriteTestCases) {
-      if (auto f = openTestFile("xml", id)) {
-        // write the header
-        *f <<
-        "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
-        "<!DOCTYPE testcase PUBLIC "
-        "\"+//IDN sosy-lab.org//DTD test-format testcase 1.1//EN\" "
-        "\"https://sosy-lab.org/test-format/testcase-1.1.dtd\">\n\n";
-
-        if (errorMessage) {
-          *f << "<testcase coversError=\"true\">\n";
-        } else {
-          *f << "<testcase>\n";
-        }
-
-        auto testvec = m_interpreter->getTestVector(state);
-        for (auto& input : testvec) {
-          *f << "  <input>" << input.toString() << "</input>\n";
-        }
-
-        *f << "</testcase>\n";
+  if (WriteTestCases) {
+    if (auto f = openTestFile("xml", id)) {
+      // write the header
+      *f <<
+      "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
+      "<!DOCTYPE testcase PUBLIC "
+      "\"+//IDN sosy-lab.org//DTD test-format testcase 1.1//EN\" "
+      "\"https://sosy-lab.org/test-format/testcase-1.1.dtd\">\n\n";
+
+      if (errorMessage) {
+        *f << "<testcase coversError=\"true\">\n";
       } else {
-        klee_warning("unable to write test-case file, losing it");
+        *f << "<testcase>\n";
       }
-    }
 
-    if (WriteWitness) {
-      if (auto witness = openTestFile("graphml", id)) {
+      const auto &testvec = getTestVector();
+      for (auto& input : testvec) {
+        *f << "  <input>" << input.toString() << "</input>\n";
+      }
 
-        *witness << "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n" ;
-        *witness << "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\" "
-                             "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">\n"
-                    "<graph edgedefault=\"directed\">\n";
+      *f << "</testcase>\n";
+    } else {
+      failures |= TestCaseFailed;
+    }
+  }
 
-        //entry node
-        *witness <<
-            "<node id=\"0\">\n"
-            "  <data key=\"entry\">true</data>\n"
-            "</node>\n";
+  if (WriteWitness) {
+    if (auto witness = openTestFile("graphml", id)) {
 
-        auto testvec = m_interpreter->getTestVector(state);
-
-        int node = 0;
-        int cyclehead = 0; // id of cyclehead
-
-        //llvm::errs() << *state.lastLoopHead << "\n";
-        //llvm::errs() << *state.lastLoopCheck << "\n";
-        for (auto& input : testvec) {
-          if (state.lastLoopHead && state.lastLoopHeadId == (size_t)node) {
-            cyclehead = node + 1;
-            *witness <<
-              "<node id=\""<< node + 1 << "\">\n"
-              "  <data key=\"cyclehead\">true</data>\n"
-              "</node>\n";
-            *witness << "<edge source=\"" << node <<"\" target=\"" << node + 1 << "\">\n"
-                        "  <data key=\"enterLoopHead\">true</data>\n";
-            if (const auto& D = state.lastLoopHead->getDebugLoc()) {
-              *witness << "  <data key=\"startline\">"<< D.getLine() << "</data>\n";
-            }
-            *witness << "</edge>\n";
-            ++node;
-          }
+      *witness << "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n" ;
+      *witness << "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\" "
+                           "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">\n"
+                  "<graph edgedefault=\"directed\">\n";
 
-          *witness <<
-            "<node id=\""<< node + 1 << "\"/>\n";
-          *witness <<
-            "<edge source=\"" << node <<"\" target=\"" << node + 1 << "\">\n"
-            "  <data key=\"assumption\">\\result==" << input.toString() << "</data>\n"
-            "  <data key=\"assumption.resultfunction\">" << input.getName() << "</data>\n";
+      //entry node
+      *witness <<
+          "<node id=\"0\">\n"
+          "  <data key=\"entry\">true</data>\n"
+          "</node>\n";
 
-            if (input.line > 0) {
-              *witness << "  <data key=\"startline\">"<< input.line << "</data>\n";
-            }
-            *witness << "</edge>\n";
-          node++;
-        }
+      const auto &testvec = getTestVector();
+
+      int node = 0;
+      int cyclehead = 0; // id of cyclehead
 
-        // was the loop head after all values?
+      //llvm::errs() << *state.lastLoopHead << "\n";
+      //llvm::errs() << *state.lastLoopCheck << "\n";
+      for (auto& input : testvec) {
         if (state.lastLoopHead && state.lastLoopHeadId == (size_t)node) {
           cyclehead = node + 1;
           *witness <<
@@ -692,124 +865,310 @@ void KleeHandler::processTestCase(const ExecutionState &state,
           ++node;
         }
 
-        //error
-        if (state.lastLoopHead) {
-          // create cycle
-          *witness << "<edge source=\"" << node <<"\" target=\"" << cyclehead << "\">\n"
-                      "  <data key=\"enterLoopHead\">true</data>\n";
-          if (state.lastLoopCheck) {
-            if (const auto& D = state.lastLoopCheck->getDebugLoc()) {
-              *witness << "  <data key=\"startline\">"<< D.getLine() << "</data>\n";
-            }
-          }
-          *witness << "</edge>\n";
-        } else if (!state.lastLoopCheck && state.lastLoopFail) {
-          // FIXME: insert loop check (0) to avoid this special case
-            // just generate infinite loop
-          *witness <<
-            "<node id=\""<< node + 1 << "\">\n"
-            "  <data key=\"cyclehead\">true</data>\n"
-            "</node>\n";
-          *witness << "<edge source=\"" << node <<"\" target=\"" << node + 1 << "\">\n"
-                      "  <data key=\"enterLoopHead\">true</data>\n";
-          if (const auto& D = state.lastLoopFail->getDebugLoc()) {
-            *witness << "  <data key=\"startline\">"<< D.getLine() << "</data>\n";
+        *witness <<
+          "<node id=\""<< node + 1 << "\"/>\n";
+        *witness <<
+          "<edge source=\"" << node <<"\" target=\"" << node + 1 << "\">\n"
+          "  <data key=\"assumption\">\\result==" << input.toString() << "</data>\n"
+          "  <data key=\"assumption.resultfunction\">" << input.getName() << "</data>\n";
+
+          if (input.line > 0) {
+            *witness << "  <data key=\"startline\">"<< input.line << "</data>\n";
           }
           *witness << "</edge>\n";
-          *witness << "<edge source=\"" << node + 1 <<"\" target=\"" << node + 1 << "\">\n"
-                      "  <data key=\"enterLoopHead\">true</data>\n";
-          if (const auto& D = state.lastLoopFail->getDebugLoc()) {
+        node++;
+      }
+
+      // was the loop head after all values?
+      if (state.lastLoopHead && state.lastLoopHeadId == (size_t)node) {
+        cyclehead = node + 1;
+        *witness <<
+          "<node id=\""<< node + 1 << "\">\n"
+          "  <data key=\"cyclehead\">true</data>\n"
+          "</node>\n";
+        *witness << "<edge source=\"" << node <<"\" target=\"" << node + 1 << "\">\n"
+                    "  <data key=\"enterLoopHead\">true</data>\n";
+        if (const auto& D = state.lastLoopHead->getDebugLoc()) {
+          *witness << "  <data key=\"startline\">"<< D.getLine() << "</data>\n";
+        }
+        *witness << "</edge>\n";
+        ++node;
+      }
+
+      //error
+      if (state.lastLoopHead) {
+        // create cycle
+        *witness << "<edge source=\"" << node <<"\" target=\"" << cyclehead << "\">\n"
+                    "  <data key=\"enterLoopHead\">true</data>\n";
+        if (state.lastLoopCheck) {
+          if (const auto& D = state.lastLoopCheck->getDebugLoc()) {
             *witness << "  <data key=\"startline\">"<< D.getLine() << "</data>\n";
           }
-          *witness << "</edge>\n";
-        } else {
-          *witness << "<node id=\""<< node + 1 << "\">\n"
-                      "  <data key=\"violation\">true</data>\n"
-                      "</node>\n";
-          *witness << "<edge source=\"" << node <<"\" target=\"" << node + 1<< "\"/>\n";
         }
-
-        *witness << "</graph>\n"
-                    "</graphml>\n";
-
+        *witness << "</edge>\n";
+      } else if (!state.lastLoopCheck && state.lastLoopFail) {
+        // FIXME: insert loop check (0) to avoid this special case
+          // just generate infinite loop
+        *witness <<
+          "<node id=\""<< node + 1 << "\">\n"
+          "  <data key=\"cyclehead\">true</data>\n"
+          "</node>\n";
+        *witness << "<edge source=\"" << node <<"\" target=\"" << node + 1 << "\">\n"
+                    "  <data key=\"enterLoopHead\">true</data>\n";
+        if (const auto& D = state.lastLoopFail->getDebugLoc()) {
+          *witness << "  <data key=\"startline\">"<< D.getLine() << "</data>\n";
+        }
+        *witness << "</edge>\n";
+        *witness << "<edge source=\"" << node + 1 <<"\" target=\"" << node + 1 << "\">\n"
+                    "  <data key=\"enterLoopHead\">true</data>\n";
+        if (const auto& D = state.lastLoopFail->getDebugLoc()) {
+          *witness << "  <data key=\"startline\">"<< D.getLine() << "</data>\n";
+        }
+        *witness << "</edge>\n";
       } else {
-        klee_warning("unable to write witness file, losing it");
+        *witness << "<node id=\""<< node + 1 << "\">\n"
+                    "  <data key=\"violation\">true</data>\n"
+                    "</node>\n";
+        *witness << "<edge source=\"" << node <<"\" target=\"" << node + 1<< "\"/>\n";
       }
+
+      *witness << "</graph>\n"
+                  "</graphml>\n";
+
+    } else {
+      failures |= WitnessFailed;
     }
+  }
 
-    if (WriteHarness) {
-      if (auto harness = openTestFile("harness.c", id)) {
+  if (WriteHarness) {
+    if (auto harness = openTestFile("harness.c", id)) {
 
-        *harness << "#include <assert.h>\n" ;
-        *harness << "void abort(void) __attribute__((noreturn));\n" ;
-        *harness << "void exit(int) __attribute__((noreturn));\n" ;
-        *harness << "void __VERIFIER_error(void) { assert(0 && \"__VERIFIER_error called\"); }\n" ;
-        *harness << "void __VERIFIER_assume(int c) { assert(c && \"__VERIFIER_assume(0) called\"); }\n\n" ;
+      *harness << "#include <assert.h>\n" ;
+      *harness << "void abort(void) __attribute__((noreturn));\n" ;
+      *harness << "void exit(int) __attribute__((noreturn));\n" ;
+      *harness << "void __VERIFIER_error(void) { assert(0 && \"__VERIFIER_error called\"); }\n" ;
+      *harness << "void __VERIFIER_assume(int c) { assert(c && \"__VERIFIER_assume(0) called\"); }\n\n" ;
 
-        auto testvec = m_interpreter->getTestVector(state);
-        // group the values according to functions
-        std::map<std::string, std::vector<ConcreteValue>> functions;
+      const auto &testvec = getTestVector();
+      // group the values according to functions
+      std::map<std::string, std::vector<const ConcreteValue *>> functions;
 
-        for (auto& input : testvec) {
-            functions[input.getName()].push_back(input);
-        }
+      for (auto& input : testvec) {
+          functions[input.getName()].push_back(&input);
+      }
 
-        for (auto& func : functions) {
-            auto& val = *func.second.begin();
-            *harness << getDecl(func.first, val.getBitWidth(),
-                                    val.isSigned(), getModule()) << " {\n";
-
-            *harness << "\tstatic int pos = 0;\n";
-            *harness << "\tswitch(pos++) {\n";
-            int n = 0;
-            for (auto& val : func.second) {
-                *harness << "\t\tcase " << n++ << ": return "
-                                            << val.toString() << ";\n";
-            }
-            *harness << "\t\tdefault: return 0;\n";
-            *harness << "\t}\n";
-            *harness << "}\n\n";
-        }
+      for (auto& func : functions) {
+          auto& val = **func.second.begin();
+          *harness << getDecl(func.first, val.getBitWidth(),
+                                  val.isSigned(), getModule()) << " {\n";
+
+          *harness << "\tstatic int pos = 0;\n";
+          *harness << "\tswitch(pos++) {\n";
+          int n = 0;
+          for (auto *val : func.second) {
+              *harness << "\t\tcase " << n++ << ": return "
+                                          << val->toString() << ";\n";
+          }
+          *harness << "\t\tdefault: return 0;\n";
+          *harness << "\t}\n";
+          *harness << "}\n\n";
+      }
 
-        // define also the rest of the undefined functions,
-        // (they are irrelenat on this path, but we need them
-        // to successfully compile the harness)
-        auto M = getModule();
-        for (auto& F : *M) {
-            if (!F.isDeclaration())
-                continue;
-            const auto& name = F.getName().str();
-            if (functions.find(name) != functions.end())
-                continue;
-
-            // for now, define only the __VERIFIER_ functions,
-            // otherwise we need to filter out the standard C functions
-            // and klee functions, and so on...
-            if (name.compare(0, 17 , "__VERIFIER_nondet") != 0)
-                continue;
-
-            auto retTy = F.getReturnType();
-            auto size = retTy->isVoidTy() ?
-                0U : M->getDataLayout().getTypeAllocSizeInBits(retTy);
-            *harness << getDecl(name, size, false, M) << " {\n";
-            *harness << "\treturn 0;\n";
-            *harness << "}\n\n";
-        }
-      } else {
-        klee_warning("unable to write harness file, losing it");
+      // define also the rest of the undefined functions,
+      // (they are irrelenat on this path, but we need them
+      // to successfully compile the harness)
+      auto M = getModule();
+      for (auto& F : *M) {
+          if (!F.isDeclaration())
+              continue;
+          const auto& name = F.getName().str();
+          if (functions.find(name) != functions.end())
+              continue;
+
+          // for now, define only the __VERIFIER_ functions,
+          // otherwise we need to filter out the standard C functions
+          // and klee functions, and so on...
+          if (name.compare(0, 17 , "__VERIFIER_nondet") != 0)
+              continue;
+
+          auto retTy = F.getReturnType();
+          auto size = retTy->isVoidTy() ?
+              0U : M->getDataLayout().getTypeAllocSizeInBits(retTy);
+          *harness << getDecl(name, size, false, M) << " {\n";
+          *harness << "\treturn 0;\n";
+          *harness << "}\n\n";
       }
+    } else {
+      failures |= HarnessFailed;
+    }
+  }
+
+  return failures;
+}
+
+void KleeHandler::reportTestFiles(uint64_t id, unsigned failures) {
+  if (failures & NoSolution)
+    klee_warning("unable to get symbolic solution, losing test case");
+  if (failures & KTestFailed) {
+    klee_warning("unable to write output test case, losing it");
+  } else if (WriteKTests && !(failures & NoSolution)) {
+    ++m_numGeneratedTests;
+    if (!m_testArchive)
+      m_writtenKTests.push_back(
+          getOutputFilename(getTestFilename("ktest", id)));
+  }
+  if (failures & TestCaseFailed)
+    klee_warning("unable to write test-case file, losing it");
+  if (failures & WitnessFailed)
+    klee_warning("unable to write witness file, losing it");
+  if (failures & HarnessFailed)
+    klee_warning("unable to write harness file, losing it");
+}
+
+void KleeHandler::forkTestWriter(const ExecutionState &state, uint64_t id,
+                                 const char *errorMessage) {
+  while (m_testWriters.size() >= TestWriterJobs)
+    reapTestWriters(true);
+
+  // with --test-archive the files come back through a pipe
+  int fds[2] = {-1, -1};
+  if (m_testArchive && pipe2(fds, O_CLOEXEC) < 0) {
+    klee_warning_once(0, "unable to create a pipe for a test writer, "
+                         "writing the test files synchronously: %s",
+                      strerror(errno));
+    reportTestFiles(id, writeSolvedTestFiles(state, id, errorMessage));
+    return;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    klee_warning_once(0, "unable to fork a test writer, writing the test "
+                         "files synchronously: %s", strerror(errno));
+    if (fds[0] >= 0) {
+      close(fds[0]);
+      close(fds[1]);
+    }
+    reportTestFiles(id, writeSolvedTestFiles(state, id, errorMessage));
+    return;
+  }
+  if (pid == 0) {
+    // the child has its own copy of the state and the solver; it must not
+    // flush what the parent buffered for its own files
+    if (fds[0] < 0)
+      _exit(writeSolvedTestFiles(state, id, errorMessage));
+
+    close(fds[0]);
+    std::string members;
+    m_testMembers = &members;
+    unsigned failures = writeSolvedTestFiles(state, id, errorMessage);
+    const char *data = members.data();
+    size_t left = members.size();
+    while (left) {
+      ssize_t n = write(fds[1], data, left);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        break;
+      data += n;
+      left -= n;
+    }
+    _exit(failures);
+  }
+  if (fds[1] >= 0)
+    close(fds[1]);
+  m_testWriters[pid] = TestWriter{id, fds[0], std::string()};
+}
+
+/* Reads what a test writer sent through its pipe, returns whether it
+   closed the pipe */
+bool KleeHandler::readTestWriter(TestWriter &writer, bool block) {
+  char buffer[64 * 1024];
+  while (writer.pipe >= 0) {
+    if (!block) {
+      pollfd p = {writer.pipe, POLLIN, 0};
+      if (poll(&p, 1, 0) == 0)
+        return false;
+    }
+    ssize_t n = read(writer.pipe, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n > 0) {
+      writer.members.append(buffer, n);
+      continue;
+    }
+    close(writer.pipe);
+    writer.pipe = -1;
+  }
+  return true;
+}
+
+void KleeHandler::reapTestWriters(bool block) {
+  // only the own children are waited for, the forked solvers wait for theirs
+  for (auto it = m_testWriters.begin(); it != m_testWriters.end();) {
+    // a writer blocked on a full pipe only exits once it is read
+    if (!readTestWriter(it->second, block)) {
+      ++it;
+      continue;
+    }
+    int status;
+    pid_t pid;
+    do {
+      pid = waitpid(it->first, &status, block ? 0 : WNOHANG);
+    } while (pid < 0 && errno == EINTR);
+    if (pid == 0) {
+      ++it;
+      continue;
+    }
+    if (pid > 0 && WIFEXITED(status)) {
+      if (!it->second.members.empty())
+        m_testArchive->add(std::move(it->second.members));
+      reportTestFiles(it->second.id, WEXITSTATUS(status));
+    } else {
+      klee_warning("test writer of %s died, losing its test files",
+                   getTestFilename("ktest", it->second.id).c_str());
+    }
+    it = m_testWriters.erase(it);
+    if (block)
+      return;
+  }
+}
+
+void KleeHandler::waitForTestWriters() {
+  while (!m_testWriters.empty())
+    reapTestWriters(true);
+}
+
+/* Outputs all files (.ktest, .kquery, .cov etc.) describing a test case */
+void KleeHandler::processTestCase(const ExecutionState &state,
+                                  const char *errorMessage,
+                                  const char *errorSuffix) {
+  if (!WriteNone) {
+    const auto start_time = time::getWallTime();
+    // the path of the state names its tests the same in every run
+    uint64_t id = ++m_numTotalTests;
+    if (DeterministicTestIds)
+      id = m_interpreter->getPathId(state);
+    reapTestWriters(false);
+
+    if (WriteKTests || WriteTestCases || WriteWitness || WriteHarness) {
+      if (TestWriterJobs)
+        forkTestWriter(state, id, errorMessage);
+      else
+        reportTestFiles(id, writeSolvedTestFiles(state, id, errorMessage));
+    }
+
+    if (errorMessage) {
+      auto f = openTestFile(errorSuffix, id);
+      if (f)
+        *f << errorMessage;
     }
 
     if (m_pathWriter) {
-      std::vector<unsigned char> concreteBranches;
+      std::vector<bool> concreteBranches;
       m_pathWriter->readStream(m_interpreter->getPathStreamID(state),
                                concreteBranches);
-      auto f = openTestFile("path", id);
-      if (f) {
-        for (const auto &branch : concreteBranches) {
-          *f << branch << '\n';
-        }
-      }
+      if (auto f = openTestFile("path", id))
+        writePathFile(*f, concreteBranches);
     }
 
     if (errorMessage || WriteKQueries) {
@@ -839,15 +1198,11 @@ void KleeHandler::processTestCase(const ExecutionState &state,
     }
 
     if (m_symPathWriter) {
-      std::vector<unsigned char> symbolicBranches;
+      std::vector<bool> symbolicBranches;
       m_symPathWriter->readStream(m_interpreter->getSymbolicPathStreamID(state),
                                   symbolicBranches);
-      auto f = openTestFile("sym.path", id);
-      if (f) {
-        for (const auto &branch : symbolicBranches) {
-          *f << branch << '\n';
-        }
-      }
+      if (auto f = openTestFile("sym.path", id))
+        writePathFile(*f, symbolicBranches);
     }
 
     if (WriteCov) {
@@ -869,8 +1224,11 @@ void KleeHandler::processTestCase(const ExecutionState &state,
     if (WriteTestInfo) {
       time::Span elapsed_time(time::getWallTime() - start_time);
       auto f = openTestFile("info", id);
-      if (f)
+      if (f) {
         *f << "Time to generate test case: " << elapsed_time << '\n';
+        for (const auto &note : state.exprDepthConcretizations)
+          *f << note << '\n';
+      }
     }
   } // if (!WriteNone)
 
@@ -880,6 +1238,30 @@ void KleeHandler::processTestCase(const ExecutionState &state,
   }
 }
 
+// compact .path files start with this, followed by the number of branches
+// as 8 bytes, least significant first, and the branches as bits
+static const char CompactPathMagic[8] = {'K', 'L', 'E', 'E', 'P', 'A', 'T', 'H'};
+
+void KleeHandler::writePathFile(llvm::raw_ostream &os,
+                                const std::vector<bool> &branches) {
+  if (!CompactPaths) {
+    for (bool branch : branches)
+      os << (branch ? "1\n" : "0\n");
+    return;
+  }
+
+  os.write(CompactPathMagic, sizeof(CompactPathMagic));
+  uint64_t count = branches.size();
+  for (unsigned i = 0; i < 8; ++i)
+    os << static_cast<char>(count >> (8 * i));
+  for (size_t i = 0; i < branches.size(); i += 8) {
+    unsigned char byte = 0;
+    for (size_t j = i; j < i + 8 && j < branches.size(); ++j)
+      byte |= branches[j] << (j - i);
+    os << static_cast<char>(byte);
+  }
+}
+
   // load a .path file
 void KleeHandler::loadPathFile(std::string name,
                                      std::vector<bool> &buffer) {
@@ -888,6 +1270,22 @@ void KleeHandler::loadPathFile(std::string name,
   if (!f.good())
     assert(0 && "unable to open path file");
 
+  char magic[sizeof(CompactPathMagic)];
+  if (f.read(magic, sizeof(magic)) &&
+      std::equal(magic, magic + sizeof(magic), CompactPathMagic)) {
+    uint64_t count = 0;
+    for (unsigned i = 0; i < 8; ++i)
+      count |= uint64_t(static_cast<unsigned char>(f.get())) << (8 * i);
+    for (uint64_t i = 0; i < count && f.good(); i += 8) {
+      int byte = f.get();
+      for (uint64_t j = i; j < i + 8 && j < count; ++j)
+        buffer.push_back(byte & (1 << (j - i)));
+    }
+    return;
+  }
+  f.clear();
+  f.seekg(0);
+
   while (f.good()) {
     unsigned value;
     f >> value;
@@ -902,7 +1300,8 @@ void KleeHandler::getKTestFilesInDir(std::string directoryPath,
   llvm::sys::fs::directory_iterator i(directoryPath, ec), e;
   for (; i != e && !ec; i.increment(ec)) {
     auto f = i->path();
-    if (f.size() >= 6 && f.substr(f.size()-6,f.size()) == ".ktest") {
+    if ((f.size() >= 6 && f.substr(f.size()-6,f.size()) == ".ktest") ||
+        (f.size() >= 10 && f.substr(f.size()-10,f.size()) == ".ktestpack")) {
       results.push_back(f);
     }
   }
@@ -1050,6 +1449,7 @@ static const char *modelledExternals[] = {
   "klee_is_symbolic",
   "klee_make_symbolic",
   "klee_mark_global",
+  "klee_memcpy",
   "klee_open_merge",
   "klee_close_merge",
   "klee_prefer_cex",
@@ -1438,6 +1838,30 @@ linkWithUclibc(StringRef libDir,
 }
 #endif
 
+// Map the tests of a .ktest file or a ktest pack, appending them to tests
+// and their names to names if given. The tests point into the mapping,
+// which is appended to maps and must outlive them.
+static bool mapKTests(const std::string &path, std::vector<KTestMap *> &maps,
+                      std::vector<KTest *> &tests,
+                      std::vector<const char *> *names) {
+  KTestMap *map = kTest_openMap(path.c_str());
+  if (!map)
+    return false;
+  maps.push_back(map);
+  for (unsigned i = 0, e = kTest_mapNumTests(map); i != e; ++i) {
+    KTest *test = kTest_mapGet(map, i);
+    if (!test) {
+      klee_warning("malformed test %s in %s", kTest_mapName(map, i),
+                   path.c_str());
+      continue;
+    }
+    tests.push_back(test);
+    if (names)
+      names->push_back(kTest_mapName(map, i));
+  }
+  return true;
+}
+
 int main(int argc, char **argv, char **envp) {
   atexit(llvm_shutdown);  // Call llvm_shutdown() on exit.
 
@@ -1549,6 +1973,7 @@ int main(int argc, char **argv, char **envp) {
                                   /*Optimize=*/OptimizeModule,
                                   /*CheckDivZero=*/CheckDivZero,
                                   /*CheckOvershift=*/CheckOvershift);
+  Opts.ExtraEntryPoints = BatchEntryPoints;
 
   if (WithPOSIXRuntime) {
     SmallString<128> Path(Opts.LibraryDir);
@@ -1656,6 +2081,7 @@ int main(int argc, char **argv, char **envp) {
 
   Interpreter::InterpreterOptions IOpts;
   IOpts.MakeConcreteSymbolic = MakeConcreteSymbolic;
+  IOpts.DeterministicPaths = DeterministicTestIds;
   KleeHandler *handler = new KleeHandler(pArgc, pArgv);
   Interpreter *interpreter =
     theInterpreter = Interpreter::create(ctx, IOpts, handler);
@@ -1678,6 +2104,14 @@ int main(int argc, char **argv, char **envp) {
 
   handler->setModule(finalModule);
 
+  std::vector<Function *> batchFns;
+  for (const auto &name : BatchEntryPoints) {
+    Function *f = finalModule->getFunction(name);
+    if (!f)
+      klee_error("Entry function '%s' not found in module.", name.c_str());
+    batchFns.push_back(f);
+  }
+
   externalsAndGlobalsCheck(finalModule);
 
   if (ReplayPathFile != "") {
@@ -1711,16 +2145,14 @@ int main(int argc, char **argv, char **envp) {
            it = ReplayKTestDir.begin(), ie = ReplayKTestDir.end();
          it != ie; ++it)
       KleeHandler::getKTestFilesInDir(*it, kTestFiles);
+    std::vector<KTestMap *> maps;
     std::vector<KTest*> kTests;
+    std::vector<const char *> kTestNames;
     for (std::vector<std::string>::iterator
            it = kTestFiles.begin(), ie = kTestFiles.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (out) {
-        kTests.push_back(out);
-      } else {
+      if (!mapKTests(*it, maps, kTests, &kTestNames))
         klee_warning("unable to open: %s\n", (*it).c_str());
-      }
     }
 
     if (RunInDir != "") {
@@ -1731,34 +2163,28 @@ int main(int argc, char **argv, char **envp) {
       }
     }
 
-    unsigned i=0;
-    for (std::vector<KTest*>::iterator
-           it = kTests.begin(), ie = kTests.end();
-         it != ie; ++it) {
-      KTest *out = *it;
+    for (unsigned i = 0; i < kTests.size(); ++i) {
+      KTest *out = kTests[i];
       interpreter->setReplayKTest(out);
-      llvm::errs() << "KLEE: replaying: " << *it << " (" << kTest_numBytes(out)
-                   << " bytes)"
-                   << " (" << ++i << "/" << kTestFiles.size() << ")\n";
+      llvm::errs() << "KLEE: replaying: " << kTestNames[i] << " ("
+                   << kTest_numBytes(out) << " bytes)"
+                   << " (" << i + 1 << "/" << kTests.size() << ")\n";
       // XXX should put envp in .ktest ?
       interpreter->runFunctionAsMain(mainFn, out->numArgs, out->args, pEnvp);
       if (interrupted) break;
     }
     interpreter->setReplayKTest(0);
-    while (!kTests.empty()) {
-      kTest_free(kTests.back());
-      kTests.pop_back();
-    }
+    for (KTestMap *map : maps)
+      kTest_closeMap(map);
   } else {
+    std::vector<KTestMap *> maps;
     std::vector<KTest *> seeds;
     for (std::vector<std::string>::iterator
            it = SeedOutFile.begin(), ie = SeedOutFile.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (!out) {
+      if (!mapKTests(*it, maps, seeds, nullptr)) {
         klee_error("unable to open: %s\n", (*it).c_str());
       }
-      seeds.push_back(out);
     }
     for (std::vector<std::string>::iterator
            it = SeedOutDir.begin(), ie = SeedOutDir.end();
@@ -1768,11 +2194,9 @@ int main(int argc, char **argv, char **envp) {
       for (std::vector<std::string>::iterator
              it2 = kTestFiles.begin(), ie = kTestFiles.end();
            it2 != ie; ++it2) {
-        KTest *out = kTest_fromFile(it2->c_str());
-        if (!out) {
+        if (!mapKTests(*it2, maps, seeds, nullptr)) {
           klee_error("unable to open: %s\n", (*it2).c_str());
         }
-        seeds.push_back(out);
       }
       if (kTestFiles.empty()) {
         klee_error("seeds directory is empty: %s\n", (*it).c_str());
@@ -1790,14 +2214,36 @@ int main(int argc, char **argv, char **envp) {
                    sys::StrError(errno).c_str());
       }
     }
-    interpreter->runFunctionAsMain(mainFn, pArgc, pArgv, pEnvp);
-
-    while (!seeds.empty()) {
-      kTest_free(seeds.back());
-      seeds.pop_back();
+    if (batchFns.empty()) {
+      interpreter->runFunctionAsMain(mainFn, pArgc, pArgv, pEnvp);
+    } else {
+      // the sessions share the prepared module, the globals snapshot and
+      // the solver caches, only the states are their own
+      for (Function *f : batchFns) {
+        const std::string name = f->getName().str();
+        unsigned paths = handler->getNumPathsExplored();
+        unsigned tests = handler->getNumTestCases();
+        klee_message("exploring entry point '%s'", name.c_str());
+        handler->beginSession(name);
+        interpreter->setHaltExecution(false);
+        interpreter->runFunctionAsMain(f, pArgc, pArgv, pEnvp);
+        handler->waitForTestWriters();
+        handler->getInfoStream()
+            << "KLEE: session " << name << ": completed paths = "
+            << handler->getNumPathsExplored() - paths
+            << ", generated tests = " << handler->getNumTestCases() - tests
+            << "\n";
+        if (interrupted)
+          break;
+      }
     }
+
+    for (KTestMap *map : maps)
+      kTest_closeMap(map);
   }
 
+  handler->waitForTestWriters();
+
   auto endTime = std::time(nullptr);
   { // output end and elapsed time
     std::uint32_t h;
@@ -1838,6 +2284,14 @@ int main(int argc, char **argv, char **envp) {
     *theStatisticManager->getStatisticByName("Instructions");
   uint64_t forks =
     *theStatisticManager->getStatisticByName("Forks");
+  uint64_t mergedStates =
+    *theStatisticManager->getStatisticByName("MergedStates");
+  uint64_t mergedSolverTime =
+    *theStatisticManager->getStatisticByName("MergedSolverTime");
+  uint64_t incrementalReuses =
+    *theStatisticManager->getStatisticByName("QueryIncrementalReuses");
+  uint64_t incrementalAsserts =
+    *theStatisticManager->getStatisticByName("QueryIncrementalAsserts");
 
   handler->getInfoStream()
     << "KLEE: done: explored paths = " << 1 + forks << "\n";
@@ -1853,6 +2307,18 @@ int main(int argc, char **argv, char **envp) {
     << "KLEE: done: valid queries = " << queriesValid << "\n"
     << "KLEE: done: invalid queries = " << queriesInvalid << "\n"
     << "KLEE: done: query cex = " << queryCounterexamples << "\n";
+  if (mergedStates)
+    handler->getInfoStream()
+      << "KLEE: done: merged states = " << mergedStates << "\n"
+      << "KLEE: done: solver time of merged states = "
+      << mergedSolverTime / 1e6 << "s\n";
+  if (incrementalReuses + incrementalAsserts)
+    handler->getInfoStream()
+      << "KLEE: done: reused incremental constraints = "
+      << 100. * incrementalReuses / (incrementalReuses + incrementalAsserts)
+      << "%\n";
+  if (ProfileSolverChain)
+    printSolverChainProfile(handler->getInfoStream());
 
   std::stringstream stats;
   stats << "\n";
@@ -0,0 +1,137 @@
+//===-- ktest-pack.cpp ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "klee/Internal/ADT/KTest.h"
+
+void print_usage_and_exit(char *program_name) {
+  fprintf(stderr,
+    "%s: Tool for packing many ktest files into one ktest pack, which klee reads with --seed-file, --seed-dir and the --replay-ktest options.\n"
+    "Usage: %s [-o <filename>] <inputs>\n"
+    "       -o <filename>   - Specifying the output file name for the pack (default: tests.ktestpack).\n"
+    "       <inputs>        - ktest files, ktest packs and directories to take the .ktest files of.\n"
+    "   Ex: %s -o seeds.ktestpack klee-out-0 klee-out-1/test000001.ktest\n"
+    "       %s -l <pack>    - Listing the tests in a pack.\n",
+    program_name, program_name, program_name, program_name);
+  exit(1);
+}
+
+static int ends_with(const std::string &s, const char *suffix) {
+  size_t n = strlen(suffix);
+  return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+static void add_dir(const std::string &path, std::vector<std::string> &files) {
+  DIR *dir = opendir(path.c_str());
+  struct dirent *entry;
+  std::vector<std::string> found;
+
+  if (!dir) {
+    fprintf(stderr, "unable to open directory: %s\n", path.c_str());
+    exit(1);
+  }
+  while ((entry = readdir(dir))) {
+    std::string name = entry->d_name;
+    if (ends_with(name, ".ktest"))
+      found.push_back(path + "/" + name);
+  }
+  closedir(dir);
+
+  // keep the order klee wrote them in
+  std::sort(found.begin(), found.end());
+  files.insert(files.end(), found.begin(), found.end());
+}
+
+int main(int argc, char *argv[]) {
+  const char *pack_file = "tests.ktestpack";
+  std::vector<std::string> files;
+  std::vector<KTestMap *> maps;
+  std::vector<KTest *> tests;
+  std::vector<const char *> names;
+  int i;
+
+  if (argc < 2)
+    print_usage_and_exit(argv[0]);
+
+  if (strcmp(argv[1], "-l") == 0) {
+    KTestMap *map;
+    unsigned j;
+
+    if (argc != 3)
+      print_usage_and_exit(argv[0]);
+    map = kTest_openMap(argv[2]);
+    if (!map) {
+      fprintf(stderr, "unable to open: %s\n", argv[2]);
+      return 1;
+    }
+    for (j = 0; j < kTest_mapNumTests(map); j++) {
+      KTest *test = kTest_mapGet(map, j);
+      if (test)
+        printf("%s: %u objects, %u bytes\n", kTest_mapName(map, j),
+               test->numObjects, kTest_numBytes(test));
+      else
+        printf("%s: malformed\n", kTest_mapName(map, j));
+    }
+    kTest_closeMap(map);
+    return 0;
+  }
+
+  for (i = 1; i < argc; i++) {
+    struct stat st;
+    if (strcmp(argv[i], "-o") == 0) {
+      if (++i == argc)
+        print_usage_and_exit(argv[0]);
+      pack_file = argv[i];
+    } else if (stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+      add_dir(argv[i], files);
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+
+  for (std::vector<std::string>::iterator it = files.begin(),
+         ie = files.end(); it != ie; ++it) {
+    KTestMap *map = kTest_openMap(it->c_str());
+    unsigned j;
+
+    if (!map) {
+      fprintf(stderr, "unable to open: %s\n", it->c_str());
+      return 1;
+    }
+    maps.push_back(map);
+    for (j = 0; j < kTest_mapNumTests(map); j++) {
+      KTest *test = kTest_mapGet(map, j);
+      if (!test) {
+        fprintf(stderr, "malformed test %s in %s\n", kTest_mapName(map, j),
+                it->c_str());
+        return 1;
+      }
+      tests.push_back(test);
+      names.push_back(kTest_mapName(map, j));
+    }
+  }
+
+  if (!kTest_packToFile(tests.data(), names.data(), tests.size(), pack_file)) {
+    fprintf(stderr, "unable to write: %s\n", pack_file);
+    return 1;
+  }
+  for (std::vector<KTestMap *>::iterator it = maps.begin(), ie = maps.end();
+       it != ie; ++it)
+    kTest_closeMap(*it);
+
+  return 0;
+}
@@ -3,7 +3,9 @@
 #include "klee/Expr/ArrayCache.h"
 #include "klee/Expr/Assignment.h"
 
+#include <chrono>
 #include <iostream>
+#include <random>
 #include <vector>
 
 int finished = 0;
@@ -65,6 +67,21 @@ TEST(AssignmentTest, CompactModel)
   ASSERT_EQ(a.getValue(array, 320000), 32);
 }
 
+TEST(AssignmentTest, CompactModelAssign)
+{
+  std::vector<std::pair<uint32_t, uint8_t> > content = {
+      {0, 1}, {2, 3}, {3, 4}, {1000, 5}};
+  CompactArrayModel model;
+  model.assign(content.begin(), content.end());
+  ASSERT_EQ(model.get(0), 1);
+  ASSERT_EQ(model.get(1), 0);
+  ASSERT_EQ(model.get(2), 3);
+  ASSERT_EQ(model.get(3), 4);
+  ASSERT_EQ(model.get(500), 0);
+  ASSERT_EQ(model.get(1000), 5);
+  ASSERT_EQ(model.asMap().size(), 5u);
+}
+
 TEST(AssignmentTest, CompactModelAsVector)
 {
   ArrayCache ac;
@@ -87,3 +104,65 @@ TEST(AssignmentTest, CompactModelAsVector)
   ASSERT_EQ(vec[31], 0);
   ASSERT_EQ(vec[32], 32);
 }
+
+TEST(AssignmentTest, CompactModelRuns)
+{
+  // dense bytes, short gaps filled, and runs far apart
+  std::vector<std::pair<uint32_t, uint8_t> > content = {
+      {3, 1}, {4, 2}, {10, 3}, {100, 4}, {101, 5}, {5000, 6}};
+  CompactArrayModel model;
+  model.assign(content.begin(), content.end());
+  for (const auto &pair : content)
+    ASSERT_EQ(model.get(pair.first), pair.second);
+  ASSERT_EQ(model.get(0), 0);
+  ASSERT_EQ(model.get(50), 0);
+  ASSERT_EQ(model.get(102), 0);
+  ASSERT_EQ(model.get(4999), 0);
+  ASSERT_EQ(model.get(5001), 0);
+  std::vector<uint8_t> vec = model.asVector();
+  ASSERT_EQ(vec.size(), 5001u);
+  ASSERT_EQ(vec[100], 4);
+  ASSERT_EQ(vec[5000], 6);
+}
+
+// Not a test as such: compares the time of reading the bytes of sparse
+// and dense models from an Assignment and from maps.
+TEST(AssignmentTest, Benchmark)
+{
+  ArrayCache ac;
+  std::mt19937 rng(7);
+  std::vector<const Array *> arrays;
+  Assignment::map_bindings_ty maps;
+  for (unsigned i = 0; i != 8; ++i) {
+    const Array *array =
+        ac.CreateArray("bench" + std::to_string(i), /*size=*/4096);
+    arrays.push_back(array);
+    MapArrayModel &model = maps[array];
+    // half of the arrays are dense, the others sparse
+    unsigned step = i % 2 ? 1 : 97;
+    for (unsigned index = 0; index < 4096; index += step)
+      model.add(index, rng());
+  }
+  Assignment assignment(maps);
+
+  std::vector<std::pair<const Array *, unsigned> > reads;
+  for (unsigned i = 0; i != 1 << 20; ++i)
+    reads.emplace_back(arrays[rng() % arrays.size()], rng() % 4096);
+
+  unsigned flatSum = 0, mapSum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const auto &read : reads)
+    flatSum += assignment.getValue(read.first, read.second);
+  auto middle = std::chrono::steady_clock::now();
+  for (const auto &read : reads)
+    mapSum += maps.find(read.first)->second.get(read.second);
+  auto end = std::chrono::steady_clock::now();
+
+  EXPECT_EQ(mapSum, flatSum);
+  using std::chrono::microseconds;
+  std::cout << "assignment: "
+            << std::chrono::duration_cast<microseconds>(middle - start).count()
+            << "us, maps: "
+            << std::chrono::duration_cast<microseconds>(end - middle).count()
+            << "us for " << reads.size() << " reads\n";
+}
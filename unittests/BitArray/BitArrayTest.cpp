@@ -0,0 +1,67 @@
+//===-- BitArrayTest.cpp ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/BitArray.h"
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+TEST(BitArrayTest, SetRange) {
+  BitArray ba(300);
+  ba.setRange(5, 200);
+  for (unsigned i = 0; i < 300; ++i)
+    EXPECT_EQ(i >= 5 && i < 205, ba.get(i)) << "bit " << i;
+  EXPECT_EQ(200u, ba.popcount());
+
+  ba.setRange(40, 100, false);
+  EXPECT_FALSE(ba.get(40));
+  EXPECT_FALSE(ba.get(139));
+  EXPECT_TRUE(ba.get(140));
+  EXPECT_EQ(100u, ba.popcount());
+}
+
+TEST(BitArrayTest, FindFirst) {
+  BitArray ba(1000);
+  EXPECT_EQ(1000u, ba.findFirstSet());
+  EXPECT_EQ(0u, ba.findFirstUnset());
+
+  ba.set(777);
+  EXPECT_EQ(777u, ba.findFirstSet());
+  EXPECT_EQ(777u, ba.findFirstSet(777));
+  EXPECT_EQ(1000u, ba.findFirstSet(778));
+
+  ba.setRange(0, 1000);
+  ba.unset(513);
+  EXPECT_EQ(513u, ba.findFirstUnset());
+  EXPECT_EQ(1000u, ba.findFirstUnset(514));
+}
+
+TEST(BitArrayTest, AllSet) {
+  BitArray ba(100);
+  ba.setRange(30, 40);
+  EXPECT_TRUE(ba.isAllSet(30, 40));
+  EXPECT_TRUE(ba.isAllSet(31, 8));
+  EXPECT_FALSE(ba.isAllSet(29, 2));
+  EXPECT_FALSE(ba.isAllSet(60, 11));
+}
+
+TEST(BitArrayTest, Resize) {
+  BitArray ba(10, true);
+  ba.resize(0);
+  EXPECT_EQ(0u, ba.size());
+  ba.resize(70, true);
+  EXPECT_EQ(70u, ba.popcount());
+  ba.resize(100);
+  EXPECT_EQ(70u, ba.popcount());
+  EXPECT_EQ(70u, ba.findFirstUnset());
+}
+
+}
@@ -56,3 +56,41 @@ TEST(DiscretePDFTest, Rotatation) {
   ASSERT_EQ(1, testTree.getWeight(1));
   ASSERT_EQ(2, testTree.getWeight(2));
 }
+
+TEST(DiscretePDFTest, Batched) {
+  DiscretePDF<int> testTree;
+
+  std::vector<std::pair<int, double> > items;
+  for (auto i = 0; i < 100; ++i)
+    items.emplace_back(i, 1);
+  testTree.insert(items);
+  ASSERT_EQ(100u, testTree.size());
+
+  // weight 1 each, so choose selects by rank
+  ASSERT_EQ(0, testTree.choose(0));
+  ASSERT_EQ(50, testTree.choose(0.505));
+  ASSERT_EQ(99, testTree.choose(0.9999));
+
+  std::vector<int> removed;
+  for (auto i = 0; i < 100; i += 2)
+    removed.push_back(i);
+  testTree.remove(removed);
+  ASSERT_EQ(50u, testTree.size());
+  ASSERT_FALSE(testTree.inTree(0));
+  ASSERT_EQ(1, testTree.choose(0));
+  ASSERT_EQ(99, testTree.choose(0.9999));
+
+  // all the weight on a single item
+  std::vector<std::pair<int, double> > updated;
+  for (auto i = 1; i < 100; i += 2)
+    updated.emplace_back(i, i == 51 ? 1 : 0);
+  testTree.update(updated);
+  ASSERT_EQ(51, testTree.choose(0));
+  ASSERT_EQ(51, testTree.choose(0.9999));
+
+  // a small batch takes the single item path
+  testTree.remove(std::vector<int>{51});
+  testTree.insert(std::vector<std::pair<int, double> >{{2, 1}});
+  ASSERT_EQ(2, testTree.choose(0.5));
+  ASSERT_EQ(50u, testTree.size());
+}
@@ -0,0 +1,81 @@
+//===-- ArrayCanonicalizerTest.cpp ----------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/ArrayCanonicalizer.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Expr.h"
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> read(const UpdateList &ul, unsigned index) {
+  return ReadExpr::create(ul, ConstantExpr::alloc(index, Expr::Int32));
+}
+
+// a[i] + b[0] with a written at a symbolic index of b
+ref<Expr> makeQuery(const Array *a, const Array *b) {
+  UpdateList ua(a, 0);
+  UpdateList ub(b, 0);
+  ua.extend(ZExtExpr::create(read(ub, 1), Expr::Int32),
+            ConstantExpr::alloc(3, Expr::Int8));
+  return EqExpr::create(AddExpr::create(read(ua, 2), read(ub, 0)),
+                        ConstantExpr::alloc(5, Expr::Int8));
+}
+
+TEST(ArrayCanonicalizerTest, RenamesByFirstOccurrence) {
+  ArrayCache ac, canonicalArrays;
+  const Array *a = ac.CreateArray("a", 4);
+  const Array *b = ac.CreateArray("b", 4);
+  const Array *x = ac.CreateArray("x", 4);
+  const Array *y = ac.CreateArray("y", 4);
+
+  ref<Expr> first = makeQuery(a, b);
+  ref<Expr> second = makeQuery(x, y);
+  ASSERT_NE(first, second);
+
+  ArrayCanonicalizer c1(canonicalArrays), c2(canonicalArrays);
+  EXPECT_EQ(c1.visit(first), c2.visit(second));
+
+  // within one query, each array keeps its number
+  EXPECT_NE(c1.visit(first), c1.visit(makeQuery(b, a)));
+  EXPECT_EQ(c1.visit(makeQuery(b, a)), c2.visit(makeQuery(y, x)));
+}
+
+TEST(ArrayCanonicalizerTest, Assignments) {
+  ArrayCache ac, canonicalArrays;
+  const Array *a = ac.CreateArray("a", 4);
+  const Array *b = ac.CreateArray("b", 4);
+  ref<Expr> query = makeQuery(a, b);
+
+  ArrayCanonicalizer canonicalizer(canonicalArrays);
+  ref<Expr> renamed = canonicalizer.visit(query);
+
+  Assignment::map_bindings_ty bindings;
+  bindings[a].add(2, 1);
+  bindings[b].add(0, 4);
+  bindings[b].add(1, 0);
+  Assignment assignment(bindings);
+  ASSERT_TRUE(assignment.satisfies(&query, &query + 1));
+
+  std::shared_ptr<const Assignment> canonical =
+      canonicalizer.toCanonical(assignment);
+  EXPECT_FALSE(canonical->hasBindings(a));
+  EXPECT_TRUE(canonical->satisfies(&renamed, &renamed + 1));
+
+  std::shared_ptr<const Assignment> back = canonicalizer.toOriginal(*canonical);
+  EXPECT_EQ(1, back->getValue(a, 2));
+  EXPECT_EQ(4, back->getValue(b, 0));
+  EXPECT_TRUE(back->satisfies(&query, &query + 1));
+}
+
+}
@@ -0,0 +1,79 @@
+//===-- ByteBoundsTest.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/ByteBounds.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> read(const Array *array, unsigned index) {
+  return ReadExpr::create(UpdateList(array, 0),
+                          ConstantExpr::alloc(index, Expr::Int32));
+}
+
+ref<Expr> read32(const Array *array) {
+  return ConcatExpr::create4(read(array, 3), read(array, 2), read(array, 1),
+                             read(array, 0));
+}
+
+ref<Expr> int32(uint64_t value) {
+  return ConstantExpr::alloc(value, Expr::Int32);
+}
+
+TEST(ByteBoundsTest, Comparisons) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  ByteBounds bounds;
+
+  // a < 1000 bounds the higher bytes
+  EXPECT_TRUE(bounds.add(UltExpr::create(read32(a), int32(1000))));
+  EXPECT_EQ(ValueRange(0, 0), bounds.get(a, 3));
+  EXPECT_EQ(ValueRange(0, 0), bounds.get(a, 2));
+  EXPECT_EQ(ValueRange(0, 3), bounds.get(a, 1));
+  EXPECT_EQ(ValueRange(0, 255), bounds.get(a, 0));
+
+  // a negated comparison of a byte
+  EXPECT_TRUE(bounds.add(Expr::createIsZero(
+      UltExpr::create(read(a, 0), ConstantExpr::alloc(7, Expr::Int8)))));
+  EXPECT_EQ(ValueRange(7, 255), bounds.get(a, 0));
+
+  EXPECT_FALSE(bounds.add(EqExpr::create(read(a, 0), read(a, 1))));
+  EXPECT_FALSE(bounds.isContradictory());
+
+  EXPECT_TRUE(bounds.add(UltExpr::create(ConstantExpr::alloc(0, Expr::Int8),
+                                         read(a, 3))));
+  EXPECT_TRUE(bounds.isContradictory());
+}
+
+TEST(ByteBoundsTest, Evaluate) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  std::vector<ref<Expr>> constraints = {
+      UltExpr::create(read32(a), int32(10))};
+  ConstraintManager cm(constraints);
+  const ByteBounds &bounds = cm.getByteBounds();
+
+  // the offset of an element of a 40-byte array
+  ref<Expr> offset = AddExpr::create(int32(4), MulExpr::create(int32(4),
+                                                               read32(a)));
+  EXPECT_TRUE(bounds.evaluate(UltExpr::create(offset, int32(44))).mustEqual(1));
+  EXPECT_TRUE(bounds.evaluate(UltExpr::create(int32(40), offset)).mustEqual(0));
+  EXPECT_FALSE(bounds.evaluate(UltExpr::create(offset, int32(20))).isFixed());
+
+  ref<Expr> shifted = ShlExpr::create(read32(a), int32(2));
+  EXPECT_TRUE(bounds.evaluate(UltExpr::create(shifted, int32(37))).mustEqual(1));
+}
+
+}
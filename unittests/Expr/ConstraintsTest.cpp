@@ -0,0 +1,66 @@
+//===-- ConstraintsTest.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> read(const Array *array, unsigned index) {
+  return ReadExpr::create(UpdateList(array, 0),
+                          ConstantExpr::alloc(index, Expr::Int32));
+}
+
+ref<Expr> byte(uint64_t value) {
+  return ConstantExpr::alloc(value, Expr::Int8);
+}
+
+TEST(ConstraintsTest, RewriteEqualities) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  const Array *b = ac.CreateArray("b", 4);
+
+  ConstraintManager cm;
+  ref<Expr> unrelated = UltExpr::create(read(b, 0), read(b, 1));
+  cm.addConstraint(unrelated);
+  cm.addConstraint(UltExpr::create(read(a, 0), read(a, 1)));
+  cm.addConstraint(UltExpr::create(read(a, 1), read(b, 2)));
+
+  // a[1] == 5 rewrites the constraints on a and keeps the one on b
+  ConstraintManager fork(cm);
+  cm.addConstraint(EqExpr::create(byte(5), read(a, 1)));
+  std::vector<ref<Expr>> constraints(cm.begin(), cm.end());
+  ASSERT_EQ(4u, constraints.size());
+  EXPECT_EQ(unrelated, constraints[0]);
+  EXPECT_EQ(UltExpr::create(read(a, 0), byte(5)), constraints[1]);
+  EXPECT_EQ(UltExpr::create(byte(5), read(b, 2)), constraints[2]);
+
+  // the fork adding the same equality gets the same constraints
+  fork.addConstraint(EqExpr::create(byte(5), read(a, 1)));
+  EXPECT_EQ(cm, fork);
+  std::vector<ref<Expr>> forked(fork.begin(), fork.end());
+  EXPECT_EQ(constraints[1].get(), forked[1].get());
+
+  // rewriting again after more constraints were added
+  cm.addConstraint(UltExpr::create(read(a, 2), read(a, 3)));
+  cm.addConstraint(EqExpr::create(byte(7), read(a, 3)));
+  constraints.assign(cm.begin(), cm.end());
+  ASSERT_EQ(6u, constraints.size());
+  EXPECT_EQ(unrelated, constraints[0]);
+  EXPECT_EQ(UltExpr::create(read(a, 2), byte(7)), constraints[4]);
+}
+
+}
@@ -0,0 +1,86 @@
+//===-- ExprAllocatorTest.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprAllocator.h"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> read(const UpdateList &ul, unsigned index) {
+  return ReadExpr::create(ul, ConstantExpr::alloc(index, Expr::Int32));
+}
+
+/// Build a few expressions and updates and drop them again.
+void buildAndDrop(const Array *a, uint64_t &usedInside) {
+  UpdateList ul(a, 0);
+  ul.extend(ConstantExpr::alloc(1, Expr::Int32),
+            ConstantExpr::alloc(7, Expr::Int8));
+  ref<Expr> sum = AddExpr::create(read(ul, 0), read(ul, 1));
+  usedInside = ExprAllocator::getUsedBytes();
+}
+
+TEST(ExprAllocatorTest, ReusesFreedNodes) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 16);
+  uint64_t usedInside;
+  // interns the small constants, which stay allocated
+  buildAndDrop(a, usedInside);
+  // sanitizer builds do not use slabs
+  if (!ExprAllocator::getSlabBytes())
+    return;
+
+  uint64_t used = ExprAllocator::getUsedBytes();
+  uint64_t slabs = ExprAllocator::getSlabBytes();
+  buildAndDrop(a, usedInside);
+  EXPECT_LT(used, usedInside);
+  EXPECT_EQ(used, ExprAllocator::getUsedBytes());
+  // served from the free lists
+  EXPECT_EQ(slabs, ExprAllocator::getSlabBytes());
+}
+
+TEST(ExprAllocatorTest, CreateDestroyThroughput) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 64);
+  UpdateList ul(a, 0);
+
+  // build and drop short-lived expressions, like bounds checks do
+  const unsigned rounds = 20000, perRound = 16;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned round = 0; round != rounds; ++round) {
+    std::vector<ref<Expr> > temporaries;
+    for (unsigned i = 0; i != perRound; ++i) {
+      ref<Expr> offset =
+          AddExpr::create(ZExtExpr::create(read(ul, i), Expr::Int32),
+                          ConstantExpr::alloc(round, Expr::Int32));
+      temporaries.push_back(
+          UltExpr::create(offset, ConstantExpr::alloc(64, Expr::Int32)));
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  // each temporary takes a read, its index, a cast, a constant, a sum, a
+  // bound and a comparison
+  double nodes = 7.0 * rounds * perRound;
+  std::cout << "[ INFO     ] " << nodes / elapsed.count() / 1e6
+            << " million nodes created and destroyed per second, "
+            << ExprAllocator::getSlabBytes() / 1024 << " KiB of slabs\n";
+  EXPECT_GT(elapsed.count(), 0);
+}
+
+}
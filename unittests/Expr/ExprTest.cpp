@@ -12,6 +12,11 @@
 
 #include "klee/Expr/ArrayCache.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprBuilder.h"
+#include "klee/Expr/ExprSerializer.h"
+
+#include <memory>
+#include <sstream>
 
 using namespace klee;
 
@@ -23,6 +28,13 @@ ref<Expr> getConstant(int value, Expr::Width width) {
   return ConstantExpr::create(trunc, width);
 }
 
+unsigned countNodes(const ref<Expr> &e) {
+  unsigned count = 1;
+  for (unsigned i = 0; i != e->getNumKids(); ++i)
+    count += countNodes(e->getKid(i));
+  return count;
+}
+
 TEST(ExprTest, BasicConstruction) {
   EXPECT_EQ(ref<Expr>(ConstantExpr::alloc(0, 32)),
             SubExpr::create(ConstantExpr::alloc(10, 32),
@@ -264,4 +276,329 @@ TEST(ExprTest, ReadExprFoldingSymbolicIndexUpdate) {
     EXPECT_EQ(Expr::Read, read.get()->getKind());
   }
 }
+
+TEST(ExprTest, ConstantInterning) {
+  // small constants share one node per width
+  ref<ConstantExpr> a = ConstantExpr::create(11, Expr::Int64);
+  EXPECT_EQ(a.get(), ConstantExpr::create(11, Expr::Int64).get());
+  EXPECT_EQ(a.get(), ConstantExpr::alloc(llvm::APInt(64, 11)).get());
+  EXPECT_NE(a.get(), ConstantExpr::create(11, Expr::Int32).get());
+
+  // folding results are interned as well
+  EXPECT_EQ(a.get(),
+            ConstantExpr::create(10, Expr::Int64)
+                ->Add(ConstantExpr::create(1, Expr::Int64)).get());
+
+  // large and wide constants are still allocated, but compare equal
+  ref<ConstantExpr> b = ConstantExpr::create(1 << 20, Expr::Int64);
+  ref<ConstantExpr> c = ConstantExpr::create(1 << 20, Expr::Int64);
+  EXPECT_NE(b.get(), c.get());
+  EXPECT_EQ(b, c);
+  ref<ConstantExpr> d = ConstantExpr::alloc(llvm::APInt(128, 11));
+  EXPECT_EQ(128u, d->getWidth());
+  EXPECT_EQ(11u, d->getZExtValue(128));
+}
+
+TEST(ExprTest, Depth) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("depth", 16);
+  UpdateList ul(array, 0);
+  ref<Expr> x = ReadExpr::create(ul, ConstantExpr::alloc(0, Expr::Int32));
+  EXPECT_EQ(1u, ConstantExpr::alloc(7, Expr::Int8)->getDepth());
+  EXPECT_EQ(2u, x->getDepth());
+  EXPECT_EQ(3u, NotExpr::create(x)->getDepth());
+
+  // the deepest kid counts, not the number of nodes
+  ref<Expr> sum = x;
+  for (unsigned i = 0; i != 10; ++i)
+    sum = AddExpr::create(sum, MulExpr::create(sum, x));
+  EXPECT_EQ(22u, sum->getDepth());
+
+  // a read counts its index, but not the values written before it
+  ul.extend(ZExtExpr::create(x, Expr::Int32), ExtractExpr::create(sum, 0, 8));
+  ref<Expr> index = ZExtExpr::create(
+      ReadExpr::create(UpdateList(array, 0),
+                       ConstantExpr::alloc(1, Expr::Int32)),
+      Expr::Int32);
+  EXPECT_EQ(4u, ReadExpr::create(ul, index)->getDepth());
+}
+
+TEST(ExprTest, HashConsingBuilder) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  std::unique_ptr<ExprBuilder> builder(
+      createHashConsingExprBuilder(createDefaultExprBuilder()));
+
+  auto build = [&](unsigned index) {
+    UpdateList ul(array, 0);
+    ref<Expr> read = builder->Read(ul, builder->Constant(index, Expr::Int32));
+    return builder->Add(builder->ZExt(read, Expr::Int32),
+                        builder->Constant(1000, Expr::Int32));
+  };
+
+  // structurally equal expressions are the same node
+  ref<Expr> a = build(3);
+  ref<Expr> b = build(3);
+  EXPECT_EQ(a.get(), b.get());
+  EXPECT_EQ(a->getKid(0).get(), b->getKid(0).get());
+  EXPECT_NE(a.get(), build(4).get());
+
+  // expressions built outside the builder are matched structurally
+  ref<Expr> c = AddExpr::alloc(a->getKid(0), ConstantExpr::alloc(1000, 32));
+  EXPECT_EQ(a.get(), builder->Add(c->getKid(0), c->getKid(1)).get());
+}
+
+TEST(ExprTest, SimplifyingBuilderOnCanonical) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  std::unique_ptr<ExprBuilder> canonical(createCanonicalExprBuilder());
+  std::unique_ptr<ExprBuilder> simplifying(
+      createSimplifyingExprBuilder(createCanonicalExprBuilder()));
+
+  ref<Expr> byte = Expr::createTempRead(array, Expr::Int8);
+  ref<Expr> cond = EqExpr::create(ConstantExpr::alloc(3, Expr::Int8), byte);
+  // the segment of a pointer to one of two objects
+  auto segment = [&](ExprBuilder &b, uint64_t other) {
+    return b.Select(cond, b.Constant(11, Expr::Int64),
+                    b.Constant(other, Expr::Int64));
+  };
+  auto patterns = [&](ExprBuilder &b) {
+    return std::vector<ref<Expr>>{
+        b.ZExt(b.ZExt(byte, Expr::Int16), Expr::Int32),
+        b.SExt(b.ZExt(byte, Expr::Int16), Expr::Int64),
+        b.Extract(b.ZExt(byte, Expr::Int32), 0, Expr::Int8),
+        b.Extract(b.ZExt(byte, Expr::Int32), 16, Expr::Int8),
+        b.Eq(b.Constant(11, Expr::Int64), segment(b, 12)),
+        b.Eq(b.Constant(12, Expr::Int64), segment(b, 12)),
+        b.Eq(segment(b, 12), segment(b, 13)),
+        b.Extract(b.ZExt(segment(b, 12), 128), 0, Expr::Int32),
+        b.Ne(byte, b.Constant(7, Expr::Int8)),
+    };
+  };
+
+  std::vector<ref<Expr>> simplified = patterns(*simplifying);
+  EXPECT_EQ(ZExtExpr::create(byte, Expr::Int32), simplified[0]);
+  EXPECT_EQ(ZExtExpr::create(byte, Expr::Int64), simplified[1]);
+  EXPECT_EQ(byte, simplified[2]);
+  EXPECT_EQ(ref<Expr>(ConstantExpr::alloc(0, Expr::Int8)), simplified[3]);
+  EXPECT_EQ(cond, simplified[4]);
+  EXPECT_EQ(Expr::createIsZero(cond), simplified[5]);
+  EXPECT_EQ(cond, simplified[6]);
+  EXPECT_EQ(SelectExpr::create(cond, ConstantExpr::alloc(11, Expr::Int32),
+                               ConstantExpr::alloc(12, Expr::Int32)),
+            simplified[7]);
+  // booleans are still negated as KLEE does
+  EXPECT_EQ(NeExpr::create(byte, ConstantExpr::alloc(7, Expr::Int8)),
+            simplified[8]);
+
+  unsigned before = 0, after = 0;
+  for (const auto &e : patterns(*canonical))
+    before += countNodes(e);
+  for (const auto &e : simplified)
+    after += countNodes(e);
+  EXPECT_LT(after, before);
+}
+
+TEST(ExprTest, SerializeRoundTrip) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  UpdateList older(array, 0);
+  older.extend(ConstantExpr::alloc(1, Expr::Int32),
+               ConstantExpr::alloc(7, Expr::Int8));
+  UpdateList newer = older;
+  newer.extend(Expr::createTempRead(array, 32),
+               ConstantExpr::alloc(9, Expr::Int8));
+
+  ref<Expr> shared = ReadExpr::alloc(older, ConstantExpr::alloc(2, Expr::Int32));
+  ref<Expr> a = AddExpr::alloc(ZExtExpr::alloc(shared, Expr::Int32),
+                               ConstantExpr::alloc(1000, Expr::Int32));
+  ref<Expr> b = ConcatExpr::alloc(
+      ReadExpr::alloc(newer, ConstantExpr::alloc(3, Expr::Int32)), shared);
+  ref<Expr> c = EqExpr::alloc(ExtractExpr::alloc(b, 4, Expr::Int8),
+                              ConstantExpr::alloc(llvm::APInt(8, 5)));
+  ref<Expr> wide = ConstantExpr::alloc(llvm::APInt(128, 11));
+
+  std::stringstream ss;
+  ExprWriter w(ss);
+  w.write(a);
+  w.write(ref<Expr>());
+  w.write(b);
+  w.write(c);
+  w.write(wide);
+  w.writeInt(42);
+
+  ExprReader r(ss);
+  ref<Expr> a2 = r.readExpr();
+  EXPECT_TRUE(r.readExpr().isNull());
+  ref<Expr> b2 = r.readExpr();
+  ref<Expr> c2 = r.readExpr();
+  ref<Expr> wide2 = r.readExpr();
+  EXPECT_EQ(42u, r.readInt());
+
+  EXPECT_EQ(a, a2);
+  EXPECT_EQ(b, b2);
+  EXPECT_EQ(c, c2);
+  EXPECT_EQ(wide, wide2);
+
+  // sharing is kept, for expressions and for update nodes
+  EXPECT_EQ(a2->getKid(0)->getKid(0).get(), b2->getKid(1).get());
+  const ReadExpr *olderRead = cast<ReadExpr>(b2->getKid(1));
+  const ReadExpr *newerRead = cast<ReadExpr>(b2->getKid(0));
+  EXPECT_EQ(array, newerRead->updates.root);
+  EXPECT_EQ(2u, newerRead->updates.getSize());
+  EXPECT_EQ(olderRead->updates.head, newerRead->updates.head->next);
+}
+
+TEST(ExprTest, ReadThroughLongUpdateList) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 64);
+  const Array *sym = ac.CreateArray("sym", 4);
+  ref<Expr> symIndex =
+      ZExtExpr::create(ReadExpr::create(UpdateList(sym, 0),
+                                        ConstantExpr::alloc(0, Expr::Int32)),
+                       Expr::Int32);
+  auto index = [](unsigned i) -> ref<Expr> {
+    return ConstantExpr::alloc(i, Expr::Int32);
+  };
+  auto value = [](unsigned v) -> ref<Expr> {
+    return ConstantExpr::alloc(v, Expr::Int8);
+  };
+
+  // a symbolic write, then a long run of writes at constant indices
+  UpdateList ul(array, 0);
+  ul.extend(index(5), value(1));
+  ul.extend(symIndex, value(2));
+  for (unsigned i = 0; i != 5000; ++i)
+    ul.extend(index(i % 40), value(i % 251));
+
+  // the most recent write at each index
+  for (unsigned i = 0; i != 40; ++i)
+    EXPECT_EQ(value((4960 + i) % 251), ReadExpr::create(ul, index(i)));
+
+  // not written in the run: the read starts at the symbolic write
+  ref<Expr> read = ReadExpr::create(ul, index(5 + 40));
+  ASSERT_TRUE(isa<ReadExpr>(read));
+  const UpdateNode *head = cast<ReadExpr>(read)->updates.head;
+  ASSERT_TRUE(head);
+  EXPECT_EQ(symIndex, head->index);
+  EXPECT_EQ(2u, head->getSize());
+
+  // a later symbolic write hides the run
+  ul.extend(symIndex, value(3));
+  ul.extend(index(7), value(4));
+  EXPECT_EQ(value(4), ReadExpr::create(ul, index(7)));
+  read = ReadExpr::create(ul, index(8));
+  ASSERT_TRUE(isa<ReadExpr>(read));
+  EXPECT_EQ(ul.getSize() - 1, cast<ReadExpr>(read)->updates.getSize());
+}
+
+TEST(ExprTest, InternedUpdates) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 8);
+  const Array *b = ac.CreateArray("b", 8);
+  ref<Expr> sym = ReadExpr::create(UpdateList(b, 0),
+                                   ConstantExpr::alloc(0, Expr::Int32));
+  auto index = [&](unsigned i) -> ref<Expr> {
+    return ZExtExpr::create(
+        AddExpr::create(sym, ConstantExpr::alloc(i, Expr::Int8)), Expr::Int32);
+  };
+  auto value = [](unsigned v) -> ref<Expr> {
+    return ConstantExpr::alloc(v, Expr::Int8);
+  };
+
+  // the same writes, with separately built indices
+  UpdateList ul1(a, 0), ul2(a, 0), other(b, 0);
+  for (unsigned i = 0; i != 100; ++i) {
+    ul1.extend(index(i % 7), value(i));
+    ul2.extend(index(i % 7), value(i));
+    other.extend(index(i % 7), value(i));
+  }
+  EXPECT_EQ(ul1.head, ul2.head);
+  EXPECT_EQ(0, ul1.compare(ul2));
+  // the nodes of each array are kept apart
+  EXPECT_NE(ul1.head, other.head);
+
+  // lists branching off are shared again when they make the same write
+  UpdateList branch1 = ul1, branch2(a, ul1.head);
+  branch1.extend(index(1), value(1));
+  branch2.extend(index(1), value(1));
+  EXPECT_EQ(branch1.head, branch2.head);
+  EXPECT_NE(0, branch1.compare(ul1));
+  EXPECT_EQ(ul1.head, branch1.head->next);
+}
+
+TEST(ExprTest, ArrayCollection) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("arr", 4);
+  const Array *b = ac.CreateArray("arr", 8);
+  EXPECT_EQ(a, ac.CreateArray("arr", 4));
+  EXPECT_NE(a, b);
+  EXPECT_TRUE(a->hasSameName(*b));
+  EXPECT_EQ(2u, ac.size());
+
+  // never referenced, so kept
+  EXPECT_EQ(0u, ac.collect());
+
+  {
+    UpdateList ul(a, 0);
+    ref<Expr> read = ReadExpr::create(ul, ConstantExpr::alloc(0, Expr::Int32));
+    EXPECT_EQ(0u, ac.collect());
+  }
+  // the last reference to a is gone
+  EXPECT_EQ(1u, ac.collect());
+  EXPECT_EQ(1u, ac.size());
+
+  // a new array under the old name
+  const Array *c = ac.CreateArray("arr", 4);
+  EXPECT_TRUE(c->hasSameName(*b));
+  EXPECT_EQ(2u, ac.size());
+
+  // an array outliving its cache is freed with its last reference
+  std::unique_ptr<UpdateList> ul;
+  {
+    ArrayCache scoped;
+    ul.reset(new UpdateList(scoped.CreateArray("outlives", 2), 0));
+  }
+  EXPECT_EQ("outlives", ul->root->name);
+  ul.reset();
+}
+
+TEST(ExprTest, NativeConstantFolding) {
+  const Expr::Width widths[] = {Expr::Bool, Expr::Int8, 13, Expr::Int32,
+                                Expr::Int64, 72};
+  for (Expr::Width w : widths) {
+    llvm::APInt values[] = {llvm::APInt(w, 0), llvm::APInt(w, 1),
+                            llvm::APInt(w, 3), llvm::APInt::getAllOnesValue(w),
+                            llvm::APInt::getSignedMinValue(w),
+                            llvm::APInt::getSignedMaxValue(w),
+                            llvm::APInt(w, w)};
+    for (const llvm::APInt &a : values) {
+      for (const llvm::APInt &b : values) {
+        ref<ConstantExpr> l = ConstantExpr::alloc(a);
+        ref<ConstantExpr> r = ConstantExpr::alloc(b);
+        EXPECT_EQ(a + b, l->Add(r)->getAPValue());
+        EXPECT_EQ(a - b, l->Sub(r)->getAPValue());
+        EXPECT_EQ(a * b, l->Mul(r)->getAPValue());
+        EXPECT_EQ(a.shl(b), l->Shl(r)->getAPValue());
+        EXPECT_EQ(a.lshr(b), l->LShr(r)->getAPValue());
+        EXPECT_EQ(a.ashr(b), l->AShr(r)->getAPValue());
+        if (b != 0) {
+          EXPECT_EQ(a.udiv(b), l->UDiv(r)->getAPValue());
+          EXPECT_EQ(a.sdiv(b), l->SDiv(r)->getAPValue());
+          EXPECT_EQ(a.urem(b), l->URem(r)->getAPValue());
+          EXPECT_EQ(a.srem(b), l->SRem(r)->getAPValue());
+        }
+        EXPECT_EQ(a.ult(b), l->Ult(r)->isTrue());
+        EXPECT_EQ(a.sle(b), l->Sle(r)->isTrue());
+        EXPECT_EQ(a == b, l->Eq(r)->isTrue());
+      }
+    }
+  }
+
+  // the Bool constants are unique
+  EXPECT_EQ(ConstantExpr::getTrue(), ConstantExpr::create(1, Expr::Bool));
+  EXPECT_EQ(ConstantExpr::getFalse(), ConstantExpr::alloc(0, Expr::Bool));
+  EXPECT_TRUE(ConstantExpr::getFalse()->isFalse());
+  EXPECT_FALSE(ConstantExpr::create(1, Expr::Int8)->isTrue());
+}
 }
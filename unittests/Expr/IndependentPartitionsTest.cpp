@@ -0,0 +1,155 @@
+//===-- IndependentPartitionsTest.cpp -------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/IndependentPartitions.h"
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> readByte(const Array *array, ref<Expr> index) {
+  UpdateList ul(array, 0);
+  return ReadExpr::create(ul, index);
+}
+
+ref<Expr> readByte(const Array *array, unsigned index) {
+  return readByte(array, ConstantExpr::alloc(index, Expr::Int32));
+}
+
+ref<Expr> lessThan(ref<Expr> e, unsigned value) {
+  return UltExpr::create(e, ConstantExpr::alloc(value, Expr::Int8));
+}
+
+TEST(IndependentPartitionsTest, SeparateBytes) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  const Array *b = ac.CreateArray("b", 4);
+  ref<Expr> c0 = lessThan(readByte(a, 0), 10);
+  ref<Expr> c1 = lessThan(readByte(a, 1), 20);
+  ref<Expr> c2 = lessThan(readByte(b, 0), 30);
+
+  IndependentPartitions partitions;
+  partitions.add(0, c0);
+  partitions.add(1, c1);
+  partitions.add(2, c2);
+  EXPECT_EQ(3U, partitions.getPartitions().size());
+
+  std::vector<ref<Expr> > result;
+  partitions.getDependencies(readByte(a, 1), result);
+  ASSERT_EQ(1U, result.size());
+  EXPECT_EQ(c1, result[0]);
+
+  // a constraint on two bytes joins their partitions
+  partitions.add(3, EqExpr::create(readByte(a, 0), readByte(b, 0)));
+  EXPECT_EQ(2U, partitions.getPartitions().size());
+  result.clear();
+  partitions.getDependencies(readByte(b, 0), result);
+  ASSERT_EQ(3U, result.size());
+  EXPECT_EQ(c0, result[0]);
+  EXPECT_EQ(c2, result[1]);
+}
+
+TEST(IndependentPartitionsTest, WholeArray) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  const Array *i = ac.CreateArray("i", 4);
+  ref<Expr> c0 = lessThan(readByte(a, 0), 10);
+  ref<Expr> c1 = lessThan(readByte(a, 3), 20);
+  ref<Expr> c2 = lessThan(readByte(i, 0), 4);
+
+  IndependentPartitions partitions;
+  partitions.add(0, c0);
+  partitions.add(1, c1);
+  partitions.add(2, c2);
+  EXPECT_EQ(3U, partitions.getPartitions().size());
+
+  // a read at a symbolic index may alias every byte of the array
+  ref<Expr> index = ZExtExpr::create(readByte(i, 0), Expr::Int32);
+  std::vector<ref<Expr> > result;
+  partitions.getDependencies(readByte(a, index), result);
+  ASSERT_EQ(3U, result.size());
+  EXPECT_EQ(c0, result[0]);
+  EXPECT_EQ(c1, result[1]);
+  EXPECT_EQ(c2, result[2]);
+
+  partitions.add(3, lessThan(readByte(a, index), 5));
+  EXPECT_EQ(1U, partitions.getPartitions().size());
+  // bytes read later belong to the whole array
+  partitions.add(4, lessThan(readByte(a, 2), 7));
+  EXPECT_EQ(1U, partitions.getPartitions().size());
+}
+
+TEST(IndependentPartitionsTest, SharedByCopies) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  const Array *b = ac.CreateArray("b", 4);
+  ref<Expr> c0 = lessThan(readByte(a, 0), 10);
+  ref<Expr> c1 = lessThan(readByte(b, 0), 20);
+
+  ConstraintManager parent;
+  parent.addConstraint(c0);
+  parent.addConstraint(c1);
+  EXPECT_EQ(2U, parent.getIndependentPartitions().getPartitions().size());
+
+  ConstraintManager child(parent);
+  child.addConstraint(EqExpr::create(readByte(a, 0), readByte(b, 0)));
+  EXPECT_EQ(1U, child.getIndependentPartitions().getPartitions().size());
+  EXPECT_EQ(2U, parent.getIndependentPartitions().getPartitions().size());
+
+  std::vector<ref<Expr> > result;
+  parent.getIndependentConstraints(readByte(b, 0), result);
+  ASSERT_EQ(1U, result.size());
+  EXPECT_EQ(c1, result[0]);
+}
+
+
+TEST(IndependentPartitionsTest, OrderedAcrossPartitions) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  ref<Expr> c0 = lessThan(readByte(a, 0), 10);
+  ref<Expr> c1 = lessThan(readByte(a, 1), 20);
+  ref<Expr> c2 = lessThan(readByte(a, 0), 30);
+  ref<Expr> c3 = lessThan(readByte(a, 1), 40);
+
+  IndependentPartitions partitions;
+  partitions.add(0, c0);
+  partitions.add(1, c1);
+  partitions.add(2, c2);
+
+  std::vector<ref<Expr> > result;
+  partitions.getDependencies(readByte(a, 0), result);
+  ASSERT_EQ(2U, result.size());
+  EXPECT_EQ(c0, result[0]);
+  EXPECT_EQ(c2, result[1]);
+
+  // the order of an extended partition is not the one used before
+  partitions.add(3, c3);
+  result.clear();
+  partitions.getDependencies(readByte(a, 1), result);
+  ASSERT_EQ(2U, result.size());
+  EXPECT_EQ(c1, result[0]);
+  EXPECT_EQ(c3, result[1]);
+
+  // the constraints of both partitions interleave
+  result.clear();
+  partitions.getDependencies(
+      EqExpr::create(readByte(a, 0), readByte(a, 1)), result);
+  ASSERT_EQ(4U, result.size());
+  EXPECT_EQ(c0, result[0]);
+  EXPECT_EQ(c1, result[1]);
+  EXPECT_EQ(c2, result[2]);
+  EXPECT_EQ(c3, result[3]);
+}
+
+}
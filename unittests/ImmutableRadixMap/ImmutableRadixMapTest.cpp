@@ -0,0 +1,75 @@
+#include "klee/Internal/ADT/ImmutableRadixMap.h"
+#include "gtest/gtest.h"
+
+#include <map>
+
+using namespace klee;
+
+namespace {
+typedef ImmutableRadixMap<int> Map;
+}
+
+TEST(ImmutableRadixMapTest, ReplaceAndLookup) {
+  Map empty;
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(nullptr, empty.lookup(0));
+
+  Map m = empty.replace(3, 30).replace(100, 1000).replace(1ull << 40, 7);
+  ASSERT_EQ(3u, m.size());
+  EXPECT_EQ(30, *m.lookup(3));
+  EXPECT_EQ(1000, *m.lookup(100));
+  EXPECT_EQ(7, *m.lookup(1ull << 40));
+  EXPECT_EQ(nullptr, m.lookup(4));
+  EXPECT_EQ(nullptr, m.lookup(~0ull));
+
+  // replacing keeps a single entry
+  Map r = m.replace(100, 1001);
+  EXPECT_EQ(3u, r.size());
+  EXPECT_EQ(1001, *r.lookup(100));
+}
+
+TEST(ImmutableRadixMapTest, CopiesAreIndependent) {
+  Map a = Map().replace(1, 10).replace(2, 20);
+  Map b = a.replace(1, 11).remove(2);
+  Map c = b;
+  c = c.replace(50, 500);
+
+  EXPECT_EQ(10, *a.lookup(1));
+  EXPECT_EQ(20, *a.lookup(2));
+  EXPECT_EQ(nullptr, a.lookup(50));
+  EXPECT_EQ(11, *b.lookup(1));
+  EXPECT_EQ(nullptr, b.lookup(2));
+  EXPECT_EQ(1u, b.size());
+  EXPECT_EQ(500, *c.lookup(50));
+  EXPECT_EQ(nullptr, b.lookup(50));
+}
+
+TEST(ImmutableRadixMapTest, MatchesStdMap) {
+  std::map<uint64_t, int> expected;
+  Map m;
+  for (uint64_t k = 0; k < 5000; k += 3) {
+    m = m.replace(k, (int)k);
+    expected[k] = (int)k;
+  }
+  for (uint64_t k = 0; k < 5000; k += 7) {
+    m = m.remove(k);
+    expected.erase(k);
+  }
+
+  EXPECT_EQ(expected.size(), m.size());
+  for (uint64_t k = 0; k < 5100; ++k) {
+    auto it = expected.find(k);
+    const int *value = m.lookup(k);
+    if (it == expected.end()) {
+      EXPECT_EQ(nullptr, value);
+    } else {
+      ASSERT_NE(nullptr, value);
+      EXPECT_EQ(it->second, *value);
+    }
+  }
+
+  for (const auto &entry : expected)
+    m = m.remove(entry.first);
+  EXPECT_TRUE(m.empty());
+  EXPECT_EQ(nullptr, m.lookup(3));
+}
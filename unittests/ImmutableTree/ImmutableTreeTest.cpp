@@ -0,0 +1,119 @@
+#include "klee/Internal/ADT/ImmutableMap.h"
+#include "gtest/gtest.h"
+
+#include <map>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+typedef ImmutableMap<int, int> Map;
+
+void expectEqual(const std::map<int, int> &expected, const Map &m) {
+  ASSERT_EQ(expected.size(), m.size());
+  auto it = expected.begin();
+  for (const auto &entry : m) {
+    EXPECT_EQ(it->first, entry.first);
+    EXPECT_EQ(it->second, entry.second);
+    ++it;
+  }
+}
+}
+
+TEST(ImmutableTreeTest, ReplaceManyExisting) {
+  Map m;
+  std::map<int, int> expected;
+  for (int i = 0; i < 100; ++i) {
+    m = m.replace(std::make_pair(i, i));
+    expected[i] = i;
+  }
+
+  std::vector<std::pair<int, int> > values;
+  for (int i = 99; i >= 0; i -= 7) {
+    values.push_back(std::make_pair(i, -i));
+    expected[i] = -i;
+  }
+  Map r = m.replaceMany(values.begin(), values.end());
+  expectEqual(expected, r);
+
+  // the original is untouched
+  for (int i = 0; i < 100; ++i)
+    EXPECT_EQ(i, m.lookup(i)->second);
+}
+
+TEST(ImmutableTreeTest, ReplaceManyInsertsAndKeepsLast) {
+  Map m;
+  std::map<int, int> expected;
+  for (int i = 0; i < 50; i += 2) {
+    m = m.replace(std::make_pair(i, i));
+    expected[i] = i;
+  }
+
+  std::vector<std::pair<int, int> > values;
+  for (int i = 0; i < 200; i += 3) {
+    values.push_back(std::make_pair(i, 1));
+    values.push_back(std::make_pair(i, 2));
+    expected[i] = 2;
+  }
+  Map r = m.replaceMany(values.begin(), values.end());
+  expectEqual(expected, r);
+
+  // the same as replacing them one by one
+  Map s = m;
+  for (const auto &value : values)
+    s = s.replace(value);
+  expectEqual(expected, s);
+  EXPECT_EQ(r.size(), s.size());
+}
+
+TEST(ImmutableTreeTest, ReplaceManyEmpty) {
+  std::vector<std::pair<int, int> > values;
+  Map m = Map().replace(std::make_pair(1, 1));
+  Map r = m.replaceMany(values.begin(), values.end());
+  expectEqual({{1, 1}}, r);
+  r = Map().replaceMany(values.begin(), values.end());
+  EXPECT_TRUE(r.empty());
+}
+
+TEST(ImmutableTreeTest, DiffVisitsDivergedValues) {
+  Map m;
+  for (int i = 0; i < 1000; ++i)
+    m = m.replace(std::make_pair(i, i));
+
+  Map a = m.replace(std::make_pair(10, -10)).remove(500);
+  Map b = m.replace(std::make_pair(900, -900)).insert(std::make_pair(2000, 0));
+
+  std::map<int, std::pair<int, int> > differing;
+  unsigned visited = 0;
+  EXPECT_TRUE(a.diff(b, [&](const std::pair<int, int> *x,
+                            const std::pair<int, int> *y) {
+    ++visited;
+    if (!x || !y || x->second != y->second)
+      differing[x ? x->first : y->first] =
+          std::make_pair(x ? x->second : 1, y ? y->second : 1);
+    return true;
+  }));
+
+  std::map<int, std::pair<int, int> > expected = {
+      {10, {-10, 10}}, {500, {1, 500}}, {900, {900, -900}}, {2000, {1, 0}}};
+  EXPECT_EQ(expected, differing);
+  // the shared subtrees are skipped
+  EXPECT_LT(visited, 200u);
+
+  // identical trees are not visited at all
+  visited = 0;
+  EXPECT_TRUE(a.diff(a, [&](const std::pair<int, int> *,
+                            const std::pair<int, int> *) {
+    ++visited;
+    return true;
+  }));
+  EXPECT_EQ(0u, visited);
+
+  // stops at the first value it is told to
+  visited = 0;
+  EXPECT_FALSE(a.diff(Map(), [&](const std::pair<int, int> *,
+                                 const std::pair<int, int> *) {
+    return ++visited < 3;
+  }));
+  EXPECT_EQ(3u, visited);
+}
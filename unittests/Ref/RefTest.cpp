@@ -38,3 +38,19 @@ TEST(RefTest, SelfAssign)
   EXPECT_EQ(r_e->refCount, 1);
   finished = 1;
 }
+
+TEST(RefTest, Move)
+{
+  finished = 0;
+  struct Expr *r_e = new Expr();
+  ref<Expr> r(r_e);
+  ref<Expr> s(std::move(r));
+  EXPECT_TRUE(r.isNull());
+  EXPECT_EQ(r_e->refCount, 1);
+  r = std::move(s);
+  EXPECT_TRUE(s.isNull());
+  EXPECT_EQ(r_e->refCount, 1);
+  r = std::move(r);
+  EXPECT_EQ(r_e->refCount, 1);
+  finished = 1;
+}
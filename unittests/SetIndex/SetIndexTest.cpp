@@ -0,0 +1,72 @@
+#include "klee/Internal/ADT/SetIndex.h"
+#include "gtest/gtest.h"
+
+#include <set>
+
+using namespace klee;
+
+namespace {
+typedef std::set<int> Set;
+
+struct Any {
+  bool operator()(int) const { return true; }
+};
+
+struct Is {
+  int value;
+  bool operator()(int v) const { return v == value; }
+};
+}
+
+TEST(SetIndexTest, Lookup) {
+  SetIndex<int, int> index;
+  index.insert(Set{1, 2, 3}, 10);
+  index.insert(Set{1, 2}, 20);
+  index.insert(Set{}, 30);
+
+  ASSERT_EQ(3u, index.size());
+  ASSERT_NE(nullptr, index.lookup(Set{1, 2, 3}));
+  EXPECT_EQ(10, *index.lookup(Set{1, 2, 3}));
+  EXPECT_EQ(20, *index.lookup(Set{1, 2}));
+  EXPECT_EQ(30, *index.lookup(Set{}));
+  EXPECT_EQ(nullptr, index.lookup(Set{1}));
+
+  // replacing keeps a single entry
+  index.insert(Set{1, 2}, 21);
+  EXPECT_EQ(3u, index.size());
+  EXPECT_EQ(21, *index.lookup(Set{1, 2}));
+}
+
+TEST(SetIndexTest, SubsetsAndSupersets) {
+  SetIndex<int, int> index;
+  index.insert(Set{1, 5}, 1);
+  index.insert(Set{2, 3, 4}, 2);
+  index.insert(Set{1, 2, 3, 4, 5, 6}, 3);
+
+  ASSERT_NE(nullptr, index.findSubset(Set{1, 2, 5}, Any()));
+  EXPECT_EQ(1, *index.findSubset(Set{1, 2, 5}, Any()));
+  EXPECT_EQ(nullptr, index.findSubset(Set{1, 2}, Any()));
+  EXPECT_EQ(2, *index.findSubset(Set{1, 2, 3, 4, 5}, Is{2}));
+  EXPECT_EQ(nullptr, index.findSubset(Set{1, 2, 3, 4, 5}, Is{3}));
+
+  EXPECT_EQ(3, *index.findSuperset(Set{1, 6}, Any()));
+  EXPECT_EQ(nullptr, index.findSuperset(Set{7}, Any()));
+  EXPECT_EQ(3, *index.findSuperset(Set{3, 4}, Is{3}));
+  EXPECT_EQ(nullptr, index.findSuperset(Set{1, 5}, Is{2}));
+}
+
+TEST(SetIndexTest, LeastRecentlyUsedIsDropped) {
+  SetIndex<int, int> index(2);
+  int evicted = 0;
+  EXPECT_FALSE(index.insert(Set{1}, 1, &evicted));
+  EXPECT_FALSE(index.insert(Set{2}, 2, &evicted));
+
+  // using {1} makes {2} the oldest entry
+  ASSERT_NE(nullptr, index.lookup(Set{1}));
+  EXPECT_TRUE(index.insert(Set{3}, 3, &evicted));
+  EXPECT_EQ(2, evicted);
+  EXPECT_EQ(2u, index.size());
+  EXPECT_EQ(nullptr, index.lookup(Set{2}));
+  EXPECT_NE(nullptr, index.lookup(Set{1}));
+  EXPECT_NE(nullptr, index.lookup(Set{3}));
+}
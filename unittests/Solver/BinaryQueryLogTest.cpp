@@ -0,0 +1,136 @@
+//===-- BinaryQueryLogTest.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprPPrinter.h"
+#include "klee/Solver/BinaryQueryLog.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> byteAt(const UpdateList &ul, unsigned offset) {
+  return ReadExpr::create(ul, ConstantExpr::alloc(offset, Expr::Int32));
+}
+
+/// Print \arg e, naming the arrays, so that expressions over the arrays of
+/// different caches can be compared.
+std::string str(const ref<Expr> &e) {
+  std::string s;
+  llvm::raw_string_ostream os(s);
+  ExprPPrinter::printSingleExpr(os, e);
+  return os.str();
+}
+
+TEST(BinaryQueryLogTest, RoundTrip) {
+  ArrayCache ac;
+  const Array *sym = ac.CreateArray("sym", 8);
+  std::vector<ref<ConstantExpr> > contents;
+  for (unsigned v : {3, 1, 4, 1})
+    contents.push_back(ConstantExpr::alloc(v, Expr::Int8));
+  const Array *table = ac.CreateArray("table", contents.size(), &contents[0],
+                                      &contents[0] + contents.size());
+
+  UpdateList ul(sym, 0);
+  ul.extend(ZExtExpr::create(byteAt(ul, 7), Expr::Int32),
+            ConstantExpr::alloc(9, Expr::Int8));
+  ref<Expr> x = ConcatExpr::create(byteAt(ul, 1), byteAt(ul, 0));
+  ref<Expr> lookup = ReadExpr::create(
+      UpdateList(table, 0), ZExtExpr::create(byteAt(ul, 3), Expr::Int32));
+  ref<Expr> c0 = UltExpr::create(x, ConstantExpr::alloc(1000, Expr::Int16));
+  ref<Expr> c1 = UltExpr::create(ZExtExpr::create(lookup, Expr::Int16), x);
+
+  std::vector<LoggedQuery> queries(3);
+  queries[0].kind = LoggedQuery::Validity;
+  queries[0].constraints = {c0};
+  queries[0].expr = c1;
+  queries[0].success = true;
+  queries[0].result = -1;
+  queries[0].elapsed = time::microseconds(1234);
+  // shares the constraint and x with the first query
+  queries[1].kind = LoggedQuery::Value;
+  queries[1].constraints = {c0, c1};
+  queries[1].expr = AddExpr::create(x, ConstantExpr::alloc(1, Expr::Int16));
+  queries[1].success = true;
+  queries[1].value = ConstantExpr::alloc(0x1234, Expr::Int16);
+  queries[2].kind = LoggedQuery::InitialValues;
+  queries[2].constraints = {c0};
+  queries[2].expr = ConstantExpr::alloc(0, Expr::Bool);
+  queries[2].objects = {sym};
+  queries[2].success = true;
+  queries[2].result = true;
+  queries[2].values = {{1, 2, 3, 4, 5, 6, 7, 8}};
+
+  std::string data;
+  {
+    llvm::raw_string_ostream os(data);
+    BinaryQueryLogWriter writer(os);
+    for (const LoggedQuery &query : queries)
+      writer.write(query);
+  }
+  EXPECT_TRUE(BinaryQueryLogReader::hasHeader(data.data(), data.size()));
+
+  // read back in another cache, as kleaver does
+  ArrayCache other;
+  std::istringstream is(data);
+  BinaryQueryLogReader reader(is, other);
+  ASSERT_TRUE(reader.isValid());
+  std::vector<LoggedQuery> read(queries.size());
+  for (LoggedQuery &query : read)
+    ASSERT_TRUE(reader.read(query));
+  LoggedQuery extra;
+  EXPECT_FALSE(reader.read(extra));
+
+  for (unsigned i = 0; i != queries.size(); ++i) {
+    EXPECT_EQ(queries[i].kind, read[i].kind);
+    ASSERT_EQ(queries[i].constraints.size(), read[i].constraints.size());
+    for (unsigned j = 0; j != queries[i].constraints.size(); ++j)
+      EXPECT_EQ(str(queries[i].constraints[j]), str(read[i].constraints[j]));
+    EXPECT_EQ(str(queries[i].expr), str(read[i].expr));
+    EXPECT_EQ(queries[i].success, read[i].success);
+    EXPECT_EQ(queries[i].result, read[i].result);
+    EXPECT_EQ(queries[i].values, read[i].values);
+  }
+  EXPECT_EQ(1234u, read[0].elapsed.toMicroseconds());
+  EXPECT_EQ(queries[1].value, read[1].value);
+
+  // the arrays are recreated once, with their contents
+  ASSERT_EQ(1u, read[2].objects.size());
+  const Array *sym2 = read[2].objects[0];
+  EXPECT_NE(sym, sym2);
+  EXPECT_EQ("sym", sym2->name);
+  EXPECT_EQ(8u, sym2->size);
+  const ReadExpr *lookup2 = cast<ReadExpr>(
+      cast<ZExtExpr>(read[0].expr->getKid(0))->getKid(0));
+  EXPECT_EQ(table->constantValues, lookup2->updates.root->constantValues);
+
+  // nodes shared between queries are shared after reading, too
+  EXPECT_EQ(read[0].constraints[0].get(), read[1].constraints[0].get());
+  EXPECT_EQ(read[0].expr.get(), read[1].constraints[1].get());
+}
+
+TEST(BinaryQueryLogTest, RejectsOtherFiles) {
+  ArrayCache ac;
+  std::istringstream is("(query [] false)\n");
+  BinaryQueryLogReader reader(is, ac);
+  EXPECT_FALSE(reader.isValid());
+  LoggedQuery query;
+  EXPECT_FALSE(reader.read(query));
+}
+
+}
@@ -0,0 +1,233 @@
+//===-- ExprBatchEvaluatorTest.cpp ----------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprBatchEvaluator.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+ArrayCache ac;
+
+ref<Expr> byteAt(const UpdateList &ul, unsigned offset) {
+  return ReadExpr::create(ul, ConstantExpr::alloc(offset, Expr::Int32));
+}
+
+ref<Expr> wordAt(const UpdateList &ul, unsigned offset) {
+  return ConcatExpr::create4(byteAt(ul, offset + 3), byteAt(ul, offset + 2),
+                             byteAt(ul, offset + 1), byteAt(ul, offset));
+}
+
+std::vector<std::unique_ptr<Assignment> >
+randomAssignments(const Array *array, unsigned count, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::vector<std::unique_ptr<Assignment> > assignments;
+  for (unsigned i = 0; i != count; ++i) {
+    std::vector<uint8_t> bytes(array->size);
+    for (auto &b : bytes)
+      // mostly small values, so that divisions by zero and equal
+      // operands come up
+      b = rng() % 4 ? rng() % 4 : rng();
+    Assignment::map_bindings_ty bindings;
+    bindings[array] = MapArrayModel(bytes);
+    assignments.emplace_back(new Assignment(bindings));
+  }
+  return assignments;
+}
+
+std::vector<const Assignment *>
+pointers(const std::vector<std::unique_ptr<Assignment> > &assignments) {
+  std::vector<const Assignment *> result;
+  for (const auto &a : assignments)
+    result.push_back(a.get());
+  return result;
+}
+
+TEST(ExprBatchEvaluatorTest, MatchesAssignmentEvaluate) {
+  const Array *array = ac.CreateArray("batch_arr", 16);
+  UpdateList ul(array, 0);
+  ref<Expr> a = wordAt(ul, 0), b = wordAt(ul, 4);
+  ref<Expr> c = byteAt(ul, 8), d = byteAt(ul, 9);
+
+  // a write to a symbolic index, read back at a symbolic index
+  UpdateList written = ul;
+  written.extend(ZExtExpr::create(ExtractExpr::create(c, 0, 3), Expr::Int32),
+                 ConstantExpr::alloc(42, Expr::Int8));
+  ref<Expr> readBack = ReadExpr::create(
+      written, ZExtExpr::create(ExtractExpr::create(d, 0, 3), Expr::Int32));
+
+  uint64_t table[8] = {3, 1, 4, 1, 5, 9, 2, 6};
+  std::vector<ref<ConstantExpr> > values;
+  for (uint64_t v : table)
+    values.push_back(ConstantExpr::alloc(v, Expr::Int8));
+  const Array *constant =
+      ac.CreateArray("batch_table", values.size(), &values[0],
+                     &values[0] + values.size());
+  ref<Expr> lookup = ReadExpr::create(
+      UpdateList(constant, 0),
+      ZExtExpr::create(ExtractExpr::create(c, 0, 4), Expr::Int32));
+
+  std::vector<ref<Expr> > exprs = {
+      AddExpr::create(a, b),
+      SubExpr::create(a, b),
+      MulExpr::create(a, b),
+      UDivExpr::create(a, b),
+      SDivExpr::create(a, b),
+      URemExpr::create(a, b),
+      SRemExpr::create(a, b),
+      SDivExpr::create(c, d),
+      ShlExpr::create(a, ZExtExpr::create(c, Expr::Int32)),
+      LShrExpr::create(a, ZExtExpr::create(c, Expr::Int32)),
+      AShrExpr::create(a, ZExtExpr::create(c, Expr::Int32)),
+      AndExpr::create(a, NotExpr::create(b)),
+      XorExpr::create(OrExpr::create(a, b), b),
+      ExtractExpr::create(a, 3, 7),
+      SExtExpr::create(c, Expr::Int64),
+      ConcatExpr::create(a, b),
+      SelectExpr::create(UltExpr::create(a, b), a, b),
+      SltExpr::create(a, b),
+      SgeExpr::create(c, d),
+      EqExpr::create(c, d),
+      readBack,
+      lookup,
+  };
+
+  ExprBatchEvaluator evaluator(exprs);
+  ASSERT_TRUE(evaluator.isCompiled());
+
+  auto assignments = randomAssignments(array, 100, 1);
+  std::vector<std::vector<uint64_t> > results;
+  std::vector<bool> exact;
+  evaluator.evaluate(pointers(assignments), results, exact);
+
+  unsigned checked = 0;
+  for (unsigned i = 0; i != assignments.size(); ++i) {
+    if (!exact[i])
+      continue;
+    ++checked;
+    for (unsigned j = 0; j != exprs.size(); ++j) {
+      ref<Expr> expected = assignments[i]->evaluate(exprs[j]);
+      ASSERT_TRUE(isa<ConstantExpr>(expected));
+      EXPECT_EQ(cast<ConstantExpr>(expected)->getZExtValue(), results[i][j])
+          << "expression " << j << ", assignment " << i;
+    }
+  }
+  EXPECT_LT(0u, checked);
+  EXPECT_GT(assignments.size(), checked);
+}
+
+TEST(ExprBatchEvaluatorTest, FindSatisfying) {
+  const Array *array = ac.CreateArray("batch_sat", 4);
+  UpdateList ul(array, 0);
+  std::vector<ref<Expr> > constraints = {
+      EqExpr::create(byteAt(ul, 0), ConstantExpr::alloc(7, Expr::Int8)),
+      UltExpr::create(byteAt(ul, 1), ConstantExpr::alloc(3, Expr::Int8)),
+      // inexact wherever byte 2 is zero
+      EqExpr::create(UDivExpr::create(byteAt(ul, 3), byteAt(ul, 2)),
+                     ConstantExpr::alloc(0, Expr::Int8)),
+  };
+  ExprBatchEvaluator evaluator(constraints);
+  ASSERT_TRUE(evaluator.isCompiled());
+
+  std::vector<std::unique_ptr<Assignment> > assignments;
+  for (unsigned i = 0; i != 40; ++i) {
+    std::vector<uint8_t> bytes = {static_cast<uint8_t>(i == 37 ? 7 : i), 1, 0,
+                                  0};
+    if (i == 37)
+      bytes[2] = 1;
+    Assignment::map_bindings_ty bindings;
+    bindings[array] = MapArrayModel(bytes);
+    assignments.emplace_back(new Assignment(bindings));
+  }
+  EXPECT_EQ(37, evaluator.findSatisfying(pointers(assignments)));
+
+  // with byte 2 zero, the division is left unevaluated as by ExprEvaluator
+  // and the constraints are not satisfied
+  assignments.resize(37);
+  std::vector<uint8_t> bytes = {7, 1, 0, 0};
+  Assignment::map_bindings_ty bindings;
+  bindings[array] = MapArrayModel(bytes);
+  assignments.emplace_back(new Assignment(bindings));
+  EXPECT_EQ(-1, evaluator.findSatisfying(pointers(assignments)));
+}
+
+TEST(ExprBatchEvaluatorTest, WideExpressionsAreNotCompiled) {
+  const Array *array = ac.CreateArray("batch_wide", 16);
+  UpdateList ul(array, 0);
+  ref<Expr> wide = ConcatExpr::create(
+      ConcatExpr::create(wordAt(ul, 0), wordAt(ul, 4)), wordAt(ul, 8));
+  ExprBatchEvaluator evaluator(
+      {EqExpr::create(wide, ConstantExpr::alloc(0, wide->getWidth()))});
+  EXPECT_FALSE(evaluator.isCompiled());
+
+  auto assignments = randomAssignments(array, 4, 2);
+  EXPECT_EQ(-1, evaluator.findSatisfying(pointers(assignments)));
+}
+
+// Not a test as such: compares the time of a batch evaluation with walking
+// the expressions for every assignment.
+TEST(ExprBatchEvaluatorTest, Benchmark) {
+  const Array *array = ac.CreateArray("batch_bench", 64);
+  UpdateList ul(array, 0);
+  std::vector<ref<Expr> > constraints;
+  for (unsigned i = 0; i + 8 <= 64; i += 4) {
+    ref<Expr> sum = AddExpr::create(wordAt(ul, i), wordAt(ul, i + 4));
+    constraints.push_back(UleExpr::create(
+        MulExpr::create(sum, ConstantExpr::alloc(3, Expr::Int32)),
+        ConstantExpr::alloc(0xfffffff0, Expr::Int32)));
+  }
+  // byte 0 is never zero below, so that every assignment is checked
+  constraints.push_back(
+      EqExpr::create(byteAt(ul, 0), ConstantExpr::alloc(0, Expr::Int8)));
+
+  std::mt19937 rng(3);
+  std::vector<std::unique_ptr<Assignment> > assignments;
+  for (unsigned i = 0; i != 4096; ++i) {
+    std::vector<uint8_t> bytes(array->size);
+    for (auto &b : bytes)
+      b = rng();
+    bytes[0] |= 1;
+    Assignment::map_bindings_ty bindings;
+    bindings[array] = MapArrayModel(bytes);
+    assignments.emplace_back(new Assignment(bindings));
+  }
+  std::vector<const Assignment *> candidates = pointers(assignments);
+
+  auto start = std::chrono::steady_clock::now();
+  ExprBatchEvaluator evaluator(constraints);
+  ASSERT_TRUE(evaluator.isCompiled());
+  int batch = evaluator.findSatisfying(candidates);
+  auto middle = std::chrono::steady_clock::now();
+  int walk = -1;
+  for (unsigned i = 0; i != candidates.size() && walk == -1; ++i)
+    if (candidates[i]->satisfies(constraints.begin(), constraints.end()))
+      walk = i;
+  auto end = std::chrono::steady_clock::now();
+
+  EXPECT_EQ(walk, batch);
+  using std::chrono::microseconds;
+  std::cout << "batch evaluation: "
+            << std::chrono::duration_cast<microseconds>(middle - start).count()
+            << "us, expression walks: "
+            << std::chrono::duration_cast<microseconds>(end - middle).count()
+            << "us for " << candidates.size() << " assignments\n";
+}
+
+}
@@ -0,0 +1,192 @@
+//===-- ExprScalarEvaluatorTest.cpp ---------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprScalarEvaluator.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+ArrayCache ac;
+
+ref<Expr> byteAt(const UpdateList &ul, unsigned offset) {
+  return ReadExpr::create(ul, ConstantExpr::alloc(offset, Expr::Int32));
+}
+
+ref<Expr> wordAt(const UpdateList &ul, unsigned offset) {
+  return ConcatExpr::create4(byteAt(ul, offset + 3), byteAt(ul, offset + 2),
+                             byteAt(ul, offset + 1), byteAt(ul, offset));
+}
+
+std::unique_ptr<Assignment> randomAssignment(const Array *array,
+                                             std::mt19937 &rng) {
+  std::vector<uint8_t> bytes(array->size);
+  for (auto &b : bytes)
+    // mostly small values, so that divisions by zero and equal operands
+    // come up
+    b = rng() % 4 ? rng() % 4 : rng();
+  Assignment::map_bindings_ty bindings;
+  bindings[array] = MapArrayModel(bytes);
+  return std::unique_ptr<Assignment>(new Assignment(bindings));
+}
+
+/// The value by rebuilding every node, as Assignment::evaluate used to.
+ref<Expr> visit(const Assignment &assignment, const ref<Expr> &e) {
+  AssignmentEvaluator<Assignment> v(assignment);
+  return v.visit(e);
+}
+
+TEST(ExprScalarEvaluatorTest, MatchesAssignmentEvaluator) {
+  const Array *array = ac.CreateArray("scalar_arr", 16);
+  UpdateList ul(array, 0);
+  ref<Expr> a = wordAt(ul, 0), b = wordAt(ul, 4);
+  ref<Expr> c = byteAt(ul, 8), d = byteAt(ul, 9);
+  ref<Expr> h = ExtractExpr::create(a, 0, 16);
+  ref<Expr> odd = ExtractExpr::create(b, 3, 13);
+
+  UpdateList written = ul;
+  written.extend(ZExtExpr::create(ExtractExpr::create(c, 0, 3), Expr::Int32),
+                 ConstantExpr::alloc(42, Expr::Int8));
+  ref<Expr> readBack = ReadExpr::create(
+      written, ZExtExpr::create(ExtractExpr::create(d, 0, 3), Expr::Int32));
+
+  std::vector<ref<ConstantExpr> > values;
+  for (uint64_t v : {3, 1, 4, 1, 5, 9, 2, 6})
+    values.push_back(ConstantExpr::alloc(v, Expr::Int8));
+  const Array *table = ac.CreateArray("scalar_table", values.size(),
+                                      &values[0], &values[0] + values.size());
+  // out of bounds for half of the indices
+  ref<Expr> lookup = ReadExpr::create(
+      UpdateList(table, 0),
+      ZExtExpr::create(ExtractExpr::create(c, 0, 4), Expr::Int32));
+
+  std::vector<ref<Expr> > exprs = {
+      AddExpr::create(a, b),
+      MulExpr::create(h, ExtractExpr::create(b, 0, 16)),
+      SubExpr::create(odd, ExtractExpr::create(a, 5, 13)),
+      UDivExpr::create(a, b),
+      SDivExpr::create(c, d),
+      SRemExpr::create(h, ExtractExpr::create(b, 0, 16)),
+      URemExpr::create(odd, ExtractExpr::create(a, 0, 13)),
+      ShlExpr::create(a, ZExtExpr::create(c, Expr::Int32)),
+      LShrExpr::create(h, ZExtExpr::create(d, Expr::Int16)),
+      AShrExpr::create(odd, ZExtExpr::create(c, 13)),
+      XorExpr::create(OrExpr::create(a, b), NotExpr::create(b)),
+      SExtExpr::create(odd, Expr::Int64),
+      ConcatExpr::create(a, b),
+      SelectExpr::create(UltExpr::create(a, b), a, b),
+      // the division is only evaluated where it is selected
+      SelectExpr::create(EqExpr::create(c, ConstantExpr::alloc(0, Expr::Int8)),
+                         d, UDivExpr::create(d, c)),
+      AndExpr::create(SltExpr::create(a, b), SgeExpr::create(c, d)),
+      OrExpr::create(EqExpr::create(h, ConstantExpr::alloc(0, Expr::Int16)),
+                     SleExpr::create(odd, ExtractExpr::create(a, 0, 13))),
+      readBack,
+      lookup,
+  };
+
+  std::mt19937 rng(1);
+  unsigned evaluated = 0, total = 0;
+  for (unsigned i = 0; i != 100; ++i) {
+    std::unique_ptr<Assignment> assignment = randomAssignment(array, rng);
+    ExprScalarEvaluator evaluator(*assignment);
+    for (unsigned j = 0; j != exprs.size(); ++j) {
+      ref<Expr> expected = visit(*assignment, exprs[j]);
+      uint64_t value;
+      ++total;
+      if (!evaluator.evaluate(exprs[j], value)) {
+        // only where ExprEvaluator leaves a division by zero
+        EXPECT_FALSE(isa<ConstantExpr>(expected))
+            << "expression " << j << ", assignment " << i;
+        continue;
+      }
+      ++evaluated;
+      ASSERT_TRUE(isa<ConstantExpr>(expected));
+      EXPECT_EQ(cast<ConstantExpr>(expected)->getZExtValue(), value)
+          << "expression " << j << ", assignment " << i;
+      EXPECT_EQ(expected, assignment->evaluate(exprs[j]));
+    }
+  }
+  EXPECT_LT(0u, evaluated);
+  EXPECT_GT(total, evaluated);
+}
+
+TEST(ExprScalarEvaluatorTest, WideExpressionsAreLeftToTheVisitor) {
+  const Array *array = ac.CreateArray("scalar_wide", 16);
+  UpdateList ul(array, 0);
+  ref<Expr> wide = ConcatExpr::create(
+      ConcatExpr::create(wordAt(ul, 0), wordAt(ul, 4)), wordAt(ul, 8));
+  std::mt19937 rng(2);
+  std::unique_ptr<Assignment> assignment = randomAssignment(array, rng);
+
+  uint64_t value;
+  ExprScalarEvaluator evaluator(*assignment);
+  EXPECT_FALSE(evaluator.evaluate(wide, value));
+  ref<Expr> low = ExtractExpr::create(AddExpr::create(wide, wide), 0, 32);
+  EXPECT_FALSE(evaluator.evaluate(low, value));
+  EXPECT_EQ(visit(*assignment, low), assignment->evaluate(low));
+}
+
+// Not a test as such: compares the time of evaluating constraints with the
+// scalar evaluator and with the visitor.
+TEST(ExprScalarEvaluatorTest, Benchmark) {
+  const Array *array = ac.CreateArray("scalar_bench", 64);
+  UpdateList ul(array, 0);
+  // a chain of sums, each constraint sharing the ones before it
+  std::vector<ref<Expr> > constraints;
+  ref<Expr> sum = ConstantExpr::alloc(0, Expr::Int32);
+  for (unsigned i = 0; i + 4 <= 64; i += 4) {
+    sum = AddExpr::create(MulExpr::create(sum, ConstantExpr::alloc(
+                                                   3, Expr::Int32)),
+                          wordAt(ul, i));
+    constraints.push_back(
+        NeExpr::create(sum, ConstantExpr::alloc(0x12345678, Expr::Int32)));
+  }
+
+  std::mt19937 rng(3);
+  std::vector<std::unique_ptr<Assignment> > assignments;
+  for (unsigned i = 0; i != 2048; ++i)
+    assignments.push_back(randomAssignment(array, rng));
+
+  unsigned scalarSatisfied = 0, visitorSatisfied = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const auto &assignment : assignments)
+    scalarSatisfied +=
+        assignment->satisfies(constraints.begin(), constraints.end());
+  auto middle = std::chrono::steady_clock::now();
+  for (const auto &assignment : assignments) {
+    AssignmentEvaluator<Assignment> v(*assignment);
+    bool satisfied = true;
+    for (const auto &constraint : constraints)
+      satisfied = satisfied && v.visit(constraint)->isTrue();
+    visitorSatisfied += satisfied;
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  EXPECT_EQ(visitorSatisfied, scalarSatisfied);
+  using std::chrono::microseconds;
+  std::cout << "scalar evaluation: "
+            << std::chrono::duration_cast<microseconds>(middle - start).count()
+            << "us, visitor: "
+            << std::chrono::duration_cast<microseconds>(end - middle).count()
+            << "us for " << assignments.size() << " assignments\n";
+}
+
+}
@@ -0,0 +1,120 @@
+//===-- PersistentQueryCacheTest.cpp --------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/PersistentQueryCache.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+
+class PersistentQueryCacheTest : public ::testing::Test {
+protected:
+  char path[32];
+
+  void SetUp() override {
+    strcpy(path, "/tmp/klee-qcache-XXXXXX");
+    int fd = mkstemp(path);
+    ASSERT_NE(-1, fd);
+    close(fd);
+    unlink(path);
+    auto &options = llvm::cl::getRegisteredOptions();
+    static_cast<llvm::cl::opt<std::string> *>(options["persistent-query-cache"])
+        ->setValue(path);
+  }
+
+  void TearDown() override { unlink(path); }
+};
+
+ref<Expr> lessThan(const Array *array, unsigned index, unsigned value) {
+  UpdateList ul(array, 0);
+  return UltExpr::create(
+      ReadExpr::create(ul, ConstantExpr::alloc(index, Expr::Int32)),
+      ConstantExpr::alloc(value, Expr::Int8));
+}
+
+TEST_F(PersistentQueryCacheTest, SharedBetweenInstances) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  const Array *b = ac.CreateArray("b", 4);
+  std::vector<ref<Expr> > first = {lessThan(a, 0, 10), lessThan(b, 1, 20)};
+
+  auto writer = PersistentQueryCache::open();
+  auto reader = PersistentQueryCache::open();
+  ASSERT_TRUE(writer && reader);
+
+  PersistentQueryCache::Key key('V', first);
+  std::string value;
+  EXPECT_FALSE(reader->lookup(key, value));
+  writer->insert(key, "x");
+  ASSERT_TRUE(reader->lookup(key, value));
+  EXPECT_EQ("x", value);
+
+  // the newest value wins
+  writer->insert(key, "y");
+  ASSERT_TRUE(reader->lookup(key, value));
+  EXPECT_EQ("y", value);
+
+  // the same constraints on other arrays, in another order
+  const Array *c = ac.CreateArray("c", 4);
+  const Array *d = ac.CreateArray("d", 4);
+  std::vector<ref<Expr> > second = {lessThan(d, 1, 20), lessThan(c, 0, 10)};
+  ASSERT_TRUE(reader->lookup(PersistentQueryCache::Key('V', second), value));
+  EXPECT_EQ("y", value);
+
+  EXPECT_FALSE(reader->lookup(PersistentQueryCache::Key('C', second), value));
+  std::vector<ref<Expr> > other = {lessThan(c, 0, 11), lessThan(d, 1, 20)};
+  EXPECT_FALSE(reader->lookup(PersistentQueryCache::Key('V', other), value));
+}
+
+TEST_F(PersistentQueryCacheTest, Assignments) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  const Array *b = ac.CreateArray("b", 4);
+  PersistentQueryCache::Key key('C', {lessThan(a, 0, 10), lessThan(b, 2, 20)});
+
+  Assignment::map_bindings_ty bindings;
+  bindings[a].add(0, 7);
+  bindings[b].add(2, 13);
+  Assignment assignment(bindings);
+
+  std::shared_ptr<const Assignment> result;
+  std::string value = PersistentQueryCache::encodeAssignment(key, &assignment);
+  ASSERT_TRUE(PersistentQueryCache::decodeAssignment(key, value, result));
+  ASSERT_TRUE(result != nullptr);
+  EXPECT_EQ(7, result->getValue(a, 0));
+  EXPECT_EQ(13, result->getValue(b, 2));
+
+  // decoded for the arrays of an equivalent query
+  const Array *c = ac.CreateArray("c", 4);
+  const Array *d = ac.CreateArray("d", 4);
+  PersistentQueryCache::Key renamed('C',
+                                    {lessThan(c, 0, 10), lessThan(d, 2, 20)});
+  ASSERT_TRUE(PersistentQueryCache::decodeAssignment(renamed, value, result));
+  EXPECT_EQ(7, result->getValue(c, 0));
+  EXPECT_EQ(13, result->getValue(d, 2));
+
+  value = PersistentQueryCache::encodeAssignment(key, nullptr);
+  ASSERT_TRUE(PersistentQueryCache::decodeAssignment(key, value, result));
+  EXPECT_TRUE(result == nullptr);
+  EXPECT_FALSE(PersistentQueryCache::decodeAssignment(key, "", result));
+}
+
+}
@@ -0,0 +1,219 @@
+//===-- PreprocessingSolverTest.cpp ---------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverCmdLine.h"
+#include "klee/Solver/SolverImpl.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// Remember the last query it was asked, and claim it is valid.
+class RecordingSolver : public SolverImpl {
+public:
+  std::vector<ref<Expr>> &constraints;
+  ref<Expr> &expr;
+
+  RecordingSolver(std::vector<ref<Expr>> &constraints, ref<Expr> &expr)
+      : constraints(constraints), expr(expr) {}
+
+  bool computeTruth(const Query &query, bool &isValid) {
+    constraints.assign(query.constraints.begin(), query.constraints.end());
+    expr = query.expr;
+    isValid = true;
+    return true;
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) { return false; }
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) {
+    return false;
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+};
+
+class PreprocessingSolverTest : public ::testing::Test {
+protected:
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 8);
+  const Array *b = ac.CreateArray("b", 8);
+  std::vector<ref<Expr>> seenConstraints;
+  ref<Expr> seenExpr;
+
+  /// Ask whether \a expr is valid under \a constraints with the given
+  /// rewrites and record the query reaching the underlying solver.
+  bool mustBeTrue(unsigned rewrites, const std::vector<ref<Expr>> &constraints,
+                  ref<Expr> expr) {
+    seenConstraints.clear();
+    seenExpr = ref<Expr>();
+    Solver *preprocessing = createPreprocessingSolver(
+        new Solver(new RecordingSolver(seenConstraints, seenExpr)), rewrites);
+    ConstraintManager cm(constraints);
+    bool result = false;
+    EXPECT_TRUE(preprocessing->mustBeTrue(Query(cm, expr), result));
+    delete preprocessing;
+    return result;
+  }
+
+  ref<Expr> read(const Array *array, ref<Expr> index) {
+    return ReadExpr::create(UpdateList(array, 0), index);
+  }
+  ref<Expr> read(const Array *array, unsigned index) {
+    return read(array, ConstantExpr::alloc(index, Expr::Int32));
+  }
+  ref<Expr> byte(uint64_t value) {
+    return ConstantExpr::alloc(value, Expr::Int8);
+  }
+};
+
+unsigned bit(PreprocessingRewrite rewrite) { return 1u << rewrite; }
+
+TEST_F(PreprocessingSolverTest, Equalities) {
+  ref<Expr> sum = AddExpr::create(read(a, 0), read(b, 0));
+  std::vector<ref<Expr>> constraints = {
+      EqExpr::create(byte(3), read(a, 0)), UltExpr::create(sum, byte(100))};
+  mustBeTrue(bit(PREPROCESS_EQUALITIES), constraints,
+             EqExpr::create(byte(5), sum));
+
+  ASSERT_EQ(2u, seenConstraints.size());
+  EXPECT_EQ(constraints[0], seenConstraints[0]);
+  ref<Expr> substituted = AddExpr::create(byte(3), read(b, 0));
+  EXPECT_EQ(UltExpr::create(substituted, byte(100)), seenConstraints[1]);
+  EXPECT_EQ(EqExpr::create(byte(5), substituted), seenExpr);
+}
+
+TEST_F(PreprocessingSolverTest, BoundsFixingByte) {
+  // a[0] <= 0 fixes a[0], which is then substituted
+  std::vector<ref<Expr>> constraints = {UleExpr::create(read(a, 0), byte(0))};
+  ref<Expr> expr = EqExpr::create(byte(7), AddExpr::create(read(a, 0),
+                                                           read(b, 0)));
+  mustBeTrue(bit(PREPROCESS_EQUALITIES) | bit(PREPROCESS_BOUNDS), constraints,
+             expr);
+
+  ASSERT_EQ(1u, seenConstraints.size());
+  EXPECT_EQ(EqExpr::create(byte(0), read(a, 0)), seenConstraints[0]);
+  EXPECT_EQ(EqExpr::create(byte(7), read(b, 0)), seenExpr);
+}
+
+TEST_F(PreprocessingSolverTest, BoundsOnConcatenation) {
+  // a[1] a[0] < 5 fixes a[1], but still bounds a[0]
+  ref<Expr> value = ConcatExpr::create(read(a, 1), read(a, 0));
+  std::vector<ref<Expr>> constraints = {
+      UltExpr::create(value, ConstantExpr::alloc(5, Expr::Int16))};
+  unsigned all = bit(PREPROCESS_EQUALITIES) | bit(PREPROCESS_READS) |
+                 bit(PREPROCESS_BOUNDS) | bit(PREPROCESS_DEAD);
+  mustBeTrue(all, constraints, EqExpr::create(byte(1), read(a, 0)));
+
+  // the equality on a[1] is unrelated to the query once substituted
+  ASSERT_EQ(1u, seenConstraints.size());
+  EXPECT_EQ(UltExpr::create(ConcatExpr::create(byte(0), read(a, 0)),
+                            ConstantExpr::alloc(5, Expr::Int16)),
+            seenConstraints[0]);
+}
+
+TEST_F(PreprocessingSolverTest, ImpliedBounds) {
+  std::vector<ref<Expr>> constraints = {UltExpr::create(read(a, 0), byte(10)),
+                                        UltExpr::create(read(a, 0), byte(5)),
+                                        UltExpr::create(read(b, 0), byte(50))};
+  mustBeTrue(bit(PREPROCESS_BOUNDS), constraints,
+             EqExpr::create(read(a, 1), read(b, 0)));
+
+  ASSERT_EQ(2u, seenConstraints.size());
+  EXPECT_EQ(constraints[1], seenConstraints[0]);
+  EXPECT_EQ(constraints[2], seenConstraints[1]);
+
+  // the query itself follows from the bounds
+  EXPECT_TRUE(mustBeTrue(bit(PREPROCESS_BOUNDS), constraints,
+                         UltExpr::create(read(a, 0), byte(20))));
+  EXPECT_TRUE(seenExpr.isNull());
+}
+
+TEST_F(PreprocessingSolverTest, ExpandReads) {
+  ref<Expr> index = ZExtExpr::create(read(b, 0), Expr::Int32);
+  std::vector<ref<Expr>> constraints = {UltExpr::create(read(b, 0), byte(2))};
+  mustBeTrue(bit(PREPROCESS_READS), constraints,
+             EqExpr::create(byte(1), read(a, index)));
+
+  ref<Expr> expanded = SelectExpr::create(
+      EqExpr::create(ConstantExpr::alloc(0, Expr::Int32), index), read(a, 0),
+      read(a, 1));
+  EXPECT_EQ(EqExpr::create(byte(1), expanded), seenExpr);
+
+  // too many possible indices
+  constraints = {UltExpr::create(read(b, 0), byte(100))};
+  ref<Expr> expr = EqExpr::create(byte(1), read(a, index));
+  mustBeTrue(bit(PREPROCESS_READS), constraints, expr);
+  EXPECT_EQ(expr, seenExpr);
+}
+
+TEST_F(PreprocessingSolverTest, ConstantTables) {
+  // t[i] = i / 8
+  std::vector<ref<ConstantExpr>> values;
+  for (unsigned i = 0; i != 32; ++i)
+    values.push_back(ConstantExpr::alloc(i / 8, Expr::Int8));
+  const Array *t = ac.CreateArray("t", values.size(), &values[0],
+                                  &values[0] + values.size());
+  ref<Expr> index = ZExtExpr::create(read(b, 0), Expr::Int32);
+  auto at = [](uint64_t i) { return ConstantExpr::alloc(i, Expr::Int32); };
+  std::vector<ref<Expr>> constraints = {UltExpr::create(read(b, 0), byte(32))};
+
+  // one choice for each run of equal values
+  mustBeTrue(bit(PREPROCESS_TABLES), constraints,
+             UltExpr::create(read(t, index), byte(2)));
+  ref<Expr> expanded = SelectExpr::create(
+      UleExpr::create(index, at(7)), byte(0),
+      SelectExpr::create(
+          UleExpr::create(index, at(15)), byte(1),
+          SelectExpr::create(UleExpr::create(index, at(23)), byte(2),
+                             byte(3))));
+  EXPECT_EQ(UltExpr::create(expanded, byte(2)), seenExpr);
+
+  // comparisons with a value become comparisons with its indices
+  constraints = {UltExpr::create(read(b, 0), byte(20))};
+  mustBeTrue(bit(PREPROCESS_TABLES), constraints,
+             EqExpr::create(byte(2), read(t, index)));
+  ref<Expr> inverted = ConstantExpr::alloc(0, Expr::Bool);
+  for (unsigned i = 20; i-- > 16;)
+    inverted = OrExpr::create(EqExpr::create(at(i), index), inverted);
+  EXPECT_EQ(inverted, seenExpr);
+
+  // no index within the bounds holds the value
+  EXPECT_FALSE(mustBeTrue(bit(PREPROCESS_TABLES), constraints,
+                          EqExpr::create(byte(3), read(t, index))));
+  EXPECT_TRUE(seenExpr.isNull());
+
+  // the index may be out of bounds
+  constraints = {UltExpr::create(read(b, 0), byte(40))};
+  ref<Expr> expr = EqExpr::create(byte(2), read(t, index));
+  mustBeTrue(bit(PREPROCESS_TABLES), constraints, expr);
+  EXPECT_EQ(expr, seenExpr);
+}
+
+TEST_F(PreprocessingSolverTest, DeadConstraints) {
+  std::vector<ref<Expr>> constraints = {
+      EqExpr::create(read(a, 0), read(a, 1)),
+      EqExpr::create(read(b, 0), read(b, 1))};
+  mustBeTrue(bit(PREPROCESS_DEAD), constraints,
+             EqExpr::create(byte(1), read(b, 1)));
+
+  ASSERT_EQ(1u, seenConstraints.size());
+  EXPECT_EQ(constraints[1], seenConstraints[0]);
+}
+
+}
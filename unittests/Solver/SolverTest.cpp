@@ -14,10 +14,13 @@
 #include "klee/Expr/Expr.h"
 #include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverCmdLine.h"
+#include "klee/Solver/SolverImpl.h"
 
 #include "llvm/ADT/StringExtras.h"
 
+#include <algorithm>
 #include <iostream>
+#include <vector>
 
 using namespace klee;
 
@@ -168,4 +171,80 @@ TEST(SolverTest, Evaluation) {
   delete solver;
 }
 
+
+/// Record the batches of truth queries it is asked, and claim that exactly
+/// the negations of equalities with a constant are valid.
+class BatchRecordingSolver : public SolverImpl {
+public:
+  std::vector<std::pair<unsigned, unsigned> > &batches;
+
+  BatchRecordingSolver(std::vector<std::pair<unsigned, unsigned> > &batches)
+      : batches(batches) {}
+
+  bool computeTruth(const Query &query, bool &isValid) {
+    std::vector<bool> results;
+    if (!computeTruths(query.constraints, {query.expr}, results))
+      return false;
+    isValid = results[0];
+    return true;
+  }
+  bool computeTruths(const ConstraintManager &constraints,
+                     const std::vector<ref<Expr> > &exprs,
+                     std::vector<bool> &isValid) {
+    batches.push_back(std::make_pair(constraints.size(), exprs.size()));
+    isValid.clear();
+    for (const ref<Expr> &e : exprs)
+      isValid.push_back(isa<ConstantExpr>(e->getKid(1)->getKid(0)));
+    return true;
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) { return false; }
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) {
+    return false;
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+};
+
+TEST(SolverTest, BatchedMayBeTrue) {
+  std::vector<std::pair<unsigned, unsigned> > batches;
+  Solver *solver = createIndependentSolver(
+      new Solver(new BatchRecordingSolver(batches)));
+
+  const Array *a = ac.CreateArray("batch_a", 1);
+  const Array *b = ac.CreateArray("batch_b", 1);
+  ref<Expr> x = Expr::createTempRead(a, Expr::Int8);
+  ref<Expr> y = Expr::createTempRead(b, Expr::Int8);
+  std::vector<ref<Expr> > constraints = {
+      UltExpr::create(x, ConstantExpr::create(10, Expr::Int8)),
+      UltExpr::create(y, ConstantExpr::create(20, Expr::Int8))};
+  ConstraintManager cm(constraints);
+
+  std::vector<ref<Expr> > exprs = {
+      EqExpr::create(ConstantExpr::create(1, Expr::Int8), x),
+      ConstantExpr::create(0, Expr::Bool),
+      EqExpr::create(ConstantExpr::create(2, Expr::Int8), x),
+      EqExpr::create(x, y)};
+  std::vector<bool> results;
+  ASSERT_TRUE(solver->mayBeTrue(cm, exprs, results));
+
+  // the constant is answered directly, the negations of the equalities
+  // with constants are claimed valid
+  ASSERT_EQ(4u, results.size());
+  EXPECT_FALSE(results[0]);
+  EXPECT_FALSE(results[1]);
+  EXPECT_FALSE(results[2]);
+  EXPECT_TRUE(results[3]);
+
+  // the expressions on x share their constraints
+  ASSERT_EQ(2u, batches.size());
+  std::sort(batches.begin(), batches.end());
+  EXPECT_EQ(std::make_pair(1u, 2u), batches[0]);
+  EXPECT_EQ(std::make_pair(2u, 1u), batches[1]);
+
+  delete solver;
+}
+
 }
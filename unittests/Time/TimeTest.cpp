@@ -1,9 +1,11 @@
+#include "klee/Internal/Support/Timer.h"
 #include "klee/Internal/System/Time.h"
 #include "gtest/gtest.h"
 #include "gtest/gtest-death-test.h"
 
 #include <cerrno>
 #include <sstream>
+#include <thread>
 
 
 int finished = 0;
@@ -182,4 +184,19 @@ TEST(TimeTest, ImplicitArithmeticConversions) {
   t1 *= 2.2;
   d = t1.toSeconds();
   ASSERT_EQ(d, 2200.0);
-}
\ No newline at end of file
+}
+
+TEST(TimeTest, TimerGroupTicks) {
+  TimerGroup timers(time::milliseconds(10));
+  unsigned runs = 0;
+  timers.add(std::make_unique<Timer>(time::milliseconds(20), [&] { ++runs; }));
+  timers.reset();
+
+  // the timer is due on the second tick, however late the ticker thread
+  // gets to count it
+  while (runs == 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    timers.invoke();
+  }
+  ASSERT_EQ(runs, 1u);
+}
@@ -46,3 +46,39 @@ TEST(TreeStreamTest, WriteLargerThanBufferSize) {
   for (unsigned i=0; i<out.size(); i++)
     ASSERT_EQ('A', out[i]);
 }
+
+/* Branches are stored as bits. A forked stream starts with the branches
+   of its parent up to the fork, also when the branches of several streams
+   are interleaved and a stream does not end on a byte boundary. */
+TEST(TreeStreamTest, Branches) {
+  TreeStreamWriter tsw("tsw3.out");
+  ASSERT_TRUE(tsw.good());
+
+  TreeOStream parent = tsw.open();
+  std::vector<bool> expectedParent;
+  for (unsigned i = 0; i < 11; i++) {
+    parent.writeBranch(i % 3 == 0);
+    expectedParent.push_back(i % 3 == 0);
+  }
+
+  TreeOStream child = tsw.open(parent);
+  std::vector<bool> expectedChild = expectedParent;
+  for (unsigned i = 0; i < 40000; i++) {
+    parent.writeBranch(true);
+    expectedParent.push_back(true);
+    child.writeBranch(i % 2);
+    expectedChild.push_back(i % 2);
+  }
+  child.write("x", 1);
+  for (unsigned j = 0; j < 8; j++)
+    expectedChild.push_back(('x' >> j) & 1);
+  child.flush();
+
+  std::vector<bool> out;
+  tsw.readStream(parent.getID(), out);
+  ASSERT_EQ(expectedParent, out);
+
+  out.clear();
+  tsw.readStream(child.getID(), out);
+  ASSERT_EQ(expectedChild, out);
+}